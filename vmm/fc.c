@@ -33,10 +33,17 @@ static LPSTR FC_SQL_SCHEMA_NTFS =
     "DROP VIEW IF EXISTS v_ntfs; " \
     "DROP TABLE IF EXISTS ntfs; " \
     "CREATE TABLE ntfs ( id INTEGER PRIMARY KEY, id_parent INTEGER, id_str INTEGER, hash INTEGER, hash_parent INTEGER, addr_phys INTEGER, inode INTEGER, mft_flags INTEGER, depth INTEGER, size_file INTEGER, size_fileres INTEGER, time_create INTEGER, time_modify INTEGER, time_read INTEGER, name_seq INTEGER, oln_u INTEGER, oln_j INTEGER );" \
-    "CREATE INDEX idx_ntfs_hash ON ntfs(hash); " \
-    "CREATE INDEX idx_ntfs_hash_parent ON ntfs(hash_parent); " \
-    "CREATE INDEX idx_oln_u ON ntfs(oln_u); " \
     "CREATE VIEW v_ntfs AS SELECT *, SUBSTR(sz, osz+1) AS sz_sub FROM ntfs, str WHERE ntfs.id_str = str.id; ";
+static LPSTR FC_SQL_INDEX_NTFS =
+    "CREATE INDEX IF NOT EXISTS idx_ntfs_hash ON ntfs(hash); " \
+    "CREATE INDEX IF NOT EXISTS idx_ntfs_hash_parent ON ntfs(hash_parent); " \
+    "CREATE INDEX IF NOT EXISTS idx_oln_u ON ntfs(oln_u); ";
+static LPSTR FC_SQL_PRAGMA_INGEST =
+    "PRAGMA synchronous = OFF; PRAGMA journal_mode = MEMORY; PRAGMA temp_store = MEMORY; PRAGMA cache_size = -65536;";
+static LPSTR FC_SQL_PRAGMA_INGEST_RESUME =
+    "PRAGMA synchronous = NORMAL; PRAGMA journal_mode = WAL; PRAGMA temp_store = MEMORY; PRAGMA cache_size = -65536;";
+static LPSTR FC_SQL_PRAGMA_DEFAULT =
+    "PRAGMA synchronous = FULL; PRAGMA journal_mode = DELETE;";
 static LPSTR FC_SQL_SCHEMA_PROCESS =
     "DROP TABLE IF EXISTS process; " \
     "CREATE TABLE process(id INTEGER PRIMARY KEY AUTOINCREMENT, id_str_name INTEGER, id_str_path INTEGER, id_str_user INTEGER, id_str_all INTEGER, pid INT, ppid INT, eprocess INTEGER, dtb INTEGER, dtb_user INTEGER, state INTEGER, wow64 INT, peb INTEGER, peb32 INTEGER, time_create INTEGER, time_exit INTEGER); " \
@@ -52,6 +59,14 @@ static LPSTR FC_SQL_SCHEMA_REGISTRY =
     "DROP TABLE IF EXISTS registry; " \
     "CREATE TABLE registry ( id INTEGER PRIMARY KEY AUTOINCREMENT, id_str INTEGER, hive INTEGER, cell INTEGER, cell_parent INTEGER, time INTEGER ); " \
     "CREATE VIEW v_registry AS SELECT *, SUBSTR(sz, osz+1) AS sz_sub FROM registry, str WHERE registry.id_str = str.id; ";
+static LPSTR FC_SQL_SCHEMA_RESUME =
+    "DROP TABLE IF EXISTS resume_info; " \
+    "CREATE TABLE resume_info ( id INTEGER PRIMARY KEY, fingerprint BLOB ); " \
+    "DROP TABLE IF EXISTS resume_manifest; " \
+    "CREATE TABLE resume_manifest ( stage INTEGER PRIMARY KEY, fcomplete INT, fenable INT, id_str INTEGER, pa_scan INTEGER ); ";
+static LPSTR FC_SQL_SCHEMA_RESUME_SCAN =
+    "DROP TABLE IF EXISTS resume_ntfs; " \
+    "CREATE TABLE resume_ntfs ( id INTEGER PRIMARY KEY AUTOINCREMENT, crecord INT, data BLOB ); ";
 
 
 
@@ -66,12 +81,15 @@ static LPSTR FC_SQL_SCHEMA_REGISTRY =
 PVOID FcNtfs_SetupInitialize();
 
 /*
-* Analyze a POB_FC_SCANPHYSMEM_CHUNK 16MB memory chunk for MFT file candidates
-* and add any found to the internal data sets. This function is meant to be
-* called asynchronously by a worker thread (VmmWork). Function is thread-safe.
+* Analyze a part of a POB_FC_SCANPHYSMEM_CHUNK 16MB memory chunk for MFT file
+* candidates and add any found to the internal data sets. This function is a
+* physical memory scan consumer callback. Function is thread-safe.
+* -- ctx = PFCNTFS_SETUP_CONTEXT
 * -- pc
+* -- iPage
+* -- cPage
 */
-VOID FcNtfs_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc);
+VOID FcNtfs_SetupChunk(_In_opt_ PVOID ctx, _In_ POB_FC_SCANPHYSMEM_CHUNK pc, _In_ DWORD iPage, _In_ DWORD cPage);
 
 /*
 * Finalize the NTFS setup/initialization phase. Try to put re-assemble the NTFS
@@ -82,6 +100,27 @@ VOID FcNtfs_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc);
 */
 VOID FcNtfs_SetupFinalize(_In_opt_ PVOID pvSetupContextNtfs, _In_ BOOL fScanSuccess);
 
+/*
+* Save the parsed MFT records not yet saved to the resumable store. This
+* function is a physical memory scan consumer checkpoint callback.
+* -- ctx = PFCNTFS_SETUP_CONTEXT
+* -- hSql
+* -- return
+*/
+_Success_(return)
+BOOL FcNtfs_SetupCheckpoint(_In_opt_ PVOID ctx, _In_ sqlite3 *hSql);
+
+/*
+* Restore the parsed MFT records of an interrupted scan from the resumable
+* store. This function is a physical memory scan consumer resume callback.
+* -- ctx = PFCNTFS_SETUP_CONTEXT
+* -- hSql
+* -- paResume
+* -- return
+*/
+_Success_(return)
+BOOL FcNtfs_SetupResume(_In_opt_ PVOID ctx, _In_ sqlite3 *hSql, _In_ QWORD paResume);
+
 /*
 * Initialize the timelining functionality. Before the timelining functionality
 * is initialized processes, threads, registry and ntfs must be initialized.
@@ -91,6 +130,23 @@ VOID FcNtfs_SetupFinalize(_In_opt_ PVOID pvSetupContextNtfs, _In_ BOOL fScanSucc
 _Success_(return)
 BOOL FcTimeline_Initialize();
 
+/*
+* Load the timeline type information from an already initialized database.
+* -- return
+*/
+_Success_(return)
+BOOL FcTimeline_InitializeInfo();
+
+/*
+* Render the utf-8 timeline files into pre-rendered memory-mapped files.
+*/
+VOID FcTimeline_RenderFile();
+
+/*
+* Render the utf-8 ntfs_files.txt into a pre-rendered memory-mapped file.
+*/
+VOID FcNtfs_RenderFile();
+
 
 
 // ----------------------------------------------------------------------------
@@ -202,17 +258,42 @@ fail:
     return rc;
 }
 
+/*
+* Fill the lengths and the id of a 'str' table entry from its utf-8 string -
+* shared by the row-by-row and the bulk insert paths. The json length is the
+* length of the string once json escaped: '"', '\\' and \b \f \n \r \t are
+* escaped with two characters, other control characters as \u00XX.
+* -- szu = utf-8 string.
+* -- cbu = utf-8 length excl. null terminator.
+* -- pThis
+*/
+VOID Fc_SqlStrEntry(_In_reads_(cbu) LPSTR szu, _In_ DWORD cbu, _Inout_ PFCSQL_INSERTSTRTABLE pThis)
+{
+    DWORD i;
+    BYTE ch;
+    pThis->cbu = cbu;
+    pThis->cbj = cbu;
+    for(i = 0; i < cbu; i++) {
+        ch = (BYTE)szu[i];
+        if((ch == '"') || (ch == '\\') || (ch == '\b') || (ch == '\f') || (ch == '\n') || (ch == '\r') || (ch == '\t')) {
+            pThis->cbj += 1;
+        } else if(ch < 0x20) {
+            pThis->cbj += 5;
+        }
+    }
+    pThis->id = InterlockedIncrement64(&ctxFc->db.qwIdStr);
+}
+
 _Success_(return)
 BOOL Fc_SqlInsertStr(_In_ sqlite3_stmt *hStmt, _In_ LPWSTR wsz, _In_ DWORD owszSub, _Out_ PFCSQL_INSERTSTRTABLE pThis)
 {
     CHAR szUTF8[2048];
+    DWORD cbu;
     pThis->cwsz = (DWORD)wcslen(wsz);
     if(pThis->cwsz < owszSub) { return FALSE; }
-    pThis->cbu = WideCharToMultiByte(CP_UTF8, 0, wsz, -1, szUTF8, sizeof(szUTF8), NULL, NULL);
-    if(!pThis->cbu) { return FALSE; }
-    pThis->cbu--;               // don't count null terminator.
-    pThis->cbj = pThis->cbu;    // TODO: FIX THIS - CALCULATE FOR JSON ESPAPE CHARS !!!
-    pThis->id = InterlockedIncrement64(&ctxFc->db.qwIdStr);
+    cbu = WideCharToMultiByte(CP_UTF8, 0, wsz, -1, szUTF8, sizeof(szUTF8), NULL, NULL);
+    if(!cbu) { return FALSE; }
+    Fc_SqlStrEntry(szUTF8, cbu - 1, pThis);     // don't count null terminator.
     sqlite3_reset(hStmt);
     sqlite3_bind_int64(hStmt, 1, pThis->id);
     sqlite3_bind_int(hStmt, 2, owszSub);
@@ -265,6 +346,621 @@ BOOL Fc_SqlInitializeDatabaseTables()
 
 
 
+// ----------------------------------------------------------------------------
+// SQLITE BULK INGEST FUNCTIONALITY BELOW:
+// The forensic initialization phase is INSERT-bound. Instead of stepping one
+// prepared statement per row producers append rows to a bulk handle which
+// stages them in columnar buffers private to the producer (no locking). Once
+// full the staged rows are drained by a single writer at a time in one large
+// transaction using multi-row INSERT statements. Secondary indexes are not
+// maintained during ingest - they're created once at the end of each stage.
+// ----------------------------------------------------------------------------
+
+typedef struct tdFC_SQLBULK {
+    LPSTR szTable;
+    LPSTR szColumns;
+    DWORD cColumn;
+    DWORD cRow;                                     // # staged table rows
+    DWORD cStr;                                     // # staged 'str' rows
+    DWORD cbStr;                                    // bytes used in szStr
+    PQWORD pqwColumn;                               // staged table rows: [cColumn][FC_SQLBULK_ROWS]
+    QWORD pqwStr[6][FC_SQLBULK_ROWS];               // staged 'str' rows: id, osz, csz, cbu, cbj, offset into szStr
+    CHAR szStr[FC_SQLBULK_STRBUFFER];               // staged 'str' utf-8 strings
+} FC_SQLBULK;
+
+/*
+* Set the ingest-time pragmas on all database connections. During ingest the
+* database is not synced to disk and the journal is kept in memory - if the
+* process crash during the forensic initialization the database is useless
+* anyway since it's not complete. The exception is the resumable store which
+* uses a write-ahead log to remain consistent if the process is killed.
+* -- fIngest = TRUE to enter ingest mode, FALSE to leave ingest mode.
+*/
+VOID Fc_SqlBulkIngestPragma(_In_ BOOL fIngest)
+{
+    DWORD i;
+    LPSTR szPragma;
+    if(fIngest) {
+        szPragma = ctxFc->Resume.fEnable ? FC_SQL_PRAGMA_INGEST_RESUME : FC_SQL_PRAGMA_INGEST;
+    } else {
+        szPragma = FC_SQL_PRAGMA_DEFAULT;
+    }
+    for(i = 0; i < FC_SQL_POOL_CONNECTION_NUM; i++) {
+        if(ctxFc->db.hSql[i]) {
+            sqlite3_exec(ctxFc->db.hSql[i], szPragma, NULL, NULL, NULL);
+        }
+    }
+}
+
+/*
+* Write staged columnar rows into a table with multi-row INSERT statements.
+* Rows are written in batches of FC_SQLBULK_BATCH rows; any remaining rows are
+* written one at a time. Must be called inside a transaction.
+* -- hSql
+* -- szTable
+* -- szColumns
+* -- cColumn
+* -- cRow
+* -- pqwColumn = columnar rows: [cColumn][FC_SQLBULK_ROWS]
+* -- szText = if set the last column is an offset into szText to bind as text.
+* -- return
+*/
+_Success_(return)
+BOOL Fc_SqlBulkFlushRows(_In_ sqlite3 *hSql, _In_ LPSTR szTable, _In_ LPSTR szColumns, _In_ DWORD cColumn, _In_ DWORD cRow, _In_ PQWORD pqwColumn, _In_opt_ LPSTR szText)
+{
+    int rc = SQLITE_OK;
+    DWORD o, c, r, iRow = 0, cBatch, iBatch;
+    QWORD v;
+    sqlite3_stmt *hStmt;
+    CHAR szSql[0x2000];
+    for(iBatch = 0; iBatch < 2; iBatch++) {
+        cBatch = iBatch ? 1 : FC_SQLBULK_BATCH;
+        if(cRow - iRow < cBatch) { continue; }
+        o = _snprintf_s(szSql, _countof(szSql), _TRUNCATE, "INSERT INTO %s (%s) VALUES ", szTable, szColumns);
+        for(r = 0; r < cBatch; r++) {
+            szSql[o++] = r ? ',' : ' ';
+            szSql[o++] = '(';
+            for(c = 0; c < cColumn; c++) {
+                if(c) { szSql[o++] = ','; }
+                szSql[o++] = '?';
+            }
+            szSql[o++] = ')';
+        }
+        szSql[o++] = ';';
+        szSql[o] = 0;
+        if(SQLITE_OK != sqlite3_prepare_v2(hSql, szSql, -1, &hStmt, NULL)) { return FALSE; }
+        while(cRow - iRow >= cBatch) {
+            sqlite3_reset(hStmt);
+            for(r = 0; r < cBatch; r++, iRow++) {
+                for(c = 0; c < cColumn; c++) {
+                    v = pqwColumn[c * FC_SQLBULK_ROWS + iRow];
+                    if(szText && (c == cColumn - 1)) {
+                        rc = sqlite3_bind_text(hStmt, r * cColumn + c + 1, szText + v, -1, SQLITE_STATIC);
+                    } else {
+                        rc = sqlite3_bind_int64(hStmt, r * cColumn + c + 1, v);
+                    }
+                }
+            }
+            rc = sqlite3_step(hStmt);
+            if(rc != SQLITE_DONE) { break; }
+        }
+        sqlite3_finalize(hStmt);
+        if(rc != SQLITE_DONE) { return FALSE; }
+    }
+    return TRUE;
+}
+
+/*
+* Drain all rows staged in a bulk handle into the database. Only one writer is
+* allowed at a time; the rows are written in a single transaction. On failure
+* the transaction is rolled back and the staged rows are dropped (logged and
+* counted as failed rows).
+* -- hBulk
+* -- return
+*/
+_Success_(return)
+BOOL Fc_SqlBulkFlush(_In_ PFC_SQLBULK hBulk)
+{
+    BOOL fResult = FALSE;
+    sqlite3 *hSql;
+    QWORD tcStart;
+    if(!hBulk->cRow && !hBulk->cStr) { return TRUE; }
+    EnterCriticalSection(&ctxFc->db.LockBulk);
+    tcStart = GetTickCount64();
+    if((hSql = Fc_SqlReserve())) {
+        if(SQLITE_OK != sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL)) {
+            vmmprintf_fn("FAIL BEGIN TRANSACTION: %s\n", sqlite3_errmsg(hSql));
+        } else if(!Fc_SqlBulkFlushRows(hSql, "str", "id, osz, csz, cbu, cbj, sz", 6, hBulk->cStr, (PQWORD)hBulk->pqwStr, hBulk->szStr)) {
+            vmmprintf_fn("FAIL INSERT INTO str: %s\n", sqlite3_errmsg(hSql));
+        } else if(!Fc_SqlBulkFlushRows(hSql, hBulk->szTable, hBulk->szColumns, hBulk->cColumn, hBulk->cRow, hBulk->pqwColumn, NULL)) {
+            vmmprintf_fn("FAIL INSERT INTO %s: %s\n", hBulk->szTable, sqlite3_errmsg(hSql));
+        } else if(SQLITE_OK != sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL)) {
+            vmmprintf_fn("FAIL COMMIT TRANSACTION: %s\n", sqlite3_errmsg(hSql));
+        } else {
+            fResult = TRUE;
+        }
+        if(!fResult && !sqlite3_get_autocommit(hSql)) {
+            sqlite3_exec(hSql, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+        }
+        Fc_SqlReserveReturn(hSql);
+    } else {
+        vmmprintf_fn("FAIL: no database connection - dropping %i %s rows, %i str rows.\n", hBulk->cRow, hBulk->szTable, hBulk->cStr);
+    }
+    if(fResult) {
+        ctxFc->db.Bulk.cRow += hBulk->cRow;
+        ctxFc->db.Bulk.cStr += hBulk->cStr;
+    } else {
+        ctxFc->db.Bulk.cRowFail += hBulk->cRow + hBulk->cStr;
+    }
+    ctxFc->db.Bulk.cFlush++;
+    ctxFc->db.Bulk.msFlush += GetTickCount64() - tcStart;
+    LeaveCriticalSection(&ctxFc->db.LockBulk);
+    hBulk->cRow = 0;
+    hBulk->cStr = 0;
+    hBulk->cbStr = 0;
+    return fResult;
+}
+
+_Success_(return != NULL)
+PFC_SQLBULK Fc_SqlBulkInitialize(_In_ LPSTR szTable, _In_ LPSTR szColumns, _In_ DWORD cColumn)
+{
+    PFC_SQLBULK hBulk;
+    if(!cColumn || (cColumn > FC_SQLBULK_COLUMN_MAX)) { return NULL; }
+    if(!(hBulk = LocalAlloc(0, sizeof(FC_SQLBULK)))) { return NULL; }
+    ZeroMemory(hBulk, sizeof(FC_SQLBULK) - FC_SQLBULK_STRBUFFER);
+    hBulk->szTable = szTable;
+    hBulk->szColumns = szColumns;
+    hBulk->cColumn = cColumn;
+    if(!(hBulk->pqwColumn = LocalAlloc(0, cColumn * FC_SQLBULK_ROWS * sizeof(QWORD)))) {
+        LocalFree(hBulk);
+        return NULL;
+    }
+    return hBulk;
+}
+
+VOID Fc_SqlBulkClose(_In_opt_ PFC_SQLBULK hBulk)
+{
+    if(hBulk) {
+        Fc_SqlBulkFlush(hBulk);
+        LocalFree(hBulk->pqwColumn);
+        LocalFree(hBulk);
+    }
+}
+
+_Success_(return)
+BOOL Fc_SqlBulkAddStr(_In_ PFC_SQLBULK hBulk, _In_ LPWSTR wsz, _In_ DWORD owszSub, _Out_ PFCSQL_INSERTSTRTABLE pThis)
+{
+    LPSTR szUTF8;
+    DWORD cb, cwch;
+    pThis->cwsz = (DWORD)wcslen(wsz);
+    if(pThis->cwsz < owszSub) { return FALSE; }
+    if((hBulk->cStr == FC_SQLBULK_ROWS) || (hBulk->cbStr + FC_SQLBULK_STR_MAX > FC_SQLBULK_STRBUFFER)) {
+        Fc_SqlBulkFlush(hBulk);
+    }
+    // truncate strings longer than FC_SQLBULK_STR_MAX utf-8 bytes (incl. null
+    // terminator) - each removed character shortens the string by 1-3 bytes;
+    // surrogate pairs are never split.
+    cwch = min(pThis->cwsz, FC_SQLBULK_STR_MAX - 1);
+    while(TRUE) {
+        if(cwch && IS_HIGH_SURROGATE(wsz[cwch - 1])) { cwch--; }
+        cb = cwch ? WideCharToMultiByte(CP_UTF8, 0, wsz, cwch, NULL, 0, NULL, NULL) : 0;
+        if(cb < FC_SQLBULK_STR_MAX) { break; }
+        cwch -= max(1, (cb - FC_SQLBULK_STR_MAX + 3) / 3);
+    }
+    szUTF8 = hBulk->szStr + hBulk->cbStr;
+    if(cwch && !WideCharToMultiByte(CP_UTF8, 0, wsz, cwch, szUTF8, FC_SQLBULK_STR_MAX - 1, NULL, NULL)) { return FALSE; }
+    szUTF8[cb] = 0;
+    pThis->cwsz = cwch;
+    owszSub = min(owszSub, cwch);
+    Fc_SqlStrEntry(szUTF8, cb, pThis);
+    hBulk->pqwStr[0][hBulk->cStr] = pThis->id;
+    hBulk->pqwStr[1][hBulk->cStr] = owszSub;
+    hBulk->pqwStr[2][hBulk->cStr] = pThis->cwsz;
+    hBulk->pqwStr[3][hBulk->cStr] = pThis->cbu;
+    hBulk->pqwStr[4][hBulk->cStr] = pThis->cbj;
+    hBulk->pqwStr[5][hBulk->cStr] = hBulk->cbStr;
+    hBulk->cbStr += pThis->cbu + 1;
+    hBulk->cStr++;
+    return TRUE;
+}
+
+VOID Fc_SqlBulkAddRow(_In_ PFC_SQLBULK hBulk, ...)
+{
+    DWORD i;
+    va_list arglist;
+    if(hBulk->cRow == FC_SQLBULK_ROWS) {
+        Fc_SqlBulkFlush(hBulk);
+    }
+    va_start(arglist, hBulk);
+    for(i = 0; i < hBulk->cColumn; i++) {
+        hBulk->pqwColumn[i * FC_SQLBULK_ROWS + hBulk->cRow] = va_arg(arglist, QWORD);
+    }
+    va_end(arglist);
+    hBulk->cRow++;
+}
+
+
+
+#ifdef VMM_TEST_SELFTEST
+// ----------------------------------------------------------------------------
+// SQLITE BULK INGEST SELF TEST BELOW (VMM_TEST_SELFTEST builds only):
+// The 'str' and 'ntfs' rows of a completed forensic database are recorded as a
+// row stream which is replayed into two empty databases: row-by-row with one
+// prepared statement step per row and the indexes in place in one transaction
+// (the previous ingest path) and with the bulk ingest path - ingest pragmas,
+// rows staged in FC_SQLBULK_ROWS columnar buffers and written in one multi-row
+// INSERT transaction per buffer, indexes created at the end. The contents of
+// both replay databases must equal the recorded stream.
+// ----------------------------------------------------------------------------
+
+#define FC_SELFTEST_SQLBULK_NTFS_COLUMNS    "id, id_parent, id_str, hash, hash_parent, addr_phys, inode, mft_flags, depth, size_file, size_fileres, time_create, time_modify, time_read, name_seq, oln_u, oln_j"
+#define FC_SELFTEST_SQLBULK_NTFS_CCOLUMN    17
+#define FC_SELFTEST_SQLBULK_CHECK_STR       "SELECT COUNT(*), SUM(id + osz + csz + cbu + cbj + LENGTH(CAST(sz AS BLOB))) FROM str;"
+#define FC_SELFTEST_SQLBULK_CHECK_NTFS      "SELECT COUNT(*), SUM(id + id_parent + id_str + (hash & 0xffff) + (hash_parent & 0xffff) + addr_phys + inode + mft_flags + depth + size_file + size_fileres + (time_create & 0xffffffff) + name_seq + oln_u + oln_j) FROM ntfs;"
+
+typedef struct tdFC_SELFTEST_SQLBULK_STREAM {
+    QWORD cStr;
+    QWORD cNtfs;
+    PQWORD pqwStr;                  // recorded 'str' rows [cStr][6] - the sz column is an offset into szText.
+    PQWORD pqwNtfs;                 // recorded 'ntfs' rows [cNtfs][FC_SELFTEST_SQLBULK_NTFS_CCOLUMN]
+    LPSTR szText;
+} FC_SELFTEST_SQLBULK_STREAM, *PFC_SELFTEST_SQLBULK_STREAM;
+
+QWORD Fc_SelfTest_TimeUs()
+{
+    QWORD tc, qwFreq;
+    QueryPerformanceFrequency((PLARGE_INTEGER)&qwFreq);
+    QueryPerformanceCounter((PLARGE_INTEGER)&tc);
+    return (tc / qwFreq) * 1000000 + (tc % qwFreq) * 1000000 / qwFreq;
+}
+
+/*
+* Execute a query with up to one numeric argument and retrieve the numeric
+* results of the first row.
+*/
+_Success_(return)
+BOOL Fc_SelfTest_SqlQuery(_In_ sqlite3 *hSql, _In_ LPSTR szSql, _In_ DWORD cArg, _In_ QWORD qwArg, _In_ DWORD cResult, _Out_writes_(cResult) PQWORD pqwResult)
+{
+    BOOL fResult = FALSE;
+    DWORD i;
+    sqlite3_stmt *hStmt = NULL;
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, szSql, -1, &hStmt, NULL)) { goto fail; }
+    if(cArg) { sqlite3_bind_int64(hStmt, 1, qwArg); }
+    if(SQLITE_ROW != sqlite3_step(hStmt)) { goto fail; }
+    for(i = 0; i < cResult; i++) {
+        pqwResult[i] = sqlite3_column_int64(hStmt, i);
+    }
+    fResult = TRUE;
+fail:
+    sqlite3_finalize(hStmt);
+    return fResult;
+}
+
+VOID Fc_SelfTest_SqlBulkStreamFree(_In_ PFC_SELFTEST_SQLBULK_STREAM ps)
+{
+    LocalFree(ps->pqwStr);
+    LocalFree(ps->pqwNtfs);
+    LocalFree(ps->szText);
+    ZeroMemory(ps, sizeof(FC_SELFTEST_SQLBULK_STREAM));
+}
+
+/*
+* Record the first cRowMax 'str' and 'ntfs' rows of the forensic database.
+*/
+_Success_(return)
+BOOL Fc_SelfTest_SqlBulkRecord(_In_ QWORD cRowMax, _Out_ PFC_SELFTEST_SQLBULK_STREAM ps)
+{
+    BOOL fResult = FALSE;
+    DWORD c;
+    QWORD i, cbText = 0, qwSize[2] = { 0 };
+    LPCSTR sz;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    ZeroMemory(ps, sizeof(FC_SELFTEST_SQLBULK_STREAM));
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    if(!Fc_SelfTest_SqlQuery(hSql, "SELECT COUNT(*), CAST(TOTAL(LENGTH(CAST(sz AS BLOB)) + 1) AS INTEGER) FROM (SELECT sz FROM str ORDER BY id LIMIT ?);", 1, cRowMax, 2, qwSize)) { goto fail; }
+    if(!qwSize[0] || !(ps->pqwStr = LocalAlloc(0, qwSize[0] * 6 * sizeof(QWORD)))) { goto fail; }
+    if(!(ps->szText = LocalAlloc(0, qwSize[1] + 1))) { goto fail; }
+    // str:
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "SELECT id, osz, csz, cbu, cbj, sz FROM str ORDER BY id LIMIT ?;", -1, &hStmt, NULL)) { goto fail; }
+    sqlite3_bind_int64(hStmt, 1, cRowMax);
+    for(i = 0; (i < qwSize[0]) && (SQLITE_ROW == sqlite3_step(hStmt)); i++) {
+        for(c = 0; c < 5; c++) {
+            ps->pqwStr[i * 6 + c] = sqlite3_column_int64(hStmt, c);
+        }
+        sz = (LPCSTR)sqlite3_column_text(hStmt, 5);
+        c = sqlite3_column_bytes(hStmt, 5);
+        if(cbText + c + 1 > qwSize[1] + 1) { break; }
+        memcpy(ps->szText + cbText, sz ? sz : "", c);
+        ps->szText[cbText + c] = 0;
+        ps->pqwStr[i * 6 + 5] = cbText;
+        cbText += c + 1;
+    }
+    ps->cStr = i;
+    sqlite3_finalize(hStmt);
+    hStmt = NULL;
+    // ntfs:
+    if(!Fc_SelfTest_SqlQuery(hSql, "SELECT COUNT(*) FROM (SELECT id FROM ntfs LIMIT ?);", 1, cRowMax, 1, qwSize)) { goto fail; }
+    if(qwSize[0] && !(ps->pqwNtfs = LocalAlloc(0, qwSize[0] * FC_SELFTEST_SQLBULK_NTFS_CCOLUMN * sizeof(QWORD)))) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "SELECT " FC_SELFTEST_SQLBULK_NTFS_COLUMNS " FROM ntfs ORDER BY id LIMIT ?;", -1, &hStmt, NULL)) { goto fail; }
+    sqlite3_bind_int64(hStmt, 1, cRowMax);
+    for(i = 0; (i < qwSize[0]) && (SQLITE_ROW == sqlite3_step(hStmt)); i++) {
+        for(c = 0; c < FC_SELFTEST_SQLBULK_NTFS_CCOLUMN; c++) {
+            ps->pqwNtfs[i * FC_SELFTEST_SQLBULK_NTFS_CCOLUMN + c] = sqlite3_column_int64(hStmt, c);
+        }
+    }
+    ps->cNtfs = i;
+    fResult = TRUE;
+fail:
+    sqlite3_finalize(hStmt);
+    Fc_SqlReserveReturn(hSql);
+    if(!fResult) { Fc_SelfTest_SqlBulkStreamFree(ps); }
+    return fResult;
+}
+
+/*
+* Replay the recorded row stream row-by-row: one prepared statement step per
+* row with the indexes in place, all rows in a single transaction.
+*/
+_Success_(return)
+BOOL Fc_SelfTest_SqlBulkReplayRow(_In_ sqlite3 *hSql, _In_ PFC_SELFTEST_SQLBULK_STREAM ps)
+{
+    BOOL fResult = FALSE;
+    DWORD c;
+    QWORD i;
+    sqlite3_stmt *hStmtStr = NULL, *hStmtNtfs = NULL;
+    if(SQLITE_OK != sqlite3_exec(hSql, FC_SQL_INDEX_NTFS, NULL, NULL, NULL)) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO str (id, osz, csz, cbu, cbj, sz) VALUES (?, ?, ?, ?, ?, ?);", -1, &hStmtStr, NULL)) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO ntfs (" FC_SELFTEST_SQLBULK_NTFS_COLUMNS ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);", -1, &hStmtNtfs, NULL)) { goto fail; }
+    if(SQLITE_OK != sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL)) { goto fail; }
+    for(i = 0; i < ps->cStr; i++) {
+        sqlite3_reset(hStmtStr);
+        for(c = 0; c < 5; c++) {
+            sqlite3_bind_int64(hStmtStr, c + 1, ps->pqwStr[i * 6 + c]);
+        }
+        sqlite3_bind_text(hStmtStr, 6, ps->szText + ps->pqwStr[i * 6 + 5], -1, SQLITE_STATIC);
+        if(SQLITE_DONE != sqlite3_step(hStmtStr)) { goto fail; }
+    }
+    for(i = 0; i < ps->cNtfs; i++) {
+        sqlite3_reset(hStmtNtfs);
+        for(c = 0; c < FC_SELFTEST_SQLBULK_NTFS_CCOLUMN; c++) {
+            sqlite3_bind_int64(hStmtNtfs, c + 1, ps->pqwNtfs[i * FC_SELFTEST_SQLBULK_NTFS_CCOLUMN + c]);
+        }
+        if(SQLITE_DONE != sqlite3_step(hStmtNtfs)) { goto fail; }
+    }
+    fResult = (SQLITE_OK == sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL));
+fail:
+    if(!fResult && !sqlite3_get_autocommit(hSql)) {
+        sqlite3_exec(hSql, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+    }
+    sqlite3_finalize(hStmtStr);
+    sqlite3_finalize(hStmtNtfs);
+    return fResult;
+}
+
+/*
+* Replay the recorded row stream with the bulk ingest path: the rows are staged
+* in columnar buffers of FC_SQLBULK_ROWS rows (as by Fc_SqlBulkAddStr and
+* Fc_SqlBulkAddRow) and each full buffer is written by Fc_SqlBulkFlushRows in
+* one transaction. The indexes are created once at the end.
+*/
+_Success_(return)
+BOOL Fc_SelfTest_SqlBulkReplayBulk(_In_ sqlite3 *hSql, _In_ PFC_SELFTEST_SQLBULK_STREAM ps)
+{
+    BOOL fResult = FALSE;
+    DWORD c, r, cStr, cNtfs;
+    QWORD iStr = 0, iNtfs = 0;
+    PQWORD pqwStage = NULL;
+    if(!(pqwStage = LocalAlloc(0, (6 + FC_SELFTEST_SQLBULK_NTFS_CCOLUMN) * FC_SQLBULK_ROWS * sizeof(QWORD)))) { goto fail; }
+    if(SQLITE_OK != sqlite3_exec(hSql, FC_SQL_PRAGMA_INGEST, NULL, NULL, NULL)) { goto fail; }
+    while((iStr < ps->cStr) || (iNtfs < ps->cNtfs)) {
+        cStr = (DWORD)min(FC_SQLBULK_ROWS, ps->cStr - iStr);
+        cNtfs = (DWORD)min(FC_SQLBULK_ROWS, ps->cNtfs - iNtfs);
+        for(r = 0; r < cStr; r++) {
+            for(c = 0; c < 6; c++) {
+                pqwStage[c * FC_SQLBULK_ROWS + r] = ps->pqwStr[(iStr + r) * 6 + c];
+            }
+        }
+        for(r = 0; r < cNtfs; r++) {
+            for(c = 0; c < FC_SELFTEST_SQLBULK_NTFS_CCOLUMN; c++) {
+                pqwStage[(6 + c) * FC_SQLBULK_ROWS + r] = ps->pqwNtfs[(iNtfs + r) * FC_SELFTEST_SQLBULK_NTFS_CCOLUMN + c];
+            }
+        }
+        if(SQLITE_OK != sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL)) { goto fail; }
+        if(!Fc_SqlBulkFlushRows(hSql, "str", "id, osz, csz, cbu, cbj, sz", 6, cStr, pqwStage, ps->szText)) { goto fail; }
+        if(!Fc_SqlBulkFlushRows(hSql, "ntfs", FC_SELFTEST_SQLBULK_NTFS_COLUMNS, FC_SELFTEST_SQLBULK_NTFS_CCOLUMN, cNtfs, pqwStage + 6 * FC_SQLBULK_ROWS, NULL)) { goto fail; }
+        if(SQLITE_OK != sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL)) { goto fail; }
+        iStr += cStr;
+        iNtfs += cNtfs;
+    }
+    fResult = (SQLITE_OK == sqlite3_exec(hSql, FC_SQL_INDEX_NTFS, NULL, NULL, NULL));
+fail:
+    if(!fResult && !sqlite3_get_autocommit(hSql)) {
+        sqlite3_exec(hSql, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+    }
+    LocalFree(pqwStage);
+    return fResult;
+}
+
+/*
+* Record the forensic database row stream and replay it into empty databases
+* row-by-row and with the bulk ingest path. Test builds only (VMM_TEST_SELFTEST).
+* -- cRowMax = max # of rows per table to record, 0 = all.
+* -- pr
+* -- return = TRUE if the stream was recorded (check the replay results).
+*/
+_Success_(return)
+BOOL Fc_SelfTest_SqlBulkReplay(_In_ QWORD cRowMax, _Out_ PFC_SELFTEST_SQLBULK_RESULT pr)
+{
+    DWORD iMode;
+    QWORD tmStart, qwCheck[2];
+    CHAR szPath[MAX_PATH], szTemp[MAX_PATH];
+    sqlite3 *hSql;
+    FC_SELFTEST_SQLBULK_STREAM Stream;
+    ZeroMemory(pr, sizeof(FC_SELFTEST_SQLBULK_RESULT));
+    if(!ctxFc || !ctxFc->fInitFinish) { return FALSE; }
+    if(!Fc_SelfTest_SqlBulkRecord(cRowMax ? cRowMax : (QWORD)-1 >> 1, &Stream)) { return FALSE; }
+    pr->cStr = Stream.cStr;
+    pr->cNtfs = Stream.cNtfs;
+    for(iMode = 0; iMode < 2; iMode++) {
+        if(!GetTempPathA(_countof(szTemp), szTemp)) { break; }
+        _snprintf_s(szPath, _countof(szPath), _TRUNCATE, "%svmm_sqlbulk_replay_%i_%i.sqlite3", szTemp, GetCurrentProcessId(), iMode);
+        DeleteFileA(szPath);
+        if(SQLITE_OK != sqlite3_open_v2(szPath, &hSql, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL)) {
+            sqlite3_close(hSql);
+            continue;
+        }
+        if((SQLITE_OK == sqlite3_exec(hSql, FC_SQL_SCHEMA_STR, NULL, NULL, NULL)) && (SQLITE_OK == sqlite3_exec(hSql, FC_SQL_SCHEMA_NTFS, NULL, NULL, NULL))) {
+            tmStart = Fc_SelfTest_TimeUs();
+            pr->Replay[iMode].fResult = iMode ? Fc_SelfTest_SqlBulkReplayBulk(hSql, &Stream) : Fc_SelfTest_SqlBulkReplayRow(hSql, &Stream);
+            pr->Replay[iMode].tmUs = max(1, Fc_SelfTest_TimeUs() - tmStart);
+            if(Fc_SelfTest_SqlQuery(hSql, FC_SELFTEST_SQLBULK_CHECK_STR, 0, 0, 2, qwCheck)) {
+                pr->Replay[iMode].cStr = qwCheck[0];
+                pr->Replay[iMode].qwCheckStr = qwCheck[1];
+            }
+            if(Fc_SelfTest_SqlQuery(hSql, FC_SELFTEST_SQLBULK_CHECK_NTFS, 0, 0, 2, qwCheck)) {
+                pr->Replay[iMode].cNtfs = qwCheck[0];
+                pr->Replay[iMode].qwCheckNtfs = qwCheck[1];
+            }
+        }
+        sqlite3_close(hSql);
+        DeleteFileA(szPath);
+    }
+    // reference check values of the recorded stream:
+    if((hSql = Fc_SqlReserve())) {
+        if(Fc_SelfTest_SqlQuery(hSql, "SELECT SUM(id + osz + csz + cbu + cbj + LENGTH(CAST(sz AS BLOB))) FROM (SELECT * FROM str ORDER BY id LIMIT ?);", 1, pr->cStr, 1, qwCheck)) {
+            pr->qwCheckStr = qwCheck[0];
+        }
+        if(Fc_SelfTest_SqlQuery(hSql, "SELECT SUM(id + id_parent + id_str + (hash & 0xffff) + (hash_parent & 0xffff) + addr_phys + inode + mft_flags + depth + size_file + size_fileres + (time_create & 0xffffffff) + name_seq + oln_u + oln_j) FROM (SELECT * FROM ntfs ORDER BY id LIMIT ?);", 1, pr->cNtfs, 1, qwCheck)) {
+            pr->qwCheckNtfs = qwCheck[0];
+        }
+        Fc_SqlReserveReturn(hSql);
+    }
+    Fc_SelfTest_SqlBulkStreamFree(&Stream);
+    return TRUE;
+}
+#endif /* VMM_TEST_SELFTEST */
+
+
+
+// ----------------------------------------------------------------------------
+// PRE-RENDERED FILE FUNCTIONALITY BELOW:
+// The timeline and ntfs text files may be very large. Rendering them from the
+// database on each read is expensive since every read requires multiple sql
+// range queries and re-rendering of the text. At the end of the forensic init
+// the files are instead rendered once into memory-mapped files (temporary
+// files or page file backed if the database is in-memory) together with a
+// line offset index (every line start - a line may contain '\n'). A read is
+// then a plain memory copy and the line id at a file position is retrieved
+// with a binary search.
+// ----------------------------------------------------------------------------
+
+VOID FcFile_CloseObCallback(_In_ PVOID pOb)
+{
+    PFCOB_FILE pObFile = (PFCOB_FILE)pOb;
+    if(pObFile->pb) { UnmapViewOfFile(pObFile->pb); }
+    if(pObFile->hMap) { CloseHandle(pObFile->hMap); }
+    if(pObFile->hFile && (pObFile->hFile != INVALID_HANDLE_VALUE)) { CloseHandle(pObFile->hFile); }
+    LocalFree(pObFile->pqwIndex);
+    LocalFree(pObFile->pdwLine);
+}
+
+_Success_(return != NULL)
+PFCOB_FILE FcFile_New(_In_ QWORD cbMax)
+{
+    PFCOB_FILE pObFile;
+    WCHAR wszTempPath[MAX_PATH], wszTempFile[MAX_PATH];
+    if(!(pObFile = Ob_Alloc('Mfil', LMEM_ZEROINIT, sizeof(FCOB_FILE), FcFile_CloseObCallback, NULL))) { return NULL; }
+    pObFile->hFile = INVALID_HANDLE_VALUE;
+    pObFile->cbMax = cbMax;
+    if(!cbMax) { return pObFile; }
+    if(ctxFc->db.tp != FC_DATABASE_TYPE_MEMORY) {
+        if(!GetTempPathW(_countof(wszTempPath), wszTempPath)) { goto fail; }
+        if(!GetTempFileNameW(wszTempPath, L"vmm", 0, wszTempFile)) { goto fail; }
+        pObFile->hFile = CreateFileW(wszTempFile, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+        if(pObFile->hFile == INVALID_HANDLE_VALUE) { goto fail; }
+    }
+    if(!(pObFile->hMap = CreateFileMappingW(pObFile->hFile, NULL, PAGE_READWRITE, (DWORD)(cbMax >> 32), (DWORD)cbMax, NULL))) { goto fail; }
+    if(!(pObFile->pb = MapViewOfFile(pObFile->hMap, FILE_MAP_WRITE, 0, 0, 0))) { goto fail; }
+    return pObFile;
+fail:
+    Ob_DECREF(pObFile);
+    return NULL;
+}
+
+_Success_(return)
+BOOL FcFile_AppendLine(_In_ PFCOB_FILE pObFile, _In_ QWORD qwId, _In_reads_(cbu) LPSTR szu, _In_ DWORD cbu)
+{
+    PQWORD pqwIndex;
+    PDWORD pdwLine;
+    if(pObFile->cb + cbu > pObFile->cbMax) { return FALSE; }
+    if(!pObFile->cLine) {
+        pObFile->qwIdBase = qwId;
+    } else if(qwId != pObFile->qwIdBase + pObFile->cLine) {
+        return FALSE;
+    }
+    if(pObFile->cLine == pObFile->cLineMax) {
+        pObFile->cLineMax = max(0x10000, pObFile->cLineMax * 2);
+        pdwLine = pObFile->pdwLine ?
+            LocalReAlloc(pObFile->pdwLine, pObFile->cLineMax * sizeof(DWORD), LMEM_MOVEABLE) :
+            LocalAlloc(0, pObFile->cLineMax * sizeof(DWORD));
+        if(!pdwLine) { return FALSE; }
+        pObFile->pdwLine = pdwLine;
+    }
+    if(!(pObFile->cLine % FC_FILE_INDEX_STRIDE)) {
+        if(pObFile->cIndex == pObFile->cIndexMax) {
+            pObFile->cIndexMax = max(0x1000, pObFile->cIndexMax * 2);
+            pqwIndex = pObFile->pqwIndex ?
+                LocalReAlloc(pObFile->pqwIndex, pObFile->cIndexMax * sizeof(QWORD), LMEM_MOVEABLE) :
+                LocalAlloc(0, pObFile->cIndexMax * sizeof(QWORD));
+            if(!pqwIndex) { return FALSE; }
+            pObFile->pqwIndex = pqwIndex;
+        }
+        pObFile->pqwIndex[pObFile->cIndex++] = pObFile->cb;
+    }
+    if(pObFile->cb - pObFile->pqwIndex[pObFile->cIndex - 1] > 0xffffffff) { return FALSE; }
+    pObFile->pdwLine[pObFile->cLine] = (DWORD)(pObFile->cb - pObFile->pqwIndex[pObFile->cIndex - 1]);
+    memcpy(pObFile->pb + pObFile->cb, szu, cbu);
+    pObFile->cb += cbu;
+    pObFile->cLine++;
+    return TRUE;
+}
+
+_Success_(return)
+BOOL FcFile_GetIdFromPosition(_In_ PFCOB_FILE pObFile, _In_ QWORD qwFilePos, _Out_ PQWORD pqwId)
+{
+    QWORD iLo = 0, iHi, iMid, iLine, iLineEnd, oBase;
+    if(!pObFile->cLine) { return FALSE; }
+    qwFilePos = min(qwFilePos, pObFile->cb - 1);
+    // 1: binary search for the last index entry at or before qwFilePos.
+    iHi = pObFile->cIndex - 1;
+    while(iLo < iHi) {
+        iMid = (iLo + iHi + 1) >> 1;
+        if(pObFile->pqwIndex[iMid] <= qwFilePos) {
+            iLo = iMid;
+        } else {
+            iHi = iMid - 1;
+        }
+    }
+    // 2: find the last line start at or before qwFilePos among the (at most
+    //    FC_FILE_INDEX_STRIDE) lines of the index entry.
+    iLine = iLo * FC_FILE_INDEX_STRIDE;
+    iLineEnd = min(iLine + FC_FILE_INDEX_STRIDE, pObFile->cLine);
+    oBase = pObFile->pqwIndex[iLo];
+    while((iLine + 1 < iLineEnd) && (oBase + pObFile->pdwLine[iLine + 1] <= qwFilePos)) {
+        iLine++;
+    }
+    *pqwId = pObFile->qwIdBase + iLine;
+    return TRUE;
+}
+
+NTSTATUS FcFile_Read(_In_ PFCOB_FILE pObFile, _Out_writes_to_(cb, *pcbRead) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
+{
+    return Util_VfsReadFile_FromPBYTE(pObFile->pb, pObFile->cb, pb, cb, pcbRead, cbOffset);
+}
+
+
+
 // ----------------------------------------------------------------------------
 // PFN / PAGE HASHING FUNCTIONALITY:
 // ----------------------------------------------------------------------------
@@ -315,17 +1011,21 @@ fail:
 }
 
 /*
-* Analyze a POB_FC_SCANPHYSMEM_CHUNK 16MB memory chunk for MFT file candidates
-* and add any found to the internal data sets. This function is meant to be
-* called asynchronously by a worker thread (VmmWork). This function is thread-safe.
+* Hash the pages of a part of a POB_FC_SCANPHYSMEM_CHUNK 16MB memory chunk and
+* add them together with their PFN information to the database. This function
+* is a physical memory scan consumer callback.
+* NB! the multi hash object is shared - the function is not thread-safe.
+* -- ctxConsumer = PFCPFN_SETUP_CONTEXT
 * -- pc
+* -- iPage
+* -- cPage
 */
-VOID FcPfn_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
+VOID FcPfn_SetupChunk(_In_opt_ PVOID ctxConsumer, _In_ POB_FC_SCANPHYSMEM_CHUNK pc, _In_ DWORD iPage, _In_ DWORD cPage)
 {
-    PFCPFN_SETUP_CONTEXT ctx = (PFCPFN_SETUP_CONTEXT)pc->ctx_PFN;
+    PFCPFN_SETUP_CONTEXT ctx = (PFCPFN_SETUP_CONTEXT)ctxConsumer;
     BCRYPT_MULTI_HASH_OPERATION *pMultiFinishOps, *pMultiHashOps = NULL;
     PBYTE pbMultiHash = NULL;
-    DWORD i, iHash = 0;
+    DWORD i, iHash = 0, iPageEnd = min(FC_PHYSMEM_NUM_CHUNKS, iPage + cPage);
     NTSTATUS nt;
     int rc;
     sqlite3 *hSql = NULL;
@@ -335,7 +1035,7 @@ VOID FcPfn_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
     if(!(pbMultiHash = LocalAlloc(0, 32 * FC_PHYSMEM_NUM_CHUNKS))) { goto fail; }
     if(!(pMultiHashOps = LocalAlloc(0, 2 * FC_PHYSMEM_NUM_CHUNKS * sizeof(BCRYPT_MULTI_HASH_OPERATION)))) { goto fail; }
     pMultiFinishOps = pMultiHashOps + FC_PHYSMEM_NUM_CHUNKS;
-    for(i = 0; i < FC_PHYSMEM_NUM_CHUNKS; i++) {
+    for(i = iPage; i < iPageEnd; i++) {
         if((pc->ppMEMs[i]->qwA != (QWORD)-1) && pc->ppMEMs[i]->f && (pc->ppMEMs[i]->cb == 0x1000)) {
             pMultiHashOps[iHash].iHash = iHash;
             pMultiHashOps[iHash].hashOperation = BCRYPT_OPERATION_TYPE_HASH;
@@ -358,7 +1058,7 @@ VOID FcPfn_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
     rc = sqlite3_prepare_v2(hSql, "INSERT INTO pfn (pfn, tp, tpex, pid, va, hash) VALUES (?, ?, ?, ?, ?, ?);", -1, &hSqlStmt, NULL);
     if(rc != SQLITE_OK) { goto fail; }
     sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
-    for(i = 0; i < pc->pPfnMap->cMap; i++) {
+    for(i = iPage; pc->pPfnMap && (i < min(iPageEnd, pc->pPfnMap->cMap)); i++) {
         pePfn = pc->pPfnMap->pMap + i;
         sqlite3_reset(hSqlStmt);
         sqlite3_bind_int(hSqlStmt, 1, pePfn->dwPfn);
@@ -390,45 +1090,31 @@ fail:
 VOID FcWinReg_Initialize_CallbackAddEntry(_In_ HANDLE hCallback1, _In_ HANDLE hCallback2, _In_ LPWSTR wszPathName, _In_ DWORD owszName, _In_ QWORD vaHive, _In_ DWORD dwCell, _In_ DWORD dwCellParent, _In_ QWORD ftLastWrite)
 {
     FCSQL_INSERTSTRTABLE SqlStrInsert;
-    sqlite3_stmt *hStmt = (sqlite3_stmt*)hCallback1;
-    sqlite3_stmt *hStmtStr = (sqlite3_stmt *)hCallback2;
-    // build and insert string data into 'str' table.
-    if(!Fc_SqlInsertStr(hStmtStr, wszPathName, owszName, &SqlStrInsert)) { return; }
-    // insert into 'process' table.
-    sqlite3_reset(hStmt);
-    Fc_SqlBindMultiInt64(hStmt, 1, 5,
+    PFC_SQLBULK hBulk = (PFC_SQLBULK)hCallback1;
+    // build and stage string data for 'str' table.
+    if(!Fc_SqlBulkAddStr(hBulk, wszPathName, owszName, &SqlStrInsert)) { return; }
+    // stage for 'registry' table.
+    Fc_SqlBulkAddRow(hBulk,
         SqlStrInsert.id,
         vaHive,
         (QWORD)dwCell,
         (QWORD)dwCellParent,
         ftLastWrite
     );
-    sqlite3_step(hStmt);
 }
 
 _Success_(return)
 BOOL FcWinReg_Initialize()
 {
-    BOOL fResult = FALSE;
     POB_REGISTRY_HIVE pObHive = NULL;
-    sqlite3 *hSql = NULL;
-    sqlite3_stmt *hStmt = NULL, *hStmtStr = NULL;
-    if(!(hSql = Fc_SqlReserve())) { goto fail; }
-    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO registry (id_str, hive, cell, cell_parent, time) VALUES (?, ?, ?, ?, ?);", -1, &hStmt, NULL)) { goto fail; }
-    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO str (id, osz, csz, cbu, cbj, sz) VALUES (?, ?, ?, ?, ?, ?);", -1, &hStmtStr, NULL)) { goto fail; }
-    sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    PFC_SQLBULK hBulk;
+    if(!(hBulk = Fc_SqlBulkInitialize("registry", "id_str, hive, cell, cell_parent, time", 5))) { return FALSE; }
     while(pObHive = VmmWinReg_HiveGetNext(pObHive)) {
-        VmmWinReg_ForensicGetAllKeys(pObHive, hStmt, hStmtStr, FcWinReg_Initialize_CallbackAddEntry);
+        VmmWinReg_ForensicGetAllKeys(pObHive, (HANDLE)hBulk, NULL, FcWinReg_Initialize_CallbackAddEntry);
     }
-    sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
+    Fc_SqlBulkClose(hBulk);
     ctxFc->fEnableRegistry = TRUE;
-    fResult = TRUE;
-fail:
-    Ob_DECREF(pObHive);
-    sqlite3_finalize(hStmt);
-    sqlite3_finalize(hStmtStr);
-    Fc_SqlReserveReturn(hSql);
-    return fResult;
+    return TRUE;
 }
 
 
@@ -560,66 +1246,435 @@ BOOL FcThread_Initialize()
 
 
 
+// ----------------------------------------------------------------------------
+// RESUMABLE FORENSIC STORE FUNCTIONALITY BELOW:
+// A static database (FC_DATABASE_TYPE_TEMPFILE_STATIC) is kept resumable. The
+// store records a fingerprint of the dump (size, kernel and sampled pages) and
+// a manifest of completed initialization stages. If the same dump is opened
+// again completed stages are skipped and an interrupted physical memory scan
+// continues from its last checkpoint. Output of an incomplete stage is removed
+// before it's re-run. During ingest the database is in WAL mode so that it is
+// consistent even if the process is killed.
+// ----------------------------------------------------------------------------
+
+/*
+* Calculate the dump fingerprint: SHA256 over the physical memory size, kernel
+* base and build and FC_RESUME_FINGERPRINT_PAGES pages spread evenly over the
+* physical memory (failed reads are zero padded).
+* -- pbFingerprint
+* -- return
+*/
+_Success_(return)
+BOOL FcResume_Fingerprint(_Out_writes_(32) PBYTE pbFingerprint)
+{
+    BOOL fResult;
+    DWORD i, cb;
+    QWORD pa;
+    PBYTE pb;
+    cb = 3 * sizeof(QWORD) + FC_RESUME_FINGERPRINT_PAGES * 0x1000;
+    if(!(pb = LocalAlloc(LMEM_ZEROINIT, cb))) { return FALSE; }
+    *(PQWORD)(pb + 0x00) = ctxMain->dev.paMax;
+    *(PQWORD)(pb + 0x08) = ctxVmm->kernel.vaBase;
+    *(PQWORD)(pb + 0x10) = ctxVmm->kernel.dwVersionBuild;
+    for(i = 0; i < FC_RESUME_FINGERPRINT_PAGES; i++) {
+        pa = (ctxMain->dev.paMax / FC_RESUME_FINGERPRINT_PAGES * i) & ~0xfff;
+        VmmReadEx(NULL, pa, pb + 3 * sizeof(QWORD) + i * 0x1000, 0x1000, NULL, VMM_FLAG_ZEROPAD_ON_FAIL | VMM_FLAG_NOCACHEPUT);
+    }
+    fResult = BCRYPT_SUCCESS(BCryptHash(BCRYPT_SHA256_ALG_HANDLE, NULL, 0, pb, cb, pbFingerprint, 32));
+    LocalFree(pb);
+    return fResult;
+}
+
+/*
+* Retrieve the enable flag of the forensic sub-system belonging to a stage.
+* -- dwStage
+* -- return
+*/
+PBOOL FcResume_StageEnableFlag(_In_ DWORD dwStage)
+{
+    switch(dwStage) {
+        case FC_STAGE_PROCESS:      return &ctxFc->fEnableProcess;
+        case FC_STAGE_THREAD:       return &ctxFc->fEnableThread;
+        case FC_STAGE_REGISTRY:     return &ctxFc->fEnableRegistry;
+        case FC_STAGE_SCANPHYSMEM:  return &ctxFc->fEnableNtfs;
+        default:                    return &ctxFc->fEnableTimeline;
+    }
+}
+
+/*
+* Initialize the database tables. If the database is static the resumable store
+* is opened; if the dump fingerprint matches the existing store the tables are
+* kept as-is for the stages to resume - otherwise the store is re-created.
+*/
+VOID FcResume_Initialize()
+{
+    BOOL fResume = FALSE;
+    BYTE pbFingerprint[32];
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    if((ctxFc->db.tp != FC_DATABASE_TYPE_TEMPFILE_STATIC) || !FcResume_Fingerprint(pbFingerprint)) {
+        Fc_SqlInitializeDatabaseTables();
+        return;
+    }
+    // 1: check for an existing store of the same dump.
+    if(!(hSql = Fc_SqlReserve())) {
+        Fc_SqlInitializeDatabaseTables();
+        return;
+    }
+    if(SQLITE_OK == sqlite3_prepare_v2(hSql, "SELECT fingerprint FROM resume_info WHERE id = 0;", -1, &hStmt, NULL)) {
+        if(SQLITE_ROW == sqlite3_step(hStmt)) {
+            fResume = (sqlite3_column_bytes(hStmt, 0) == 32) && !memcmp(sqlite3_column_blob(hStmt, 0), pbFingerprint, 32);
+        }
+    }
+    sqlite3_finalize(hStmt);
+    hStmt = NULL;
+    hSql = Fc_SqlReserveReturn(hSql);
+    // 2: no match - create tables and a new (empty) store.
+    if(!fResume) {
+        if(!Fc_SqlInitializeDatabaseTables()) { return; }
+        if(SQLITE_OK != Fc_SqlExec(FC_SQL_SCHEMA_RESUME)) { return; }
+        if(!(hSql = Fc_SqlReserve())) { return; }
+        if(SQLITE_OK == sqlite3_prepare_v2(hSql, "INSERT INTO resume_info (id, fingerprint) VALUES (0, ?);", -1, &hStmt, NULL)) {
+            sqlite3_bind_blob(hStmt, 1, pbFingerprint, 32, SQLITE_STATIC);
+            ctxFc->Resume.fEnable = (SQLITE_DONE == sqlite3_step(hStmt));
+        }
+        sqlite3_finalize(hStmt);
+        Fc_SqlReserveReturn(hSql);
+        return;
+    }
+    vmmprintfv("FORENSIC: Resuming forensic database of the same memory dump.\n");
+    ctxFc->Resume.fEnable = TRUE;
+    ctxFc->Resume.fResume = TRUE;
+}
+
+/*
+* Begin an initialization stage. If the stage is already completed in the
+* resumable store its enable flag is restored and it should be skipped.
+* Otherwise the output of any earlier (interrupted) attempt is removed and the
+* stage should be run.
+* -- dwStage = FC_STAGE_*
+* -- szSchema = optional schema which drops/creates the tables of the stage.
+* -- return = TRUE if the stage should be run, FALSE if it should be skipped.
+*/
+BOOL FcResume_StageBegin(_In_ DWORD dwStage, _In_opt_ LPSTR szSchema)
+{
+    DWORD cResult = 0;
+    QWORD qwStage = dwStage, qwResult[4] = { 0 };
+    ctxFc->Resume.paScan = 0;
+    if(!ctxFc->Resume.fEnable) { return TRUE; }
+    if(ctxFc->Resume.fResume && (SQLITE_OK == Fc_SqlQueryN("SELECT fcomplete, fenable, id_str, pa_scan FROM resume_manifest WHERE stage = ?;", 1, &qwStage, 4, qwResult, NULL))) {
+        cResult = 1;
+    }
+    if(cResult && qwResult[0]) {
+        *FcResume_StageEnableFlag(dwStage) = qwResult[1] ? TRUE : FALSE;
+        ctxFc->db.qwIdStr = qwResult[2];
+        ctxFc->Resume.cStageSkip++;
+        vmmprintfv_fn("skip completed stage %i.\n", dwStage);
+        return FALSE;
+    }
+    // first stage to run: remove strings of incomplete stages.
+    if(!ctxFc->Resume.fStrTruncate) {
+        Fc_SqlQueryN("DELETE FROM str WHERE id > ?;", 1, &ctxFc->db.qwIdStr, 0, NULL, NULL);
+        ctxFc->Resume.fStrTruncate = TRUE;
+    }
+    ctxFc->Resume.paScan = cResult ? qwResult[3] : 0;
+    Fc_SqlQueryN("DELETE FROM resume_manifest WHERE stage >= ?;", 1, &qwStage, 0, NULL, NULL);
+    Fc_SqlQueryN("INSERT INTO resume_manifest (stage, fcomplete, fenable, id_str, pa_scan) VALUES (?, 0, 0, ?, ?);", 3, (QWORD[]) { qwStage, ctxFc->db.qwIdStr, ctxFc->Resume.paScan }, 0, NULL, NULL);
+    if(szSchema) {
+        Fc_SqlExec(szSchema);
+    }
+    return TRUE;
+}
+
+/*
+* Mark an initialization stage as completed in the resumable store. A stage
+* which was interrupted by shutdown is not marked as completed.
+* -- dwStage = FC_STAGE_*
+*/
+VOID FcResume_StageEnd(_In_ DWORD dwStage)
+{
+    if(!ctxFc->Resume.fEnable || !ctxVmm->Work.fEnabled) { return; }
+    Fc_SqlQueryN(
+        "UPDATE resume_manifest SET fcomplete = 1, fenable = ?, id_str = ? WHERE stage = ?;",
+        3,
+        (QWORD[]) { (*FcResume_StageEnableFlag(dwStage) ? 1 : 0), ctxFc->db.qwIdStr, dwStage },
+        0, NULL, NULL);
+}
+
+
+
 // ----------------------------------------------------------------------------
 // PHYSICAL MEMORY SCAN FUNCTIONALITY BELOW:
-// Physical memory is scanned and analyzed in parallel. Currently
-// the physical memory consumers are:
-// - PFN / HASH
+// Physical memory is scanned and analyzed in parallel. A single reader thread
+// reads physical memory into a ring of cRing 16MB chunks and stays up to
+// cRing-1 chunks ahead of the slowest consumer. Consumers are registered with
+// FcScanPhysMem_ConsumerRegister. Each chunk is split into a per-consumer # of
+// parts which are analyzed in parallel by the worker threads. Currently the
+// physical memory consumers are:
 // - NTFS MFT ANALYZE
+// - PFN / HASH (currently disabled)
 // ----------------------------------------------------------------------------
 
+/*
+* Retrieve a monotonic timestamp in microseconds.
+*/
+QWORD FcScanPhysMem_TimeUs()
+{
+    QWORD tc, qwFreq;
+    QueryPerformanceFrequency((PLARGE_INTEGER)&qwFreq);
+    QueryPerformanceCounter((PLARGE_INTEGER)&tc);
+    return (tc / qwFreq) * 1000000 + (tc % qwFreq) * 1000000 / qwFreq;
+}
+
+_Success_(return)
+BOOL FcScanPhysMem_ConsumerRegister(_In_ LPSTR szName, _In_opt_ PVOID ctx, _In_ DWORD cSplit, _In_ PFN_FC_SCANPHYSMEM_CONSUMER_CHUNK pfnChunk, _In_opt_ PFN_FC_SCANPHYSMEM_CONSUMER_FINALIZE pfnFinalize, _In_opt_ PFN_FC_SCANPHYSMEM_CONSUMER_CHECKPOINT pfnCheckpoint, _In_opt_ PFN_FC_SCANPHYSMEM_CONSUMER_RESUME pfnResume)
+{
+    PFC_SCANPHYSMEM_CONSUMER pConsumer;
+    if(!cSplit || (cSplit > FC_PHYSMEM_SPLIT_MAX) || !pfnChunk) { return FALSE; }
+    EnterCriticalSection(&ctxFc->Lock);
+    if(ctxFc->ScanPhysMem.cConsumer >= FC_PHYSMEM_CONSUMER_MAX) {
+        LeaveCriticalSection(&ctxFc->Lock);
+        return FALSE;
+    }
+    pConsumer = ctxFc->ScanPhysMem.Consumer + ctxFc->ScanPhysMem.cConsumer;
+    ZeroMemory(pConsumer, sizeof(FC_SCANPHYSMEM_CONSUMER));
+    strncpy_s(pConsumer->szName, _countof(pConsumer->szName), szName, _TRUNCATE);
+    pConsumer->ctx = ctx;
+    pConsumer->cSplit = cSplit;
+    pConsumer->pfnChunk = pfnChunk;
+    pConsumer->pfnFinalize = pfnFinalize;
+    pConsumer->pfnCheckpoint = pfnCheckpoint;
+    pConsumer->pfnResume = pfnResume;
+    ctxFc->ScanPhysMem.cConsumer++;
+    LeaveCriticalSection(&ctxFc->Lock);
+    return TRUE;
+}
+
+_Success_(return)
+BOOL FcScanPhysMem_StatisticsToString(_Out_ LPSTR *pszStatistics, _Out_ PDWORD pcsz)
+{
+    DWORD i, o = 0, cb;
+    LPSTR sz;
+    PFC_SCANPHYSMEM_CONSUMER pConsumer;
+    cb = 0x400 + FC_PHYSMEM_CONSUMER_MAX * 0x100;
+    if(!(sz = LocalAlloc(0, cb))) { return FALSE; }
+    o += snprintf(sz + o, cb - o,
+        "PHYSICAL MEMORY SCAN STATISTICS (DECIMAL)\n" \
+        "=========================================\n" \
+        "STATUS:                   %16s\n" \
+        "RING CHUNKS (16MB):       %16i\n" \
+        "CHUNKS READ:              %16lli\n" \
+        "MB READ:                  %16lli\n" \
+        "READ TIME (MS):           %16lli\n" \
+        "READ MB/S:                %16lli\n" \
+        "READER WAIT (MS):         %16lli\n" \
+        "TOTAL TIME (MS):          %16lli\n" \
+        "TOTAL MB/S:               %16lli\n",
+        ctxFc->ScanPhysMem.fFinish ? "FINISHED" : "RUNNING",
+        ctxFc->ScanPhysMem.cRing,
+        ctxFc->ScanPhysMem.cChunk,
+        ctxFc->ScanPhysMem.cPage >> 8,
+        ctxFc->ScanPhysMem.usRead / 1000,
+        ctxFc->ScanPhysMem.usRead ? ((ctxFc->ScanPhysMem.cPage >> 8) * 1000000 / ctxFc->ScanPhysMem.usRead) : 0,
+        ctxFc->ScanPhysMem.usWait / 1000,
+        ctxFc->ScanPhysMem.usTotal / 1000,
+        ctxFc->ScanPhysMem.usTotal ? ((ctxFc->ScanPhysMem.cPage >> 8) * 1000000 / ctxFc->ScanPhysMem.usTotal) : 0
+    );
+    if(ctxFc->Resume.fEnable) {
+        o += snprintf(sz + o, cb - o,
+            "RESUME STORE:             %16s\n" \
+            "RESUME STAGES SKIPPED:    %16i\n" \
+            "RESUME SCAN START (MB):   %16lli\n" \
+            "RESUME CHECKPOINTS:       %16lli\n",
+            ctxFc->Resume.fResume ? "RESUMED" : "NEW",
+            ctxFc->Resume.cStageSkip,
+            ctxFc->Resume.paScanStart >> 20,
+            ctxFc->Resume.cCheckpoint
+        );
+    }
+    o += snprintf(sz + o, cb - o,
+        "------------------------------------------------------------------------\n" \
+        "CONSUMER           SPLIT        PARTS           MB  THREAD(MS)     MB/S\n" \
+        "------------------------------------------------------------------------\n"
+    );
+    for(i = 0; i < ctxFc->ScanPhysMem.cConsumer; i++) {
+        pConsumer = ctxFc->ScanPhysMem.Consumer + i;
+        o += snprintf(sz + o, cb - o, "%-16s %7i %12lli %12lli %11lli %8lli\n",
+            pConsumer->szName,
+            pConsumer->cSplit,
+            pConsumer->stat.cWork,
+            pConsumer->stat.cPage >> 8,
+            pConsumer->stat.usWork / 1000,
+            pConsumer->stat.usWork ? ((pConsumer->stat.cPage >> 8) * 1000000 / pConsumer->stat.usWork) : 0
+        );
+    }
+    *pszStatistics = sz;
+    *pcsz = o;
+    return TRUE;
+}
+
+/*
+* Worker thread entry point of a single consumer work item - i.e. a part of a
+* physical memory scan chunk to be analyzed by a consumer.
+* -- pw
+*/
+VOID FcScanPhysMem_ConsumerWork_ThreadProc(_In_ PFC_SCANPHYSMEM_WORK pw)
+{
+    QWORD tmStart = FcScanPhysMem_TimeUs();
+    pw->pConsumer->pfnChunk(pw->pConsumer->ctx, pw->pc, pw->iPage, pw->cPage);
+    InterlockedIncrement64(&pw->pConsumer->stat.cWork);
+    InterlockedAdd64(&pw->pConsumer->stat.cPage, pw->cPage);
+    InterlockedAdd64(&pw->pConsumer->stat.usWork, FcScanPhysMem_TimeUs() - tmStart);
+}
+
 VOID FcScanPhysMem_CallbackCleanup_ObChunk(POB_FC_SCANPHYSMEM_CHUNK pOb)
 {
-    for(DWORD i = 0; i < sizeof(pOb->hEventFinish) / sizeof(HANDLE); i++) {
-        if(pOb->hEventFinish[i]) {
-            CloseHandle(pOb->hEventFinish[i]);
+    Ob_DECREF(pOb->pObWorkGroup);
+    Ob_DECREF(pOb->pPfnMap);
+    LcMemFree(pOb->ppMEMs);
+}
+
+/*
+* Prepare the resumable store for the physical memory scan. A new scan clears
+* any saved consumer state while an interrupted scan restores it. If a restore
+* fails the saved state is cleared so that the next run starts over.
+* -- return = physical address to start the scan at, or -1 on fail.
+*/
+QWORD FcScanPhysMem_Resume()
+{
+    BOOL fResult = TRUE;
+    DWORD i;
+    sqlite3 *hSql;
+    PFC_SCANPHYSMEM_CONSUMER pConsumer;
+    QWORD qwStage = FC_STAGE_SCANPHYSMEM;
+    if(!ctxFc->Resume.fEnable) { return 0; }
+    for(i = 0; i < ctxFc->ScanPhysMem.cConsumer; i++) {
+        pConsumer = ctxFc->ScanPhysMem.Consumer + i;
+        if(!pConsumer->pfnCheckpoint || !pConsumer->pfnResume) {
+            ctxFc->Resume.fCheckpointFail = TRUE;
+            ctxFc->Resume.paScan = 0;
         }
     }
-    LcMemFree(pOb->ppMEMs);
+    if(ctxFc->Resume.paScan) {
+        if(!(hSql = Fc_SqlReserve())) { return (QWORD)-1; }
+        for(i = 0; fResult && (i < ctxFc->ScanPhysMem.cConsumer); i++) {
+            pConsumer = ctxFc->ScanPhysMem.Consumer + i;
+            fResult = pConsumer->pfnResume(pConsumer->ctx, hSql, ctxFc->Resume.paScan);
+        }
+        Fc_SqlReserveReturn(hSql);
+        if(fResult) {
+            vmmprintfv_fn("resume physical memory scan at %016llx.\n", ctxFc->Resume.paScan);
+            return ctxFc->Resume.paScan;
+        }
+        vmmprintf_fn("FAIL: unable to resume physical memory scan - restart required.\n");
+    }
+    Fc_SqlExec(FC_SQL_SCHEMA_RESUME_SCAN);
+    Fc_SqlQueryN("UPDATE resume_manifest SET pa_scan = 0 WHERE stage = ?;", 1, &qwStage, 0, NULL, NULL);
+    return fResult ? 0 : (QWORD)-1;
+}
+
+/*
+* Checkpoint the physical memory scan without waiting for the chunks in flight:
+* the scan position saved is the completed-chunk watermark - the base of the
+* oldest chunk in the ring which still has consumer work in flight (chunks no
+* longer in the ring are completed). The consumer states and the watermark are
+* saved in a single transaction. If the checkpoint fails no more checkpoints
+* are taken - a later resume continues from the last successful checkpoint.
+* -- ppc = the scan ring.
+* -- cRing
+* -- paNext = physical address of the next chunk to be scanned.
+*/
+VOID FcScanPhysMem_Checkpoint(_In_reads_(cRing) POB_FC_SCANPHYSMEM_CHUNK *ppc, _In_ DWORD cRing, _In_ QWORD paNext)
+{
+    BOOL fResult;
+    DWORD i;
+    QWORD paCheckpoint = paNext;
+    sqlite3 *hSql;
+    sqlite3_stmt *hStmt = NULL;
+    PFC_SCANPHYSMEM_CONSUMER pConsumer;
+    for(i = 0; i < cRing; i++) {
+        if(ppc[i]->pObWorkGroup->cPending && (ppc[i]->paBase < paCheckpoint)) {
+            paCheckpoint = ppc[i]->paBase;
+        }
+    }
+    if(!ctxVmm->Work.fEnabled) { return; }
+    if(!(hSql = Fc_SqlReserve())) { return; }
+    fResult = (SQLITE_OK == sqlite3_exec(hSql, "BEGIN TRANSACTION", NULL, NULL, NULL));
+    for(i = 0; fResult && (i < ctxFc->ScanPhysMem.cConsumer); i++) {
+        pConsumer = ctxFc->ScanPhysMem.Consumer + i;
+        fResult = pConsumer->pfnCheckpoint(pConsumer->ctx, hSql);
+    }
+    fResult = fResult &&
+        (SQLITE_OK == sqlite3_prepare_v2(hSql, "UPDATE resume_manifest SET pa_scan = ? WHERE stage = "STRINGIZE(FC_STAGE_SCANPHYSMEM)";", -1, &hStmt, NULL)) &&
+        (SQLITE_OK == sqlite3_bind_int64(hStmt, 1, paCheckpoint)) &&
+        (SQLITE_DONE == sqlite3_step(hStmt));
+    sqlite3_finalize(hStmt);
+    if(fResult && (SQLITE_OK == sqlite3_exec(hSql, "COMMIT TRANSACTION", NULL, NULL, NULL))) {
+        ctxFc->Resume.cCheckpoint++;
+    } else {
+        sqlite3_exec(hSql, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+        ctxFc->Resume.fCheckpointFail = TRUE;
+        vmmprintfv_fn("checkpoint at %016llx failed - no further checkpoints.\n", paCheckpoint);
+    }
+    Fc_SqlReserveReturn(hSql);
 }
 
 /*
 * Physical Memory Scan Loop - function is meant to be running in asynchronously
-* with one thread calling only. The function allocates two 16MB chunks and will
-* begin to loop-read physical memory into a chunk, call consumers asynchronously
-* and continue to read next 16MB chunk (if consumers are finished processing).
-* Currently the consumers are:
+* with one thread calling only. The function allocates a ring of 16MB chunks
+* and will loop-read physical memory into the chunks. Once a chunk is read its
+* registered consumers are called asynchronously and the next chunk is read,
+* as long as the consumers of the chunk previously held by the ring slot are
+* finished processing. Currently the consumers are:
 * - NTFS MFT SCAN
-* - SHA256 PAGE HASHING
 */
 VOID FcScanPhysMem()
 {
     BOOL fValidMEMs, fValidAddr, fScanSuccess = FALSE;
-    QWORD i, j, iChunk = 0, pa, paBase;
-    POB_FC_SCANPHYSMEM_CHUNK pc, pObScanChunk[2] = { 0 };
+    QWORD i, iChunk = 0, pa, paBase, paStart, tmStart, tmScanStart;
+    DWORD iConsumer, iSplit, iWork, cPageSplit, cRing;
+    POB_FC_SCANPHYSMEM_CHUNK pc, pObScanChunk[FC_PHYSMEM_RING_MAX] = { 0 };
+    PFC_SCANPHYSMEM_CONSUMER pConsumer;
+    PFC_SCANPHYSMEM_WORK pw;
     PVOID ctx_Pfn = NULL, ctx_Ntfs = NULL;
     PMMPFN_MAP_ENTRY pePfn;
-    // 1: initialize two 16MB physical memory scan chunks
-    for(i = 0; i < 2; i++) {
+    tmScanStart = FcScanPhysMem_TimeUs();
+    // 1: initialize scan consumers
+    ctx_Pfn = FcPfn_Initialize();
+    //FcScanPhysMem_ConsumerRegister("PFN", ctx_Pfn, 1, FcPfn_SetupChunk, NULL, NULL, NULL);
+    if((ctx_Ntfs = FcNtfs_SetupInitialize()) && !FcScanPhysMem_ConsumerRegister("NTFS MFT", ctx_Ntfs, FC_PHYSMEM_SPLIT_MAX / 2, FcNtfs_SetupChunk, FcNtfs_SetupFinalize, FcNtfs_SetupCheckpoint, FcNtfs_SetupResume)) {
+        FcNtfs_SetupFinalize(ctx_Ntfs, FALSE);
+    }
+    // 2: initialize the ring of 16MB physical memory scan chunks
+    cRing = ctxMain->cfg.cForensicScanRing ? min(FC_PHYSMEM_RING_MAX, max(2, ctxMain->cfg.cForensicScanRing)) : FC_PHYSMEM_RING_DEFAULT;
+    ctxFc->ScanPhysMem.cRing = cRing;
+    for(i = 0; i < cRing; i++) {
         if(!(pObScanChunk[i] = Ob_Alloc('FSCN', LMEM_ZEROINIT, sizeof(OB_FC_SCANPHYSMEM_CHUNK), FcScanPhysMem_CallbackCleanup_ObChunk, NULL))) { goto fail; }
         if(!LcAllocScatter1(FC_PHYSMEM_NUM_CHUNKS, &pObScanChunk[i]->ppMEMs)) { goto fail; }
-        for(j = 0; j < FC_PHYSMEMSCAN_CONSUMERS; j++) {
-            if(!(pObScanChunk[i]->hEventFinish[j] = CreateEvent(NULL, TRUE, TRUE, NULL))) { goto fail; }
-        }
-    }
-    // 2: initialize scan consumers
-    ctx_Pfn = FcPfn_Initialize();
-    ctx_Ntfs = FcNtfs_SetupInitialize();
-    for(i = 0; i < 2; i++) {
-        pObScanChunk[i]->ctx_PFN = ctx_Pfn;
-        pObScanChunk[i]->ctx_NTFS = ctx_Ntfs;
+        if(!(pObScanChunk[i]->pObWorkGroup = VmmWorkGroup_New())) { goto fail; }
     }
+    // 2.1: resumable store - restore the consumer states of an interrupted scan
+    if((paStart = FcScanPhysMem_Resume()) == (QWORD)-1) { goto fail; }
+    ctxFc->Resume.paScanStart = paStart;
     // 3: main physical memory scan loop
-    for(paBase = 0; paBase < ctxMain->dev.paMax; paBase += 0x1000 * FC_PHYSMEM_NUM_CHUNKS) {
+    for(paBase = paStart; paBase < ctxMain->dev.paMax; paBase += 0x1000 * FC_PHYSMEM_NUM_CHUNKS) {
         vmmprintfvv_fn("PhysicalAddress=%016llx\n", paBase);
-        // 3.1: get entry and wait for previous consumers to finish
-        pc = pObScanChunk[++iChunk % 2];
-        WaitForMultipleObjects(FC_PHYSMEMSCAN_CONSUMERS, pc->hEventFinish, TRUE, INFINITE);
+        // 3.1: resumable store - checkpoint every FC_RESUME_CHECKPOINT_CHUNKS
+        //      chunks (incl. chunks without valid pages) at the watermark.
+        if(iChunk && !(iChunk % FC_RESUME_CHECKPOINT_CHUNKS) && ctxFc->Resume.fEnable && !ctxFc->Resume.fCheckpointFail) {
+            FcScanPhysMem_Checkpoint(pObScanChunk, cRing, paBase);
+        }
+        // 3.2: get ring entry and wait for the consumers of its previous chunk to finish
+        pc = pObScanChunk[iChunk++ % cRing];
+        tmStart = FcScanPhysMem_TimeUs();
+        VmmWorkGroup_Join(pc->pObWorkGroup);
+        ctxFc->ScanPhysMem.usWait += FcScanPhysMem_TimeUs() - tmStart;
         if(!ctxVmm->Work.fEnabled) { goto fail; }
-        // 3.2: init pfn map
+        pc->paBase = paBase;
+        // 3.3: init pfn map
         Ob_DECREF_NULL(&pc->pPfnMap);
         MmPfn_Map_GetPfn((DWORD)(paBase >> 12), FC_PHYSMEM_NUM_CHUNKS, &pc->pPfnMap, TRUE);
-        // 3.3: init addresses & read
+        // 3.4: init addresses & read
         for(i = 0, fValidMEMs = FALSE; i < FC_PHYSMEM_NUM_CHUNKS; i++) {
             pa = paBase + (i << 12);
             fValidAddr = (pa <= ctxMain->dev.paMax);
@@ -638,42 +1693,50 @@ VOID FcScanPhysMem()
             pc->ppMEMs[i]->f = FALSE;
             fValidMEMs = fValidMEMs || fValidAddr;
         }
-        if(fValidMEMs) {
-            VmmReadScatterPhysical(pc->ppMEMs, FC_PHYSMEM_NUM_CHUNKS, VMM_FLAG_NOCACHEPUT);
-        }
+        if(!fValidMEMs) { continue; }
+        tmStart = FcScanPhysMem_TimeUs();
+        VmmReadScatterPhysical(pc->ppMEMs, FC_PHYSMEM_NUM_CHUNKS, VMM_FLAG_NOCACHEPUT);
+        ctxFc->ScanPhysMem.usRead += FcScanPhysMem_TimeUs() - tmStart;
+        ctxFc->ScanPhysMem.cPage += FC_PHYSMEM_NUM_CHUNKS;
+        ctxFc->ScanPhysMem.cChunk++;
         if(!ctxVmm->Work.fEnabled) { goto fail; }
-        // 3.4: schedule work onto consumers
-        //if(pc->ctx_PFN) {
-        //    ResetEvent(pc->hEventFinish_PFN);
-        //    VmmWork((LPTHREAD_START_ROUTINE)FcPfn_Setup_ThreadProc, pc, pc->hEventFinish_PFN);
-        //}
-        if(pc->ctx_NTFS) {
-            ResetEvent(pc->hEventFinish_NTFS);
-            VmmWork((LPTHREAD_START_ROUTINE)FcNtfs_Setup_ThreadProc, pc, pc->hEventFinish_NTFS);
+        // 3.5: schedule the parts of the chunk onto the consumers
+        for(iConsumer = 0, iWork = 0; iConsumer < ctxFc->ScanPhysMem.cConsumer; iConsumer++) {
+            pConsumer = ctxFc->ScanPhysMem.Consumer + iConsumer;
+            cPageSplit = FC_PHYSMEM_NUM_CHUNKS / pConsumer->cSplit;
+            for(iSplit = 0; iSplit < pConsumer->cSplit; iSplit++) {
+                pw = pc->Work + iWork++;
+                pw->pc = pc;
+                pw->pConsumer = pConsumer;
+                pw->iPage = iSplit * cPageSplit;
+                pw->cPage = (iSplit + 1 == pConsumer->cSplit) ? (FC_PHYSMEM_NUM_CHUNKS - pw->iPage) : cPageSplit;
+                VmmWorkGroup_Add(pc->pObWorkGroup, (LPTHREAD_START_ROUTINE)FcScanPhysMem_ConsumerWork_ThreadProc, pw);
+            }
         }
     }
     // 4: finalize scan consumers
     fScanSuccess = TRUE;
 fail:
     // 5: wait for any worker sub-threads to finish
-    for(i = 0; i < 2; i++) {
-        if(pObScanChunk[i] && pObScanChunk[i]->hEventFinish[FC_PHYSMEMSCAN_CONSUMERS - 1]) {
-            WaitForMultipleObjects(FC_PHYSMEMSCAN_CONSUMERS, pObScanChunk[i]->hEventFinish, TRUE, INFINITE);
+    for(i = 0; i < cRing; i++) {
+        if(pObScanChunk[i] && pObScanChunk[i]->pObWorkGroup) {
+            VmmWorkGroup_Join(pObScanChunk[i]->pObWorkGroup);
         }
     }
     // 6: call work customer finalize functionality
     FcPfn_Finalize(ctx_Pfn, fScanSuccess);
-    FcNtfs_SetupFinalize(ctx_Ntfs, fScanSuccess);
-    // 7: clean up / close
-    for(i = 0; i < 2; i++) {
-        if(!(pc = pObScanChunk[i])) { continue; }
-        for(j = 0; j < FC_PHYSMEMSCAN_CONSUMERS; j++) {
-            if(pc->hEventFinish[j]) {
-                CloseHandle(pc->hEventFinish[j]);
-            }
+    for(iConsumer = 0; iConsumer < ctxFc->ScanPhysMem.cConsumer; iConsumer++) {
+        pConsumer = ctxFc->ScanPhysMem.Consumer + iConsumer;
+        if(pConsumer->pfnFinalize) {
+            pConsumer->pfnFinalize(pConsumer->ctx, fScanSuccess);
         }
-        LcMemFree(pc->ppMEMs);
-        Ob_DECREF(pc->pPfnMap);
+        pConsumer->ctx = NULL;
+    }
+    ctxFc->ScanPhysMem.usTotal = FcScanPhysMem_TimeUs() - tmScanStart;
+    ctxFc->ScanPhysMem.fFinish = TRUE;
+    // 7: clean up / close
+    for(i = 0; i < cRing; i++) {
+        Ob_DECREF_NULL(&pObScanChunk[i]);
     }
 }
 
@@ -688,12 +1751,43 @@ fail:
 */
 VOID FcInitialize_ThreadProc(_In_ PVOID pvContext)
 {
-    Fc_SqlInitializeDatabaseTables();
-    FcProcess_Initialize();
-    FcThread_Initialize();
-    FcWinReg_Initialize();
-    FcScanPhysMem();
-    FcTimeline_Initialize();
+    VmmIoSchedClassSet(VMM_IOSCHED_CLASS_BULK);
+    FcResume_Initialize();
+    Fc_SqlBulkIngestPragma(TRUE);
+    if(FcResume_StageBegin(FC_STAGE_PROCESS, FC_SQL_SCHEMA_PROCESS)) {
+        FcProcess_Initialize();
+        FcResume_StageEnd(FC_STAGE_PROCESS);
+    }
+    if(FcResume_StageBegin(FC_STAGE_THREAD, FC_SQL_SCHEMA_THREAD)) {
+        FcThread_Initialize();
+        FcResume_StageEnd(FC_STAGE_THREAD);
+    }
+    if(FcResume_StageBegin(FC_STAGE_REGISTRY, FC_SQL_SCHEMA_REGISTRY)) {
+        FcWinReg_Initialize();
+        FcResume_StageEnd(FC_STAGE_REGISTRY);
+    }
+    if(FcResume_StageBegin(FC_STAGE_SCANPHYSMEM, FC_SQL_SCHEMA_NTFS)) {
+        FcScanPhysMem();
+        Fc_SqlExec(FC_SQL_INDEX_NTFS);
+        FcResume_StageEnd(FC_STAGE_SCANPHYSMEM);
+    } else {
+        ctxFc->ScanPhysMem.fFinish = TRUE;
+    }
+    if(FcResume_StageBegin(FC_STAGE_TIMELINE, NULL)) {
+        FcTimeline_Initialize();
+        FcResume_StageEnd(FC_STAGE_TIMELINE);
+    } else if(ctxFc->fEnableTimeline) {
+        ctxFc->fEnableTimeline = FcTimeline_InitializeInfo();
+    }
+    Fc_SqlBulkIngestPragma(FALSE);
+    if(ctxFc->Resume.fEnable) {
+        vmmprintfv("FORENSIC: Resumable store: %i stages skipped, %lli scan checkpoints.\n", ctxFc->Resume.cStageSkip, ctxFc->Resume.cCheckpoint);
+    }
+    if(!ctxMain->cfg.fForensicDisableRenderFile) {
+        FcTimeline_RenderFile();
+        FcNtfs_RenderFile();
+    }
+    vmmprintfv("FORENSIC: Bulk ingest: %lli rows, %lli strings, %lli transactions, %lli ms, %lli failed rows.\n", ctxFc->db.Bulk.cRow, ctxFc->db.Bulk.cStr, ctxFc->db.Bulk.cFlush, ctxFc->db.Bulk.msFlush, ctxFc->db.Bulk.cRowFail);
     ctxFc->db.fSingleThread = FALSE;
     ctxFc->fInitFinish = TRUE;
     PluginManager_Notify(VMMDLL_PLUGIN_EVENT_FORENSIC_INIT, NULL, 100);
@@ -719,8 +1813,13 @@ VOID FcClose()
     if(ctxFc->db.tp == FC_DATABASE_TYPE_TEMPFILE_CLOSE) {
         DeleteFileW(ctxFc->db.wszDatabaseWinPath);
     }
+    for(i = 0; ctxFc->Timeline.pInfo && (i < ctxFc->Timeline.cTp); i++) {
+        Ob_DECREF_NULL(&ctxFc->Timeline.pInfo[i].pObFileUTF8);
+    }
+    Ob_DECREF_NULL(&ctxFc->File.pObNtfs);
     LocalFree(ctxFc->Timeline.pInfo);
     LeaveCriticalSection(&ctxFc->Lock);
+    DeleteCriticalSection(&ctxFc->db.LockBulk);
     DeleteCriticalSection(&ctxFc->Lock);
 }
 
@@ -796,6 +1895,7 @@ BOOL FcInitialize_Impl(_In_ DWORD dwDatabaseType, _In_ BOOL fForceReInit)
     if(ctxFc) { FcClose(); }
     if(!(ctxFc = (PFC_CONTEXT)LocalAlloc(LMEM_ZEROINIT, sizeof(FC_CONTEXT)))) { goto fail; }
     InitializeCriticalSection(&ctxFc->Lock);
+    InitializeCriticalSection(&ctxFc->db.LockBulk);
     // 2: SQLITE INIT:
     if(SQLITE_CONFIG_MULTITHREAD != sqlite3_threadsafe()) {
         vmmprintf_fn("CRITICAL: WRONG SQLITE THREADING MODE - TERMINATING!\n");
@@ -20,8 +20,27 @@
 #include "include/sqlite3.h"
 
 #define FC_SQL_POOL_CONNECTION_NUM          4
-#define FC_PHYSMEM_NUM_CHUNKS               0x1000
-#define FC_PHYSMEMSCAN_CONSUMERS            2
+#define FC_PHYSMEM_NUM_CHUNKS               0x1000      // # of 4kB pages in a physical memory scan chunk (16MB)
+#define FC_PHYSMEM_RING_DEFAULT             4           // default # of chunks in the physical memory scan ring
+#define FC_PHYSMEM_RING_MAX                 16          // max # of chunks in the physical memory scan ring
+#define FC_PHYSMEM_CONSUMER_MAX             8           // max # of registered physical memory scan consumers
+#define FC_PHYSMEM_SPLIT_MAX                8           // max # of parts a consumer may split a chunk into
+#define FC_SQLBULK_ROWS                     0x1000      // # of rows staged in a bulk ingest handle before it's flushed
+#define FC_SQLBULK_BATCH                    32          // # of rows per multi-row INSERT statement when flushing
+#define FC_SQLBULK_COLUMN_MAX               24          // max # of columns in a bulk ingest table
+#define FC_SQLBULK_STRBUFFER                0x00100000  // utf-8 'str' staging buffer size of a bulk ingest handle
+#define FC_SQLBULK_STR_MAX                  2048        // max size in bytes of a staged utf-8 string (incl. null terminator)
+#define FC_FILE_INDEX_STRIDE                64          // # of lines per offset index entry in a pre-rendered file
+#define FC_RESUME_CHECKPOINT_CHUNKS         16          // # of physical memory scan chunks between resume checkpoints (256MB)
+#define FC_RESUME_FINGERPRINT_PAGES         16          // # of sampled physical pages in the dump fingerprint
+
+// forensic initialization stages (resumable store manifest).
+#define FC_STAGE_PROCESS                    1
+#define FC_STAGE_THREAD                     2
+#define FC_STAGE_REGISTRY                   3
+#define FC_STAGE_SCANPHYSMEM                4
+#define FC_STAGE_TIMELINE                   5
+#define FC_STAGE_MAX                        5
 
 typedef struct tdFCSQL_INSERTSTRTABLE {
     QWORD id;
@@ -30,6 +49,81 @@ typedef struct tdFCSQL_INSERTSTRTABLE {
     DWORD cbj;      // UTF-8 JSON string count (excl. NULL)
 } FCSQL_INSERTSTRTABLE, *PFCSQL_INSERTSTRTABLE;
 
+// pre-rendered memory-mapped forensic text file with a line offset index. The
+// start of every line is indexed since rendered text may contain '\n' inside
+// a line (registry key names, urls, carved mft names).
+typedef struct tdFCOB_FILE {
+    OB ObHdr;
+    HANDLE hFile;                   // backing temporary file (INVALID_HANDLE_VALUE = page file)
+    HANDLE hMap;
+    PBYTE pb;                       // mapped file view
+    QWORD cb;                       // # bytes rendered
+    QWORD cbMax;                    // # bytes mapped
+    QWORD qwIdBase;                 // id of the first line
+    QWORD cLine;                    // # lines rendered
+    QWORD cIndex;
+    QWORD cIndexMax;
+    PQWORD pqwIndex;                // file offset of each FC_FILE_INDEX_STRIDE'th line
+    QWORD cLineMax;
+    PDWORD pdwLine;                 // per line: offset of the line from its pqwIndex entry
+} FCOB_FILE, *PFCOB_FILE;
+
+struct tdOB_FC_SCANPHYSMEM_CHUNK;
+
+typedef struct tdFC_SQLBULK *PFC_SQLBULK;
+
+/*
+* Physical memory scan consumer callback: analyze the pages [iPage, iPage+cPage)
+* of a scan chunk. The callback is called by worker threads and may be called
+* concurrently for different parts of the same chunk and for different chunks.
+*/
+typedef VOID(*PFN_FC_SCANPHYSMEM_CONSUMER_CHUNK)(_In_opt_ PVOID ctx, _In_ struct tdOB_FC_SCANPHYSMEM_CHUNK *pc, _In_ DWORD iPage, _In_ DWORD cPage);
+
+/*
+* Physical memory scan consumer callback: called once when the scan is done.
+* The consumer should clean up its context.
+*/
+typedef VOID(*PFN_FC_SCANPHYSMEM_CONSUMER_FINALIZE)(_In_opt_ PVOID ctx, _In_ BOOL fScanSuccess);
+
+/*
+* Physical memory scan consumer callback: save the consumer state not already
+* saved to the resumable store. Called inside an open transaction on hSql while
+* chunks may still be in flight. The saved state must contain all results of
+* the chunks completed below the checkpoint watermark; results of later chunks
+* may be included. Return FALSE on failure.
+*/
+typedef BOOL(*PFN_FC_SCANPHYSMEM_CONSUMER_CHECKPOINT)(_In_opt_ PVOID ctx, _In_ sqlite3 *hSql);
+
+/*
+* Physical memory scan consumer callback: restore the consumer state from the
+* resumable store before an interrupted scan continues at paResume. Results at
+* or above paResume must be discarded - they are re-scanned. On failure the
+* state of the consumer must be left untouched.
+*/
+typedef BOOL(*PFN_FC_SCANPHYSMEM_CONSUMER_RESUME)(_In_opt_ PVOID ctx, _In_ sqlite3 *hSql, _In_ QWORD paResume);
+
+typedef struct tdFC_SCANPHYSMEM_CONSUMER {
+    CHAR szName[16];
+    PVOID ctx;                                      // consumer context (must be thread safe)
+    DWORD cSplit;                                   // # of parts each chunk is split into
+    PFN_FC_SCANPHYSMEM_CONSUMER_CHUNK pfnChunk;
+    PFN_FC_SCANPHYSMEM_CONSUMER_FINALIZE pfnFinalize;
+    PFN_FC_SCANPHYSMEM_CONSUMER_CHECKPOINT pfnCheckpoint;
+    PFN_FC_SCANPHYSMEM_CONSUMER_RESUME pfnResume;
+    struct {
+        QWORD cWork;                                // # of chunk parts processed
+        QWORD cPage;                                // # of pages processed
+        QWORD usWork;                               // total worker thread time (us)
+    } stat;
+} FC_SCANPHYSMEM_CONSUMER, *PFC_SCANPHYSMEM_CONSUMER;
+
+typedef struct tdFC_SCANPHYSMEM_WORK {
+    struct tdOB_FC_SCANPHYSMEM_CHUNK *pc;
+    PFC_SCANPHYSMEM_CONSUMER pConsumer;
+    DWORD iPage;
+    DWORD cPage;
+} FC_SCANPHYSMEM_WORK, *PFC_SCANPHYSMEM_WORK;
+
 /*
 * Context struct for communicating between physical memory scan activity and
 * its worker thread consumers which resides in other c-files. This struct is
@@ -40,16 +134,8 @@ typedef struct tdOB_FC_SCANPHYSMEM_CHUNK {
     QWORD paBase;
     PMMPFNOB_MAP pPfnMap;
     PPMEM_SCATTER ppMEMs;
-    union {
-        HANDLE hEventFinish[FC_PHYSMEMSCAN_CONSUMERS];
-        struct {
-            HANDLE hEventFinish_PFN;
-            HANDLE hEventFinish_NTFS;
-        };
-    };
-    // consumer contexts (must be individually thread safe)
-    PVOID ctx_PFN;
-    PVOID ctx_NTFS;
+    PVMMOB_WORK_GROUP pObWorkGroup;     // consumer work items of this chunk
+    FC_SCANPHYSMEM_WORK Work[FC_PHYSMEM_CONSUMER_MAX * FC_PHYSMEM_SPLIT_MAX];
 } OB_FC_SCANPHYSMEM_CHUNK, *POB_FC_SCANPHYSMEM_CHUNK;
 
 typedef struct tdFC_TIMELINE_INFO {
@@ -59,6 +145,7 @@ typedef struct tdFC_TIMELINE_INFO {
     CHAR szNameShort[7];        // 6 chars + NULL
     WCHAR wszNameFileUTF8[32];
     WCHAR wszNameFileJSON[32];
+    PFCOB_FILE pObFileUTF8;     // pre-rendered utf-8 file (if rendered)
 } FC_TIMELINE_INFO, *PFC_TIMELINE_INFO;
 
 typedef struct tdFC_CONTEXT {
@@ -79,11 +166,43 @@ typedef struct tdFC_CONTEXT {
         HANDLE hEvent[FC_SQL_POOL_CONNECTION_NUM];
         sqlite3 *hSql[FC_SQL_POOL_CONNECTION_NUM];
         QWORD qwIdStr;
+        CRITICAL_SECTION LockBulk;          // single writer lock for bulk ingest flushes
+        struct {
+            QWORD cRow;                     // # table rows ingested
+            QWORD cStr;                     // # 'str' rows ingested
+            QWORD cFlush;                   // # flushes (transactions)
+            QWORD msFlush;                  // time (ms) spent flushing
+            QWORD cRowFail;                 // # table + 'str' rows dropped by failed flushes
+        } Bulk;
     } db;
     struct {
         DWORD cTp;
         PFC_TIMELINE_INFO pInfo;    // array of cTp items
     } Timeline;
+    struct {
+        PFCOB_FILE pObNtfs;         // pre-rendered ntfs_files.txt (if rendered)
+    } File;
+    struct {
+        BOOL fFinish;
+        DWORD cRing;                        // # of chunks in the scan ring
+        DWORD cConsumer;
+        FC_SCANPHYSMEM_CONSUMER Consumer[FC_PHYSMEM_CONSUMER_MAX];
+        QWORD cChunk;                       // # of chunks read
+        QWORD cPage;                        // # of pages read
+        QWORD usRead;                       // time (us) spent reading
+        QWORD usWait;                       // time (us) the reader waited for consumers
+        QWORD usTotal;                      // total scan time (us)
+    } ScanPhysMem;
+    struct {
+        BOOL fEnable;                       // resumable store active (FC_DATABASE_TYPE_TEMPFILE_STATIC)
+        BOOL fResume;                       // dump fingerprint matched an existing store
+        BOOL fStrTruncate;                  // 'str' rows of incomplete stages removed
+        BOOL fCheckpointFail;               // checkpoint failed - no further checkpoints this run
+        DWORD cStageSkip;                   // # of completed stages skipped
+        QWORD paScan;                       // physical address to resume the scan from
+        QWORD paScanStart;                  // physical address the scan of this run started at
+        QWORD cCheckpoint;                  // # of scan checkpoints committed
+    } Resume;
 } FC_CONTEXT, *PFC_CONTEXT;
 
 
@@ -122,6 +241,41 @@ VOID FcClose();
 
 
 
+// ----------------------------------------------------------------------------
+// FC PHYSICAL MEMORY SCAN FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+/*
+* Register a physical memory scan consumer. Each chunk read by the physical
+* memory scan is split into cSplit parts which are analyzed in parallel by the
+* worker threads. Consumers must be registered before the physical memory scan
+* starts. If the registration is successful the finalize callback is always
+* called exactly once. An interrupted scan can only be resumed if all consumers
+* supply both the checkpoint and the resume callbacks.
+* -- szName = short name shown in the scan statistics.
+* -- ctx = consumer context passed to the callbacks.
+* -- cSplit = # of parts to split each chunk into [1..FC_PHYSMEM_SPLIT_MAX].
+* -- pfnChunk
+* -- pfnFinalize
+* -- pfnCheckpoint
+* -- pfnResume
+* -- return
+*/
+_Success_(return)
+BOOL FcScanPhysMem_ConsumerRegister(_In_ LPSTR szName, _In_opt_ PVOID ctx, _In_ DWORD cSplit, _In_ PFN_FC_SCANPHYSMEM_CONSUMER_CHUNK pfnChunk, _In_opt_ PFN_FC_SCANPHYSMEM_CONSUMER_FINALIZE pfnFinalize, _In_opt_ PFN_FC_SCANPHYSMEM_CONSUMER_CHECKPOINT pfnCheckpoint, _In_opt_ PFN_FC_SCANPHYSMEM_CONSUMER_RESUME pfnResume);
+
+/*
+* Retrieve physical memory scan statistics as a human readable text.
+* CALLER LocalFree: *pszStatistics
+* -- pszStatistics
+* -- pcsz
+* -- return
+*/
+_Success_(return)
+BOOL FcScanPhysMem_StatisticsToString(_Out_ LPSTR *pszStatistics, _Out_ PDWORD pcsz);
+
+
+
 // ----------------------------------------------------------------------------
 // FC DATABASE FUNCTIONALITY BELOW:
 // ----------------------------------------------------------------------------
@@ -208,6 +362,101 @@ int Fc_SqlBindMultiInt64(
     ...
 );
 
+/*
+* Create a bulk ingest handle for a table. Rows added to the handle are staged
+* in memory private to the handle and written to the database in large
+* transactions. A handle must only be used by one thread at a time, use one
+* handle per producer thread. All rows are written when the handle is closed.
+* CALLER Fc_SqlBulkClose: return
+* -- szTable = table name (must remain valid for the lifetime of the handle).
+* -- szColumns = comma separated list of the integer columns to insert into.
+* -- cColumn = # of columns in szColumns [1..FC_SQLBULK_COLUMN_MAX].
+* -- return = the bulk ingest handle, or NULL on fail.
+*/
+_Success_(return != NULL)
+PFC_SQLBULK Fc_SqlBulkInitialize(_In_ LPSTR szTable, _In_ LPSTR szColumns, _In_ DWORD cColumn);
+
+/*
+* Flush any remaining staged rows and close a bulk ingest handle.
+* -- hBulk
+*/
+VOID Fc_SqlBulkClose(_In_opt_ PFC_SQLBULK hBulk);
+
+/*
+* Stage a string for insertion into the database 'str' table. The resulting
+* string id is returned in pThis->id and is valid immediately. Strings longer
+* than FC_SQLBULK_STR_MAX utf-8 bytes are truncated.
+* -- hBulk
+* -- wsz
+* -- owszSub = sub-offset to 2'nd string at the end of wsz (if any).
+* -- pThis
+* -- return
+*/
+_Success_(return)
+BOOL Fc_SqlBulkAddStr(
+    _In_ PFC_SQLBULK hBulk,
+    _In_ LPWSTR wsz,
+    _In_ DWORD owszSub,
+    _Out_ PFCSQL_INSERTSTRTABLE pThis
+);
+
+/*
+* Stage a single row for insertion into the bulk handle table.
+* NB! 32-bit DWORDs must be casted to 64-bit QWORD to avoid padding of
+* 0xcccccccc in the high-part.
+* -- hBulk
+* -- ... = vararg of cColumn QWORDs (as given in Fc_SqlBulkInitialize).
+*/
+VOID Fc_SqlBulkAddRow(_In_ PFC_SQLBULK hBulk, ...);
+
+
+
+// ----------------------------------------------------------------------------
+// FC PRE-RENDERED FILE FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
+
+/*
+* Create a new empty pre-rendered file object with room for cbMax bytes.
+* CALLER DECREF: return
+* -- cbMax = max file size; the file may be rendered to a smaller size.
+* -- return
+*/
+_Success_(return != NULL)
+PFCOB_FILE FcFile_New(_In_ QWORD cbMax);
+
+/*
+* Append a single line (including its trailing newline) to a pre-rendered
+* file. Lines must be appended in id order starting at the base id.
+* -- pObFile
+* -- qwId = the id of the line.
+* -- szu = the line to append.
+* -- cbu = the byte count of szu.
+* -- return
+*/
+_Success_(return)
+BOOL FcFile_AppendLine(_In_ PFCOB_FILE pObFile, _In_ QWORD qwId, _In_reads_(cbu) LPSTR szu, _In_ DWORD cbu);
+
+/*
+* Retrieve the id of the line at a given position in a pre-rendered file.
+* -- pObFile
+* -- qwFilePos
+* -- pqwId
+* -- return
+*/
+_Success_(return)
+BOOL FcFile_GetIdFromPosition(_In_ PFCOB_FILE pObFile, _In_ QWORD qwFilePos, _Out_ PQWORD pqwId);
+
+/*
+* Read from a pre-rendered file.
+* -- pObFile
+* -- pb
+* -- cb
+* -- pcbRead
+* -- cbOffset
+* -- return
+*/
+NTSTATUS FcFile_Read(_In_ PFCOB_FILE pObFile, _Out_writes_to_(cb, *pcbRead) PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset);
+
 
 
 // ----------------------------------------------------------------------------
@@ -287,6 +536,45 @@ BOOL FcTimeline_GetIdFromPosition(
     _Out_ PQWORD pqwId
 );
 
+/*
+* Render a single utf-8 timeline file line (including trailing newline).
+* -- pe
+* -- szu
+* -- cszu
+* -- return = the number of bytes written.
+*/
+DWORD FcTimeline_FormatLineUTF8(
+    _In_ PFC_MAP_TIMELINEENTRY pe,
+    _Out_writes_(cszu) LPSTR szu,
+    _In_ DWORD cszu
+);
+
+#ifdef VMM_TEST_SELFTEST
+typedef struct tdFCTIMELINE_SELFTEST_RESULT {
+    DWORD cEvent;                   // # synthetic timeline events
+    DWORD cTp;                      // # timeline types
+    QWORD cbSpill;                  // spill file size of the sort build
+    struct {
+        BOOL fResult;
+        QWORD cRow;
+        QWORD tmMs;
+    } Build[2];                     // external merge sort, window-function sql
+    QWORD cRowMismatch;             // # rows which differ between the builds
+    DWORD cFileSizeMismatch;        // # timeline types with differing file sizes
+} FCTIMELINE_SELFTEST_RESULT, *PFCTIMELINE_SELFTEST_RESULT;
+
+/*
+* Run the timeline build self test: build a synthetic timeline with the
+* external merge sort and with the window-function SQL and compare the results.
+* Requires a completed forensic database. Test builds only (VMM_TEST_SELFTEST).
+* -- cEvent = # of synthetic timeline events, 0 = default (50M).
+* -- pr
+* -- return = TRUE if the synthetic input was created (check the result).
+*/
+_Success_(return)
+BOOL FcTimeline_SelfTest_Build(_In_ DWORD cEvent, _Out_ PFCTIMELINE_SELFTEST_RESULT pr);
+#endif /* VMM_TEST_SELFTEST */
+
 
 
 // ----------------------------------------------------------------------------
@@ -409,4 +697,111 @@ BOOL FcNtfs_GetIdFromPosition(
     _Out_ PQWORD pqwId
 );
 
+/*
+* Render a single utf-8 ntfs_files.txt line (including trailing newline).
+* -- pe
+* -- szu
+* -- cszu
+* -- return = the number of bytes written.
+*/
+DWORD FcNtfs_FormatLineUTF8(
+    _In_ PFC_MAP_NTFSENTRY pe,
+    _Out_writes_(cszu) LPSTR szu,
+    _In_ DWORD cszu
+);
+
+#ifdef VMM_TEST_SELFTEST
+typedef struct tdFCNTFS_SELFTEST_RESULT {
+    DWORD cPage;                    // # pages of the synthetic image
+    DWORD cRecordExpect;            // # valid records planted in readable pages
+    DWORD cTornExpect;              // # torn records planted
+    DWORD cIterScan;
+    struct {
+        CHAR szName[8];
+        BOOL fAvailable;
+        BOOL fSelected;             // selected at runtime for this cpu
+        DWORD cMaskMismatch;
+        QWORD tmUs;                 // time of cIterScan scans of the image
+    } Scan[3];                      // scalar, sse2, avx2
+    struct {
+        DWORD cCarved;
+        DWORD cMissing;
+        DWORD cFalse;
+        DWORD cFieldMismatch;
+        DWORD cTorn;
+        DWORD cEntry;               // # entries after merge
+        DWORD cFs;                  // # file system fragments after merge
+        QWORD tmUs;
+    } Carve[2];                     // single-threaded, multi-threaded
+    DWORD cMismatchText;
+    DWORD cchMismatch;
+    CHAR szMismatch[0x1000];        // the first mismatches.
+} FCNTFS_SELFTEST_RESULT, *PFCNTFS_SELFTEST_RESULT;
+
+/*
+* Run the MFT record carving self test on a synthetic 16MB image with known
+* valid and invalid MFT records. Test builds only (VMM_TEST_SELFTEST).
+* -- cIterScan = # of signature scan benchmark iterations, 0 = default.
+* -- pr
+* -- return = TRUE if the test ran (check the mismatch counters).
+*/
+_Success_(return)
+BOOL FcNtfs_SelfTest_Carving(_In_ DWORD cIterScan, _Out_ PFCNTFS_SELFTEST_RESULT pr);
+
+typedef struct tdFCNTFS_SELFTEST_FINALIZE_RESULT {
+    DWORD cVolume;                  // # synthetic volumes
+    DWORD cRecord;                  // # synthetic MFT records (incl. duplicate copies)
+    DWORD cPage;                    // # pages (file system fragments)
+    DWORD cRun;
+    DWORD cDepthMax;
+    DWORD cNameCollision;           // # entries with a bumped name sequence number
+    struct {
+        BOOL fResult;
+        DWORD cRow;                 // # finalized entries
+        DWORD cRowMismatch;         // # entries which differ from the sequential reference
+        QWORD tmUs;
+    } Run[4];                       // sequential reference, parallel x 3
+    DWORD cMismatchText;
+    DWORD cchMismatch;
+    CHAR szMismatch[0x1000];        // the first mismatches.
+} FCNTFS_SELFTEST_FINALIZE_RESULT, *PFCNTFS_SELFTEST_FINALIZE_RESULT;
+
+/*
+* Run the MFT tree reconstruction self test: finalize synthetic MFT record sets
+* of multiple volumes with the sequential reference and the parallel algorithm
+* and compare the finalized entries. Test builds only (VMM_TEST_SELFTEST).
+* -- cVolume = # of synthetic volumes, 0 = default.
+* -- pr
+* -- return = TRUE if the test ran (check the mismatch counters).
+*/
+_Success_(return)
+BOOL FcNtfs_SelfTest_Finalize(_In_ DWORD cVolume, _Out_ PFCNTFS_SELFTEST_FINALIZE_RESULT pr);
+
+typedef struct tdFC_SELFTEST_SQLBULK_RESULT {
+    QWORD cStr;                     // # recorded 'str' rows
+    QWORD cNtfs;                    // # recorded 'ntfs' rows
+    QWORD qwCheckStr;               // check value of the recorded 'str' rows
+    QWORD qwCheckNtfs;              // check value of the recorded 'ntfs' rows
+    struct {
+        BOOL fResult;
+        QWORD tmUs;
+        QWORD cStr;
+        QWORD cNtfs;
+        QWORD qwCheckStr;
+        QWORD qwCheckNtfs;
+    } Replay[2];                    // row-by-row, bulk
+} FC_SELFTEST_SQLBULK_RESULT, *PFC_SELFTEST_SQLBULK_RESULT;
+
+/*
+* Record the 'str' and 'ntfs' row stream of the completed forensic database and
+* replay it into empty databases row-by-row and with the bulk ingest path.
+* Test builds only (VMM_TEST_SELFTEST).
+* -- cRowMax = max # of rows per table to record, 0 = all.
+* -- pr
+* -- return = TRUE if the stream was recorded (check the replay results).
+*/
+_Success_(return)
+BOOL Fc_SelfTest_SqlBulkReplay(_In_ QWORD cRowMax, _Out_ PFC_SELFTEST_SQLBULK_RESULT pr);
+#endif /* VMM_TEST_SELFTEST */
+
 #endif /* __FC_H__ */
@@ -12,6 +12,8 @@
 #include "mm_pfn.h"
 #include "pluginmanager.h"
 #include "util.h"
+#include <intrin.h>
+#include <immintrin.h>
 
 //-----------------------------------------------------------------------------
 // NTFS MFT WINDOWS DEFINES AND TYPEDEFS BELOW:
@@ -183,10 +185,44 @@ typedef struct tdFCNTFS_COUNTX {
     int c;
 } FCNTFS_COUNTX, *PFCNTFS_COUNTX;
 
-#define NTFS_LAST_VA_MAX    0x40
+#define NTFS_LAST_VA_MAX            0x40
+#define FCNTFS_SETUP_BLOCK_SIZE     0x10000
+
+// parsed (but not yet committed) MFT record - variable length, 8-byte aligned.
+typedef struct tdFCNTFS_SETUP_RECORD {
+    QWORD pa;
+    QWORD va;
+    QWORD qwLogFileSequenceNumber;
+    QWORD ftCreate;
+    QWORD ftModify;
+    QWORD ftRead;
+    QWORD cbFileSize;
+    DWORD dwMftRecordNumber;
+    DWORD dwIdParent;
+    WORD cbFileSizeMftResident;
+    WORD Flags;
+    WORD cwszName;
+    WCHAR wszName[0];
+} FCNTFS_SETUP_RECORD, *PFCNTFS_SETUP_RECORD;
+
+// block of parsed MFT records produced by a single scan worker.
+typedef struct tdFCNTFS_SETUP_BLOCK {
+    struct tdFCNTFS_SETUP_BLOCK *FLink;
+    DWORD cRecord;
+    DWORD cbUsed;
+    BYTE pb[FCNTFS_SETUP_BLOCK_SIZE];
+} FCNTFS_SETUP_BLOCK, *PFCNTFS_SETUP_BLOCK;
+
+typedef VOID(*PFCNTFS_SETUP_SCAN_PFN)(_In_ POB_FC_SCANPHYSMEM_CHUNK pc, _In_ DWORD iPage, _In_ DWORD cPage, _Out_writes_(cPage) PBYTE pbMask);
 
 typedef struct tdFCNTFS_SETUP_CONTEXT {
     CRITICAL_SECTION LockUpdate;
+    PFCNTFS_SETUP_SCAN_PFN pfnScan;             // MFT record signature scan implementation (scalar/sse2/avx2).
+    PFCNTFS_SETUP_BLOCK pBlockHead;             // parsed MFT records not yet committed [LockUpdate].
+    PFCNTFS_SETUP_BLOCK pBlockCheckpoint;       // first block saved to the resumable store (blocks before it are not).
+    BOOL fCheckpointRewrite;                    // resumed (filtered) blocks - next checkpoint rewrites the saved records.
+    volatile LONG cCandidate;
+    volatile LONG cTorn;
     POB_MAP pmId;                               // map of: [MftRecordId+InternalSeqId]->[PFCNTFS]
     POB_MAP pmFs;                               // map of: [IdFs]->[PFCNTFS_CONTEXT_IDFS_LISTENTRY]
     DWORD iLastVa;
@@ -196,6 +232,12 @@ typedef struct tdFCNTFS_SETUP_CONTEXT {
     // below used in finalize:
     PPFCNTFS_CONTEXT_IDFS_LISTENTRY ppListsSorted;
     PFCNTFS_CONTEXT_COUNTER pListsCounter;
+    PDWORD pdwListsCounterTouched;              // idfs with non-zero pListsCounter (sparse reset/scan in MergeFind).
+    volatile LONG iListsCompact;                // parallel compaction work index (decremented as-goes).
+#ifdef VMM_TEST_SELFTEST
+    BOOL fFinalizeSequential;                   // finalize with the previous sequential algorithm (self test reference).
+    struct tdFCNTFS_SELFTEST_FINALIZE *pSelfTestFinalize;   // collect finalized entries instead of adding them to the database.
+#endif /* VMM_TEST_SELFTEST */
 } FCNTFS_SETUP_CONTEXT, *PFCNTFS_SETUP_CONTEXT;
 
 
@@ -215,19 +257,27 @@ typedef struct tdFCNTFS_SETUP_CONTEXT {
 //     working at the moment and provides the functionality needed.
 //-----------------------------------------------------------------------------
 
+PFCNTFS_SETUP_SCAN_PFN FcNtfs_SetupScan_Select();
+
 /*
 * Close and clean up PFCNTFS_SETUP_CONTEXT.
 * -- ctx
 */
 VOID FcNtfs_SetupClose(_Frees_ptr_opt_ PFCNTFS_SETUP_CONTEXT ctx)
 {
+    PFCNTFS_SETUP_BLOCK pBlock;
     // TODO: CHECK REMAINING REFERENCE COUNTS !!!
     if(ctx) {
         DeleteCriticalSection(&ctx->LockUpdate);
+        while((pBlock = ctx->pBlockHead)) {
+            ctx->pBlockHead = pBlock->FLink;
+            LocalFree(pBlock);
+        }
         Ob_DECREF(ctx->pmId);
         Ob_DECREF(ctx->pmFs);
         LocalFree(ctx->ppListsSorted);
         LocalFree(ctx->pListsCounter);
+        LocalFree(ctx->pdwListsCounterTouched);
         LocalFree(ctx);
     }
 }
@@ -243,6 +293,7 @@ PVOID FcNtfs_SetupInitialize()
     InitializeCriticalSection(&ctx->LockUpdate);
     if(!(ctx->pmId = ObMap_New(OB_MAP_FLAGS_OBJECT_LOCALFREE))) { goto fail; }
     if(!(ctx->pmFs = ObMap_New(OB_MAP_FLAGS_OBJECT_LOCALFREE))) { goto fail; }
+    ctx->pfnScan = FcNtfs_SetupScan_Select();
     return ctx;
 fail:
     FcNtfs_SetupClose(ctx);
@@ -296,21 +347,68 @@ PFCNTFS FcNtfs_SetupCreateEntry(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ DWORD dwIdM
 }
 
 /*
-* Try add a single MFT entry to the NTFS MFT dataset.
+* Link a block of parsed MFT records into the setup context.
+* -- ctx
+* -- pBlock
+*/
+VOID FcNtfs_SetupBlockCommit(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ PFCNTFS_SETUP_BLOCK pBlock)
+{
+    EnterCriticalSection(&ctx->LockUpdate);
+    pBlock->FLink = ctx->pBlockHead;
+    ctx->pBlockHead = pBlock;
+    LeaveCriticalSection(&ctx->LockUpdate);
+}
+
+/*
+* Validate the update sequence array of a 1kB MFT record and apply its fixups.
+* Records in the on-disk (protected) form carry the update sequence number at
+* the end of each 512-byte sector; these are replaced with the saved values.
+* Records where no sector carries the update sequence number are assumed to be
+* in the unprotected (in-memory) form and are accepted as-is. Records with a
+* partial match are torn and are rejected. Only the sectors within the first
+* 1kB are validated (4kB records are analyzed as 1kB records).
+* -- pb = record buffer (modified in place).
+* -- return
+*/
+_Success_(return)
+BOOL FcNtfs_SetupRecordFixup(_Inout_updates_(0x400) PBYTE pb)
+{
+    PNTFS_FILE_RECORD pr = (PNTFS_FILE_RECORD)pb;
+    DWORD i, cSector, cMatch = 0;
+    PWORD pwUsa;
+    if((pr->UpdateSequenceArrayOffset & 1) || (pr->UpdateSequenceArrayOffset < 0x28) || !pr->UpdateSequenceArraySize) { return FALSE; }
+    if(pr->UpdateSequenceArrayOffset + pr->UpdateSequenceArraySize * sizeof(WORD) > 0x400) { return FALSE; }
+    pwUsa = (PWORD)(pb + pr->UpdateSequenceArrayOffset);
+    cSector = min(2, pr->UpdateSequenceArraySize - 1);
+    for(i = 1; i <= cSector; i++) {
+        if(*(PWORD)(pb + i * 0x200 - 2) == pwUsa[0]) { cMatch++; }
+    }
+    if(!cMatch) { return TRUE; }
+    if(cMatch != cSector) { return FALSE; }
+    for(i = 1; i <= cSector; i++) {
+        *(PWORD)(pb + i * 0x200 - 2) = pwUsa[i];
+    }
+    return TRUE;
+}
+
+/*
+* Parse a single fixed-up MFT record and append the result to a setup record
+* block. No shared state is touched - the function may be called in parallel.
+* If the block is full it's linked into the context and a new one is allocated.
 * -- ctx
+* -- ppBlock = the block of the calling worker (updated if replaced).
 * -- qwPhysicalAddress
 * -- qwVirtualAddress
 * -- pb
 */
-VOID FcNtfs_SetupMftEntry(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD qwPhysicalAddress, _In_opt_ QWORD qwVirtualAddress, _In_reads_(0x400) PBYTE pb)
+VOID FcNtfs_SetupRecordParse(_In_ PFCNTFS_SETUP_CONTEXT ctx, _Inout_ PFCNTFS_SETUP_BLOCK *ppBlock, _In_ QWORD qwPhysicalAddress, _In_opt_ QWORD qwVirtualAddress, _In_reads_(0x400) PBYTE pb)
 {
-    DWORD i, oA, dwIdFs, cbData = 0;
+    DWORD oA, cbRecord, cbData = 0;
     PNTFS_FILE_RECORD pr;
     PNTFS_ATTR pa;
     PNTFS_FILE_NAME pfnC, pfn = NULL;
     PNTFS_STANDARD_INFORMATION psi = NULL;
-    PFCNTFS pNtfs = NULL, pNtfs_IdColl = NULL;
-    PFCNTFS_CONTEXT_IDFS_LISTENTRY pFsList;
+    PFCNTFS_SETUP_RECORD pe;
     pr = (PNTFS_FILE_RECORD)pb;
     // Check MFT record number is within the correct location inside the page.
     if((((qwPhysicalAddress >> 10) & 0x3) != (0x3 & pr->MftRecordNumber)) || (pr->MftRecordNumber == 0)) { return; }
@@ -339,26 +437,67 @@ VOID FcNtfs_SetupMftEntry(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD qwPhysicalA
         oA += pa->Length;
     }
     if(!psi || !pfn || (pfn->ParentDirectory.SegmentNumber > 0xffffffff)) { return; }
-    // Duplicate check by MftRecordNumber and LogFileSequenceNumber [SINGLE THREADED SECTION].
-    while((pNtfs_IdColl = FcNtfs_Setup_ObMap_GetNextByKey(ctx->pmId, pr->MftRecordNumber, pNtfs_IdColl))) {
-        if(pNtfs_IdColl->Setup.qwLogFileSequenceNumber == pr->LogFileSequenceNumber) {
+    // Append parsed record to the block of the calling worker.
+    cbRecord = (sizeof(FCNTFS_SETUP_RECORD) + pfn->NameLength * sizeof(WCHAR) + 7) & ~7;
+    if(*ppBlock && ((*ppBlock)->cbUsed + cbRecord > FCNTFS_SETUP_BLOCK_SIZE)) {
+        FcNtfs_SetupBlockCommit(ctx, *ppBlock);
+        *ppBlock = NULL;
+    }
+    if(!*ppBlock) {
+        if(!(*ppBlock = LocalAlloc(0, sizeof(FCNTFS_SETUP_BLOCK)))) { return; }
+        (*ppBlock)->FLink = NULL;
+        (*ppBlock)->cRecord = 0;
+        (*ppBlock)->cbUsed = 0;
+    }
+    pe = (PFCNTFS_SETUP_RECORD)((*ppBlock)->pb + (*ppBlock)->cbUsed);
+    pe->pa = qwPhysicalAddress;
+    pe->va = qwVirtualAddress;
+    pe->qwLogFileSequenceNumber = pr->LogFileSequenceNumber;
+    pe->ftCreate = psi->TimeCreate;
+    pe->ftModify = psi->TimeModify;
+    pe->ftRead = psi->TimeRead;
+    pe->cbFileSize = max(cbData, pfn->SizeReal);
+    pe->dwMftRecordNumber = pr->MftRecordNumber;
+    pe->dwIdParent = (DWORD)pfn->ParentDirectory.SegmentNumber;
+    pe->cbFileSizeMftResident = (WORD)cbData;
+    pe->Flags = pr->Flags;
+    pe->cwszName = pfn->NameLength;
+    memcpy(pe->wszName, pfn->Name, pfn->NameLength * sizeof(WCHAR));
+    (*ppBlock)->cbUsed += cbRecord;
+    (*ppBlock)->cRecord++;
+}
+
+/*
+* Try add a single parsed MFT record to the NTFS MFT dataset.
+* NB! Must be called single-threaded in ascending physical address order.
+* -- ctx
+* -- pe
+*/
+VOID FcNtfs_SetupRecordCommit(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ PFCNTFS_SETUP_RECORD pe)
+{
+    DWORD i, dwIdFs;
+    PFCNTFS pNtfs = NULL, pNtfs_IdColl = NULL;
+    PFCNTFS_CONTEXT_IDFS_LISTENTRY pFsList;
+    // Duplicate check by MftRecordNumber and LogFileSequenceNumber.
+    while((pNtfs_IdColl = FcNtfs_Setup_ObMap_GetNextByKey(ctx->pmId, pe->dwMftRecordNumber, pNtfs_IdColl))) {
+        if(pNtfs_IdColl->Setup.qwLogFileSequenceNumber == pe->qwLogFileSequenceNumber) {
             return;
         }
     }
-    // Create NTFS object and populate [SINGLE THREADED SECTION].
-    if(!(pNtfs = FcNtfs_SetupCreateEntry(ctx, pr->MftRecordNumber, pfn->Name, pfn->NameLength, (pr->Flags & 0x02)))) {
+    // Create NTFS object and populate.
+    if(!(pNtfs = FcNtfs_SetupCreateEntry(ctx, pe->dwMftRecordNumber, pe->wszName, pe->cwszName, (pe->Flags & 0x02)))) {
         return;
     }
-    pNtfs->pa = qwPhysicalAddress;
-    pNtfs->va = qwVirtualAddress;
-    pNtfs->Setup.qwLogFileSequenceNumber = pr->LogFileSequenceNumber;
-    pNtfs->Setup.dwIdParent = (DWORD)pfn->ParentDirectory.SegmentNumber;
-    pNtfs->cbFileSize = max(cbData, pfn->SizeReal);
-    pNtfs->cbFileSizeMftResident = (WORD)cbData;
-    pNtfs->ftCreate = psi->TimeCreate;
-    pNtfs->ftModify = psi->TimeModify;
-    pNtfs->ftRead = psi->TimeRead;
-    pNtfs->Flags = pr->Flags;
+    pNtfs->pa = pe->pa;
+    pNtfs->va = pe->va;
+    pNtfs->Setup.qwLogFileSequenceNumber = pe->qwLogFileSequenceNumber;
+    pNtfs->Setup.dwIdParent = pe->dwIdParent;
+    pNtfs->cbFileSize = pe->cbFileSize;
+    pNtfs->cbFileSizeMftResident = pe->cbFileSizeMftResident;
+    pNtfs->ftCreate = pe->ftCreate;
+    pNtfs->ftModify = pe->ftModify;
+    pNtfs->ftRead = pe->ftRead;
+    pNtfs->Flags = pe->Flags;
     // Set idfs [internal file system id]
     dwIdFs = 0;
     if(ctx->pLast && ((ctx->pLast->pa >> 12) == (pNtfs->pa >> 12))) {
@@ -384,7 +523,7 @@ VOID FcNtfs_SetupMftEntry(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD qwPhysicalA
     }
     pNtfs->Setup.dwIdFs = dwIdFs;
     ctx->pLast = pNtfs;
-    // Commit NTFS object to ctx [SINGLE THREADED SECTION].
+    // Commit NTFS object to ctx.
     if(!(pFsList = ObMap_GetByKey(ctx->pmFs, dwIdFs))) {
         if(!(pFsList = LocalAlloc(LMEM_ZEROINIT, sizeof(FCNTFS_CONTEXT_IDFS_LISTENTRY)))) {
             ObMap_Remove(ctx->pmId, pNtfs);
@@ -418,97 +557,333 @@ VOID FcNtfs_SetupMftEntry(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD qwPhysicalA
 }
 
 /*
-* Try add a physical memory page to the NTFS MFT dataset.
+* qsort comparator - sort parsed records on physical address.
+*/
+int FcNtfs_SetupMerge_CmpRecord(const void *v1, const void *v2)
+{
+    PFCNTFS_SETUP_RECORD p1 = *(PFCNTFS_SETUP_RECORD*)v1;
+    PFCNTFS_SETUP_RECORD p2 = *(PFCNTFS_SETUP_RECORD*)v2;
+    return (p1->pa < p2->pa) ? -1 : ((p1->pa > p2->pa) ? 1 : 0);
+}
+
+/*
+* Merge the parsed records of all workers into the NTFS MFT dataset. Records
+* are committed in physical address order which keeps the 'same page as last
+* record' file system heuristic independent of worker thread scheduling.
 * -- ctx
-* -- pa
-* -- pbPage
 */
-VOID FcNtfs_SetupMftPage(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ QWORD pa, _In_reads_(0x1000) PBYTE pbPage)
+VOID FcNtfs_SetupMerge(_In_ PFCNTFS_SETUP_CONTEXT ctx)
 {
-    QWORD i, va = 0;
-    PNTFS_FILE_RECORD pr;
-    if(*(PDWORD)pbPage != 'ELIF') { return; }     // file signature
-    // virtual address correlation is effective for reducing the number of file
-    // system fragments and hence lowers the risk of incorrect mergers across
-    // file systems if multiple file systems exists. But it's very resource
-    // intensive to retrieve virtual address from physical address so skip this.
-    /*
-    PVMM_PROCESS pObSystemProcess = NULL;
-    PVMMOB_PHYS2VIRT_INFORMATION pObPhys2Virt = NULL;
-    if((pObSystemProcess = VmmProcessGet(4))) {
-        if((pObPhys2Virt = VmmPhys2VirtGetInformation(pObSystemProcess, pa)) && pObPhys2Virt->cvaList) {
-            va = pObPhys2Virt->pvaList[0];
+    DWORD i, o, iRecord = 0, cRecord = 0;
+    PFCNTFS_SETUP_BLOCK pBlock, pBlockNext;
+    PFCNTFS_SETUP_RECORD pe, *ppRecords = NULL;
+    for(pBlock = ctx->pBlockHead; pBlock; pBlock = pBlock->FLink) {
+        cRecord += pBlock->cRecord;
+    }
+    vmmprintfv_fn("NTFS MFT: %i candidates, %i parsed records, %i torn records rejected.\n", ctx->cCandidate, cRecord, ctx->cTorn);
+    if(cRecord && (ppRecords = LocalAlloc(0, cRecord * sizeof(PFCNTFS_SETUP_RECORD)))) {
+        for(pBlock = ctx->pBlockHead; pBlock; pBlock = pBlock->FLink) {
+            for(i = 0, o = 0; i < pBlock->cRecord; i++) {
+                pe = (PFCNTFS_SETUP_RECORD)(pBlock->pb + o);
+                ppRecords[iRecord++] = pe;
+                o += (sizeof(FCNTFS_SETUP_RECORD) + pe->cwszName * sizeof(WCHAR) + 7) & ~7;
+            }
+        }
+        qsort(ppRecords, cRecord, sizeof(PFCNTFS_SETUP_RECORD), FcNtfs_SetupMerge_CmpRecord);
+        for(i = 0; i < cRecord; i++) {
+            FcNtfs_SetupRecordCommit(ctx, ppRecords[i]);
         }
-        Ob_DECREF_NULL(&pObPhys2Virt);
-        Ob_DECREF_NULL(&pObSystemProcess);
+        LocalFree(ppRecords);
     }
-    */
-    for(i = 0; i < 0x1000; i += 0x400) {
-        pr = (PNTFS_FILE_RECORD)(pbPage + i);
-        if(pr->Signature != 'ELIF') { continue; }
-        if((pr->UpdateSequenceArrayOffset > 0x100) || (pr->UpdateSequenceArraySize > 0x100)) { continue; }
-        if(pr->BaseFileRecordSegment.SegmentNumber) { continue; }
-        if(pr->FirstAttributeOffset > 0x300) { continue; }
-        FcNtfs_SetupMftEntry(ctx, pa + i, (va ? va + i : 0), pbPage + i);
+    // free the record blocks - they are no longer needed.
+    pBlock = ctx->pBlockHead;
+    ctx->pBlockHead = NULL;
+    ctx->pBlockCheckpoint = NULL;
+    while(pBlock) {
+        pBlockNext = pBlock->FLink;
+        LocalFree(pBlock);
+        pBlock = pBlockNext;
     }
 }
 
 /*
-* Filter incoming POB_FC_SCANPHYSMEM_CHUNK to retrieve potential MFT entry
-* physical page addresses and their data in a map [pa -> pb].
-* CALLER DECREF: return
+* Save the parsed MFT records not yet saved to the resumable store. Called by
+* the physical memory scan while chunks may be in flight - the record blocks
+* linked in front of the last checkpointed block are the new ones. Committed
+* blocks are never modified, only the list head is protected by LockUpdate.
+* Records of chunks above the checkpoint watermark are discarded on resume.
+* -- ctxConsumer = PFCNTFS_SETUP_CONTEXT
+* -- hSql = database handle with an open transaction.
+* -- return
+*/
+_Success_(return)
+BOOL FcNtfs_SetupCheckpoint(_In_opt_ PVOID ctxConsumer, _In_ sqlite3 *hSql)
+{
+    BOOL fResult = FALSE;
+    sqlite3_stmt *hStmt = NULL;
+    PFCNTFS_SETUP_BLOCK pBlock, pBlockHead;
+    PFCNTFS_SETUP_CONTEXT ctx = (PFCNTFS_SETUP_CONTEXT)ctxConsumer;
+    if(!ctx) { return FALSE; }
+    EnterCriticalSection(&ctx->LockUpdate);
+    pBlockHead = ctx->pBlockHead;
+    LeaveCriticalSection(&ctx->LockUpdate);
+    if(ctx->fCheckpointRewrite) {
+        if(SQLITE_OK != sqlite3_exec(hSql, "DELETE FROM resume_ntfs;", NULL, NULL, NULL)) { goto fail; }
+    }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "INSERT INTO resume_ntfs (crecord, data) VALUES (?, ?);", -1, &hStmt, NULL)) { goto fail; }
+    for(pBlock = pBlockHead; pBlock != (ctx->fCheckpointRewrite ? NULL : ctx->pBlockCheckpoint); pBlock = pBlock->FLink) {
+        sqlite3_bind_int(hStmt, 1, pBlock->cRecord);
+        sqlite3_bind_blob(hStmt, 2, pBlock->pb, pBlock->cbUsed, SQLITE_STATIC);
+        if(SQLITE_DONE != sqlite3_step(hStmt)) { goto fail; }
+        sqlite3_reset(hStmt);
+    }
+    ctx->pBlockCheckpoint = pBlockHead;
+    ctx->fCheckpointRewrite = FALSE;
+    fResult = TRUE;
+fail:
+    sqlite3_finalize(hStmt);
+    return fResult;
+}
+
+/*
+* Restore the parsed MFT records of an interrupted scan from the resumable
+* store. The saved blocks are validated before use - on failure the context
+* is left untouched. Records at or above paResume are discarded since they
+* are re-scanned (the checkpoint may have saved records of later chunks); the
+* next checkpoint then rewrites the saved records in the same transaction as
+* the new scan position so that discarded records are never resumed twice.
+* -- ctxConsumer = PFCNTFS_SETUP_CONTEXT
+* -- hSql
+* -- paResume
+* -- return
+*/
+_Success_(return)
+BOOL FcNtfs_SetupResume(_In_opt_ PVOID ctxConsumer, _In_ sqlite3 *hSql, _In_ QWORD paResume)
+{
+    int rc;
+    BOOL fResult = FALSE;
+    DWORD i, o, oKeep, cb, cbRecord, cKeep;
+    PFCNTFS_SETUP_RECORD pe;
+    PFCNTFS_SETUP_BLOCK pBlock = NULL, pBlockHead = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    PFCNTFS_SETUP_CONTEXT ctx = (PFCNTFS_SETUP_CONTEXT)ctxConsumer;
+    if(!ctx || ctx->pBlockHead) { return FALSE; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "SELECT crecord, data FROM resume_ntfs ORDER BY id;", -1, &hStmt, NULL)) { goto fail; }
+    while(SQLITE_ROW == (rc = sqlite3_step(hStmt))) {
+        cb = sqlite3_column_bytes(hStmt, 1);
+        if(!cb || (cb > FCNTFS_SETUP_BLOCK_SIZE)) { goto fail; }
+        if(!(pBlock = LocalAlloc(0, sizeof(FCNTFS_SETUP_BLOCK)))) { goto fail; }
+        pBlock->cRecord = sqlite3_column_int(hStmt, 0);
+        memcpy(pBlock->pb, sqlite3_column_blob(hStmt, 1), cb);
+        // validate record layout - the records are walked by FcNtfs_SetupMerge -
+        // and compact the records below paResume to the front of the block.
+        for(i = 0, o = 0, oKeep = 0, cKeep = 0; i < pBlock->cRecord; i++) {
+            if(o + sizeof(FCNTFS_SETUP_RECORD) > cb) { goto fail; }
+            pe = (PFCNTFS_SETUP_RECORD)(pBlock->pb + o);
+            cbRecord = (sizeof(FCNTFS_SETUP_RECORD) + pe->cwszName * sizeof(WCHAR) + 7) & ~7;
+            if(o + cbRecord > cb) { goto fail; }
+            if(pe->pa < paResume) {
+                memmove(pBlock->pb + oKeep, pe, cbRecord);
+                oKeep += cbRecord;
+                cKeep++;
+            }
+            o += cbRecord;
+        }
+        if(o != cb) { goto fail; }
+        if(!cKeep) {
+            LocalFree(pBlock);
+            pBlock = NULL;
+            continue;
+        }
+        pBlock->cRecord = cKeep;
+        pBlock->cbUsed = oKeep;
+        pBlock->FLink = pBlockHead;
+        pBlockHead = pBlock;
+        pBlock = NULL;
+    }
+    if(rc != SQLITE_DONE) { goto fail; }
+    ctx->pBlockHead = pBlockHead;
+    ctx->pBlockCheckpoint = pBlockHead;
+    ctx->fCheckpointRewrite = TRUE;
+    pBlockHead = NULL;
+    fResult = TRUE;
+fail:
+    sqlite3_finalize(hStmt);
+    LocalFree(pBlock);
+    while((pBlock = pBlockHead)) {
+        pBlockHead = pBlock->FLink;
+        LocalFree(pBlock);
+    }
+    return fResult;
+}
+
+/*
+* MFT record signature scan: a candidate record is a 1kB aligned record with
+* the 'FILE' signature. The result is a 4-bit candidate record mask per page.
+* Three implementations exist - scalar, SSE2 and AVX2 - and the best one for
+* the CPU is selected at runtime. The AVX2 implementation gathers the record
+* signatures of two pages at a time and requires the page buffers of the chunk
+* to be contiguous in memory (which they usually are), otherwise SSE2 is used.
 * -- pc
-* -- return = MAP or NULL if no candidate pages found.
+* -- iPage
+* -- cPage
+* -- pbMask = per page candidate record mask.
 */
-POB_MAP FcNtfs_SetupGetValidAddrMap(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
+VOID FcNtfs_SetupScan_Scalar(_In_ POB_FC_SCANPHYSMEM_CHUNK pc, _In_ DWORD iPage, _In_ DWORD cPage, _Out_writes_(cPage) PBYTE pbMask)
 {
-    BOOL fPfnValidForMft;
     DWORD i;
-    POB_MAP pmObAddr;
-    PMMPFN_MAP_ENTRY pePfn;
-    if(!(pmObAddr = ObMap_New(0))) { return NULL; }
-    for(i = 0; i < 0x1000; i++) {
-        if((pc->ppMEMs[i]->qwA != (QWORD)-1) && pc->ppMEMs[i]->f && (pc->ppMEMs[i]->cb == 0x1000) && (*(PDWORD)pc->ppMEMs[i]->pb == 'ELIF')) {
-            pePfn = (pc->pPfnMap && (i < pc->pPfnMap->cMap)) ? (pc->pPfnMap->pMap + i) : NULL;
-            fPfnValidForMft =
-                !pePfn || (pePfn->dwPfn != (pc->ppMEMs[i]->qwA >> 12)) ||
-                (pePfn->PageLocation == MmPfnTypeStandby) ||
-                (pePfn->PageLocation == MmPfnTypeModified) ||
-                (pePfn->PageLocation == MmPfnTypeModifiedNoWrite) ||
-                (pePfn->PageLocation == MmPfnTypeTransition) ||
-                ((pePfn->PageLocation == MmPfnTypeActive) && (pePfn->Priority == 5));
-            if(fPfnValidForMft) {
-                ObMap_Push(pmObAddr, pc->ppMEMs[i]->qwA, pc->ppMEMs[i]->pb);
+    PDWORD pdw;
+    for(i = 0; i < cPage; i++) {
+        pdw = (PDWORD)pc->ppMEMs[iPage + i]->pb;
+        pbMask[i] =
+            ((pdw[0x000] == 'ELIF') ? 1 : 0) |
+            ((pdw[0x100] == 'ELIF') ? 2 : 0) |
+            ((pdw[0x200] == 'ELIF') ? 4 : 0) |
+            ((pdw[0x300] == 'ELIF') ? 8 : 0);
+    }
+}
+
+VOID FcNtfs_SetupScan_Sse2(_In_ POB_FC_SCANPHYSMEM_CHUNK pc, _In_ DWORD iPage, _In_ DWORD cPage, _Out_writes_(cPage) PBYTE pbMask)
+{
+    DWORD i;
+    PINT pi;
+    __m128i v, vSig = _mm_set1_epi32('ELIF');
+    for(i = 0; i < cPage; i++) {
+        pi = (PINT)pc->ppMEMs[iPage + i]->pb;
+        v = _mm_setr_epi32(pi[0x000], pi[0x100], pi[0x200], pi[0x300]);
+        pbMask[i] = (BYTE)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, vSig)));
+    }
+}
+
+VOID FcNtfs_SetupScan_Avx2(_In_ POB_FC_SCANPHYSMEM_CHUNK pc, _In_ DWORD iPage, _In_ DWORD cPage, _Out_writes_(cPage) PBYTE pbMask)
+{
+    DWORD i, m;
+    PBYTE pb0 = pc->ppMEMs[iPage]->pb;
+    __m256i v, vSig, vIdx;
+    for(i = 1; i < cPage; i++) {
+        if(pc->ppMEMs[iPage + i]->pb != pb0 + ((QWORD)i << 12)) {
+            FcNtfs_SetupScan_Sse2(pc, iPage, cPage, pbMask);
+            return;
+        }
+    }
+    vSig = _mm256_set1_epi32('ELIF');
+    vIdx = _mm256_setr_epi32(0x000, 0x100, 0x200, 0x300, 0x400, 0x500, 0x600, 0x700);
+    for(i = 0; i + 1 < cPage; i += 2) {
+        v = _mm256_i32gather_epi32((const int*)(pb0 + ((QWORD)i << 12)), vIdx, 4);
+        m = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, vSig)));
+        pbMask[i] = (BYTE)(m & 0xf);
+        pbMask[i + 1] = (BYTE)(m >> 4);
+    }
+    if(i < cPage) {
+        FcNtfs_SetupScan_Sse2(pc, iPage + i, 1, pbMask + i);
+    }
+    _mm256_zeroupper();
+}
+
+/*
+* Select the MFT record signature scan implementation at runtime.
+* -- return
+*/
+PFCNTFS_SETUP_SCAN_PFN FcNtfs_SetupScan_Select()
+{
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 0);
+    if(cpuInfo[0] >= 7) {
+        __cpuid(cpuInfo, 1);
+        // OSXSAVE + AVX and OS support for saving YMM state.
+        if((cpuInfo[2] & (1 << 27)) && (cpuInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6)) {
+            __cpuidex(cpuInfo, 7, 0);
+            if(cpuInfo[1] & (1 << 5)) {
+                return FcNtfs_SetupScan_Avx2;
             }
         }
     }
-    if(ObMap_Size(pmObAddr)) {
-        return pmObAddr;
+    if(IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE)) {
+        return FcNtfs_SetupScan_Sse2;
     }
-    Ob_DECREF(pmObAddr);
-    return NULL;
+    return FcNtfs_SetupScan_Scalar;
 }
 
 /*
-* Analyze a POB_FC_SCANPHYSMEM_CHUNK 16MB memory chunk for MFT file candidates
-* and add any found to the internal data sets. This function is meant to be
-* called asynchronously by a worker thread (VmmWork). Function is thread-safe.
+* Analyze a part of a POB_FC_SCANPHYSMEM_CHUNK 16MB memory chunk for MFT file
+* candidates and add any found to the internal data sets. This function is a
+* physical memory scan consumer callback. Function is thread-safe; records are
+* scanned, fixed-up and parsed in parallel into a per-worker record block. The
+* blocks are merged into the dataset by FcNtfs_SetupFinalize.
+* -- ctxConsumer = PFCNTFS_SETUP_CONTEXT
 * -- pc
+* -- iPage
+* -- cPage
 */
-VOID FcNtfs_Setup_ThreadProc(_In_ POB_FC_SCANPHYSMEM_CHUNK pc)
+VOID FcNtfs_SetupChunk(_In_opt_ PVOID ctxConsumer, _In_ POB_FC_SCANPHYSMEM_CHUNK pc, _In_ DWORD iPage, _In_ DWORD cPage)
 {
-    QWORD pa;
-    PBYTE pb;
-    POB_MAP pmObAddr;
-    PFCNTFS_SETUP_CONTEXT ctx = (PFCNTFS_SETUP_CONTEXT)pc->ctx_NTFS;
-    EnterCriticalSection(&ctx->LockUpdate);
-    if((pmObAddr = FcNtfs_SetupGetValidAddrMap(pc))) {
-        while((pb = ObMap_PopWithKey(pmObAddr, &pa))) {
-            FcNtfs_SetupMftPage(ctx, pa, pb);
+    BOOL fPfnValidForMft;
+    DWORD i, j, cCandidate = 0, cTorn = 0;
+    QWORD va = 0;
+    PBYTE pbPage;
+    PMEM_SCATTER pMEM;
+    PNTFS_FILE_RECORD pr;
+    PMMPFN_MAP_ENTRY pePfn;
+    PFCNTFS_SETUP_BLOCK pBlock = NULL;
+    BYTE pbMask[FC_PHYSMEM_NUM_CHUNKS];
+    BYTE pbRecord[0x400];
+    PFCNTFS_SETUP_CONTEXT ctx = (PFCNTFS_SETUP_CONTEXT)ctxConsumer;
+    if(!ctx || !cPage || (iPage + cPage > FC_PHYSMEM_NUM_CHUNKS)) { return; }
+    // 1: find candidate records of the whole chunk part in one pass.
+    ctx->pfnScan(pc, iPage, cPage, pbMask);
+    // 2: validate, fixup and parse candidate records.
+    for(i = 0; i < cPage; i++) {
+        if(!pbMask[i]) { continue; }
+        pMEM = pc->ppMEMs[iPage + i];
+        if((pMEM->qwA == (QWORD)-1) || !pMEM->f || (pMEM->cb != 0x1000)) { continue; }
+        pePfn = (pc->pPfnMap && (iPage + i < pc->pPfnMap->cMap)) ? (pc->pPfnMap->pMap + iPage + i) : NULL;
+        fPfnValidForMft =
+            !pePfn || (pePfn->dwPfn != (pMEM->qwA >> 12)) ||
+            (pePfn->PageLocation == MmPfnTypeStandby) ||
+            (pePfn->PageLocation == MmPfnTypeModified) ||
+            (pePfn->PageLocation == MmPfnTypeModifiedNoWrite) ||
+            (pePfn->PageLocation == MmPfnTypeTransition) ||
+            ((pePfn->PageLocation == MmPfnTypeActive) && (pePfn->Priority == 5));
+        if(!fPfnValidForMft) { continue; }
+        pbPage = pMEM->pb;
+        // virtual address correlation is effective for reducing the number of file
+        // system fragments and hence lowers the risk of incorrect mergers across
+        // file systems if multiple file systems exists. But it's very resource
+        // intensive to retrieve virtual address from physical address so skip this.
+        /*
+        PVMM_PROCESS pObSystemProcess = NULL;
+        PVMMOB_PHYS2VIRT_INFORMATION pObPhys2Virt = NULL;
+        if((pObSystemProcess = VmmProcessGet(4))) {
+            if((pObPhys2Virt = VmmPhys2VirtGetInformation(pObSystemProcess, pMEM->qwA)) && pObPhys2Virt->cvaList) {
+                va = pObPhys2Virt->pvaList[0];
+            }
+            Ob_DECREF_NULL(&pObPhys2Virt);
+            Ob_DECREF_NULL(&pObSystemProcess);
+        }
+        */
+        for(j = 0; j < 4; j++) {
+            if(!(pbMask[i] & (1 << j))) { continue; }
+            cCandidate++;
+            pr = (PNTFS_FILE_RECORD)(pbPage + (j << 10));
+            if((pr->UpdateSequenceArrayOffset > 0x100) || (pr->UpdateSequenceArraySize > 0x100)) { continue; }
+            if(pr->BaseFileRecordSegment.SegmentNumber) { continue; }
+            if(pr->FirstAttributeOffset > 0x300) { continue; }
+            memcpy(pbRecord, pbPage + (j << 10), 0x400);
+            if(!FcNtfs_SetupRecordFixup(pbRecord)) {
+                cTorn++;
+                continue;
+            }
+            FcNtfs_SetupRecordParse(ctx, &pBlock, pMEM->qwA + (j << 10), (va ? va + (j << 10) : 0), pbRecord);
         }
     }
-    LeaveCriticalSection(&ctx->LockUpdate);
-    Ob_DECREF(pmObAddr);
+    // 3: hand over the record block of this worker to the context.
+    if(pBlock && pBlock->cRecord) {
+        FcNtfs_SetupBlockCommit(ctx, pBlock);
+    } else {
+        LocalFree(pBlock);
+    }
+    InterlockedAdd(&ctx->cCandidate, cCandidate);
+    InterlockedAdd(&ctx->cTorn, cTorn);
 }
 
 /*
@@ -621,6 +996,20 @@ VOID FcNtfs_SetupFinalize_Compact(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_opt_ PFCNT
     }
 }
 
+/*
+* Worker: compact file system fragments in parallel. Compaction only links
+* entries to parents within the same file system fragment - fragments are
+* independent of each other as long as no merge is ongoing.
+* -- ctx
+*/
+VOID FcNtfs_SetupFinalize_Compact_ThreadProc(_In_ PFCNTFS_SETUP_CONTEXT ctx)
+{
+    LONG i = InterlockedDecrement(&ctx->iListsCompact);
+    if(i >= 0) {
+        FcNtfs_SetupFinalize_Compact(ctx, ctx->ppListsSorted[i]);
+    }
+}
+
 /*
 * Merge two file system fragments into one.
 * -- ctx
@@ -746,6 +1135,59 @@ DWORD FcNtfs_SetupFinalize_MergeFind2(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ DWORD
 * -- return = the file system id most suitable to merge into (-1 if none).
 */
 DWORD FcNtfs_SetupFinalize_MergeFind(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ DWORD iListMerge)
+{
+    PFCNTFS_CONTEXT_IDFS_LISTENTRY pFsList;
+    PFCNTFS_CONTEXT_COUNTER pc;
+    PFCNTFS pe, peParent;
+    DWORD i, iFs, iMerge, cTouched = 0;
+    pFsList = ObMap_GetByKey(ctx->pmFs, iListMerge);
+    pe = pFsList ? pFsList->pAll : NULL;
+    while(pe) {
+        if(!pe->pParent) {
+            peParent = NULL;
+            while((peParent = FcNtfs_Setup_ObMap_GetNextByKey(ctx->pmId, pe->Setup.dwIdParent, peParent))) {
+                if(peParent->Setup.dwIdFs != pe->Setup.dwIdFs) {
+                    pc = ctx->pListsCounter + peParent->Setup.dwIdFs;
+                    if(!pc->cPos && !pc->cNeg) {
+                        ctx->pdwListsCounterTouched[cTouched++] = peParent->Setup.dwIdFs;
+                    }
+                    if(peParent->fDir) {
+                        pc->cPos++;
+                    } else {
+                        pc->cNeg++;
+                    }
+                }
+            }
+        }
+        pe = pe->Setup.pNextAll;
+    }
+    // only the touched counters are scanned and reset - lowest idfs wins ties.
+    for(i = 0, iMerge = -1; i < cTouched; i++) {
+        iFs = ctx->pdwListsCounterTouched[i];
+        pc = ctx->pListsCounter + iFs;
+        if(!pc->cNeg && pc->cPos) {
+            if((iMerge == -1) || (pc->cPos > ctx->pListsCounter[iMerge].cPos) || ((pc->cPos == ctx->pListsCounter[iMerge].cPos) && (iFs < iMerge))) {
+                iMerge = iFs;
+            }
+        }
+    }
+    for(i = 0; i < cTouched; i++) {
+        ctx->pListsCounter[ctx->pdwListsCounterTouched[i]].cPos = 0;
+        ctx->pListsCounter[ctx->pdwListsCounterTouched[i]].cNeg = 0;
+    }
+    return iMerge;
+}
+
+#ifdef VMM_TEST_SELFTEST
+/*
+* Find the ideal file system fragment to merge into - previous algorithm which
+* clears and scans the counters of all file system fragments on each call.
+* Used as reference by the sequential finalize (ctx->fFinalizeSequential).
+* -- ctx
+* -- iListMerge
+* -- return = the file system id most suitable to merge into (-1 if none).
+*/
+DWORD FcNtfs_SetupFinalize_MergeFindSequential(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ DWORD iListMerge)
 {
     PFCNTFS_CONTEXT_IDFS_LISTENTRY pFsList;
     PFCNTFS pe, peParent;
@@ -776,15 +1218,68 @@ DWORD FcNtfs_SetupFinalize_MergeFind(_In_ PFCNTFS_SETUP_CONTEXT ctx, _In_ DWORD
     }
     return iMerge;
 }
+#endif /* VMM_TEST_SELFTEST */
+
+#define FCNTFS_FINALIZE_SPLIT_DEPTH     3
+
+// sub-tree (sibling list and its descendants) hashed by a parallel worker.
+typedef struct tdFCNTFS_FINALIZE_SUBTREE {
+    struct tdFCNTFS_FINALIZE_SUBTREE *FLink;
+    PFCNTFS pe;                     // first entry in sibling list (parent already hashed).
+    DWORD iDirDepth;
+    DWORD cwszPath;                 // path length of parent.
+    DWORD cEntry;                   // # entries hashed.
+    POB_SET psObHashPath;           // worker local hash set.
+} FCNTFS_FINALIZE_SUBTREE, *PFCNTFS_FINALIZE_SUBTREE;
 
 typedef struct tdFCNTFS_FINALIZE_CONTEXT {
-    sqlite3 *hSql;
-    sqlite3_stmt *st;
-    sqlite3_stmt *st_str;
+    PFC_SQLBULK hBulk;
     QWORD cbUtf8Total;
     QWORD cbJsonTotal;
+    POB_SET psObHashPath;
+    DWORD cSub;
+    volatile LONG iSub;             // parallel hash work index (decremented as-goes).
+    PFCNTFS_FINALIZE_SUBTREE pSubHead;
+    PFCNTFS_FINALIZE_SUBTREE *ppSub;
+#ifdef VMM_TEST_SELFTEST
+    struct tdFCNTFS_SELFTEST_FINALIZE *pSelfTest;
+#endif /* VMM_TEST_SELFTEST */
 } FCNTFS_FINALIZE_CONTEXT, *PFCNTFS_FINALIZE_CONTEXT;
 
+#ifdef VMM_TEST_SELFTEST
+// finalized entry as it would have been added to the database (self test).
+typedef struct tdFCNTFS_SELFTEST_FINALIZE_ROW {
+    QWORD id;
+    QWORD idParent;
+    QWORD qwHash;
+    QWORD qwHashParent;
+    QWORD qwHashPath;               // hash of the path string
+    QWORD pa;
+    QWORD cbFileSize;
+    QWORD ftCreate;
+    QWORD olnUtf8;
+    QWORD olnJson;
+    DWORD dwIdThis;
+    DWORD cbu;
+    WORD Flags;
+    WORD iDirDepth;
+    WORD wName_SeqNbr;
+    WORD _Filler;
+} FCNTFS_SELFTEST_FINALIZE_ROW, *PFCNTFS_SELFTEST_FINALIZE_ROW;
+
+typedef struct tdFCNTFS_SELFTEST_FINALIZE {
+    DWORD cRow;
+    DWORD cRowMax;
+    PFCNTFS_SELFTEST_FINALIZE_ROW pRow;
+} FCNTFS_SELFTEST_FINALIZE, *PFCNTFS_SELFTEST_FINALIZE;
+
+#define FCNTFS_FINALIZE_SELFTEST(ctxFinal)      ((ctxFinal)->pSelfTest)
+#define FCNTFS_FINALIZE_SEQUENTIAL(ctx)         ((ctx)->fFinalizeSequential)
+#else
+#define FCNTFS_FINALIZE_SELFTEST(ctxFinal)      (NULL)
+#define FCNTFS_FINALIZE_SEQUENTIAL(ctx)         (FALSE)
+#endif /* VMM_TEST_SELFTEST */
+
 /*
 * Add a file system entry to the database.
 */
@@ -792,60 +1287,256 @@ VOID FcNtfs_SetupFinalize_DatabaseAdd(_In_ PFCNTFS_FINALIZE_CONTEXT ctx, _In_ PF
 {
     QWORD id = pe->iMap;
     FCSQL_INSERTSTRTABLE SqlStrInsert = { 0 };
-    if(!Fc_SqlInsertStr(ctx->st_str, wszPathName + 1, owszName - 1, &SqlStrInsert)) { return; }
-    sqlite3_reset(ctx->st);
-    sqlite3_bind_int64(ctx->st, 1, id);
-    sqlite3_bind_int64(ctx->st, 2, pe->pParent ? pe->pParent->iMap : -1);
-    sqlite3_bind_int64(ctx->st, 3, SqlStrInsert.id);
-    sqlite3_bind_int64(ctx->st, 4, pe->qwHashThis);
-    sqlite3_bind_int64(ctx->st, 5, pe->pParent ? pe->pParent->qwHashThis : -1);
-    sqlite3_bind_int64(ctx->st, 6, pe->pa);
-    sqlite3_bind_int64(ctx->st, 7, pe->dwIdThis);
-    sqlite3_bind_int64(ctx->st, 8, pe->Flags);
-    sqlite3_bind_int64(ctx->st, 9, pe->iDirDepth);
-    sqlite3_bind_int64(ctx->st, 10, pe->cbFileSize);
-    sqlite3_bind_int64(ctx->st, 11, pe->cbFileSizeMftResident);
-    sqlite3_bind_int64(ctx->st, 12, pe->ftCreate);
-    sqlite3_bind_int64(ctx->st, 13, pe->ftModify);
-    sqlite3_bind_int64(ctx->st, 14, pe->ftRead);
-    sqlite3_bind_int64(ctx->st, 15, pe->wName_SeqNbr);
-    sqlite3_bind_int64(ctx->st, 16, ctx->cbUtf8Total + id * M_NTFS_INFO_LINELENGTH_UTF8);
-    sqlite3_bind_int64(ctx->st, 17, ctx->cbJsonTotal + id * M_NTFS_INFO_LINELENGTH_JSON);
-    sqlite3_step(ctx->st);
+#ifdef VMM_TEST_SELFTEST
+    LPWSTR wsz;
+    PFCNTFS_SELFTEST_FINALIZE_ROW pRow;
+    if(ctx->pSelfTest) {
+        if(ctx->pSelfTest->cRow == ctx->pSelfTest->cRowMax) { return; }
+        pRow = ctx->pSelfTest->pRow + ctx->pSelfTest->cRow++;
+        pRow->id = id;
+        pRow->idParent = pe->pParent ? (QWORD)pe->pParent->iMap : (QWORD)-1;
+        pRow->qwHash = pe->qwHashThis;
+        pRow->qwHashParent = pe->pParent ? pe->pParent->qwHashThis : (QWORD)-1;
+        for(pRow->qwHashPath = 0xcbf29ce484222325, wsz = wszPathName + 1; *wsz; wsz++) {
+            pRow->qwHashPath = (pRow->qwHashPath ^ *wsz) * 0x100000001b3;
+        }
+        pRow->pa = pe->pa;
+        pRow->cbFileSize = pe->cbFileSize;
+        pRow->ftCreate = pe->ftCreate;
+        pRow->olnUtf8 = ctx->cbUtf8Total + id * M_NTFS_INFO_LINELENGTH_UTF8;
+        pRow->olnJson = ctx->cbJsonTotal + id * M_NTFS_INFO_LINELENGTH_JSON;
+        pRow->dwIdThis = pe->dwIdThis;
+        pRow->cbu = WideCharToMultiByte(CP_UTF8, 0, wszPathName + 1, -1, NULL, 0, NULL, NULL);
+        pRow->Flags = pe->Flags;
+        pRow->iDirDepth = pe->iDirDepth;
+        pRow->wName_SeqNbr = pe->wName_SeqNbr;
+        pRow->_Filler = 0;
+        ctx->cbUtf8Total += pRow->cbu;
+        ctx->cbJsonTotal += pRow->cbu;
+        return;
+    }
+#endif /* VMM_TEST_SELFTEST */
+    if(!Fc_SqlBulkAddStr(ctx->hBulk, wszPathName + 1, owszName - 1, &SqlStrInsert)) { return; }
+    Fc_SqlBulkAddRow(ctx->hBulk,
+        id,
+        (pe->pParent ? (QWORD)pe->pParent->iMap : (QWORD)-1),
+        SqlStrInsert.id,
+        pe->qwHashThis,
+        (pe->pParent ? pe->pParent->qwHashThis : (QWORD)-1),
+        pe->pa,
+        (QWORD)pe->dwIdThis,
+        (QWORD)pe->Flags,
+        (QWORD)pe->iDirDepth,
+        pe->cbFileSize,
+        (QWORD)pe->cbFileSizeMftResident,
+        pe->ftCreate,
+        pe->ftModify,
+        pe->ftRead,
+        (QWORD)pe->wName_SeqNbr,
+        ctx->cbUtf8Total + id * M_NTFS_INFO_LINELENGTH_UTF8,
+        ctx->cbJsonTotal + id * M_NTFS_INFO_LINELENGTH_JSON
+    );
     ctx->cbUtf8Total += SqlStrInsert.cbu;
     ctx->cbJsonTotal += SqlStrInsert.cbj;
 }
 
-DWORD FcNtfs_SetupFinalize_SetupFinish(_In_ PFCNTFS_FINALIZE_CONTEXT ctx, _In_ POB_SET psHashPath, _In_ PFCNTFS peNtfs, _In_ DWORD iMap, _In_ BYTE iDirDepth, _In_reads_(2048) LPWSTR wszPath, _In_ DWORD cwszPath)
+/*
+* Calculate the path hash of an entry from its (already hashed) parent. Name
+* collisions within the hash set are resolved by bumping wName_SeqNbr.
+* -- psHashPath
+* -- pe
+*/
+VOID FcNtfs_SetupFinalize_HashEntry(_In_ POB_SET psHashPath, _In_ PFCNTFS pe)
 {
-    DWORD dwHashName, cwszName;
+    DWORD dwHashName;
     QWORD qwHashTotal;
+    while(TRUE) {
+        qwHashTotal = pe->pParent ? pe->pParent->qwHashThis : 0;
+        dwHashName = Util_HashNameW_Registry(pe->wszName, pe->wName_SeqNbr);
+        qwHashTotal = dwHashName + ((qwHashTotal >> 13) | (qwHashTotal << 51));
+        if(!ObSet_Exists(psHashPath, qwHashTotal) || (pe->wName_SeqNbr > 100)) { break; }
+        pe->wName_SeqNbr++;
+    }
+    ObSet_Push(psHashPath, qwHashTotal);
+    pe->qwHashThis = qwHashTotal;
+}
+
+/*
+* Hash a sibling list and its sub-trees depth-first in the same order, and with
+* the same path length cut-off, as FcNtfs_SetupFinalize_SetupFinish. Child lists
+* at depth iDirDepthSplit are not descended into but queued onto ctx for hashing
+* in parallel (iDirDepthSplit = 0 hashes the whole tree).
+* -- ctx
+* -- psHashPath
+* -- pe
+* -- iDirDepth = depth of pe.
+* -- iDirDepthSplit
+* -- cwszPath = path length of the parent of pe.
+* -- return = number of entries hashed (queued entries excluded).
+*/
+DWORD FcNtfs_SetupFinalize_HashTree(_In_opt_ PFCNTFS_FINALIZE_CONTEXT ctx, _In_ POB_SET psHashPath, _In_opt_ PFCNTFS pe, _In_ DWORD iDirDepth, _In_ DWORD iDirDepthSplit, _In_ DWORD cwszPath)
+{
+    DWORD cwszName, cEntry = 0;
+    PFCNTFS_FINALIZE_SUBTREE pSub;
+    while(pe) {
+        cwszName = (DWORD)wcslen(pe->wszName);
+        if(cwszPath + cwszName + 2 >= 2048) { break; }
+        FcNtfs_SetupFinalize_HashEntry(psHashPath, pe);
+        cEntry++;
+        if(pe->pChild) {
+            if(ctx && (iDirDepth + 1 == iDirDepthSplit) && (pSub = LocalAlloc(LMEM_ZEROINIT, sizeof(FCNTFS_FINALIZE_SUBTREE)))) {
+                pSub->pe = pe->pChild;
+                pSub->iDirDepth = iDirDepth + 1;
+                pSub->cwszPath = cwszPath + cwszName + 1;
+                pSub->FLink = ctx->pSubHead;
+                ctx->pSubHead = pSub;
+                ctx->cSub++;
+            } else {
+                cEntry += FcNtfs_SetupFinalize_HashTree(ctx, psHashPath, pe->pChild, iDirDepth + 1, iDirDepthSplit, cwszPath + cwszName + 1);
+            }
+        }
+        pe = pe->pSibling;
+    }
+    return cEntry;
+}
+
+/*
+* Worker: hash a queued sub-tree into its own (thread local) hash set.
+* -- ctx
+*/
+VOID FcNtfs_SetupFinalize_HashSubtree_ThreadProc(_In_ PFCNTFS_FINALIZE_CONTEXT ctx)
+{
+    PFCNTFS_FINALIZE_SUBTREE pSub = ctx->ppSub[InterlockedDecrement(&ctx->iSub)];
+    if((pSub->psObHashPath = ObSet_New())) {
+        pSub->cEntry = FcNtfs_SetupFinalize_HashTree(NULL, pSub->psObHashPath, pSub->pe, pSub->iDirDepth, 0, pSub->cwszPath);
+    }
+}
+
+/*
+* Reset path hash collision counters of a tree (fallback to sequential hashing).
+* -- pe
+*/
+VOID FcNtfs_SetupFinalize_HashReset(_In_opt_ PFCNTFS pe)
+{
+    while(pe) {
+        pe->wName_SeqNbr = 0;
+        FcNtfs_SetupFinalize_HashReset(pe->pChild);
+        pe = pe->pSibling;
+    }
+}
+
+/*
+* Calculate the path hashes of the whole tree. The upper directory levels are
+* hashed sequentially and the sub-trees below them in parallel - each in its own
+* hash set. If all resulting hashes are unique no collision handling could have
+* differed from a single sequential pass. Otherwise (rare) the tree is re-hashed
+* sequentially to guarantee identical results.
+* -- ctx
+* -- pNtfsGlobalRoot
+* -- return
+*/
+_Success_(return)
+BOOL FcNtfs_SetupFinalize_Hash(_In_ PFCNTFS_FINALIZE_CONTEXT ctx, _In_ PFCNTFS pNtfsGlobalRoot)
+{
+    BOOL fResult = FALSE, fUnique;
+    DWORD i, cEntry;
+    PFCNTFS_FINALIZE_SUBTREE pSub;
+    PVMMOB_WORK_GROUP pObWorkGroup = NULL;
+    cEntry = FcNtfs_SetupFinalize_HashTree(ctx, ctx->psObHashPath, pNtfsGlobalRoot, 0, FCNTFS_FINALIZE_SPLIT_DEPTH, 0);
+    if(ctx->cSub) {
+        if(!(ctx->ppSub = LocalAlloc(0, ctx->cSub * sizeof(PFCNTFS_FINALIZE_SUBTREE)))) { goto fail; }
+        for(i = 0, pSub = ctx->pSubHead; pSub; pSub = pSub->FLink) {
+            ctx->ppSub[i++] = pSub;
+        }
+        ctx->iSub = ctx->cSub;
+        if(!(pObWorkGroup = VmmWorkGroup_New())) { goto fail; }
+        for(i = 0; i < ctx->cSub; i++) {
+            VmmWorkGroup_Add(pObWorkGroup, (LPTHREAD_START_ROUTINE)FcNtfs_SetupFinalize_HashSubtree_ThreadProc, ctx);
+        }
+        VmmWorkGroup_Join(pObWorkGroup);
+    }
+    // merge sub-tree hash sets and verify global uniqueness.
+    fUnique = !ctx->iSub;
+    for(pSub = ctx->pSubHead; fUnique && pSub; pSub = pSub->FLink) {
+        fUnique = pSub->psObHashPath && ObSet_PushSet(ctx->psObHashPath, pSub->psObHashPath);
+        cEntry += pSub->cEntry;
+    }
+    if(!fUnique || (ObSet_Size(ctx->psObHashPath) != cEntry)) {
+        vmmprintfv_fn("path hash collision - sequential fallback.\n");
+        ObSet_Clear(ctx->psObHashPath);
+        FcNtfs_SetupFinalize_HashReset(pNtfsGlobalRoot);
+        FcNtfs_SetupFinalize_HashTree(NULL, ctx->psObHashPath, pNtfsGlobalRoot, 0, 0, 0);
+    }
+    fResult = TRUE;
+fail:
+    Ob_DECREF(pObWorkGroup);
+    return fResult;
+}
+
+/*
+* Assign map indexes (depth-first pre-order) and add the (already hashed) tree
+* to the database.
+* -- ctx
+* -- peNtfs
+* -- iMap
+* -- iDirDepth
+* -- wszPath
+* -- cwszPath
+* -- return = next map index.
+*/
+DWORD FcNtfs_SetupFinalize_SetupFinish(_In_ PFCNTFS_FINALIZE_CONTEXT ctx, _In_ PFCNTFS peNtfs, _In_ DWORD iMap, _In_ BYTE iDirDepth, _In_reads_(2048) LPWSTR wszPath, _In_ DWORD cwszPath)
+{
+    DWORD cwszName;
     while(peNtfs) {
         // update/set path
         cwszName = (DWORD)wcslen(peNtfs->wszName);
         if(cwszPath + cwszName + 2 >= 2048) { break; }
         wszPath[cwszPath] = '\\';
         memcpy(&wszPath[cwszPath + 1], peNtfs->wszName, ((QWORD)cwszName << 1) + 2);
-        // update/set path hash
-        while(TRUE) {
-            qwHashTotal = peNtfs->pParent ? peNtfs->pParent->qwHashThis : 0;
-            dwHashName = Util_HashNameW_Registry(peNtfs->wszName, peNtfs->wName_SeqNbr);
-            qwHashTotal = dwHashName + ((qwHashTotal >> 13) | (qwHashTotal << 51));
-            if(!ObSet_Exists(psHashPath, qwHashTotal) || (peNtfs->wName_SeqNbr > 100)) { break; }
-            peNtfs->wName_SeqNbr++;
-        }
-        ObSet_Push(psHashPath, qwHashTotal);
-        peNtfs->qwHashThis = qwHashTotal;
         peNtfs->iDirDepth = iDirDepth;
         peNtfs->iMap = iMap++;
         FcNtfs_SetupFinalize_DatabaseAdd(ctx, peNtfs, wszPath, cwszPath + 1);
-        iMap = FcNtfs_SetupFinalize_SetupFinish(ctx, psHashPath, peNtfs->pChild, iMap, iDirDepth + 1, wszPath, cwszPath + cwszName + 1);
+        iMap = FcNtfs_SetupFinalize_SetupFinish(ctx, peNtfs->pChild, iMap, iDirDepth + 1, wszPath, cwszPath + cwszName + 1);
         peNtfs = peNtfs->pSibling;
     }
     wszPath[cwszPath] = 0;
     return iMap;
 }
 
+#ifdef VMM_TEST_SELFTEST
+/*
+* Hash the path, assign map indexes (depth-first pre-order) and add the tree to
+* the database in a single sequential pass - previous algorithm used as
+* reference by the sequential finalize (ctx->fFinalizeSequential).
+* -- ctx
+* -- peNtfs
+* -- iMap
+* -- iDirDepth
+* -- wszPath
+* -- cwszPath
+* -- return = next map index.
+*/
+DWORD FcNtfs_SetupFinalize_SetupFinishSequential(_In_ PFCNTFS_FINALIZE_CONTEXT ctx, _In_ PFCNTFS peNtfs, _In_ DWORD iMap, _In_ BYTE iDirDepth, _In_reads_(2048) LPWSTR wszPath, _In_ DWORD cwszPath)
+{
+    DWORD cwszName;
+    while(peNtfs) {
+        // update/set path
+        cwszName = (DWORD)wcslen(peNtfs->wszName);
+        if(cwszPath + cwszName + 2 >= 2048) { break; }
+        wszPath[cwszPath] = '\\';
+        memcpy(&wszPath[cwszPath + 1], peNtfs->wszName, ((QWORD)cwszName << 1) + 2);
+        FcNtfs_SetupFinalize_HashEntry(ctx->psObHashPath, peNtfs);
+        peNtfs->iDirDepth = iDirDepth;
+        peNtfs->iMap = iMap++;
+        FcNtfs_SetupFinalize_DatabaseAdd(ctx, peNtfs, wszPath, cwszPath + 1);
+        iMap = FcNtfs_SetupFinalize_SetupFinishSequential(ctx, peNtfs->pChild, iMap, iDirDepth + 1, wszPath, cwszPath + cwszName + 1);
+        peNtfs = peNtfs->pSibling;
+    }
+    wszPath[cwszPath] = 0;
+    return iMap;
+}
+#endif /* VMM_TEST_SELFTEST */
+
 VOID FcNtfs_SetupFinalize_AddToParent(_In_ PFCNTFS pNtfsParent, _In_ PFCNTFS pNtfs)
 {
     pNtfs->pParent = pNtfsParent;
@@ -886,18 +1577,21 @@ VOID FcNtfs_SetupFinalize_MergeFinalTree(_In_ PFCNTFS_CONTEXT_IDFS_LISTENTRY pLi
 VOID FcNtfs_SetupFinalize(_In_opt_ PVOID pvSetupContextNtfs, _In_ BOOL fScanSuccess)
 {
     PFCNTFS_SETUP_CONTEXT ctx = (PFCNTFS_SETUP_CONTEXT)pvSetupContextNtfs;
-    DWORD i, iNtfsDummy = 0, iFileSystem = 0;
+    DWORD i, iNtfsDummy = 0, iFileSystem = 0, dwIdFsMerge;
     PFCNTFS pNtfsGlobalRoot, pNtfsGlobalOrphan, pNtfsFsRoot, pNtfsFsOrphan;
     PFCNTFS_CONTEXT_IDFS_LISTENTRY pFsList, pFsListMerge;
-    POB_SET psObHashPath = NULL;
+    PFCNTFS_FINALIZE_SUBTREE pSub;
+    PVMMOB_WORK_GROUP pObWorkGroup = NULL;
+    QWORD tcStart = GetTickCount64();
     WCHAR wszBuffer1[MAX_PATH], wszBuffer2[MAX_PATH];
     WCHAR wszPath[2048] = { 0 };
     FCNTFS_FINALIZE_CONTEXT ctxFinal = { 0 };
-    int rc;
     if(!ctx) { return; }
     if(!fScanSuccess) { goto fail; }
+    // merge parsed MFT records from the physical memory scan into the dataset
+    FcNtfs_SetupMerge(ctx);
     // initialize general
-    if(!(psObHashPath = ObSet_New())) { goto fail; }
+    if(!(ctxFinal.psObHashPath = ObSet_New())) { goto fail; }
     // initialize virtual root
     pNtfsGlobalRoot = FcNtfs_SetupCreateEntry(ctx, --iNtfsDummy, L"", 0, TRUE);
     pNtfsGlobalOrphan = FcNtfs_SetupCreateEntry(ctx, --iNtfsDummy, L"u0", 8, TRUE);
@@ -905,6 +1599,7 @@ VOID FcNtfs_SetupFinalize(_In_opt_ PVOID pvSetupContextNtfs, _In_ BOOL fScanSucc
     // allocate arrays for counting and sorting
     if(!(ctx->pListsCounter = LocalAlloc(LMEM_ZEROINIT, ctx->dwLastIdFs * sizeof(FCNTFS_CONTEXT_COUNTER)))) { goto fail; }
     if(!(ctx->ppListsSorted = LocalAlloc(LMEM_ZEROINIT, ctx->dwLastIdFs * sizeof(PFCNTFS_CONTEXT_COUNTER)))) { goto fail; }
+    if(!(ctx->pdwListsCounterTouched = LocalAlloc(0, ctx->dwLastIdFs * sizeof(DWORD)))) { goto fail; }
     // COMPACT INITIAL & MERGE SINGLE
     for(i = 0; i < ctx->dwLastIdFs; i++) {
         if((pFsList = ObMap_GetByKey(ctx->pmFs, i))) {
@@ -922,18 +1617,35 @@ VOID FcNtfs_SetupFinalize(_In_opt_ PVOID pvSetupContextNtfs, _In_ BOOL fScanSucc
             );
         }
     }
+    // COMPACT (PARALLEL - NO MERGES ONGOING SO FRAGMENTS ARE INDEPENDENT)
     for(i = 0; i < ctx->dwLastIdFs; i++) {
-        if((pFsList = ObMap_GetByKey(ctx->pmFs, i))) {
-            FcNtfs_SetupFinalize_Compact(ctx, pFsList);
-            ctx->ppListsSorted[i] = pFsList;
+        ctx->ppListsSorted[i] = ObMap_GetByKey(ctx->pmFs, i);
+    }
+    if(FCNTFS_FINALIZE_SEQUENTIAL(ctx)) {
+        for(i = 0; i < ctx->dwLastIdFs; i++) {
+            FcNtfs_SetupFinalize_Compact(ctx, ctx->ppListsSorted[i]);
+        }
+    } else {
+        if(!(pObWorkGroup = VmmWorkGroup_New())) { goto fail; }
+        ctx->iListsCompact = ctx->dwLastIdFs;
+        for(i = 0; i < ctx->dwLastIdFs; i++) {
+            VmmWorkGroup_Add(pObWorkGroup, (LPTHREAD_START_ROUTINE)FcNtfs_SetupFinalize_Compact_ThreadProc, ctx);
         }
+        VmmWorkGroup_Join(pObWorkGroup);
     }
     qsort(ctx->ppListsSorted, ctx->dwLastIdFs, sizeof(PFCNTFS_CONTEXT_IDFS_LISTENTRY), FcNtfs_SetupFinalize_CmpFsListEntry);
     // COMPACT AND MERGE AS MUCH AS POSSIBLE
     for(i = 0; i < ctx->dwLastIdFs; i++) {
         pFsList = ctx->ppListsSorted[i];
         if(pFsList->cAll) {
-            if((pFsListMerge = ObMap_GetByKey(ctx->pmFs, FcNtfs_SetupFinalize_MergeFind(ctx, pFsList->pAll->Setup.dwIdFs)))) {
+#ifdef VMM_TEST_SELFTEST
+            dwIdFsMerge = ctx->fFinalizeSequential ?
+                FcNtfs_SetupFinalize_MergeFindSequential(ctx, pFsList->pAll->Setup.dwIdFs) :
+                FcNtfs_SetupFinalize_MergeFind(ctx, pFsList->pAll->Setup.dwIdFs);
+#else
+            dwIdFsMerge = FcNtfs_SetupFinalize_MergeFind(ctx, pFsList->pAll->Setup.dwIdFs);
+#endif /* VMM_TEST_SELFTEST */
+            if((pFsListMerge = ObMap_GetByKey(ctx->pmFs, dwIdFsMerge))) {
                 FcNtfs_SetupFinalize_Merge(ctx, pFsListMerge, pFsList);
                 FcNtfs_SetupFinalize_Compact(ctx, pFsListMerge);
             }
@@ -966,28 +1678,737 @@ VOID FcNtfs_SetupFinalize(_In_opt_ PVOID pvSetupContextNtfs, _In_ BOOL fScanSucc
         }
     }
     // SETUP FINISH:
-    if(!(ctxFinal.hSql = Fc_SqlReserve())) { goto fail; }
-    rc = sqlite3_prepare_v2(ctxFinal.hSql, 
-        "INSERT INTO ntfs " \
-        "(id, id_parent, id_str, hash, hash_parent, addr_phys, inode, mft_flags, depth, size_file, size_fileres, time_create, time_modify, time_read, name_seq, oln_u, oln_j) " \
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);"
-        , -1, &ctxFinal.st, NULL);
-    if(rc != SQLITE_OK) { goto fail; }
-    rc = sqlite3_prepare_v2(ctxFinal.hSql, "INSERT INTO str (id, osz, csz, cbu, cbj, sz) VALUES (?, ?, ?, ?, ?, ?);", -1, &ctxFinal.st_str, NULL);
-    if(rc != SQLITE_OK) { goto fail; }
-    sqlite3_exec(ctxFinal.hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
-    DWORD DEBUG_NUM = FcNtfs_SetupFinalize_SetupFinish(&ctxFinal, psObHashPath, pNtfsGlobalRoot, 0, 0, wszPath, 0);
-    sqlite3_exec(ctxFinal.hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
+#ifdef VMM_TEST_SELFTEST
+    ctxFinal.pSelfTest = ctx->pSelfTestFinalize;
+#endif /* VMM_TEST_SELFTEST */
+    if(!FCNTFS_FINALIZE_SELFTEST(&ctxFinal)) {
+        ctxFinal.hBulk = Fc_SqlBulkInitialize(
+            "ntfs",
+            "id, id_parent, id_str, hash, hash_parent, addr_phys, inode, mft_flags, depth, size_file, size_fileres, time_create, time_modify, time_read, name_seq, oln_u, oln_j",
+            17);
+        if(!ctxFinal.hBulk) { goto fail; }
+    }
+#ifdef VMM_TEST_SELFTEST
+    if(ctx->fFinalizeSequential) {
+        FcNtfs_SetupFinalize_SetupFinishSequential(&ctxFinal, pNtfsGlobalRoot, 0, 0, wszPath, 0);
+    } else
+#endif /* VMM_TEST_SELFTEST */
+    {
+        if(!FcNtfs_SetupFinalize_Hash(&ctxFinal, pNtfsGlobalRoot)) { goto fail; }
+        FcNtfs_SetupFinalize_SetupFinish(&ctxFinal, pNtfsGlobalRoot, 0, 0, wszPath, 0);
+    }
+    Fc_SqlBulkClose(ctxFinal.hBulk);
+    ctxFinal.hBulk = NULL;
+    vmmprintfv_fn("%i sub-trees hashed in parallel, %lli ms.\n", ctxFinal.cSub, GetTickCount64() - tcStart);
     // MARK AS FINISHED AND CLEAN UP:
-    ctxFc->fEnableNtfs = TRUE;
+    if(!FCNTFS_FINALIZE_SELFTEST(&ctxFinal)) {
+        ctxFc->fEnableNtfs = TRUE;
+    }
+fail:
+    Fc_SqlBulkClose(ctxFinal.hBulk);
+    while((pSub = ctxFinal.pSubHead)) {
+        ctxFinal.pSubHead = pSub->FLink;
+        Ob_DECREF(pSub->psObHashPath);
+        LocalFree(pSub);
+    }
+    LocalFree(ctxFinal.ppSub);
+    Ob_DECREF(ctxFinal.psObHashPath);
+    Ob_DECREF(pObWorkGroup);
+    FcNtfs_SetupClose(ctx);
+}
+
+
+
+#ifdef VMM_TEST_SELFTEST
+//-----------------------------------------------------------------------------
+// MFT RECORD CARVING SELF TEST BELOW (VMM_TEST_SELFTEST builds only):
+// A synthetic 16MB scan chunk of random data is planted with known records -
+// valid records in the in-memory and on-disk (update sequence protected) form
+// and records which must be rejected: torn, misplaced, extension records, no
+// file name, MFT record number zero, records in unreadable pages and 'FILE'
+// signatures at unaligned offsets. Every signature scan implementation must
+// produce the planted signature mask (also for non-contiguous page buffers)
+// and the records carved single- and multi-threaded must equal the planted
+// valid records.
+//-----------------------------------------------------------------------------
+
+#define FCNTFS_SELFTEST_PABASE              0x0000000100000000
+#define FCNTFS_SELFTEST_THREADS             8
+#define FCNTFS_SELFTEST_SCAN_ITERATIONS     64
+#define FCNTFS_SELFTEST_MISMATCH_TEXT_MAX   16
+
+typedef struct tdFCNTFS_SELFTEST_EXPECT {
+    QWORD pa;
+    DWORD dwMftRecordNumber;
+    DWORD dwIdParent;
+    DWORD cbData;
+    BOOL fDir;
+    WCHAR wszName[32];
+} FCNTFS_SELFTEST_EXPECT, *PFCNTFS_SELFTEST_EXPECT;
+
+typedef struct tdFCNTFS_SELFTEST_IMAGE {
+    PBYTE pb;
+    PMEM_SCATTER pMEMs;
+    POB_FC_SCANPHYSMEM_CHUNK pc;                // page buffers contiguous in memory
+    POB_FC_SCANPHYSMEM_CHUNK pcReverse;         // page buffers in reverse order (non-contiguous)
+    BYTE pbMask[FC_PHYSMEM_NUM_CHUNKS];         // planted 'FILE' signature mask per page
+    DWORD cExpect;
+    FCNTFS_SELFTEST_EXPECT Expect[FC_PHYSMEM_NUM_CHUNKS * 4];
+} FCNTFS_SELFTEST_IMAGE, *PFCNTFS_SELFTEST_IMAGE;
+
+typedef struct tdFCNTFS_SELFTEST_THREAD {
+    PFCNTFS_SETUP_CONTEXT ctx;
+    POB_FC_SCANPHYSMEM_CHUNK pc;
+    DWORD iPage;
+    DWORD cPage;
+} FCNTFS_SELFTEST_THREAD, *PFCNTFS_SELFTEST_THREAD;
+
+VOID FcNtfs_SelfTest_Mismatch(_Inout_ PFCNTFS_SELFTEST_RESULT pr, _In_z_ _Printf_format_string_ LPSTR szFormat, ...)
+{
+    int cch;
+    va_list args;
+    if(pr->cMismatchText >= FCNTFS_SELFTEST_MISMATCH_TEXT_MAX) { return; }
+    pr->cMismatchText++;
+    va_start(args, szFormat);
+    cch = _vsnprintf_s(pr->szMismatch + pr->cchMismatch, sizeof(pr->szMismatch) - pr->cchMismatch, _TRUNCATE, szFormat, args);
+    va_end(args);
+    pr->cchMismatch = (cch < 0) ? (sizeof(pr->szMismatch) - 1) : (pr->cchMismatch + cch);
+}
+
+QWORD FcNtfs_SelfTest_TimeUs()
+{
+    LARGE_INTEGER qwFreq, qwNow;
+    QueryPerformanceFrequency(&qwFreq);
+    QueryPerformanceCounter(&qwNow);
+    return (qwNow.QuadPart / qwFreq.QuadPart) * 1000000 + (qwNow.QuadPart % qwFreq.QuadPart) * 1000000 / qwFreq.QuadPart;
+}
+
+/*
+* Write a synthetic 1kB MFT record with $STANDARD_INFORMATION, $FILE_NAME and
+* (files only) resident $DATA attributes.
+* -- pb
+* -- dwMft
+* -- dwParent
+* -- wszName
+* -- fDir
+* -- cbData = resident data size (files only).
+* -- fProtected = on-disk form with the update sequence applied to the sectors.
+* -- fDosName = add a DOS namespace file name before the win32 file name.
+*/
+VOID FcNtfs_SelfTest_Record(_Out_writes_(0x400) PBYTE pb, _In_ DWORD dwMft, _In_ DWORD dwParent, _In_ LPWSTR wszName, _In_ BOOL fDir, _In_ DWORD cbData, _In_ BOOL fProtected, _In_ BOOL fDosName)
+{
+    DWORD i, o, cwszName;
+    LPWSTR wszNameAttr;
+    PWORD pwUsa;
+    PNTFS_ATTR pa;
+    PNTFS_FILE_NAME pfn;
+    PNTFS_STANDARD_INFORMATION psi;
+    PNTFS_FILE_RECORD pr = (PNTFS_FILE_RECORD)pb;
+    ZeroMemory(pb, 0x400);
+    pr->Signature = 'ELIF';
+    pr->UpdateSequenceArrayOffset = 0x30;
+    pr->UpdateSequenceArraySize = 3;
+    pr->LogFileSequenceNumber = 0x10000000 + dwMft;
+    pr->SequenceNumber = 1;
+    pr->HardLinkCount = 1;
+    pr->FirstAttributeOffset = 0x38;
+    pr->Flags = fDir ? 0x03 : 0x01;
+    pr->AllocatedSize = 0x400;
+    pr->MftRecordNumber = dwMft;
+    o = 0x38;
+    // $STANDARD_INFORMATION
+    pa = (PNTFS_ATTR)(pb + o);
+    pa->Type = NTFS_ATTR_TYPE_STANDARD_INFORMATION;
+    pa->AttrOffset = sizeof(NTFS_ATTR);
+    pa->AttrLength = sizeof(NTFS_STANDARD_INFORMATION);
+    pa->Length = sizeof(NTFS_ATTR) + sizeof(NTFS_STANDARD_INFORMATION);
+    psi = (PNTFS_STANDARD_INFORMATION)(pb + o + sizeof(NTFS_ATTR));
+    psi->TimeCreate = 0x01d6000000000000 + dwMft;
+    psi->TimeModify = psi->TimeCreate + 1;
+    psi->TimeRead = psi->TimeCreate + 2;
+    o += pa->Length;
+    // $FILE_NAME (dos and/or win32 namespace)
+    for(i = fDosName ? 0 : 1; i < 2; i++) {
+        wszNameAttr = i ? wszName : L"MTEST~1.DAT";
+        cwszName = (DWORD)wcslen(wszNameAttr);
+        pa = (PNTFS_ATTR)(pb + o);
+        pa->Type = NTFS_ATTR_TYPE_FILE_NAME;
+        pa->AttrOffset = sizeof(NTFS_ATTR);
+        pa->AttrLength = 0x42 + cwszName * sizeof(WCHAR);
+        pa->Length = (sizeof(NTFS_ATTR) + pa->AttrLength + 7) & ~7;
+        pfn = (PNTFS_FILE_NAME)(pb + o + sizeof(NTFS_ATTR));
+        pfn->ParentDirectory.SegmentNumber = dwParent;
+        pfn->ParentDirectory.SequenceNumber = 1;
+        pfn->SizeReal = fDir ? 0 : cbData;
+        pfn->SizeAllocated = fDir ? 0 : ((cbData + 7) & ~7);
+        pfn->NameLength = (BYTE)cwszName;
+        pfn->NameSpace = i ? NTFS_FILENAME_NAMESPACE_WIN32 : NTFS_FILENAME_NAMESPACE_DOS;
+        memcpy(pfn->Name, wszNameAttr, cwszName * sizeof(WCHAR));
+        o += pa->Length;
+    }
+    // $DATA (resident)
+    if(!fDir) {
+        pa = (PNTFS_ATTR)(pb + o);
+        pa->Type = NTFS_ATTR_TYPE_DATA;
+        pa->AttrOffset = sizeof(NTFS_ATTR);
+        pa->AttrLength = cbData;
+        pa->Length = (sizeof(NTFS_ATTR) + cbData + 7) & ~7;
+        memset(pb + o + sizeof(NTFS_ATTR), 'A' + (dwMft % 26), cbData);
+        o += pa->Length;
+    }
+    *(PDWORD)(pb + o) = 0xffffffff;
+    pr->RealSize = o + 8;
+    // update sequence array
+    pwUsa = (PWORD)(pb + pr->UpdateSequenceArrayOffset);
+    pwUsa[0] = 0x0017;
+    if(fProtected) {
+        for(i = 1; i <= 2; i++) {
+            pwUsa[i] = *(PWORD)(pb + i * 0x200 - 2);
+            *(PWORD)(pb + i * 0x200 - 2) = pwUsa[0];
+        }
+    }
+}
+
+/*
+* Plant a valid record and add it to the expected records if its page is
+* readable.
+*/
+VOID FcNtfs_SelfTest_PlantValid(_Inout_ PFCNTFS_SELFTEST_IMAGE pi, _In_ DWORD iPage, _In_ DWORD iSlot, _In_ DWORD dwParent, _In_ BOOL fDir, _In_ BOOL fProtected, _In_ BOOL fDosName)
+{
+    PFCNTFS_SELFTEST_EXPECT pe = pi->Expect + pi->cExpect;
+    DWORD dwMft = ((iPage << 2) | iSlot) + 0x40;
+    ZeroMemory(pe, sizeof(FCNTFS_SELFTEST_EXPECT));
+    pe->pa = FCNTFS_SELFTEST_PABASE + ((QWORD)iPage << 12) + ((QWORD)iSlot << 10);
+    pe->dwMftRecordNumber = dwMft;
+    pe->dwIdParent = dwParent;
+    pe->fDir = fDir;
+    pe->cbData = fDir ? 0 : (1 + (dwMft * 13) % 0x100);
+    if(fDir) {
+        _snwprintf_s(pe->wszName, _countof(pe->wszName), _TRUNCATE, L"mtest_dir_%05x", iPage);
+    } else {
+        _snwprintf_s(pe->wszName, _countof(pe->wszName), _TRUNCATE, L"mtest_file_%05x_%i.dat", iPage, iSlot);
+    }
+    FcNtfs_SelfTest_Record(pi->pb + ((QWORD)iPage << 12) + ((QWORD)iSlot << 10), dwMft, dwParent, pe->wszName, fDir, pe->cbData, fProtected, fDosName);
+    pi->pbMask[iPage] |= 1 << iSlot;
+    if(pi->pMEMs[iPage].f) {
+        pi->cExpect++;
+    }
+}
+
+/*
+* Create the synthetic image. Page layout by (page index % 8):
+* 0 = four valid in-memory records: a directory and three files within it.
+* 1 = two valid protected records in slots 1 and 3, random data in 0 and 2.
+* 2 = rejected: torn, misplaced record number, extension record, no file name.
+* 3 = 'FILE' signatures at unaligned offsets only.
+* 4 = valid protected record with a dos name in slot 2, record number 0 in slot 0.
+* 5-7 = random data.
+* Every 64th page of type 0 is unreadable.
+*/
+_Success_(return)
+BOOL FcNtfs_SelfTest_Image(_Out_ PFCNTFS_SELFTEST_IMAGE pi, _Out_ PDWORD pcTornExpect)
+{
+    DWORD i, j, dwMft;
+    PDWORD pdw;
+    PBYTE pbRecord;
+    QWORD qwSeed = 0x4e5446535f4d4654;
+    *pcTornExpect = 0;
+    if(!(pi->pb = LocalAlloc(0, FC_PHYSMEM_NUM_CHUNKS << 12))) { return FALSE; }
+    if(!(pi->pMEMs = LocalAlloc(LMEM_ZEROINIT, FC_PHYSMEM_NUM_CHUNKS * sizeof(MEM_SCATTER)))) { return FALSE; }
+    if(!(pi->pc = LocalAlloc(LMEM_ZEROINIT, sizeof(OB_FC_SCANPHYSMEM_CHUNK)))) { return FALSE; }
+    if(!(pi->pcReverse = LocalAlloc(LMEM_ZEROINIT, sizeof(OB_FC_SCANPHYSMEM_CHUNK)))) { return FALSE; }
+    if(!(pi->pc->ppMEMs = LocalAlloc(0, FC_PHYSMEM_NUM_CHUNKS * sizeof(PMEM_SCATTER)))) { return FALSE; }
+    if(!(pi->pcReverse->ppMEMs = LocalAlloc(0, FC_PHYSMEM_NUM_CHUNKS * sizeof(PMEM_SCATTER)))) { return FALSE; }
+    pi->pc->paBase = FCNTFS_SELFTEST_PABASE;
+    pi->pcReverse->paBase = FCNTFS_SELFTEST_PABASE;
+    // random data without aligned signatures:
+    for(i = 0; i < (FC_PHYSMEM_NUM_CHUNKS << 12) / sizeof(QWORD); i++) {
+        qwSeed ^= qwSeed << 13;
+        qwSeed ^= qwSeed >> 7;
+        qwSeed ^= qwSeed << 17;
+        ((PQWORD)pi->pb)[i] = qwSeed;
+    }
+    for(i = 0; i < FC_PHYSMEM_NUM_CHUNKS * 4; i++) {
+        pdw = (PDWORD)(pi->pb + ((QWORD)i << 10));
+        if(*pdw == 'ELIF') { *pdw ^= 1; }
+    }
+    for(i = 0; i < FC_PHYSMEM_NUM_CHUNKS; i++) {
+        pi->pMEMs[i].version = MEM_SCATTER_VERSION;
+        pi->pMEMs[i].qwA = FCNTFS_SELFTEST_PABASE + ((QWORD)i << 12);
+        pi->pMEMs[i].cb = 0x1000;
+        pi->pMEMs[i].pb = pi->pb + ((QWORD)i << 12);
+        pi->pMEMs[i].f = ((i % 64) != 56);
+        pi->pc->ppMEMs[i] = pi->pMEMs + i;
+        pi->pcReverse->ppMEMs[i] = pi->pMEMs + (FC_PHYSMEM_NUM_CHUNKS - 1 - i);
+    }
+    // planted records:
+    for(i = 0; i < FC_PHYSMEM_NUM_CHUNKS; i++) {
+        switch(i % 8) {
+            case 0:
+                FcNtfs_SelfTest_PlantValid(pi, i, 0, 5, TRUE, FALSE, FALSE);
+                for(j = 1; j < 4; j++) {
+                    FcNtfs_SelfTest_PlantValid(pi, i, j, ((i << 2) | 0) + 0x40, FALSE, FALSE, FALSE);
+                }
+                break;
+            case 1:
+                FcNtfs_SelfTest_PlantValid(pi, i, 1, 5, FALSE, TRUE, FALSE);
+                FcNtfs_SelfTest_PlantValid(pi, i, 3, 5, TRUE, TRUE, FALSE);
+                break;
+            case 2:
+                for(j = 0; j < 4; j++) {
+                    dwMft = ((i << 2) | j) + 0x40;
+                    pbRecord = pi->pb + ((QWORD)i << 12) + ((QWORD)j << 10);
+                    FcNtfs_SelfTest_Record(pbRecord, (j == 1) ? (dwMft ^ 1) : dwMft, 5, L"mtest_rejected.dat", (j == 3), 0x10, (j == 0), FALSE);
+                    pi->pbMask[i] |= 1 << j;
+                    if(j == 0) {
+                        *(PWORD)(pbRecord + 0x3fe) ^= 0xffff;       // torn: 2nd sector not updated
+                        (*pcTornExpect)++;
+                    }
+                    if(j == 2) {
+                        ((PNTFS_FILE_RECORD)pbRecord)->BaseFileRecordSegment.SegmentNumber = 7;
+                    }
+                    if(j == 3) {
+                        *(PDWORD)(pbRecord + 0x38 + 0x60) = NTFS_ATTR_TYPE_OBJECT_ID;
+                    }
+                }
+                break;
+            case 3:
+                *(PDWORD)(pi->pb + ((QWORD)i << 12) + 0x200) = 'ELIF';
+                *(PDWORD)(pi->pb + ((QWORD)i << 12) + 0x604) = 'ELIF';
+                break;
+            case 4:
+                FcNtfs_SelfTest_PlantValid(pi, i, 2, 5, FALSE, TRUE, TRUE);
+                FcNtfs_SelfTest_Record(pi->pb + ((QWORD)i << 12), 0, 5, L"mtest_rejected.dat", FALSE, 0x10, FALSE, FALSE);
+                pi->pbMask[i] |= 1;
+                break;
+        }
+    }
+    return TRUE;
+}
+
+VOID FcNtfs_SelfTest_ImageFree(_In_ PFCNTFS_SELFTEST_IMAGE pi)
+{
+    if(pi->pc) { LocalFree(pi->pc->ppMEMs); }
+    if(pi->pcReverse) { LocalFree(pi->pcReverse->ppMEMs); }
+    LocalFree(pi->pc);
+    LocalFree(pi->pcReverse);
+    LocalFree(pi->pMEMs);
+    LocalFree(pi->pb);
+}
+
+DWORD WINAPI FcNtfs_SelfTest_ThreadProc(_In_ PFCNTFS_SELFTEST_THREAD pt)
+{
+    FcNtfs_SetupChunk(pt->ctx, pt->pc, pt->iPage, pt->cPage);
+    return 0;
+}
+
+/*
+* Carve the image single-threaded (iMode = 0) or split over worker threads
+* (iMode = 1) and compare the carved records with the expected records.
+*/
+VOID FcNtfs_SelfTest_Carve(_In_ PFCNTFS_SELFTEST_IMAGE pi, _In_ DWORD iMode, _Inout_ PFCNTFS_SELFTEST_RESULT pr)
+{
+    DWORD i, o, iRecord = 0, iExpect = 0, cRecord = 0;
+    QWORD tmStart;
+    HANDLE hThread[FCNTFS_SELFTEST_THREADS] = { 0 };
+    FCNTFS_SELFTEST_THREAD Thread[FCNTFS_SELFTEST_THREADS];
+    PFCNTFS_SETUP_CONTEXT ctx = NULL;
+    PFCNTFS_SETUP_BLOCK pBlock;
+    PFCNTFS_SETUP_RECORD pe, *ppRecords = NULL;
+    PFCNTFS_SELFTEST_EXPECT px;
+    LPSTR szMode = iMode ? "multi-threaded" : "single-threaded";
+    if(!(ctx = FcNtfs_SetupInitialize())) { goto fail; }
+    tmStart = FcNtfs_SelfTest_TimeUs();
+    if(iMode) {
+        for(i = 0; i < FCNTFS_SELFTEST_THREADS; i++) {
+            Thread[i].ctx = ctx;
+            Thread[i].pc = pi->pc;
+            Thread[i].cPage = FC_PHYSMEM_NUM_CHUNKS / FCNTFS_SELFTEST_THREADS;
+            Thread[i].iPage = i * Thread[i].cPage;
+            if(!(hThread[i] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)FcNtfs_SelfTest_ThreadProc, Thread + i, 0, NULL))) {
+                FcNtfs_SelfTest_ThreadProc(Thread + i);
+            }
+        }
+        for(i = 0; i < FCNTFS_SELFTEST_THREADS; i++) {
+            if(hThread[i]) {
+                WaitForSingleObject(hThread[i], INFINITE);
+                CloseHandle(hThread[i]);
+            }
+        }
+    } else {
+        FcNtfs_SetupChunk(ctx, pi->pc, 0, FC_PHYSMEM_NUM_CHUNKS);
+    }
+    pr->Carve[iMode].tmUs = FcNtfs_SelfTest_TimeUs() - tmStart;
+    pr->Carve[iMode].cTorn = ctx->cTorn;
+    // collect the carved records in physical address order:
+    for(pBlock = ctx->pBlockHead; pBlock; pBlock = pBlock->FLink) {
+        cRecord += pBlock->cRecord;
+    }
+    pr->Carve[iMode].cCarved = cRecord;
+    if(cRecord) {
+        if(!(ppRecords = LocalAlloc(0, cRecord * sizeof(PFCNTFS_SETUP_RECORD)))) { goto fail; }
+        for(pBlock = ctx->pBlockHead; pBlock; pBlock = pBlock->FLink) {
+            for(i = 0, o = 0; i < pBlock->cRecord; i++) {
+                pe = (PFCNTFS_SETUP_RECORD)(pBlock->pb + o);
+                ppRecords[iRecord++] = pe;
+                o += (sizeof(FCNTFS_SETUP_RECORD) + pe->cwszName * sizeof(WCHAR) + 7) & ~7;
+            }
+        }
+        qsort(ppRecords, cRecord, sizeof(PFCNTFS_SETUP_RECORD), FcNtfs_SetupMerge_CmpRecord);
+    }
+    // compare with the expected records:
+    iRecord = 0;
+    while((iRecord < cRecord) || (iExpect < pi->cExpect)) {
+        pe = (iRecord < cRecord) ? ppRecords[iRecord] : NULL;
+        px = (iExpect < pi->cExpect) ? (pi->Expect + iExpect) : NULL;
+        if(pe && (!px || (pe->pa < px->pa))) {
+            pr->Carve[iMode].cFalse++;
+            FcNtfs_SelfTest_Mismatch(pr, "%s: false record  pa=%llx mft=%x\n", szMode, pe->pa, pe->dwMftRecordNumber);
+            iRecord++;
+            continue;
+        }
+        if(!pe || (px->pa < pe->pa)) {
+            pr->Carve[iMode].cMissing++;
+            FcNtfs_SelfTest_Mismatch(pr, "%s: missing record pa=%llx mft=%x %S\n", szMode, px->pa, px->dwMftRecordNumber, px->wszName);
+            iExpect++;
+            continue;
+        }
+        if((pe->dwMftRecordNumber != px->dwMftRecordNumber) || (pe->dwIdParent != px->dwIdParent) ||
+            (pe->cwszName != wcslen(px->wszName)) || memcmp(pe->wszName, px->wszName, pe->cwszName * sizeof(WCHAR)) ||
+            ((pe->Flags & 0x02) ? !px->fDir : px->fDir) || (pe->cbFileSize != px->cbData) || (pe->cbFileSizeMftResident != px->cbData) ||
+            (pe->ftCreate != 0x01d6000000000000 + px->dwMftRecordNumber) || (pe->qwLogFileSequenceNumber != 0x10000000 + px->dwMftRecordNumber)) {
+            pr->Carve[iMode].cFieldMismatch++;
+            FcNtfs_SelfTest_Mismatch(pr, "%s: field mismatch pa=%llx mft=%x/%x parent=%x/%x size=%llx/%x %S\n", szMode, px->pa, pe->dwMftRecordNumber, px->dwMftRecordNumber, pe->dwIdParent, px->dwIdParent, pe->cbFileSize, px->cbData, px->wszName);
+        }
+        iRecord++;
+        iExpect++;
+    }
+    // merge into the dataset - the file system fragments must not depend on threading:
+    FcNtfs_SetupMerge(ctx);
+    pr->Carve[iMode].cEntry = ObMap_Size(ctx->pmId);
+    pr->Carve[iMode].cFs = ObMap_Size(ctx->pmFs);
 fail:
-    sqlite3_finalize(ctxFinal.st);
-    sqlite3_finalize(ctxFinal.st_str);
-    Fc_SqlReserveReturn(ctxFinal.hSql);
-    Ob_DECREF(psObHashPath);
+    LocalFree(ppRecords);
     FcNtfs_SetupClose(ctx);
 }
 
+/*
+* Run the MFT record carving self test on a synthetic image. Test builds only
+* (VMM_TEST_SELFTEST).
+* -- cIterScan = # of signature scan benchmark iterations, 0 = default.
+* -- pr
+* -- return = TRUE if the test ran (check the mismatch counters).
+*/
+_Success_(return)
+BOOL FcNtfs_SelfTest_Carving(_In_ DWORD cIterScan, _Out_ PFCNTFS_SELFTEST_RESULT pr)
+{
+    BOOL fResult = FALSE;
+    DWORD i, iScan, iIter;
+    QWORD tmStart;
+    BYTE pbMask[FC_PHYSMEM_NUM_CHUNKS];
+    PFCNTFS_SELFTEST_IMAGE pi = NULL;
+    PFCNTFS_SETUP_SCAN_PFN pfnSelect, pfnScan[3] = { FcNtfs_SetupScan_Scalar, FcNtfs_SetupScan_Sse2, FcNtfs_SetupScan_Avx2 };
+    LPSTR szScan[3] = { "scalar", "sse2", "avx2" };
+    ZeroMemory(pr, sizeof(FCNTFS_SELFTEST_RESULT));
+    pr->cIterScan = cIterScan = cIterScan ? cIterScan : FCNTFS_SELFTEST_SCAN_ITERATIONS;
+    pr->cPage = FC_PHYSMEM_NUM_CHUNKS;
+    if(!(pi = LocalAlloc(LMEM_ZEROINIT, sizeof(FCNTFS_SELFTEST_IMAGE)))) { goto fail; }
+    if(!FcNtfs_SelfTest_Image(pi, &pr->cTornExpect)) { goto fail; }
+    pr->cRecordExpect = pi->cExpect;
+    // signature scan implementations:
+    pfnSelect = FcNtfs_SetupScan_Select();
+    for(iScan = 0; iScan < 3; iScan++) {
+        strcpy_s(pr->Scan[iScan].szName, sizeof(pr->Scan[iScan].szName), szScan[iScan]);
+        pr->Scan[iScan].fSelected = (pfnScan[iScan] == pfnSelect);
+        switch(iScan) {
+            case 0: pr->Scan[iScan].fAvailable = TRUE; break;
+            case 1: pr->Scan[iScan].fAvailable = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE); break;
+            case 2: pr->Scan[iScan].fAvailable = (pfnSelect == FcNtfs_SetupScan_Avx2); break;
+        }
+        if(!pr->Scan[iScan].fAvailable) { continue; }
+        tmStart = FcNtfs_SelfTest_TimeUs();
+        for(iIter = 0; iIter < cIterScan; iIter++) {
+            pfnScan[iScan](pi->pc, 0, FC_PHYSMEM_NUM_CHUNKS, pbMask);
+        }
+        pr->Scan[iScan].tmUs = max(1, FcNtfs_SelfTest_TimeUs() - tmStart);
+        for(i = 0; i < FC_PHYSMEM_NUM_CHUNKS; i++) {
+            if(pbMask[i] != pi->pbMask[i]) {
+                pr->Scan[iScan].cMaskMismatch++;
+                FcNtfs_SelfTest_Mismatch(pr, "%s: mask mismatch page=%x mask=%x expected=%x\n", szScan[iScan], i, pbMask[i], pi->pbMask[i]);
+            }
+        }
+        // non-contiguous page buffers, and a chunk part not starting at page zero:
+        pfnScan[iScan](pi->pcReverse, 1, FC_PHYSMEM_NUM_CHUNKS - 1, pbMask);
+        for(i = 0; i < FC_PHYSMEM_NUM_CHUNKS - 1; i++) {
+            if(pbMask[i] != pi->pbMask[FC_PHYSMEM_NUM_CHUNKS - 2 - i]) {
+                pr->Scan[iScan].cMaskMismatch++;
+                FcNtfs_SelfTest_Mismatch(pr, "%s: non-contiguous mask mismatch page=%x mask=%x expected=%x\n", szScan[iScan], i, pbMask[i], pi->pbMask[FC_PHYSMEM_NUM_CHUNKS - 2 - i]);
+            }
+        }
+    }
+    // record carving:
+    FcNtfs_SelfTest_Carve(pi, 0, pr);
+    FcNtfs_SelfTest_Carve(pi, 1, pr);
+    fResult = TRUE;
+fail:
+    if(pi) { FcNtfs_SelfTest_ImageFree(pi); }
+    LocalFree(pi);
+    return fResult;
+}
+
+// ----------------------------------------------------------------------------
+// MFT TREE RECONSTRUCTION SELF TEST BELOW (VMM_TEST_SELFTEST builds only):
+// Synthetic MFT record sets of multiple volumes with overlapping MFT record
+// numbers are laid out 4 records per page with the pages shuffled across the
+// physical address space (each page becomes a file system fragment). The sets
+// contain missing records (orphans), duplicate record copies, parents which are
+// files, name collisions within a directory and paths above the length cut-off.
+// FcNtfs_SetupFinalize is run with the previous sequential algorithm as the
+// reference and then repeatedly with the parallel algorithm - the finalized
+// entries (what is added to the database) must be identical.
+// ----------------------------------------------------------------------------
+
+#define FCNTFS_SELFTEST_FINALIZE_VOLUMES    16
+#define FCNTFS_SELFTEST_FINALIZE_RUNS       3
+#define FCNTFS_SELFTEST_FINALIZE_PABASE     0x0000000200000000
+
+typedef struct tdFCNTFS_SELFTEST_MFTSET {
+    PFCNTFS_SETUP_BLOCK pBlockHead;
+    DWORD cRecord;
+    DWORD cPage;
+} FCNTFS_SELFTEST_MFTSET, *PFCNTFS_SELFTEST_MFTSET;
+
+VOID FcNtfs_SelfTest_FinalizeMismatch(_Inout_ PFCNTFS_SELFTEST_FINALIZE_RESULT pr, _In_z_ _Printf_format_string_ LPSTR szFormat, ...)
+{
+    int cch;
+    va_list args;
+    if(pr->cMismatchText >= FCNTFS_SELFTEST_MISMATCH_TEXT_MAX) { return; }
+    pr->cMismatchText++;
+    va_start(args, szFormat);
+    cch = _vsnprintf_s(pr->szMismatch + pr->cchMismatch, sizeof(pr->szMismatch) - pr->cchMismatch, _TRUNCATE, szFormat, args);
+    va_end(args);
+    pr->cchMismatch = (cch < 0) ? (sizeof(pr->szMismatch) - 1) : (pr->cchMismatch + cch);
+}
+
+QWORD FcNtfs_SelfTest_FinalizeRand(_Inout_ PQWORD pqwSeed)
+{
+    *pqwSeed ^= *pqwSeed << 13;
+    *pqwSeed ^= *pqwSeed >> 7;
+    *pqwSeed ^= *pqwSeed << 17;
+    return *pqwSeed;
+}
+
+/*
+* Append a parsed MFT record to the synthetic MFT set.
+*/
+_Success_(return)
+BOOL FcNtfs_SelfTest_MftSetAdd(_Inout_ PFCNTFS_SELFTEST_MFTSET ps, _In_ QWORD pa, _In_ DWORD dwVolume, _In_ DWORD dwMft, _In_ DWORD dwParent, _In_ BOOL fDir, _In_ LPWSTR wszName)
+{
+    DWORD cb, cwszName = (DWORD)wcslen(wszName);
+    PFCNTFS_SETUP_BLOCK pBlock = ps->pBlockHead;
+    PFCNTFS_SETUP_RECORD pe;
+    cb = (sizeof(FCNTFS_SETUP_RECORD) + cwszName * sizeof(WCHAR) + 7) & ~7;
+    if(!pBlock || (pBlock->cbUsed + cb > FCNTFS_SETUP_BLOCK_SIZE)) {
+        if(!(pBlock = LocalAlloc(0, sizeof(FCNTFS_SETUP_BLOCK)))) { return FALSE; }
+        pBlock->cRecord = 0;
+        pBlock->cbUsed = 0;
+        pBlock->FLink = ps->pBlockHead;
+        ps->pBlockHead = pBlock;
+    }
+    pe = (PFCNTFS_SETUP_RECORD)(pBlock->pb + pBlock->cbUsed);
+    ZeroMemory(pe, cb);
+    pe->pa = pa;
+    pe->qwLogFileSequenceNumber = ((QWORD)dwVolume << 32) | dwMft;
+    pe->ftCreate = 0x01d6000000000000 + ((QWORD)dwVolume << 24) + dwMft;
+    pe->ftModify = pe->ftCreate + 1;
+    pe->ftRead = pe->ftCreate + 2;
+    pe->cbFileSize = fDir ? 0 : (dwMft * 17);
+    pe->cbFileSizeMftResident = fDir ? 0 : (WORD)(dwMft % 0x100);
+    pe->dwMftRecordNumber = dwMft;
+    pe->dwIdParent = dwParent;
+    pe->Flags = fDir ? 0x03 : 0x01;
+    pe->cwszName = (WORD)cwszName;
+    memcpy(pe->wszName, wszName, cwszName * sizeof(WCHAR));
+    pBlock->cbUsed += cb;
+    pBlock->cRecord++;
+    ps->cRecord++;
+    return TRUE;
+}
+
+VOID FcNtfs_SelfTest_MftSetFree(_In_ PFCNTFS_SELFTEST_MFTSET ps)
+{
+    PFCNTFS_SETUP_BLOCK pBlock;
+    while((pBlock = ps->pBlockHead)) {
+        ps->pBlockHead = pBlock->FLink;
+        LocalFree(pBlock);
+    }
+}
+
+/*
+* Create a synthetic MFT record set of cVolume volumes.
+*/
+_Success_(return)
+BOOL FcNtfs_SelfTest_MftSet(_In_ DWORD cVolume, _Out_ PFCNTFS_SELFTEST_MFTSET ps)
+{
+    BOOL fResult = FALSE, fDir;
+    DWORD v, r, i, j, k, cPage = 0, cDir, cDup = 0, dwParent;
+    QWORD qwSeed = 0x4e5446535f46494e, pa;
+    PDWORD pcRecord = NULL, pdwPage = NULL;
+    WCHAR wszName[256];
+    ZeroMemory(ps, sizeof(FCNTFS_SELFTEST_MFTSET));
+    if(!(pcRecord = LocalAlloc(0, cVolume * sizeof(DWORD)))) { goto fail; }
+    for(v = 0; v < cVolume; v++) {
+        pcRecord[v] = 0x800 + (DWORD)(FcNtfs_SelfTest_FinalizeRand(&qwSeed) % 0x800);
+        cPage += (pcRecord[v] + 3) / 4;
+    }
+    // shuffled page layout: page (volume << 16 | page index) -> physical page.
+    if(!(pdwPage = LocalAlloc(0, cPage * sizeof(DWORD)))) { goto fail; }
+    for(v = 0, i = 0; v < cVolume; v++) {
+        for(j = 0; j < (pcRecord[v] + 3) / 4; j++) {
+            pdwPage[i++] = (v << 16) | j;
+        }
+    }
+    for(i = cPage - 1; i > 0; i--) {
+        j = (DWORD)(FcNtfs_SelfTest_FinalizeRand(&qwSeed) % (i + 1));
+        v = pdwPage[i];
+        pdwPage[i] = pdwPage[j];
+        pdwPage[j] = v;
+    }
+    ps->cPage = cPage;
+    for(i = 0; i < cPage; i++) {
+        v = pdwPage[i] >> 16;
+        for(j = 0; j < 4; j++) {
+            r = ((pdwPage[i] & 0xffff) << 2) + j;
+            if(r >= pcRecord[v]) { break; }
+            pa = FCNTFS_SELFTEST_FINALIZE_PABASE + ((QWORD)i << 12) + ((QWORD)j << 10);
+            // record r of volume v - record 0 is the root directory (mft 5).
+            if(r == 0) {
+                if(!FcNtfs_SelfTest_MftSetAdd(ps, pa, v, 5, 5, TRUE, L".")) { goto fail; }
+                continue;
+            }
+            if(r % 13 == 0) { continue; }                           // missing record (orphans)
+            // directory structure is deterministic per record (independent of page order):
+            fDir = (r % 6 == 1) || ((v == 0) && (r < 16));
+            if((v == 0) && (r < 16)) {
+                dwParent = (r == 1) ? 5 : (0x40 + r - 1);           // deep chain of long names (path cut-off)
+                for(k = 0; k < 200; k++) {
+                    wszName[k] = L'a' + (WCHAR)((r + k) % 26);
+                }
+                wszName[k] = 0;
+            } else {
+                cDir = (r > 6) ? ((r - 1) / 6) : 0;
+                dwParent = cDir ? (0x40 + 1 + 6 * (DWORD)((((QWORD)r * 2654435761) >> 7) % cDir)) : 5;
+                if(r % 97 == 0) { dwParent = 0x40 + r - 2; }        // parent is a file
+                if(!fDir && (r % 50 == 0)) {
+                    wcscpy_s(wszName, _countof(wszName), L"collision.txt");
+                } else if(fDir) {
+                    _snwprintf_s(wszName, _countof(wszName), _TRUNCATE, L"dir_%x", r % 0x40);
+                } else {
+                    _snwprintf_s(wszName, _countof(wszName), _TRUNCATE, L"file_%x.dat", r);
+                }
+            }
+            if(!FcNtfs_SelfTest_MftSetAdd(ps, pa, v, 0x40 + r, dwParent, fDir, wszName)) { goto fail; }
+            // duplicate copy of the record (same lsn) in a separate page:
+            if(r % 31 == 0) {
+                pa = FCNTFS_SELFTEST_FINALIZE_PABASE + ((QWORD)(cPage + cDup++) << 12);
+                if(!FcNtfs_SelfTest_MftSetAdd(ps, pa, v, 0x40 + r, dwParent, fDir, wszName)) { goto fail; }
+            }
+        }
+    }
+    fResult = TRUE;
+fail:
+    LocalFree(pcRecord);
+    LocalFree(pdwPage);
+    if(!fResult) { FcNtfs_SelfTest_MftSetFree(ps); }
+    return fResult;
+}
+
+/*
+* Finalize a copy of the synthetic MFT set and collect the finalized entries.
+*/
+_Success_(return)
+BOOL FcNtfs_SelfTest_FinalizeRun(_In_ PFCNTFS_SELFTEST_MFTSET ps, _In_ BOOL fSequential, _Inout_ PFCNTFS_SELFTEST_FINALIZE pOut, _Out_ PQWORD ptmUs)
+{
+    QWORD tmStart;
+    PFCNTFS_SETUP_BLOCK pBlock, pBlockCopy;
+    PFCNTFS_SETUP_CONTEXT ctx;
+    pOut->cRow = 0;
+    if(!(ctx = FcNtfs_SetupInitialize())) { return FALSE; }
+    for(pBlock = ps->pBlockHead; pBlock; pBlock = pBlock->FLink) {
+        if(!(pBlockCopy = LocalAlloc(0, sizeof(FCNTFS_SETUP_BLOCK)))) {
+            FcNtfs_SetupClose(ctx);
+            return FALSE;
+        }
+        memcpy(pBlockCopy, pBlock, sizeof(FCNTFS_SETUP_BLOCK));
+        FcNtfs_SetupBlockCommit(ctx, pBlockCopy);
+    }
+    ctx->fFinalizeSequential = fSequential;
+    ctx->pSelfTestFinalize = pOut;
+    tmStart = FcNtfs_SelfTest_TimeUs();
+    FcNtfs_SetupFinalize(ctx, TRUE);            // ctx is closed by finalize
+    *ptmUs = max(1, FcNtfs_SelfTest_TimeUs() - tmStart);
+    return (pOut->cRow > 0) && (pOut->cRow < pOut->cRowMax);
+}
+
+/*
+* Run the MFT tree reconstruction self test: finalize synthetic MFT record sets
+* with the sequential reference and the parallel algorithm and compare the
+* finalized entries. Test builds only (VMM_TEST_SELFTEST).
+* -- cVolume = # of synthetic volumes, 0 = default.
+* -- pr
+* -- return = TRUE if the test ran (check the mismatch counters).
+*/
+_Success_(return)
+BOOL FcNtfs_SelfTest_Finalize(_In_ DWORD cVolume, _Out_ PFCNTFS_SELFTEST_FINALIZE_RESULT pr)
+{
+    BOOL fResult = FALSE;
+    DWORD i, iRun;
+    FCNTFS_SELFTEST_MFTSET MftSet = { 0 };
+    FCNTFS_SELFTEST_FINALIZE Out[2] = { 0 };
+    PFCNTFS_SELFTEST_FINALIZE_ROW p0, p1;
+    ZeroMemory(pr, sizeof(FCNTFS_SELFTEST_FINALIZE_RESULT));
+    pr->cVolume = cVolume = cVolume ? min(cVolume, 0x1000) : FCNTFS_SELFTEST_FINALIZE_VOLUMES;
+    pr->cRun = 1 + FCNTFS_SELFTEST_FINALIZE_RUNS;
+    if(!FcNtfs_SelfTest_MftSet(cVolume, &MftSet)) { goto fail; }
+    pr->cRecord = MftSet.cRecord;
+    pr->cPage = MftSet.cPage;
+    for(i = 0; i < 2; i++) {
+        Out[i].cRowMax = 3 * MftSet.cRecord + 16;
+        if(!(Out[i].pRow = LocalAlloc(0, Out[i].cRowMax * sizeof(FCNTFS_SELFTEST_FINALIZE_ROW)))) { goto fail; }
+    }
+    // run 0 = sequential reference, run 1..n = parallel:
+    for(iRun = 0; iRun < pr->cRun; iRun++) {
+        pr->Run[iRun].fResult = FcNtfs_SelfTest_FinalizeRun(&MftSet, (iRun == 0), Out + (iRun ? 1 : 0), &pr->Run[iRun].tmUs);
+        pr->Run[iRun].cRow = Out[iRun ? 1 : 0].cRow;
+        if(!iRun) { continue; }
+        if(Out[1].cRow != Out[0].cRow) {
+            FcNtfs_SelfTest_FinalizeMismatch(pr, "run %i: %i entries, sequential %i entries\n", iRun, Out[1].cRow, Out[0].cRow);
+        }
+        for(i = 0; i < min(Out[0].cRow, Out[1].cRow); i++) {
+            p0 = Out[0].pRow + i;
+            p1 = Out[1].pRow + i;
+            if(memcmp(p0, p1, sizeof(FCNTFS_SELFTEST_FINALIZE_ROW))) {
+                pr->Run[iRun].cRowMismatch++;
+                FcNtfs_SelfTest_FinalizeMismatch(pr, "run %i: entry %x differs: mft=%x/%x parent=%llx/%llx hash=%llx/%llx path=%llx/%llx seq=%i/%i oln=%llx/%llx\n",
+                    iRun, i, p1->dwIdThis, p0->dwIdThis, p1->idParent, p0->idParent, p1->qwHash, p0->qwHash, p1->qwHashPath, p0->qwHashPath, p1->wName_SeqNbr, p0->wName_SeqNbr, p1->olnUtf8, p0->olnUtf8);
+            }
+        }
+        pr->Run[iRun].cRowMismatch += max(Out[0].cRow, Out[1].cRow) - min(Out[0].cRow, Out[1].cRow);
+    }
+    // tree statistics of the reference:
+    for(i = 0; i < Out[0].cRow; i++) {
+        pr->cDepthMax = max(pr->cDepthMax, Out[0].pRow[i].iDirDepth);
+        if(Out[0].pRow[i].wName_SeqNbr) { pr->cNameCollision++; }
+    }
+    fResult = TRUE;
+fail:
+    FcNtfs_SelfTest_MftSetFree(&MftSet);
+    LocalFree(Out[0].pRow);
+    LocalFree(Out[1].pRow);
+    return fResult;
+}
+#endif /* VMM_TEST_SELFTEST */
+
 
 
 //-----------------------------------------------------------------------------
@@ -1192,7 +2613,75 @@ _Success_(return)
 BOOL FcNtfs_GetIdFromPosition(_In_ QWORD qwFilePos, _In_ BOOL fJSON, _Out_ PQWORD pqwId)
 {
     QWORD v[] = { max(2048, qwFilePos) - 2048, qwFilePos};
+    if(!fJSON && ctxFc->File.pObNtfs) {
+        return FcFile_GetIdFromPosition(ctxFc->File.pObNtfs, qwFilePos, pqwId);
+    }
     return fJSON ?
         (SQLITE_OK == Fc_SqlQueryN("SELECT MAX(id) FROM ntfs WHERE oln_j >= ? AND oln_j <= ?", 2, v, 1, pqwId, NULL)) :
         (SQLITE_OK == Fc_SqlQueryN("SELECT MAX(id) FROM ntfs WHERE oln_u >= ? AND oln_u <= ?", 2, v, 1, pqwId, NULL));
 }
+
+/*
+* Render a single utf-8 ntfs_files.txt line (including trailing newline).
+* -- pe
+* -- szu
+* -- cszu
+* -- return = the number of bytes written.
+*/
+DWORD FcNtfs_FormatLineUTF8(_In_ PFC_MAP_NTFSENTRY pe, _Out_writes_(cszu) LPSTR szu, _In_ DWORD cszu)
+{
+    DWORD o;
+    CHAR szTimeCreate[24], szTimeModify[24];
+    Util_FileTime2String((PFILETIME)&pe->ftCreate, szTimeCreate);
+    Util_FileTime2String((PFILETIME)&pe->ftModify, szTimeModify);
+    o = snprintf(
+        szu,
+        cszu,
+        "%6llx%12llx %8x %s : %s %12llx %3x %c ",
+        pe->qwId,
+        pe->pa,
+        (pe->dwMftId & 0xf0000000 ? 0 : pe->dwMftId),
+        szTimeCreate,
+        szTimeModify,
+        pe->qwFileSize,
+        pe->dwFileSizeResident,
+        pe->fDir ? 'D' : ' '
+    );
+    o += WideCharToMultiByte(CP_UTF8, 0, pe->wszText, -1, szu + o, (int)(cszu - o), NULL, NULL);
+    if(o) {
+        szu[o - 1] = '\n';
+    }
+    return o;
+}
+
+/*
+* Render the utf-8 ntfs_files.txt into a pre-rendered memory-mapped file. The
+* rendering is done once at the end of the forensic initialization; on error
+* reads fall back to rendering from the database.
+*/
+VOID FcNtfs_RenderFile()
+{
+    BOOL fResult = TRUE;
+    DWORD i;
+    QWORD qwId, cbFileSizeUTF8;
+    PFCOB_FILE pObFile;
+    PFCOB_MAP_NTFS pObMap = NULL;
+    CHAR szu[0x2000];
+    if(!ctxFc->fEnableNtfs || !FcNtfs_GetFileSize(NULL, &cbFileSizeUTF8, NULL)) { return; }
+    if(!(pObFile = FcFile_New(cbFileSizeUTF8))) { return; }
+    for(qwId = 0; fResult; qwId += 0x1000) {
+        if(!FcNtfsMap_GetFromIdRange(qwId, 0x1000, &pObMap)) { fResult = FALSE; break; }
+        if(!pObMap->cMap) { break; }
+        for(i = 0; fResult && (i < pObMap->cMap); i++) {
+            fResult = FcFile_AppendLine(pObFile, pObMap->pMap[i].qwId, szu, FcNtfs_FormatLineUTF8(pObMap->pMap + i, szu, sizeof(szu)));
+        }
+        Ob_DECREF_NULL(&pObMap);
+    }
+    Ob_DECREF_NULL(&pObMap);
+    if(fResult && (pObFile->cb == cbFileSizeUTF8)) {
+        ctxFc->File.pObNtfs = pObFile;
+    } else {
+        vmmprintfv_fn("FAIL RENDER NTFS FILE\n");
+        Ob_DECREF(pObFile);
+    }
+}
@@ -10,12 +10,11 @@
 //
 #include "fc.h"
 #include "pluginmanager.h"
+#include "util.h"
 
 typedef struct tdFCTIMELINE_PLUGIN_CONTEXT {
     DWORD dwId;
-    sqlite3 *hSql;
-    sqlite3_stmt *hStmt;
-    sqlite3_stmt *hStmtStr;
+    PFC_SQLBULK hBulk;
 } FCTIMELINE_PLUGIN_CONTEXT, *PFCTIMELINE_PLUGIN_CONTEXT;
 
 /*
@@ -31,11 +30,10 @@ VOID FcTimeline_Callback_PluginAddEntry(_In_ HANDLE hTimeline, _In_ QWORD ft, _I
 {
     PFCTIMELINE_PLUGIN_CONTEXT ctxPlugin = (PFCTIMELINE_PLUGIN_CONTEXT)hTimeline;
     FCSQL_INSERTSTRTABLE SqlStrInsert;
-    // build and insert string data into 'str' table.
-    if(!Fc_SqlInsertStr(ctxPlugin->hStmtStr, wszText, 0, &SqlStrInsert)) { return; }
-    // insert into 'timeline_data' table.
-    sqlite3_reset(ctxPlugin->hStmt);
-    Fc_SqlBindMultiInt64(ctxPlugin->hStmt, 1, 6,
+    // build and stage string data for 'str' table.
+    if(!Fc_SqlBulkAddStr(ctxPlugin->hBulk, wszText, 0, &SqlStrInsert)) { return; }
+    // stage for 'timeline_data' table.
+    Fc_SqlBulkAddRow(ctxPlugin->hBulk,
         SqlStrInsert.id,
         (QWORD)ctxPlugin->dwId,
         ft,
@@ -43,7 +41,6 @@ VOID FcTimeline_Callback_PluginAddEntry(_In_ HANDLE hTimeline, _In_ QWORD ft, _I
         (QWORD)dwPID,
         qwValue
     );
-    sqlite3_step(ctxPlugin->hStmt);
 }
 
 /*
@@ -53,10 +50,8 @@ VOID FcTimeline_Callback_PluginAddEntry(_In_ HANDLE hTimeline, _In_ QWORD ft, _I
 VOID FcTimeline_Callback_PluginClose(_In_ HANDLE hTimeline)
 {
     PFCTIMELINE_PLUGIN_CONTEXT ctxPlugin = (PFCTIMELINE_PLUGIN_CONTEXT)hTimeline;
-    sqlite3_exec(ctxPlugin->hSql, "COMMIT TRANSACTION", NULL, NULL, NULL);
-    sqlite3_finalize(ctxPlugin->hStmtStr);
-    sqlite3_finalize(ctxPlugin->hStmt);
-    Fc_SqlReserveReturn(ctxPlugin->hSql);
+    Fc_SqlBulkClose(ctxPlugin->hBulk);
+    LocalFree(ctxPlugin);
 }
 
 /*
@@ -82,18 +77,402 @@ HANDLE FcTimeline_Callback_PluginRegister(_In_reads_(6) LPSTR sNameShort, _In_re
     Fc_SqlQueryN("SELECT MAX(id) FROM timeline_info;", 0, NULL, 1, &v, NULL);
     if(!(ctxPlugin = LocalAlloc(LMEM_ZEROINIT, sizeof(FCTIMELINE_PLUGIN_CONTEXT)))) { goto fail; }
     ctxPlugin->dwId = (DWORD)v;
-    ctxPlugin->hSql = Fc_SqlReserve();
-    sqlite3_prepare_v2(ctxPlugin->hSql, "INSERT INTO timeline_data (id_str, tp, ft, ac, pid, data64) VALUES (?, ?, ?, ?, ?, ?);", -1, &ctxPlugin->hStmt, NULL);
-    sqlite3_prepare_v2(ctxPlugin->hSql, "INSERT INTO str (id, osz, csz, cbu, cbj, sz) VALUES (?, ?, ?, ?, ?, ?);", -1, &ctxPlugin->hStmtStr, NULL);
-    sqlite3_exec(ctxPlugin->hSql, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    if(!(ctxPlugin->hBulk = Fc_SqlBulkInitialize("timeline_data", "id_str, tp, ft, ac, pid, data64", 6))) {
+        LocalFree(ctxPlugin);
+        ctxPlugin = NULL;
+    }
+fail:
+    sqlite3_finalize(hStmt);
+    Fc_SqlReserveReturn(hSql);
+    return (HANDLE)ctxPlugin;
+}
+
+// ----------------------------------------------------------------------------
+// TIMELINE EXTERNAL MERGE SORT FUNCTIONALITY BELOW:
+// The timeline is ordered by time (descending) and each line is assigned its
+// byte offset in the global and the per-type timeline files. Instead of doing
+// this in sqlite with window functions (single-threaded with multiple temporary
+// b-trees) the timeline_data rows are read in fixed size id ranges which are
+// sorted in parallel into runs spilled to a memory-mapped file (temporary file
+// or page file). The runs are then k-way merged in a single pass during which
+// ids and line offsets are assigned and the timeline table is bulk ingested.
+// If the sort fails (spill file, run read or ingest) the timeline is instead
+// built with the window-function SQL as a fallback.
+// ----------------------------------------------------------------------------
+
+#define FCTIMELINE_SORT_RUN_ENTRIES         0x00040000
+
+typedef struct tdFCTIMELINE_SORT_ENTRY {
+    QWORD ft;
+    QWORD id;                       // timeline_data id (tie-breaker)
+    QWORD id_str;
+    QWORD data64;
+    DWORD tp;
+    DWORD ac;
+    DWORD pid;
+    DWORD cbu;
+    DWORD cbj;
+    DWORD _Filler;
+} FCTIMELINE_SORT_ENTRY, *PFCTIMELINE_SORT_ENTRY;
+
+typedef struct tdFCTIMELINE_SORT_RUN {
+    QWORD qwIdBase;                 // first timeline_data id of the run
+    DWORD cEntry;                   // # entries in the run (after sort)
+    DWORD iEntry;                   // merge read position
+    BOOL fFail;                     // run could not be read completely
+    LPSTR szTableData;              // source table (timeline_data)
+    PFCTIMELINE_SORT_ENTRY pe;      // run entries inside the spill file
+} FCTIMELINE_SORT_RUN, *PFCTIMELINE_SORT_RUN;
+
+/*
+* qsort comparator / merge ordering: time descending, id ascending. The time
+* is compared signed - same as the sqlite INTEGER ordering of the fallback.
+*/
+int FcTimeline_SortCmpEntry(const void *v1, const void *v2)
+{
+    PFCTIMELINE_SORT_ENTRY p1 = (PFCTIMELINE_SORT_ENTRY)v1;
+    PFCTIMELINE_SORT_ENTRY p2 = (PFCTIMELINE_SORT_ENTRY)v2;
+    if(p1->ft != p2->ft) { return ((LONG64)p1->ft > (LONG64)p2->ft) ? -1 : 1; }
+    return (p1->id < p2->id) ? -1 : ((p1->id > p2->id) ? 1 : 0);
+}
+
+/*
+* Worker: read a timeline_data id range and sort it into a run. If the range
+* cannot be read completely pRun->fFail is set.
+* -- pRun
+*/
+VOID FcTimeline_SortRun_ThreadProc(_In_ PFCTIMELINE_SORT_RUN pRun)
+{
+    int rc = SQLITE_ERROR;
+    sqlite3 *hSql;
+    sqlite3_stmt *hStmt = NULL;
+    PFCTIMELINE_SORT_ENTRY pe;
+    DWORD cEntry = 0;
+    CHAR szSql[0x200];
+    _snprintf_s(szSql, _countof(szSql), _TRUNCATE, "SELECT td.id, td.id_str, td.tp, td.ft, td.ac, td.pid, td.data64, str.cbu, str.cbj FROM %s td, str WHERE str.id = td.id_str AND td.id >= ? AND td.id < ?", pRun->szTableData);
+    if(!(hSql = Fc_SqlReserve())) {
+        pRun->fFail = TRUE;
+        return;
+    }
+    if(SQLITE_OK == sqlite3_prepare_v2(hSql, szSql, -1, &hStmt, NULL)) {
+        sqlite3_bind_int64(hStmt, 1, pRun->qwIdBase);
+        sqlite3_bind_int64(hStmt, 2, pRun->qwIdBase + FCTIMELINE_SORT_RUN_ENTRIES);
+        while((cEntry < FCTIMELINE_SORT_RUN_ENTRIES) && (SQLITE_ROW == (rc = sqlite3_step(hStmt)))) {
+            pe = pRun->pe + cEntry++;
+            pe->id = sqlite3_column_int64(hStmt, 0);
+            pe->id_str = sqlite3_column_int64(hStmt, 1);
+            pe->tp = sqlite3_column_int(hStmt, 2);
+            pe->ft = sqlite3_column_int64(hStmt, 3);
+            pe->ac = sqlite3_column_int(hStmt, 4);
+            pe->pid = sqlite3_column_int(hStmt, 5);
+            pe->data64 = sqlite3_column_int64(hStmt, 6);
+            pe->cbu = sqlite3_column_int(hStmt, 7);
+            pe->cbj = sqlite3_column_int(hStmt, 8);
+        }
+    }
+    if((rc != SQLITE_DONE) && (cEntry < FCTIMELINE_SORT_RUN_ENTRIES)) {
+        pRun->fFail = TRUE;
+    }
+    sqlite3_finalize(hStmt);
+    Fc_SqlReserveReturn(hSql);
+    // sort outside of the database connection - this is the parallel part.
+    qsort(pRun->pe, cEntry, sizeof(FCTIMELINE_SORT_ENTRY), FcTimeline_SortCmpEntry);
+    pRun->cEntry = cEntry;
+}
+
+/*
+* Restore the min-heap property (by merge order) of the run heap from i down.
+*/
+VOID FcTimeline_SortHeapDown(_Inout_ PFCTIMELINE_SORT_RUN *ppHeap, _In_ DWORD cHeap, _In_ DWORD i)
+{
+    DWORD iMin, iChild;
+    PFCTIMELINE_SORT_RUN pRun;
+    while(TRUE) {
+        iMin = i;
+        for(iChild = 2 * i + 1; (iChild <= 2 * i + 2) && (iChild < cHeap); iChild++) {
+            if(FcTimeline_SortCmpEntry(ppHeap[iChild]->pe + ppHeap[iChild]->iEntry, ppHeap[iMin]->pe + ppHeap[iMin]->iEntry) < 0) {
+                iMin = iChild;
+            }
+        }
+        if(iMin == i) { return; }
+        pRun = ppHeap[i];
+        ppHeap[i] = ppHeap[iMin];
+        ppHeap[iMin] = pRun;
+        i = iMin;
+    }
+}
+
+/*
+* Build the timeline table from the timeline_data table using a parallel run
+* sort followed by a single-pass k-way merge. The timeline_info file sizes are
+* updated from the line offsets computed during the merge.
+* -- cTp = # of timeline types.
+* -- szTableData = source table (timeline_data).
+* -- szTableTimeline = destination table (timeline).
+* -- pqwFileSize = optional: receives the utf-8 and json file sizes [2][cTp]
+*                  instead of updating timeline_info.
+* -- pcbSpill = optional: receives the spill file size.
+* -- return = TRUE on success, FALSE on failure (timeline table may be partly
+*             populated).
+*/
+_Success_(return)
+BOOL FcTimeline_SortBuild(_In_ DWORD cTp, _In_ LPSTR szTableData, _In_ LPSTR szTableTimeline, _Out_writes_opt_(2 * cTp) PQWORD pqwFileSize, _Out_opt_ PQWORD pcbSpill)
+{
+    BOOL fResult = FALSE;
+    DWORD i, cRun = 0, cHeap = 0;
+    QWORD qwIdMax = 0, tcStart = GetTickCount64(), cEntry = 0, cRowFail;
+    PQWORD pqwTpId = NULL, pqwOlnU = NULL, pqwOlnJ = NULL;
+    QWORD qwOlnU = 0, qwOlnJ = 0;
+    PFCTIMELINE_SORT_ENTRY pe;
+    PFCTIMELINE_SORT_RUN pRuns = NULL, *ppHeap = NULL;
+    PFCOB_FILE pObSpill = NULL;
+    PVMMOB_WORK_GROUP pObWorkGroup = NULL;
+    PFC_SQLBULK hBulk = NULL;
+    CHAR szSql[0x100];
+    if(!cTp) { return FALSE; }
+    _snprintf_s(szSql, _countof(szSql), _TRUNCATE, "SELECT MAX(id) FROM %s;", szTableData);
+    if(SQLITE_OK != Fc_SqlQueryN(szSql, 0, NULL, 1, &qwIdMax, NULL)) { goto fail; }
+    // 1: spill file & sorted runs (in parallel).
+    cRun = (DWORD)((qwIdMax + FCTIMELINE_SORT_RUN_ENTRIES) / FCTIMELINE_SORT_RUN_ENTRIES);
+    if(!(pObSpill = FcFile_New((QWORD)cRun * FCTIMELINE_SORT_RUN_ENTRIES * sizeof(FCTIMELINE_SORT_ENTRY)))) { goto fail; }
+    if(!(pRuns = LocalAlloc(LMEM_ZEROINIT, cRun * (sizeof(FCTIMELINE_SORT_RUN) + sizeof(PFCTIMELINE_SORT_RUN))))) { goto fail; }
+    ppHeap = (PFCTIMELINE_SORT_RUN*)(pRuns + cRun);
+    if(!(pqwTpId = LocalAlloc(LMEM_ZEROINIT, 3 * cTp * sizeof(QWORD)))) { goto fail; }
+    pqwOlnU = pqwTpId + cTp;
+    pqwOlnJ = pqwOlnU + cTp;
+    if(!(pObWorkGroup = VmmWorkGroup_New())) { goto fail; }
+    for(i = 0; i < cRun; i++) {
+        pRuns[i].qwIdBase = (QWORD)i * FCTIMELINE_SORT_RUN_ENTRIES;
+        pRuns[i].szTableData = szTableData;
+        pRuns[i].pe = (PFCTIMELINE_SORT_ENTRY)pObSpill->pb + (QWORD)i * FCTIMELINE_SORT_RUN_ENTRIES;
+        VmmWorkGroup_Add(pObWorkGroup, (LPTHREAD_START_ROUTINE)FcTimeline_SortRun_ThreadProc, pRuns + i);
+    }
+    VmmWorkGroup_Join(pObWorkGroup);
+    for(i = 0; i < cRun; i++) {
+        if(pRuns[i].fFail) {
+            vmmprintfv_fn("FAIL: READ RUN #%i\n", i);
+            goto fail;
+        }
+    }
+    // 2: k-way merge; assign ids and line offsets and ingest into timeline.
+    cRowFail = ctxFc->db.Bulk.cRowFail;
+    if(!(hBulk = Fc_SqlBulkInitialize(szTableTimeline, "id, tp, tp_id, id_str, ft, ac, pid, data64, oln_u, oln_j, oln_utp, oln_jtp", 12))) { goto fail; }
+    for(i = 0; i < cRun; i++) {
+        if(pRuns[i].cEntry) { ppHeap[cHeap++] = pRuns + i; }
+    }
+    for(i = cHeap / 2; i > 0; i--) {
+        FcTimeline_SortHeapDown(ppHeap, cHeap, i - 1);
+    }
+    while(cHeap) {
+        pe = ppHeap[0]->pe + ppHeap[0]->iEntry;
+        if(pe->tp < cTp) {
+            Fc_SqlBulkAddRow(hBulk,
+                ++cEntry,
+                (QWORD)pe->tp,
+                ++pqwTpId[pe->tp],
+                pe->id_str,
+                pe->ft,
+                (QWORD)pe->ac,
+                (QWORD)pe->pid,
+                pe->data64,
+                qwOlnU,
+                qwOlnJ,
+                pqwOlnU[pe->tp],
+                pqwOlnJ[pe->tp]
+            );
+            qwOlnU += pe->cbu + FC_LINELENGTH_TIMELINE_UTF8;
+            qwOlnJ += pe->cbj + FC_LINELENGTH_TIMELINE_JSON;
+            pqwOlnU[pe->tp] += pe->cbu + FC_LINELENGTH_TIMELINE_UTF8;
+            pqwOlnJ[pe->tp] += pe->cbj + FC_LINELENGTH_TIMELINE_JSON;
+        }
+        if(++ppHeap[0]->iEntry == ppHeap[0]->cEntry) {
+            ppHeap[0] = ppHeap[--cHeap];
+        }
+        FcTimeline_SortHeapDown(ppHeap, cHeap, 0);
+    }
+    Fc_SqlBulkClose(hBulk);
+    hBulk = NULL;
+    if(cRowFail != ctxFc->db.Bulk.cRowFail) {
+        vmmprintfv_fn("FAIL: INGEST\n");
+        goto fail;
+    }
+    // 3: update timeline_info file sizes from the computed offsets.
+    pqwOlnU[0] = qwOlnU;
+    pqwOlnJ[0] = qwOlnJ;
+    if(pcbSpill) { *pcbSpill = pObSpill->cbMax; }
+    if(pqwFileSize) {
+        memcpy(pqwFileSize, pqwOlnU, 2 * cTp * sizeof(QWORD));
+    }
+    for(i = 0; !pqwFileSize && (i < cTp); i++) {
+        if(SQLITE_DONE != Fc_SqlQueryN("UPDATE timeline_info SET file_size_u = ?, file_size_j = ? WHERE id = ?;", 3, (QWORD[]) { pqwOlnU[i], pqwOlnJ[i], i }, 0, NULL, NULL)) { goto fail; }
+    }
+    vmmprintfv_fn("%lli entries, %i runs, %lli MB spill, %lli ms.\n", cEntry, cRun, pObSpill->cbMax >> 20, GetTickCount64() - tcStart);
+    fResult = TRUE;
 fail:
+    Fc_SqlBulkClose(hBulk);
+    Ob_DECREF(pObWorkGroup);
+    Ob_DECREF(pObSpill);
+    LocalFree(pqwTpId);
+    LocalFree(pRuns);
+    return fResult;
+}
+
+/*
+* Window-function SQL build of the timeline (fallback of the sort build).
+*/
+#define FCTIMELINE_SQL_WINDOW_INSERT(szTableTimeline, szTableData) \
+    "INSERT INTO " szTableTimeline " (tp, tp_id, id_str, ft, ac, pid, data64, oln_u, oln_j, oln_utp, oln_jtp) SELECT td.tp, (SUM(1) OVER (PARTITION BY td.tp ORDER BY td.ft DESC, td.id)), td.id_str, td.ft, td.ac, td.pid, td.data64, (SUM(str.cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)")  OVER (ORDER BY td.ft DESC, td.id) - str.cbu-"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)"), (SUM(str.cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)") OVER (ORDER BY td.ft DESC, td.id) - str.cbj-"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)"), (SUM(str.cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)")  OVER (PARTITION BY td.tp ORDER BY td.ft DESC, td.id) - str.cbu-"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)"), (SUM(str.cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)") OVER (PARTITION BY td.tp ORDER BY td.ft DESC, td.id) - str.cbj-"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)") FROM " szTableData " td, str WHERE str.id = td.id_str ORDER BY td.ft DESC, td.id;"
+
+#ifdef VMM_TEST_SELFTEST
+// ----------------------------------------------------------------------------
+// TIMELINE BUILD SELF TEST BELOW (VMM_TEST_SELFTEST builds only):
+// A synthetic timeline_data table of random events (referencing existing 'str'
+// rows, with many duplicate timestamps and some negative timestamps) is built
+// into two separate timeline tables - by the external merge sort and by the
+// window-function SQL. Both tables and the resulting file sizes must be equal.
+// The live timeline tables are not touched.
+// ----------------------------------------------------------------------------
+
+#define FCTIMELINE_SELFTEST_EVENTS_DEFAULT  50000000
+#define FCTIMELINE_SELFTEST_STR_MAX         0x00010000
+#define FCTIMELINE_SELFTEST_SCHEMA          "( id INTEGER PRIMARY KEY AUTOINCREMENT, tp INT, tp_id INTEGER, id_str INTEGER, ft INTEGER, ac INT, pid INT, data64 INTEGER, oln_u INTEGER, oln_j INTEGER, oln_utp INTEGER, oln_jtp INTEGER )"
+
+QWORD FcTimeline_SelfTest_Rand(_Inout_ PQWORD pqwSeed)
+{
+    *pqwSeed ^= *pqwSeed << 13;
+    *pqwSeed ^= *pqwSeed >> 7;
+    *pqwSeed ^= *pqwSeed << 17;
+    return *pqwSeed;
+}
+
+/*
+* Populate the synthetic timeline_selftest_data table with cEvent events.
+*/
+_Success_(return)
+BOOL FcTimeline_SelfTest_Populate(_In_ DWORD cEvent, _In_ DWORD cTp)
+{
+    BOOL fResult = FALSE;
+    DWORD i, cStrId = 0;
+    QWORD ft, qwSeed = 0x54494d454c494e45, cRowFail = ctxFc->db.Bulk.cRowFail;
+    PQWORD pqwStrId = NULL;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    PFC_SQLBULK hBulk = NULL;
+    // sample existing 'str' ids - the sort and sql builds join with 'str'.
+    if(!(pqwStrId = LocalAlloc(0, FCTIMELINE_SELFTEST_STR_MAX * sizeof(QWORD)))) { goto fail; }
+    if(!(hSql = Fc_SqlReserve())) { goto fail; }
+    if(SQLITE_OK != sqlite3_prepare_v2(hSql, "SELECT id FROM str LIMIT ?;", -1, &hStmt, NULL)) { goto fail; }
+    sqlite3_bind_int64(hStmt, 1, FCTIMELINE_SELFTEST_STR_MAX);
+    while((cStrId < FCTIMELINE_SELFTEST_STR_MAX) && (SQLITE_ROW == sqlite3_step(hStmt))) {
+        pqwStrId[cStrId++] = sqlite3_column_int64(hStmt, 0);
+    }
     sqlite3_finalize(hStmt);
-    if(ctxPlugin) {
-        return (HANDLE)ctxPlugin;
+    hStmt = NULL;
+    hSql = Fc_SqlReserveReturn(hSql);
+    if(!cStrId) { goto fail; }
+    // synthetic events:
+    if(!(hBulk = Fc_SqlBulkInitialize("timeline_selftest_data", "id_str, tp, ft, ac, pid, data64", 6))) { goto fail; }
+    for(i = 0; i < cEvent; i++) {
+        if(i % 1024 == 1023) {
+            ft = FcTimeline_SelfTest_Rand(&qwSeed) | 0x8000000000000000;
+        } else {
+            ft = 0x01d0000000000000 + (FcTimeline_SelfTest_Rand(&qwSeed) % (cEvent / 4 + 1)) * 10000000;
+        }
+        Fc_SqlBulkAddRow(hBulk,
+            pqwStrId[FcTimeline_SelfTest_Rand(&qwSeed) % cStrId],
+            1 + FcTimeline_SelfTest_Rand(&qwSeed) % (cTp - 1),
+            ft,
+            FcTimeline_SelfTest_Rand(&qwSeed) % 4,
+            FcTimeline_SelfTest_Rand(&qwSeed) % 0x10000,
+            FcTimeline_SelfTest_Rand(&qwSeed)
+        );
     }
+    Fc_SqlBulkClose(hBulk);
+    fResult = (cRowFail == ctxFc->db.Bulk.cRowFail);
+fail:
+    sqlite3_finalize(hStmt);
     Fc_SqlReserveReturn(hSql);
-    return NULL;
+    LocalFree(pqwStrId);
+    return fResult;
+}
+
+/*
+* Run the timeline build self test: build a synthetic timeline with the
+* external merge sort and with the window-function SQL and compare the results.
+* Test builds only (VMM_TEST_SELFTEST).
+* -- cEvent = # of synthetic timeline events, 0 = default (50M).
+* -- pr
+* -- return = TRUE if the synthetic input was created (check the result).
+*/
+_Success_(return)
+BOOL FcTimeline_SelfTest_Build(_In_ DWORD cEvent, _Out_ PFCTIMELINE_SELFTEST_RESULT pr)
+{
+    BOOL fResult = FALSE;
+    DWORD i, cTp;
+    QWORD tcStart, qwSize[2];
+    PQWORD pqwFileSize = NULL;
+    LPSTR szDROP[] = {
+        "DROP TABLE IF EXISTS timeline_selftest_data;",
+        "DROP TABLE IF EXISTS timeline_selftest_sort;",
+        "DROP TABLE IF EXISTS timeline_selftest_sql;",
+    };
+    LPSTR szCREATE[] = {
+        "CREATE TABLE timeline_selftest_data ( id INTEGER PRIMARY KEY AUTOINCREMENT, id_str INTEGER, tp INT, ft INTEGER, ac INT, pid INT, data64 INTEGER );",
+        "CREATE TABLE timeline_selftest_sort " FCTIMELINE_SELFTEST_SCHEMA ";",
+        "CREATE TABLE timeline_selftest_sql " FCTIMELINE_SELFTEST_SCHEMA ";",
+    };
+    ZeroMemory(pr, sizeof(FCTIMELINE_SELFTEST_RESULT));
+    if(!ctxFc || !ctxFc->fInitFinish || (ctxFc->Timeline.cTp < 2)) { return FALSE; }
+    pr->cEvent = cEvent = cEvent ? cEvent : FCTIMELINE_SELFTEST_EVENTS_DEFAULT;
+    pr->cTp = cTp = ctxFc->Timeline.cTp;
+    if(!(pqwFileSize = LocalAlloc(LMEM_ZEROINIT, 2 * cTp * sizeof(QWORD)))) { goto fail; }
+    for(i = 0; i < _countof(szDROP); i++) {
+        Fc_SqlExec(szDROP[i]);
+        if(SQLITE_OK != Fc_SqlExec(szCREATE[i])) { goto fail; }
+    }
+    if(!FcTimeline_SelfTest_Populate(cEvent, cTp)) { goto fail; }
+    fResult = TRUE;
+    // 1: external merge sort build:
+    tcStart = GetTickCount64();
+    pr->Build[0].fResult = FcTimeline_SortBuild(cTp, "timeline_selftest_data", "timeline_selftest_sort", pqwFileSize, &pr->cbSpill);
+    pr->Build[0].tmMs = GetTickCount64() - tcStart;
+    // 2: window-function sql build:
+    tcStart = GetTickCount64();
+    pr->Build[1].fResult = (SQLITE_OK == Fc_SqlExec(FCTIMELINE_SQL_WINDOW_INSERT("timeline_selftest_sql", "timeline_selftest_data")));
+    pr->Build[1].tmMs = GetTickCount64() - tcStart;
+    // 3: compare:
+    Fc_SqlQueryN("SELECT COUNT(*) FROM timeline_selftest_sort;", 0, NULL, 1, &pr->Build[0].cRow, NULL);
+    Fc_SqlQueryN("SELECT COUNT(*) FROM timeline_selftest_sql;", 0, NULL, 1, &pr->Build[1].cRow, NULL);
+    Fc_SqlQueryN(
+        "SELECT COUNT(*) FROM timeline_selftest_sort a LEFT JOIN timeline_selftest_sql b ON a.id = b.id WHERE b.id IS NULL OR " \
+        "a.tp != b.tp OR a.tp_id != b.tp_id OR a.id_str != b.id_str OR a.ft != b.ft OR a.ac != b.ac OR a.pid != b.pid OR a.data64 != b.data64 OR " \
+        "a.oln_u != b.oln_u OR a.oln_j != b.oln_j OR a.oln_utp != b.oln_utp OR a.oln_jtp != b.oln_jtp;",
+        0, NULL, 1, &pr->cRowMismatch, NULL);
+    for(i = 0; i < cTp; i++) {
+        qwSize[0] = qwSize[1] = 0;
+        if(i) {
+            Fc_SqlQueryN("SELECT COALESCE(MAX(t.oln_utp + str.cbu + "STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)"), 0), COALESCE(MAX(t.oln_jtp + str.cbj + "STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)"), 0) FROM timeline_selftest_sql t, str WHERE t.id_str = str.id AND t.tp = ?;", 1, (QWORD[]) { i }, 2, qwSize, NULL);
+        } else {
+            Fc_SqlQueryN("SELECT COALESCE(MAX(t.oln_u + str.cbu + "STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)"), 0), COALESCE(MAX(t.oln_j + str.cbj + "STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)"), 0) FROM timeline_selftest_sql t, str WHERE t.id_str = str.id;", 0, NULL, 2, qwSize, NULL);
+        }
+        if((qwSize[0] != pqwFileSize[i]) || (qwSize[1] != pqwFileSize[cTp + i])) {
+            pr->cFileSizeMismatch++;
+        }
+    }
+fail:
+    for(i = 0; i < _countof(szDROP); i++) {
+        Fc_SqlExec(szDROP[i]);
+    }
+    LocalFree(pqwFileSize);
+    return fResult;
 }
+#endif /* VMM_TEST_SELFTEST */
+
+
+
+// ----------------------------------------------------------------------------
+// TIMELINE INITIALIZATION FUNCTIONALITY BELOW:
+// ----------------------------------------------------------------------------
 
 /*
 * Initialize the timelining functionality. Before the timelining functionality
@@ -104,13 +483,25 @@ fail:
 _Success_(return)
 BOOL FcTimeline_Initialize()
 {
-    BOOL f, fResult = FALSE;
+    BOOL fResult = FALSE, fSortBuild;
     int rc;
     DWORD i, j;
-    QWORD k, v = 0;
-    sqlite3 *hSql = NULL;
-    sqlite3_stmt *hStmt = NULL;
-    PFC_TIMELINE_INFO pi;
+    QWORD v = 0;
+    LPSTR szSql;
+    LPSTR szTIMELINE_SQL_FALLBACK[] = {
+        // re-create (possibly partly populated) timeline table and populate it.
+        "DROP TABLE IF EXISTS timeline;",
+        "CREATE TABLE timeline ( id INTEGER PRIMARY KEY AUTOINCREMENT, tp INT, tp_id INTEGER, id_str INTEGER, ft INTEGER, ac INT, pid INT, data64 INTEGER, oln_u INTEGER, oln_j INTEGER, oln_utp INTEGER, oln_jtp INTEGER );",
+        FCTIMELINE_SQL_WINDOW_INSERT("timeline", "timeline_data"),
+    };
+    LPSTR szTIMELINE_SQL_FALLBACK_UPD_ALL[] = {
+        "UPDATE timeline_info SET file_size_u = (SELECT oln_u+cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)" AS cbu_tot FROM v_timeline WHERE id = (SELECT MAX(id) FROM v_timeline)) WHERE id = 0;",
+        "UPDATE timeline_info SET file_size_j = (SELECT oln_j+cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)" AS cbj_tot FROM v_timeline WHERE id = (SELECT MAX(id) FROM v_timeline)) WHERE id = 0;",
+    };
+    LPSTR szTIMELINE_SQL_FALLBACK_UPD_TP[] = {
+        "UPDATE timeline_info SET file_size_u = (SELECT oln_utp+cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)" FROM v_timeline WHERE tp = ? AND tp_id = (SELECT MAX(tp_id) FROM v_timeline WHERE tp = ?)) WHERE id = ?;",
+        "UPDATE timeline_info SET file_size_j = (SELECT oln_jtp+cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)" FROM v_timeline WHERE tp = ? AND tp_id = (SELECT MAX(tp_id) FROM v_timeline WHERE tp = ?)) WHERE id = ?;",
+    };
     LPSTR szTIMELINE_SQL1[] = {
         // populate timeline_info with basic information:
         "DROP TABLE IF EXISTS timeline_info;",
@@ -146,16 +537,6 @@ BOOL FcTimeline_Initialize()
         "DROP VIEW IF EXISTS v_timeline;",
         "CREATE TABLE timeline ( id INTEGER PRIMARY KEY AUTOINCREMENT, tp INT, tp_id INTEGER, id_str INTEGER, ft INTEGER, ac INT, pid INT, data64 INTEGER, oln_u INTEGER, oln_j INTEGER, oln_utp INTEGER, oln_jtp INTEGER );"
         "CREATE VIEW v_timeline AS SELECT * FROM timeline, str WHERE timeline.id_str = str.id;",
-        "CREATE UNIQUE INDEX idx_timeline_tpid     ON timeline(tp, tp_id);",
-        "CREATE UNIQUE INDEX idx_timeline_oln_u    ON timeline(oln_u);",
-        "CREATE UNIQUE INDEX idx_timeline_oln_j    ON timeline(oln_j);"
-        "CREATE UNIQUE INDEX idx_timeline_oln_utp  ON timeline(tp, oln_utp);",
-        "CREATE UNIQUE INDEX idx_timeline_oln_jtp  ON timeline(tp, oln_jtp);",
-        "INSERT INTO timeline (tp, tp_id, id_str, ft, ac, pid, data64, oln_u, oln_j, oln_utp, oln_jtp) SELECT td.tp, (SUM(1) OVER (PARTITION BY td.tp ORDER BY td.ft DESC, td.id)), td.id_str, td.ft, td.ac, td.pid, td.data64, (SUM(str.cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)")  OVER (ORDER BY td.ft DESC, td.id) - str.cbu-"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)"), (SUM(str.cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)") OVER (ORDER BY td.ft DESC, td.id) - str.cbj-"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)"), (SUM(str.cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)")  OVER (PARTITION BY td.tp ORDER BY td.ft DESC, td.id) - str.cbu-"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)"), (SUM(str.cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)") OVER (PARTITION BY td.tp ORDER BY td.ft DESC, td.id) - str.cbj-"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)") FROM timeline_data td, str WHERE str.id = td.id_str ORDER BY td.ft DESC, td.id;",
-        "DROP TABLE timeline_data;"
-        // update timeline_info with sizes for 'all' file (utf8 and json).
-        "UPDATE timeline_info SET file_size_u = (SELECT oln_u+cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)" AS cbu_tot FROM v_timeline WHERE id = (SELECT MAX(id) FROM v_timeline)) WHERE id = 0;",
-        "UPDATE timeline_info SET file_size_j = (SELECT oln_j+cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)" AS cbj_tot FROM v_timeline WHERE id = (SELECT MAX(id) FROM v_timeline)) WHERE id = 0;",
     };
     for(i = 0; i < sizeof(szTIMELINE_SQL2) / sizeof(LPCSTR); i++) {
         if(SQLITE_OK != (rc = Fc_SqlExec(szTIMELINE_SQL2[i]))) {
@@ -163,22 +544,67 @@ BOOL FcTimeline_Initialize()
             goto fail;
         }
     }
-    // update timeline_info with sizes for individual types (utf8 and json).
-    LPSTR szTIMELINE_SQL_TIMELINE_UPD[] = {
-        "UPDATE timeline_info SET file_size_u = (SELECT oln_utp+cbu+"STRINGIZE(FC_LINELENGTH_TIMELINE_UTF8)" FROM v_timeline WHERE tp = ? AND tp_id = (SELECT MAX(tp_id) FROM v_timeline WHERE tp = ?)) WHERE id = ?;",
-        "UPDATE timeline_info SET file_size_j = (SELECT oln_jtp+cbj+"STRINGIZE(FC_LINELENGTH_TIMELINE_JSON)" FROM v_timeline WHERE tp = ? AND tp_id = (SELECT MAX(tp_id) FROM v_timeline WHERE tp = ?)) WHERE id = ?;",
-    };
+    // populate main timeline table and timeline_info file sizes (external merge
+    // sort) - on failure fall back to populating it with window-function sql.
     Fc_SqlQueryN("SELECT MAX(id) FROM timeline_info;", 0, NULL, 1, &v, NULL);
     ctxFc->Timeline.cTp = (DWORD)v + 1;
-    for(k = 1; k < ctxFc->Timeline.cTp; k++) {
+    if(!(fSortBuild = FcTimeline_SortBuild(ctxFc->Timeline.cTp, "timeline_data", "timeline", NULL, NULL))) {
+        vmmprintfv_fn("TIMELINE SORT FAILED - FALLBACK TO SQL.\n");
+        for(i = 0; i < sizeof(szTIMELINE_SQL_FALLBACK) / sizeof(LPCSTR); i++) {
+            if(SQLITE_OK != (rc = Fc_SqlExec(szTIMELINE_SQL_FALLBACK[i]))) {
+                vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szTIMELINE_SQL_FALLBACK[i]);
+                goto fail;
+            }
+        }
+    }
+    LPSTR szTIMELINE_SQL3[] = {
+        // create indexes once the timeline table is populated.
+        "CREATE UNIQUE INDEX idx_timeline_tpid     ON timeline(tp, tp_id);",
+        "CREATE UNIQUE INDEX idx_timeline_oln_u    ON timeline(oln_u);",
+        "CREATE UNIQUE INDEX idx_timeline_oln_j    ON timeline(oln_j);",
+        "CREATE UNIQUE INDEX idx_timeline_oln_utp  ON timeline(tp, oln_utp);",
+        "CREATE UNIQUE INDEX idx_timeline_oln_jtp  ON timeline(tp, oln_jtp);",
+        "DROP TABLE timeline_data;"
+    };
+    for(i = 0; i < sizeof(szTIMELINE_SQL3) / sizeof(LPCSTR); i++) {
+        if(SQLITE_OK != (rc = Fc_SqlExec(szTIMELINE_SQL3[i]))) {
+            vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szTIMELINE_SQL3[i]);
+            goto fail;
+        }
+    }
+    // fallback: update timeline_info with file sizes (utf8 and json).
+    for(i = 0; !fSortBuild && (i < ctxFc->Timeline.cTp); i++) {
         for(j = 0; j < 2; j++) {
-            if(SQLITE_DONE != (rc = Fc_SqlQueryN(szTIMELINE_SQL_TIMELINE_UPD[j], 3, (QWORD[]) { k, k, k }, 0, NULL, NULL))) {
-                vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szTIMELINE_SQL_TIMELINE_UPD[j]);
+            szSql = i ? szTIMELINE_SQL_FALLBACK_UPD_TP[j] : szTIMELINE_SQL_FALLBACK_UPD_ALL[j];
+            if(SQLITE_DONE != (rc = Fc_SqlQueryN(szSql, (i ? 3 : 0), (QWORD[]) { i, i, i }, 0, NULL, NULL))) {
+                vmmprintf_fn("FAIL INITIALIZE TIMELINE WITH SQLITE ERROR CODE %i, QUERY: %s\n", rc, szSql);
                 goto fail;
             }
         }
     }
-    // populate timeline info struct
+    if(!FcTimeline_InitializeInfo()) { goto fail; }
+    ctxFc->fEnableTimeline = TRUE;
+    fResult = TRUE;
+fail:
+    return fResult;
+}
+
+/*
+* Load the timeline type information from an already initialized database.
+* -- return
+*/
+_Success_(return)
+BOOL FcTimeline_InitializeInfo()
+{
+    BOOL f, fResult = FALSE;
+    DWORD i, j;
+    QWORD v = 0;
+    sqlite3 *hSql = NULL;
+    sqlite3_stmt *hStmt = NULL;
+    PFC_TIMELINE_INFO pi;
+    if(SQLITE_OK != Fc_SqlQueryN("SELECT MAX(id) FROM timeline_info;", 0, NULL, 1, &v, NULL)) { goto fail; }
+    ctxFc->Timeline.cTp = (DWORD)v + 1;
+    LocalFree(ctxFc->Timeline.pInfo);
     if(!(ctxFc->Timeline.pInfo = LocalAlloc(LMEM_ZEROINIT, (ctxFc->Timeline.cTp) * sizeof(FC_TIMELINE_INFO)))) { goto fail; }
     if(!(hSql = Fc_SqlReserve())) { goto fail; }
     if(SQLITE_OK != sqlite3_prepare_v2(hSql, "SELECT * FROM timeline_info", -1, &hStmt, 0)) { goto fail; }
@@ -199,7 +625,6 @@ BOOL FcTimeline_Initialize()
         pi->dwFileSizeUTF8 = sqlite3_column_int(hStmt, 4);
         pi->dwFileSizeJSON = sqlite3_column_int(hStmt, 5);
     }
-    ctxFc->fEnableTimeline = TRUE;
     fResult = TRUE;
 fail:
     sqlite3_finalize(hStmt);
@@ -313,6 +738,9 @@ _Success_(return)
 BOOL FcTimeline_GetIdFromPosition(_In_ DWORD dwTimelineType, _In_ BOOL fJSON, _In_ QWORD qwFilePos, _Out_ PQWORD pqwId)
 {
     QWORD v[] = { max(2048, qwFilePos) - 2048, qwFilePos, dwTimelineType };
+    if(!fJSON && (dwTimelineType < ctxFc->Timeline.cTp) && ctxFc->Timeline.pInfo[dwTimelineType].pObFileUTF8) {
+        return FcFile_GetIdFromPosition(ctxFc->Timeline.pInfo[dwTimelineType].pObFileUTF8, qwFilePos, pqwId);
+    }
     DWORD iSQL = (dwTimelineType ? 2 : 0) + (fJSON ? 1 : 0);
     LPSTR szSQL[4] = {
         "SELECT MAX(id) FROM timeline WHERE oln_u >= ? AND oln_u <= ?",
@@ -322,3 +750,71 @@ BOOL FcTimeline_GetIdFromPosition(_In_ DWORD dwTimelineType, _In_ BOOL fJSON, _I
     };
     return (SQLITE_OK == Fc_SqlQueryN(szSQL[iSQL], (dwTimelineType ? 3 : 2), v, 1, pqwId, NULL));
 }
+
+/*
+* Render a single utf-8 timeline file line (including trailing newline).
+* -- pe
+* -- szu
+* -- cszu
+* -- return = the number of bytes written.
+*/
+DWORD FcTimeline_FormatLineUTF8(_In_ PFC_MAP_TIMELINEENTRY pe, _Out_writes_(cszu) LPSTR szu, _In_ DWORD cszu)
+{
+    DWORD o, dwEntryType, dwEntryAction;
+    CHAR szTime[24];
+    Util_FileTime2String((PFILETIME)&pe->ft, szTime);
+    dwEntryType = (pe->tp < ctxFc->Timeline.cTp) ? pe->tp : 0;
+    dwEntryAction = (pe->ac <= FC_TIMELINE_ACTION_MAX) ? pe->ac : FC_TIMELINE_ACTION_NONE;
+    o = snprintf(
+        szu,
+        cszu,
+        "%s  %s %s%10i %16llx ",
+        szTime,
+        ctxFc->Timeline.pInfo[dwEntryType].szNameShort,
+        FC_TIMELINE_ACTION_STR[dwEntryAction],
+        pe->pid,
+        pe->data64
+    );
+    o += WideCharToMultiByte(CP_UTF8, 0, pe->wszText, -1, szu + o, (int)(cszu - o), NULL, NULL);
+    if(o) {
+        szu[o - 1] = '\n';
+    }
+    return o;
+}
+
+/*
+* Render the utf-8 timeline files into pre-rendered memory-mapped files. The
+* rendering is done once at the end of the forensic initialization; on error
+* the file is skipped and reads fall back to rendering from the database.
+*/
+VOID FcTimeline_RenderFile()
+{
+    BOOL fResult;
+    DWORD i, iTp;
+    QWORD qwId;
+    PFC_TIMELINE_INFO pi;
+    PFCOB_FILE pObFile;
+    PFCOB_MAP_TIMELINE pObMap = NULL;
+    CHAR szu[0x2000];
+    if(!ctxFc->fEnableTimeline) { return; }
+    for(iTp = 0; iTp < ctxFc->Timeline.cTp; iTp++) {
+        pi = ctxFc->Timeline.pInfo + iTp;
+        if(!pi->wszNameFileUTF8[0] || !(pObFile = FcFile_New(pi->dwFileSizeUTF8))) { continue; }
+        fResult = TRUE;
+        for(qwId = 1; fResult; qwId += 0x1000) {
+            if(!FcTimelineMap_GetFromIdRange(pi->dwId, qwId, 0x1000, &pObMap)) { fResult = FALSE; break; }
+            if(!pObMap->cMap) { break; }
+            for(i = 0; fResult && (i < pObMap->cMap); i++) {
+                fResult = FcFile_AppendLine(pObFile, pObMap->pMap[i].id, szu, FcTimeline_FormatLineUTF8(pObMap->pMap + i, szu, sizeof(szu)));
+            }
+            Ob_DECREF_NULL(&pObMap);
+        }
+        Ob_DECREF_NULL(&pObMap);
+        if(fResult && (pObFile->cb == pi->dwFileSizeUTF8)) {
+            pi->pObFileUTF8 = pObFile;
+        } else {
+            vmmprintfv_fn("FAIL RENDER TIMELINE FILE: %S\n", pi->wszNameFileUTF8);
+            Ob_DECREF(pObFile);
+        }
+    }
+}
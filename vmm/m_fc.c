@@ -41,6 +41,9 @@ LPCSTR szMFC_README =
 NTSTATUS M_Fc_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
     BYTE btp;
+    DWORD csz;
+    LPSTR sz;
+    NTSTATUS nt;
     if(!wcscmp(ctx->wszPath, L"readme.txt")) {
         return Util_VfsReadFile_FromPBYTE((PBYTE)szMFC_README, strlen(szMFC_README), pb, cb, pcbRead, cbOffset);
     }
@@ -55,6 +58,14 @@ NTSTATUS M_Fc_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWORD c
             return Util_VfsReadFile_FromPBYTE(NULL, 0, pb, cb, pcbRead, cbOffset);
         }
     }
+    if(!_wcsicmp(ctx->wszPath, L"scan_statistics.txt")) {
+        if(!ctxFc || !FcScanPhysMem_StatisticsToString(&sz, &csz)) {
+            return Util_VfsReadFile_FromPBYTE(NULL, 0, pb, cb, pcbRead, cbOffset);
+        }
+        nt = Util_VfsReadFile_FromPBYTE(sz, csz, pb, cb, pcbRead, cbOffset);
+        LocalFree(sz);
+        return nt;
+    }
     return VMMDLL_STATUS_FILE_INVALID;
 }
 
@@ -72,9 +83,15 @@ NTSTATUS M_Fc_Write(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _In_ PBYTE pb, _In_ DWORD c
 
 BOOL M_Fc_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileList)
 {
+    DWORD csz = 0;
+    LPSTR sz;
+    if(ctxFc && FcScanPhysMem_StatisticsToString(&sz, &csz)) {
+        LocalFree(sz);
+    }
     VMMDLL_VfsList_AddFile(pFileList, L"forensic_enable.txt", 1, NULL);
     VMMDLL_VfsList_AddFile(pFileList, L"database.txt", ctxFc ? wcslen_u8(ctxFc->db.wszDatabaseWinPath) : 0, NULL);
     VMMDLL_VfsList_AddFile(pFileList, L"readme.txt", strlen(szMFC_README), NULL);
+    VMMDLL_VfsList_AddFile(pFileList, L"scan_statistics.txt", csz, NULL);
     return TRUE;
 }
 
@@ -17,12 +17,12 @@
 NTSTATUS M_FcNtfs_ReadInfo(_Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
     NTSTATUS nt = VMMDLL_STATUS_FILE_INVALID;
-    PFC_MAP_NTFSENTRY pe;
     PFCOB_MAP_NTFS pObNtfsMap = NULL;
     QWORD i, o, qwIdBase, qwIdTop, cId, cszuBuffer, cbOffsetBuffer;
-    DWORD iDirDepth;
     LPSTR szuBuffer = NULL;
-    CHAR szTimeCreate[24], szTimeModify[24];
+    if(ctxFc->File.pObNtfs) {
+        return FcFile_Read(ctxFc->File.pObNtfs, pb, cb, pcbRead, cbOffset);
+    }
     if(!FcNtfs_GetIdFromPosition(cbOffset, FALSE, &qwIdBase)) { goto fail; }
     if(!FcNtfs_GetIdFromPosition(cbOffset + cb, FALSE, &qwIdTop)) { goto fail; }
     cId = min(cb / M_NTFS_INFO_LINELENGTH_UTF8, qwIdTop - qwIdBase) + 1;
@@ -32,27 +32,7 @@ NTSTATUS M_FcNtfs_ReadInfo(_Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead,
     cszuBuffer = 0x01000000;
     if(!(szuBuffer = LocalAlloc(0, cszuBuffer))) { goto fail; }
     for(i = 0, o = 0; (i < pObNtfsMap->cMap) && (o < cszuBuffer - 0x1000); i++) {
-        pe = pObNtfsMap->pMap + i;
-        Util_FileTime2String((PFILETIME)&pe->ftCreate, szTimeCreate);
-        Util_FileTime2String((PFILETIME)&pe->ftModify, szTimeModify);
-        iDirDepth = min(20, pe->dwDirDepth);
-        o += snprintf(
-            szuBuffer + o,
-            cszuBuffer - o,
-            "%6llx%12llx %8x %s : %s %12llx %3x %c ",
-            pe->qwId,
-            pe->pa,
-            (pe->dwMftId & 0xf0000000 ? 0 : pe->dwMftId),
-            szTimeCreate,
-            szTimeModify,
-            pe->qwFileSize,
-            pe->dwFileSizeResident,
-            pe->fDir ? 'D' : ' '
-        );
-        o += WideCharToMultiByte(CP_UTF8, 0, pe->wszText, -1, szuBuffer + o, (int)(cszuBuffer - o), NULL, NULL);
-        if(o) {
-            szuBuffer[o - 1] = '\n';
-        }
+        o += FcNtfs_FormatLineUTF8(pObNtfsMap->pMap + i, szuBuffer + o, (DWORD)(cszuBuffer - o));
     }
     nt = Util_VfsReadFile_FromPBYTE(szuBuffer, o, pb, cb, pcbRead, cbOffset - cbOffsetBuffer);
 fail:
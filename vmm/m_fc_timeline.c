@@ -14,12 +14,12 @@
 NTSTATUS M_FcTimeline_ReadInfo(_In_ DWORD dwTimelineType, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
     NTSTATUS nt = VMMDLL_STATUS_FILE_INVALID;
-    PFC_MAP_TIMELINEENTRY pe;
     PFCOB_MAP_TIMELINE pObMap = NULL;
     QWORD i, o, qwIdBase, qwIdTop, cId, cszuBuffer, cbOffsetBuffer;
     LPSTR szuBuffer = NULL;
-    DWORD dwEntryType, dwEntryAction;
-    CHAR szTime[24];
+    if((dwTimelineType < ctxFc->Timeline.cTp) && ctxFc->Timeline.pInfo[dwTimelineType].pObFileUTF8) {
+        return FcFile_Read(ctxFc->Timeline.pInfo[dwTimelineType].pObFileUTF8, pb, cb, pcbRead, cbOffset);
+    }
     if(!FcTimeline_GetIdFromPosition(dwTimelineType, FALSE, cbOffset, &qwIdBase)) { goto fail; }
     if(!FcTimeline_GetIdFromPosition(dwTimelineType, FALSE, cbOffset + cb, &qwIdTop)) { goto fail; }
     cId = min(cb / FC_LINELENGTH_TIMELINE_UTF8, qwIdTop - qwIdBase) + 1;
@@ -29,24 +29,7 @@ NTSTATUS M_FcTimeline_ReadInfo(_In_ DWORD dwTimelineType, _Out_ PBYTE pb, _In_ D
     cszuBuffer = 0x01000000;
     if(!(szuBuffer = LocalAlloc(0, cszuBuffer))) { goto fail; }
     for(i = 0, o = 0; (i < pObMap->cMap) && (o < cszuBuffer - 0x1000); i++) {
-        pe = pObMap->pMap + i;
-        Util_FileTime2String((PFILETIME)&pe->ft, szTime);
-        dwEntryType = (pe->tp < ctxFc->Timeline.cTp) ? pe->tp : 0;
-        dwEntryAction = (pe->ac <= FC_TIMELINE_ACTION_MAX) ? pe->ac : FC_TIMELINE_ACTION_NONE;
-        o += snprintf(
-            szuBuffer + o,
-            cszuBuffer - o,
-            "%s  %s %s%10i %16llx ",
-            szTime,
-            ctxFc->Timeline.pInfo[dwEntryType].szNameShort,
-            FC_TIMELINE_ACTION_STR[dwEntryAction],
-            pe->pid,
-            pe->data64
-        );
-        o += WideCharToMultiByte(CP_UTF8, 0, pe->wszText, -1, szuBuffer + o, (int)(cszuBuffer - o), NULL, NULL);
-        if(o) {
-            szuBuffer[o - 1] = '\n';
-        }
+        o += FcTimeline_FormatLineUTF8(pObMap->pMap + i, szuBuffer + o, (DWORD)(cszuBuffer - o));
     }
     nt = Util_VfsReadFile_FromPBYTE(szuBuffer, o, pb, cb, pcbRead, cbOffset - cbOffsetBuffer);
 fail:
@@ -22,6 +22,19 @@
 #include "vmmwinreg.h"
 #include "statistics.h"
 
+/*
+* Render the .status/warmmaps file contents.
+* -- sz = buffer of at least 0x40 chars.
+* -- return = number of chars rendered.
+*/
+DWORD MStatus_WarmMapsToString(_Out_writes_(0x40) LPSTR sz)
+{
+    int cch = snprintf(sz, 0x40, "%s %08x/%08x\n",
+        (ctxVmm->WarmMaps.fActive ? "ACTIVE   " : (ctxVmm->WarmMaps.fCompleted ? "COMPLETED" : "INACTIVE ")),
+        ctxVmm->WarmMaps.cProcessDone, ctxVmm->WarmMaps.cProcessTotal);
+    return (cch > 0) ? min(0x3f, (DWORD)cch) : 0;
+}
+
 /*
 * Read : function as specified by the module manager. The module manager will
 * call into this callback function whenever a read shall occur from a "file".
@@ -34,11 +47,12 @@
 */
 NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
 {
-    DWORD cchBuffer;
-    CHAR szBuffer[0x800];
+    DWORD i, cchBuffer;
+    CHAR szBuffer[0x1000];
     DWORD cbCallStatistics = 0;
     PBYTE pbCallStatistics = NULL;
-    QWORD cPageReadTotal, cPageFailTotal;
+    QWORD cPageReadTotal, cPageFailTotal, cVTlbHitRate, cReadAheadIssued, cReadAheadHit, cReadAheadAccuracy;
+    QWORD cIoSchedWaitAvg[VMM_IOSCHED_CLASS_MAX];
     NTSTATUS nt;
     if(!_wcsicmp(ctx->wszPath, L"config_process_show_terminated")) {
         return Util_VfsReadFile_FromBOOL(ctxVmm->flags & VMM_FLAG_PROCESS_SHOW_TERMINATED, pb, cb, pcbRead, cbOffset);
@@ -46,6 +60,26 @@ NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWOR
     if(!_wcsicmp(ctx->wszPath, L"config_cache_enable")) {
         return Util_VfsReadFile_FromBOOL(!(ctxVmm->flags & VMM_FLAG_NOCACHE), pb, cb, pcbRead, cbOffset);
     }
+    if(!_wcsicmp(ctx->wszPath, L"config_cache_budget_mb")) {
+        return Util_VfsReadFile_FromDWORD(ctxVmm->Cache.Budget.cMB, pb, cb, pcbRead, cbOffset, FALSE);
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_cache_adaptive")) {
+        return Util_VfsReadFile_FromBOOL(ctxVmm->Cache.Budget.fAdaptive, pb, cb, pcbRead, cbOffset);
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_read_sched_slice")) {
+        return Util_VfsReadFile_FromDWORD(ctxVmm->IoSched.cSlice, pb, cb, pcbRead, cbOffset, FALSE);
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_read_async_depth")) {
+        return Util_VfsReadFile_FromDWORD(ctxVmm->ReadAsync.cDepth, pb, cb, pcbRead, cbOffset, FALSE);
+    }
+#ifdef VMM_TEST_LATENCY_INJECT
+    if(!_wcsicmp(ctx->wszPath, L"config_read_latency_inject_ms")) {
+        return Util_VfsReadFile_FromDWORD(ctxVmm->ReadAsync.cMsLatencyInject, pb, cb, pcbRead, cbOffset, FALSE);
+    }
+#endif /* VMM_TEST_LATENCY_INJECT */
+    if(!_wcsicmp(ctx->wszPath, L"config_read_coalesce_max")) {
+        return Util_VfsReadFile_FromDWORD(ctxVmm->Coalesce.cbMax, pb, cb, pcbRead, cbOffset, FALSE);
+    }
     if(!_wcsicmp(ctx->wszPath, L"config_paging_enable")) {
         return Util_VfsReadFile_FromBOOL(!(ctxVmm->flags & VMM_FLAG_NOPAGING), pb, cb, pcbRead, cbOffset);
     }
@@ -76,11 +110,19 @@ NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWOR
     if(!_wcsicmp(ctx->wszPath, L"statistics")) {
         cPageReadTotal = ctxVmm->stat.page.cPrototype + ctxVmm->stat.page.cTransition + ctxVmm->stat.page.cDemandZero + ctxVmm->stat.page.cVAD + ctxVmm->stat.page.cCacheHit + ctxVmm->stat.page.cPageFile + ctxVmm->stat.page.cCompressed;
         cPageFailTotal = ctxVmm->stat.page.cFailCacheHit + ctxVmm->stat.page.cFailVAD + ctxVmm->stat.page.cFailPageFile + ctxVmm->stat.page.cFailCompressed + ctxVmm->stat.page.cFail;
-        cchBuffer = snprintf(szBuffer, 0x800,
+        cVTlbHitRate = (ctxVmm->stat.cVTlbHit + ctxVmm->stat.cVTlbMiss) ? (100 * ctxVmm->stat.cVTlbHit / (ctxVmm->stat.cVTlbHit + ctxVmm->stat.cVTlbMiss)) : 0;
+        cReadAheadIssued = ctxVmm->stat.readahead.cIssued[VMM_READAHEAD_TP_RANDOM] + ctxVmm->stat.readahead.cIssued[VMM_READAHEAD_TP_STREAM];
+        cReadAheadHit = ctxVmm->stat.readahead.cHit[VMM_READAHEAD_TP_RANDOM] + ctxVmm->stat.readahead.cHit[VMM_READAHEAD_TP_STREAM];
+        cReadAheadAccuracy = cReadAheadIssued ? (100 * min(cReadAheadHit, cReadAheadIssued) / cReadAheadIssued) : 0;
+        for(i = 0; i < VMM_IOSCHED_CLASS_MAX; i++) {
+            cIoSchedWaitAvg[i] = ctxVmm->stat.iosched[i].cWait ? (ctxVmm->stat.iosched[i].usWaitTotal / ctxVmm->stat.iosched[i].cWait) : 0;
+        }
+        cchBuffer = snprintf(szBuffer, sizeof(szBuffer),
             "VMM STATISTICS   (4kB PAGES / COUNTS - HEXADECIMAL)\n" \
             "===================================================\n" \
             "PHYSICAL MEMORY:                      \n" \
             "  READ CACHE HIT:               %16llx\n" \
+            "  READ FAIL CACHE HIT:          %16llx\n" \
             "  READ RETRIEVED:               %16llx\n" \
             "  READ FAIL:                    %16llx\n" \
             "  WRITE:                        %16llx\n" \
@@ -102,18 +144,86 @@ NTSTATUS MStatus_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWOR
             "  CACHE HIT:                    %16llx\n" \
             "  RETRIEVED:                    %16llx\n" \
             "  FAILED:                       %16llx\n" \
+            "TRANSLATION CACHE (VA->PA):           \n" \
+            "  CACHE HIT:                    %16llx\n" \
+            "  CACHE MISS:                   %16llx\n" \
+            "  HIT RATE (PERCENT, DECIMAL):  %16lli\n" \
+            "NEGATIVE CACHE (FAILED READS):        \n" \
+            "  INSERT:                       %16llx\n" \
+            "  EVICT:                        %16llx\n" \
+            "  EXPIRE:                       %16llx\n" \
+            "READ-AHEAD (SPECULATIVE READS):       \n" \
+            "  ACCESS SEQUENTIAL:            %16llx\n" \
+            "  ACCESS STRIDED:               %16llx\n" \
+            "  ACCESS RANDOM:                %16llx\n" \
+            "  PAGES READ AHEAD (STREAM):    %16llx\n" \
+            "  PAGES READ AHEAD (RANDOM):    %16llx\n" \
+            "  PAGES HIT (STREAM):           %16llx\n" \
+            "  PAGES HIT (RANDOM):           %16llx\n" \
+            "  ACCURACY (PERCENT, DECIMAL):  %16lli\n" \
+            "  WASTED BYTES:                 %16llx\n" \
+            "  WINDOW STREAM MAX (PAGES):    %16llx\n" \
+            "  WINDOW RANDOM (PAGES):        %16llx\n" \
+            "DEVICE READ (COALESCED):              \n" \
+            "  DEVICE CALLS:                 %16llx\n" \
+            "  PAGES:                        %16llx\n" \
+            "  DUPLICATE PAGES MERGED:       %16llx\n" \
+            "  CONTIGUOUS READS:             %16llx\n" \
+            "  CONTIGUOUS READ PAGES:        %16llx\n" \
+            "  CONTIGUOUS READ FAIL:         %16llx\n" \
+            "ASYNC READ:                           \n" \
+            "  BATCHES SUBMITTED:            %16llx\n" \
+            "  BATCHES SYNCHRONOUS:          %16llx\n" \
+            "  BLOCKING WAITS:               %16llx\n" \
+            "  MAX IN FLIGHT:                %16llx\n" \
+            "I/O SCHEDULER:                        \n" \
+            "  INTERACTIVE:                        \n" \
+            "    REQUESTS:                   %16llx\n" \
+            "    DEVICE READS (SLICES):      %16llx\n" \
+            "    QUEUED:                     %16llx\n" \
+            "    WAIT AVG (US, DECIMAL):     %16lli\n" \
+            "    WAIT MAX (US, DECIMAL):     %16lli\n" \
+            "  REFRESH:                            \n" \
+            "    REQUESTS:                   %16llx\n" \
+            "    DEVICE READS (SLICES):      %16llx\n" \
+            "    QUEUED:                     %16llx\n" \
+            "    WAIT AVG (US, DECIMAL):     %16lli\n" \
+            "    WAIT MAX (US, DECIMAL):     %16lli\n" \
+            "  BULK:                               \n" \
+            "    REQUESTS:                   %16llx\n" \
+            "    DEVICE READS (SLICES):      %16llx\n" \
+            "    QUEUED:                     %16llx\n" \
+            "    WAIT AVG (US, DECIMAL):     %16lli\n" \
+            "    WAIT MAX (US, DECIMAL):     %16lli\n" \
             "PHYSICAL MEMORY REFRESH:        %16llx\n" \
             "TLB MEMORY REFRESH:             %16llx\n" \
             "PROCESS PARTIAL REFRESH:        %16llx\n" \
             "PROCESS FULL REFRESH:           %16llx\n",
-            ctxVmm->stat.cPhysCacheHit, ctxVmm->stat.cPhysReadSuccess, ctxVmm->stat.cPhysReadFail, ctxVmm->stat.cPhysWrite,
+            ctxVmm->stat.cPhysCacheHit, ctxVmm->stat.cPhysFailCacheHit, ctxVmm->stat.cPhysReadSuccess, ctxVmm->stat.cPhysReadFail, ctxVmm->stat.cPhysWrite,
             cPageReadTotal, ctxVmm->stat.page.cPrototype, ctxVmm->stat.page.cTransition, ctxVmm->stat.page.cDemandZero, ctxVmm->stat.page.cVAD, ctxVmm->stat.page.cCacheHit, ctxVmm->stat.page.cPageFile, ctxVmm->stat.page.cCompressed,
             cPageFailTotal, ctxVmm->stat.page.cFailCacheHit, ctxVmm->stat.page.cFailVAD, ctxVmm->stat.page.cFailPageFile, ctxVmm->stat.page.cFailCompressed,
             ctxVmm->stat.cTlbCacheHit, ctxVmm->stat.cTlbReadSuccess, ctxVmm->stat.cTlbReadFail,
+            ctxVmm->stat.cVTlbHit, ctxVmm->stat.cVTlbMiss, cVTlbHitRate,
+            ctxVmm->stat.negcache.cInsert, ctxVmm->stat.negcache.cEvict, ctxVmm->stat.negcache.cExpire,
+            ctxVmm->stat.readahead.cAccessSequential, ctxVmm->stat.readahead.cAccessStrided, ctxVmm->stat.readahead.cAccessRandom,
+            ctxVmm->stat.readahead.cIssued[VMM_READAHEAD_TP_STREAM], ctxVmm->stat.readahead.cIssued[VMM_READAHEAD_TP_RANDOM],
+            ctxVmm->stat.readahead.cHit[VMM_READAHEAD_TP_STREAM], ctxVmm->stat.readahead.cHit[VMM_READAHEAD_TP_RANDOM],
+            cReadAheadAccuracy, ctxVmm->stat.readahead.cWasted * 0x1000,
+            (QWORD)ctxVmm->ReadAhead.cWindowMax, (QWORD)ctxVmm->ReadAhead.cWindowRandom,
+            ctxVmm->stat.coalesce.cDeviceCall, ctxVmm->stat.coalesce.cPage, ctxVmm->stat.coalesce.cDuplicate,
+            ctxVmm->stat.coalesce.cRun, ctxVmm->stat.coalesce.cRunPage, ctxVmm->stat.coalesce.cRunFail,
+            ctxVmm->stat.readasync.cSubmit, ctxVmm->stat.readasync.cSync, ctxVmm->stat.readasync.cWaitBlock, ctxVmm->stat.readasync.cInFlightMax,
+            ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_INTERACTIVE].cRequest, ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_INTERACTIVE].cSlice, ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_INTERACTIVE].cWait, cIoSchedWaitAvg[VMM_IOSCHED_CLASS_INTERACTIVE], ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_INTERACTIVE].usWaitMax,
+            ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_REFRESH].cRequest, ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_REFRESH].cSlice, ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_REFRESH].cWait, cIoSchedWaitAvg[VMM_IOSCHED_CLASS_REFRESH], ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_REFRESH].usWaitMax,
+            ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_BULK].cRequest, ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_BULK].cSlice, ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_BULK].cWait, cIoSchedWaitAvg[VMM_IOSCHED_CLASS_BULK], ctxVmm->stat.iosched[VMM_IOSCHED_CLASS_BULK].usWaitMax,
             ctxVmm->stat.cPhysRefreshCache, ctxVmm->stat.cTlbRefreshCache, ctxVmm->stat.cProcessRefreshPartial, ctxVmm->stat.cProcessRefreshFull
         );
         return Util_VfsReadFile_FromPBYTE(szBuffer, cchBuffer, pb, cb, pcbRead, cbOffset);
     }
+    if(!_wcsicmp(ctx->wszPath, L"warmmaps")) {
+        cchBuffer = MStatus_WarmMapsToString(szBuffer);
+        return Util_VfsReadFile_FromPBYTE(szBuffer, cchBuffer, pb, cb, pcbRead, cbOffset);
+    }
     if(!_wcsicmp(ctx->wszPath, L"statistics_fncall")) {
         Statistics_CallToString(NULL, 0, &cbCallStatistics);
         pbCallStatistics = LocalAlloc(0, cbCallStatistics);
@@ -177,6 +287,7 @@ NTSTATUS MStatus_Write(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _In_ PBYTE pb, _In_ DWOR
 {
     NTSTATUS nt;
     BOOL fEnable = FALSE;
+    DWORD dwValue;
     if(!_wcsicmp(ctx->wszPath, L"config_process_show_terminated")) {
         nt = Util_VfsWriteFile_BOOL(&fEnable, pb, cb, pcbWrite, cbOffset);
         if(nt == VMMDLL_STATUS_SUCCESS) {
@@ -193,6 +304,46 @@ NTSTATUS MStatus_Write(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _In_ PBYTE pb, _In_ DWOR
         }
         return nt;
     }
+    if(!_wcsicmp(ctx->wszPath, L"config_cache_budget_mb")) {
+        dwValue = ctxVmm->Cache.Budget.cMB;
+        nt = Util_VfsWriteFile_DWORD(&dwValue, pb, cb, pcbWrite, cbOffset, 0, 0);
+        if(nt == VMMDLL_STATUS_SUCCESS) {
+            VmmCacheBudgetSet(dwValue);
+        }
+        return nt;
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_read_sched_slice")) {
+        dwValue = ctxVmm->IoSched.cSlice;
+        nt = Util_VfsWriteFile_DWORD(&dwValue, pb, cb, pcbWrite, cbOffset, 0, VMM_IOSCHED_SLICE_MAX);
+        if(nt == VMMDLL_STATUS_SUCCESS) {
+            VmmIoSchedSliceSet(dwValue);
+        }
+        return nt;
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_read_async_depth")) {
+        dwValue = ctxVmm->ReadAsync.cDepth;
+        nt = Util_VfsWriteFile_DWORD(&dwValue, pb, cb, pcbWrite, cbOffset, 0, VMM_READASYNC_DEPTH_MAX);
+        if(nt == VMMDLL_STATUS_SUCCESS) {
+            VmmReadAsyncDepthSet(dwValue);
+        }
+        return nt;
+    }
+#ifdef VMM_TEST_LATENCY_INJECT
+    if(!_wcsicmp(ctx->wszPath, L"config_read_latency_inject_ms")) {
+        return Util_VfsWriteFile_DWORD((PDWORD)&ctxVmm->ReadAsync.cMsLatencyInject, pb, cb, pcbWrite, cbOffset, 0, 10000);
+    }
+#endif /* VMM_TEST_LATENCY_INJECT */
+    if(!_wcsicmp(ctx->wszPath, L"config_read_coalesce_max")) {
+        dwValue = ctxVmm->Coalesce.cbMax;
+        nt = Util_VfsWriteFile_DWORD(&dwValue, pb, cb, pcbWrite, cbOffset, 0, VMM_COALESCE_CB_MAX);
+        if(nt == VMMDLL_STATUS_SUCCESS) {
+            VmmReadCoalesceSet(dwValue);
+        }
+        return nt;
+    }
+    if(!_wcsicmp(ctx->wszPath, L"config_cache_adaptive")) {
+        return Util_VfsWriteFile_BOOL(&ctxVmm->Cache.Budget.fAdaptive, pb, cb, pcbWrite, cbOffset);
+    }
     if(!_wcsicmp(ctx->wszPath, L"config_paging_enable")) {
         nt = Util_VfsWriteFile_BOOL(&fEnable, pb, cb, pcbWrite, cbOffset);
         if(nt == VMMDLL_STATUS_SUCCESS) {
@@ -274,11 +425,20 @@ NTSTATUS MStatus_Write(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _In_ PBYTE pb, _In_ DWOR
 BOOL MStatus_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileList)
 {
     DWORD cbCallStatistics = 0;
+    CHAR szWarmMaps[0x40];
     // not module root directory -> fail!
     if(ctx->wszPath[0]) { return FALSE; }
     // "root" view
     if(!ctx->pProcess) {
         VMMDLL_VfsList_AddFile(pFileList, L"config_cache_enable", 1, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"config_cache_budget_mb", 8, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"config_cache_adaptive", 1, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"config_read_coalesce_max", 8, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"config_read_async_depth", 8, NULL);
+#ifdef VMM_TEST_LATENCY_INJECT
+        VMMDLL_VfsList_AddFile(pFileList, L"config_read_latency_inject_ms", 8, NULL);
+#endif /* VMM_TEST_LATENCY_INJECT */
+        VMMDLL_VfsList_AddFile(pFileList, L"config_read_sched_slice", 8, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_paging_enable", 1, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_statistics_fncall", 1, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_refresh_enable", 1, NULL);
@@ -292,7 +452,8 @@ BOOL MStatus_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileList)
         VMMDLL_VfsList_AddFile(pFileList, L"config_symbolcache", strlen(ctxMain->pdb.szLocal), NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_symbolserver", strlen(ctxMain->pdb.szServer), NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_symbolserver_enable", 1, NULL);
-        VMMDLL_VfsList_AddFile(pFileList, L"statistics", 1103, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"statistics", 1289, NULL);
+        VMMDLL_VfsList_AddFile(pFileList, L"warmmaps", MStatus_WarmMapsToString(szWarmMaps), NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_printf_enable", 1, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_printf_v", 1, NULL);
         VMMDLL_VfsList_AddFile(pFileList, L"config_printf_vv", 1, NULL);
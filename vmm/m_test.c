@@ -0,0 +1,1122 @@
+// m_test.c : implementation of the .test built-in module (test builds only).
+//
+// (c) Ulf Frisk, 2018-2020
+// Author: Ulf Frisk, pcileech@frizk.net
+//
+
+/*
+* The m_test module registers itself with the name '.test' with the plugin
+* manager - but only in builds with VMM_TEST_SELFTEST defined (vmm.h).
+*
+* The module exposes internal self-tests and benchmarks which cannot be driven
+* through the public API. Each test is a file in the module root directory:
+* writing a decimal parameter (0 = default) to the file runs the test to
+* completion, reading the file returns the result of the last run. Results
+* which are tests contain a PASS or FAIL line. The drivers in vmm_example
+* (vmmdll_test.c) run the tests against a memory dump.
+* The config_* files are test knobs (decimal DWORDs in ctxVmm->Test) which
+* select alternative internal code paths for comparison by the drivers.
+*/
+
+#include "fc.h"
+#include "mm.h"
+#include "pdb.h"
+#include "pluginmanager.h"
+#include "util.h"
+#include "vmm.h"
+
+#ifdef VMM_TEST_SELFTEST
+
+#define MTEST_RESULT_MAX                0x4000
+
+typedef struct tdMTEST_RESULT {
+    DWORD cch;
+    CHAR sz[MTEST_RESULT_MAX];
+} MTEST_RESULT, *PMTEST_RESULT;
+
+/*
+* Append formatted text to a test result. Text exceeding the result buffer is
+* truncated.
+* -- pr
+* -- szFormat
+* -- ...
+*/
+VOID MTest_Printf(_Inout_ PMTEST_RESULT pr, _In_z_ _Printf_format_string_ LPSTR szFormat, ...)
+{
+    int cch;
+    va_list args;
+    if(pr->cch + 1 >= MTEST_RESULT_MAX) { return; }
+    va_start(args, szFormat);
+    cch = _vsnprintf_s(pr->sz + pr->cch, MTEST_RESULT_MAX - pr->cch, _TRUNCATE, szFormat, args);
+    va_end(args);
+    pr->cch = (cch < 0) ? (MTEST_RESULT_MAX - 1) : (pr->cch + cch);
+}
+
+/*
+* Retrieve a monotonic timestamp in microseconds.
+*/
+QWORD MTest_TimeUs()
+{
+    static LARGE_INTEGER qwFreq = { 0 };
+    LARGE_INTEGER qwNow;
+    if(!qwFreq.QuadPart) { QueryPerformanceFrequency(&qwFreq); }
+    QueryPerformanceCounter(&qwNow);
+    return (qwNow.QuadPart / qwFreq.QuadPart) * 1000000 + (qwNow.QuadPart % qwFreq.QuadPart) * 1000000 / qwFreq.QuadPart;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// workgroup: scheduler overhead and scaling of a fan-out of many tiny tasks.
+// The work-stealing scheduler (VmmWork and VmmWorkGroup) is compared against
+// a copy of the previous ObSet-backed thread pool (MTestWorkRef_*) which is
+// kept here, unmodified apart from its names, as the reference. Tasks are
+// submitted from 1-8 threads concurrently:
+// REF    - previous pool, completion by event counting (InterlockedDecrement
+//          and SetEvent on zero) as in the previous ForeachParallel.
+// EVENT  - VmmWork with the same event counting.
+// GROUP  - VmmWorkGroup_Add and VmmWorkGroup_Join.
+// NESTED - VmmWorkGroup tasks which each fan out and join a group of 100 tasks.
+// ----------------------------------------------------------------------------
+
+#define MTEST_WORKREF_NUM_THREADS       0x20
+#define MTEST_WORK_TASKS_DEFAULT        10000
+#define MTEST_WORK_ROUNDS               10
+#define MTEST_WORK_NESTED               100
+#define MTEST_WORK_TIMEOUT_MS           60000
+
+#define MTEST_WORK_TP_REF               0
+#define MTEST_WORK_TP_EVENT             1
+#define MTEST_WORK_TP_GROUP             2
+#define MTEST_WORK_TP_NESTED            3
+
+typedef struct tdMTEST_WORKREF_UNIT {
+    LPTHREAD_START_ROUTINE pfn;     // function to call
+    PVOID ctx;                      // optional function parameter
+    HANDLE hEventFinish;            // optional event to set when upon work completion
+} MTEST_WORKREF_UNIT, *PMTEST_WORKREF_UNIT;
+
+typedef struct tdMTEST_WORKREF_THREAD_CONTEXT {
+    HANDLE hEventWakeup;
+    HANDLE hThread;
+} MTEST_WORKREF_THREAD_CONTEXT, *PMTEST_WORKREF_THREAD_CONTEXT;
+
+struct {
+    volatile BOOL fEnabled;
+    POB_SET psUnit;
+    POB_SET psThreadAll;
+    POB_SET psThreadAvail;
+} g_MTestWorkRef;
+
+DWORD MTestWorkRef_MainWorkerLoop_ThreadProc(PMTEST_WORKREF_THREAD_CONTEXT ctx)
+{
+    PMTEST_WORKREF_UNIT pu;
+    while(g_MTestWorkRef.fEnabled) {
+        if((pu = (PMTEST_WORKREF_UNIT)ObSet_Pop(g_MTestWorkRef.psUnit))) {
+            pu->pfn(pu->ctx);
+            if(pu->hEventFinish) {
+                SetEvent(pu->hEventFinish);
+            }
+            LocalFree(pu);
+        } else {
+            ResetEvent(ctx->hEventWakeup);
+            ObSet_Push(g_MTestWorkRef.psThreadAvail, (QWORD)ctx);
+            WaitForSingleObject(ctx->hEventWakeup, INFINITE);
+        }
+    }
+    ObSet_Remove(g_MTestWorkRef.psThreadAll, (QWORD)ctx);
+    CloseHandle(ctx->hEventWakeup);
+    CloseHandle(ctx->hThread);
+    LocalFree(ctx);
+    return 1;
+}
+
+_Success_(return)
+BOOL MTestWorkRef_Initialize()
+{
+    PMTEST_WORKREF_THREAD_CONTEXT p;
+    g_MTestWorkRef.fEnabled = TRUE;
+    g_MTestWorkRef.psUnit = ObSet_New();
+    g_MTestWorkRef.psThreadAll = ObSet_New();
+    g_MTestWorkRef.psThreadAvail = ObSet_New();
+    if(!g_MTestWorkRef.psUnit || !g_MTestWorkRef.psThreadAll || !g_MTestWorkRef.psThreadAvail) { return FALSE; }
+    while(ObSet_Size(g_MTestWorkRef.psThreadAll) < MTEST_WORKREF_NUM_THREADS) {
+        if((p = LocalAlloc(LMEM_ZEROINIT, sizeof(MTEST_WORKREF_THREAD_CONTEXT)))) {
+            p->hEventWakeup = CreateEvent(NULL, TRUE, FALSE, NULL);
+            p->hThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)MTestWorkRef_MainWorkerLoop_ThreadProc, p, 0, NULL);
+            ObSet_Push(g_MTestWorkRef.psThreadAll, (QWORD)p);
+        }
+    }
+    return TRUE;
+}
+
+VOID MTestWorkRef_Close()
+{
+    PMTEST_WORKREF_UNIT pu;
+    PMTEST_WORKREF_THREAD_CONTEXT pt = NULL;
+    g_MTestWorkRef.fEnabled = FALSE;
+    while(ObSet_Size(g_MTestWorkRef.psThreadAll)) {
+        while((pt = (PMTEST_WORKREF_THREAD_CONTEXT)ObSet_GetNext(g_MTestWorkRef.psThreadAll, (QWORD)pt))) {
+            SetEvent(pt->hEventWakeup);
+        }
+        SwitchToThread();
+    }
+    while((pu = (PMTEST_WORKREF_UNIT)ObSet_Pop(g_MTestWorkRef.psUnit))) {
+        if(pu->hEventFinish) {
+            SetEvent(pu->hEventFinish);
+        }
+        LocalFree(pu);
+    }
+    Ob_DECREF_NULL(&g_MTestWorkRef.psUnit);
+    Ob_DECREF_NULL(&g_MTestWorkRef.psThreadAll);
+    Ob_DECREF_NULL(&g_MTestWorkRef.psThreadAvail);
+}
+
+VOID MTestWorkRef_Work(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDLE hEventFinish)
+{
+    PMTEST_WORKREF_UNIT pu;
+    PMTEST_WORKREF_THREAD_CONTEXT pt;
+    if((pu = LocalAlloc(0, sizeof(MTEST_WORKREF_UNIT)))) {
+        pu->pfn = pfn;
+        pu->ctx = ctx;
+        pu->hEventFinish = hEventFinish;
+        ObSet_Push(g_MTestWorkRef.psUnit, (QWORD)pu);
+        if((pt = (PMTEST_WORKREF_THREAD_CONTEXT)ObSet_Pop(g_MTestWorkRef.psThreadAvail))) {
+            SetEvent(pt->hEventWakeup);
+        }
+    }
+}
+
+typedef struct tdMTEST_WORK_CONTEXT {
+    DWORD tp;
+    DWORD cTaskPerSubmitter;
+    volatile LONG cTaskDone;
+    volatile LONG cRemaining;
+    volatile QWORD qwSink;
+    HANDLE hEventDone;
+} MTEST_WORK_CONTEXT, *PMTEST_WORK_CONTEXT;
+
+/*
+* Tiny task: a few dozen cycles of work - the scheduler overhead dominates.
+*/
+DWORD MTest_Work_TaskTiny(_In_ PMTEST_WORK_CONTEXT ctx)
+{
+    DWORD i;
+    QWORD q = (QWORD)&i;
+    for(i = 0; i < 64; i++) {
+        q = q * 6364136223846793005 + 1442695040888963407;
+    }
+    ctx->qwSink = q;
+    InterlockedIncrement(&ctx->cTaskDone);
+    return 0;
+}
+
+DWORD MTest_Work_TaskTinyEvent(_In_ PMTEST_WORK_CONTEXT ctx)
+{
+    MTest_Work_TaskTiny(ctx);
+    if(!InterlockedDecrement(&ctx->cRemaining)) {
+        SetEvent(ctx->hEventDone);
+    }
+    return 0;
+}
+
+DWORD MTest_Work_TaskNested(_In_ PMTEST_WORK_CONTEXT ctx)
+{
+    DWORD i;
+    PVMMOB_WORK_GROUP pg;
+    if(!(pg = VmmWorkGroup_New())) { return 0; }
+    for(i = 0; i < MTEST_WORK_NESTED; i++) {
+        VmmWorkGroup_Add(pg, (LPTHREAD_START_ROUTINE)MTest_Work_TaskTiny, ctx);
+    }
+    VmmWorkGroup_Join(pg);
+    Ob_DECREF(pg);
+    return 0;
+}
+
+DWORD MTest_Work_SubmitterThreadProc(_In_ PMTEST_WORK_CONTEXT ctx)
+{
+    DWORD i;
+    PVMMOB_WORK_GROUP pg;
+    switch(ctx->tp) {
+        case MTEST_WORK_TP_REF:
+            for(i = 0; i < ctx->cTaskPerSubmitter; i++) {
+                MTestWorkRef_Work((LPTHREAD_START_ROUTINE)MTest_Work_TaskTinyEvent, ctx, NULL);
+            }
+            break;
+        case MTEST_WORK_TP_EVENT:
+            for(i = 0; i < ctx->cTaskPerSubmitter; i++) {
+                VmmWork((LPTHREAD_START_ROUTINE)MTest_Work_TaskTinyEvent, ctx, NULL);
+            }
+            break;
+        case MTEST_WORK_TP_GROUP:
+            if(!(pg = VmmWorkGroup_New())) { break; }
+            for(i = 0; i < ctx->cTaskPerSubmitter; i++) {
+                VmmWorkGroup_Add(pg, (LPTHREAD_START_ROUTINE)MTest_Work_TaskTiny, ctx);
+            }
+            VmmWorkGroup_Join(pg);
+            Ob_DECREF(pg);
+            break;
+        case MTEST_WORK_TP_NESTED:
+            if(!(pg = VmmWorkGroup_New())) { break; }
+            for(i = 0; i < ctx->cTaskPerSubmitter / MTEST_WORK_NESTED; i++) {
+                VmmWorkGroup_Add(pg, (LPTHREAD_START_ROUTINE)MTest_Work_TaskNested, ctx);
+            }
+            VmmWorkGroup_Join(pg);
+            Ob_DECREF(pg);
+            break;
+    }
+    return 0;
+}
+
+/*
+* Run one round of the fan-out: cSubmitter threads concurrently submit their
+* share of the tasks, the round ends when all tasks have completed.
+* -- tp = MTEST_WORK_TP_*
+* -- cSubmitter
+* -- cTaskPerSubmitter
+* -- return = elapsed time in microseconds, or 0 if not all tasks ran exactly once.
+*/
+QWORD MTest_Work_Round(_In_ DWORD tp, _In_ DWORD cSubmitter, _In_ DWORD cTaskPerSubmitter)
+{
+    DWORD i, cHandle = 0;
+    QWORD tmStart, tmElapsed = 0;
+    HANDLE hThreads[8];
+    MTEST_WORK_CONTEXT ctx = { 0 };
+    cSubmitter = min(cSubmitter, _countof(hThreads));
+    ctx.tp = tp;
+    ctx.cTaskPerSubmitter = cTaskPerSubmitter;
+    ctx.cRemaining = cSubmitter * cTaskPerSubmitter;
+    if(!(ctx.hEventDone = CreateEvent(NULL, TRUE, FALSE, NULL))) { return 0; }
+    for(i = 0; i < cSubmitter; i++) {
+        if((hThreads[cHandle] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)MTest_Work_SubmitterThreadProc, &ctx, CREATE_SUSPENDED, NULL))) {
+            cHandle++;
+        }
+    }
+    if(cHandle != cSubmitter) {
+        // not all submitters started - let the started ones exit without work.
+        ctx.cTaskPerSubmitter = 0;
+        goto fail;
+    }
+    tmStart = MTest_TimeUs();
+    for(i = 0; i < cHandle; i++) {
+        ResumeThread(hThreads[i]);
+    }
+    WaitForMultipleObjects(cHandle, hThreads, TRUE, INFINITE);
+    if((tp == MTEST_WORK_TP_REF) || (tp == MTEST_WORK_TP_EVENT)) {
+        if(WAIT_OBJECT_0 != WaitForSingleObject(ctx.hEventDone, MTEST_WORK_TIMEOUT_MS)) { goto fail; }
+    }
+    tmElapsed = max(1, MTest_TimeUs() - tmStart);
+    if((DWORD)ctx.cTaskDone != cSubmitter * cTaskPerSubmitter) { tmElapsed = 0; }
+fail:
+    for(i = 0; i < cHandle; i++) {
+        if(cHandle != cSubmitter) { ResumeThread(hThreads[i]); }
+        WaitForSingleObject(hThreads[i], INFINITE);
+        CloseHandle(hThreads[i]);
+    }
+    if(ctx.cTaskPerSubmitter && ((tp == MTEST_WORK_TP_REF) || (tp == MTEST_WORK_TP_EVENT))) {
+        // timed out event counted round - wait for stragglers before ctx goes out of scope.
+        while(ctx.cRemaining > 0) { Sleep(10); }
+    }
+    CloseHandle(ctx.hEventDone);
+    return tmElapsed;
+}
+
+/*
+* Benchmark: fan-out of dwParam (default 10000) tiny tasks.
+* -- dwParam = # of tasks per round.
+* -- pr
+*/
+VOID MTest_WorkGroup(_In_ DWORD dwParam, _Inout_ PMTEST_RESULT pr)
+{
+    BOOL fResult = TRUE;
+    DWORD tp, iSubmitter, iRound, cSubmitter, cTask, cTaskPerSubmitter;
+    QWORD tm, tmBest, tmTotal;
+    DWORD cSubmitters[] = { 1, 2, 4, 8 };
+    LPSTR szTp[] = { "REF", "EVENT", "GROUP", "NESTED" };
+    cTask = dwParam ? dwParam : MTEST_WORK_TASKS_DEFAULT;
+    MTest_Printf(pr, "WORK SCHEDULER FAN-OUT: %i tasks, %i rounds, %i worker threads (reference pool: %i)\n", cTask, MTEST_WORK_ROUNDS, ctxVmm->Work.cThread, MTEST_WORKREF_NUM_THREADS);
+    MTest_Printf(pr, "MODE    SUBMITTERS   BEST US    AVG US  NS/TASK\n");
+    if(!MTestWorkRef_Initialize()) {
+        MTest_Printf(pr, "FAIL: reference pool initialization\n");
+        MTestWorkRef_Close();
+        return;
+    }
+    for(tp = 0; tp < _countof(szTp); tp++) {
+        for(iSubmitter = 0; iSubmitter < _countof(cSubmitters); iSubmitter++) {
+            cSubmitter = cSubmitters[iSubmitter];
+            cTaskPerSubmitter = cTask / cSubmitter;
+            if(tp == MTEST_WORK_TP_NESTED) {
+                cTaskPerSubmitter -= cTaskPerSubmitter % MTEST_WORK_NESTED;
+            }
+            if(!cTaskPerSubmitter) { continue; }
+            tmBest = (QWORD)-1;
+            tmTotal = 0;
+            MTest_Work_Round(tp, cSubmitter, cTaskPerSubmitter);    // warm-up
+            for(iRound = 0; iRound < MTEST_WORK_ROUNDS; iRound++) {
+                if(!(tm = MTest_Work_Round(tp, cSubmitter, cTaskPerSubmitter))) {
+                    MTest_Printf(pr, "FAIL: %s submitters=%i: task count mismatch or timeout\n", szTp[tp], cSubmitter);
+                    fResult = FALSE;
+                    break;
+                }
+                tmBest = min(tmBest, tm);
+                tmTotal += tm;
+            }
+            if(iRound < MTEST_WORK_ROUNDS) { continue; }
+            MTest_Printf(pr, "%-6s  %10i %9lli %9lli %8lli\n",
+                szTp[tp],
+                cSubmitter,
+                tmBest,
+                tmTotal / MTEST_WORK_ROUNDS,
+                tmBest * 1000 / ((QWORD)cSubmitter * cTaskPerSubmitter)
+            );
+        }
+    }
+    MTestWorkRef_Close();
+    MTest_Printf(pr, fResult ? "PASS: all tasks ran exactly once\n" : "FAIL: work scheduler\n");
+}
+
+
+
+// ----------------------------------------------------------------------------
+// pdb: compare the native .pdb parser against dbghelp.dll for the kernel .pdb
+// of the analyzed memory dump - symbol rvas, closest symbol to an rva, type
+// sizes and type member offsets. Running the test over memory dumps of many
+// kernel builds covers a corpus of ntoskrnl .pdbs.
+// ----------------------------------------------------------------------------
+
+/*
+* Test: native .pdb parser equals dbghelp.
+* -- dwParam = max # of symbols and types to compare, 0 = all.
+* -- pr
+*/
+VOID MTest_Pdb(_In_ DWORD dwParam, _Inout_ PMTEST_RESULT pr)
+{
+    PPDB_SELFTEST_RESULT pPdb;
+    if(!(pPdb = LocalAlloc(0, sizeof(PDB_SELFTEST_RESULT)))) { return; }
+    if(!PDB_SelfTest_Kernel(dwParam, pPdb)) {
+        MTest_Printf(pr, "FAIL: kernel .pdb not loaded natively or dbghelp not available\n");
+        LocalFree(pPdb);
+        return;
+    }
+    MTest_Printf(pr, "PDB: %s\n", pPdb->szPdbPath);
+    MTest_Printf(pr, "QUERY             COUNT  MISMATCH\n");
+    MTest_Printf(pr, "symbol -> rva  %8i  %8i\n", pPdb->cSymbol, pPdb->cSymbolMismatch);
+    MTest_Printf(pr, "rva -> symbol  %8i  %8i\n", pPdb->cSymbolFromOffset, pPdb->cSymbolFromOffsetMismatch);
+    MTest_Printf(pr, "type size      %8i  %8i  (native only: %i)\n", pPdb->cType, pPdb->cTypeMismatch, pPdb->cTypeNativeOnly);
+    MTest_Printf(pr, "type child     %8i  %8i\n", pPdb->cTypeChild, pPdb->cTypeChildMismatch);
+    MTest_Printf(pr, "TIME: native lookups %lli us, dbghelp lookups %lli us\n", pPdb->tmNativeUs, pPdb->tmDbgHelpUs);
+    if(pPdb->cchMismatch) {
+        MTest_Printf(pr, "%s", pPdb->szMismatch);
+    }
+    if(pPdb->cSymbolMismatch || pPdb->cSymbolFromOffsetMismatch || pPdb->cTypeMismatch || pPdb->cTypeChildMismatch || !pPdb->cSymbol || !pPdb->cType) {
+        MTest_Printf(pr, "FAIL: native .pdb parser differs from dbghelp\n");
+    } else {
+        MTest_Printf(pr, "PASS: native .pdb parser equals dbghelp\n");
+    }
+    LocalFree(pPdb);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// xpress: validate the in-tree XPRESS decoder (MmWin_XpressDecompress) against
+// ntdll and benchmark both in pages/sec. The corpus is compressed by ntdll
+// RtlCompressBuffer (the format of the compressed store) and consists of pages
+// of the analyzed memory as well as synthetic pages exercising the decoder
+// paths: zero/fill pages (long match lengths), short offset run-lengths, wide
+// copy offsets and literal-heavy pages. Pages which do not compress are stored
+// uncompressed by the compressed store and are not part of the corpus.
+// ----------------------------------------------------------------------------
+
+#define MTEST_XPRESS_PAGES_DEFAULT      4096
+#define MTEST_XPRESS_SYNTHETIC          8
+#define MTEST_XPRESS_BENCH_MS           1000
+
+typedef NTSTATUS MTESTFN_RtlGetCompressionWorkSpaceSize(USHORT CompressionFormatAndEngine, PULONG CompressBufferWorkSpaceSize, PULONG CompressFragmentWorkSpaceSize);
+typedef NTSTATUS MTESTFN_RtlCompressBuffer(USHORT CompressionFormatAndEngine, PUCHAR UncompressedBuffer, ULONG UncompressedBufferSize, PUCHAR CompressedBuffer, ULONG CompressedBufferSize, ULONG UncompressedChunkSize, PULONG FinalCompressedSize, PVOID WorkSpace);
+
+typedef struct tdMTEST_XPRESS_PAGE {
+    DWORD cbCompressed;
+    BYTE pbRaw[0x1000];
+    BYTE pbCompressed[0x1000];
+} MTEST_XPRESS_PAGE, *PMTEST_XPRESS_PAGE;
+
+/*
+* Fill a synthetic corpus page.
+* -- iType
+* -- pb
+*/
+VOID MTest_Xpress_SyntheticPage(_In_ DWORD iType, _Out_writes_(0x1000) PBYTE pb)
+{
+    DWORD i;
+    QWORD q = 0x9e3779b97f4a7c15 * (iType + 1);
+    for(i = 0; i < 0x1000; i++) {
+        q = q * 6364136223846793005 + 1442695040888963407;
+        switch(iType) {
+            case 0: pb[i] = 0; break;                                   // zero page
+            case 1: pb[i] = 0x41; break;                                // fill page
+            case 2: pb[i] = "ab"[i % 2]; break;                         // offset 2 run-length
+            case 3: pb[i] = "abcdefg"[i % 7]; break;                    // offset 7 run-length
+            case 4: pb[i] = "abcdefghijklmnopq"[i % 17]; break;         // wide copy offset
+            case 5: pb[i] = (BYTE)((q >> 60) & 0x3); break;             // literal-heavy
+            case 6: pb[i] = (i & 0x100) ? (BYTE)(q >> 56) : 0; break;   // literal runs + zero runs
+            default: pb[i] = (i % 64 < 48) ? (BYTE)(i / 64) : (BYTE)(q >> 56); break;
+        }
+    }
+}
+
+/*
+* Test and benchmark: in-tree XPRESS decoder.
+* -- dwParam = # of memory pages in the corpus (default 4096).
+* -- pr
+*/
+VOID MTest_Xpress(_In_ DWORD dwParam, _Inout_ PMTEST_RESULT pr)
+{
+    HMODULE hNtDll;
+    MTESTFN_RtlGetCompressionWorkSpaceSize *pfnRtlGetCompressionWorkSpaceSize;
+    MTESTFN_RtlCompressBuffer *pfnRtlCompressBuffer;
+    PMTEST_XPRESS_PAGE pPages = NULL, pe;
+    PBYTE pbWorkSpace = NULL;
+    BYTE pbOut[0x1000];
+    QWORD pa, tmStart, tmElapsed, cDecoded, cPageTest;
+    DWORD i, iDecoder, cPage = 0, cbWorkSpace = 0, cbFragment, cbOut, cbCompressedTotal = 0;
+    DWORD cMemoryPage, cMismatch = 0, cMismatchNtdll = 0, cTruncated = 0;
+    BOOL fOK;
+    cMemoryPage = dwParam ? dwParam : MTEST_XPRESS_PAGES_DEFAULT;
+    if(!(hNtDll = GetModuleHandleA("ntdll.dll"))) { goto fail; }
+    pfnRtlGetCompressionWorkSpaceSize = (MTESTFN_RtlGetCompressionWorkSpaceSize*)GetProcAddress(hNtDll, "RtlGetCompressionWorkSpaceSize");
+    pfnRtlCompressBuffer = (MTESTFN_RtlCompressBuffer*)GetProcAddress(hNtDll, "RtlCompressBuffer");
+    if(!pfnRtlGetCompressionWorkSpaceSize || !pfnRtlCompressBuffer || !ctxVmm->fn.RtlDecompressBuffer) { goto fail; }
+    if(VMM_STATUS_SUCCESS != pfnRtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_XPRESS, &cbWorkSpace, &cbFragment)) { goto fail; }
+    if(!(pbWorkSpace = LocalAlloc(0, cbWorkSpace))) { goto fail; }
+    if(!(pPages = LocalAlloc(0, (SIZE_T)(cMemoryPage + MTEST_XPRESS_SYNTHETIC) * sizeof(MTEST_XPRESS_PAGE)))) { goto fail; }
+    // 1: build corpus - synthetic pages and memory pages spread over physical memory
+    for(i = 0; i < MTEST_XPRESS_SYNTHETIC + cMemoryPage; i++) {
+        pe = pPages + cPage;
+        if(i < MTEST_XPRESS_SYNTHETIC) {
+            MTest_Xpress_SyntheticPage(i, pe->pbRaw);
+        } else {
+            pa = ((ctxMain->dev.paMax / cMemoryPage) * (i - MTEST_XPRESS_SYNTHETIC)) & ~0xfff;
+            if(!VmmRead(NULL, pa, pe->pbRaw, 0x1000)) { continue; }
+        }
+        if(VMM_STATUS_SUCCESS != pfnRtlCompressBuffer(COMPRESSION_FORMAT_XPRESS, pe->pbRaw, 0x1000, pe->pbCompressed, sizeof(pe->pbCompressed), 0x1000, &pe->cbCompressed, pbWorkSpace)) { continue; }
+        if(!pe->cbCompressed || (pe->cbCompressed >= 0x1000)) { continue; }
+        cbCompressedTotal += pe->cbCompressed;
+        cPage++;
+    }
+    if(cPage <= MTEST_XPRESS_SYNTHETIC) {
+        MTest_Printf(pr, "FAIL: no compressible memory pages\n");
+        goto cleanup;
+    }
+    MTest_Printf(pr, "XPRESS CORPUS: %i pages (%i synthetic), avg compressed size: %i bytes\n", cPage, MTEST_XPRESS_SYNTHETIC, cbCompressedTotal / cPage);
+    // 2: validate - in-tree decoder and ntdll must both reproduce the original page
+    for(i = 0; i < cPage; i++) {
+        pe = pPages + i;
+        fOK = MmWin_XpressDecompress(pbOut, 0x1000, pe->pbCompressed, pe->cbCompressed, &cbOut) && (cbOut == 0x1000) && !memcmp(pbOut, pe->pbRaw, 0x1000);
+        if(!fOK) {
+            if(cMismatch < 16) {
+                MTest_Printf(pr, "MISMATCH: page #%i (%s) compressed size: %i\n", i, (i < MTEST_XPRESS_SYNTHETIC) ? "synthetic" : "memory", pe->cbCompressed);
+            }
+            cMismatch++;
+        }
+        fOK = (VMM_STATUS_SUCCESS == ctxVmm->fn.RtlDecompressBuffer(COMPRESSION_FORMAT_XPRESS, pbOut, 0x1000, pe->pbCompressed, pe->cbCompressed, &cbOut)) && (cbOut == 0x1000) && !memcmp(pbOut, pe->pbRaw, 0x1000);
+        if(!fOK) { cMismatchNtdll++; }
+        // truncated input must be rejected or decode within bounds - never fault.
+        MmWin_XpressDecompress(pbOut, 0x1000, pe->pbCompressed, pe->cbCompressed / 2, &cbOut);
+        cTruncated++;
+    }
+    MTest_Printf(pr, "VALIDATE: in-tree mismatches: %i, ntdll mismatches: %i, truncated inputs decoded: %i\n", cMismatch, cMismatchNtdll, cTruncated);
+    // 3: benchmark - decode the corpus repeatedly for MTEST_XPRESS_BENCH_MS
+    MTest_Printf(pr, "DECODER        PAGES/S      MB/S\n");
+    for(iDecoder = 0; iDecoder < 2; iDecoder++) {
+        cDecoded = 0;
+        tmStart = MTest_TimeUs();
+        do {
+            for(i = 0; i < cPage; i++) {
+                pe = pPages + i;
+                if(iDecoder) {
+                    ctxVmm->fn.RtlDecompressBuffer(COMPRESSION_FORMAT_XPRESS, pbOut, 0x1000, pe->pbCompressed, pe->cbCompressed, &cbOut);
+                } else {
+                    MmWin_XpressDecompress(pbOut, 0x1000, pe->pbCompressed, pe->cbCompressed, &cbOut);
+                }
+            }
+            cDecoded += cPage;
+            tmElapsed = MTest_TimeUs() - tmStart;
+        } while(tmElapsed < MTEST_XPRESS_BENCH_MS * 1000);
+        cPageTest = cDecoded * 1000000 / tmElapsed;
+        MTest_Printf(pr, "%-10s %11lli %9lli\n", iDecoder ? "ntdll" : "in-tree", cPageTest, cPageTest / 256);
+    }
+    MTest_Printf(pr, (cMismatch || cMismatchNtdll) ? "FAIL: xpress decoder mismatch\n" : "PASS: xpress decoder equals ntdll and original pages\n");
+    goto cleanup;
+fail:
+    MTest_Printf(pr, "FAIL: ntdll compression functions not available\n");
+cleanup:
+    LocalFree(pbWorkSpace);
+    LocalFree(pPages);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// pagefile: concurrent page file read throughput. The positional overlapped
+// page file reader (MmWin_PfReadFile and MmWin_PfReadFileBatch) is compared
+// against a copy of the previous reader (MTestPfRef_*): a buffered FILE* per
+// page file with _fseeki64 + fread of 0x1000 bytes behind one shared lock.
+// Threads read random pages of the page files given at startup (-pagefile0..9)
+// until the time has passed. The page contents of both readers are compared.
+// ----------------------------------------------------------------------------
+
+#define MTEST_PF_SECONDS_DEFAULT        2
+#define MTEST_PF_THREADS_MAX            16
+#define MTEST_PF_BATCH                  64
+#define MTEST_PF_VERIFY                 0x1000
+
+#define MTEST_PF_TP_REF                 0
+#define MTEST_PF_TP_SINGLE              1
+#define MTEST_PF_TP_BATCH               2
+
+typedef struct tdMTEST_PF_CONTEXT {
+    volatile BOOL fStop;
+    DWORD tp;
+    DWORD cPf;
+    DWORD dwPfNumber[10];
+    DWORD cPfPages[10];
+    CRITICAL_SECTION RefLock;
+    FILE *hRefFile[10];
+} MTEST_PF_CONTEXT, *PMTEST_PF_CONTEXT;
+
+typedef struct tdMTEST_PF_THREAD {
+    PMTEST_PF_CONTEXT ctx;
+    QWORD qwSeed;
+    QWORD cPage;
+    QWORD cFail;
+} MTEST_PF_THREAD, *PMTEST_PF_THREAD;
+
+_Success_(return)
+BOOL MTestPfRef_ReadFile(_In_ PMTEST_PF_CONTEXT ctx, _In_ DWORD dwPfNumber, _In_ DWORD dwPfOffset, _Out_writes_(4096) PBYTE pbPage)
+{
+    BOOL fResult = FALSE;
+    if(dwPfNumber >= 10) { return FALSE; }
+    EnterCriticalSection(&ctx->RefLock);
+    if(ctx->hRefFile[dwPfNumber]) {
+        fResult =
+            !_fseeki64(ctx->hRefFile[dwPfNumber], (QWORD)dwPfOffset << 12, SEEK_SET) &&
+            fread(pbPage, 1, 0x1000, ctx->hRefFile[dwPfNumber]);
+    }
+    LeaveCriticalSection(&ctx->RefLock);
+    return fResult;
+}
+
+/*
+* Select a random page of a random page file.
+*/
+VOID MTest_Pf_RandomPage(_In_ PMTEST_PF_CONTEXT ctx, _Inout_ PQWORD pqwSeed, _Out_ PDWORD pdwPfNumber, _Out_ PDWORD pdwPfOffset)
+{
+    DWORD iPf;
+    *pqwSeed = *pqwSeed * 6364136223846793005 + 1442695040888963407;
+    iPf = (DWORD)(*pqwSeed >> 60) % ctx->cPf;
+    *pdwPfNumber = ctx->dwPfNumber[iPf];
+    *pdwPfOffset = (DWORD)((*pqwSeed >> 16) % ctx->cPfPages[iPf]);
+}
+
+int MTest_Pf_CmpReq(const void *v1, const void *v2)
+{
+    PMMWIN_PF_READ p1 = (PMMWIN_PF_READ)v1, p2 = (PMMWIN_PF_READ)v2;
+    if(p1->dwPfNumber != p2->dwPfNumber) { return (p1->dwPfNumber < p2->dwPfNumber) ? -1 : 1; }
+    return (p1->dwPfOffset < p2->dwPfOffset) ? -1 : ((p1->dwPfOffset > p2->dwPfOffset) ? 1 : 0);
+}
+
+DWORD MTest_Pf_ThreadProc(_In_ PMTEST_PF_THREAD pt)
+{
+    DWORD i, dwPfNumber, dwPfOffset;
+    PMTEST_PF_CONTEXT ctx = pt->ctx;
+    MMWIN_PF_READ Reqs[MTEST_PF_BATCH];
+    PBYTE pbBuffer;
+    if(!(pbBuffer = LocalAlloc(0, MTEST_PF_BATCH * 0x1000))) { return 0; }
+    while(!ctx->fStop) {
+        if(ctx->tp == MTEST_PF_TP_BATCH) {
+            for(i = 0; i < MTEST_PF_BATCH; i++) {
+                MTest_Pf_RandomPage(ctx, &pt->qwSeed, &Reqs[i].dwPfNumber, &Reqs[i].dwPfOffset);
+                Reqs[i].pb = pbBuffer + i * 0x1000;
+            }
+            qsort(Reqs, MTEST_PF_BATCH, sizeof(MMWIN_PF_READ), MTest_Pf_CmpReq);
+            MmWin_PfReadFileBatch(MTEST_PF_BATCH, Reqs);
+            for(i = 0; i < MTEST_PF_BATCH; i++) {
+                if(!Reqs[i].f) { pt->cFail++; }
+            }
+            pt->cPage += MTEST_PF_BATCH;
+        } else {
+            MTest_Pf_RandomPage(ctx, &pt->qwSeed, &dwPfNumber, &dwPfOffset);
+            if(ctx->tp == MTEST_PF_TP_REF) {
+                if(!MTestPfRef_ReadFile(ctx, dwPfNumber, dwPfOffset, pbBuffer)) { pt->cFail++; }
+            } else {
+                if(!MmWin_PfReadFile(dwPfNumber, dwPfOffset, pbBuffer)) { pt->cFail++; }
+            }
+            pt->cPage++;
+        }
+    }
+    LocalFree(pbBuffer);
+    return 1;
+}
+
+/*
+* Benchmark: concurrent page file read throughput vs the previous reader.
+* -- dwParam = seconds per run (default 2).
+* -- pr
+*/
+VOID MTest_PageFile(_In_ DWORD dwParam, _Inout_ PMTEST_RESULT pr)
+{
+    BOOL fResult = FALSE;
+    HANDLE hFile, hThreads[MTEST_PF_THREADS_MAX];
+    LARGE_INTEGER cbFile;
+    QWORD qwSeed = 1, tmStart, tmElapsed, cPage, cFail;
+    DWORD i, tp, cThread, cHandle, dwPfNumber, dwPfOffset, cMismatch = 0, cVerified = 0;
+    LPSTR szTp[] = { "REF", "SINGLE", "BATCH" };
+    PMTEST_PF_CONTEXT ctx = NULL;
+    MTEST_PF_THREAD Threads[MTEST_PF_THREADS_MAX];
+    BYTE pbPage1[0x1000], pbPage2[0x1000];
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(MTEST_PF_CONTEXT)))) { return; }
+    InitializeCriticalSection(&ctx->RefLock);
+    // 1: open the page files for the reference reader and retrieve their sizes
+    for(i = 0; i < 10; i++) {
+        if(!ctxMain->cfg.szPageFile[i][0]) { continue; }
+        hFile = CreateFileA(ctxMain->cfg.szPageFile[i], GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(hFile == INVALID_HANDLE_VALUE) { continue; }
+        fResult = GetFileSizeEx(hFile, &cbFile) && (cbFile.QuadPart >= 0x1000);
+        CloseHandle(hFile);
+        if(!fResult || fopen_s(&ctx->hRefFile[i], ctxMain->cfg.szPageFile[i], "rb")) { continue; }
+        ctx->dwPfNumber[ctx->cPf] = i;
+        ctx->cPfPages[ctx->cPf] = (DWORD)min(0xffffffff, cbFile.QuadPart >> 12);
+        ctx->cPf++;
+    }
+    if(!ctx->cPf) {
+        MTest_Printf(pr, "FAIL: no page files - start with -pagefile0 <pagefile.sys>\n");
+        goto cleanup;
+    }
+    // 2: verify that both readers return the same pages
+    for(i = 0; i < MTEST_PF_VERIFY; i++) {
+        MTest_Pf_RandomPage(ctx, &qwSeed, &dwPfNumber, &dwPfOffset);
+        if(!MTestPfRef_ReadFile(ctx, dwPfNumber, dwPfOffset, pbPage1)) { continue; }
+        cVerified++;
+        if(!MmWin_PfReadFile(dwPfNumber, dwPfOffset, pbPage2) || memcmp(pbPage1, pbPage2, 0x1000)) {
+            cMismatch++;
+        }
+    }
+    MTest_Printf(pr, "PAGE FILE READ: %i page files, %i s per run, verified pages: %i mismatches: %i\n", ctx->cPf, (dwParam ? dwParam : MTEST_PF_SECONDS_DEFAULT), cVerified, cMismatch);
+    // 3: benchmark 1..16 threads
+    MTest_Printf(pr, "MODE    THREADS    PAGES/S     MB/S   FAIL\n");
+    for(tp = 0; tp < _countof(szTp); tp++) {
+        for(cThread = 1; cThread <= MTEST_PF_THREADS_MAX; cThread *= 2) {
+            ctx->tp = tp;
+            ctx->fStop = FALSE;
+            cHandle = 0;
+            for(i = 0; i < cThread; i++) {
+                Threads[i].ctx = ctx;
+                Threads[i].qwSeed = 0x9e3779b97f4a7c15 * (i + 1);
+                Threads[i].cPage = 0;
+                Threads[i].cFail = 0;
+                if((hThreads[cHandle] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)MTest_Pf_ThreadProc, Threads + i, 0, NULL))) {
+                    cHandle++;
+                }
+            }
+            tmStart = MTest_TimeUs();
+            Sleep(1000 * (dwParam ? dwParam : MTEST_PF_SECONDS_DEFAULT));
+            ctx->fStop = TRUE;
+            if(cHandle) { WaitForMultipleObjects(cHandle, hThreads, TRUE, INFINITE); }
+            tmElapsed = max(1, MTest_TimeUs() - tmStart);
+            cPage = 0;
+            cFail = 0;
+            for(i = 0; i < cHandle; i++) {
+                CloseHandle(hThreads[i]);
+                cPage += Threads[i].cPage;
+                cFail += Threads[i].cFail;
+            }
+            MTest_Printf(pr, "%-6s  %7i %10lli %8lli %6lli\n", szTp[tp], cHandle, cPage * 1000000 / tmElapsed, cPage * 1000000 / tmElapsed / 256, cFail);
+        }
+    }
+    MTest_Printf(pr, (cMismatch || !cVerified) ? "FAIL: page file readers differ\n" : "PASS: page file readers equal\n");
+cleanup:
+    for(i = 0; i < 10; i++) {
+        if(ctx->hRefFile[i]) { fclose(ctx->hRefFile[i]); }
+    }
+    DeleteCriticalSection(&ctx->RefLock);
+    LocalFree(ctx);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// ntfscarve: carving accuracy of the NTFS MFT record carver on a synthetic
+// image with known valid and invalid MFT records (FcNtfs_SelfTest_Carving).
+// ----------------------------------------------------------------------------
+
+/*
+* Test: MFT record carving accuracy and signature scan throughput.
+* -- dwParam = # of signature scan iterations, 0 = default.
+* -- pr
+*/
+VOID MTest_NtfsCarve(_In_ DWORD dwParam, _Inout_ PMTEST_RESULT pr)
+{
+    BOOL fFail = FALSE;
+    DWORD i;
+    PFCNTFS_SELFTEST_RESULT pNtfs;
+    LPSTR szMode[2] = { "single-thread", "multi-thread" };
+    if(!(pNtfs = LocalAlloc(0, sizeof(FCNTFS_SELFTEST_RESULT)))) { return; }
+    if(!FcNtfs_SelfTest_Carving(dwParam, pNtfs)) {
+        MTest_Printf(pr, "FAIL: synthetic image could not be created\n");
+        LocalFree(pNtfs);
+        return;
+    }
+    MTest_Printf(pr, "SYNTHETIC IMAGE: %i pages, %i valid records, %i torn records\n", pNtfs->cPage, pNtfs->cRecordExpect, pNtfs->cTornExpect);
+    MTest_Printf(pr, "SCAN      SELECTED  MISMATCH     PAGES/S\n");
+    for(i = 0; i < 3; i++) {
+        if(!pNtfs->Scan[i].fAvailable) {
+            MTest_Printf(pr, "%-8s  not supported by cpu\n", pNtfs->Scan[i].szName);
+            continue;
+        }
+        MTest_Printf(pr, "%-8s  %8s  %8i %11lli\n",
+            pNtfs->Scan[i].szName,
+            pNtfs->Scan[i].fSelected ? "yes" : "",
+            pNtfs->Scan[i].cMaskMismatch,
+            (QWORD)pNtfs->cPage * pNtfs->cIterScan * 1000000 / pNtfs->Scan[i].tmUs
+        );
+        fFail = fFail || pNtfs->Scan[i].cMaskMismatch;
+    }
+    MTest_Printf(pr, "CARVE          CARVED  MISSING   FALSE  FIELDS   TORN  ENTRIES  FS   TIME(US)\n");
+    for(i = 0; i < 2; i++) {
+        MTest_Printf(pr, "%-13s %7i %8i %7i %7i %6i %8i %3i %10lli\n",
+            szMode[i],
+            pNtfs->Carve[i].cCarved,
+            pNtfs->Carve[i].cMissing,
+            pNtfs->Carve[i].cFalse,
+            pNtfs->Carve[i].cFieldMismatch,
+            pNtfs->Carve[i].cTorn,
+            pNtfs->Carve[i].cEntry,
+            pNtfs->Carve[i].cFs,
+            pNtfs->Carve[i].tmUs
+        );
+        fFail = fFail || pNtfs->Carve[i].cMissing || pNtfs->Carve[i].cFalse || pNtfs->Carve[i].cFieldMismatch;
+        fFail = fFail || (pNtfs->Carve[i].cTorn != pNtfs->cTornExpect) || (pNtfs->Carve[i].cEntry != pNtfs->cRecordExpect);
+    }
+    fFail = fFail || (pNtfs->Carve[0].cFs != pNtfs->Carve[1].cFs);
+    if(pNtfs->cchMismatch) {
+        MTest_Printf(pr, "%s", pNtfs->szMismatch);
+    }
+    MTest_Printf(pr, fFail ? "FAIL: carved records differ from the planted records\n" : "PASS: carved records equal the planted records\n");
+    LocalFree(pNtfs);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// ntfsfinal: NTFS MFT tree reconstruction - the parallel finalize must produce
+// output identical to the previous sequential finalize on synthetic MFT record
+// sets of multiple volumes (FcNtfs_SelfTest_Finalize).
+// ----------------------------------------------------------------------------
+
+/*
+* Test: MFT tree reconstruction identical output and finalize time.
+* -- dwParam = # of synthetic volumes, 0 = default.
+* -- pr
+*/
+VOID MTest_NtfsFinal(_In_ DWORD dwParam, _Inout_ PMTEST_RESULT pr)
+{
+    BOOL fFail = FALSE;
+    DWORD i;
+    PFCNTFS_SELFTEST_FINALIZE_RESULT pNtfs;
+    if(!(pNtfs = LocalAlloc(0, sizeof(FCNTFS_SELFTEST_FINALIZE_RESULT)))) { return; }
+    if(!FcNtfs_SelfTest_Finalize(dwParam, pNtfs)) {
+        MTest_Printf(pr, "FAIL: synthetic mft set could not be created\n");
+        LocalFree(pNtfs);
+        return;
+    }
+    MTest_Printf(pr, "SYNTHETIC MFT SET: %i volumes, %i records, %i fragments\n", pNtfs->cVolume, pNtfs->cRecord, pNtfs->cPage);
+    MTest_Printf(pr, "TREE: max depth %i, %i name collisions\n", pNtfs->cDepthMax, pNtfs->cNameCollision);
+    MTest_Printf(pr, "FINALIZE      RESULT  ENTRIES  MISMATCH   TIME(US)\n");
+    for(i = 0; i < pNtfs->cRun; i++) {
+        MTest_Printf(pr, "%-10s #%i %6s %8i %9i %10lli\n",
+            i ? "parallel" : "sequential",
+            i,
+            pNtfs->Run[i].fResult ? "ok" : "error",
+            pNtfs->Run[i].cRow,
+            pNtfs->Run[i].cRowMismatch,
+            pNtfs->Run[i].tmUs
+        );
+        fFail = fFail || !pNtfs->Run[i].fResult || pNtfs->Run[i].cRowMismatch || (pNtfs->Run[i].cRow != pNtfs->Run[0].cRow);
+    }
+    if(pNtfs->cchMismatch) {
+        MTest_Printf(pr, "%s", pNtfs->szMismatch);
+    }
+    MTest_Printf(pr, fFail ? "FAIL: parallel finalize differs from the sequential finalize\n" : "PASS: parallel finalize equals the sequential finalize\n");
+    LocalFree(pNtfs);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// sqlbulk: replay of the recorded 'str' and 'ntfs' row stream of a completed
+// forensic database row-by-row and with the bulk ingest path
+// (Fc_SelfTest_SqlBulkReplay).
+// ----------------------------------------------------------------------------
+
+/*
+* Test: forensic database ingest throughput - row-by-row vs bulk ingest.
+* -- dwParam = max # of rows per table to replay, 0 = all.
+* -- pr
+*/
+VOID MTest_SqlBulk(_In_ DWORD dwParam, _Inout_ PMTEST_RESULT pr)
+{
+    BOOL fFail = FALSE;
+    DWORD i;
+    QWORD cRow;
+    FC_SELFTEST_SQLBULK_RESULT Bulk;
+    LPSTR szMode[2] = { "row-by-row", "bulk" };
+    if(!Fc_SelfTest_SqlBulkReplay(dwParam, &Bulk)) {
+        MTest_Printf(pr, "FAIL: forensic database not ready - enable forensic mode and wait for it to complete\n");
+        return;
+    }
+    cRow = Bulk.cStr + Bulk.cNtfs;
+    MTest_Printf(pr, "RECORDED: %lli str rows, %lli ntfs rows\n", Bulk.cStr, Bulk.cNtfs);
+    MTest_Printf(pr, "REPLAY        RESULT   TIME(US)      ROWS/S  CONTENT\n");
+    for(i = 0; i < 2; i++) {
+        fFail = fFail || !Bulk.Replay[i].fResult;
+        fFail = fFail || (Bulk.Replay[i].cStr != Bulk.cStr) || (Bulk.Replay[i].cNtfs != Bulk.cNtfs);
+        fFail = fFail || (Bulk.Replay[i].qwCheckStr != Bulk.qwCheckStr) || (Bulk.Replay[i].qwCheckNtfs != Bulk.qwCheckNtfs);
+        MTest_Printf(pr, "%-12s  %6s %10lli %11lli  %s\n",
+            szMode[i],
+            Bulk.Replay[i].fResult ? "ok" : "error",
+            Bulk.Replay[i].tmUs,
+            Bulk.Replay[i].tmUs ? cRow * 1000000 / Bulk.Replay[i].tmUs : 0,
+            ((Bulk.Replay[i].cStr == Bulk.cStr) && (Bulk.Replay[i].cNtfs == Bulk.cNtfs) && (Bulk.Replay[i].qwCheckStr == Bulk.qwCheckStr) && (Bulk.Replay[i].qwCheckNtfs == Bulk.qwCheckNtfs)) ? "equal" : "DIFFERS"
+        );
+    }
+    if(Bulk.Replay[0].tmUs && Bulk.Replay[1].tmUs) {
+        MTest_Printf(pr, "SPEEDUP: %lli.%02llix\n", Bulk.Replay[0].tmUs / Bulk.Replay[1].tmUs, (Bulk.Replay[0].tmUs * 100 / Bulk.Replay[1].tmUs) % 100);
+    }
+    MTest_Printf(pr, fFail ? "FAIL: replayed rows differ from the recorded rows\n" : "PASS: replayed rows equal the recorded rows\n");
+}
+
+
+
+// ----------------------------------------------------------------------------
+// timeline: external merge sort timeline build vs the window-function SQL
+// build on a synthetic timeline (FcTimeline_SelfTest_Build).
+// ----------------------------------------------------------------------------
+
+/*
+* Test: timeline build - identical output and build time / spill size.
+* -- dwParam = # of synthetic timeline events, 0 = default (50M).
+* -- pr
+*/
+VOID MTest_Timeline(_In_ DWORD dwParam, _Inout_ PMTEST_RESULT pr)
+{
+    BOOL fFail;
+    DWORD i;
+    FCTIMELINE_SELFTEST_RESULT Timeline;
+    LPSTR szMode[2] = { "merge-sort", "sql" };
+    if(!FcTimeline_SelfTest_Build(dwParam, &Timeline)) {
+        MTest_Printf(pr, "FAIL: synthetic timeline could not be created - enable forensic mode and wait for it to complete\n");
+        return;
+    }
+    MTest_Printf(pr, "SYNTHETIC TIMELINE: %i events, %i types\n", Timeline.cEvent, Timeline.cTp);
+    MTest_Printf(pr, "BUILD        RESULT        ROWS   TIME(MS)  SPILL(MB)\n");
+    for(i = 0; i < 2; i++) {
+        MTest_Printf(pr, "%-11s  %6s %11lli %10lli  %9lli\n",
+            szMode[i],
+            Timeline.Build[i].fResult ? "ok" : "error",
+            Timeline.Build[i].cRow,
+            Timeline.Build[i].tmMs,
+            i ? 0 : Timeline.cbSpill >> 20
+        );
+    }
+    MTest_Printf(pr, "ROW MISMATCH: %lli  FILE SIZE MISMATCH: %i\n", Timeline.cRowMismatch, Timeline.cFileSizeMismatch);
+    fFail = !Timeline.Build[0].fResult || !Timeline.Build[1].fResult;
+    fFail = fFail || (Timeline.Build[0].cRow != Timeline.cEvent) || (Timeline.Build[1].cRow != Timeline.cEvent);
+    fFail = fFail || Timeline.cRowMismatch || Timeline.cFileSizeMismatch;
+    MTest_Printf(pr, fFail ? "FAIL: merge-sort timeline differs from the sql timeline\n" : "PASS: merge-sort timeline equals the sql timeline\n");
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Module interface below:
+// ----------------------------------------------------------------------------
+
+typedef struct tdMTEST_ENTRY {
+    LPWSTR wszName;
+    VOID(*pfn)(_In_ DWORD dwParam, _Inout_ PMTEST_RESULT pr);
+    PMTEST_RESULT pResult;
+} MTEST_ENTRY, *PMTEST_ENTRY;
+
+MTEST_ENTRY g_MTestEntries[] = {
+    { L"workgroup",     MTest_WorkGroup },
+    { L"pdb",           MTest_Pdb },
+    { L"xpress",        MTest_Xpress },
+    { L"pagefile",      MTest_PageFile },
+    { L"ntfscarve",     MTest_NtfsCarve },
+    { L"ntfsfinal",     MTest_NtfsFinal },
+    { L"sqlbulk",       MTest_SqlBulk },
+    { L"timeline",      MTest_Timeline },
+};
+
+typedef struct tdMTEST_CONFIG {
+    LPWSTR wszName;
+    DWORD oTest;                    // offset of the DWORD knob in VMM_CONTEXT
+} MTEST_CONFIG, *PMTEST_CONFIG;
+
+MTEST_CONFIG g_MTestConfig[] = {
+    { L"config_paged_batch_disable",        FIELD_OFFSET(VMM_CONTEXT, Test.fPagedBatchDisable) },
+};
+
+SRWLOCK g_MTestLockSRW = SRWLOCK_INIT;
+
+PMTEST_CONFIG MTest_GetConfig(_In_ LPWSTR wszPath)
+{
+    DWORD i;
+    for(i = 0; i < _countof(g_MTestConfig); i++) {
+        if(!_wcsicmp(wszPath, g_MTestConfig[i].wszName)) {
+            return g_MTestConfig + i;
+        }
+    }
+    return NULL;
+}
+
+/*
+* Parse a decimal number from a file write - empty = 0.
+*/
+DWORD MTest_ParseDecimal(_In_reads_(cb) PBYTE pb, _In_ DWORD cb)
+{
+    DWORD i, dw = 0;
+    for(i = 0; (i < cb) && (pb[i] >= '0') && (pb[i] <= '9') && (dw < 0x10000000); i++) {
+        dw = dw * 10 + (pb[i] - '0');
+    }
+    return dw;
+}
+
+PMTEST_ENTRY MTest_GetEntry(_In_ LPWSTR wszPath)
+{
+    DWORD i;
+    for(i = 0; i < _countof(g_MTestEntries); i++) {
+        if(!_wcsicmp(wszPath, g_MTestEntries[i].wszName)) {
+            return g_MTestEntries + i;
+        }
+    }
+    return NULL;
+}
+
+/*
+* Read : function as specified by the module manager. Returns the result of
+* the last run of the test.
+* -- ctx
+* -- pb
+* -- cb
+* -- pcbRead
+* -- cbOffset
+* -- return
+*/
+NTSTATUS MTest_Read(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Out_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbRead, _In_ QWORD cbOffset)
+{
+    NTSTATUS nt;
+    PMTEST_ENTRY pe;
+    PMTEST_CONFIG pc;
+    CHAR szValue[12];
+    if((pc = MTest_GetConfig(ctx->wszPath))) {
+        _snprintf_s(szValue, _countof(szValue), _TRUNCATE, "%i", *(PDWORD)((PBYTE)ctxVmm + pc->oTest));
+        return Util_VfsReadFile_FromPBYTE((PBYTE)szValue, strlen(szValue), pb, cb, pcbRead, cbOffset);
+    }
+    if(!(pe = MTest_GetEntry(ctx->wszPath))) { return VMMDLL_STATUS_FILE_INVALID; }
+    AcquireSRWLockShared(&g_MTestLockSRW);
+    nt = Util_VfsReadFile_FromPBYTE(pe->pResult ? pe->pResult->sz : NULL, pe->pResult ? pe->pResult->cch : 0, pb, cb, pcbRead, cbOffset);
+    ReleaseSRWLockShared(&g_MTestLockSRW);
+    return nt;
+}
+
+/*
+* Write : function as specified by the module manager. Runs the test with the
+* written decimal parameter (empty or 0 = test default) to completion - or sets
+* the written decimal value of a config_* test knob.
+* -- ctx
+* -- pb
+* -- cb
+* -- pcbWrite
+* -- cbOffset
+* -- return
+*/
+NTSTATUS MTest_Write(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _In_ PBYTE pb, _In_ DWORD cb, _Out_ PDWORD pcbWrite, _In_ QWORD cbOffset)
+{
+    DWORD dwParam;
+    PMTEST_ENTRY pe;
+    PMTEST_RESULT pr;
+    PMTEST_CONFIG pc;
+    *pcbWrite = cb;
+    if(cbOffset) { return VMMDLL_STATUS_SUCCESS; }
+    dwParam = MTest_ParseDecimal(pb, cb);
+    if((pc = MTest_GetConfig(ctx->wszPath))) {
+        *(PDWORD)((PBYTE)ctxVmm + pc->oTest) = dwParam;
+        return VMMDLL_STATUS_SUCCESS;
+    }
+    if(!(pe = MTest_GetEntry(ctx->wszPath))) { return VMMDLL_STATUS_FILE_INVALID; }
+    if(!(pr = LocalAlloc(LMEM_ZEROINIT, sizeof(MTEST_RESULT)))) { return VMMDLL_STATUS_FILE_INVALID; }
+    AcquireSRWLockExclusive(&g_MTestLockSRW);
+    vmmprintfv_fn("running '%S' param=%i\n", pe->wszName, dwParam);
+    pe->pfn(dwParam, pr);
+    LocalFree(pe->pResult);
+    pe->pResult = pr;
+    ReleaseSRWLockExclusive(&g_MTestLockSRW);
+    return VMMDLL_STATUS_SUCCESS;
+}
+
+/*
+* List : function as specified by the module manager.
+* -- ctx
+* -- pFileList
+* -- return
+*/
+BOOL MTest_List(_In_ PVMMDLL_PLUGIN_CONTEXT ctx, _Inout_ PHANDLE pFileList)
+{
+    DWORD i;
+    if(ctx->wszPath[0]) { return FALSE; }
+    AcquireSRWLockShared(&g_MTestLockSRW);
+    for(i = 0; i < _countof(g_MTestEntries); i++) {
+        VMMDLL_VfsList_AddFile(pFileList, g_MTestEntries[i].wszName, g_MTestEntries[i].pResult ? g_MTestEntries[i].pResult->cch : 0, NULL);
+    }
+    ReleaseSRWLockShared(&g_MTestLockSRW);
+    for(i = 0; i < _countof(g_MTestConfig); i++) {
+        VMMDLL_VfsList_AddFile(pFileList, g_MTestConfig[i].wszName, 1, NULL);
+    }
+    return TRUE;
+}
+
+VOID MTest_Close()
+{
+    DWORD i;
+    AcquireSRWLockExclusive(&g_MTestLockSRW);
+    for(i = 0; i < _countof(g_MTestEntries); i++) {
+        LocalFree(g_MTestEntries[i].pResult);
+        g_MTestEntries[i].pResult = NULL;
+    }
+    ReleaseSRWLockExclusive(&g_MTestLockSRW);
+}
+
+#endif /* VMM_TEST_SELFTEST */
+
+/*
+* Initialization function. The module manager shall call into this function
+* when the module shall be initialized. If the module wish to initialize it
+* shall call the supplied pfnPluginManager_Register function.
+* NB! the module only registers itself in VMM_TEST_SELFTEST builds.
+* -- pRI
+*/
+VOID M_Test_Initialize(_Inout_ PVMMDLL_PLUGIN_REGINFO pRI)
+{
+#ifdef VMM_TEST_SELFTEST
+    if((pRI->magic != VMMDLL_PLUGIN_REGINFO_MAGIC) || (pRI->wVersion != VMMDLL_PLUGIN_REGINFO_VERSION)) { return; }
+    wcscpy_s(pRI->reg_info.wszPathName, 128, L"\\.test");       // module name
+    pRI->reg_info.fRootModule = TRUE;                           // module shows in root directory
+    pRI->reg_fn.pfnList = MTest_List;                           // List function supported
+    pRI->reg_fn.pfnRead = MTest_Read;                           // Read function supported
+    pRI->reg_fn.pfnWrite = MTest_Write;                         // Write function supported
+    pRI->reg_fn.pfnClose = MTest_Close;                         // Close function supported
+    pRI->pfnPluginManager_Register(pRI);
+#endif /* VMM_TEST_SELFTEST */
+}
@@ -42,6 +42,47 @@ VOID MmWin_PagingInitialize(_In_ BOOL fModeFull);
 */
 VOID MmWin_PagingClose();
 
+typedef struct tdMMWIN_PF_READ {
+    DWORD dwPfNumber;       // page file number [0..9].
+    DWORD dwPfOffset;       // page offset (in 4kB pages) in page file.
+    PBYTE pb;               // 4kB destination buffer.
+    BOOL f;                 // result: TRUE on success.
+    OVERLAPPED ov;          // internal use.
+} MMWIN_PF_READ, *PMMWIN_PF_READ;
+
+/*
+* Read a single page from a page file. Reads from different threads never block
+* each other - page files are read with positional overlapped i/o.
+* -- dwPfNumber = page file number [0..9].
+* -- dwPfOffset = page offset (in 4kB pages) in page file.
+* -- pbPage
+* -- return
+*/
+_Success_(return)
+BOOL MmWin_PfReadFile(_In_ DWORD dwPfNumber, _In_ DWORD dwPfOffset, _Out_writes_(4096) PBYTE pbPage);
+
+/*
+* Read multiple pages from the page files with all reads in-flight at the same
+* time. Requests should ideally be sorted by page file number and offset. The
+* result of each individual read is returned in its f member.
+* -- cReq
+* -- pReqs
+*/
+VOID MmWin_PfReadFileBatch(_In_ DWORD cReq, _Inout_updates_(cReq) PMMWIN_PF_READ pReqs);
+
+/*
+* Decompress a buffer compressed with the plain LZ77 XPRESS algorithm - as used
+* by the Windows 10 compressed store (COMPRESS_ALGORITHM_XPRESS).
+* -- pbOut
+* -- cbOut = size of output buffer - decompression stops when it is full.
+* -- pbIn
+* -- cbIn
+* -- pcbOut = number of bytes decompressed.
+* -- return
+*/
+_Success_(return)
+BOOL MmWin_XpressDecompress(_Out_writes_(cbOut) PBYTE pbOut, _In_ DWORD cbOut, _In_reads_(cbIn) PBYTE pbIn, _In_ DWORD cbIn, _Out_ PDWORD pcbOut);
+
 /*
 * Initialize / Ensure that a VAD map is initialized for the specific process.
 * -- pProcess
@@ -690,8 +690,10 @@ VOID MmVad_Spider_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pPr
     DWORD cMax, cVads, dwFlagsBitMask = 0;
     PVMM_MAP_VADENTRY eVad;
     PVMMOB_MAP_VAD pmObVad = NULL, pmObVadTemp;
-    POB_SET psObAll = NULL, psObTry1 = NULL, psObTry2 = NULL, psObPrefetch = NULL;
+    POB_SET psObAll = NULL, psObTry1 = NULL, psObTry2 = NULL, psObTry3 = NULL, psObPrefetch = NULL, psObRound;
     PVMM_MAP_VADENTRY(*pfnMmVad_Spider)(PVMM_PROCESS, QWORD, PVMMOB_MAP_VAD, POB_SET, POB_SET, POB_SET, QWORD, DWORD);
+    VMM_READASYNC_PIPE Pipe;
+    VmmReadAsyncPipe_Initialize(&Pipe, pSystemProcess, sizeof(_MMVAD64_10), fVmmRead);
     if(!(ctxVmm->tpSystem == VMM_SYSTEM_WINDOWS_X64 || ctxVmm->tpSystem == VMM_SYSTEM_WINDOWS_X86)) { goto fail; }
     // 1: retrieve # of VAD entries and sanity check.
     if(ctxVmm->kernel.dwVersionBuild >= 9600) {
@@ -720,6 +722,7 @@ VOID MmVad_Spider_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pPr
     if(!(psObAll = ObSet_New())) { goto fail; }
     if(!(psObTry1 = ObSet_New())) { goto fail; }
     if(!(psObTry2 = ObSet_New())) { goto fail; }
+    if(!(psObTry3 = ObSet_New())) { goto fail; }
     // 3: retrieve initial VAD node entry
     f = ((ctxVmm->kernel.dwVersionBuild >= 6000) && (ctxVmm->kernel.dwVersionBuild < 9600));    // AvlTree (Vista::Win8.0
     for(i = (f ? 1 : 0); i < (f ? 4 : 1); i++) {
@@ -756,26 +759,35 @@ VOID MmVad_Spider_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pPr
         VmmCachePrefetchPages3(pSystemProcess, psObPrefetch, sizeof(_MMVAD64_10), fVmmRead);
         Ob_DECREF_NULL(&psObPrefetch);
     }
-    // 5: spider vad tree in an efficient way (minimize non-cached reads)
-    while((pmObVad->cMap < cMax) && ObSet_Size(psObTry2)) {
-        // fetch vad entries 2nd attempt
-        VmmCachePrefetchPages3(pSystemProcess, psObTry2, sizeof(_MMVAD64_10), fVmmRead);
-        while((pmObVad->cMap < cMax) && (va = ObSet_Pop(psObTry2))) {
-            if((eVad = pfnMmVad_Spider(pSystemProcess, va, pmObVad, psObAll, psObTry1, NULL, fVmmRead, dwFlagsBitMask))) {
-                if(eVad->CommitCharge > ((eVad->vaEnd + 1 - eVad->vaStart) >> 12)) { eVad->CommitCharge = 0; }
-                eVad->vaVad = va + (ctxVmm->f32 ? 8 : 0x10);
-                eVad->wszText = &ctxVmm->_EmptyWCHAR;
-                if(eVad->cbPrototypePte > 0x01000000) { eVad->cbPrototypePte = MMVAD_PTESIZE * (DWORD)((0x1000 + eVad->vaEnd - eVad->vaStart) >> 12); }
+    // 5: spider vad tree in an efficient way (minimize non-cached reads).
+    //    nodes not in cache are fetched in rounds; several rounds (sub-trees)
+    //    are kept in flight asynchronously while spidering continues.
+    while(pmObVad->cMap < cMax) {
+        if((va = ObSet_Pop(psObTry3))) {
+            // fetch vad entries 2nd attempt (fetched by completed round)
+            eVad = pfnMmVad_Spider(pSystemProcess, va, pmObVad, psObAll, psObTry1, NULL, fVmmRead, dwFlagsBitMask);
+        } else if((va = ObSet_Pop(psObTry1))) {
+            // fetch vad entries 1st attempt
+            eVad = pfnMmVad_Spider(pSystemProcess, va, pmObVad, psObAll, psObTry1, psObTry2, fVmmRead, dwFlagsBitMask);
+        } else {
+            if(ObSet_Size(psObTry2) && VmmReadAsyncPipe_Free(&Pipe) && VmmReadAsyncPipe_Submit(&Pipe, psObTry2, NULL)) { continue; }
+            if(!(psObRound = VmmReadAsyncPipe_WaitNext(&Pipe))) {
+                // no rounds in flight - remaining nodes (if any) were prefetched
+                // synchronously by the pipe -> read them directly.
+                if(!ObSet_Size(psObTry2)) { break; }
+                ObSet_PushSet(psObTry3, psObTry2);
+                ObSet_Clear(psObTry2);
+                continue;
             }
+            ObSet_PushSet(psObTry3, psObRound);
+            Ob_DECREF(psObRound);
+            continue;
         }
-        // fetch vad entries 1st attempt
-        while((pmObVad->cMap < cMax) && (va = ObSet_Pop(psObTry1))) {
-            if((eVad = pfnMmVad_Spider(pSystemProcess, va, pmObVad, psObAll, psObTry1, psObTry2, fVmmRead, dwFlagsBitMask))) {
-                if(eVad->CommitCharge > ((eVad->vaEnd + 1 - eVad->vaStart) >> 12)) { eVad->CommitCharge = 0; }
-                eVad->vaVad = va + (ctxVmm->f32 ? 8 : 0x10);
-                eVad->wszText = &ctxVmm->_EmptyWCHAR;
-                if(eVad->cbPrototypePte > 0x01000000) { eVad->cbPrototypePte = MMVAD_PTESIZE * (DWORD)((0x1000 + eVad->vaEnd - eVad->vaStart) >> 12); }
-            }
+        if(eVad) {
+            if(eVad->CommitCharge > ((eVad->vaEnd + 1 - eVad->vaStart) >> 12)) { eVad->CommitCharge = 0; }
+            eVad->vaVad = va + (ctxVmm->f32 ? 8 : 0x10);
+            eVad->wszText = &ctxVmm->_EmptyWCHAR;
+            if(eVad->cbPrototypePte > 0x01000000) { eVad->cbPrototypePte = MMVAD_PTESIZE * (DWORD)((0x1000 + eVad->vaEnd - eVad->vaStart) >> 12); }
         }
     }
     // 6: sort result
@@ -793,10 +805,12 @@ VOID MmVad_Spider_DoWork(_In_ PVMM_PROCESS pSystemProcess, _In_ PVMM_PROCESS pPr
     }
     pProcess->Map.pObVad = Ob_INCREF(pmObVad);
 fail:
+    VmmReadAsyncPipe_Close(&Pipe);
     Ob_DECREF(pmObVad);
     Ob_DECREF(psObAll);
     Ob_DECREF(psObTry1);
     Ob_DECREF(psObTry2);
+    Ob_DECREF(psObTry3);
 }
 
 /*
@@ -62,14 +62,29 @@ typedef struct tdMMWIN_MEMCOMPRESS_CONTEXT {
     QWORD vaSmGlobals;
     QWORD vaKeyToStoreTree;
     MMWIN_MEMCOMPRESS_OFFSET O;
+    CRITICAL_SECTION LockCache;
+    POB_CONTAINER pObCCache;    // compressed store metadata cache (dumps only)
 } MMWIN_MEMCOMPRESS_CONTEXT, *PMMWIN_MEMCOMPRESS_CONTEXT;
 
+#define MMWIN_PF_EVENT_POOL_SIZE    32
+#define MMWIN_PF_BATCH_MAX          MAXIMUM_WAIT_OBJECTS
+
 typedef struct tdMMWIN_CONTEXT {
-    CRITICAL_SECTION Lock;
-    FILE *pPageFile[10];
+    HANDLE hPageFile[10];                               // overlapped i/o handles - no shared file position.
+    HANDLE hEventPool[MMWIN_PF_EVENT_POOL_SIZE];        // idle read completion events (lock-free pool).
     MMWIN_MEMCOMPRESS_CONTEXT MemCompress;
 } MMWIN_CONTEXT, *PMMWIN_CONTEXT;
 
+// page file / compressed store read deferred to the batch paged read.
+typedef struct tdMMWIN_PAGED_DEFER {
+    BOOL fValid;
+    BOOL fCompressed;
+    DWORD dwPfNumber;
+    DWORD dwPfOffset;
+    QWORD pte;                  // software pte (paging cache key).
+    QWORD fVmmRead;
+} MMWIN_PAGED_DEFER, *PMMWIN_PAGED_DEFER;
+
 //-----------------------------------------------------------------------------
 // BTREE FUNCTIONALITY BELOW:
 //-----------------------------------------------------------------------------
@@ -595,6 +610,120 @@ fail:
 }
 
 
+//-----------------------------------------------------------------------------
+// XPRESS DECOMPRESSION BELOW:
+// In-tree decoder of the plain LZ77 XPRESS format [MS-XCA 2.3/2.4] used by the
+// Windows 10 compressed store (COMPRESS_ALGORITHM_XPRESS). The decoder works
+// directly on the caller supplied buffers without allocations and is tuned for
+// the 4kB page outputs of the compressed store:
+//  - 32 consecutive literals (flag DWORD of zero) are copied in one go.
+//  - matches with an offset of 8 or more are expanded with 8-byte wide copies
+//    if the output buffer has room for the over-copy.
+//  - short offset matches (run-lengths) are expanded byte-wise.
+//-----------------------------------------------------------------------------
+
+/*
+* Decompress a buffer compressed with the plain LZ77 XPRESS algorithm.
+* -- pbOut
+* -- cbOut = size of output buffer - decompression stops when it is full.
+* -- pbIn
+* -- cbIn
+* -- pcbOut = number of bytes decompressed.
+* -- return
+*/
+_Success_(return)
+BOOL MmWin_XpressDecompress(_Out_writes_(cbOut) PBYTE pbOut, _In_ DWORD cbOut, _In_reads_(cbIn) PBYTE pbIn, _In_ DWORD cbIn, _Out_ PDWORD pcbOut)
+{
+    DWORD i = 0, o = 0, dwFlags = 0, cFlags = 0, iHalfByte = 0;
+    DWORD cbMatch, oMatch;
+    WORD wMatch;
+    PBYTE pbSrc, pbDst;
+    *pcbOut = 0;
+    while(o < cbOut) {
+        if(!cFlags) {
+            if(i + 4 > cbIn) { return FALSE; }
+            dwFlags = *(PDWORD)(pbIn + i);
+            i += 4;
+            cFlags = 32;
+            // fast path: 32 consecutive literals
+            if(!dwFlags && (i + 32 <= cbIn) && (o + 32 <= cbOut)) {
+                memcpy(pbOut + o, pbIn + i, 32);
+                i += 32;
+                o += 32;
+                cFlags = 0;
+                continue;
+            }
+        }
+        cFlags--;
+        if(!(dwFlags & (1 << cFlags))) {
+            // literal
+            if(i >= cbIn) { return FALSE; }
+            pbOut[o++] = pbIn[i++];
+            continue;
+        }
+        // match
+        if(i == cbIn) { break; }
+        if(i + 2 > cbIn) { return FALSE; }
+        wMatch = *(PWORD)(pbIn + i);
+        i += 2;
+        cbMatch = wMatch & 7;
+        oMatch = (wMatch >> 3) + 1;
+        if(cbMatch == 7) {
+            if(!iHalfByte) {
+                if(i >= cbIn) { return FALSE; }
+                cbMatch = pbIn[i] & 0x0f;
+                iHalfByte = i++;
+            } else {
+                cbMatch = pbIn[iHalfByte] >> 4;
+                iHalfByte = 0;
+            }
+            if(cbMatch == 15) {
+                if(i >= cbIn) { return FALSE; }
+                cbMatch = pbIn[i++];
+                if(cbMatch == 255) {
+                    if(i + 2 > cbIn) { return FALSE; }
+                    cbMatch = *(PWORD)(pbIn + i);
+                    i += 2;
+                    if(!cbMatch) {
+                        if(i + 4 > cbIn) { return FALSE; }
+                        cbMatch = *(PDWORD)(pbIn + i);
+                        i += 4;
+                    }
+                    if(cbMatch < 15 + 7) { return FALSE; }
+                    cbMatch -= 15 + 7;
+                }
+                cbMatch += 15;
+            }
+            cbMatch += 7;
+        }
+        cbMatch += 3;
+        if((oMatch > o) || (cbMatch > cbOut - o)) { return FALSE; }
+        pbDst = pbOut + o;
+        pbSrc = pbDst - oMatch;
+        o += cbMatch;
+        if((oMatch >= 8) && (o + 8 <= cbOut)) {
+            // wide copy - may over-copy up to 7 bytes within output buffer
+            while(TRUE) {
+                *(PQWORD)pbDst = *(PQWORD)pbSrc;
+                if(cbMatch <= 8) { break; }
+                pbDst += 8;
+                pbSrc += 8;
+                cbMatch -= 8;
+            }
+        } else if(oMatch == 1) {
+            memset(pbDst, *pbSrc, cbMatch);
+        } else {
+            while(cbMatch--) {
+                *pbDst++ = *pbSrc++;
+            }
+        }
+    }
+    *pcbOut = o;
+    return TRUE;
+}
+
+
+
 //-----------------------------------------------------------------------------
 // COMPRESSED STORE FUNCTIONALITY BELOW:
 //-----------------------------------------------------------------------------
@@ -610,6 +739,7 @@ fail:
 
 typedef struct tdMMWINX64_COMPRESS_CONTEXT {
     QWORD fVmmRead;
+    BOOL fNoLog;                            // suppress error log (cache path w/ fallback)
     PVMM_PROCESS pProcess;
     PVMM_PROCESS pSystemProcess;
     PVMM_PROCESS pProcessMemCompress;
@@ -674,6 +804,7 @@ typedef struct td_ST_PAGE_RECORD {
 
 BOOL MmWin_MemCompress_LogError(_In_ PMMWINX64_COMPRESS_CONTEXT ctx, _In_ LPSTR sz)
 {
+    if(ctx->fNoLog) { return FALSE; }
     vmmprintfvv(
         "MmWin_CompressedPage: FAIL: %s\n" \
         "  va= %016llx ep= %016llx pgk=%08x ism=%04x vas=%016llx \n" \
@@ -940,13 +1071,372 @@ BOOL MmWin_MemCompress5_DecompressPage(_In_ PMMWINX64_COMPRESS_CONTEXT ctx, _Out
     if(ctx->e.cbCompressedData == 0x1000) {
         memcpy(pbDecompressedPage, ctx->e.pbCompressedData, 0x1000);
     } else {
-        if((VMM_STATUS_SUCCESS != ctxVmm->fn.RtlDecompressBuffer(COMPRESS_ALGORITHM_XPRESS, pbDecompressedPage, 0x1000, ctx->e.pbCompressedData, ctx->e.cbCompressedData, &cbDecompressed)) || (cbDecompressed != 0x1000)) {
-            return MmWin_MemCompress_LogError(ctx, "#52 Decompress");
+        if(!MmWin_XpressDecompress(pbDecompressedPage, 0x1000, ctx->e.pbCompressedData, ctx->e.cbCompressedData, &cbDecompressed) || (cbDecompressed != 0x1000)) {
+            // fallback to ntdll decompression (if available) on in-tree decoder failure
+            if(!ctxVmm->fn.RtlDecompressBuffer || (VMM_STATUS_SUCCESS != ctxVmm->fn.RtlDecompressBuffer(COMPRESS_ALGORITHM_XPRESS, pbDecompressedPage, 0x1000, ctx->e.pbCompressedData, ctx->e.cbCompressedData, &cbDecompressed)) || (cbDecompressed != 0x1000)) {
+                return MmWin_MemCompress_LogError(ctx, "#52 Decompress");
+            }
+        }
+    }
+    return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// COMPRESSED STORE METADATA CACHE BELOW:
+// Resolving a compressed page by walking the KeyToStoreTree and the per-store
+// PagesTree B+trees node by node is costly. On non-volatile memory (dumps) the
+// leaf records of these trees are instead flattened into sorted arrays once -
+// together with the decoded store metadata - and subsequent lookups are local
+// binary searches. Page record array addresses and region addresses are also
+// remembered per store. The cache is discarded whenever the paging cache is
+// cleared (ctxVmm->Cache.dwPagingGeneration is bumped).
+//-----------------------------------------------------------------------------
+
+#define MMWIN_MEMCOMPRESS_CACHE_MAX_LEAF        0x01000000
+
+typedef struct tdMMWIN_BTREE_FLAT {
+    DWORD c;
+    DWORD cMax;
+    _BTREE_LEAF_ENTRY *pe;
+} MMWIN_BTREE_FLAT, *PMMWIN_BTREE_FLAT;
+
+typedef struct tdMMWINOB_MEMCOMPRESS_STORE {
+    OB ObHdr;
+    BOOL fValid;                    // invalid stores are cached as well to avoid repeated decode attempts.
+    QWORD vaSmkmStore;
+    QWORD vaRegionPtrArray;
+    DWORD dwRegionIndexMask;
+    DWORD dwRegionSizeMask;
+    // decoded _SMHP_CHUNK_METADATA:
+    QWORD avaChunkPtr[32];
+    DWORD dwBitValue;
+    DWORD dwPageRecordsPerChunkMask;
+    DWORD dwPageRecordSize;
+    DWORD dwChunkPageHeaderSize;
+    POB_MAP pmPageRecordArray;      // (iChunkPtr << 16 | iChunkArray) -> va of page record array
+    POB_MAP pmRegion;               // region index -> va of region
+    MMWIN_BTREE_FLAT PagesTree;     // flattened pages tree: page key -> region key
+} MMWINOB_MEMCOMPRESS_STORE, *PMMWINOB_MEMCOMPRESS_STORE;
+
+typedef struct tdMMWINOB_MEMCOMPRESS_CACHE {
+    OB ObHdr;
+    BOOL fValid;
+    DWORD dwGeneration;
+    POB_MAP pmObStore;              // store index (iSmkm) -> PMMWINOB_MEMCOMPRESS_STORE
+    MMWIN_BTREE_FLAT KeyToStoreTree;    // flattened key to store tree: page key -> store index
+} MMWINOB_MEMCOMPRESS_CACHE, *PMMWINOB_MEMCOMPRESS_CACHE;
+
+/*
+* Append all leaf entries of a B+tree to a flat array - in tree (key) order.
+* -- pProcess
+* -- vaTree
+* -- pFlat
+* -- fVmmRead
+* -- return
+*/
+_Success_(return)
+BOOL MmWin_BTree_Flatten(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaTree, _Inout_ PMMWIN_BTREE_FLAT pFlat, _In_ QWORD fVmmRead)
+{
+    DWORD i, cMax;
+    BYTE pbBuffer[0x1000];
+    P_BTREE32 pT32 = (P_BTREE32)pbBuffer;
+    P_BTREE64 pT64 = (P_BTREE64)pbBuffer;
+    _BTREE_LEAF_ENTRY *peLeaf, *peNew;
+    // 1: read tree
+    if(MM_LOOP_PROTECT_MAX(fVmmRead)) { return FALSE; }
+    if(ctxVmm->f32 ? !VMM_KADDR32_PAGE(vaTree) : !VMM_KADDR64_PAGE(vaTree)) { return FALSE; }
+    if(!VmmRead2(pProcess, vaTree, pbBuffer, 0x1000, fVmmRead) || !pT32->cEntries || (pT32->cEntries > 0x1ff)) { return FALSE; }
+    // 2: node -> recurse into children in key order
+    if(!pT32->fLeaf) {
+        if(ctxVmm->f32) {
+            if(!MmWin_BTree_Flatten(pProcess, pT32->vaLeftChild, pFlat, MM_LOOP_PROTECT_ADD(fVmmRead))) { return FALSE; }
+            for(i = 0; i < pT32->cEntries; i++) {
+                if(!MmWin_BTree_Flatten(pProcess, pT32->NodeEntries[i].vaLeaf, pFlat, MM_LOOP_PROTECT_ADD(fVmmRead))) { return FALSE; }
+            }
+        } else {
+            if(pT64->cEntries > 0xff) { return FALSE; }
+            if(!MmWin_BTree_Flatten(pProcess, pT64->vaLeftChild, pFlat, MM_LOOP_PROTECT_ADD(fVmmRead))) { return FALSE; }
+            for(i = 0; i < pT64->cEntries; i++) {
+                if(!MmWin_BTree_Flatten(pProcess, pT64->NodeEntries[i].vaLeaf, pFlat, MM_LOOP_PROTECT_ADD(fVmmRead))) { return FALSE; }
+            }
+        }
+        return TRUE;
+    }
+    // 3: leaf -> append entries
+    peLeaf = ctxVmm->f32 ? pT32->LeafEntries : pT64->LeafEntries;
+    if(pFlat->c + pT32->cEntries > pFlat->cMax) {
+        cMax = max(0x1000, pFlat->cMax * 2);
+        if(pFlat->c + pT32->cEntries > MMWIN_MEMCOMPRESS_CACHE_MAX_LEAF) { return FALSE; }
+        if(!(peNew = LocalAlloc(0, cMax * sizeof(_BTREE_LEAF_ENTRY)))) { return FALSE; }
+        if(pFlat->pe) {
+            memcpy(peNew, pFlat->pe, pFlat->c * sizeof(_BTREE_LEAF_ENTRY));
+            LocalFree(pFlat->pe);
+        }
+        pFlat->pe = peNew;
+        pFlat->cMax = cMax;
+    }
+    memcpy(pFlat->pe + pFlat->c, peLeaf, pT32->cEntries * sizeof(_BTREE_LEAF_ENTRY));
+    pFlat->c += pT32->cEntries;
+    return TRUE;
+}
+
+int MmWin_BTree_FlatCmpSort(_In_ _BTREE_LEAF_ENTRY *pe1, _In_ _BTREE_LEAF_ENTRY *pe2)
+{
+    return (pe1->k < pe2->k) ? -1 : ((pe1->k > pe2->k) ? 1 : 0);
+}
+
+int MmWin_BTree_FlatCmpFind(_In_ PVOID pvFind, _In_ _BTREE_LEAF_ENTRY *pe)
+{
+    DWORD dwKey = (DWORD)(QWORD)pvFind;
+    return (dwKey < pe->k) ? -1 : ((dwKey > pe->k) ? 1 : 0);
+}
+
+/*
+* Flatten a B+tree into a sorted array of its leaf entries.
+* -- pProcess
+* -- vaTree
+* -- pFlat
+* -- fVmmRead
+* -- return
+*/
+_Success_(return)
+BOOL MmWin_BTree_FlattenSorted(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaTree, _Out_ PMMWIN_BTREE_FLAT pFlat, _In_ QWORD fVmmRead)
+{
+    DWORD i;
+    ZeroMemory(pFlat, sizeof(MMWIN_BTREE_FLAT));
+    if(!MmWin_BTree_Flatten(pProcess, vaTree, pFlat, fVmmRead)) {
+        LocalFree(pFlat->pe);
+        ZeroMemory(pFlat, sizeof(MMWIN_BTREE_FLAT));
+        return FALSE;
+    }
+    for(i = 1; i < pFlat->c; i++) {
+        if(pFlat->pe[i - 1].k > pFlat->pe[i].k) {
+            qsort(pFlat->pe, pFlat->c, sizeof(_BTREE_LEAF_ENTRY), (int(*)(const void*, const void*))MmWin_BTree_FlatCmpSort);
+            break;
         }
     }
     return TRUE;
 }
 
+/*
+* Search a flattened B+tree for a key.
+* -- pFlat
+* -- dwKey
+* -- pdwValue
+* -- return
+*/
+_Success_(return)
+BOOL MmWin_BTree_FlatSearch(_In_ PMMWIN_BTREE_FLAT pFlat, _In_ DWORD dwKey, _Out_ PDWORD pdwValue)
+{
+    _BTREE_LEAF_ENTRY *pe;
+    pe = Util_qfind((PVOID)(QWORD)dwKey, pFlat->c, pFlat->pe, sizeof(_BTREE_LEAF_ENTRY), (int(*)(PVOID, PVOID))MmWin_BTree_FlatCmpFind);
+    if(!pe) { return FALSE; }
+    *pdwValue = pe->v;
+    return TRUE;
+}
+
+VOID MmWin_MemCompressCache_CallbackCleanup_ObStore(PMMWINOB_MEMCOMPRESS_STORE pOb)
+{
+    Ob_DECREF(pOb->pmPageRecordArray);
+    Ob_DECREF(pOb->pmRegion);
+    LocalFree(pOb->PagesTree.pe);
+}
+
+VOID MmWin_MemCompressCache_CallbackCleanup_ObCache(PMMWINOB_MEMCOMPRESS_CACHE pOb)
+{
+    Ob_DECREF(pOb->pmObStore);
+    LocalFree(pOb->KeyToStoreTree.pe);
+}
+
+/*
+* Retrieve the compressed store metadata cache of the current generation - or
+* build a new cache (flatten the KeyToStoreTree) if the generation is stale.
+* CALLER DECREF: return
+* -- ctx
+* -- return
+*/
+PMMWINOB_MEMCOMPRESS_CACHE MmWin_MemCompressCache_Get(_In_ PMMWINX64_COMPRESS_CONTEXT ctx)
+{
+    PMMWIN_MEMCOMPRESS_CONTEXT ctxMc = &((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress;
+    PMMWINOB_MEMCOMPRESS_CACHE pObCache = NULL, pObCachePublished;
+    DWORD dwGeneration = ctxVmm->Cache.dwPagingGeneration;
+    pObCache = ObContainer_GetOb(ctxMc->pObCCache);
+    if(pObCache && (pObCache->dwGeneration == dwGeneration)) { return pObCache; }
+    Ob_DECREF_NULL(&pObCache);
+    // build new cache without holding the lock (device reads), the lock is
+    // only taken to publish - a concurrently published cache is preferred.
+    if(!(pObCache = Ob_Alloc(OB_TAG_MM_MEMCOMPRESS_CACHE, LMEM_ZEROINIT, sizeof(MMWINOB_MEMCOMPRESS_CACHE), MmWin_MemCompressCache_CallbackCleanup_ObCache, NULL))) { return NULL; }
+    pObCache->dwGeneration = dwGeneration;
+    pObCache->fValid =
+        (pObCache->pmObStore = ObMap_New(OB_MAP_FLAGS_OBJECT_OB)) &&
+        MmWin_BTree_FlattenSorted(ctx->pSystemProcess, ctxMc->vaKeyToStoreTree, &pObCache->KeyToStoreTree, ctx->fVmmRead);
+    EnterCriticalSection(&ctxMc->LockCache);
+    pObCachePublished = ObContainer_GetOb(ctxMc->pObCCache);
+    if(pObCachePublished && (pObCachePublished->dwGeneration == dwGeneration)) {
+        Ob_DECREF(pObCache);
+        pObCache = pObCachePublished;
+    } else {
+        Ob_DECREF(pObCachePublished);
+        ObContainer_SetOb(ctxMc->pObCCache, pObCache);
+        vmmprintfvv_fn("KeyToStoreTree flattened: %s %i entries.\n", (pObCache->fValid ? "OK" : "FAIL"), pObCache->KeyToStoreTree.c);
+    }
+    LeaveCriticalSection(&ctxMc->LockCache);
+    return pObCache;
+}
+
+/*
+* Retrieve a decoded compressed store from the cache - or decode the store and
+* flatten its PagesTree if not already cached. ctx->e.iSmkm must be set. The
+* returned store may be invalid (fValid = FALSE) if decoding failed.
+* CALLER DECREF: return
+* -- ctx
+* -- pCache
+* -- return
+*/
+PMMWINOB_MEMCOMPRESS_STORE MmWin_MemCompressCache_GetStore(_In_ PMMWINX64_COMPRESS_CONTEXT ctx, _In_ PMMWINOB_MEMCOMPRESS_CACHE pCache)
+{
+    PMMWIN_MEMCOMPRESS_CONTEXT ctxMc = &((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress;
+    PMMWIN_MEMCOMPRESS_OFFSET po = &ctxMc->O;
+    PMMWINOB_MEMCOMPRESS_STORE pObStore = NULL, pObStorePublished;
+    P_SMHP_CHUNK_METADATA32 pc32;
+    P_SMHP_CHUNK_METADATA64 pc64;
+    QWORD vaPagesTree;
+    DWORD i;
+    if((pObStore = ObMap_GetByKey(pCache->pmObStore, ctx->e.iSmkm))) { return pObStore; }
+    // decode store without holding the lock (device reads), the lock is only
+    // taken to publish - also invalid stores are published to avoid retries.
+    if(!(pObStore = Ob_Alloc(OB_TAG_MM_MEMCOMPRESS_STORE, LMEM_ZEROINIT, sizeof(MMWINOB_MEMCOMPRESS_STORE), MmWin_MemCompressCache_CallbackCleanup_ObStore, NULL))) { return NULL; }
+    // 1: locate and read SmkmStore
+    if(ctxVmm->f32 ? !MmWin_MemCompress2_SmkmStoreMetadata32(ctx) : !MmWin_MemCompress2_SmkmStoreMetadata64(ctx)) { goto finish; }
+    if(!VmmRead2(ctx->pSystemProcess, ctx->e.vaSmkmStore, ctx->e.pbSmkm, sizeof(ctx->e.pbSmkm), ctx->fVmmRead)) {
+        MmWin_MemCompress_LogError(ctx, "#C1 ReadSmkmStore");
+        goto finish;
+    }
+    // 2: validate
+    vaPagesTree = ctxVmm->f32 ? *(PDWORD)(ctx->e.pbSmkm + po->SMKM_STORE.PagesTree) : *(PQWORD)(ctx->e.pbSmkm + po->SMKM_STORE.PagesTree);
+    ctx->e.vaOwnerEPROCESS = ctxVmm->f32 ? *(PDWORD)(ctx->e.pbSmkm + po->SMKM_STORE.OwnerProcess) : *(PQWORD)(ctx->e.pbSmkm + po->SMKM_STORE.OwnerProcess);
+    if(COMPRESS_ALGORITHM_XPRESS != *(PWORD)(ctx->e.pbSmkm + po->SMKM_STORE.CompressionAlgorithm)) {
+        MmWin_MemCompress_LogError(ctx, "#C2 InvalidCompressionAlgorithm");
+        goto finish;
+    }
+    if(ctx->e.vaOwnerEPROCESS != ctxMc->vaEPROCESS) {
+        MmWin_MemCompress_LogError(ctx, "#C3 OwnerEPROCESS");
+        goto finish;
+    }
+    // 3: decode store metadata
+    pObStore->vaSmkmStore = ctx->e.vaSmkmStore;
+    pObStore->dwRegionIndexMask = *(PDWORD)(ctx->e.pbSmkm + po->SMKM_STORE.RegionIndexMask) & 0xff;
+    pObStore->dwRegionSizeMask = *(PDWORD)(ctx->e.pbSmkm + po->SMKM_STORE.RegionSizeMask);
+    if(ctxVmm->f32) {
+        pObStore->vaRegionPtrArray = *(PDWORD)(ctx->e.pbSmkm + po->SMKM_STORE.CompressedRegionPtrArray);
+        pc32 = (P_SMHP_CHUNK_METADATA32)(ctx->e.pbSmkm + po->SMKM_STORE.ChunkMetaData);
+        for(i = 0; i < 32; i++) {
+            pObStore->avaChunkPtr[i] = pc32->avaChunkPtr[i];
+        }
+        pObStore->dwBitValue = pc32->dwBitValue;
+        pObStore->dwPageRecordsPerChunkMask = pc32->dwPageRecordsPerChunkMask;
+        pObStore->dwPageRecordSize = pc32->dwPageRecordSize;
+        pObStore->dwChunkPageHeaderSize = pc32->dwChunkPageHeaderSize;
+    } else {
+        pObStore->vaRegionPtrArray = *(PQWORD)(ctx->e.pbSmkm + po->SMKM_STORE.CompressedRegionPtrArray);
+        pc64 = (P_SMHP_CHUNK_METADATA64)(ctx->e.pbSmkm + po->SMKM_STORE.ChunkMetaData);
+        memcpy(pObStore->avaChunkPtr, pc64->avaChunkPtr, sizeof(pObStore->avaChunkPtr));
+        pObStore->dwBitValue = pc64->dwBitValue;
+        pObStore->dwPageRecordsPerChunkMask = pc64->dwPageRecordsPerChunkMask;
+        pObStore->dwPageRecordSize = pc64->dwPageRecordSize;
+        pObStore->dwChunkPageHeaderSize = pc64->dwChunkPageHeaderSize;
+    }
+    // 4: flatten pages tree
+    if(!(pObStore->pmPageRecordArray = ObMap_New(0)) || !(pObStore->pmRegion = ObMap_New(0))) { goto finish; }
+    if(!MmWin_BTree_FlattenSorted(ctx->pSystemProcess, vaPagesTree, &pObStore->PagesTree, ctx->fVmmRead)) {
+        MmWin_MemCompress_LogError(ctx, "#C4 PagesTreeFlatten");
+        goto finish;
+    }
+    pObStore->fValid = TRUE;
+finish:
+    EnterCriticalSection(&ctxMc->LockCache);
+    if((pObStorePublished = ObMap_GetByKey(pCache->pmObStore, ctx->e.iSmkm))) {
+        Ob_DECREF(pObStore);
+        pObStore = pObStorePublished;
+    } else {
+        ObMap_Push(pCache->pmObStore, ctx->e.iSmkm, pObStore);
+    }
+    LeaveCriticalSection(&ctxMc->LockCache);
+    return pObStore;
+}
+
+/*
+* Resolve the compressed data location (ctx->e.vaRegion, cbRegionOffset and
+* cbCompressedData) of a page using the compressed store metadata cache.
+* -- ctx
+* -- return
+*/
+_Success_(return)
+BOOL MmWin_MemCompressCache_Resolve(_In_ PMMWINX64_COMPRESS_CONTEXT ctx)
+{
+    BOOL fResult = FALSE;
+    PMMWINOB_MEMCOMPRESS_CACHE pObCache = NULL;
+    PMMWINOB_MEMCOMPRESS_STORE pObStore = NULL;
+    DWORD i, v, dwEncodedMetadata, iChunkPtr = 0, iChunkArray, dwPoolHdr = 0, dwRegionIndex;
+    QWORD vaPageRecordArray = 0, vaRegion = 0;
+    _ST_PAGE_RECORD PageRecord;
+    // 1: store index and store
+    if(!(pObCache = MmWin_MemCompressCache_Get(ctx)) || !pObCache->fValid) { goto fail; }
+    if(!MmWin_BTree_FlatSearch(&pObCache->KeyToStoreTree, ctx->e.dwPageKey, &v)) {
+        MmWin_MemCompress_LogError(ctx, "#C5 KeyToStoreSearch");
+        goto fail;
+    }
+    if(v & 0x01000000) { goto fail; }
+    ctx->e.iSmkm = 0x3ff & v;
+    if(!(pObStore = MmWin_MemCompressCache_GetStore(ctx, pObCache)) || !pObStore->fValid) { goto fail; }
+    ctx->e.vaSmkmStore = pObStore->vaSmkmStore;
+    // 2: region key and page record
+    if(!MmWin_BTree_FlatSearch(&pObStore->PagesTree, ctx->e.dwPageKey, &ctx->e.dwRegionKey)) {
+        MmWin_MemCompress_LogError(ctx, "#C6 PagesTreeSearch");
+        goto fail;
+    }
+    dwEncodedMetadata = ctx->e.dwRegionKey >> (pObStore->dwBitValue & 0xff);
+    for(i = 0; i < 32; i++) {
+        if(!(dwEncodedMetadata >> i)) { break; }
+        iChunkPtr = i;
+    }
+    iChunkArray = (1 << iChunkPtr) ^ dwEncodedMetadata;
+    if(iChunkArray > 0x400) { goto fail; }
+    if(!(vaPageRecordArray = (QWORD)ObMap_GetByKey(pObStore->pmPageRecordArray, ((QWORD)iChunkPtr << 16) | iChunkArray))) {
+        if(ctxVmm->f32 ? !VMM_KADDR32_8((DWORD)pObStore->avaChunkPtr[iChunkPtr]) : !VMM_KADDR64_16(pObStore->avaChunkPtr[iChunkPtr])) { goto fail; }
+        if(pObStore->avaChunkPtr[iChunkPtr] & 0xfff) {
+            if(!VmmRead2(ctx->pSystemProcess, pObStore->avaChunkPtr[iChunkPtr] - (ctxVmm->f32 ? 4 : 12), (PBYTE)&dwPoolHdr, 4, ctx->fVmmRead) || (dwPoolHdr != 'ABms')) { goto fail; }
+        }
+        if(!VmmRead2(ctx->pSystemProcess, pObStore->avaChunkPtr[iChunkPtr] + (ctxVmm->f32 ? 0x0cULL : 0x10ULL) * iChunkArray, (PBYTE)&vaPageRecordArray, (ctxVmm->f32 ? sizeof(DWORD) : sizeof(QWORD)), ctx->fVmmRead)) { goto fail; }
+        if(ctxVmm->f32 ? !VMM_KADDR32_PAGE((DWORD)vaPageRecordArray) : !VMM_KADDR64_PAGE(vaPageRecordArray)) { goto fail; }
+        ObMap_Push(pObStore->pmPageRecordArray, ((QWORD)iChunkPtr << 16) | iChunkArray, (PVOID)vaPageRecordArray);
+    }
+    ctx->e.vaPageRecord = vaPageRecordArray + pObStore->dwChunkPageHeaderSize + ((QWORD)pObStore->dwPageRecordSize * (ctx->e.dwRegionKey & pObStore->dwPageRecordsPerChunkMask));
+    if(ctxVmm->f32) { ctx->e.vaPageRecord = (DWORD)ctx->e.vaPageRecord; }
+    // 3: page record -> region and offset
+    if(!VmmRead2(ctx->pSystemProcess, ctx->e.vaPageRecord, (PBYTE)&PageRecord, sizeof(PageRecord), ctx->fVmmRead)) {
+        MmWin_MemCompress_LogError(ctx, "#C7 ReadPageRecord");
+        goto fail;
+    }
+    if(PageRecord.Key == 0xffffffff) { goto fail; }
+    ctx->e.cbCompressedData = (PageRecord.CompressedSize == 0x1000) ? 0x1000 : PageRecord.CompressedSize & 0xfff;
+    dwRegionIndex = PageRecord.Key >> pObStore->dwRegionIndexMask;
+    if(!(vaRegion = (QWORD)ObMap_GetByKey(pObStore->pmRegion, dwRegionIndex))) {
+        if(!VmmRead2(ctx->pSystemProcess, pObStore->vaRegionPtrArray + dwRegionIndex * (ctxVmm->f32 ? sizeof(DWORD) : sizeof(QWORD)), (PBYTE)&vaRegion, (ctxVmm->f32 ? sizeof(DWORD) : sizeof(QWORD)), ctx->fVmmRead)) { goto fail; }
+        if(!vaRegion || (vaRegion & (ctxVmm->f32 ? 0x8000ffff : 0xffff8000'0000ffff))) { goto fail; }
+        ObMap_Push(pObStore->pmRegion, dwRegionIndex, (PVOID)vaRegion);
+    }
+    ctx->e.vaRegion = vaRegion;
+    ctx->e.cbRegionOffset = (PageRecord.Key & pObStore->dwRegionSizeMask) << 4;
+    fResult = TRUE;
+fail:
+    Ob_DECREF(pObStore);
+    Ob_DECREF(pObCache);
+    return fResult;
+}
+
+
+
 /*
 * Decompress a page.
 * -- pProcess
@@ -967,13 +1457,22 @@ BOOL MmWin_MemCompress(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD
     ctx->fVmmRead = fVmmRead;
     ctx->e.va = va;
     ctx->e.PTE = pte;
-    if(ctxVmm->f32) {
+    ctx->e.dwPageKey = ctxVmm->f32 ? MMWINX86PAE_PTE_PAGE_KEY_COMPRESSED(pte) : MMWINX64_PTE_PAGE_KEY_COMPRESSED(pte);
+    fResult =
+        (ctx->pProcess = pProcess) &&
+        (ctx->pSystemProcess = pObSystemProcess = VmmProcessGet(4)) &&
+        (ctx->pProcessMemCompress = pObMemCompressProcess = VmmProcessGet(((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.dwPid));
+    if(!fResult) { goto fail; }
+    // non-volatile memory -> try resolve by metadata cache. errors are logged
+    // once only - by the uncached fallback if the cache path fails.
+    ctx->fNoLog = TRUE;
+    fResult = !ctxMain->dev.fVolatile && MmWin_MemCompressCache_Resolve(ctx);
+    ctx->fNoLog = FALSE;
+    if(fResult) {
+        fResult = MmWin_MemCompress5_DecompressPage(ctx, pbPage);
+    } else if(ctxVmm->f32) {
         // 32-bit system
-        ctx->e.dwPageKey = MMWINX86PAE_PTE_PAGE_KEY_COMPRESSED(pte);
         fResult =
-            (ctx->pProcess = pProcess) &&
-            (ctx->pSystemProcess = pObSystemProcess = VmmProcessGet(4)) &&
-            (ctx->pProcessMemCompress = pObMemCompressProcess = VmmProcessGet(((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.dwPid)) &&
             MmWin_MemCompress1_SmkmStoreIndex(ctx) &&
             MmWin_MemCompress2_SmkmStoreMetadata32(ctx) &&
             MmWin_MemCompress3_SmkmStoreAndPageRecord32(ctx) &&
@@ -981,11 +1480,7 @@ BOOL MmWin_MemCompress(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD
             MmWin_MemCompress5_DecompressPage(ctx, pbPage);
     } else {
         // 64-bit system
-        ctx->e.dwPageKey = MMWINX64_PTE_PAGE_KEY_COMPRESSED(pte);
         fResult =
-            (ctx->pProcess = pProcess) &&
-            (ctx->pSystemProcess = pObSystemProcess = VmmProcessGet(4)) &&
-            (ctx->pProcessMemCompress = pObMemCompressProcess = VmmProcessGet(((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.dwPid)) &&
             MmWin_MemCompress1_SmkmStoreIndex(ctx) &&
             MmWin_MemCompress2_SmkmStoreMetadata64(ctx) &&
             MmWin_MemCompress3_SmkmStoreAndPageRecord64(ctx) &&
@@ -1005,24 +1500,172 @@ fail:
 // PAGE FILE FUNCTIONALITY BELOW:
 //-----------------------------------------------------------------------------
 
+/*
+* Retrieve a read completion event from the lock-free event pool - or create a
+* new event if the pool is empty. The event is returned in non-signaled state.
+* -- ctx
+* -- return
+*/
+HANDLE MmWin_PfEventGet(_In_ PMMWIN_CONTEXT ctx)
+{
+    DWORD i;
+    HANDLE hEvent;
+    for(i = 0; i < MMWIN_PF_EVENT_POOL_SIZE; i++) {
+        if(ctx->hEventPool[i] && (hEvent = InterlockedExchangePointer(&ctx->hEventPool[i], NULL))) {
+            return hEvent;
+        }
+    }
+    return CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+/*
+* Return a read completion event to the event pool (or close it if full).
+* -- ctx
+* -- hEvent
+*/
+VOID MmWin_PfEventReturn(_In_ PMMWIN_CONTEXT ctx, _In_opt_ HANDLE hEvent)
+{
+    DWORD i;
+    if(!hEvent) { return; }
+    ResetEvent(hEvent);
+    for(i = 0; i < MMWIN_PF_EVENT_POOL_SIZE; i++) {
+        if(!InterlockedCompareExchangePointer(&ctx->hEventPool[i], hEvent, NULL)) {
+            return;
+        }
+    }
+    CloseHandle(hEvent);
+}
+
+/*
+* Issue an overlapped positional read of one page from a page file.
+* -- ctx
+* -- pReq
+* -- return = TRUE if the read is pending or completed; FALSE on failure.
+*/
+_Success_(return)
+BOOL MmWin_PfReadFile_Issue(_In_ PMMWIN_CONTEXT ctx, _Inout_ PMMWIN_PF_READ pReq)
+{
+    QWORD qwOffset = (QWORD)pReq->dwPfOffset << 12;
+    pReq->f = FALSE;
+    ZeroMemory(&pReq->ov, sizeof(OVERLAPPED));
+    if((pReq->dwPfNumber >= 10) || !ctx->hPageFile[pReq->dwPfNumber]) { return FALSE; }
+    if(!(pReq->ov.hEvent = MmWin_PfEventGet(ctx))) { return FALSE; }
+    pReq->ov.Offset = (DWORD)qwOffset;
+    pReq->ov.OffsetHigh = (DWORD)(qwOffset >> 32);
+    if(ReadFile(ctx->hPageFile[pReq->dwPfNumber], pReq->pb, 0x1000, NULL, &pReq->ov) || (GetLastError() == ERROR_IO_PENDING)) {
+        return TRUE;
+    }
+    MmWin_PfEventReturn(ctx, pReq->ov.hEvent);
+    pReq->ov.hEvent = NULL;
+    return FALSE;
+}
+
+/*
+* Wait for completion of a read previously issued by MmWin_PfReadFile_Issue().
+* -- ctx
+* -- pReq
+*/
+VOID MmWin_PfReadFile_Complete(_In_ PMMWIN_CONTEXT ctx, _Inout_ PMMWIN_PF_READ pReq)
+{
+    DWORD cbRead = 0;
+    if(!pReq->ov.hEvent) { return; }
+    pReq->f = GetOverlappedResult(ctx->hPageFile[pReq->dwPfNumber], &pReq->ov, &cbRead, TRUE) && (cbRead == 0x1000);
+    MmWin_PfEventReturn(ctx, pReq->ov.hEvent);
+    pReq->ov.hEvent = NULL;
+}
+
+/*
+* Read multiple pages from the page files. All reads are issued before any is
+* waited upon - allowing the storage stack to service them concurrently. The
+* requests should ideally be sorted by page file number and offset. Results of
+* the individual reads are returned in the f member of each request.
+* Reads from different threads never block each other since page files are
+* read with positional overlapped i/o without a shared file position.
+* -- cReq
+* -- pReqs
+*/
+VOID MmWin_PfReadFileBatch(_In_ DWORD cReq, _Inout_updates_(cReq) PMMWIN_PF_READ pReqs)
+{
+    PMMWIN_CONTEXT ctx = (PMMWIN_CONTEXT)ctxVmm->pMmContext;
+    DWORD i, iBase, cChunk;
+    for(i = 0; i < cReq; i++) {
+        pReqs[i].f = FALSE;
+    }
+    if(!ctx) { return; }
+    for(iBase = 0; iBase < cReq; iBase += cChunk) {
+        cChunk = min(cReq - iBase, MMWIN_PF_BATCH_MAX);
+        for(i = iBase; i < iBase + cChunk; i++) {
+            MmWin_PfReadFile_Issue(ctx, pReqs + i);
+        }
+        for(i = iBase; i < iBase + cChunk; i++) {
+            MmWin_PfReadFile_Complete(ctx, pReqs + i);
+        }
+    }
+}
+
 _Success_(return)
 BOOL MmWin_PfReadFile(_In_ DWORD dwPfNumber, _In_ DWORD dwPfOffset, _Out_writes_(4096) PBYTE pbPage)
 {
     PMMWIN_CONTEXT ctx = (PMMWIN_CONTEXT)ctxVmm->pMmContext;
-    DWORD cb = 0;
-    if(!ctx || !ctx->pPageFile[dwPfNumber]) { return FALSE; }
-    EnterCriticalSection(&ctx->Lock);
-    if(!_fseeki64(ctx->pPageFile[dwPfNumber], (QWORD)dwPfOffset << 12, SEEK_SET)) {
-        cb = (DWORD)fread(pbPage, 1, 0x1000, ctx->pPageFile[dwPfNumber]);
-    }
-    LeaveCriticalSection(&ctx->Lock);
-    return cb == 0x1000;
+    MMWIN_PF_READ req = { 0 };
+    if(!ctx) { return FALSE; }
+    req.dwPfNumber = dwPfNumber;
+    req.dwPfOffset = dwPfOffset;
+    req.pb = pbPage;
+    if(MmWin_PfReadFile_Issue(ctx, &req)) {
+        MmWin_PfReadFile_Complete(ctx, &req);
+    }
+    return req.f;
 }
 
+/*
+* Update statistics and the paging cache (success or failure) after a page
+* has been read from the page file or the compressed store.
+* -- pte
+* -- pbPage
+* -- fResult
+* -- fCompressed
+* -- return = fResult
+*/
+BOOL MmWin_PfRead_Finish(_In_ QWORD pte, _In_reads_(4096) PBYTE pbPage, _In_ BOOL fResult, _In_ BOOL fCompressed)
+{
+    PVMMOB_MEM pObCacheEntry;
+    if(fCompressed) {
+        InterlockedIncrement64(fResult ? &ctxVmm->stat.page.cCompressed : &ctxVmm->stat.page.cFailCompressed);
+    } else {
+        InterlockedIncrement64(fResult ? &ctxVmm->stat.page.cPageFile : &ctxVmm->stat.page.cFailPageFile);
+    }
+    if(fResult) {
+        if((pObCacheEntry = VmmCacheReserve(VMM_CACHE_TAG_PAGING))) {
+            pObCacheEntry->h.f = TRUE;
+            pObCacheEntry->h.qwA = pte;
+            memcpy(pObCacheEntry->pb, pbPage, 0x1000);
+            VmmCacheReserveReturn(pObCacheEntry);
+        }
+        return TRUE;
+    }
+    VmmNegCachePush(VMM_CACHE_TAG_PAGING, pte);
+    return FALSE;
+}
+
+/*
+* Read a page from the page file or the compressed store. If pDefer is given
+* the actual i/o is not performed - instead the read is recorded in pDefer for
+* the caller to carry out in a batch. Cached pages are always served directly.
+* -- pProcess
+* -- va
+* -- pte
+* -- fVmmRead
+* -- dwPfNumber
+* -- dwPfOffset
+* -- pbPage
+* -- pDefer
+* -- return
+*/
 _Success_(return)
-BOOL MmWin_PfRead(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _In_ QWORD fVmmRead, _In_ DWORD dwPfNumber, _In_ DWORD dwPfOffset, _Out_writes_(4096) PBYTE pbPage)
+BOOL MmWin_PfRead(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _In_ QWORD fVmmRead, _In_ DWORD dwPfNumber, _In_ DWORD dwPfOffset, _Out_writes_(4096) PBYTE pbPage, _Out_opt_ PMMWIN_PAGED_DEFER pDefer)
 {
-    BOOL fResult;
+    BOOL fResult, fCompressed;
     PVMMOB_MEM pObCacheEntry;
     // cached page?
     if((pObCacheEntry = VmmCacheGet(VMM_CACHE_TAG_PAGING, pte))) {
@@ -1032,41 +1675,31 @@ BOOL MmWin_PfRead(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte,
         return TRUE;
     }
     // cached failed page?
-    if(ObSet_Exists(ctxVmm->Cache.PAGING_FAILED, pte)) {
+    if(VmmNegCacheExists(VMM_CACHE_TAG_PAGING, pte)) {
         InterlockedIncrement64(&ctxVmm->stat.page.cFailCacheHit);
         return FALSE;
     }
     // check flags: NoPagingIo, ForceCache and santity checks.
     if(fVmmRead & (VMM_FLAG_NOPAGING_IO | VMM_FLAG_FORCECACHE_READ)) { return FALSE; }
     if(!ctxVmm->pMmContext || (dwPfNumber >= 10)) { return FALSE; }
+    fCompressed = ((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.fValid && (dwPfNumber == ((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.dwPageFileNumber);
+    // defer to batch caller
+    if(pDefer) {
+        pDefer->fValid = TRUE;
+        pDefer->fCompressed = fCompressed;
+        pDefer->dwPfNumber = dwPfNumber;
+        pDefer->dwPfOffset = dwPfOffset;
+        pDefer->pte = pte;
+        pDefer->fVmmRead = fVmmRead;
+        return FALSE;
+    }
     // dispatch to page file or compressed virtual store
-    if(((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.fValid && (dwPfNumber == ((PMMWIN_CONTEXT)ctxVmm->pMmContext)->MemCompress.dwPageFileNumber)) {
+    if(fCompressed) {
         fResult = MmWin_MemCompress(pProcess, va, pte, pbPage, fVmmRead);
-        if(fResult) {
-            InterlockedIncrement64(&ctxVmm->stat.page.cCompressed);
-        } else {
-            InterlockedIncrement64(&ctxVmm->stat.page.cFailCompressed);
-        }
     } else {
         fResult = MmWin_PfReadFile(dwPfNumber, dwPfOffset, pbPage);
-        if(fResult) {
-            InterlockedIncrement64(&ctxVmm->stat.page.cPageFile);
-        } else {
-            InterlockedIncrement64(&ctxVmm->stat.page.cFailPageFile);
-        }
     }
-    // update cache
-    if(fResult) {
-        if((pObCacheEntry = VmmCacheReserve(VMM_CACHE_TAG_PAGING))) {
-            pObCacheEntry->h.f = TRUE;
-            pObCacheEntry->h.qwA = pte;
-            memcpy(pObCacheEntry->pb, pbPage, 0x1000);
-            VmmCacheReserveReturn(pObCacheEntry);
-        }
-        return TRUE;
-    }
-    ObSet_Push(ctxVmm->Cache.PAGING_FAILED, pte);
-    return FALSE;
+    return MmWin_PfRead_Finish(pte, pbPage, fResult, fCompressed);
 }
 
 
@@ -1105,7 +1738,7 @@ fail:
 * -- return
 */
 _Success_(return)
-BOOL MmWinX86_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ DWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags)
+BOOL MmWinX86_ReadPagedEx(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ DWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _Out_opt_ PMMWIN_PAGED_DEFER pDefer, _In_ QWORD flags)
 {
     BOOL f;
     DWORD dwPfNumber, dwPfOffset;
@@ -1149,7 +1782,7 @@ BOOL MmWinX86_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ DWOR
             *ppa = pte & 0xfffff000;
             return FALSE;
         }
-        return MmWinX86_ReadPaged(pProcess, va, pte, pbPage, ppa, flags | VMM_FLAG_NOVAD);
+        return MmWinX86_ReadPagedEx(pProcess, va, pte, pbPage, ppa, pDefer, flags | VMM_FLAG_NOVAD);
     }
     if(!pte || !pbPage) { return FALSE; }
     // demand zero virtual memory [ nt!_MMPTE_SOFTWARE ]
@@ -1159,12 +1792,18 @@ BOOL MmWinX86_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ DWOR
         return TRUE;
     }
     // retrive from page file or compressed store
-    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage);
+    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage, pDefer);
 fail:
     InterlockedIncrement64(&ctxVmm->stat.page.cFail);
     return FALSE;
 }
 
+_Success_(return)
+BOOL MmWinX86_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ DWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags)
+{
+    return MmWinX86_ReadPagedEx(pProcess, va, pte, pbPage, ppa, NULL, flags);
+}
+
 
 //-----------------------------------------------------------------------------
 // X86PAE VIRTUAL MEMORY BELOW:
@@ -1202,7 +1841,7 @@ fail:
 * -- return
 */
 _Success_(return)
-BOOL MmWinX86PAE_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags)
+BOOL MmWinX86PAE_ReadPagedEx(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _Out_opt_ PMMWIN_PAGED_DEFER pDefer, _In_ QWORD flags)
 {
     BOOL f;
     DWORD dwPfNumber, dwPfOffset;
@@ -1246,7 +1885,7 @@ BOOL MmWinX86PAE_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ Q
             *ppa = pte & 0x0000003f'fffff000;
             return FALSE;
         }
-        return MmWinX86PAE_ReadPaged(pProcess, va, pte, pbPage, ppa, flags | VMM_FLAG_NOVAD);
+        return MmWinX86PAE_ReadPagedEx(pProcess, va, pte, pbPage, ppa, pDefer, flags | VMM_FLAG_NOVAD);
     }
     if(!pte || !pbPage) { return FALSE; }
     // demand zero virtual memory [ nt!_MMPTE_SOFTWARE ]
@@ -1256,12 +1895,18 @@ BOOL MmWinX86PAE_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ Q
         return TRUE;
     }
     // retrive from page file or compressed store
-    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage);
+    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage, pDefer);
 fail:
     InterlockedIncrement64(&ctxVmm->stat.page.cFail);
     return FALSE;
 }
 
+_Success_(return)
+BOOL MmWinX86PAE_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ DWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags)
+{
+    return MmWinX86PAE_ReadPagedEx(pProcess, va, pte, pbPage, ppa, NULL, flags);
+}
+
 
 //-----------------------------------------------------------------------------
 // X64 VIRTUAL MEMORY BELOW:
@@ -1300,7 +1945,7 @@ fail:
 * -- return
 */
 _Success_(return)
-BOOL MmWinX64_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags)
+BOOL MmWinX64_ReadPagedEx(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _Out_opt_ PMMWIN_PAGED_DEFER pDefer, _In_ QWORD flags)
 {
     BOOL f;
     DWORD dwPfNumber, dwPfOffset;
@@ -1344,7 +1989,7 @@ BOOL MmWinX64_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWOR
             *ppa = pte & 0x0000ffff'fffff000;
             return FALSE;
         }
-        return MmWinX64_ReadPaged(pProcess, va, pte, pbPage, ppa, flags | VMM_FLAG_NOVAD);
+        return MmWinX64_ReadPagedEx(pProcess, va, pte, pbPage, ppa, pDefer, flags | VMM_FLAG_NOVAD);
     }
     if(!pte || !pbPage) { return FALSE; }
     // demand zero virtual memory [ nt!_MMPTE_SOFTWARE ]
@@ -1354,12 +1999,223 @@ BOOL MmWinX64_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWOR
         return TRUE;
     }
     // retrive from page file or compressed store
-    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage);
+    return MmWin_PfRead(pProcess, va, pte, flags, dwPfNumber, dwPfOffset, pbPage, pDefer);
 fail:
     InterlockedIncrement64(&ctxVmm->stat.page.cFail);
     return FALSE;
 }
 
+_Success_(return)
+BOOL MmWinX64_ReadPaged(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags)
+{
+    return MmWinX64_ReadPagedEx(pProcess, va, pte, pbPage, ppa, NULL, flags);
+}
+
+
+//-----------------------------------------------------------------------------
+// BATCHED PAGED READ BELOW:
+//-----------------------------------------------------------------------------
+
+#define MMWIN_PAGED_BATCH_COMPRESS_THREADS      8
+
+typedef struct tdMMWINOB_PAGED_BATCH_CONTEXT {
+    OB ObHdr;
+    PVMM_PROCESS pProcess;
+    PVMM_PAGED_READ pPages;
+    PMMWIN_PAGED_DEFER pDefer;
+    PDWORD piCompressed;
+    LONG cCompressed;
+    volatile LONG iCompressed;  // set to compressed count on entry and decremented as-goes
+    volatile LONG cDone;        // # of completed compressed pages
+    HANDLE hEventDone;          // set when all compressed pages are completed
+} MMWINOB_PAGED_BATCH_CONTEXT, *PMMWINOB_PAGED_BATCH_CONTEXT;
+
+/*
+* Retrieve the prototype pte address of a pte (or 0 if not a prototype pte).
+* -- pte
+* -- return
+*/
+QWORD MmWin_ReadPagedBatch_PrototypeAddress(_In_ QWORD pte)
+{
+    switch(ctxVmm->tpMemoryModel) {
+        case VMM_MEMORYMODEL_X64:
+            return MMWINX64_PTE_IS_HARDWARE(pte) ? 0 : MMWINX64_PTE_PROTOTYPE(pte);
+        case VMM_MEMORYMODEL_X86PAE:
+            return MMWINX86PAE_PTE_IS_HARDWARE(pte) ? 0 : MMWINX86PAE_PTE_PROTOTYPE(pte);
+        case VMM_MEMORYMODEL_X86:
+            return MMWINX86_PTE_IS_HARDWARE((DWORD)pte) ? 0 : MMWINX86_PTE_PROTOTYPE((DWORD)pte);
+        default:
+            return 0;
+    }
+}
+
+VOID MmWin_ReadPagedBatch_CallbackCleanup_ObContext(PMMWINOB_PAGED_BATCH_CONTEXT pOb)
+{
+    if(pOb->hEventDone) { CloseHandle(pOb->hEventDone); }
+}
+
+/*
+* Decompress compressed store pages of a batch until none are left to claim.
+* The caller buffers (pPages/pDefer) are only touched for claimed pages - a
+* work item starting after all pages are claimed returns without touching
+* them. Called by the batch owner and by helper work items.
+* -- ctx
+*/
+VOID MmWin_ReadPagedBatch_CompressDoWork(_In_ PMMWINOB_PAGED_BATCH_CONTEXT ctx)
+{
+    LONG i;
+    BOOL fResult;
+    PVMM_PAGED_READ pPage;
+    PMMWIN_PAGED_DEFER pDefer;
+    while((i = InterlockedDecrement(&ctx->iCompressed)) >= 0) {
+        pPage = ctx->pPages + ctx->piCompressed[i];
+        pDefer = ctx->pDefer + ctx->piCompressed[i];
+        fResult = MmWin_MemCompress(ctx->pProcess, pPage->va, pDefer->pte, pPage->pb, pDefer->fVmmRead);
+        pPage->f = MmWin_PfRead_Finish(pDefer->pte, pPage->pb, fResult, TRUE);
+        if(InterlockedIncrement(&ctx->cDone) == ctx->cCompressed) {
+            SetEvent(ctx->hEventDone);
+        }
+    }
+}
+
+/*
+* Helper work item - the batch context reference is overtaken from the caller.
+*/
+DWORD MmWin_ReadPagedBatch_CompressThreadProc(_In_ PMMWINOB_PAGED_BATCH_CONTEXT ctx)
+{
+    MmWin_ReadPagedBatch_CompressDoWork(ctx);
+    Ob_DECREF(ctx);
+    return 1;
+}
+
+/*
+* Read multiple 'paged' pages from virtual memory in one batch. The pages are
+* processed in stages:
+* 1) prefetch the prototype ptes of all pages in one scatter read.
+* 2) resolve each page - pages resolving to physical memory (transition and
+*    prototype) are returned in pa for the caller to read in one scatter read.
+*    page file and compressed store reads are deferred.
+* 3) read deferred page file pages sorted by page file and offset with all
+*    reads in-flight at the same time.
+* 4) decompress deferred compressed store pages in parallel on the work pool.
+* -- pProcess
+* -- cPages
+* -- pPages
+* -- flags
+*/
+VOID MmWin_ReadPagedBatch(_In_ PVMM_PROCESS pProcess, _In_ DWORD cPages, _Inout_updates_(cPages) PVMM_PAGED_READ pPages, _In_ QWORD flags)
+{
+    DWORD i, iPf, cPf = 0, cCompressed = 0, cThread;
+    QWORD va;
+    PVMM_PAGED_READ pPage;
+    PMMWIN_PAGED_DEFER pDefer, pDefers = NULL;
+    PQWORD pqwPfSort = NULL;
+    PMMWIN_PF_READ pPfReads = NULL;
+    POB_SET pObSetPrototype = NULL;
+    PVMM_PROCESS pObSystemProcess = NULL;
+    PMMWINOB_PAGED_BATCH_CONTEXT pObBatch = NULL;
+    PDWORD piCompressed;
+    for(i = 0; i < cPages; i++) {
+        pPages[i].pa = 0;
+        pPages[i].f = FALSE;
+    }
+    if(!(pPfReads = LocalAlloc(LMEM_ZEROINIT, cPages * (sizeof(MMWIN_PF_READ) + sizeof(MMWIN_PAGED_DEFER) + sizeof(QWORD) + sizeof(DWORD))))) {
+        // out of memory - resolve one page at a time.
+        for(i = 0; i < cPages; i++) {
+            pPages[i].f = ctxVmm->fnMemoryModel.pfnPagedRead(pProcess, pPages[i].va, pPages[i].pte, pPages[i].pb, &pPages[i].pa, flags);
+        }
+        return;
+    }
+    pDefers = (PMMWIN_PAGED_DEFER)(pPfReads + cPages);
+    pqwPfSort = (PQWORD)(pDefers + cPages);
+    piCompressed = (PDWORD)(pqwPfSort + cPages);
+    // 1: prefetch prototype ptes
+    if(!(flags & VMM_FLAG_NOPAGING_IO) && (cPages > 1) && (pObSetPrototype = ObSet_New())) {
+        for(i = 0; i < cPages; i++) {
+            if((va = MmWin_ReadPagedBatch_PrototypeAddress(pPages[i].pte))) {
+                ObSet_Push(pObSetPrototype, va);
+            }
+        }
+        if(ObSet_Size(pObSetPrototype) && (pObSystemProcess = VmmProcessGet(4))) {
+            VmmCachePrefetchPages3(pObSystemProcess, pObSetPrototype, (ctxVmm->tpMemoryModel == VMM_MEMORYMODEL_X86) ? 4 : 8, flags | VMM_FLAG_NOPAGING);
+        }
+    }
+    // 2: resolve pages - defer page file and compressed store i/o
+    for(i = 0; i < cPages; i++) {
+        pPage = pPages + i;
+        pDefer = pDefers + i;
+        switch(ctxVmm->tpMemoryModel) {
+            case VMM_MEMORYMODEL_X64:
+                pPage->f = MmWinX64_ReadPagedEx(pProcess, pPage->va, pPage->pte, pPage->pb, &pPage->pa, pDefer, flags);
+                break;
+            case VMM_MEMORYMODEL_X86PAE:
+                pPage->f = MmWinX86PAE_ReadPagedEx(pProcess, (DWORD)pPage->va, pPage->pte, pPage->pb, &pPage->pa, pDefer, flags);
+                break;
+            case VMM_MEMORYMODEL_X86:
+                pPage->f = MmWinX86_ReadPagedEx(pProcess, (DWORD)pPage->va, (DWORD)pPage->pte, pPage->pb, &pPage->pa, pDefer, flags);
+                break;
+        }
+        if(!pDefer->fValid) { continue; }
+        if(pDefer->fCompressed) {
+            piCompressed[cCompressed++] = i;
+        } else {
+            pqwPfSort[cPf++] = ((QWORD)pDefer->dwPfNumber << 60) | ((QWORD)pDefer->dwPfOffset << 28) | i;
+        }
+    }
+    // 3: read page file pages - sorted by page file and offset
+    if(cPf) {
+        qsort(pqwPfSort, cPf, sizeof(QWORD), Util_qsort_QWORD);
+        for(iPf = 0; iPf < cPf; iPf++) {
+            i = (DWORD)(pqwPfSort[iPf] & 0x0fffffff);
+            pPfReads[iPf].dwPfNumber = pDefers[i].dwPfNumber;
+            pPfReads[iPf].dwPfOffset = pDefers[i].dwPfOffset;
+            pPfReads[iPf].pb = pPages[i].pb;
+        }
+        MmWin_PfReadFileBatch(cPf, pPfReads);
+        for(iPf = 0; iPf < cPf; iPf++) {
+            i = (DWORD)(pqwPfSort[iPf] & 0x0fffffff);
+            pPages[i].f = MmWin_PfRead_Finish(pDefers[i].pte, pPages[i].pb, pPfReads[iPf].f, FALSE);
+        }
+    }
+    // 4: decompress compressed store pages - in parallel on the work pool
+    //    with the calling thread participating. helper work items hold own
+    //    references to the batch context - the calling thread never waits on
+    //    not yet started work items; only on pages claimed by other threads.
+    if(cCompressed) {
+        pObBatch = Ob_Alloc(OB_TAG_MM_PAGED_BATCH, LMEM_ZEROINIT, sizeof(MMWINOB_PAGED_BATCH_CONTEXT), MmWin_ReadPagedBatch_CallbackCleanup_ObContext, NULL);
+        if(pObBatch && !(pObBatch->hEventDone = CreateEvent(NULL, TRUE, FALSE, NULL))) {
+            Ob_DECREF_NULL(&pObBatch);
+        }
+        if(pObBatch) {
+            pObBatch->pProcess = pProcess;
+            pObBatch->pPages = pPages;
+            pObBatch->pDefer = pDefers;
+            pObBatch->piCompressed = piCompressed;
+            pObBatch->cCompressed = cCompressed;
+            pObBatch->iCompressed = cCompressed;
+            cThread = min(cCompressed, MMWIN_PAGED_BATCH_COMPRESS_THREADS);
+            for(i = 1; i < cThread; i++) {
+                VmmWork((LPTHREAD_START_ROUTINE)MmWin_ReadPagedBatch_CompressThreadProc, Ob_INCREF(pObBatch), NULL);
+            }
+            MmWin_ReadPagedBatch_CompressDoWork(pObBatch);
+            if(pObBatch->cDone != pObBatch->cCompressed) {
+                WaitForSingleObject(pObBatch->hEventDone, INFINITE);
+            }
+        } else {
+            // out of memory - decompress one page at a time.
+            for(i = 0; i < cCompressed; i++) {
+                pPage = pPages + piCompressed[i];
+                pDefer = pDefers + piCompressed[i];
+                pPage->f = MmWin_PfRead_Finish(pDefer->pte, pPage->pb, MmWin_MemCompress(pProcess, pPage->va, pDefer->pte, pPage->pb, pDefer->fVmmRead), TRUE);
+            }
+        }
+    }
+    Ob_DECREF(pObBatch);
+    Ob_DECREF(pObSetPrototype);
+    Ob_DECREF(pObSystemProcess);
+    LocalFree(pPfReads);
+}
+
 
 //-----------------------------------------------------------------------------
 // INITIALIZATION FUNCTIONALITY BELOW:
@@ -1372,10 +2228,17 @@ VOID MmWin_PagingClose()
     if(ctx) {
         ctxVmm->pMmContext = NULL;
         for(i = 0; i < 10; i++) {
-            if(ctx->pPageFile[i]) {
-                fclose(ctx->pPageFile[i]);
+            if(ctx->hPageFile[i]) {
+                CloseHandle(ctx->hPageFile[i]);
+            }
+        }
+        for(i = 0; i < MMWIN_PF_EVENT_POOL_SIZE; i++) {
+            if(ctx->hEventPool[i]) {
+                CloseHandle(ctx->hEventPool[i]);
             }
         }
+        Ob_DECREF(ctx->MemCompress.pObCCache);
+        DeleteCriticalSection(&ctx->MemCompress.LockCache);
         LocalFree(ctx);
     }
 }
@@ -1398,14 +2261,18 @@ VOID MmWin_PagingInitialize(_In_ BOOL fModeFull)
         default:
             return;
     }
+    ctxVmm->fnMemoryModel.pfnPagedReadBatch = MmWin_ReadPagedBatch;
     // 2: Initialize Page Files (if any)
     if(!ctx) {
         ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(MMWIN_CONTEXT));
         if(!ctx) { return; }
-        InitializeCriticalSection(&ctx->Lock);
+        InitializeCriticalSection(&ctx->MemCompress.LockCache);
+        ctx->MemCompress.pObCCache = ObContainer_New(NULL);
         for(i = 0; i < 10; i++) {
             if(ctxMain->cfg.szPageFile[i][0]) {
-                if(fopen_s(&ctx->pPageFile[i], ctxMain->cfg.szPageFile[i], "rb")) {
+                ctx->hPageFile[i] = CreateFileA(ctxMain->cfg.szPageFile[i], GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_RANDOM_ACCESS, NULL);
+                if(ctx->hPageFile[i] == INVALID_HANDLE_VALUE) {
+                    ctx->hPageFile[i] = NULL;
                     vmmprintfv("WARNING: CANNOT OPEN PAGE FILE #%i '%s'\n", i, ctxMain->cfg.szPageFile[i]);
                 } else {
                     vmmprintfvv("Successfully opened page file #%i '%s'\n", i, ctxMain->cfg.szPageFile[i]);
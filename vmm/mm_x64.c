@@ -211,32 +211,51 @@ BOOL MmX64_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
     return TRUE;
 }
 
-_Success_(return)
-BOOL MmX64_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa)
+DWORD MmX64_Virt2PhysStep(_In_ PVMMOB_MEM pObPT, _In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD pqw)
 {
     QWORD pte, i, qwMask;
-    PVMMOB_MEM pObPTEs;
-    if(iPML == (BYTE)-1) { iPML = 4; }
-    pObPTEs = VmmTlbGetPageTable(paPT & 0x0000fffffffff000, FALSE);
-    if(!pObPTEs) { return FALSE; }
+    *pqw = 0;
     i = 0x1ff & (va >> MMX64_PAGETABLEMAP_PML_REGION_SIZE[iPML]);
-    pte = pObPTEs->pqw[i];
-    Ob_DECREF(pObPTEs);
+    pte = pObPT->pqw[i];
     if(!MMX64_PTE_IS_VALID(pte, iPML)) {
-        if(iPML == 1) { *ppa = pte; }                       // NOT VALID
-        return FALSE;
+        if(iPML == 1) { *pqw = pte; }                       // NOT VALID
+        return VMM_VIRT2PHYS_STEP_FAIL;
     }
-    if(fUserOnly && !(pte & 0x04)) { return FALSE; }        // SUPERVISOR PAGE & USER MODE REQ
-    if(pte & 0x000f000000000000) { return FALSE; }          // RESERVED
+    if(fUserOnly && !(pte & 0x04)) { return VMM_VIRT2PHYS_STEP_FAIL; }  // SUPERVISOR PAGE & USER MODE REQ
+    if(pte & 0x000f000000000000) { return VMM_VIRT2PHYS_STEP_FAIL; }    // RESERVED
     if((iPML == 1) || (pte & 0x80) /* PS */) {
-        if(iPML == 4) { return FALSE; }                     // NO SUPPORT IN PML4
+        if(iPML == 4) { return VMM_VIRT2PHYS_STEP_FAIL; }               // NO SUPPORT IN PML4
         qwMask = 0xffffffffffffffff << MMX64_PAGETABLEMAP_PML_REGION_SIZE[iPML];
-        *ppa = pte & 0x0000fffffffff000 & qwMask;           // MASK AWAY BITS FOR 4kB/2MB/1GB PAGES
+        *pqw = pte & 0x0000fffffffff000 & qwMask;           // MASK AWAY BITS FOR 4kB/2MB/1GB PAGES
         qwMask = qwMask ^ 0xffffffffffffffff;
-        *ppa = *ppa | (qwMask & va);                        // FILL LOWER ADDRESS BITS
-        return TRUE;
+        *pqw = *pqw | (qwMask & va);                        // FILL LOWER ADDRESS BITS
+        return VMM_VIRT2PHYS_STEP_SUCCESS;
     }
-    return MmX64_Virt2Phys(pte, fUserOnly, iPML - 1, va, ppa);
+    *pqw = pte;
+    return VMM_VIRT2PHYS_STEP_NEXT;
+}
+
+_Success_(return)
+BOOL MmX64_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa)
+{
+    QWORD qw;
+    DWORD dwStep;
+    PVMMOB_MEM pObPTEs;
+    if(iPML == (BYTE)-1) { iPML = 4; }
+    pObPTEs = VmmTlbGetPageTable(paPT & 0x0000fffffffff000, FALSE);
+    if(!pObPTEs) { return FALSE; }
+    dwStep = MmX64_Virt2PhysStep(pObPTEs, paPT, fUserOnly, iPML, va, &qw);
+    Ob_DECREF(pObPTEs);
+    if(dwStep == VMM_VIRT2PHYS_STEP_NEXT) {
+        return MmX64_Virt2Phys(qw, fUserOnly, iPML - 1, va, ppa);
+    }
+    if((dwStep == VMM_VIRT2PHYS_STEP_SUCCESS) || (iPML == 1)) { *ppa = qw; }
+    return dwStep == VMM_VIRT2PHYS_STEP_SUCCESS;
+}
+
+VOID MmX64_Virt2PhysBatch(_In_ PVMM_PROCESS pProcess, _In_ DWORD cVA, _In_reads_(cVA) PQWORD pqwVA, _Out_writes_(cVA) PQWORD pqwPA, _Out_writes_(cVA) PBOOL pfPA)
+{
+    VmmVirt2PhysBatch_DoWork(pProcess, 4, MmX64_Virt2PhysStep, cVA, pqwVA, pqwPA, pfPA);
 }
 
 VOID MmX64_Virt2PhysGetInformation_DoWork(_Inout_ PVMM_PROCESS pProcess, _Inout_ PVMM_VIRT2PHYS_INFORMATION pVirt2PhysInfo, _In_ BYTE iPML, _In_ QWORD PTEs[512])
@@ -340,6 +359,7 @@ VOID MmX64_Initialize()
     }
     ctxVmm->fnMemoryModel.pfnClose = MmX64_Close;
     ctxVmm->fnMemoryModel.pfnVirt2Phys = MmX64_Virt2Phys;
+    ctxVmm->fnMemoryModel.pfnVirt2PhysBatch = MmX64_Virt2PhysBatch;
     ctxVmm->fnMemoryModel.pfnVirt2PhysGetInformation = MmX64_Virt2PhysGetInformation;
     ctxVmm->fnMemoryModel.pfnPhys2VirtGetInformation = MmX64_Phys2VirtGetInformation;
     ctxVmm->fnMemoryModel.pfnPteMapInitialize = MmX64_PteMapInitialize;
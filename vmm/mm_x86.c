@@ -145,36 +145,60 @@ BOOL MmX86_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
     return TRUE;
 }
 
+DWORD MmX86_Virt2PhysStep(_In_ PVMMOB_MEM pObPT, _In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD pqw)
+{
+    DWORD pte, i;
+    *pqw = 0;
+    if(va > 0xffffffff) { return VMM_VIRT2PHYS_STEP_FAIL; }
+    i = 0x3ff & (va >> MMX86_PAGETABLEMAP_PML_REGION_SIZE[iPML]);
+    pte = pObPT->pdw[i];
+    if(!MMX86_PTE_IS_VALID(pte, iPML)) {
+        if(iPML == 1) { *pqw = pte; }                       // NOT VALID
+        return VMM_VIRT2PHYS_STEP_FAIL;
+    }
+    if(fUserOnly && !(pte & 0x04)) { return VMM_VIRT2PHYS_STEP_FAIL; }  // SUPERVISOR PAGE & USER MODE REQ
+    if((iPML == 2) && !(pte & 0x80) /* PS */) {
+        *pqw = pte;
+        return VMM_VIRT2PHYS_STEP_NEXT;
+    }
+    if(iPML == 1) { // 4kB PAGE
+        *pqw = pte & 0xfffff000;
+        return VMM_VIRT2PHYS_STEP_SUCCESS;
+    }
+    // 4MB PAGE
+    if(pte & 0x003e0000) { return VMM_VIRT2PHYS_STEP_FAIL; }            // RESERVED
+    *pqw = (((QWORD)(pte & 0x0001e000)) << (32 - 13)) + (pte & 0xffc00000) + (va & 0x003ff000);
+    return VMM_VIRT2PHYS_STEP_SUCCESS;
+}
+
 _Success_(return)
 BOOL MmX86_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa)
 {
-    DWORD pte, i;
+    QWORD qw;
+    DWORD dwStep;
     PVMMOB_MEM pObPTEs;
-    //PBYTE pbPTEs;
     if(va > 0xffffffff) { return FALSE; }
     if(paPT > 0xffffffff) { return FALSE; }
     if(iPML == (BYTE)-1) { iPML = 2; }
     pObPTEs = VmmTlbGetPageTable(paPT & 0xfffff000, FALSE);
     if(!pObPTEs) { return FALSE; }
-    i = 0x3ff & (va >> MMX86_PAGETABLEMAP_PML_REGION_SIZE[iPML]);
-    pte = pObPTEs->pdw[i];
+    dwStep = MmX86_Virt2PhysStep(pObPTEs, paPT, fUserOnly, iPML, va, &qw);
     Ob_DECREF(pObPTEs);
-    if(!MMX86_PTE_IS_VALID(pte, iPML)) {
-        if(iPML == 1) { *ppa = pte; }                       // NOT VALID
-        return FALSE;
+    if(dwStep == VMM_VIRT2PHYS_STEP_NEXT) {
+        return MmX86_Virt2Phys(qw, fUserOnly, 1, va, ppa);
     }
-    if(fUserOnly && !(pte & 0x04)) { return FALSE; }        // SUPERVISOR PAGE & USER MODE REQ
-    if((iPML == 2) && !(pte & 0x80) /* PS */) {
-        return MmX86_Virt2Phys(pte, fUserOnly, 1, va, ppa);
-    }
-    if(iPML == 1) { // 4kB PAGE
-        *ppa = pte & 0xfffff000;
-        return TRUE;
+    if((dwStep == VMM_VIRT2PHYS_STEP_SUCCESS) || (iPML == 1)) { *ppa = qw; }
+    return dwStep == VMM_VIRT2PHYS_STEP_SUCCESS;
+}
+
+VOID MmX86_Virt2PhysBatch(_In_ PVMM_PROCESS pProcess, _In_ DWORD cVA, _In_reads_(cVA) PQWORD pqwVA, _Out_writes_(cVA) PQWORD pqwPA, _Out_writes_(cVA) PBOOL pfPA)
+{
+    if(pProcess->paDTB > 0xffffffff) {
+        ZeroMemory(pqwPA, cVA * sizeof(QWORD));
+        ZeroMemory(pfPA, cVA * sizeof(BOOL));
+        return;
     }
-    // 4MB PAGE
-    if(pte & 0x003e0000) { return FALSE; }                  // RESERVED
-    *ppa = (((QWORD)(pte & 0x0001e000)) << (32 - 13)) + (pte & 0xffc00000) + (va & 0x003ff000);
-    return TRUE;
+    VmmVirt2PhysBatch_DoWork(pProcess, 2, MmX86_Virt2PhysStep, cVA, pqwVA, pqwPA, pfPA);
 }
 
 VOID MmX86_Virt2PhysGetInformation_DoWork(_Inout_ PVMM_PROCESS pProcess, _Inout_ PVMM_VIRT2PHYS_INFORMATION pVirt2PhysInfo, _In_ BYTE iPML, _In_ QWORD paPT)
@@ -281,6 +305,7 @@ VOID MmX86_Initialize()
     }
     ctxVmm->fnMemoryModel.pfnClose = MmX86_Close;
     ctxVmm->fnMemoryModel.pfnVirt2Phys = MmX86_Virt2Phys;
+    ctxVmm->fnMemoryModel.pfnVirt2PhysBatch = MmX86_Virt2PhysBatch;
     ctxVmm->fnMemoryModel.pfnVirt2PhysGetInformation = MmX86_Virt2PhysGetInformation;
     ctxVmm->fnMemoryModel.pfnPhys2VirtGetInformation = MmX86_Phys2VirtGetInformation;
     ctxVmm->fnMemoryModel.pfnPteMapInitialize = MmX86_PteMapInitialize;
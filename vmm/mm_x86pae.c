@@ -196,47 +196,62 @@ BOOL MmX86PAE_PteMapInitialize(_In_ PVMM_PROCESS pProcess)
     return TRUE;
 }
 
-_Success_(return)
-BOOL MmX86PAE_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa)
+DWORD MmX86PAE_Virt2PhysStep(_In_ PVMMOB_MEM pObPT, _In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD pqw)
 {
-    PBYTE pbPTEs;
     QWORD pte, i, qwMask;
-    PVMMOB_MEM pObPTEs;
-    if(va > 0xffffffff) { return FALSE; }
-    if(iPML == (BYTE)-1) { iPML = 3; }
-    pObPTEs = VmmTlbGetPageTable(paPT & 0x0000fffffffff000, FALSE);
-    if(!pObPTEs) { return FALSE; }
+    *pqw = 0;
+    if(va > 0xffffffff) { return VMM_VIRT2PHYS_STEP_FAIL; }
     i = 0x1ff & (va >> MMX86PAE_PAGETABLEMAP_PML_REGION_SIZE[iPML]);
     if(iPML == 3) {
         // PDPT
-        if(i > 3) {                                         // MAX 4 ENTRIES IN PDPT
-            Ob_DECREF(pObPTEs);
-            return FALSE;
-        }                     
-        pbPTEs = pObPTEs->pb + (paPT & 0xfe0);              // ADJUST PDPT TO 32-BYTE BOUNDARY
-        pte = ((PQWORD)pbPTEs)[i];
-        Ob_DECREF(pObPTEs);
-        if(!(pte & 0x01)) { return FALSE; }                 // NOT VALID
-        if(pte & 0xffff0000000001e6) { return FALSE; }      // RESERVED BITS IN PDPTE
-        return MmX86PAE_Virt2Phys(pte, fUserOnly, 2, va, ppa);
+        if(i > 3) { return VMM_VIRT2PHYS_STEP_FAIL; }                   // MAX 4 ENTRIES IN PDPT
+        pte = ((PQWORD)(pObPT->pb + (paPT & 0xfe0)))[i];    // ADJUST PDPT TO 32-BYTE BOUNDARY
+        if(!(pte & 0x01)) { return VMM_VIRT2PHYS_STEP_FAIL; }           // NOT VALID
+        if(pte & 0xffff0000000001e6) { return VMM_VIRT2PHYS_STEP_FAIL; } // RESERVED BITS IN PDPTE
+        *pqw = pte;
+        return VMM_VIRT2PHYS_STEP_NEXT;
     }
     // PT or PD
-    pte = pObPTEs->pqw[i];
-    Ob_DECREF(pObPTEs);
+    pte = pObPT->pqw[i];
     if(!MMX86PAE_PTE_IS_VALID(pte, iPML)) {
-        if(iPML == 1) { *ppa = pte; }                       // NOT VALID
-        return FALSE;
+        if(iPML == 1) { *pqw = pte; }                       // NOT VALID
+        return VMM_VIRT2PHYS_STEP_FAIL;
     }
-    if(fUserOnly && !(pte & 0x04)) { return FALSE; }        // SUPERVISOR PAGE & USER MODE REQ
-    if(pte & 0x000f000000000000) { return FALSE; }          // RESERVED
+    if(fUserOnly && !(pte & 0x04)) { return VMM_VIRT2PHYS_STEP_FAIL; }  // SUPERVISOR PAGE & USER MODE REQ
+    if(pte & 0x000f000000000000) { return VMM_VIRT2PHYS_STEP_FAIL; }    // RESERVED
     if((iPML == 1) || (pte & 0x80) /* PS */) {
         qwMask = 0xffffffffffffffff << MMX86PAE_PAGETABLEMAP_PML_REGION_SIZE[iPML];
-        *ppa = pte & 0x0000fffffffff000 & qwMask;           // MASK AWAY BITS FOR 4kB/2MB/1GB PAGES
+        *pqw = pte & 0x0000fffffffff000 & qwMask;           // MASK AWAY BITS FOR 4kB/2MB/1GB PAGES
         qwMask = qwMask ^ 0xffffffffffffffff;
-        *ppa = *ppa | (qwMask & va);                        // FILL LOWER ADDRESS BITS
-        return TRUE;
+        *pqw = *pqw | (qwMask & va);                        // FILL LOWER ADDRESS BITS
+        return VMM_VIRT2PHYS_STEP_SUCCESS;
+    }
+    *pqw = pte;
+    return VMM_VIRT2PHYS_STEP_NEXT;
+}
+
+_Success_(return)
+BOOL MmX86PAE_Virt2Phys(_In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa)
+{
+    QWORD qw;
+    DWORD dwStep;
+    PVMMOB_MEM pObPTEs;
+    if(va > 0xffffffff) { return FALSE; }
+    if(iPML == (BYTE)-1) { iPML = 3; }
+    pObPTEs = VmmTlbGetPageTable(paPT & 0x0000fffffffff000, FALSE);
+    if(!pObPTEs) { return FALSE; }
+    dwStep = MmX86PAE_Virt2PhysStep(pObPTEs, paPT, fUserOnly, iPML, va, &qw);
+    Ob_DECREF(pObPTEs);
+    if(dwStep == VMM_VIRT2PHYS_STEP_NEXT) {
+        return MmX86PAE_Virt2Phys(qw, fUserOnly, iPML - 1, va, ppa);
     }
-    return MmX86PAE_Virt2Phys(pte, fUserOnly, 1, va, ppa);
+    if((dwStep == VMM_VIRT2PHYS_STEP_SUCCESS) || (iPML == 1)) { *ppa = qw; }
+    return dwStep == VMM_VIRT2PHYS_STEP_SUCCESS;
+}
+
+VOID MmX86PAE_Virt2PhysBatch(_In_ PVMM_PROCESS pProcess, _In_ DWORD cVA, _In_reads_(cVA) PQWORD pqwVA, _Out_writes_(cVA) PQWORD pqwPA, _Out_writes_(cVA) PBOOL pfPA)
+{
+    VmmVirt2PhysBatch_DoWork(pProcess, 3, MmX86PAE_Virt2PhysStep, cVA, pqwVA, pqwPA, pfPA);
 }
 
 VOID MmX86PAE_Virt2PhysGetInformation_DoWork(_Inout_ PVMM_PROCESS pProcess, _Inout_ PVMM_VIRT2PHYS_INFORMATION pVirt2PhysInfo, _In_ BYTE iPML, _In_ QWORD PTEs[512])
@@ -355,6 +370,7 @@ VOID MmX86PAE_Initialize()
     }
     ctxVmm->fnMemoryModel.pfnClose = MmX86PAE_Close;
     ctxVmm->fnMemoryModel.pfnVirt2Phys = MmX86PAE_Virt2Phys;
+    ctxVmm->fnMemoryModel.pfnVirt2PhysBatch = MmX86PAE_Virt2PhysBatch;
     ctxVmm->fnMemoryModel.pfnVirt2PhysGetInformation = MmX86PAE_Virt2PhysGetInformation;
     ctxVmm->fnMemoryModel.pfnPhys2VirtGetInformation = MmX86PAE_Phys2VirtGetInformation;
     ctxVmm->fnMemoryModel.pfnPteMapInitialize = MmX86PAE_PteMapInitialize;
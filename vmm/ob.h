@@ -24,10 +24,14 @@ typedef unsigned __int64                QWORD, *PQWORD;
 #define OB_TAG_MAP_USER                 'Musr'
 #define OB_TAG_MAP_NET                  'Mnet'
 #define OB_TAG_MAP_PFN                  'Mpfn'
+#define OB_TAG_MM_MEMCOMPRESS_CACHE     'MmCc'
+#define OB_TAG_MM_MEMCOMPRESS_STORE     'MmCs'
+#define OB_TAG_MM_PAGED_BATCH           'MmPb'
 #define OB_TAG_MOD_MINIDUMP_CTX         'mMDx'
 #define OB_TAG_OBJ_ERROR                'Oerr'
 #define OB_TAG_OBJ_FILE                 'Ofil'
 #define OB_TAG_PDB_ENTRY                'PdbE'
+#define OB_TAG_PDB_PROFILE              'PdbP'
 #define OB_TAG_PFN_CONTEXT              'PfnC'
 #define OB_TAG_PFN_PROC_TABLE           'PfnT'
 #define OB_TAG_REG_HIVE                 'Rhve'
@@ -37,6 +41,8 @@ typedef unsigned __int64                QWORD, *PQWORD;
 #define OB_TAG_VMM_PROCESS_CLONE        'PsC_'
 #define OB_TAG_VMM_PROCESS_PERSISTENT   'PsSt'
 #define OB_TAG_VMM_PROCESSTABLE         'PsTb'
+#define OB_TAG_VMM_READASYNC            'RdAs'
+#define OB_TAG_VMM_WORK_GROUP           'WkGr'
 #define OB_TAG_VMMVFS_DUMPCONTEXT       'CDmp'
 
 // ----------------------------------------------------------------------------
@@ -10,6 +10,7 @@
 #include "pe.h"
 #include "util.h"
 #include "vmmwininit.h"
+#include "version.h"
 #include <dbghelp.h>
 #include <winreg.h>
 #include <io.h>
@@ -30,8 +31,10 @@ typedef struct tdPDB_ENTRY {
     DWORD cbModuleSize;
     // load data below
     BOOL fLoadFailed;
+    BOOL fDbgHelpFailed;
     LPSTR szPath;
     QWORD qwLoadAddress;
+    struct tdPDB_NATIVE *pNative;
 } PDB_ENTRY, *PPDB_ENTRY;
 
 const LPSTR szVMMWIN_PDB_FUNCTIONS[] = {
@@ -104,8 +107,1040 @@ DWORD PDB_HashModuleName(_In_ LPSTR szModuleName)
     return dwHash;
 }
 
+//-----------------------------------------------------------------------------
+// NATIVE MSF/PDB PARSER BELOW:
+// Parse the type (TPI), debug info (DBI) and symbol record streams of a local
+// .pdb file once into hash tables. Lookups against the parsed tables are done
+// without taking the PDB lock. dbghelp.dll is only used to locate/download the
+// .pdb and as a fallback for queries not covered by the native tables.
+//-----------------------------------------------------------------------------
+
+#define PDB_NATIVE_MSF_MAGIC            "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0"
+#define PDB_NATIVE_STREAM_PDB           1
+#define PDB_NATIVE_STREAM_TPI           2
+#define PDB_NATIVE_STREAM_DBI           3
+#define PDB_NATIVE_DBGHDR_SECTIONHDR    5
+#define PDB_NATIVE_MAX_FILE_SIZE        0x40000000
+#define PDB_NATIVE_TPI_TYPES_MAX        0x01000000
+
+#define LF_FIELDLIST                    0x1203
+#define LF_BCLASS                       0x1400
+#define LF_VBCLASS                      0x1401
+#define LF_IVBCLASS                     0x1402
+#define LF_INDEX                        0x1404
+#define LF_VFUNCTAB                     0x1409
+#define LF_FRIENDCLS                    0x140b
+#define LF_ENUMERATE                    0x1502
+#define LF_CLASS                        0x1504
+#define LF_STRUCTURE                    0x1505
+#define LF_UNION                        0x1506
+#define LF_FRIENDFCN                    0x150c
+#define LF_MEMBER                       0x150d
+#define LF_STMEMBER                     0x150e
+#define LF_METHOD                       0x150f
+#define LF_NESTTYPE                     0x1510
+#define LF_ONEMETHOD                    0x1511
+#define LF_INTERFACE                    0x1519
+#define LF_CHAR                         0x8000
+#define LF_SHORT                        0x8001
+#define LF_USHORT                       0x8002
+#define LF_LONG                         0x8003
+#define LF_ULONG                        0x8004
+#define LF_QUADWORD                     0x8009
+#define LF_UQUADWORD                    0x800a
+#define CV_PROP_FWDREF                  0x0080
+
+#define S_LDATA32                       0x110c
+#define S_GDATA32                       0x110d
+#define S_PUB32                         0x110e
+
+typedef struct tdPDB_NATIVE_MSF_SUPERBLOCK {
+    CHAR szMagic[32];
+    DWORD cbBlock;
+    DWORD iFreeBlockMap;
+    DWORD cBlocks;
+    DWORD cbDirectory;
+    DWORD dwReserved;
+    DWORD iBlockMapAddr;
+} PDB_NATIVE_MSF_SUPERBLOCK, *PPDB_NATIVE_MSF_SUPERBLOCK;
+
+typedef struct tdPDB_NATIVE_INFO_HEADER {
+    DWORD dwVersion;
+    DWORD dwSignature;
+    DWORD dwAge;
+    BYTE pbGUID[16];
+} PDB_NATIVE_INFO_HEADER, *PPDB_NATIVE_INFO_HEADER;
+
+typedef struct tdPDB_NATIVE_TPI_HEADER {
+    DWORD dwVersion;
+    DWORD cbHeader;
+    DWORD tiBegin;
+    DWORD tiEnd;
+    DWORD cbTypeRecord;
+} PDB_NATIVE_TPI_HEADER, *PPDB_NATIVE_TPI_HEADER;
+
+typedef struct tdPDB_NATIVE_DBI_HEADER {
+    DWORD dwVersionSignature;
+    DWORD dwVersionHeader;
+    DWORD dwAge;
+    WORD iGlobalStream;
+    WORD wBuildNumber;
+    WORD iPublicStream;
+    WORD wPdbDllVersion;
+    WORD iSymRecordStream;
+    WORD wPdbDllRbld;
+    DWORD cbModInfo;
+    DWORD cbSectionContribution;
+    DWORD cbSectionMap;
+    DWORD cbSourceInfo;
+    DWORD cbTypeServerMap;
+    DWORD dwMFCTypeServerIndex;
+    DWORD cbOptionalDbgHeader;
+    DWORD cbECSubstream;
+    WORD wFlags;
+    WORD wMachine;
+    DWORD dwPadding;
+} PDB_NATIVE_DBI_HEADER, *PPDB_NATIVE_DBI_HEADER;
+
+typedef struct tdPDB_NATIVE_MSF {
+    PBYTE pbFile;
+    QWORD cbFile;
+    DWORD cbBlock;
+    DWORD cStreams;
+    PDWORD pdwDirectory;
+    PDWORD pdwStreamSize;
+    PDWORD poStreamBlocks;      // per stream: index into pdwDirectory of the 1st block number.
+} PDB_NATIVE_MSF, *PPDB_NATIVE_MSF;
+
+typedef struct tdPDB_NATIVE_ENTRY {
+    DWORD dwHash;
+    DWORD iNext;                // 1-based index of next entry in hash chain; 0 = end.
+    DWORD oszName;              // offset of name relative to table pbNameBase.
+    DWORD dwValue;              // symbol: rva, type: size.
+    DWORD tiFieldList;          // type: type index of field list.
+} PDB_NATIVE_ENTRY, *PPDB_NATIVE_ENTRY;
+
+typedef struct tdPDB_NATIVE_TABLE {
+    DWORD c;
+    DWORD dwBucketMask;
+    PDWORD piBucket;            // 1-based index of first entry in hash chain; 0 = empty.
+    PPDB_NATIVE_ENTRY pe;
+    PBYTE pbNameBase;
+} PDB_NATIVE_TABLE, *PPDB_NATIVE_TABLE;
+
+typedef struct tdPDB_NATIVE {
+    PDB_NATIVE_TABLE Sym;       // symbols sorted by rva.
+    PDB_NATIVE_TABLE Type;      // udt (struct/class/union) types.
+    PBYTE pbSymName;
+    PBYTE pbTpi;
+    DWORD cbTpi;
+    DWORD tiBegin;
+    DWORD cTypeRecord;
+    PDWORD poTypeRecord;        // per type index: offset of record in pbTpi.
+} PDB_NATIVE, *PPDB_NATIVE;
+
+/*
+* Case-insensitive hash of a symbol/type name (dbghelp is initialized with
+* SYMOPT_CASE_INSENSITIVE - native lookups behave the same).
+*/
+DWORD PDB_Native_HashName(_In_ LPCSTR sz)
+{
+    CHAR c;
+    DWORD dwHash = 0;
+    while((c = *sz++)) {
+        if((c >= 'a') && (c <= 'z')) { c -= 'a' - 'A'; }
+        dwHash = ((dwHash >> 13) | (dwHash << 19)) + c;
+    }
+    return dwHash;
+}
+
+VOID PDB_Native_Free(_In_opt_ PPDB_NATIVE pNative)
+{
+    if(pNative) {
+        LocalFree(pNative->Sym.piBucket);
+        LocalFree(pNative->Sym.pe);
+        LocalFree(pNative->Type.piBucket);
+        LocalFree(pNative->Type.pe);
+        LocalFree(pNative->pbSymName);
+        LocalFree(pNative->pbTpi);
+        LocalFree(pNative->poTypeRecord);
+        LocalFree(pNative);
+    }
+}
+
+/*
+* Build the hash buckets of a table. Entries are chained in ascending order so
+* that the 1st entry in the table wins if the same name exists multiple times.
+* -- pt
+* -- return
+*/
+_Success_(return)
+BOOL PDB_Native_TableBuild(_Inout_ PPDB_NATIVE_TABLE pt)
+{
+    DWORD i, cBucket = 0x10, iBucket;
+    while(cBucket < 2 * pt->c) { cBucket <<= 1; }
+    if(!(pt->piBucket = LocalAlloc(LMEM_ZEROINIT, cBucket * sizeof(DWORD)))) { return FALSE; }
+    pt->dwBucketMask = cBucket - 1;
+    for(i = pt->c; i; i--) {
+        iBucket = pt->pe[i - 1].dwHash & pt->dwBucketMask;
+        pt->pe[i - 1].iNext = pt->piBucket[iBucket];
+        pt->piBucket[iBucket] = i;
+    }
+    return TRUE;
+}
+
+/*
+* Retrieve a table entry by its (case-insensitive) name.
+* -- pt
+* -- szName
+* -- return = the entry on success, NULL on fail.
+*/
+PPDB_NATIVE_ENTRY PDB_Native_TableGet(_In_ PPDB_NATIVE_TABLE pt, _In_ LPCSTR szName)
+{
+    PPDB_NATIVE_ENTRY pe;
+    DWORD dwHash = PDB_Native_HashName(szName);
+    DWORD i = pt->piBucket[dwHash & pt->dwBucketMask];
+    while(i) {
+        pe = pt->pe + i - 1;
+        if((pe->dwHash == dwHash) && !_stricmp(szName, (LPSTR)(pt->pbNameBase + pe->oszName))) {
+            return pe;
+        }
+        i = pe->iNext;
+    }
+    return NULL;
+}
+
+/*
+* Read a MSF stream into a newly allocated contiguous buffer.
+* CALLER LocalFree: return
+* -- pMsf
+* -- iStream
+* -- pcbStream
+* -- return
+*/
+_Success_(return != NULL)
+PBYTE PDB_Native_MsfStreamRead(_In_ PPDB_NATIVE_MSF pMsf, _In_ DWORD iStream, _Out_ PDWORD pcbStream)
+{
+    PBYTE pb;
+    DWORD i, cb, cBlocks, iBlock;
+    if(iStream >= pMsf->cStreams) { return NULL; }
+    cb = pMsf->pdwStreamSize[iStream];
+    if(!cb) { return NULL; }
+    if(!(pb = LocalAlloc(0, cb))) { return NULL; }
+    cBlocks = (cb + pMsf->cbBlock - 1) / pMsf->cbBlock;
+    for(i = 0; i < cBlocks; i++) {
+        iBlock = pMsf->pdwDirectory[pMsf->poStreamBlocks[iStream] + i];
+        if(((QWORD)iBlock + 1) * pMsf->cbBlock > pMsf->cbFile) {
+            LocalFree(pb);
+            return NULL;
+        }
+        memcpy(pb + i * pMsf->cbBlock, pMsf->pbFile + (QWORD)iBlock * pMsf->cbBlock, min(pMsf->cbBlock, cb - i * pMsf->cbBlock));
+    }
+    *pcbStream = cb;
+    return pb;
+}
+
+/*
+* Parse the MSF super block and stream directory.
+* -- pMsf = with pbFile/cbFile set by caller.
+* -- return
+*/
+_Success_(return)
+BOOL PDB_Native_MsfInitialize(_Inout_ PPDB_NATIVE_MSF pMsf)
+{
+    PPDB_NATIVE_MSF_SUPERBLOCK pSB = (PPDB_NATIVE_MSF_SUPERBLOCK)pMsf->pbFile;
+    PDWORD pdwBlockMap;
+    DWORD i, o, cdw, cDirBlocks, iBlock;
+    if(pMsf->cbFile < 0x1000) { return FALSE; }
+    if(memcmp(pSB->szMagic, PDB_NATIVE_MSF_MAGIC, sizeof(PDB_NATIVE_MSF_MAGIC))) { return FALSE; }
+    pMsf->cbBlock = pSB->cbBlock;
+    if((pMsf->cbBlock != 0x200) && (pMsf->cbBlock != 0x400) && (pMsf->cbBlock != 0x800) && (pMsf->cbBlock != 0x1000)) { return FALSE; }
+    if((QWORD)pSB->cBlocks * pMsf->cbBlock > pMsf->cbFile) { return FALSE; }
+    if(((QWORD)pSB->iBlockMapAddr + 1) * pMsf->cbBlock > pMsf->cbFile) { return FALSE; }
+    // 1: assemble stream directory from the blocks listed in the block map.
+    //    the block map is a single block - PDBs with a stream directory too
+    //    large for its block list to fit in one block are not supported.
+    cDirBlocks = (pSB->cbDirectory + pMsf->cbBlock - 1) / pMsf->cbBlock;
+    if(!cDirBlocks) { return FALSE; }
+    if(cDirBlocks * sizeof(DWORD) > pMsf->cbBlock) {
+        vmmprintfv_fn("PDB block map spans multiple blocks - not supported.\n");
+        return FALSE;
+    }
+    if(!(pMsf->pdwDirectory = LocalAlloc(0, cDirBlocks * pMsf->cbBlock))) { return FALSE; }
+    pdwBlockMap = (PDWORD)(pMsf->pbFile + (QWORD)pSB->iBlockMapAddr * pMsf->cbBlock);
+    for(i = 0; i < cDirBlocks; i++) {
+        iBlock = pdwBlockMap[i];
+        if(((QWORD)iBlock + 1) * pMsf->cbBlock > pMsf->cbFile) { return FALSE; }
+        memcpy((PBYTE)pMsf->pdwDirectory + i * pMsf->cbBlock, pMsf->pbFile + (QWORD)iBlock * pMsf->cbBlock, pMsf->cbBlock);
+    }
+    // 2: parse stream directory: [cStreams][cb stream 0..n][blocks stream 0..n]
+    cdw = pSB->cbDirectory / sizeof(DWORD);
+    pMsf->cStreams = pMsf->pdwDirectory[0];
+    if(!pMsf->cStreams || (pMsf->cStreams >= cdw)) { return FALSE; }
+    pMsf->pdwStreamSize = pMsf->pdwDirectory + 1;
+    if(!(pMsf->poStreamBlocks = LocalAlloc(0, pMsf->cStreams * sizeof(DWORD)))) { return FALSE; }
+    for(i = 0, o = 1 + pMsf->cStreams; i < pMsf->cStreams; i++) {
+        if(pMsf->pdwStreamSize[i] == (DWORD)-1) { pMsf->pdwStreamSize[i] = 0; }
+        pMsf->poStreamBlocks[i] = o;
+        o += (pMsf->pdwStreamSize[i] + pMsf->cbBlock - 1) / pMsf->cbBlock;
+        if(o > cdw) { return FALSE; }
+    }
+    return TRUE;
+}
+
+/*
+* Decode a CodeView numeric leaf.
+* -- pb
+* -- cb
+* -- pqw
+* -- return = number of bytes consumed, 0 on fail.
+*/
+DWORD PDB_Native_Numeric(_In_reads_(cb) PBYTE pb, _In_ DWORD cb, _Out_ PQWORD pqw)
+{
+    WORD wLeaf;
+    *pqw = 0;
+    if(cb < 2) { return 0; }
+    wLeaf = *(PWORD)pb;
+    if(wLeaf < LF_CHAR) {
+        *pqw = wLeaf;
+        return 2;
+    }
+    switch(wLeaf) {
+        case LF_CHAR:
+            if(cb < 3) { return 0; }
+            *pqw = (QWORD)(LONG64)*(PCHAR)(pb + 2);
+            return 3;
+        case LF_SHORT:
+            if(cb < 4) { return 0; }
+            *pqw = (QWORD)(LONG64)*(PSHORT)(pb + 2);
+            return 4;
+        case LF_USHORT:
+            if(cb < 4) { return 0; }
+            *pqw = *(PWORD)(pb + 2);
+            return 4;
+        case LF_LONG:
+            if(cb < 6) { return 0; }
+            *pqw = (QWORD)(LONG64)*(PLONG)(pb + 2);
+            return 6;
+        case LF_ULONG:
+            if(cb < 6) { return 0; }
+            *pqw = *(PDWORD)(pb + 2);
+            return 6;
+        case LF_QUADWORD:
+        case LF_UQUADWORD:
+            if(cb < 10) { return 0; }
+            *pqw = *(PQWORD)(pb + 2);
+            return 10;
+    }
+    return 0;
+}
+
+/*
+* Retrieve the type record for a type index.
+* -- pNative
+* -- ti
+* -- pwKind
+* -- pcbData
+* -- return = pointer to the record data following the kind, NULL on fail.
+*/
+PBYTE PDB_Native_TypeRecord(_In_ PPDB_NATIVE pNative, _In_ DWORD ti, _Out_ PWORD pwKind, _Out_ PDWORD pcbData)
+{
+    PBYTE pbRecord;
+    DWORD oRecord;
+    if((ti < pNative->tiBegin) || (ti - pNative->tiBegin >= pNative->cTypeRecord)) { return NULL; }
+    oRecord = pNative->poTypeRecord[ti - pNative->tiBegin];
+    if((QWORD)oRecord + 4 > pNative->cbTpi) { return NULL; }
+    pbRecord = pNative->pbTpi + oRecord;
+    if((*(PWORD)pbRecord < 2) || ((QWORD)oRecord + 2 + *(PWORD)pbRecord > pNative->cbTpi)) { return NULL; }
+    *pwKind = *(PWORD)(pbRecord + 2);
+    *pcbData = *(PWORD)pbRecord - 2;
+    return pbRecord + 4;
+}
+
+/*
+* Parse the TPI stream - index all type records and add all non forward
+* referenced struct/class/union types to the type table.
+* -- pNative
+* -- pMsf
+* -- return
+*/
+_Success_(return)
+BOOL PDB_Native_ParseTpi(_Inout_ PPDB_NATIVE pNative, _In_ PPDB_NATIVE_MSF pMsf)
+{
+    PPDB_NATIVE_TPI_HEADER pHdr;
+    PPDB_NATIVE_ENTRY pe;
+    PBYTE pbData;
+    QWORD qwSize;
+    WORD wKind, wProperty;
+    DWORD i, o, oEnd, oName, cbData, cbNumeric, tiFieldList, cType;
+    if(!(pNative->pbTpi = PDB_Native_MsfStreamRead(pMsf, PDB_NATIVE_STREAM_TPI, &pNative->cbTpi))) { return FALSE; }
+    if(pNative->cbTpi < sizeof(PDB_NATIVE_TPI_HEADER)) { return FALSE; }
+    pHdr = (PPDB_NATIVE_TPI_HEADER)pNative->pbTpi;
+    if((pHdr->cbHeader > pNative->cbTpi) || (pHdr->tiEnd < pHdr->tiBegin) || (pHdr->cbTypeRecord > pNative->cbTpi - pHdr->cbHeader)) { return FALSE; }
+    // type count is bounded by the record data - each record is >= 4 bytes.
+    cType = min(pHdr->tiEnd - pHdr->tiBegin, pHdr->cbTypeRecord / 4);
+    if(!cType || (cType > PDB_NATIVE_TPI_TYPES_MAX)) { return FALSE; }
+    pNative->tiBegin = pHdr->tiBegin;
+    if(!(pNative->poTypeRecord = LocalAlloc(0, cType * sizeof(DWORD)))) { return FALSE; }
+    if(!(pNative->Type.pe = LocalAlloc(0, cType * sizeof(PDB_NATIVE_ENTRY)))) { return FALSE; }
+    pNative->Type.pbNameBase = pNative->pbTpi;
+    o = pHdr->cbHeader;
+    oEnd = pHdr->cbHeader + pHdr->cbTypeRecord;
+    for(i = 0; (i < cType) && (o + 4 <= oEnd); i++) {
+        pNative->poTypeRecord[i] = o;
+        cbData = *(PWORD)(pNative->pbTpi + o) - 2;
+        wKind = *(PWORD)(pNative->pbTpi + o + 2);
+        pbData = pNative->pbTpi + o + 4;
+        o += 2 + *(PWORD)(pNative->pbTpi + o);
+        if((o > oEnd) || (cbData > 0xffff)) { break; }
+        switch(wKind) {
+            case LF_CLASS:
+            case LF_STRUCTURE:
+            case LF_INTERFACE:
+                if(cbData < 18) { continue; }
+                oName = 16;
+                break;
+            case LF_UNION:
+                if(cbData < 10) { continue; }
+                oName = 8;
+                break;
+            default:
+                continue;
+        }
+        wProperty = *(PWORD)(pbData + 2);
+        tiFieldList = *(PDWORD)(pbData + 4);
+        if(wProperty & CV_PROP_FWDREF) { continue; }
+        if(!(cbNumeric = PDB_Native_Numeric(pbData + oName, cbData - oName, &qwSize))) { continue; }
+        oName += cbNumeric;
+        if((oName >= cbData) || !memchr(pbData + oName, 0, cbData - oName) || (qwSize > 0xffffffff)) { continue; }
+        pe = pNative->Type.pe + pNative->Type.c++;
+        pe->oszName = (DWORD)(pbData + oName - pNative->pbTpi);
+        pe->dwHash = PDB_Native_HashName((LPSTR)(pbData + oName));
+        pe->dwValue = (DWORD)qwSize;
+        pe->tiFieldList = tiFieldList;
+    }
+    pNative->cTypeRecord = i;
+    return PDB_Native_TableBuild(&pNative->Type);
+}
+
+/*
+* Remove x86 C name decoration from a public symbol name to match the names
+* returned by dbghelp with SYMOPT_UNDNAME: _name, _name@N, @name@N.
+* -- szName
+* -- szBuffer = receives the undecorated name, at least strlen(szName) + 1.
+*/
+VOID PDB_Native_UndecorateX86(_In_ LPSTR szName, _Out_ LPSTR szBuffer)
+{
+    DWORD i, cch;
+    if((szName[0] == '_') || (szName[0] == '@')) {
+        szName++;
+    }
+    strcpy_s(szBuffer, strlen(szName) + 1, szName);
+    for(i = cch = (DWORD)strlen(szBuffer); i; i--) {
+        if(szBuffer[i - 1] == '@') {
+            if((i < cch) && (i > 1)) { szBuffer[i - 1] = 0; }
+            break;
+        }
+        if((szBuffer[i - 1] < '0') || (szBuffer[i - 1] > '9')) { break; }
+    }
+}
+
+/*
+* qsort comparator - sort symbols by rva.
+*/
+int PDB_Native_CmpSymbol(const void *v1, const void *v2)
+{
+    DWORD dw1 = ((PPDB_NATIVE_ENTRY)v1)->dwValue;
+    DWORD dw2 = ((PPDB_NATIVE_ENTRY)v2)->dwValue;
+    return (dw1 < dw2) ? -1 : ((dw1 > dw2) ? 1 : 0);
+}
+
+/*
+* Parse the DBI stream for section headers and the symbol record stream for
+* public and global data symbols. Symbol addresses are converted into rva.
+* -- pNative
+* -- pMsf
+* -- return
+*/
+_Success_(return)
+BOOL PDB_Native_ParseSymbols(_Inout_ PPDB_NATIVE pNative, _In_ PPDB_NATIVE_MSF pMsf)
+{
+    BOOL fResult = FALSE, fX86;
+    PPDB_NATIVE_DBI_HEADER pDbi;
+    PIMAGE_SECTION_HEADER pSections;
+    PPDB_NATIVE_ENTRY pe;
+    PBYTE pbDbi = NULL, pbSecHdr = NULL, pbSymRec = NULL, pbRecord;
+    DWORD o, oName, cbDbi, cbSecHdr = 0, cbSymRec, cSections, cbRecord, oSymName = 0, dwOffset, cSymMax;
+    WORD wKind, wSegment, iSecHdrStream;
+    LPSTR szName;
+    // 1: dbi header & section headers
+    if(!(pbDbi = PDB_Native_MsfStreamRead(pMsf, PDB_NATIVE_STREAM_DBI, &cbDbi)) || (cbDbi < sizeof(PDB_NATIVE_DBI_HEADER))) { goto fail; }
+    pDbi = (PPDB_NATIVE_DBI_HEADER)pbDbi;
+    fX86 = (pDbi->wMachine == IMAGE_FILE_MACHINE_I386);
+    o = sizeof(PDB_NATIVE_DBI_HEADER);
+    o += pDbi->cbModInfo + pDbi->cbSectionContribution + pDbi->cbSectionMap + pDbi->cbSourceInfo + pDbi->cbTypeServerMap + pDbi->cbECSubstream;
+    if((o > cbDbi) || (pDbi->cbOptionalDbgHeader > cbDbi - o) || (pDbi->cbOptionalDbgHeader < (PDB_NATIVE_DBGHDR_SECTIONHDR + 1) * sizeof(WORD))) { goto fail; }
+    iSecHdrStream = *(PWORD)(pbDbi + o + PDB_NATIVE_DBGHDR_SECTIONHDR * sizeof(WORD));
+    if(!(pbSecHdr = PDB_Native_MsfStreamRead(pMsf, iSecHdrStream, &cbSecHdr))) { goto fail; }
+    pSections = (PIMAGE_SECTION_HEADER)pbSecHdr;
+    cSections = cbSecHdr / sizeof(IMAGE_SECTION_HEADER);
+    // 2: symbol records
+    if(!(pbSymRec = PDB_Native_MsfStreamRead(pMsf, pDbi->iSymRecordStream, &cbSymRec))) { goto fail; }
+    if(!(pNative->pbSymName = LocalAlloc(0, cbSymRec))) { goto fail; }
+    cSymMax = cbSymRec / 16 + 1;
+    if(!(pNative->Sym.pe = LocalAlloc(0, cSymMax * sizeof(PDB_NATIVE_ENTRY)))) { goto fail; }
+    pNative->Sym.pbNameBase = pNative->pbSymName;
+    for(o = 0; o + 4 <= cbSymRec; o += 2 + cbRecord) {
+        cbRecord = *(PWORD)(pbSymRec + o);
+        wKind = *(PWORD)(pbSymRec + o + 2);
+        pbRecord = pbSymRec + o + 4;
+        if((cbRecord < 2) || (o + 2 + cbRecord > cbSymRec) || (pNative->Sym.c >= cSymMax)) { break; }
+        if((wKind != S_PUB32) && (wKind != S_GDATA32) && (wKind != S_LDATA32)) { continue; }
+        // S_PUB32: [flags][offset][segment][name], S_[GL]DATA32: [type][offset][segment][name]
+        oName = 4 + 4 + 2;
+        if((cbRecord - 2 <= oName) || !memchr(pbRecord + oName, 0, cbRecord - 2 - oName)) { continue; }
+        dwOffset = *(PDWORD)(pbRecord + 4);
+        wSegment = *(PWORD)(pbRecord + 8);
+        if(!wSegment || (wSegment > cSections)) { continue; }
+        szName = (LPSTR)(pNative->pbSymName + oSymName);
+        if(fX86 && (wKind == S_PUB32)) {
+            PDB_Native_UndecorateX86((LPSTR)(pbRecord + oName), szName);
+        } else {
+            strcpy_s(szName, cbSymRec - oSymName, (LPSTR)(pbRecord + oName));
+        }
+        if(!szName[0]) { continue; }
+        pe = pNative->Sym.pe + pNative->Sym.c++;
+        pe->oszName = oSymName;
+        pe->dwHash = PDB_Native_HashName(szName);
+        pe->dwValue = pSections[wSegment - 1].VirtualAddress + dwOffset;
+        pe->tiFieldList = 0;
+        oSymName += (DWORD)strlen(szName) + 1;
+    }
+    // 3: sort by rva (for nearest symbol lookups) and build hash table.
+    qsort(pNative->Sym.pe, pNative->Sym.c, sizeof(PDB_NATIVE_ENTRY), PDB_Native_CmpSymbol);
+    fResult = pNative->Sym.c && PDB_Native_TableBuild(&pNative->Sym);
+fail:
+    LocalFree(pbDbi);
+    LocalFree(pbSecHdr);
+    LocalFree(pbSymRec);
+    return fResult;
+}
+
+/*
+* Load and parse a .pdb file from disk.
+* CALLER PDB_Native_Free: return
+* -- szPdbPath
+* -- pbGUID = expected GUID of the .pdb.
+* -- return
+*/
+_Success_(return != NULL)
+PPDB_NATIVE PDB_Native_Load(_In_ LPSTR szPdbPath, _In_reads_(16) PBYTE pbGUID)
+{
+    BOOL fResult = FALSE;
+    HANDLE hFile = INVALID_HANDLE_VALUE, hMap = NULL;
+    LARGE_INTEGER cbFile;
+    PDB_NATIVE_MSF Msf = { 0 };
+    PPDB_NATIVE pNative = NULL;
+    PBYTE pbInfo = NULL;
+    DWORD cbInfo;
+    hFile = CreateFileA(szPdbPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE) { goto fail; }
+    if(!GetFileSizeEx(hFile, &cbFile) || (cbFile.QuadPart > PDB_NATIVE_MAX_FILE_SIZE)) { goto fail; }
+    if(!(hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL))) { goto fail; }
+    if(!(Msf.pbFile = MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0))) { goto fail; }
+    Msf.cbFile = cbFile.QuadPart;
+    if(!PDB_Native_MsfInitialize(&Msf)) { goto fail; }
+    // verify the .pdb matches the expected guid.
+    if(!(pbInfo = PDB_Native_MsfStreamRead(&Msf, PDB_NATIVE_STREAM_PDB, &cbInfo)) || (cbInfo < sizeof(PDB_NATIVE_INFO_HEADER))) { goto fail; }
+    if(memcmp(((PPDB_NATIVE_INFO_HEADER)pbInfo)->pbGUID, pbGUID, 16)) { goto fail; }
+    if(!(pNative = LocalAlloc(LMEM_ZEROINIT, sizeof(PDB_NATIVE)))) { goto fail; }
+    fResult = PDB_Native_ParseTpi(pNative, &Msf) && PDB_Native_ParseSymbols(pNative, &Msf);
+fail:
+    LocalFree(pbInfo);
+    LocalFree(Msf.pdwDirectory);
+    LocalFree(Msf.poStreamBlocks);
+    if(Msf.pbFile) { UnmapViewOfFile(Msf.pbFile); }
+    if(hMap) { CloseHandle(hMap); }
+    if(hFile != INVALID_HANDLE_VALUE) { CloseHandle(hFile); }
+    if(!fResult) {
+        PDB_Native_Free(pNative);
+        return NULL;
+    }
+    return pNative;
+}
+
+/*
+* Retrieve the rva of a symbol from the native tables.
+*/
+_Success_(return)
+BOOL PDB_Native_GetSymbolOffset(_In_ PPDB_NATIVE pNative, _In_ LPSTR szSymbolName, _Out_ PDWORD pdwSymbolOffset)
+{
+    PPDB_NATIVE_ENTRY pe = PDB_Native_TableGet(&pNative->Sym, szSymbolName);
+    if(!pe || !pe->dwValue || (pe->dwValue >= 0x10000000)) { return FALSE; }
+    *pdwSymbolOffset = pe->dwValue;
+    return TRUE;
+}
+
+/*
+* Retrieve the closest symbol at or below an rva from the native tables.
+*/
+_Success_(return)
+BOOL PDB_Native_GetSymbolFromOffset(_In_ PPDB_NATIVE pNative, _In_ DWORD dwSymbolOffset, _Out_writes_opt_(MAX_PATH) LPSTR szSymbolName, _Out_opt_ PDWORD pdwSymbolDisplacement)
+{
+    PPDB_NATIVE_ENTRY pe;
+    DWORD iLo = 0, iHi = pNative->Sym.c, iMid;
+    // binary search for the last entry with rva <= dwSymbolOffset.
+    while(iLo < iHi) {
+        iMid = (iLo + iHi) / 2;
+        if(pNative->Sym.pe[iMid].dwValue <= dwSymbolOffset) {
+            iLo = iMid + 1;
+        } else {
+            iHi = iMid;
+        }
+    }
+    if(!iLo) { return FALSE; }
+    pe = pNative->Sym.pe + iLo - 1;
+    if(szSymbolName) {
+        strncpy_s(szSymbolName, MAX_PATH, (LPSTR)(pNative->Sym.pbNameBase + pe->oszName), _TRUNCATE);
+    }
+    if(pdwSymbolDisplacement) {
+        *pdwSymbolDisplacement = dwSymbolOffset - pe->dwValue;
+    }
+    return TRUE;
+}
+
+/*
+* Retrieve the size of a struct/class/union type from the native tables.
+*/
+_Success_(return)
+BOOL PDB_Native_GetTypeSize(_In_ PPDB_NATIVE pNative, _In_ LPSTR szTypeName, _Out_ PDWORD pdwTypeSize)
+{
+    PPDB_NATIVE_ENTRY pe = PDB_Native_TableGet(&pNative->Type, szTypeName);
+    if(!pe || !pe->dwValue) { return FALSE; }
+    *pdwTypeSize = pe->dwValue;
+    return TRUE;
+}
+
+/*
+* Compare a narrow (pdb) member name with a wide member name - exact match.
+*/
+BOOL PDB_Native_NameEqualsW(_In_ LPSTR szName, _In_ LPWSTR wszName)
+{
+    while(*szName && ((WCHAR)(BYTE)*szName == *wszName)) {
+        szName++;
+        wszName++;
+    }
+    return !*szName && !*wszName;
+}
+
+/*
+* Retrieve the offset of a data member of a struct/class/union type from the
+* native tables by walking the field list of the type.
+*/
+_Success_(return)
+BOOL PDB_Native_GetTypeChildOffset(_In_ PPDB_NATIVE pNative, _In_ LPSTR szTypeName, _In_ LPWSTR wszTypeChildName, _Out_ PDWORD pdwTypeOffset)
+{
+    PPDB_NATIVE_ENTRY pe;
+    PBYTE pb;
+    QWORD qwOffset, qwDummy;
+    WORD wKind, wLeaf, wAttr;
+    DWORD o, cb, cbNumeric, ti, cFieldList = 0;
+    LPSTR szName;
+    if(!(pe = PDB_Native_TableGet(&pNative->Type, szTypeName))) { return FALSE; }
+    ti = pe->tiFieldList;
+    while(ti && (cFieldList++ < 0x100)) {
+        if(!(pb = PDB_Native_TypeRecord(pNative, ti, &wKind, &cb)) || (wKind != LF_FIELDLIST)) { return FALSE; }
+        ti = 0;
+        o = 0;
+        while(o + 2 <= cb) {
+            wLeaf = *(PWORD)(pb + o);
+            o += 2;
+            szName = NULL;
+            switch(wLeaf) {
+                case LF_MEMBER:         // [attr][type][numeric offset][name]
+                    if(o + 6 > cb) { return FALSE; }
+                    if(!(cbNumeric = PDB_Native_Numeric(pb + o + 6, cb - o - 6, &qwOffset))) { return FALSE; }
+                    o += 6 + cbNumeric;
+                    szName = (LPSTR)(pb + o);
+                    break;
+                case LF_STMEMBER:       // [attr][type][name]
+                case LF_NESTTYPE:       // [pad][type][name]
+                case LF_FRIENDFCN:      // [pad][type][name]
+                case LF_METHOD:         // [count][mlist][name]
+                    o += 6;
+                    szName = (LPSTR)(pb + o);
+                    break;
+                case LF_ONEMETHOD:      // [attr][type][vbaseoff if intro virtual][name]
+                    if(o + 6 > cb) { return FALSE; }
+                    wAttr = *(PWORD)(pb + o);
+                    o += ((((wAttr >> 2) & 7) == 4) || (((wAttr >> 2) & 7) == 6)) ? 10 : 6;
+                    szName = (LPSTR)(pb + o);
+                    break;
+                case LF_ENUMERATE:      // [attr][numeric value][name]
+                    if(!(cbNumeric = PDB_Native_Numeric(pb + o + 2, (o + 2 < cb) ? cb - o - 2 : 0, &qwDummy))) { return FALSE; }
+                    o += 2 + cbNumeric;
+                    szName = (LPSTR)(pb + o);
+                    break;
+                case LF_BCLASS:         // [attr][type][numeric offset]
+                    if(o + 6 > cb) { return FALSE; }
+                    if(!(cbNumeric = PDB_Native_Numeric(pb + o + 6, cb - o - 6, &qwDummy))) { return FALSE; }
+                    o += 6 + cbNumeric;
+                    break;
+                case LF_VBCLASS:        // [attr][btype][vbptype][numeric vbpoff][numeric vboff]
+                case LF_IVBCLASS:
+                    if(o + 10 > cb) { return FALSE; }
+                    if(!(cbNumeric = PDB_Native_Numeric(pb + o + 10, cb - o - 10, &qwDummy))) { return FALSE; }
+                    o += 10 + cbNumeric;
+                    if(!(cbNumeric = PDB_Native_Numeric(pb + o, (o < cb) ? cb - o : 0, &qwDummy))) { return FALSE; }
+                    o += cbNumeric;
+                    break;
+                case LF_VFUNCTAB:       // [pad][type]
+                case LF_FRIENDCLS:
+                    o += 6;
+                    break;
+                case LF_INDEX:          // [pad][type index of continuation field list]
+                    if(o + 6 > cb) { return FALSE; }
+                    ti = *(PDWORD)(pb + o + 2);
+                    o = cb;
+                    break;
+                default:
+                    return FALSE;
+            }
+            if(o > cb) { return FALSE; }
+            if(szName) {
+                if(!memchr(szName, 0, cb - o)) { return FALSE; }
+                if((wLeaf == LF_MEMBER) && PDB_Native_NameEqualsW(szName, wszTypeChildName)) {
+                    *pdwTypeOffset = (DWORD)qwOffset;
+                    return TRUE;
+                }
+                o += (DWORD)strlen(szName) + 1;
+            }
+            // skip LF_PAD alignment bytes
+            while((o < cb) && (pb[o] > 0xf0)) {
+                o += pb[o] & 0x0f;
+            }
+        }
+    }
+    return FALSE;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// KERNEL OFFSET PROFILE CACHE BELOW:
+// Offsets resolved from the kernel .pdb - and offsets fuzzed from memory - are
+// recorded in a small binary profile file in the local symbol cache keyed by
+// the kernel PDB_HashPdb(name, GUID, age). Subsequent analysis of memory from
+// the same kernel build answers these queries from the profile without having
+// to load the .pdb or re-run the offset fuzzers.
+//-----------------------------------------------------------------------------
+
+#define PDB_PROFILE_MAGIC               0x666f7250      // 'Prof'
+#define PDB_PROFILE_VERSION             ((VERSION_MAJOR << 24) | (VERSION_MINOR << 16) | (VERSION_REVISION << 8) | 1)
+#define PDB_PROFILE_MAX_FILE_SIZE       0x00100000
+#define PDB_PROFILE_QUERY_SYMBOL        1
+#define PDB_PROFILE_QUERY_TYPESIZE      2
+#define PDB_PROFILE_QUERY_TYPECHILD     3
+
+typedef struct tdPDB_PROFILE_FILE_HEADER {
+    DWORD dwMagic;
+    DWORD dwVersion;
+    QWORD qwPdbHash;
+    DWORD cEntries;
+    DWORD cbEntries;
+    // followed by cEntries of: [QWORD qwKey][DWORD cb][BYTE pb[cb]]
+} PDB_PROFILE_FILE_HEADER, *PPDB_PROFILE_FILE_HEADER;
+
+typedef struct tdPDB_PROFILE_CONTEXT {
+    QWORD qwPdbHash;
+    BOOL fLoaded;               // profile loaded from disk.
+    BOOL fDirty;                // profile updated since last flush.
+    CRITICAL_SECTION LockFlush;
+    POB_MAP pmObEntries;        // key -> POB_DATA
+    CHAR szPath[MAX_PATH];
+} PDB_PROFILE_CONTEXT, *PPDB_PROFILE_CONTEXT;
+
+VOID PDB_Initialize_InitialValues_LocalPath(_Out_writes_(MAX_PATH) LPSTR szLocal);
+BOOL PDB_Initialize_Async_Kernel_ScanForPdbInfo(_In_ PVMM_PROCESS pSystemProcess, _Out_ PPE_CODEVIEW_INFO pCodeViewInfo);
+
+/*
+* Load the profile file from disk into the profile context.
+* -- ctx
+*/
+VOID PDB_Profile_Load(_In_ PPDB_PROFILE_CONTEXT ctx)
+{
+    HANDLE hFile;
+    PBYTE pb = NULL;
+    DWORD i, o, cb, cbRead, cbEntry;
+    QWORD qwKey;
+    POB_DATA pObData;
+    PPDB_PROFILE_FILE_HEADER pHdr;
+    hFile = CreateFileA(ctx->szPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE) { return; }
+    cb = GetFileSize(hFile, NULL);
+    if((cb < sizeof(PDB_PROFILE_FILE_HEADER)) || (cb > PDB_PROFILE_MAX_FILE_SIZE)) { goto fail; }
+    if(!(pb = LocalAlloc(0, cb))) { goto fail; }
+    if(!ReadFile(hFile, pb, cb, &cbRead, NULL) || (cb != cbRead)) { goto fail; }
+    pHdr = (PPDB_PROFILE_FILE_HEADER)pb;
+    if((pHdr->dwMagic != PDB_PROFILE_MAGIC) || (pHdr->dwVersion != PDB_PROFILE_VERSION) || (pHdr->qwPdbHash != ctx->qwPdbHash)) { goto fail; }
+    if(pHdr->cbEntries != cb - sizeof(PDB_PROFILE_FILE_HEADER)) { goto fail; }
+    for(i = 0, o = sizeof(PDB_PROFILE_FILE_HEADER); i < pHdr->cEntries; i++) {
+        if(o + 12 > cb) { goto fail; }
+        qwKey = *(PQWORD)(pb + o);
+        cbEntry = *(PDWORD)(pb + o + 8);
+        o += 12;
+        if(cbEntry > cb - o) { goto fail; }
+        if(!(pObData = Ob_Alloc(OB_TAG_PDB_PROFILE, 0, sizeof(OB) + cbEntry, NULL, NULL))) { goto fail; }
+        memcpy(pObData->pb, pb + o, cbEntry);
+        ObMap_Push(ctx->pmObEntries, qwKey, pObData);
+        Ob_DECREF(pObData);
+        o += cbEntry;
+    }
+    ctx->fLoaded = TRUE;
+    vmmprintfv_fn("Offset profile loaded: %s [%i entries]\n", ctx->szPath, pHdr->cEntries);
+fail:
+    if(!ctx->fLoaded) {
+        ObMap_Clear(ctx->pmObEntries);
+    }
+    LocalFree(pb);
+    CloseHandle(hFile);
+}
+
+typedef struct tdPDB_PROFILE_SERIALIZE_CONTEXT {
+    PBYTE pb;
+    DWORD cb;
+    DWORD o;
+    DWORD c;
+} PDB_PROFILE_SERIALIZE_CONTEXT, *PPDB_PROFILE_SERIALIZE_CONTEXT;
+
+/*
+* ObMap_Filter callback: serialize a profile entry (or count its size if no
+* buffer is given).
+*/
+VOID PDB_Profile_Flush_SerializeCB(_In_ QWORD qwKey, _In_ POB_DATA pObData, _Inout_ PPDB_PROFILE_SERIALIZE_CONTEXT ctx)
+{
+    DWORD cbEntry = 12 + pObData->ObHdr.cbData;
+    if(ctx->pb && (ctx->o + cbEntry <= ctx->cb)) {
+        *(PQWORD)(ctx->pb + ctx->o) = qwKey;
+        *(PDWORD)(ctx->pb + ctx->o + 8) = pObData->ObHdr.cbData;
+        memcpy(ctx->pb + ctx->o + 12, pObData->pb, pObData->ObHdr.cbData);
+    }
+    ctx->o += cbEntry;
+    ctx->c++;
+}
+
+/*
+* Write the profile to disk if it has been updated. The profile is written to
+* a temporary file which then replaces the profile file - this allows multiple
+* concurrent instances to share the same symbol cache directory.
+*/
+VOID PDB_Profile_Flush()
+{
+    PPDB_PROFILE_CONTEXT ctx = (PPDB_PROFILE_CONTEXT)ctxVmm->pPdbProfile;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    PPDB_PROFILE_FILE_HEADER pHdr;
+    PDB_PROFILE_SERIALIZE_CONTEXT ctxS = { 0 };
+    CHAR szPathTmp[MAX_PATH];
+    DWORD cbWrite;
+    BOOL fResult;
+    if(!ctx || !ctx->fDirty) { return; }
+    EnterCriticalSection(&ctx->LockFlush);
+    if(!ctx->fDirty) { goto fail; }
+    ctx->fDirty = FALSE;
+    // 1: serialize
+    ctxS.o = sizeof(PDB_PROFILE_FILE_HEADER);
+    ObMap_Filter(ctx->pmObEntries, &ctxS, (VOID(*)(QWORD, PVOID, PVOID))PDB_Profile_Flush_SerializeCB);
+    if(ctxS.o > PDB_PROFILE_MAX_FILE_SIZE) { goto fail; }
+    ctxS.cb = ctxS.o;
+    ctxS.o = sizeof(PDB_PROFILE_FILE_HEADER);
+    ctxS.c = 0;
+    if(!(ctxS.pb = LocalAlloc(LMEM_ZEROINIT, ctxS.cb))) { goto fail; }
+    ObMap_Filter(ctx->pmObEntries, &ctxS, (VOID(*)(QWORD, PVOID, PVOID))PDB_Profile_Flush_SerializeCB);
+    if(ctxS.o > ctxS.cb) {
+        ctx->fDirty = TRUE;     // updated while serializing - retry on next flush
+        goto fail;
+    }
+    pHdr = (PPDB_PROFILE_FILE_HEADER)ctxS.pb;
+    pHdr->dwMagic = PDB_PROFILE_MAGIC;
+    pHdr->dwVersion = PDB_PROFILE_VERSION;
+    pHdr->qwPdbHash = ctx->qwPdbHash;
+    pHdr->cEntries = ctxS.c;
+    pHdr->cbEntries = ctxS.o - sizeof(PDB_PROFILE_FILE_HEADER);
+    // 2: write to temporary file and replace
+    _snprintf_s(szPathTmp, MAX_PATH, _TRUNCATE, "%s.%i.tmp", ctx->szPath, GetCurrentProcessId());
+    hFile = CreateFileA(szPathTmp, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE) { goto fail; }
+    fResult = WriteFile(hFile, ctxS.pb, ctxS.o, &cbWrite, NULL) && (ctxS.o == cbWrite);
+    CloseHandle(hFile);
+    fResult = fResult && MoveFileExA(szPathTmp, ctx->szPath, MOVEFILE_REPLACE_EXISTING);
+    if(!fResult) {
+        DeleteFileA(szPathTmp);
+        goto fail;
+    }
+    vmmprintfvv_fn("Offset profile written: %s [%i entries]\n", ctx->szPath, ctxS.c);
+fail:
+    LeaveCriticalSection(&ctx->LockFlush);
+    LocalFree(ctxS.pb);
+}
+
+/*
+* Retrieve a profile entry. The entry size must match exactly.
+* -- qwKey
+* -- pb
+* -- cb
+* -- return
+*/
+_Success_(return)
+BOOL PDB_Profile_Get(_In_ QWORD qwKey, _Out_writes_(cb) PBYTE pb, _In_ DWORD cb)
+{
+    PPDB_PROFILE_CONTEXT ctx = (PPDB_PROFILE_CONTEXT)ctxVmm->pPdbProfile;
+    POB_DATA pObData;
+    BOOL fResult = FALSE;
+    if(!ctx || !(pObData = ObMap_GetByKey(ctx->pmObEntries, qwKey))) { return FALSE; }
+    if(pObData->ObHdr.cbData == cb) {
+        memcpy(pb, pObData->pb, cb);
+        fResult = TRUE;
+    }
+    Ob_DECREF(pObData);
+    return fResult;
+}
+
+/*
+* Add or replace a profile entry.
+* -- qwKey
+* -- pb
+* -- cb
+*/
+VOID PDB_Profile_Put(_In_ QWORD qwKey, _In_reads_(cb) PBYTE pb, _In_ DWORD cb)
+{
+    PPDB_PROFILE_CONTEXT ctx = (PPDB_PROFILE_CONTEXT)ctxVmm->pPdbProfile;
+    POB_DATA pObData;
+    if(!ctx) { return; }
+    if((pObData = ObMap_GetByKey(ctx->pmObEntries, qwKey))) {
+        if((pObData->ObHdr.cbData == cb) && !memcmp(pObData->pb, pb, cb)) {
+            Ob_DECREF(pObData);
+            return;
+        }
+        Ob_DECREF(pObData);
+    }
+    if(!(pObData = Ob_Alloc(OB_TAG_PDB_PROFILE, 0, sizeof(OB) + cb, NULL, NULL))) { return; }
+    memcpy(pObData->pb, pb, cb);
+    Ob_DECREF(ObMap_RemoveByKey(ctx->pmObEntries, qwKey));
+    ObMap_Push(ctx->pmObEntries, qwKey, pObData);
+    Ob_DECREF(pObData);
+    ctx->fDirty = TRUE;
+}
+
+/*
+* Key of a memoized kernel .pdb query in the profile.
+* -- dwQuery = PDB_PROFILE_QUERY_*
+* -- szName = symbol or type name.
+* -- wszChild = optional type child name.
+* -- return
+*/
+QWORD PDB_Profile_QueryKey(_In_ DWORD dwQuery, _In_ LPSTR szName, _In_opt_ LPWSTR wszChild)
+{
+    QWORD qwKey = dwQuery;
+    qwKey = Util_HashStringA(szName) + ((qwKey >> 13) | (qwKey << 51));
+    while(wszChild && *wszChild) {
+        qwKey = *wszChild++ + ((qwKey >> 13) | (qwKey << 51));
+    }
+    return qwKey | 0x8000000000000000;     // high bit set - distinct from PDB_PROFILE_KEY_*
+}
+
+/*
+* Retrieve a memoized kernel .pdb query result (DWORD value or negative result).
+* -- qwKey
+* -- pdwValue
+* -- pfResult = receives the result of the original query.
+* -- return = TRUE if found in profile.
+*/
+_Success_(return)
+BOOL PDB_Profile_GetQuery(_In_ QWORD qwKey, _Out_ PDWORD pdwValue, _Out_ PBOOL pfResult)
+{
+    DWORD dw[2];
+    if(!PDB_Profile_Get(qwKey, (PBYTE)dw, sizeof(dw))) { return FALSE; }
+    if((*pfResult = dw[0] ? TRUE : FALSE)) {
+        *pdwValue = dw[1];
+    }
+    return TRUE;
+}
+
+VOID PDB_Profile_PutQuery(_In_ QWORD qwKey, _In_ BOOL fResult, _In_ DWORD dwValue)
+{
+    DWORD dw[2];
+    dw[0] = fResult ? 1 : 0;
+    dw[1] = fResult ? dwValue : 0;
+    PDB_Profile_Put(qwKey, (PBYTE)dw, sizeof(dw));
+}
+
+/*
+* Initialize the kernel offset profile cache. This should be called as soon as
+* the kernel base address is known - before any offsets are fuzzed.
+* -- pSystemProcess
+*/
+VOID PDB_Profile_Initialize(_In_ PVMM_PROCESS pSystemProcess)
+{
+    PPDB_PROFILE_CONTEXT ctx = NULL;
+    PE_CODEVIEW_INFO CodeViewInfo;
+    CHAR szLocal[MAX_PATH];
+    if(ctxVmm->pPdbProfile || !ctxVmm->kernel.vaBase) { return; }
+    if(!PE_GetCodeViewInfo(pSystemProcess, ctxVmm->kernel.vaBase, NULL, &CodeViewInfo) && !PDB_Initialize_Async_Kernel_ScanForPdbInfo(pSystemProcess, &CodeViewInfo)) {
+        vmmprintfvv_fn("Unable to locate kernel debug information - offset profile disabled.\n");
+        return;
+    }
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(PDB_PROFILE_CONTEXT)))) { return; }
+    if(!(ctx->pmObEntries = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) {
+        LocalFree(ctx);
+        return;
+    }
+    InitializeCriticalSection(&ctx->LockFlush);
+    ctx->qwPdbHash = PDB_HashPdb(CodeViewInfo.CodeView.PdbFileName, CodeViewInfo.CodeView.Guid, CodeViewInfo.CodeView.Age);
+    // profile path: <symbol cache>\_vmmprofile\<pdb hash>.vmmprofile
+    PDB_Initialize_InitialValues_LocalPath(szLocal);
+    CreateDirectoryA(szLocal, NULL);
+    strncat_s(szLocal, MAX_PATH, "\\_vmmprofile", _TRUNCATE);
+    CreateDirectoryA(szLocal, NULL);
+    _snprintf_s(ctx->szPath, MAX_PATH, _TRUNCATE, "%s\\%016llx.vmmprofile", szLocal, ctx->qwPdbHash);
+    PDB_Profile_Load(ctx);
+    ctxVmm->pPdbProfile = ctx;
+}
+
+/*
+* Check whether the kernel offset profile was loaded from disk.
+* -- return
+*/
+BOOL PDB_Profile_IsLoaded()
+{
+    PPDB_PROFILE_CONTEXT ctx = (PPDB_PROFILE_CONTEXT)ctxVmm->pPdbProfile;
+    return ctx && ctx->fLoaded;
+}
+
+/*
+* Flush and close the kernel offset profile cache.
+*/
+VOID PDB_Profile_Close()
+{
+    PPDB_PROFILE_CONTEXT ctx = (PPDB_PROFILE_CONTEXT)ctxVmm->pPdbProfile;
+    if(!ctx) { return; }
+    PDB_Profile_Flush();
+    ctxVmm->pPdbProfile = NULL;
+    EnterCriticalSection(&ctx->LockFlush);
+    LeaveCriticalSection(&ctx->LockFlush);
+    DeleteCriticalSection(&ctx->LockFlush);
+    Ob_DECREF(ctx->pmObEntries);
+    LocalFree(ctx);
+}
+
+
+
+//-----------------------------------------------------------------------------
+// PDB DATABASE AND QUERY FUNCTIONALITY BELOW:
+//-----------------------------------------------------------------------------
+
 VOID PDB_CallbackCleanup_ObPdbEntry(PPDB_ENTRY pOb)
 {
+    PDB_Native_Free(pOb->pNative);
     LocalFree(pOb->szModuleName);
     LocalFree(pOb->szName);
     LocalFree(pOb->szPath);
@@ -222,7 +1257,55 @@ PDB_HANDLE PDB_GetHandleFromModuleName(_In_ LPSTR szModuleName)
 }
 
 /*
-* Ensure that the PDB_ENTRY have its symbols loaded into memory.
+* Retrieve the path of a .pdb in the local symbol cache directory (which uses
+* the symbol server layout: <cache>\<name>\<GUID><AGE>\<name>) if it exists.
+* -- pPdbEntry
+* -- szPdbPath
+* -- return
+*/
+_Success_(return)
+BOOL PDB_LoadEnsure_LocalPath(_In_ PPDB_ENTRY pPdbEntry, _Out_writes_(MAX_PATH) LPSTR szPdbPath)
+{
+    PBYTE pb = pPdbEntry->pbGUID;
+    if(!ctxMain->pdb.szLocal[0]) { return FALSE; }
+    _snprintf_s(
+        szPdbPath, MAX_PATH, _TRUNCATE,
+        "%s\\%s\\%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%X\\%s",
+        ctxMain->pdb.szLocal, pPdbEntry->szName,
+        *(PDWORD)pb, *(PWORD)(pb + 4), *(PWORD)(pb + 6), pb[8], pb[9], pb[10], pb[11], pb[12], pb[13], pb[14], pb[15],
+        pPdbEntry->dwAge, pPdbEntry->szName
+    );
+    return !_access_s(szPdbPath, 04);
+}
+
+/*
+* Ensure that the PDB_ENTRY have its symbols loaded into dbghelp.dll. This is
+* only required for queries not covered by the native .pdb parser.
+* NB! this function must be called in a single-threaded context!
+* -- pPdbEntry
+* -- return
+*/
+_Success_(return)
+BOOL PDB_LoadEnsureDbgHelp(_In_ PPDB_ENTRY pPdbEntry)
+{
+    PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
+    if(!ctx || !pPdbEntry->szPath || pPdbEntry->fDbgHelpFailed) { return FALSE; }
+    if(pPdbEntry->qwLoadAddress) { return TRUE; }
+    if(ctx->hSym) {
+        pPdbEntry->qwLoadAddress = ctx->pfn.SymLoadModuleEx(ctx->hSym, NULL, pPdbEntry->szPath, NULL, ctx->qwLoadAddressNext, pPdbEntry->cbModuleSize, NULL, 0);
+        ctx->qwLoadAddressNext += VMMWIN_PDB_LOAD_ADDRESS_STEP;
+    }
+    if(!pPdbEntry->qwLoadAddress) {
+        pPdbEntry->fDbgHelpFailed = TRUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+* Ensure that the PDB_ENTRY have its symbols loaded into memory. The .pdb is
+* located in the local symbol cache - or retrieved by dbghelp/symsrv - and is
+* parsed by the native parser. dbghelp is used if the native parse fails.
 * NB! this function must be called in a single-threaded context!
 * -- pPdbEntry
 * -- return
@@ -233,12 +1316,18 @@ BOOL PDB_LoadEnsureEx(_In_ PPDB_ENTRY pPdbEntry)
     PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
     CHAR szPdbPath[MAX_PATH + 1];
     if(!ctx || pPdbEntry->fLoadFailed) { return FALSE; }
-    if(pPdbEntry->qwLoadAddress) { return TRUE; }
-    if(!ctx->pfn.SymFindFileInPath(ctx->hSym, NULL, pPdbEntry->szName, pPdbEntry->pbGUID, pPdbEntry->dwAge, 0, SSRVOPT_GUIDPTR, szPdbPath, NULL, NULL)) { goto fail; }
-    pPdbEntry->szPath = Util_StrDupA(szPdbPath);
-    pPdbEntry->qwLoadAddress = ctx->pfn.SymLoadModuleEx(ctx->hSym, NULL, szPdbPath, NULL, ctx->qwLoadAddressNext, pPdbEntry->cbModuleSize, NULL, 0);
-    ctx->qwLoadAddressNext += VMMWIN_PDB_LOAD_ADDRESS_STEP;
-    if(!pPdbEntry->szPath || !pPdbEntry->qwLoadAddress) { goto fail; }
+    if(pPdbEntry->pNative || pPdbEntry->qwLoadAddress) { return TRUE; }
+    if(!PDB_LoadEnsure_LocalPath(pPdbEntry, szPdbPath)) {
+        if(!ctx->hSym) { goto fail; }
+        if(!ctx->pfn.SymFindFileInPath(ctx->hSym, NULL, pPdbEntry->szName, pPdbEntry->pbGUID, pPdbEntry->dwAge, 0, SSRVOPT_GUIDPTR, szPdbPath, NULL, NULL)) { goto fail; }
+    }
+    if(!(pPdbEntry->szPath = Util_StrDupA(szPdbPath))) { goto fail; }
+    if((pPdbEntry->pNative = PDB_Native_Load(pPdbEntry->szPath, pPdbEntry->pbGUID))) {
+        vmmprintfvv_fn("Native parse of .pdb: %s symbols: %i types: %i\n", pPdbEntry->szPath, pPdbEntry->pNative->Sym.c, pPdbEntry->pNative->Type.c);
+        return TRUE;
+    }
+    vmmprintfv_fn("Native parse of .pdb failed - falling back to dbghelp: %s\n", pPdbEntry->szPath);
+    if(!PDB_LoadEnsureDbgHelp(pPdbEntry)) { goto fail; }
     return TRUE;
 fail:
     pPdbEntry->fLoadFailed = TRUE;
@@ -266,6 +1355,23 @@ BOOL PDB_LoadEnsure(_In_opt_ PDB_HANDLE hPDB)
     return fResult;
 }
 
+/*
+* Retrieve the native .pdb tables of a PDB entry - loading them if required.
+* The tables live as long as the entry and are queried without the PDB lock.
+* -- ctx
+* -- pPdbEntry
+* -- return = the native tables, or NULL if not available.
+*/
+PPDB_NATIVE PDB_GetNative(_In_ PVMMWIN_PDB_CONTEXT ctx, _In_ PPDB_ENTRY pPdbEntry)
+{
+    if(!pPdbEntry->pNative && !pPdbEntry->fLoadFailed) {
+        EnterCriticalSection(&ctx->Lock);
+        PDB_LoadEnsureEx(pPdbEntry);
+        LeaveCriticalSection(&ctx->Lock);
+    }
+    return pPdbEntry->pNative;
+}
+
 /*
 * Return the module name given a PDB handle.
 * -- hPDB
@@ -285,6 +1391,38 @@ BOOL PDB_GetModuleName(_In_opt_ PDB_HANDLE hPDB, _Out_writes_(MAX_PATH) LPSTR sz
     return TRUE;
 }
 
+/*
+* Check whether a PDB handle refers to the kernel .pdb of the offset profile.
+* The offset profile is only used if the PDB subsystem is enabled.
+* -- hPDB
+* -- return
+*/
+BOOL PDB_Profile_IsKernel(_In_opt_ PDB_HANDLE hPDB)
+{
+    PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
+    PPDB_PROFILE_CONTEXT ctxProfile = (PPDB_PROFILE_CONTEXT)ctxVmm->pPdbProfile;
+    if(!ctx || ctx->fDisabled || !ctxProfile || !hPDB) { return FALSE; }
+    return (hPDB == PDB_HANDLE_KERNEL) || (hPDB == ctxProfile->qwPdbHash);
+}
+
+/*
+* Check whether the kernel .pdb is loaded - i.e. whether a failed query is a
+* genuine miss which may be recorded as such in the offset profile.
+* -- return
+*/
+BOOL PDB_Profile_IsKernelPdbLoaded()
+{
+    PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
+    PPDB_PROFILE_CONTEXT ctxProfile = (PPDB_PROFILE_CONTEXT)ctxVmm->pPdbProfile;
+    PPDB_ENTRY pObPdbEntry;
+    BOOL fResult;
+    if(!ctx || ctx->fDisabled || !ctxProfile) { return FALSE; }
+    if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, ctxProfile->qwPdbHash))) { return FALSE; }
+    fResult = pObPdbEntry->pNative || pObPdbEntry->qwLoadAddress;
+    Ob_DECREF(pObPdbEntry);
+    return fResult;
+}
+
 /*
 * Callback function for PDB_GetSymbolOffset() / SymEnumSymbols()
 */
@@ -296,26 +1434,22 @@ BOOL PDB_GetSymbolOffset_Callback(_In_ PSYMBOL_INFO pSymInfo, _In_ ULONG SymbolS
     return FALSE;
 }
 
-/*
-* Query the PDB for the offset of a symbol. If szSymbolName contains wildcard
-* '?*' characters and matches multiple symbols the offset of the 1st symbol is
-* returned.
-* -- hPDB
-* -- szSymbolName = wildcard symbol name
-* -- pdwSymbolOffset
-* -- return
-*/
 _Success_(return)
-BOOL PDB_GetSymbolOffset(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szSymbolName, _Out_ PDWORD pdwSymbolOffset)
+BOOL PDB_GetSymbolOffset_DoWork(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szSymbolName, _Out_ PDWORD pdwSymbolOffset)
 {
     PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
     PPDB_ENTRY pObPdbEntry = NULL;
+    PPDB_NATIVE pNative;
     BOOL fResult = FALSE;
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
     if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return FALSE; }
+    if(!strpbrk(szSymbolName, "*?") && (pNative = PDB_GetNative(ctx, pObPdbEntry)) && PDB_Native_GetSymbolOffset(pNative, szSymbolName, pdwSymbolOffset)) {
+        Ob_DECREF(pObPdbEntry);
+        return TRUE;
+    }
     EnterCriticalSection(&ctx->Lock);
-    if(!PDB_LoadEnsureEx(pObPdbEntry)) { goto fail; }
+    if(!PDB_LoadEnsureEx(pObPdbEntry) || !PDB_LoadEnsureDbgHelp(pObPdbEntry)) { goto fail; }
     *pdwSymbolOffset = 0;
     if(!ctx->pfn.SymEnumSymbols(ctx->hSym, pObPdbEntry->qwLoadAddress, szSymbolName, PDB_GetSymbolOffset_Callback, pdwSymbolOffset)) { goto fail; }
     if(!*pdwSymbolOffset) { goto fail; }
@@ -326,6 +1460,32 @@ fail:
     return fResult;
 }
 
+/*
+* Query the PDB for the offset of a symbol. If szSymbolName contains wildcard
+* '?*' characters and matches multiple symbols the offset of the 1st symbol is
+* returned.
+* -- hPDB
+* -- szSymbolName = wildcard symbol name
+* -- pdwSymbolOffset
+* -- return
+*/
+_Success_(return)
+BOOL PDB_GetSymbolOffset(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szSymbolName, _Out_ PDWORD pdwSymbolOffset)
+{
+    QWORD qwKey;
+    BOOL fResult;
+    if(!PDB_Profile_IsKernel(hPDB)) {
+        return PDB_GetSymbolOffset_DoWork(hPDB, szSymbolName, pdwSymbolOffset);
+    }
+    qwKey = PDB_Profile_QueryKey(PDB_PROFILE_QUERY_SYMBOL, szSymbolName, NULL);
+    if(PDB_Profile_GetQuery(qwKey, pdwSymbolOffset, &fResult)) { return fResult; }
+    fResult = PDB_GetSymbolOffset_DoWork(hPDB, szSymbolName, pdwSymbolOffset);
+    if(fResult || PDB_Profile_IsKernelPdbLoaded()) {
+        PDB_Profile_PutQuery(qwKey, fResult, fResult ? *pdwSymbolOffset : 0);
+    }
+    return fResult;
+}
+
 /*
 * Query the PDB for the offset of a symbol and return its virtual address. If
 * szSymbolName contains wildcard '?*' characters and matches multiple symbols
@@ -342,6 +1502,11 @@ BOOL PDB_GetSymbolAddress(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szSymbolName, _Ou
     PPDB_ENTRY pObPdbEntry = NULL;
     DWORD cbSymbolOffset;
     BOOL fResult = FALSE;
+    if(PDB_Profile_IsKernel(hPDB)) {
+        if(!PDB_GetSymbolOffset(PDB_HANDLE_KERNEL, szSymbolName, &cbSymbolOffset)) { return FALSE; }
+        *pvaSymbolAddress = ctxVmm->kernel.vaBase + cbSymbolOffset;
+        return TRUE;
+    }
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
     if(!PDB_GetSymbolOffset(hPDB, szSymbolName, &cbSymbolOffset)) { return FALSE; }
@@ -367,12 +1532,17 @@ BOOL PDB_GetSymbolFromOffset(_In_opt_ PDB_HANDLE hPDB, _In_ DWORD dwSymbolOffset
     SYMBOL_INFO_PACKAGE SymbolInfo = { 0 };
     QWORD cch, qwDisplacement;
     PPDB_ENTRY pObPdbEntry = NULL;
+    PPDB_NATIVE pNative;
     BOOL fResult = FALSE;
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
     if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return FALSE; }
+    if((pNative = PDB_GetNative(ctx, pObPdbEntry)) && PDB_Native_GetSymbolFromOffset(pNative, dwSymbolOffset, szSymbolName, pdwSymbolDisplacement)) {
+        Ob_DECREF(pObPdbEntry);
+        return TRUE;
+    }
     EnterCriticalSection(&ctx->Lock);
-    if(!PDB_LoadEnsureEx(pObPdbEntry)) { goto fail; }
+    if(!PDB_LoadEnsureEx(pObPdbEntry) || !PDB_LoadEnsureDbgHelp(pObPdbEntry)) { goto fail; }
     SymbolInfo.si.SizeOfStruct = sizeof(SYMBOL_INFO);
     SymbolInfo.si.MaxNameLen = MAX_SYM_NAME;
     if(!ctx->pfn.SymFromAddr(ctx->hSym, pObPdbEntry->qwLoadAddress + dwSymbolOffset, &qwDisplacement, &SymbolInfo.si)) { goto fail; }
@@ -409,6 +1579,10 @@ BOOL PDB_GetSymbolPBYTE(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szSymbolName, _In_
     PPDB_ENTRY pObPdbEntry = NULL;
     DWORD dwSymbolOffset;
     BOOL fResult;
+    if(PDB_Profile_IsKernel(hPDB)) {
+        if(!PDB_GetSymbolOffset(PDB_HANDLE_KERNEL, szSymbolName, &dwSymbolOffset)) { return FALSE; }
+        return VmmRead(pProcess, ctxVmm->kernel.vaBase + dwSymbolOffset, pb, cb);
+    }
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
     if(!PDB_GetSymbolOffset(hPDB, szSymbolName, &dwSymbolOffset)) { return FALSE; }
@@ -427,25 +1601,22 @@ BOOL PDB_GetTypeSize_Callback(_In_ PSYMBOL_INFO pSymInfo, _In_ ULONG SymbolSize,
     return FALSE;
 }
 
-/*
-* Query the PDB for the size of a type. If szTypeName contains wildcard '?*'
-* characters and matches multiple types the size of the 1st type is returned.
-* -- hPDB
-* -- szTypeName = wildcard type name
-* -- pdwTypeSize
-* -- return
-*/
 _Success_(return)
-BOOL PDB_GetTypeSize(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _Out_ PDWORD pdwTypeSize)
+BOOL PDB_GetTypeSize_DoWork(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _Out_ PDWORD pdwTypeSize)
 {
     PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
     PPDB_ENTRY pObPdbEntry = NULL;
+    PPDB_NATIVE pNative;
     BOOL fResult = FALSE;
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
     if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return FALSE; }
+    if(!strpbrk(szTypeName, "*?") && (pNative = PDB_GetNative(ctx, pObPdbEntry)) && PDB_Native_GetTypeSize(pNative, szTypeName, pdwTypeSize)) {
+        Ob_DECREF(pObPdbEntry);
+        return TRUE;
+    }
     EnterCriticalSection(&ctx->Lock);
-    if(!PDB_LoadEnsureEx(pObPdbEntry)) { goto fail; }
+    if(!PDB_LoadEnsureEx(pObPdbEntry) || !PDB_LoadEnsureDbgHelp(pObPdbEntry)) { goto fail; }
     *pdwTypeSize = 0;
     if(!ctx->pfn.SymEnumTypesByName(ctx->hSym, pObPdbEntry->qwLoadAddress, szTypeName, PDB_GetTypeSize_Callback, pdwTypeSize)) { goto fail; }
     if(!*pdwTypeSize) { goto fail; }
@@ -456,6 +1627,31 @@ fail:
     return fResult;
 }
 
+/*
+* Query the PDB for the size of a type. If szTypeName contains wildcard '?*'
+* characters and matches multiple types the size of the 1st type is returned.
+* -- hPDB
+* -- szTypeName = wildcard type name
+* -- pdwTypeSize
+* -- return
+*/
+_Success_(return)
+BOOL PDB_GetTypeSize(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _Out_ PDWORD pdwTypeSize)
+{
+    QWORD qwKey;
+    BOOL fResult;
+    if(!PDB_Profile_IsKernel(hPDB)) {
+        return PDB_GetTypeSize_DoWork(hPDB, szTypeName, pdwTypeSize);
+    }
+    qwKey = PDB_Profile_QueryKey(PDB_PROFILE_QUERY_TYPESIZE, szTypeName, NULL);
+    if(PDB_Profile_GetQuery(qwKey, pdwTypeSize, &fResult)) { return fResult; }
+    fResult = PDB_GetTypeSize_DoWork(hPDB, szTypeName, pdwTypeSize);
+    if(fResult || PDB_Profile_IsKernelPdbLoaded()) {
+        PDB_Profile_PutQuery(qwKey, fResult, fResult ? *pdwTypeSize : 0);
+    }
+    return fResult;
+}
+
 _Success_(return)
 BOOL PDB_GetTypeSizeShort(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _Out_ PWORD pwTypeSize)
 {
@@ -475,30 +1671,25 @@ BOOL PDB_GetTypeChildOffset_Callback(_In_ PSYMBOL_INFO pSymInfo, _In_ ULONG Symb
     return FALSE;
 }
 
-/*
-* Query the PDB for the offset of a child inside a type - often inside a struct.
-* If szTypeName contains wildcard '?*' characters and matches multiple types the
-* first type is queried for children. The child name must match exactly.
-* -- hPDB
-* -- szTypeName = wildcard type name.
-* -- wszTypeChildName = exact match of child name.
-* -- pdwTypeOffset = offset relative to type base.
-* -- return
-*/
 _Success_(return)
-BOOL PDB_GetTypeChildOffset(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _In_ LPWSTR wszTypeChildName, _Out_ PDWORD pdwTypeOffset)
+BOOL PDB_GetTypeChildOffset_DoWork(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _In_ LPWSTR wszTypeChildName, _Out_ PDWORD pdwTypeOffset)
 {
     PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
     BOOL fResult = FALSE;
     LPWSTR wszTypeChildSymName;
     PPDB_ENTRY pObPdbEntry = NULL;
+    PPDB_NATIVE pNative;
     DWORD dwTypeId, cTypeChildren, iTypeChild;
     TI_FINDCHILDREN_PARAMS *pFindChildren = NULL;
     if(!ctx || ctx->fDisabled || !hPDB) { return FALSE; }
     if(hPDB == PDB_HANDLE_KERNEL) { hPDB = PDB_GetHandleFromModuleName("ntoskrnl"); }
     if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return FALSE; }
+    if(!strpbrk(szTypeName, "*?") && (pNative = PDB_GetNative(ctx, pObPdbEntry)) && PDB_Native_GetTypeChildOffset(pNative, szTypeName, wszTypeChildName, pdwTypeOffset)) {
+        Ob_DECREF(pObPdbEntry);
+        return TRUE;
+    }
     EnterCriticalSection(&ctx->Lock);
-    if(!PDB_LoadEnsureEx(pObPdbEntry)) { goto fail; }
+    if(!PDB_LoadEnsureEx(pObPdbEntry) || !PDB_LoadEnsureDbgHelp(pObPdbEntry)) { goto fail; }
     if(!ctx->pfn.SymEnumTypesByName(ctx->hSym, pObPdbEntry->qwLoadAddress, szTypeName, PDB_GetTypeChildOffset_Callback, &dwTypeId) || !dwTypeId) { goto fail; }
     if(!ctx->pfn.SymGetTypeInfo(ctx->hSym, pObPdbEntry->qwLoadAddress, dwTypeId, TI_GET_CHILDRENCOUNT, &cTypeChildren) || !cTypeChildren) { goto fail; }
     if(!(pFindChildren = LocalAlloc(LMEM_ZEROINIT, sizeof(TI_FINDCHILDREN_PARAMS) + cTypeChildren * sizeof(ULONG)))) { goto fail; }
@@ -522,6 +1713,33 @@ fail:
     return fResult;
 }
 
+/*
+* Query the PDB for the offset of a child inside a type - often inside a struct.
+* If szTypeName contains wildcard '?*' characters and matches multiple types the
+* first type is queried for children. The child name must match exactly.
+* -- hPDB
+* -- szTypeName = wildcard type name.
+* -- wszTypeChildName = exact match of child name.
+* -- pdwTypeOffset = offset relative to type base.
+* -- return
+*/
+_Success_(return)
+BOOL PDB_GetTypeChildOffset(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _In_ LPWSTR wszTypeChildName, _Out_ PDWORD pdwTypeOffset)
+{
+    QWORD qwKey;
+    BOOL fResult;
+    if(!PDB_Profile_IsKernel(hPDB)) {
+        return PDB_GetTypeChildOffset_DoWork(hPDB, szTypeName, wszTypeChildName, pdwTypeOffset);
+    }
+    qwKey = PDB_Profile_QueryKey(PDB_PROFILE_QUERY_TYPECHILD, szTypeName, wszTypeChildName);
+    if(PDB_Profile_GetQuery(qwKey, pdwTypeOffset, &fResult)) { return fResult; }
+    fResult = PDB_GetTypeChildOffset_DoWork(hPDB, szTypeName, wszTypeChildName, pdwTypeOffset);
+    if(fResult || PDB_Profile_IsKernelPdbLoaded()) {
+        PDB_Profile_PutQuery(qwKey, fResult, fResult ? *pdwTypeOffset : 0);
+    }
+    return fResult;
+}
+
 _Success_(return)
 BOOL PDB_GetTypeChildOffsetShort(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _In_ LPWSTR wszTypeChildName, _Out_ PWORD pwTypeOffset)
 {
@@ -533,6 +1751,159 @@ BOOL PDB_GetTypeChildOffsetShort(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName
 
 
 
+#ifdef VMM_TEST_SELFTEST
+//-----------------------------------------------------------------------------
+// NATIVE PARSER SELF TEST BELOW (VMM_TEST_SELFTEST builds only):
+// Compare the native tables of the kernel .pdb against dbghelp - which parses
+// the same .pdb - for every public symbol (name -> rva and rva -> symbol) and
+// every struct/class/union type (size and data member offsets).
+//-----------------------------------------------------------------------------
+
+VOID PDB_SelfTest_Mismatch(_Inout_ PPDB_SELFTEST_RESULT pr, _In_z_ _Printf_format_string_ LPSTR szFormat, ...)
+{
+    int cch;
+    va_list args;
+    if(pr->cMismatchText >= PDB_SELFTEST_MISMATCH_TEXT_MAX) { return; }
+    pr->cMismatchText++;
+    va_start(args, szFormat);
+    cch = _vsnprintf_s(pr->szMismatch + pr->cchMismatch, sizeof(pr->szMismatch) - pr->cchMismatch, _TRUNCATE, szFormat, args);
+    va_end(args);
+    pr->cchMismatch = (cch < 0) ? (sizeof(pr->szMismatch) - 1) : (pr->cchMismatch + cch);
+}
+
+QWORD PDB_SelfTest_TimeUs()
+{
+    LARGE_INTEGER qwFreq, qwNow;
+    QueryPerformanceFrequency(&qwFreq);
+    QueryPerformanceCounter(&qwNow);
+    return (qwNow.QuadPart / qwFreq.QuadPart) * 1000000 + (qwNow.QuadPart % qwFreq.QuadPart) * 1000000 / qwFreq.QuadPart;
+}
+
+/*
+* Compare the type size and all data member offsets of a type.
+*/
+VOID PDB_SelfTest_Type(_In_ PVMMWIN_PDB_CONTEXT ctx, _In_ PPDB_ENTRY pPdbEntry, _In_ PPDB_NATIVE pNative, _In_ LPSTR szTypeName, _Inout_ PPDB_SELFTEST_RESULT pr)
+{
+    QWORD tm;
+    BOOL fNative;
+    LPWSTR wszChild;
+    DWORD i, cChild = 0, dwTypeId = 0, dwSizeDbgHelp = 0, dwSizeNative = 0, dwOffsetDbgHelp, dwOffsetNative;
+    TI_FINDCHILDREN_PARAMS *pFindChildren = NULL;
+    // size
+    tm = PDB_SelfTest_TimeUs();
+    fNative = PDB_Native_GetTypeSize(pNative, szTypeName, &dwSizeNative);
+    pr->tmNativeUs += PDB_SelfTest_TimeUs() - tm;
+    tm = PDB_SelfTest_TimeUs();
+    ctx->pfn.SymEnumTypesByName(ctx->hSym, pPdbEntry->qwLoadAddress, szTypeName, PDB_GetTypeSize_Callback, &dwSizeDbgHelp);
+    ctx->pfn.SymEnumTypesByName(ctx->hSym, pPdbEntry->qwLoadAddress, szTypeName, PDB_GetTypeChildOffset_Callback, &dwTypeId);
+    pr->tmDbgHelpUs += PDB_SelfTest_TimeUs() - tm;
+    pr->cType++;
+    if(!dwSizeDbgHelp && fNative) {
+        pr->cTypeNativeOnly++;      // i.e. 1st dbghelp match is a forward reference.
+    } else if(dwSizeDbgHelp != (fNative ? dwSizeNative : 0)) {
+        pr->cTypeMismatch++;
+        PDB_SelfTest_Mismatch(pr, "TYPE SIZE  %s: native=%x dbghelp=%x\n", szTypeName, dwSizeNative, dwSizeDbgHelp);
+    }
+    // data members
+    if(!dwTypeId) { return; }
+    if(!ctx->pfn.SymGetTypeInfo(ctx->hSym, pPdbEntry->qwLoadAddress, dwTypeId, TI_GET_CHILDRENCOUNT, &cChild) || !cChild) { return; }
+    if(!(pFindChildren = LocalAlloc(LMEM_ZEROINIT, sizeof(TI_FINDCHILDREN_PARAMS) + cChild * sizeof(ULONG)))) { return; }
+    pFindChildren->Count = cChild;
+    if(ctx->pfn.SymGetTypeInfo(ctx->hSym, pPdbEntry->qwLoadAddress, dwTypeId, TI_FINDCHILDREN, pFindChildren)) {
+        for(i = 0; i < cChild; i++) {
+            if(!ctx->pfn.SymGetTypeInfo(ctx->hSym, pPdbEntry->qwLoadAddress, pFindChildren->ChildId[i], TI_GET_SYMNAME, &wszChild)) { continue; }
+            if(ctx->pfn.SymGetTypeInfo(ctx->hSym, pPdbEntry->qwLoadAddress, pFindChildren->ChildId[i], TI_GET_OFFSET, &dwOffsetDbgHelp)) {
+                pr->cTypeChild++;
+                tm = PDB_SelfTest_TimeUs();
+                fNative = PDB_Native_GetTypeChildOffset(pNative, szTypeName, wszChild, &dwOffsetNative);
+                pr->tmNativeUs += PDB_SelfTest_TimeUs() - tm;
+                if(!fNative || (dwOffsetNative != dwOffsetDbgHelp)) {
+                    pr->cTypeChildMismatch++;
+                    PDB_SelfTest_Mismatch(pr, "TYPE CHILD %s.%S: native=%x dbghelp=%x\n", szTypeName, wszChild, (fNative ? dwOffsetNative : (DWORD)-1), dwOffsetDbgHelp);
+                }
+            }
+            LocalFree(wszChild);
+        }
+    }
+    LocalFree(pFindChildren);
+}
+
+/*
+* Compare the native .pdb tables of the kernel against dbghelp.dll.
+* -- cMax = max # of symbols and types to compare (spread over the tables), 0 = all.
+* -- pr
+* -- return = TRUE if the comparison ran (check the mismatch counters).
+*/
+_Success_(return)
+BOOL PDB_SelfTest_Kernel(_In_ DWORD cMax, _Out_ PPDB_SELFTEST_RESULT pr)
+{
+    PVMMWIN_PDB_CONTEXT ctx = (PVMMWIN_PDB_CONTEXT)ctxVmm->pPdbContext;
+    SYMBOL_INFO_PACKAGE SymbolInfo = { 0 };
+    PPDB_ENTRY pObPdbEntry = NULL;
+    PPDB_NATIVE pNative;
+    PDB_HANDLE hPDB;
+    QWORD tm, qwDisplacement;
+    BOOL fNative, fResult = FALSE;
+    LPSTR szName;
+    CHAR szNameNative[MAX_PATH];
+    DWORD i, iStep, dwRvaNative, dwRvaDbgHelp, dwDisplacementNative;
+    ZeroMemory(pr, sizeof(PDB_SELFTEST_RESULT));
+    if(!ctx || ctx->fDisabled || !ctx->hSym) { return FALSE; }
+    if(!(hPDB = PDB_GetHandleFromModuleName("ntoskrnl"))) { return FALSE; }
+    if(!(pObPdbEntry = ObMap_GetByKey(ctx->pmPdbByHash, hPDB))) { return FALSE; }
+    if(!(pNative = PDB_GetNative(ctx, pObPdbEntry))) { goto fail_nolock; }
+    strncpy_s(pr->szPdbPath, _countof(pr->szPdbPath), pObPdbEntry->szPath, _TRUNCATE);
+    EnterCriticalSection(&ctx->Lock);
+    if(!PDB_LoadEnsureDbgHelp(pObPdbEntry)) { goto fail; }
+    // symbols: name -> rva and rva -> closest symbol
+    iStep = (cMax && (cMax < pNative->Sym.c)) ? (pNative->Sym.c / cMax) : 1;
+    for(i = 0; i < pNative->Sym.c; i += iStep) {
+        szName = (LPSTR)(pNative->Sym.pbNameBase + pNative->Sym.pe[i].oszName);
+        if(strpbrk(szName, "*?")) { continue; }
+        pr->cSymbol++;
+        dwRvaDbgHelp = 0;
+        tm = PDB_SelfTest_TimeUs();
+        fNative = PDB_Native_GetSymbolOffset(pNative, szName, &dwRvaNative);
+        pr->tmNativeUs += PDB_SelfTest_TimeUs() - tm;
+        tm = PDB_SelfTest_TimeUs();
+        ctx->pfn.SymEnumSymbols(ctx->hSym, pObPdbEntry->qwLoadAddress, szName, PDB_GetSymbolOffset_Callback, &dwRvaDbgHelp);
+        pr->tmDbgHelpUs += PDB_SelfTest_TimeUs() - tm;
+        if(dwRvaDbgHelp != (fNative ? dwRvaNative : 0)) {
+            pr->cSymbolMismatch++;
+            PDB_SelfTest_Mismatch(pr, "SYMBOL     %s: native=%x dbghelp=%x\n", szName, (fNative ? dwRvaNative : 0), dwRvaDbgHelp);
+        }
+        // rva -> symbol: compare the rva of the closest symbol (names may alias).
+        if(!pNative->Sym.pe[i].dwValue) { continue; }
+        pr->cSymbolFromOffset++;
+        SymbolInfo.si.SizeOfStruct = sizeof(SYMBOL_INFO);
+        SymbolInfo.si.MaxNameLen = MAX_SYM_NAME;
+        fNative = PDB_Native_GetSymbolFromOffset(pNative, pNative->Sym.pe[i].dwValue + 1, szNameNative, &dwDisplacementNative);
+        if(!ctx->pfn.SymFromAddr(ctx->hSym, pObPdbEntry->qwLoadAddress + pNative->Sym.pe[i].dwValue + 1, &qwDisplacement, &SymbolInfo.si)) {
+            if(fNative) {
+                pr->cSymbolFromOffsetMismatch++;
+                PDB_SelfTest_Mismatch(pr, "SYMBOL RVA %x: native=%s dbghelp=<none>\n", pNative->Sym.pe[i].dwValue + 1, szNameNative);
+            }
+        } else if(!fNative || (pNative->Sym.pe[i].dwValue + 1 - dwDisplacementNative != SymbolInfo.si.Address - pObPdbEntry->qwLoadAddress)) {
+            pr->cSymbolFromOffsetMismatch++;
+            PDB_SelfTest_Mismatch(pr, "SYMBOL RVA %x: native=%s dbghelp=%s\n", pNative->Sym.pe[i].dwValue + 1, (fNative ? szNameNative : "<none>"), SymbolInfo.si.Name);
+        }
+    }
+    // types: size and data member offsets
+    iStep = (cMax && (cMax < pNative->Type.c)) ? (pNative->Type.c / cMax) : 1;
+    for(i = 0; i < pNative->Type.c; i += iStep) {
+        szName = (LPSTR)(pNative->Type.pbNameBase + pNative->Type.pe[i].oszName);
+        if(strpbrk(szName, "*?")) { continue; }
+        PDB_SelfTest_Type(ctx, pObPdbEntry, pNative, szName, pr);
+    }
+    fResult = TRUE;
+fail:
+    LeaveCriticalSection(&ctx->Lock);
+fail_nolock:
+    Ob_DECREF(pObPdbEntry);
+    return fResult;
+}
+#endif /* VMM_TEST_SELFTEST */
+
 //-----------------------------------------------------------------------------
 // INITIALIZATION/REFRESH/CLOSE FUNCTIONALITY BELOW:
 //-----------------------------------------------------------------------------
@@ -635,7 +2006,8 @@ DWORD PDB_Initialize_Async_Kernel_ThreadProc(LPVOID lpParameter)
         vmmprintf("%s         Reason: Failed creating initial PDB entry.\n", VMMWIN_PDB_WARN_DEFAULT);
         goto fail;
     }
-    if(!PDB_LoadEnsureEx(pObKernelEntry)) {
+    // kernel .pdb is loaded on-demand if an offset profile exists for the kernel.
+    if(!PDB_Profile_IsLoaded() && !PDB_LoadEnsureEx(pObKernelEntry)) {
         vmmprintf("%s         Reason: Unable to download kernel symbols to cache from Symbol Server.\n", VMMWIN_PDB_WARN_DEFAULT);
         goto fail;
     }
@@ -651,6 +2023,29 @@ fail:
     return dwReturnStatus;
 }
 
+/*
+* Retrieve the local symbol cache directory from the registry - or the default
+* directory 'Symbols' in the directory of vmm.dll if not configured.
+* -- szLocal
+*/
+VOID PDB_Initialize_InitialValues_LocalPath(_Out_writes_(MAX_PATH) LPSTR szLocal)
+{
+    HKEY hKey;
+    DWORD cbData;
+    szLocal[0] = 0;
+    if(ERROR_SUCCESS == RegOpenKeyExA(HKEY_CURRENT_USER, "Software\\UlfFrisk\\MemProcFS", 0, KEY_READ, &hKey)) {
+        cbData = MAX_PATH - 1;
+        RegQueryValueExA(hKey, "SymbolCache", NULL, NULL, (PBYTE)szLocal, &cbData);
+        if(cbData < 3) { szLocal[0] = 0; }
+        szLocal[MAX_PATH - 1] = 0;
+        RegCloseKey(hKey);
+    }
+    if(!szLocal[0]) {
+        Util_GetPathDll(szLocal, ctxVmm->hModuleVmm);
+        strncat_s(szLocal, MAX_PATH, "Symbols", _TRUNCATE);
+    }
+}
+
 VOID PDB_Initialize_InitialValues()
 {
     HKEY hKey;
@@ -665,9 +2060,6 @@ VOID PDB_Initialize_InitialValues()
     dwEnableSymbols = ctxMain->pdb.fEnable ? 1 : 0;
     dwEnableSymbolServer = ctxMain->pdb.fServerEnable ? 1 : 0;
     if(ERROR_SUCCESS == RegOpenKeyExA(HKEY_CURRENT_USER, "Software\\UlfFrisk\\MemProcFS", 0, KEY_READ, &hKey)) {
-        cbData = _countof(ctxMain->pdb.szLocal) - 1;
-        RegQueryValueExA(hKey, "SymbolCache", NULL, NULL, (PBYTE)ctxMain->pdb.szLocal, &cbData);
-        if(cbData < 3) { ctxMain->pdb.szLocal[0] = 0; }
         cbData = _countof(ctxMain->pdb.szServer) - 1;
         RegQueryValueExA(hKey, "SymbolServer", NULL, NULL, (PBYTE)ctxMain->pdb.szServer, &cbData);
         if(cbData < 3) { ctxMain->pdb.szServer[0] = 0; }
@@ -682,10 +2074,7 @@ VOID PDB_Initialize_InitialValues()
         RegCloseKey(hKey);
     }
     // 2: set default values (if not already loaded from registry)
-    if(!ctxMain->pdb.szLocal[0]) {
-        Util_GetPathDll(ctxMain->pdb.szLocal, ctxVmm->hModuleVmm);
-        strncat_s(ctxMain->pdb.szLocal, _countof(ctxMain->pdb.szLocal), "Symbols", _TRUNCATE);
-    }
+    PDB_Initialize_InitialValues_LocalPath(ctxMain->pdb.szLocal);
     if(!ctxMain->pdb.szServer[0]) {
         strncpy_s(ctxMain->pdb.szServer, _countof(ctxMain->pdb.szServer), "https://msdl.microsoft.com/download/symbols", _TRUNCATE);
     }
@@ -733,22 +2122,17 @@ VOID PDB_ConfigChange()
 }
 
 /*
-* Initialize the PDB sub-system. This should ideally be done on Vmm Init()
+* Load dbghelp.dll and symsrv.dll from the directory of vmm.dll - i.e. not from
+* system32 - and initialize the symbol handler. dbghelp.dll is used to locate
+* and download .pdb files and as a fallback for the native .pdb parser.
+* -- ctx
+* -- return
 */
-VOID PDB_Initialize(_In_opt_ PPE_CODEVIEW_INFO pPdbInfoOpt, _In_ BOOL fInitializeKernelAsync)
+_Success_(return)
+BOOL PDB_Initialize_DbgHelp(_In_ PVMMWIN_PDB_CONTEXT ctx)
 {
-    HANDLE hEventThreadStarted = 0;
-    PVMMWIN_PDB_CONTEXT ctx = NULL;
     DWORD i, dwSymOptions;
     CHAR szPathSymSrv[MAX_PATH], szPathDbgHelp[MAX_PATH];
-    PVMMWIN_PDB_INITIALIZE_KERNEL_PARAMETERS pKernelParameters = NULL;
-    if(ctxMain->pdb.fInitialized) { return; }
-    PDB_Initialize_InitialValues();
-    if(!ctxMain->pdb.fEnable) { goto fail; }
-    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMWIN_PDB_CONTEXT)))) { goto fail; }
-    if(!(ctx->pmPdbByHash = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
-    if(!(ctx->pmPdbByModule = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
-    // 1: dynamic load of dbghelp.dll and symsrv.dll from directory of vmm.dll - i.e. not from system32
     Util_GetPathDll(szPathSymSrv, ctxVmm->hModuleVmm);
     Util_GetPathDll(szPathDbgHelp, ctxVmm->hModuleVmm);
     strncat_s(szPathSymSrv, MAX_PATH, "symsrv.dll", _TRUNCATE);
@@ -756,17 +2140,16 @@ VOID PDB_Initialize(_In_opt_ PPE_CODEVIEW_INFO pPdbInfoOpt, _In_ BOOL fInitializ
     ctx->hModuleSymSrv = LoadLibraryA(szPathSymSrv);
     ctx->hModuleDbgHelp = LoadLibraryA(szPathDbgHelp);
     if(!ctx->hModuleSymSrv || !ctx->hModuleDbgHelp) {
-        vmmprintf("%s         Reason: Could not load PDB required files - symsrv.dll/dbghelp.dll.\n", VMMWIN_PDB_WARN_DEFAULT);
-        goto fail;
+        vmmprintfv_fn("Could not load PDB required files - symsrv.dll/dbghelp.dll.\n");
+        return FALSE;
     }
     for(i = 0; i < sizeof(VMMWIN_PDB_FUNCTIONS) / sizeof(PVOID); i++) {
         ctx->vafn[i] = (QWORD)GetProcAddress(ctx->hModuleDbgHelp, szVMMWIN_PDB_FUNCTIONS[i]);
         if(!ctx->vafn[i]) {
-            vmmprintf("%s         Reason: Could not load function(s) from symsrv.dll/dbghelp.dll.\n", VMMWIN_PDB_WARN_DEFAULT);
-            goto fail;
+            vmmprintfv_fn("Could not load function(s) from symsrv.dll/dbghelp.dll.\n");
+            return FALSE;
         }
     }
-    // 2: initialize dbghelp.dll
     ctx->hSym = VMMWIN_PDB_FAKEPROCHANDLE;
     dwSymOptions = ctx->pfn.SymGetOptions();
     dwSymOptions &= ~SYMOPT_DEFERRED_LOADS;
@@ -776,9 +2159,35 @@ VOID PDB_Initialize(_In_opt_ PPE_CODEVIEW_INFO pPdbInfoOpt, _In_ BOOL fInitializ
     dwSymOptions |= SYMOPT_UNDNAME;
     ctx->pfn.SymSetOptions(dwSymOptions);
     if(!ctx->pfn.SymInitialize(ctx->hSym, ctxMain->pdb.szSymbolPath, FALSE)) {
-        vmmprintf("%s         Reason: Failed to initialize Symbol Handler / dbghelp.dll.\n", VMMWIN_PDB_WARN_DEFAULT);
+        vmmprintfv_fn("Failed to initialize Symbol Handler / dbghelp.dll.\n");
         ctx->hSym = NULL;
-        goto fail;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+* Initialize the PDB sub-system. This should ideally be done on Vmm Init()
+*/
+VOID PDB_Initialize(_In_opt_ PPE_CODEVIEW_INFO pPdbInfoOpt, _In_ BOOL fInitializeKernelAsync)
+{
+    HANDLE hEventThreadStarted = 0;
+    PVMMWIN_PDB_CONTEXT ctx = NULL;
+    PVMMWIN_PDB_INITIALIZE_KERNEL_PARAMETERS pKernelParameters = NULL;
+    if(ctxMain->pdb.fInitialized) { return; }
+    PDB_Initialize_InitialValues();
+    if(!ctxMain->pdb.fEnable) { goto fail; }
+    if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMWIN_PDB_CONTEXT)))) { goto fail; }
+    if(!(ctx->pmPdbByHash = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
+    if(!(ctx->pmPdbByModule = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
+    // 1: dynamic load of dbghelp.dll and symsrv.dll - if not available symbols
+    //    are only retrieved from the local symbol cache by the native parser.
+    if(!PDB_Initialize_DbgHelp(ctx)) {
+        if(ctx->hModuleDbgHelp) { FreeLibrary(ctx->hModuleDbgHelp); }
+        if(ctx->hModuleSymSrv) { FreeLibrary(ctx->hModuleSymSrv); }
+        ctx->hModuleDbgHelp = NULL;
+        ctx->hModuleSymSrv = NULL;
+        vmmprintf("WARNING: dbghelp.dll/symsrv.dll unavailable - debug symbols are only loaded from local symbol cache.\n");
     }
     // success - finish up and load kernel .pdb async (to optimize startup time).
     // pdb subsystem won't be fully initialized until before the kernel is loaded.
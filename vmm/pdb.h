@@ -38,6 +38,48 @@ VOID PDB_Close();
 */
 VOID PDB_ConfigChange();
 
+/*
+* Initialize the on-disk kernel offset profile cache. The profile is keyed by
+* the kernel .pdb GUID+age and holds results of kernel symbol/type queries as
+* well as fuzzed kernel offsets. It should be initialized as soon as the kernel
+* base address is known and before offsets are fuzzed.
+* -- pSystemProcess
+*/
+VOID PDB_Profile_Initialize(_In_ PVMM_PROCESS pSystemProcess);
+
+/*
+* Write the kernel offset profile to disk if it has been modified.
+*/
+VOID PDB_Profile_Flush();
+
+/*
+* Flush and close the kernel offset profile. Should be done on Vmm Close().
+*/
+VOID PDB_Profile_Close();
+
+#define PDB_PROFILE_KEY_EPROCESS            0x01
+#define PDB_PROFILE_KEY_TCPE                0x02
+
+/*
+* Retrieve an item from the kernel offset profile. The stored item must be
+* exactly cb bytes in size.
+* -- qwKey = PDB_PROFILE_KEY_*
+* -- pb
+* -- cb
+* -- return
+*/
+_Success_(return)
+BOOL PDB_Profile_Get(_In_ QWORD qwKey, _Out_writes_(cb) PBYTE pb, _In_ DWORD cb);
+
+/*
+* Store an item in the kernel offset profile. The profile is written to disk
+* on the next call to PDB_Profile_Flush() or PDB_Profile_Close().
+* -- qwKey = PDB_PROFILE_KEY_*
+* -- pb
+* -- cb
+*/
+VOID PDB_Profile_Put(_In_ QWORD qwKey, _In_reads_(cb) PBYTE pb, _In_ DWORD cb);
+
 /*
 * Retrieve a PDB handle given a process and module base address. If the handle
 * is not found in the database an attempt to automatically add it is performed.
@@ -198,4 +240,37 @@ BOOL PDB_GetTypeChildOffset(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _In
 _Success_(return)
 BOOL PDB_GetTypeChildOffsetShort(_In_opt_ PDB_HANDLE hPDB, _In_ LPSTR szTypeName, _In_ LPWSTR wszTypeChildName, _Out_ PWORD pwTypeOffset);
 
+#ifdef VMM_TEST_SELFTEST
+#define PDB_SELFTEST_MISMATCH_TEXT_MAX  32
+
+typedef struct tdPDB_SELFTEST_RESULT {
+    CHAR szPdbPath[MAX_PATH];
+    DWORD cSymbol;
+    DWORD cSymbolMismatch;
+    DWORD cSymbolFromOffset;
+    DWORD cSymbolFromOffsetMismatch;
+    DWORD cType;
+    DWORD cTypeMismatch;
+    DWORD cTypeNativeOnly;
+    DWORD cTypeChild;
+    DWORD cTypeChildMismatch;
+    QWORD tmNativeUs;
+    QWORD tmDbgHelpUs;
+    DWORD cMismatchText;
+    DWORD cchMismatch;
+    CHAR szMismatch[0x2000];    // the first PDB_SELFTEST_MISMATCH_TEXT_MAX mismatches.
+} PDB_SELFTEST_RESULT, *PPDB_SELFTEST_RESULT;
+
+/*
+* Compare the native .pdb tables of the kernel against dbghelp.dll - for every
+* public symbol (name -> rva and rva -> symbol) and every struct/class/union
+* type (size and data member offsets). Test builds only (VMM_TEST_SELFTEST).
+* -- cMax = max # of symbols and types to compare (spread over the tables), 0 = all.
+* -- pr
+* -- return = TRUE if the comparison ran (check the mismatch counters).
+*/
+_Success_(return)
+BOOL PDB_SelfTest_Kernel(_In_ DWORD cMax, _Out_ PPDB_SELFTEST_RESULT pr);
+#endif /* VMM_TEST_SELFTEST */
+
 #endif /* __PDB_H__ */
@@ -253,12 +253,15 @@ BOOL PluginManager_Notify(_In_ DWORD fEvent, _In_opt_ PVOID pvEvent, _In_opt_ DW
 {
     QWORD tmStart = Statistics_CallStart();
     PPLUGIN_ENTRY pModule = (PPLUGIN_ENTRY)ctxVmm->PluginManager.FLinkNotify;
+    // notify handlers are background work - never schedule them as interactive i/o.
+    DWORD iIoClassPrevious = VmmIoSchedClassSet(max(VMM_IOSCHED_CLASS_REFRESH, VmmIoSchedClassGet()));
     while(pModule) {
         if(pModule->pfnNotify) {
             pModule->pfnNotify(fEvent, pvEvent, cbEvent);
         }
         pModule = pModule->FLinkNotify;
     }
+    VmmIoSchedClassSet(iIoClassPrevious);
     Statistics_CallEnd(STATISTICS_ID_PluginManager_Notify, tmStart);
     return TRUE;
 }
@@ -18,6 +18,447 @@
 #include "util.h"
 #include <sddl.h>
 
+// ----------------------------------------------------------------------------
+// MEMORY MAPPED RAW DUMP FILE FUNCTIONALITY:
+// Raw memory dump files (physical address == file offset) are mapped into the
+// address space. Physical reads are then serviced by a single copy directly
+// from the mapping (OS page cache) instead of via the device and the PHYS
+// cache. Other device types are unaffected and read through LeechCore.
+// NB! reads are not zero-copy views into the mapping: MEM_SCATTER buffers are
+// owned by the caller (public API) and page table / cache consumers access the
+// inline VMMOB_MEM buffer - one copy into the caller buffer remains.
+// ----------------------------------------------------------------------------
+
+/*
+* Try to memory map the backing raw memory dump file (if any). This is only
+* possible if the device is a non-volatile local file without any dump header
+* and no memory map (i.e. physical address == file offset).
+* -- return
+*/
+_Success_(return)
+BOOL VmmPhysFile_Initialize()
+{
+    LPSTR szFile;
+    PBYTE pbHdr = NULL;
+    DWORD cbHdr = 0;
+    LARGE_INTEGER cbFile;
+    if(ctxVmm->PhysFile.fActive) { return TRUE; }
+    if(ctxMain->dev.fVolatile || ctxMain->dev.fRemote || ctxMain->cfg.szMemMap[0]) { return FALSE; }
+    if(_stricmp(ctxMain->dev.szDeviceName, "file")) { return FALSE; }
+    if(LcCommand(ctxMain->hLC, LC_CMD_FILE_DUMPHEADER_GET, 0, NULL, &pbHdr, &cbHdr)) {
+        LcMemFree(pbHdr);
+        return FALSE;
+    }
+    szFile = ctxMain->dev.szDevice;
+    if(!_strnicmp(szFile, "file://", 7)) { szFile += 7; }
+    ctxVmm->PhysFile.hFile = CreateFileA(szFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if(ctxVmm->PhysFile.hFile == INVALID_HANDLE_VALUE) {
+        ctxVmm->PhysFile.hFile = NULL;
+        return FALSE;
+    }
+    if(!GetFileSizeEx(ctxVmm->PhysFile.hFile, &cbFile) || (cbFile.QuadPart < 0x1000)) { goto fail; }
+    if(!(ctxVmm->PhysFile.hMap = CreateFileMappingA(ctxVmm->PhysFile.hFile, NULL, PAGE_READONLY, 0, 0, NULL))) { goto fail; }
+    if(!(ctxVmm->PhysFile.pb = MapViewOfFile(ctxVmm->PhysFile.hMap, FILE_MAP_READ, 0, 0, 0))) { goto fail; }
+    ctxVmm->PhysFile.cb = min((QWORD)cbFile.QuadPart, ctxMain->dev.paMax ? ctxMain->dev.paMax : (QWORD)cbFile.QuadPart);
+    ctxVmm->PhysFile.fActive = TRUE;
+    vmmprintfv_fn("Memory mapped raw dump file: %s [size=%llx].\n", szFile, ctxVmm->PhysFile.cb);
+    return TRUE;
+fail:
+    VmmPhysFile_Close();
+    return FALSE;
+}
+
+VOID VmmPhysFile_Close()
+{
+    ctxVmm->PhysFile.fActive = FALSE;
+    if(ctxVmm->PhysFile.pb) {
+        UnmapViewOfFile(ctxVmm->PhysFile.pb);
+        ctxVmm->PhysFile.pb = NULL;
+    }
+    if(ctxVmm->PhysFile.hMap) {
+        CloseHandle(ctxVmm->PhysFile.hMap);
+        ctxVmm->PhysFile.hMap = NULL;
+    }
+    if(ctxVmm->PhysFile.hFile) {
+        CloseHandle(ctxVmm->PhysFile.hFile);
+        ctxVmm->PhysFile.hFile = NULL;
+    }
+    ctxVmm->PhysFile.cb = 0;
+}
+
+/*
+* Read scatter physical memory from the memory mapped raw dump file. Reads
+* outside the file or which fail due to i/o errors are not marked as success.
+* -- cMEMs
+* -- ppMEMs
+*/
+VOID VmmPhysFile_ReadScatter(_In_ DWORD cMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    DWORD i;
+    PMEM_SCATTER pMEM;
+    for(i = 0; i < cMEMs; i++) {
+        pMEM = ppMEMs[i];
+        if(pMEM->f || (pMEM->qwA == MEM_SCATTER_ADDR_INVALID)) { continue; }
+        if((pMEM->qwA >= ctxVmm->PhysFile.cb) || (pMEM->cb > ctxVmm->PhysFile.cb - pMEM->qwA)) { continue; }
+        __try {
+            memcpy(pMEM->pb, ctxVmm->PhysFile.pb + pMEM->qwA, pMEM->cb);
+            pMEM->f = TRUE;
+        } __except(GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+            ;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// COALESCED DEVICE READ FUNCTIONALITY:
+// Scatter reads passed on to LeechCore are sorted on physical address and any
+// duplicate page requests are merged. Runs of adjacent page aligned 4kB pages
+// are read with a single contiguous device read (up to a configurable max size)
+// on backends that benefit from it (non-volatile, i.e. dump files). The result
+// is scattered back into the original MEM_SCATTERs. A contiguous read is all-
+// or-nothing; failed runs are re-read scatter style to retain partial results.
+// ----------------------------------------------------------------------------
+
+int VmmReadCoalesce_CmpSort(PPMEM_SCATTER ppMEM1, PPMEM_SCATTER ppMEM2)
+{
+    QWORD qwA1 = (*ppMEM1)->qwA, qwA2 = (*ppMEM2)->qwA;
+    return (qwA1 < qwA2) ? -1 : ((qwA1 > qwA2) ? 1 : 0);
+}
+
+/*
+* Read a run of adjacent pages with one contiguous device read. Data is read
+* directly into the caller buffers if they are adjacent in memory (as is the
+* case for LcAllocScatter2 style buffers) - otherwise via a bounce buffer.
+* -- ppMEMs = address sorted adjacent page aligned 4kB MEMs.
+* -- cMEMs
+* -- cbBounce = size of bounce buffer to allocate on first use.
+* -- ppbBounce = bounce buffer - allocated on first use; free with LocalFree.
+* -- return
+*/
+_Success_(return)
+BOOL VmmReadCoalesce_ReadRun(_In_reads_(cMEMs) PPMEM_SCATTER ppMEMs, _In_ DWORD cMEMs, _In_ DWORD cbBounce, _Inout_ PBYTE *ppbBounce)
+{
+    DWORD i;
+    BOOL fDirect = TRUE;
+    for(i = 1; i < cMEMs; i++) {
+        if(ppMEMs[i]->pb != ppMEMs[0]->pb + ((SIZE_T)i << 12)) {
+            fDirect = FALSE;
+            break;
+        }
+    }
+    if(!fDirect && !*ppbBounce && !(*ppbBounce = LocalAlloc(0, cbBounce))) { return FALSE; }
+    InterlockedIncrement64(&ctxVmm->stat.coalesce.cDeviceCall);
+    if(!LcRead(ctxMain->hLC, ppMEMs[0]->qwA, cMEMs << 12, fDirect ? ppMEMs[0]->pb : *ppbBounce)) {
+        InterlockedIncrement64(&ctxVmm->stat.coalesce.cRunFail);
+        return FALSE;
+    }
+    for(i = 0; i < cMEMs; i++) {
+        if(!fDirect) {
+            memcpy(ppMEMs[i]->pb, *ppbBounce + ((SIZE_T)i << 12), 0x1000);
+        }
+        ppMEMs[i]->f = TRUE;
+    }
+    InterlockedIncrement64(&ctxVmm->stat.coalesce.cRun);
+    InterlockedAdd64(&ctxVmm->stat.coalesce.cRunPage, cMEMs);
+    return TRUE;
+}
+
+/*
+* Read scatter physical memory from LeechCore with sorting, de-duplication and
+* coalescing of adjacent pages into contiguous reads.
+* -- cMEMs
+* -- ppMEMs
+*/
+VOID VmmReadCoalesce_ReadScatter(_In_ DWORD cMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    PMEM_SCATTER pMEM, pMEMPrev;
+    PBYTE pbBounce = NULL;
+    DWORD i, j, cbMax, cSort = 0, cUnique = 0, cScatter = 0, cDuplicate = 0;
+    PPMEM_SCATTER ppSort, ppUnique, ppScatter, ppBufferLarge = NULL;
+    PMEM_SCATTER ppBufferSmall[3 * VMM_COALESCE_SMALL];
+    cbMax = ctxVmm->Coalesce.fContiguous ? (ctxVmm->Coalesce.cbMax & ~0xfff) : 0;
+    if(cMEMs > VMM_COALESCE_SMALL) {
+        if(!(ppBufferLarge = LocalAlloc(0, 3ULL * cMEMs * sizeof(PMEM_SCATTER)))) {
+            InterlockedIncrement64(&ctxVmm->stat.coalesce.cDeviceCall);
+            LcReadScatter(ctxMain->hLC, cMEMs, ppMEMs);
+            return;
+        }
+    }
+    ppSort = ppBufferLarge ? ppBufferLarge : ppBufferSmall;
+    ppUnique = ppSort + cMEMs;
+    ppScatter = ppUnique + cMEMs;
+    // 1: split into whole pages (sort & coalesce) and partial pages (scatter as-is)
+    for(i = 0; i < cMEMs; i++) {
+        pMEM = ppMEMs[i];
+        if(pMEM->f || !MEM_SCATTER_ADDR_ISVALID(pMEM)) { continue; }
+        if((pMEM->cb == 0x1000) && !(pMEM->qwA & 0xfff)) {
+            ppSort[cSort++] = pMEM;
+        } else {
+            ppScatter[cScatter++] = pMEM;
+        }
+    }
+    // 2: sort & remove duplicates
+    qsort(ppSort, cSort, sizeof(PMEM_SCATTER), (int(*)(const void*, const void*))VmmReadCoalesce_CmpSort);
+    for(i = 0; i < cSort; i++) {
+        if(i && (ppSort[i]->qwA == ppSort[i - 1]->qwA)) {
+            cDuplicate++;
+            continue;
+        }
+        ppUnique[cUnique++] = ppSort[i];
+    }
+    // 3: read contiguous runs - single pages and failed runs are scatter read
+    for(i = 0; i < cUnique; i = j) {
+        for(j = i + 1; (j < cUnique) && ((j - i) < (cbMax >> 12)) && (ppUnique[j]->qwA == ppUnique[j - 1]->qwA + 0x1000); j++);
+        if((j - i > 1) && VmmReadCoalesce_ReadRun(ppUnique + i, j - i, cbMax, &pbBounce)) { continue; }
+        memcpy(ppScatter + cScatter, ppUnique + i, (j - i) * sizeof(PMEM_SCATTER));
+        cScatter += j - i;
+    }
+    if(cScatter) {
+        InterlockedIncrement64(&ctxVmm->stat.coalesce.cDeviceCall);
+        LcReadScatter(ctxMain->hLC, cScatter, ppScatter);
+    }
+    // 4: copy result to duplicates
+    for(i = 1; i < cSort; i++) {
+        pMEM = ppSort[i];
+        pMEMPrev = ppSort[i - 1];
+        if((pMEM->qwA == pMEMPrev->qwA) && pMEMPrev->f) {
+            memcpy(pMEM->pb, pMEMPrev->pb, 0x1000);
+            pMEM->f = TRUE;
+        }
+    }
+    if(cDuplicate) {
+        InterlockedAdd64(&ctxVmm->stat.coalesce.cDuplicate, cDuplicate);
+    }
+    LocalFree(pbBounce);
+    LocalFree(ppBufferLarge);
+}
+
+_Success_(return)
+BOOL VmmReadCoalesceSet(_In_ DWORD cbMax)
+{
+    if(cbMax > VMM_COALESCE_CB_MAX) { return FALSE; }
+    ctxVmm->Coalesce.cbMax = cbMax & ~0xfff;
+    return TRUE;
+}
+
+// ----------------------------------------------------------------------------
+// I/O SCHEDULER FUNCTIONALITY:
+// Device reads are arbitrated between three priority classes: interactive
+// (api/vfs - default), refresh (background refresh thread and plugin notify)
+// and bulk (forensic scans). The class is a per-thread property which is
+// inherited by work units and async reads submitted by the thread. Device
+// reads of the background classes are sliced into reads of at most cSlice
+// pages, each slice is scheduled separately. Waiting reads are kept in per-
+// class FIFO queues and dispatched earliest deadline first; the deadline of a
+// read is its enqueue time plus a per-class grace period - background reads
+// thus cannot starve each other. Interactive reads are not arbitrated: they
+// are never queued nor limited and pass queued background reads between the
+// slices. The number of concurrently dispatched background device reads is
+// limited to the async read depth (min 1).
+// ----------------------------------------------------------------------------
+
+typedef struct tdVMM_IOSCHED_REQUEST {
+    struct tdVMM_IOSCHED_REQUEST *FLink;
+    QWORD tcDeadline;
+    BOOL fGranted;
+} VMM_IOSCHED_REQUEST, *PVMM_IOSCHED_REQUEST;
+
+static const DWORD VMM_IOSCHED_DEADLINE_US[VMM_IOSCHED_CLASS_MAX] = { 0, 20000, 100000 };
+
+// per-thread i/o priority class (stored as class + 1). The tls index is
+// allocated once per process and is never freed since api threads may query
+// the class concurrently with, or after, VmmClose.
+static DWORD g_dwVmmIoSchedTlsIndex = TLS_OUT_OF_INDEXES;
+
+DWORD VmmIoSchedClassGet()
+{
+    DWORD iClass;
+    if(!ctxVmm->IoSched.fActive) { return VMM_IOSCHED_CLASS_INTERACTIVE; }
+    iClass = (DWORD)(SIZE_T)TlsGetValue(g_dwVmmIoSchedTlsIndex);
+    return (iClass && (iClass <= VMM_IOSCHED_CLASS_MAX)) ? (iClass - 1) : VMM_IOSCHED_CLASS_INTERACTIVE;
+}
+
+DWORD VmmIoSchedClassSet(_In_ DWORD iClass)
+{
+    DWORD iClassPrevious = VmmIoSchedClassGet();
+    if(ctxVmm->IoSched.fActive && (iClass < VMM_IOSCHED_CLASS_MAX)) {
+        TlsSetValue(g_dwVmmIoSchedTlsIndex, (LPVOID)(SIZE_T)(iClass + 1));
+    }
+    return iClassPrevious;
+}
+
+_Success_(return)
+BOOL VmmIoSchedSliceSet(_In_ DWORD cSlice)
+{
+    if(cSlice > VMM_IOSCHED_SLICE_MAX) { return FALSE; }
+    ctxVmm->IoSched.cSlice = cSlice;
+    return TRUE;
+}
+
+QWORD VmmIoSched_TickCount()
+{
+    QWORD tc;
+    QueryPerformanceCounter((PLARGE_INTEGER)&tc);
+    return tc;
+}
+
+/*
+* Dispatch queued background requests as long as there are free device slots.
+* The queued request with the earliest deadline is dispatched first.
+* NB! LockSRW must be held by caller.
+* -- return = TRUE if at least one request was dispatched (waiters should be woken).
+*/
+BOOL VmmIoSched_DispatchNext()
+{
+    BOOL fResult = FALSE;
+    DWORD i, iBest;
+    PVMM_IOSCHED_REQUEST prq;
+    while(ctxVmm->IoSched.cActive < max(1, ctxVmm->ReadAsync.cDepth)) {
+        for(i = 0, iBest = VMM_IOSCHED_CLASS_MAX; i < VMM_IOSCHED_CLASS_MAX; i++) {
+            if(!ctxVmm->IoSched.pQueueHead[i]) { continue; }
+            if((iBest == VMM_IOSCHED_CLASS_MAX) || (ctxVmm->IoSched.pQueueHead[i]->tcDeadline < ctxVmm->IoSched.pQueueHead[iBest]->tcDeadline)) {
+                iBest = i;
+            }
+        }
+        if(iBest == VMM_IOSCHED_CLASS_MAX) { break; }
+        prq = ctxVmm->IoSched.pQueueHead[iBest];
+        ctxVmm->IoSched.pQueueHead[iBest] = prq->FLink;
+        if(!prq->FLink) {
+            ctxVmm->IoSched.pQueueTail[iBest] = NULL;
+        }
+        prq->fGranted = TRUE;
+        ctxVmm->IoSched.cActive++;
+        fResult = TRUE;
+    }
+    return fResult;
+}
+
+/*
+* Acquire a device slot for a device read of the given background class. The
+* function blocks until the read is dispatched by the scheduler.
+* -- iClass = VMM_IOSCHED_CLASS_REFRESH or VMM_IOSCHED_CLASS_BULK.
+*/
+VOID VmmIoSched_Acquire(_In_ DWORD iClass)
+{
+    QWORD tcStart, usWait, usWaitMax;
+    VMM_IOSCHED_REQUEST rq = { 0 };
+    tcStart = VmmIoSched_TickCount();
+    InterlockedIncrement64(&ctxVmm->stat.iosched[iClass].cSlice);
+    AcquireSRWLockExclusive(&ctxVmm->IoSched.LockSRW);
+    if(!ctxVmm->IoSched.pQueueHead[VMM_IOSCHED_CLASS_REFRESH] && !ctxVmm->IoSched.pQueueHead[VMM_IOSCHED_CLASS_BULK] && (ctxVmm->IoSched.cActive < max(1, ctxVmm->ReadAsync.cDepth))) {
+        // fast path - free background slot and no waiters.
+        ctxVmm->IoSched.cActive++;
+        ReleaseSRWLockExclusive(&ctxVmm->IoSched.LockSRW);
+        return;
+    }
+    rq.tcDeadline = tcStart + VMM_IOSCHED_DEADLINE_US[iClass] * ctxVmm->IoSched.qwFreq / 1000000;
+    if(ctxVmm->IoSched.pQueueTail[iClass]) {
+        ctxVmm->IoSched.pQueueTail[iClass]->FLink = &rq;
+    } else {
+        ctxVmm->IoSched.pQueueHead[iClass] = &rq;
+    }
+    ctxVmm->IoSched.pQueueTail[iClass] = &rq;
+    while(!rq.fGranted) {
+        SleepConditionVariableSRW(&ctxVmm->IoSched.CondGrant, &ctxVmm->IoSched.LockSRW, INFINITE, 0);
+    }
+    ReleaseSRWLockExclusive(&ctxVmm->IoSched.LockSRW);
+    usWait = (VmmIoSched_TickCount() - tcStart) * 1000000 / max(1, ctxVmm->IoSched.qwFreq);
+    InterlockedIncrement64(&ctxVmm->stat.iosched[iClass].cWait);
+    InterlockedAdd64(&ctxVmm->stat.iosched[iClass].usWaitTotal, usWait);
+    while((usWaitMax = ctxVmm->stat.iosched[iClass].usWaitMax) < usWait) {
+        if((QWORD)InterlockedCompareExchange64((volatile LONG64*)&ctxVmm->stat.iosched[iClass].usWaitMax, usWait, usWaitMax) == usWaitMax) { break; }
+    }
+}
+
+/*
+* Release a device slot acquired by VmmIoSched_Acquire and dispatch any queued
+* requests onto the freed slot.
+*/
+VOID VmmIoSched_Release()
+{
+    BOOL fWake;
+    AcquireSRWLockExclusive(&ctxVmm->IoSched.LockSRW);
+    ctxVmm->IoSched.cActive--;
+    fWake = VmmIoSched_DispatchNext();
+    ReleaseSRWLockExclusive(&ctxVmm->IoSched.LockSRW);
+    if(fWake) {
+        WakeAllConditionVariable(&ctxVmm->IoSched.CondGrant);
+    }
+}
+
+VOID VmmIoSched_Initialize()
+{
+    if(g_dwVmmIoSchedTlsIndex == TLS_OUT_OF_INDEXES) {
+        if((g_dwVmmIoSchedTlsIndex = TlsAlloc()) == TLS_OUT_OF_INDEXES) { return; }
+    }
+    QueryPerformanceFrequency((PLARGE_INTEGER)&ctxVmm->IoSched.qwFreq);
+    InitializeSRWLock(&ctxVmm->IoSched.LockSRW);
+    InitializeConditionVariable(&ctxVmm->IoSched.CondGrant);
+    ctxVmm->IoSched.cSlice = VMM_IOSCHED_SLICE_DEFAULT;
+    ctxVmm->IoSched.fActive = TRUE;
+}
+
+VOID VmmIoSched_Close()
+{
+    ctxVmm->IoSched.fActive = FALSE;
+}
+
+/*
+* Read scatter physical memory from the underlying device without scheduling.
+* -- cMEMs
+* -- ppMEMs
+*/
+VOID VmmReadScatterDevice_DoWork(_In_ DWORD cMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+#ifdef VMM_TEST_LATENCY_INJECT
+    if(ctxVmm->ReadAsync.cMsLatencyInject) {
+        Sleep(ctxVmm->ReadAsync.cMsLatencyInject);
+    }
+#endif /* VMM_TEST_LATENCY_INJECT */
+    if(ctxVmm->PhysFile.fActive) {
+        VmmPhysFile_ReadScatter(cMEMs, ppMEMs);
+        return;
+    }
+    InterlockedAdd64(&ctxVmm->stat.coalesce.cPage, cMEMs);
+    if((cMEMs > 1) && ctxVmm->Coalesce.cbMax) {
+        VmmReadCoalesce_ReadScatter(cMEMs, ppMEMs);
+    } else {
+        InterlockedIncrement64(&ctxVmm->stat.coalesce.cDeviceCall);
+        LcReadScatter(ctxMain->hLC, cMEMs, ppMEMs);
+    }
+}
+
+/*
+* Read scatter physical memory from the underlying device - either directly
+* from a memory mapped raw dump file or from LeechCore. No caching is done.
+* Reads of the background i/o priority classes of the calling thread are
+* sliced and scheduled by the i/o scheduler, interactive reads are issued
+* directly.
+* -- cMEMs
+* -- ppMEMs
+*/
+VOID VmmReadScatterDevice(_In_ DWORD cMEMs, _Inout_ PPMEM_SCATTER ppMEMs)
+{
+    DWORD i, c, cSlice, iClass;
+    if(!cMEMs) { return; }
+    if(!ctxVmm->IoSched.fActive || !(cSlice = ctxVmm->IoSched.cSlice)) {
+        VmmReadScatterDevice_DoWork(cMEMs, ppMEMs);
+        return;
+    }
+    iClass = VmmIoSchedClassGet();
+    InterlockedIncrement64(&ctxVmm->stat.iosched[iClass].cRequest);
+    if(iClass == VMM_IOSCHED_CLASS_INTERACTIVE) {
+        VmmReadScatterDevice_DoWork(cMEMs, ppMEMs);
+        return;
+    }
+    for(i = 0; i < cMEMs; i += c) {
+        c = min(cSlice, cMEMs - i);
+        VmmIoSched_Acquire(iClass);
+        VmmReadScatterDevice_DoWork(c, ppMEMs + i);
+        VmmIoSched_Release();
+    }
+}
+
 // ----------------------------------------------------------------------------
 // CACHE FUNCTIONALITY:
 // PHYSICAL MEMORY CACHING FOR READS AND PAGE TABLES
@@ -40,53 +481,121 @@ PVMM_CACHE_TABLE VmmCacheTableGet(_In_ DWORD wTblTag)
     }
 }
 
-#define VMM_CACHE2_GET_REGION(qwA)      ((qwA >> 12) % VMM_CACHE2_REGIONS)
-#define VMM_CACHE2_GET_BUCKET(qwA)      ((qwA >> 12) % VMM_CACHE2_BUCKETS)
+#define VMM_CACHE2_GET_SHARD(t, qwA)    ((DWORD)(((qwA >> 12) * 0x9E3779B97F4A7C15) >> 40) & (t->cShard - 1))
+#define VMM_CACHE2_GET_BUCKET(pB, qwA)  ((DWORD)((qwA >> 12) % pB->cB))
+
+/*
+* Advance the epoch of a shard if all readers of the previous epoch have left.
+* Entries retired during the previous epoch can no longer be referenced by any
+* lock-free reader and are released - the refcount callback will take care of
+* re-insertion into the empty list. Retired bucket arrays are free'd.
+* NB! shard lock must be held by caller.
+* -- s
+*/
+VOID VmmCacheShardEpochAdvance(_In_ PVMM_CACHE_SHARD s)
+{
+    DWORD iPrev;
+    PVMMOB_MEM pOb, pObNext;
+    iPrev = (s->iEpoch + 1) & 1;
+    if(InterlockedCompareExchange(&s->cReaders[iPrev], 0, 0)) { return; }
+    pOb = s->Retire[iPrev];
+    s->Retire[iPrev] = NULL;
+    LocalFree(s->RetireBuckets[iPrev]);
+    s->RetireBuckets[iPrev] = NULL;
+    InterlockedIncrement(&s->iEpoch);
+    while(pOb) {
+        pObNext = pOb->RetireFLink;
+        pOb->RetireFLink = NULL;
+        s->cRetired--;
+        Ob_DECREF(pOb);
+        pOb = pObNext;
+    }
+}
+
+/*
+* Detach an entry from the clock ring of a shard and put it on the retire list
+* of the current epoch. The bucket chain is not touched - the caller is
+* responsible for unlinking the entry.
+* NB! shard lock must be held by caller.
+* -- s
+* -- pOb
+*/
+VOID VmmCacheShardRetire(_In_ PVMM_CACHE_SHARD s, _In_ PVMMOB_MEM pOb)
+{
+    // detach clock ring
+    if(pOb->ClockFLink == pOb) {
+        s->ClockHand = NULL;
+    } else {
+        pOb->ClockBLink->ClockFLink = pOb->ClockFLink;
+        pOb->ClockFLink->ClockBLink = pOb->ClockBLink;
+        if(s->ClockHand == pOb) {
+            s->ClockHand = pOb->ClockFLink;
+        }
+    }
+    pOb->ClockFLink = NULL;
+    pOb->ClockBLink = NULL;
+    // retire - region refcount is released on epoch advance.
+    pOb->RetireFLink = s->Retire[s->iEpoch & 1];
+    s->Retire[s->iEpoch & 1] = pOb;
+    s->cRetired++;
+    s->c--;
+}
+
+/*
+* Detach an entry from the bucket chain and the clock ring of a shard and put
+* it on the retire list of the current epoch. The forward link of the entry is
+* kept intact so that concurrent lock-free readers may continue their walk.
+* NB! shard lock must be held by caller.
+* -- s
+* -- pOb
+*/
+VOID VmmCacheShardRemove(_In_ PVMM_CACHE_SHARD s, _In_ PVMMOB_MEM pOb)
+{
+    PVMMOB_MEM volatile *ppOb;
+    // detach bucket
+    ppOb = &s->pB->B[VMM_CACHE2_GET_BUCKET(s->pB, pOb->h.qwA)];
+    while(*ppOb && (*ppOb != pOb)) {
+        ppOb = &(*ppOb)->FLink;
+    }
+    if(!*ppOb) {
+        vmmprintf_fn("ERROR - SHOULD NOT HAPPEN - OBJECT NOT IN BUCKET\n");
+        return;
+    }
+    *ppOb = pOb->FLink;
+    VmmCacheShardRetire(s, pOb);
+}
 
 /*
 * Invalidate a cache entry (if exists)
 */
 VOID VmmCacheInvalidate_2(_In_ DWORD dwTblTag, _In_ QWORD qwA)
 {
-    DWORD iR, iB;
+    BOOL fRemove = FALSE;
     PVMM_CACHE_TABLE t;
+    PVMM_CACHE_SHARD s;
     PVMMOB_MEM pOb, pObNext;
     t = VmmCacheTableGet(dwTblTag);
     if(!t || !t->fActive) { return; }
-    iR = VMM_CACHE2_GET_REGION(qwA);
-    iB = VMM_CACHE2_GET_BUCKET(qwA);
-    EnterCriticalSection(&t->R[iR].Lock);
-    pOb = t->R[iR].B[iB];
+    s = &t->S[VMM_CACHE2_GET_SHARD(t, qwA)];
+    EnterCriticalSection(&s->Lock);
+    pOb = s->pB->B[VMM_CACHE2_GET_BUCKET(s->pB, qwA)];
     while(pOb) {
         pObNext = pOb->FLink;
         if(pOb->h.qwA == qwA) {
-            // detach bucket
-            if(pOb->BLink) {
-                pOb->BLink->FLink = pOb->FLink;
-            } else {
-                t->R[iR].B[iB] = pOb->FLink;
-            }
-            if(pOb->FLink) {
-                pOb->FLink->BLink = pOb->BLink;
-            }
-            // detach age list
-            if(pOb->AgeBLink) {
-                pOb->AgeBLink->AgeFLink = pOb->AgeFLink;
-            } else {
-                t->R[iR].AgeFLink = pOb->AgeFLink;
-            }
-            if(pOb->AgeFLink) {
-                pOb->AgeFLink->AgeBLink = pOb->AgeBLink;
-            } else {
-                t->R[iR].AgeBLink = pOb->AgeBLink;
-            }
-            // decrease count & decref
-            InterlockedDecrement(&t->R[iR].c);
-            Ob_DECREF(pOb);
+            VmmCacheShardRemove(s, pOb);
+            fRemove = TRUE;
         }
         pOb = pObNext;
     }
-    LeaveCriticalSection(&t->R[iR].Lock);
+    VmmCacheShardEpochAdvance(s);
+    LeaveCriticalSection(&s->Lock);
+    // an invalidated page table -> invalidate process translation caches.
+    // NB! page tables evicted by the CLOCK reclaim do not invalidate - the
+    //     translations derived from them remain valid until the next TLB
+    //     cache clear (refresh) just as the page tables would have.
+    if(fRemove && (dwTblTag == VMM_CACHE_TAG_TLB)) {
+        VmmVTlbInvalidateAll();
+    }
 }
 
 VOID VmmCacheInvalidate(_In_ QWORD pa)
@@ -95,38 +604,40 @@ VOID VmmCacheInvalidate(_In_ QWORD pa)
     VmmCacheInvalidate_2(VMM_CACHE_TAG_PHYS, pa);
 }
 
-VOID VmmCacheReclaim(_In_ PVMM_CACHE_TABLE t, _In_ DWORD iR, _In_ BOOL fTotal)
+/*
+* Evict entries from a shard using the CLOCK (second chance) algorithm. Entries
+* that have been hit since the clock hand last passed are given another round.
+* -- t
+* -- iS = shard index.
+* -- fTotal = evict all entries (regardless of reference bit).
+*/
+VOID VmmCacheReclaim(_In_ PVMM_CACHE_TABLE t, _In_ DWORD iS, _In_ BOOL fTotal)
 {
-    DWORD cThreshold;
+    DWORD cThreshold, cSweep = 0;
     PVMMOB_MEM pOb;
-    EnterCriticalSection(&t->R[iR].Lock);
-    cThreshold = fTotal ? 0 : max(0x10, t->R[iR].c >> 1);
-    while(t->R[iR].c > cThreshold) {
-        // get
-        pOb = t->R[iR].AgeBLink;
+    PVMM_CACHE_SHARD s = &t->S[iS];
+    EnterCriticalSection(&s->Lock);
+    cThreshold = fTotal ? 0 : max(0x10, s->c >> 1);
+    while(s->c > cThreshold) {
+        pOb = s->ClockHand;
         if(!pOb) {
             vmmprintf_fn("ERROR - SHOULD NOT HAPPEN - NULL OBJECT RETRIEVED\n");
             break;
         }
-        // detach from age list
-        t->R[iR].AgeBLink = pOb->AgeBLink;
-        if(pOb->AgeBLink) {
-            pOb->AgeBLink->AgeFLink = NULL;
-        } else {
-            t->R[iR].AgeFLink = NULL;
-        }
-        // detach from bucket list
-        if(pOb->BLink) {
-            pOb->BLink->FLink = NULL;
-        } else {
-            t->R[iR].B[VMM_CACHE2_GET_BUCKET(pOb->h.qwA)] = NULL;
+        // second chance - bounded to one full sweep to guarantee progress
+        // even if readers keep re-setting the reference bit.
+        if(!fTotal && pOb->fClockRef && (cSweep++ < s->c)) {
+            pOb->fClockRef = FALSE;
+            s->ClockHand = pOb->ClockFLink;
+            continue;
         }
-        // remove region refcount of object - callback will take care of
-        // re-insertion into empty list when refcount becomes low enough.
-        Ob_DECREF(pOb);
-        InterlockedDecrement(&t->R[iR].c);
+        VmmCacheShardRemove(s, pOb);
     }
-    LeaveCriticalSection(&t->R[iR].Lock);
+    VmmCacheShardEpochAdvance(s);
+    if(fTotal) {
+        VmmCacheShardEpochAdvance(s);
+    }
+    LeaveCriticalSection(&s->Lock);
 }
 
 /*
@@ -140,11 +651,16 @@ VOID VmmCacheClear(_In_ DWORD dwTblTag)
     PVMM_PROCESS pObProcess = NULL;
     // 1: clear cache
     t = VmmCacheTableGet(dwTblTag);
-    for(i = 0; i < VMM_CACHE2_REGIONS; i++) {
+    for(i = 0; i < t->cShard; i++) {
         VmmCacheReclaim(t, i, TRUE);
     }
-    // 2: if tlb cache clear -> update process 'is spider done' flag
+    if(dwTblTag == VMM_CACHE_TAG_PAGING) {
+        InterlockedIncrement((volatile LONG*)&ctxVmm->Cache.dwPagingGeneration);
+    }
+    // 2: if tlb cache clear -> invalidate process translation caches and
+    //    update process 'is spider done' flag
     if(dwTblTag == VMM_CACHE_TAG_TLB) {
+        VmmVTlbInvalidateAll();
         while((pObProcess = VmmProcessGetNext(pObProcess, 0))) {
             if(pObProcess->fTlbSpiderDone) {
                 EnterCriticalSection(&pObProcess->LockUpdate);
@@ -163,7 +679,11 @@ VOID VmmCache_CallbackRefCount1(PVMMOB_MEM pOb)
         vmmprintf_fn("ERROR - SHOULD NOT HAPPEN - INVALID OBJECT TAG %02X\n", ((POB)pOb)->_tag);
         return;
     }
-    if(!t->fActive) { return; }
+    if(pOb->tpReadAhead && InterlockedExchange(&pOb->tpReadAhead, 0)) {
+        // read-ahead entry released without ever being hit.
+        InterlockedIncrement64(&ctxVmm->stat.readahead.cWasted);
+    }
+    if(!t->fActive || pOb->fDiscard) { return; }
     Ob_INCREF(pOb);
     InterlockedPushEntrySList(&t->ListHeadEmpty, &pOb->SListEmpty);
     InterlockedIncrement(&t->cEmpty);
@@ -177,8 +697,9 @@ VOID VmmCache_CallbackRefCount1(PVMMOB_MEM pOb)
 */
 VOID VmmCacheReserveReturn(_In_opt_ PVMMOB_MEM pOb)
 {
-    DWORD iR, iB;
+    DWORD iB;
     PVMM_CACHE_TABLE t;
+    PVMM_CACHE_SHARD s;
     if(!pOb) { return; }
     t = VmmCacheTableGet(((POB)pOb)->_tag);
     if(!t) {
@@ -191,23 +712,28 @@ VOID VmmCacheReserveReturn(_In_opt_ PVMMOB_MEM pOb)
         Ob_DECREF(pOb);
         return;
     }
-    // insert into map - refcount will be overtaken by "cache region".
-    iR = VMM_CACHE2_GET_REGION(pOb->h.qwA);
-    iB = VMM_CACHE2_GET_BUCKET(pOb->h.qwA);
-    EnterCriticalSection(&t->R[iR].Lock);
-    // insert into "bucket"
-    pOb->BLink = NULL;
-    pOb->FLink = t->R[iR].B[iB];
-    if(pOb->FLink) { pOb->FLink->BLink = pOb; }
-    t->R[iR].B[iB] = pOb;
-    // insert into "age list"
-    pOb->AgeFLink = t->R[iR].AgeFLink;
-    if(pOb->AgeFLink) { pOb->AgeFLink->AgeBLink = pOb; }
-    pOb->AgeBLink = NULL;
-    t->R[iR].AgeFLink = pOb;
-    if(!t->R[iR].AgeBLink) { t->R[iR].AgeBLink = pOb; }
-    InterlockedIncrement(&t->R[iR].c);
-    LeaveCriticalSection(&t->R[iR].Lock);
+    // insert into shard - refcount will be overtaken by "cache shard".
+    s = &t->S[VMM_CACHE2_GET_SHARD(t, pOb->h.qwA)];
+    pOb->fClockRef = FALSE;
+    EnterCriticalSection(&s->Lock);
+    iB = VMM_CACHE2_GET_BUCKET(s->pB, pOb->h.qwA);
+    // insert into clock ring (just behind the clock hand)
+    if(s->ClockHand) {
+        pOb->ClockFLink = s->ClockHand;
+        pOb->ClockBLink = s->ClockHand->ClockBLink;
+        pOb->ClockBLink->ClockFLink = pOb;
+        s->ClockHand->ClockBLink = pOb;
+    } else {
+        pOb->ClockFLink = pOb;
+        pOb->ClockBLink = pOb;
+        s->ClockHand = pOb;
+    }
+    // publish in bucket - entry must be fully initialized before it becomes
+    // visible to lock-free readers.
+    pOb->FLink = s->pB->B[iB];
+    InterlockedExchangePointer((PVOID volatile*)&s->pB->B[iB], pOb);
+    s->c++;
+    LeaveCriticalSection(&s->Lock);
 }
 
 PVMMOB_MEM VmmCacheReserve(_In_ DWORD dwTblTag)
@@ -215,11 +741,11 @@ PVMMOB_MEM VmmCacheReserve(_In_ DWORD dwTblTag)
     PVMM_CACHE_TABLE t;
     PVMMOB_MEM pOb;
     PSLIST_ENTRY e;
-    WORD iReclaimLast, cLoopProtect = 0;
+    DWORD iReclaimLast, cLoopProtect = 0;
     t = VmmCacheTableGet(dwTblTag);
     if(!t || !t->fActive) { return NULL; }
     while(!(e = InterlockedPopEntrySList(&t->ListHeadEmpty))) {
-        if(t->cTotal < VMM_CACHE2_MAX_ENTRIES) {
+        if(t->cTotal < t->cMaxEntries) {
             // below max threshold -> create new
             pOb = Ob_Alloc(t->tag, LMEM_ZEROINIT, sizeof(VMMOB_MEM), NULL, VmmCache_CallbackRefCount1);
             if(!pOb) { return NULL; }
@@ -232,10 +758,11 @@ PVMMOB_MEM VmmCacheReserve(_In_ DWORD dwTblTag)
             InterlockedIncrement(&t->cTotal);
             return pOb;         // return fresh object - refcount = 2.
         }
-        // reclaim existing entries
-        iReclaimLast = InterlockedIncrement16(&t->iReclaimLast);
-        VmmCacheReclaim(t, iReclaimLast % VMM_CACHE2_REGIONS, FALSE);
-        if(++cLoopProtect == VMM_CACHE2_REGIONS) {
+        // reclaim existing entries (cache full -> good time to re-split budget)
+        VmmCacheBudgetRebalanceRequest();
+        iReclaimLast = InterlockedIncrement(&t->iReclaimLast);
+        VmmCacheReclaim(t, iReclaimLast % t->cShard, FALSE);
+        if(++cLoopProtect == t->cShard) {
             vmmprintf_fn("ERROR - SHOULD NOT HAPPEN - CACHE %04X DRAINED OF ENTRIES\n", dwTblTag);
             Sleep(10);
         }
@@ -247,21 +774,37 @@ PVMMOB_MEM VmmCacheReserve(_In_ DWORD dwTblTag)
     return pOb; // reference overtaken by callee (from EmptyList)
 }
 
+/*
+* Retrieve an entry from the cache. The lookup is lock-free; the reader only
+* registers itself in the current epoch of the shard to prevent concurrently
+* evicted entries from being recycled while they are being looked at.
+* CALLER DECREF: return
+* -- dwTblTag
+* -- qwA
+* -- return
+*/
 PVMMOB_MEM VmmCacheGet(_In_ DWORD dwTblTag, _In_ QWORD qwA)
 {
     PVMM_CACHE_TABLE t;
-    DWORD iR;
+    PVMM_CACHE_SHARD s;
+    PVMM_CACHE_BUCKETS pB;
     PVMMOB_MEM pOb;
+    DWORD iEpoch;
     t = VmmCacheTableGet(dwTblTag);
     if(!t || !t->fActive) { return NULL; }
-    iR = VMM_CACHE2_GET_REGION(qwA);
-    EnterCriticalSection(&t->R[iR].Lock);
-    pOb = t->R[iR].B[VMM_CACHE2_GET_BUCKET(qwA)];
+    s = &t->S[VMM_CACHE2_GET_SHARD(t, qwA)];
+    iEpoch = s->iEpoch & 1;
+    InterlockedIncrement(&s->cReaders[iEpoch]);
+    pB = s->pB;
+    pOb = pB->B[VMM_CACHE2_GET_BUCKET(pB, qwA)];
     while(pOb && (qwA != pOb->h.qwA)) {
         pOb = pOb->FLink;
     }
-    Ob_INCREF(pOb);
-    LeaveCriticalSection(&t->R[iR].Lock);
+    if(pOb) {
+        if(!pOb->fClockRef) { pOb->fClockRef = TRUE; }
+        Ob_INCREF(pOb);
+    }
+    InterlockedDecrement(&s->cReaders[iEpoch]);
     return pOb;
 }
 
@@ -281,7 +824,7 @@ PVMMOB_MEM VmmCacheGet_FromDeviceOnMiss(_In_ DWORD dwTblTag, _In_ DWORD dwTblTag
             pObMEM = NULL;
         }
         if(!pMEM->f) {
-            LcReadScatter(ctxMain->hLC, 1, &pMEM);
+            VmmReadScatterDevice(1, &pMEM);
         }
         if(pMEM->f) {
             Ob_INCREF(pObReservedMEM);
@@ -333,20 +876,274 @@ PVMMOB_MEM VmmTlbGetPageTable(_In_ QWORD pa, _In_ BOOL fCacheOnly)
     return NULL;
 }
 
+/*
+* Retrieve a suitable (prime) number of buckets per shard given the current
+* max number of entries of the cache table. The bucket count is scaled so that
+* it's at least the number of entries per shard (load factor <= 1) to keep the
+* lock-free bucket chains short.
+* -- t
+* -- return
+*/
+DWORD VmmCacheBucketCount(_In_ PVMM_CACHE_TABLE t)
+{
+    const DWORD BUCKETS[] = { 509, 1021, 2039, 4093, 8191, 16381, 32749, 65521, 131071, 262139, 524287, 1048573 };
+    DWORD i, cTarget = max(VMM_CACHE2_BUCKETS, t->cMaxEntries / t->cShard);
+    for(i = 0; (i < sizeof(BUCKETS) / sizeof(DWORD) - 1) && (BUCKETS[i] < cTarget); i++);
+    return BUCKETS[i];
+}
+
+/*
+* Replace the bucket array of a shard with a new array of cB buckets and rehash
+* the live entries of the shard into it. The new chains are built privately and
+* then published. Concurrent lock-free readers of the old array may be led into
+* a chain of the new array by a re-linked entry - all chains are terminated and
+* all entries remain live (epoch protected) so such a reader may at worst miss,
+* which is harmless for a cache. The old array is retired until no readers may
+* reference it any longer.
+* NB! shard lock must be held by caller.
+* -- s
+* -- cB
+* -- return = FALSE if the array could not be replaced (the shard is unchanged).
+*/
+_Success_(return)
+BOOL VmmCacheShardBucketsResize(_In_ PVMM_CACHE_SHARD s, _In_ DWORD cB)
+{
+    DWORD iB, cRetry = 0;
+    PVMMOB_MEM pOb;
+    PVMM_CACHE_BUCKETS pBOld = s->pB, pBNew;
+    if(pBOld->cB == cB) { return TRUE; }
+    // previous array not yet free'd -> wait for its (short lived) readers.
+    VmmCacheShardEpochAdvance(s);
+    while(s->RetireBuckets[s->iEpoch & 1]) {
+        if(++cRetry > 0x1000) { return FALSE; }
+        SwitchToThread();
+        VmmCacheShardEpochAdvance(s);
+    }
+    if(!(pBNew = LocalAlloc(LMEM_ZEROINIT, sizeof(VMM_CACHE_BUCKETS) + cB * sizeof(PVMMOB_MEM)))) { return FALSE; }
+    pBNew->cB = cB;
+    if((pOb = s->ClockHand)) {
+        do {
+            iB = VMM_CACHE2_GET_BUCKET(pBNew, pOb->h.qwA);
+            InterlockedExchangePointer((PVOID volatile*)&pOb->FLink, pBNew->B[iB]);
+            pBNew->B[iB] = pOb;
+            pOb = pOb->ClockFLink;
+        } while(pOb != s->ClockHand);
+    }
+    InterlockedExchangePointer((PVOID volatile*)&s->pB, pBNew);
+    s->RetireBuckets[s->iEpoch & 1] = pBOld;
+    return TRUE;
+}
+
+VOID VmmCacheResize(_In_ DWORD dwTblTag, _In_ DWORD cMaxEntries)
+{
+    DWORD i, cB, cBShard, cDiscard = 0, cLoopProtect = 0, cFail = 0;
+    PVMM_CACHE_TABLE t;
+    PVMMOB_MEM pOb, pObDiscard = NULL;
+    PSLIST_ENTRY e, eNext;
+    t = VmmCacheTableGet(dwTblTag);
+    if(!t || !t->fActive) { return; }
+    cMaxEntries = max(VMM_CACHE2_MIN_ENTRIES, cMaxEntries);
+    EnterCriticalSection(&t->LockResize);
+    t->cMaxEntries = cMaxEntries;
+    // 1: collect surplus entries from the empty list (evict if required).
+    //    entries are flagged as discarded - this prevents the refcount
+    //    callback from re-inserting them into the empty list.
+    while((t->cTotal > cMaxEntries + cDiscard) && (cLoopProtect < 4 * t->cShard)) {
+        if(!(e = InterlockedPopEntrySList(&t->ListHeadEmpty))) {
+            VmmCacheReclaim(t, InterlockedIncrement(&t->iReclaimLast) % t->cShard, FALSE);
+            cLoopProtect++;
+            continue;
+        }
+        cLoopProtect = 0;
+        InterlockedDecrement(&t->cEmpty);
+        pOb = CONTAINING_RECORD(e, VMMOB_MEM, SListEmpty);
+        pOb->fDiscard = TRUE;
+        pOb->RetireFLink = pObDiscard;
+        pObDiscard = pOb;
+        cDiscard++;
+    }
+    // 2: remove discarded entries from the "total list" and free them.
+    if(cDiscard) {
+        e = InterlockedFlushSList(&t->ListHeadTotal);
+        while(e) {
+            eNext = e->Next;
+            if(!CONTAINING_RECORD(e, VMMOB_MEM, SListTotal)->fDiscard) {
+                InterlockedPushEntrySList(&t->ListHeadTotal, e);
+            }
+            e = eNext;
+        }
+        while((pOb = pObDiscard)) {
+            pObDiscard = pOb->RetireFLink;
+            InterlockedDecrement(&t->cTotal);
+            Ob_DECREF(pOb);     // "empty list" reference
+            Ob_DECREF(pOb);     // "total list" reference -> free
+        }
+    }
+    // 3: resize shard bucket arrays to match the new capacity. The arrays are
+    //    grown at once but only shrunk once they are more than one size step
+    //    too large (hysteresis) - a fluctuating budget should not rehash.
+    cB = VmmCacheBucketCount(t);
+    for(i = 0; i < t->cShard; i++) {
+        EnterCriticalSection(&t->S[i].Lock);
+        cBShard = t->S[i].pB->cB;
+        if(((cB > cBShard) || (2 * cB < cBShard)) && !VmmCacheShardBucketsResize(&t->S[i], cB)) {
+            cFail++;
+        }
+        LeaveCriticalSection(&t->S[i].Lock);
+    }
+    if(cFail) {
+        vmmprintfv_fn("WARNING: cache %04X: %i/%i shard bucket arrays not resized - retry on next resize.\n", dwTblTag, cFail, t->cShard);
+    }
+    LeaveCriticalSection(&t->LockResize);
+}
+
+const DWORD VMM_CACHE_BUDGET_TAG[3] = { VMM_CACHE_TAG_PHYS, VMM_CACHE_TAG_TLB, VMM_CACHE_TAG_PAGING };
+
+/*
+* Retrieve the number of cache misses (reads that had to be serviced by the
+* device or paging subsystem) and cache hits per cache table from statistics.
+* -- cMiss = PHYS, TLB, PAGING
+* -- cHit = PHYS, TLB, PAGING
+*/
+VOID VmmCacheBudgetStatCount(_Out_writes_(3) PQWORD cMiss, _Out_writes_(3) PQWORD cHit)
+{
+    cMiss[0] = ctxVmm->stat.cPhysReadSuccess + ctxVmm->stat.cPhysReadFail;
+    cMiss[1] = ctxVmm->stat.cTlbReadSuccess + ctxVmm->stat.cTlbReadFail;
+    cMiss[2] = ctxVmm->stat.page.cPageFile + ctxVmm->stat.page.cCompressed + ctxVmm->stat.page.cFailPageFile + ctxVmm->stat.page.cFailCompressed;
+    cHit[0] = ctxVmm->stat.cPhysCacheHit;
+    cHit[1] = ctxVmm->stat.cTlbCacheHit;
+    cHit[2] = ctxVmm->stat.page.cCacheHit;
+}
+
+/*
+* Apply the current budget split to the cache tables.
+* NB! Cache.Budget.fRebalanceActive must be held by caller.
+*/
+VOID VmmCacheBudgetApply()
+{
+    DWORD i;
+    QWORD cEntries;
+    cEntries = ((QWORD)ctxVmm->Cache.Budget.cMB << 20) / sizeof(VMMOB_MEM);
+    for(i = 0; i < 3; i++) {
+        VmmCacheResize(VMM_CACHE_BUDGET_TAG[i], (DWORD)min(0xffffffff, cEntries * ctxVmm->Cache.Budget.dwPromille[i] / 1000));
+    }
+}
+
+VOID VmmCacheBudgetSet(_In_ DWORD cMB)
+{
+    DWORD i;
+    while(InterlockedCompareExchange(&ctxVmm->Cache.Budget.fRebalanceActive, 1, 0)) {
+        SwitchToThread();
+    }
+    if(cMB && (cMB < VMM_CACHE_BUDGET_MIN_MB)) { cMB = VMM_CACHE_BUDGET_MIN_MB; }
+    ctxVmm->Cache.Budget.cMB = cMB;
+    if(cMB) {
+        for(i = 0; i < 3; i++) {
+            ctxVmm->Cache.Budget.dwPromille[i] = 1000 / 3;
+        }
+        VmmCacheBudgetStatCount(ctxVmm->Cache.Budget.cMissLast, ctxVmm->Cache.Budget.cHitLast);
+        ctxVmm->Cache.Budget.tcRebalanceLast = GetTickCount64();
+        VmmCacheBudgetApply();
+    } else {
+        for(i = 0; i < 3; i++) {
+            VmmCacheResize(VMM_CACHE_BUDGET_TAG[i], VMM_CACHE2_MAX_ENTRIES);
+        }
+    }
+    InterlockedExchange(&ctxVmm->Cache.Budget.fRebalanceActive, 0);
+}
+
+VOID VmmCacheBudgetRebalance(_In_ BOOL fForce)
+{
+    DWORD i, dwTarget, dwHitPromille;
+    QWORD tc, cMiss[3], cHit[3], cWeight[3], cMissTotal = 0, cWeightTotal = 0;
+    if(!ctxVmm->Cache.Budget.cMB || !ctxVmm->Cache.Budget.fAdaptive) { return; }
+    tc = GetTickCount64();
+    if(!fForce && (tc - ctxVmm->Cache.Budget.tcRebalanceLast < VMM_CACHE_BUDGET_REBALANCE_MS)) { return; }
+    if(InterlockedCompareExchange(&ctxVmm->Cache.Budget.fRebalanceActive, 1, 0)) { return; }
+    ctxVmm->Cache.Budget.tcRebalanceLast = tc;
+    VmmCacheBudgetStatCount(cMiss, cHit);
+    for(i = 0; i < 3; i++) {
+        cMiss[i] -= ctxVmm->Cache.Budget.cMissLast[i];
+        cHit[i] -= ctxVmm->Cache.Budget.cHitLast[i];
+        cMissTotal += cMiss[i];
+    }
+    if(cMissTotal >= VMM_CACHE_BUDGET_REBALANCE_MIN_MISS) {
+        // weight the misses of each cache by its hit ratio - misses of a cache
+        // which also sees hits are likely re-references that more capacity
+        // would turn into hits, misses of a cache without hits are streaming
+        // reads which won't benefit from more capacity.
+        for(i = 0; i < 3; i++) {
+            ctxVmm->Cache.Budget.cMissLast[i] += cMiss[i];
+            ctxVmm->Cache.Budget.cHitLast[i] += cHit[i];
+            dwHitPromille = (cHit[i] + cMiss[i]) ? (DWORD)(cHit[i] * 1000 / (cHit[i] + cMiss[i])) : 0;
+            cWeight[i] = cMiss[i] * (100 + dwHitPromille);
+            cWeightTotal += cWeight[i];
+        }
+        // move budget share towards the caches with the highest weight - each
+        // cache is guaranteed a min share; the change is smoothed by half.
+        for(i = 0; i < 3; i++) {
+            dwTarget = VMM_CACHE_BUDGET_MIN_PROMILLE + (DWORD)((1000 - 3 * VMM_CACHE_BUDGET_MIN_PROMILLE) * cWeight[i] / cWeightTotal);
+            ctxVmm->Cache.Budget.dwPromille[i] = (ctxVmm->Cache.Budget.dwPromille[i] + dwTarget) / 2;
+        }
+        VmmCacheBudgetApply();
+    }
+    InterlockedExchange(&ctxVmm->Cache.Budget.fRebalanceActive, 0);
+}
+
+DWORD VmmCacheBudgetRebalance_ThreadProc(_In_ PVOID pv)
+{
+    VmmCacheBudgetRebalance(FALSE);
+    InterlockedExchange(&ctxVmm->Cache.Budget.fRebalanceQueued, 0);
+    return 0;
+}
+
+/*
+* Request an adaptive rebalance of the cache budget. The rebalance is performed
+* by the cache refresh thread if it's running - otherwise it's queued as a work
+* item. The calling (hot) thread never resizes the caches itself.
+*/
+VOID VmmCacheBudgetRebalanceRequest()
+{
+    if(!ctxVmm->Cache.Budget.cMB || !ctxVmm->Cache.Budget.fAdaptive || ctxVmm->ThreadProcCache.fEnabled) { return; }
+    if(GetTickCount64() - ctxVmm->Cache.Budget.tcRebalanceLast < VMM_CACHE_BUDGET_REBALANCE_MS) { return; }
+    if(InterlockedCompareExchange(&ctxVmm->Cache.Budget.fRebalanceQueued, 1, 0)) { return; }
+    VmmWork((LPTHREAD_START_ROUTINE)VmmCacheBudgetRebalance_ThreadProc, NULL, 0);
+}
+
 VOID VmmCache2Close(_In_ DWORD dwTblTag)
 {
     PVMM_CACHE_TABLE t;
-    PVMMOB_MEM pOb;
+    PVMM_CACHE_SHARD s;
+    PVMMOB_MEM pOb, pObNext;
     PSLIST_ENTRY e;
-    DWORD i;
+    DWORD i, iEpoch;
     t = VmmCacheTableGet(dwTblTag);
     if(!t || !t->fActive) { return; }
     t->fActive = FALSE;
-    // remove from "regions"
-    for(i = 0; i < VMM_CACHE2_REGIONS; i++) {
+    // remove from "shards"
+    for(i = 0; i < t->cShard; i++) {
+        s = &t->S[i];
         VmmCacheReclaim(t, i, TRUE);
-        DeleteCriticalSection(&t->R[i].Lock);
+        // release retired entries and bucket arrays regardless of epoch - the
+        // cache is inactive so no new readers may enter at this point.
+        for(iEpoch = 0; iEpoch < 2; iEpoch++) {
+            pOb = s->Retire[iEpoch];
+            s->Retire[iEpoch] = NULL;
+            while(pOb) {
+                pObNext = pOb->RetireFLink;
+                pOb->RetireFLink = NULL;
+                s->cRetired--;
+                Ob_DECREF(pOb);
+                pOb = pObNext;
+            }
+            LocalFree(s->RetireBuckets[iEpoch]);
+            s->RetireBuckets[iEpoch] = NULL;
+        }
+        DeleteCriticalSection(&t->S[i].Lock);
+        LocalFree(t->S[i].pB);
+        t->S[i].pB = NULL;
     }
+    DeleteCriticalSection(&t->LockResize);
     // remove from "empty list"
     while(e = InterlockedPopEntrySList(&t->ListHeadEmpty)) {
         pOb = CONTAINING_RECORD(e, VMMOB_MEM, SListEmpty);
@@ -361,15 +1158,40 @@ VOID VmmCache2Close(_In_ DWORD dwTblTag)
     }
 }
 
+/*
+* Initialize a cache table. The number of shards is scaled with the number of
+* processors (power of two, twice the processor count) to keep contention on
+* the shard writer locks and reader counters low.
+* -- dwTblTag
+*/
 VOID VmmCache2Initialize(_In_ DWORD dwTblTag)
 {
-    DWORD i;
+    DWORD i, cB;
+    SYSTEM_INFO SystemInfo = { 0 };
     PVMM_CACHE_TABLE t;
     t = VmmCacheTableGet(dwTblTag);
     if(!t || t->fActive) { return; }
-    for(i = 0; i < VMM_CACHE2_REGIONS; i++) {
-        InitializeCriticalSection(&t->R[i].Lock);
+    GetSystemInfo(&SystemInfo);
+    t->cShard = 4;
+    while((t->cShard < VMM_CACHE2_SHARDS_MAX) && (t->cShard < 2 * SystemInfo.dwNumberOfProcessors)) {
+        t->cShard <<= 1;
     }
+    t->cMaxEntries = VMM_CACHE2_MAX_ENTRIES;
+    cB = VmmCacheBucketCount(t);
+    for(i = 0; i < t->cShard; i++) {
+        if(!(t->S[i].pB = LocalAlloc(LMEM_ZEROINIT, sizeof(VMM_CACHE_BUCKETS) + cB * sizeof(PVMMOB_MEM)))) {
+            while(i) {
+                i--;
+                DeleteCriticalSection(&t->S[i].Lock);
+                LocalFree(t->S[i].pB);
+                t->S[i].pB = NULL;
+            }
+            return;
+        }
+        t->S[i].pB->cB = cB;
+        InitializeCriticalSection(&t->S[i].Lock);
+    }
+    InitializeCriticalSection(&t->LockResize);
     InitializeSListHead(&t->ListHeadEmpty);
     InitializeSListHead(&t->ListHeadTotal);
     t->fActive = TRUE;
@@ -397,7 +1219,7 @@ VOID VmmTlbPrefetch(_In_ POB_SET pTlbPrefetch)
             ppMEMs[i] = &ppObMEMs[i]->h;
             ppMEMs[i]->qwA = ObSet_Pop(pTlbPrefetch);
         }
-        LcReadScatter(ctxMain->hLC, cTlbs, ppMEMs);
+        VmmReadScatterDevice(cTlbs, ppMEMs);
         for(i = 0; i < cTlbs; i++) {
             if(ppMEMs[i]->f && !VmmTlbPageTableVerify(ppMEMs[i]->pb, ppMEMs[i]->qwA, FALSE)) {
                 ppMEMs[i]->f = FALSE;  // "fail" invalid page table read
@@ -410,6 +1232,361 @@ fail:
     LocalFree(ppObMEMs);
 }
 
+// ----------------------------------------------------------------------------
+// NEGATIVE CACHE FUNCTIONALITY BELOW:
+// Fixed size caches of failed physical reads (key: physical page) and failed
+// paged reads (key: pte). A key is hashed into a bucket index and a non-zero
+// 32-bit fingerprint. Each bucket is one cache line of entries which are read
+// and written lock-free. On volatile targets entries expire after the physical
+// memory cache refresh period - on static targets entries never expire.
+// ----------------------------------------------------------------------------
+
+PVMM_NEGCACHE_TABLE VmmNegCacheTableGet(_In_ DWORD dwTblTag)
+{
+    switch(dwTblTag) {
+        case VMM_CACHE_TAG_PHYS:
+            return &ctxVmm->Cache.PHYS_FAILED;
+        case VMM_CACHE_TAG_PAGING:
+            return &ctxVmm->Cache.PAGING_FAILED;
+        default:
+            return NULL;
+    }
+}
+
+/*
+* Locate the bucket and the fingerprint of a key.
+* -- t
+* -- dwTblTag
+* -- qwKey
+* -- pdwFP
+* -- return = bucket.
+*/
+volatile QWORD *VmmNegCacheBucket(_In_ PVMM_NEGCACHE_TABLE t, _In_ DWORD dwTblTag, _In_ QWORD qwKey, _Out_ PDWORD pdwFP)
+{
+    if(dwTblTag == VMM_CACHE_TAG_PHYS) { qwKey >>= 12; }
+    // splitmix64 finalizer
+    qwKey = (qwKey ^ (qwKey >> 30)) * 0xBF58476D1CE4E5B9;
+    qwKey = (qwKey ^ (qwKey >> 27)) * 0x94D049BB133111EB;
+    qwKey = qwKey ^ (qwKey >> 31);
+    *pdwFP = (DWORD)(qwKey >> 32) | 1;
+    return t->pqwE + ((DWORD)qwKey & t->cBucketMask) * VMM_NEGCACHE_BUCKET_ENTRIES;
+}
+
+/*
+* Retrieve the time-to-live of negative cache entries in ms (0 = no expiry).
+*/
+DWORD VmmNegCacheTTL()
+{
+    if(!ctxMain->dev.fVolatile) { return 0; }
+    return max(1, ctxVmm->ThreadProcCache.cMs_TickPeriod * ctxVmm->ThreadProcCache.cTick_Phys);
+}
+
+BOOL VmmNegCacheExists(_In_ DWORD dwTblTag, _In_ QWORD qwKey)
+{
+    DWORD i, dwFP, dwTTL;
+    QWORD qwE;
+    volatile QWORD *pqwB;
+    PVMM_NEGCACHE_TABLE t = VmmNegCacheTableGet(dwTblTag);
+    if(!t || !t->fActive) { return FALSE; }
+    pqwB = VmmNegCacheBucket(t, dwTblTag, qwKey, &dwFP);
+    for(i = 0; i < VMM_NEGCACHE_BUCKET_ENTRIES; i++) {
+        qwE = pqwB[i];
+        if((DWORD)(qwE >> 32) != dwFP) { continue; }
+        dwTTL = VmmNegCacheTTL();
+        if(dwTTL && ((DWORD)GetTickCount64() - (DWORD)qwE > dwTTL)) {
+            // expired -> remove unless concurrently replaced.
+            if(InterlockedCompareExchange64((volatile LONG64*)(pqwB + i), 0, qwE) == qwE) {
+                InterlockedIncrement64(&ctxVmm->stat.negcache.cExpire);
+            }
+            return FALSE;
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+VOID VmmNegCachePush(_In_ DWORD dwTblTag, _In_ QWORD qwKey)
+{
+    DWORD i, iE = 0, dwFP, dwTick, dwAge, dwAgeMax = 0;
+    QWORD qwE;
+    volatile QWORD *pqwB;
+    PVMM_NEGCACHE_TABLE t = VmmNegCacheTableGet(dwTblTag);
+    if(!t || !t->fActive) { return; }
+    pqwB = VmmNegCacheBucket(t, dwTblTag, qwKey, &dwFP);
+    dwTick = (DWORD)GetTickCount64();
+    // 1: existing entry -> refresh
+    for(i = 0; i < VMM_NEGCACHE_BUCKET_ENTRIES; i++) {
+        if((DWORD)(pqwB[i] >> 32) == dwFP) {
+            pqwB[i] = ((QWORD)dwFP << 32) | dwTick;
+            return;
+        }
+    }
+    // 2: empty entry or evict the oldest entry
+    for(i = 0; i < VMM_NEGCACHE_BUCKET_ENTRIES; i++) {
+        qwE = pqwB[i];
+        if(!qwE) {
+            iE = i;
+            break;
+        }
+        dwAge = dwTick - (DWORD)qwE;
+        if(dwAge >= dwAgeMax) {
+            dwAgeMax = dwAge;
+            iE = i;
+        }
+    }
+    if(i == VMM_NEGCACHE_BUCKET_ENTRIES) {
+        InterlockedIncrement64(&ctxVmm->stat.negcache.cEvict);
+    }
+    pqwB[iE] = ((QWORD)dwFP << 32) | dwTick;
+    InterlockedIncrement64(&ctxVmm->stat.negcache.cInsert);
+}
+
+VOID VmmNegCacheClear(_In_ DWORD dwTblTag)
+{
+    PVMM_NEGCACHE_TABLE t = VmmNegCacheTableGet(dwTblTag);
+    if(!t || !t->fActive) { return; }
+    ZeroMemory((PVOID)t->pqwE, (t->cBucketMask + 1ULL) * VMM_NEGCACHE_BUCKET_ENTRIES * sizeof(QWORD));
+}
+
+VOID VmmNegCacheClose(_In_ DWORD dwTblTag)
+{
+    PVMM_NEGCACHE_TABLE t = VmmNegCacheTableGet(dwTblTag);
+    if(!t) { return; }
+    t->fActive = FALSE;
+    LocalFree((PVOID)t->pqwE);
+    t->pqwE = NULL;
+}
+
+VOID VmmNegCacheInitialize(_In_ DWORD dwTblTag)
+{
+    PVMM_NEGCACHE_TABLE t = VmmNegCacheTableGet(dwTblTag);
+    if(!t || t->fActive) { return; }
+    if(!(t->pqwE = LocalAlloc(LMEM_ZEROINIT, VMM_NEGCACHE_BUCKETS * VMM_NEGCACHE_BUCKET_ENTRIES * sizeof(QWORD)))) { return; }
+    t->cBucketMask = VMM_NEGCACHE_BUCKETS - 1;
+    t->fActive = TRUE;
+}
+
+// ----------------------------------------------------------------------------
+// PROCESS TRANSLATION CACHE (VTLB) FUNCTIONALITY BELOW:
+// Per-process cache of final virtual to physical translation results. Entries
+// are tagged with the global generation ctxVmm->Cache.dwVTlbGeneration which
+// is bumped whenever the TLB (page table) cache is cleared or invalidated. An
+// entry from an older generation is treated as empty. Lookups are lock-free;
+// writers claim an entry by atomically setting its tag to the 'locked' value.
+// The generation is also bumped whenever a page table leaves the TLB cache -
+// a valid entry is thus always backed by page tables still in the TLB cache,
+// and invalidating a single physical page only affects the translation caches
+// if the page was a cached page table.
+// ----------------------------------------------------------------------------
+
+#define VMM_VTLB_TAG_VALID          1
+#define VMM_VTLB_TAG_LOCKED         2
+#define VMM_VTLB_TAG(va)            (((va) & ~0xfff) | VMM_VTLB_TAG_VALID)
+#define VMM_VTLB_INDEX(va)          ((DWORD)((((va) >> 12) * 0x9E3779B97F4A7C15) >> 40) & (VMM_VTLB_ENTRIES - 1))
+
+/*
+* Retrieve a translation from the process translation cache. Successful
+* translations are cached per page - the page offset is added from va.
+* -- pProcess
+* -- dwGeneration = generation at start of the translation.
+* -- va
+* -- pqwA = pa on successful translation, pte on failed translation.
+* -- pfPA = translation success status.
+* -- return = TRUE on cache hit, FALSE on cache miss.
+*/
+_Success_(return)
+BOOL VmmVTlbGet(_In_ PVMM_PROCESS pProcess, _In_ DWORD dwGeneration, _In_ QWORD va, _Out_ PQWORD pqwA, _Out_ PBOOL pfPA)
+{
+    DWORD i, iE;
+    QWORD qwTag, qwA;
+    BOOL f;
+    PVMM_VTLB_ENTRY pe;
+    if(!pProcess->pVTlb) { return FALSE; }
+    qwTag = VMM_VTLB_TAG(va);
+    iE = VMM_VTLB_INDEX(va);
+    for(i = 0; i < VMM_VTLB_PROBE; i++) {
+        pe = pProcess->pVTlb + ((iE + i) & (VMM_VTLB_ENTRIES - 1));
+        if(pe->qwTag != qwTag) { continue; }
+        if(pe->dwGeneration != dwGeneration) { break; }
+        qwA = pe->qwA;
+        f = pe->f;
+        if(pe->qwTag != qwTag) { break; }  // entry re-written during read
+        *pqwA = f ? (qwA | (va & 0xfff)) : qwA;
+        *pfPA = f;
+        InterlockedIncrement64(&ctxVmm->stat.cVTlbHit);
+        return TRUE;
+    }
+    InterlockedIncrement64(&ctxVmm->stat.cVTlbMiss);
+    return FALSE;
+}
+
+/*
+* Add a translation to the process translation cache. Only results that are
+* fully determined by the cached page tables are added - i.e. successful
+* translations and failed translations with a non-zero pte. A successful
+* translation is stored as page frame only (the page offset is not cached).
+* -- pProcess
+* -- dwGeneration = generation at start of the translation.
+* -- va
+* -- qwA
+* -- fPA
+*/
+VOID VmmVTlbPut(_In_ PVMM_PROCESS pProcess, _In_ DWORD dwGeneration, _In_ QWORD va, _In_ QWORD qwA, _In_ BOOL fPA)
+{
+    DWORD i, iE;
+    QWORD qwTag, qwTagOld;
+    PVMM_VTLB_ENTRY pe, peTarget = NULL;
+    if(!pProcess->pVTlb || (!fPA && !qwA)) { return; }
+    if(dwGeneration != ctxVmm->Cache.dwVTlbGeneration) { return; }
+    qwTag = VMM_VTLB_TAG(va);
+    iE = VMM_VTLB_INDEX(va);
+    // find: (1) existing entry, (2) empty or stale entry, (3) home entry.
+    for(i = 0; i < VMM_VTLB_PROBE; i++) {
+        pe = pProcess->pVTlb + ((iE + i) & (VMM_VTLB_ENTRIES - 1));
+        if(pe->qwTag == qwTag) {
+            peTarget = pe;
+            break;
+        }
+        if(!peTarget && (!pe->qwTag || (pe->dwGeneration != dwGeneration))) {
+            peTarget = pe;
+        }
+    }
+    pe = peTarget ? peTarget : (pProcess->pVTlb + iE);
+    qwTagOld = pe->qwTag;
+    if(qwTagOld == VMM_VTLB_TAG_LOCKED) { return; }
+    if(InterlockedCompareExchange64((volatile LONG64*)&pe->qwTag, VMM_VTLB_TAG_LOCKED, qwTagOld) != (LONG64)qwTagOld) { return; }
+    pe->qwA = fPA ? (qwA & ~0xfff) : qwA;
+    pe->f = fPA;
+    pe->dwGeneration = dwGeneration;
+    InterlockedExchange64((volatile LONG64*)&pe->qwTag, qwTag);
+}
+
+/*
+* Invalidate all process translation caches.
+*/
+VOID VmmVTlbInvalidateAll()
+{
+    InterlockedIncrement((volatile LONG*)&ctxVmm->Cache.dwVTlbGeneration);
+}
+
+_Success_(return)
+BOOL VmmVirt2Phys(_In_ PVMM_PROCESS pProcess, _In_ QWORD va, _Out_ PQWORD ppa)
+{
+    BOOL f;
+    DWORD dwGeneration;
+    *ppa = 0;
+    if(ctxVmm->tpMemoryModel == VMM_MEMORYMODEL_NA) { return FALSE; }
+    dwGeneration = ctxVmm->Cache.dwVTlbGeneration;
+    if(VmmVTlbGet(pProcess, dwGeneration, va, ppa, &f)) { return f; }
+    f = ctxVmm->fnMemoryModel.pfnVirt2Phys(pProcess->paDTB, pProcess->fUserOnly, -1, va, ppa);
+    VmmVTlbPut(pProcess, dwGeneration, va, *ppa, f);
+    return f;
+}
+
+VOID VmmVirt2PhysBatch(_In_ PVMM_PROCESS pProcess, _In_ DWORD cVA, _In_reads_(cVA) PQWORD pqwVA, _Out_writes_(cVA) PQWORD pqwPA, _Out_writes_(cVA) PBOOL pfPA)
+{
+    if(ctxVmm->tpMemoryModel == VMM_MEMORYMODEL_NA) {
+        ZeroMemory(pqwPA, cVA * sizeof(QWORD));
+        ZeroMemory(pfPA, cVA * sizeof(BOOL));
+        return;
+    }
+    ctxVmm->fnMemoryModel.pfnVirt2PhysBatch(pProcess, cVA, pqwVA, pqwPA, pfPA);
+}
+
+typedef struct tdVMM_VIRT2PHYS_BATCH_ENTRY {
+    QWORD va;
+    QWORD paPT;     // page table of current level (raw pte of upper level).
+    DWORD i;        // index in caller arrays.
+    BOOL fDone;
+} VMM_VIRT2PHYS_BATCH_ENTRY, *PVMM_VIRT2PHYS_BATCH_ENTRY;
+
+int VmmVirt2PhysBatch_CmpSort(PVMM_VIRT2PHYS_BATCH_ENTRY a, PVMM_VIRT2PHYS_BATCH_ENTRY b)
+{
+    return (a->va < b->va) ? -1 : ((a->va > b->va) ? 1 : 0);
+}
+
+VOID VmmVirt2PhysBatch_DoWork(_In_ PVMM_PROCESS pProcess, _In_ BYTE iPML, _In_ PVMM_VIRT2PHYS_STEP_PFN pfnStep, _In_ DWORD cVA, _In_reads_(cVA) PQWORD pqwVA, _Out_writes_(cVA) PQWORD pqwPA, _Out_writes_(cVA) PBOOL pfPA)
+{
+    BOOL f;
+    DWORD i, dwStep, cActive, dwGeneration;
+    QWORD qw, paPT, paPTLast;
+    PVMMOB_MEM pObPT = NULL;
+    POB_SET psObPrefetch = NULL;
+    PVMM_VIRT2PHYS_BATCH_ENTRY pe = NULL;
+    if(!cVA) { return; }
+    if(!(pe = LocalAlloc(0, cVA * sizeof(VMM_VIRT2PHYS_BATCH_ENTRY))) || !(psObPrefetch = ObSet_New())) {
+        // fallback: translate one-by-one
+        for(i = 0; i < cVA; i++) {
+            pfPA[i] = VmmVirt2Phys(pProcess, pqwVA[i], &qw);
+            pqwPA[i] = qw;
+        }
+        goto fail;
+    }
+    // 1: look up translation cache and sort remaining virtual addresses -
+    //    neighboring addresses share page tables.
+    dwGeneration = ctxVmm->Cache.dwVTlbGeneration;
+    for(i = 0, cActive = cVA; i < cVA; i++) {
+        pe[i].va = pqwVA[i];
+        pe[i].paPT = pProcess->paDTB;
+        pe[i].i = i;
+        pe[i].fDone = FALSE;
+        qw = 0;
+        if(VmmVTlbGet(pProcess, dwGeneration, pe[i].va, &qw, &f)) {
+            pe[i].fDone = TRUE;
+            cActive--;
+        } else {
+            f = FALSE;
+        }
+        pqwPA[i] = qw;
+        pfPA[i] = f;
+    }
+    qsort(pe, cVA, sizeof(VMM_VIRT2PHYS_BATCH_ENTRY), (int(*)(const void*, const void*))VmmVirt2PhysBatch_CmpSort);
+    // 2: walk the page tables level by level.
+    for(; cActive && iPML; iPML--) {
+        // 2.1: prefetch all page tables of this level missing from the cache.
+        paPTLast = (QWORD)-1;
+        for(i = 0; i < cVA; i++) {
+            if(pe[i].fDone) { continue; }
+            paPT = pe[i].paPT & 0x0000fffffffff000;
+            if(paPT == paPTLast) { continue; }
+            paPTLast = paPT;
+            if(!VmmCacheExists(VMM_CACHE_TAG_TLB, paPT)) {
+                ObSet_Push(psObPrefetch, paPT);
+            }
+        }
+        if(ObSet_Size(psObPrefetch)) {
+            VmmTlbPrefetch(psObPrefetch);
+        }
+        // 2.2: resolve entries - each page table is looked up once per run of
+        //      (sorted) addresses sharing it.
+        paPTLast = (QWORD)-1;
+        for(i = 0; i < cVA; i++) {
+            if(pe[i].fDone) { continue; }
+            paPT = pe[i].paPT & 0x0000fffffffff000;
+            if(paPT != paPTLast) {
+                Ob_DECREF_NULL(&pObPT);
+                pObPT = VmmTlbGetPageTable(paPT, FALSE);
+                paPTLast = paPT;
+            }
+            qw = 0;
+            dwStep = pObPT ? pfnStep(pObPT, pe[i].paPT, pProcess->fUserOnly, iPML, pe[i].va, &qw) : VMM_VIRT2PHYS_STEP_FAIL;
+            if(dwStep == VMM_VIRT2PHYS_STEP_NEXT) {
+                pe[i].paPT = qw;
+                continue;
+            }
+            pe[i].fDone = TRUE;
+            pqwPA[pe[i].i] = qw;
+            pfPA[pe[i].i] = (dwStep == VMM_VIRT2PHYS_STEP_SUCCESS);
+            VmmVTlbPut(pProcess, dwGeneration, pe[i].va, qw, pfPA[pe[i].i]);
+            cActive--;
+        }
+        Ob_DECREF_NULL(&pObPT);
+    }
+fail:
+    Ob_DECREF(psObPrefetch);
+    LocalFree(pe);
+}
+
 /*
 * Prefetch a set of addresses contained in pPrefetchPages into the cache. This
 * is useful when reading data from somewhat known addresses over higher latency
@@ -426,6 +1603,7 @@ VOID VmmCachePrefetchPages(_In_opt_ PVMM_PROCESS pProcess, _In_opt_ POB_SET pPre
     PPMEM_SCATTER ppMEMs = NULL;
     cPages = ObSet_Size(pPrefetchPages);
     if(!cPages || (ctxVmm->flags & VMM_FLAG_NOCACHE)) { return; }
+    if(!pProcess && ctxVmm->PhysFile.fActive) { return; }
     if(!LcAllocScatter1(cPages, &ppMEMs)) { return; }
     while((qwA = ObSet_GetNext(pPrefetchPages, qwA))) {
         ppMEMs[iMEM++]->qwA = qwA & ~0xfff;
@@ -1056,6 +2234,7 @@ VOID VmmProcess_CloseObCallback(_In_ PVOID pVmmOb)
     Ob_DECREF(pProcess->Map.pObHandle);
     Ob_DECREF(pProcess->pObPersistent);
     LocalFree(pProcess->win.TOKEN.szSID);
+    LocalFree(pProcess->pVTlb);
     // plugin cleanup below
     Ob_DECREF(pProcess->Plugin.pObCLdrModulesDisplayCache);
     Ob_DECREF(pProcess->Plugin.pObCPeDumpDirCache);
@@ -1072,6 +2251,7 @@ VOID VmmProcessClone_CloseObCallback(_In_ PVOID pVmmOb)
     PVMM_PROCESS pProcessClone = (PVMM_PROCESS)pVmmOb;
     // decref clone parent
     Ob_DECREF(pProcessClone->pObProcessCloneParent);
+    LocalFree(pProcessClone->pVTlb);
     // delete lock
     DeleteCriticalSection(&pProcessClone->LockUpdate);
     DeleteCriticalSection(&pProcessClone->LockPlugin);
@@ -1119,6 +2299,8 @@ PVMM_PROCESS VmmProcessClone(_In_ PVMM_PROCESS pProcess)
     if(!pObProcessClone) { return NULL; }
     memcpy((PBYTE)pObProcessClone + sizeof(OB), (PBYTE)pProcess + sizeof(OB), pProcess->ObHdr.cbData);
     pObProcessClone->pObProcessCloneParent = Ob_INCREF(pProcess);
+    pObProcessClone->pVTlb = LocalAlloc(LMEM_ZEROINIT, VMM_VTLB_ENTRIES * sizeof(VMM_VTLB_ENTRY));    // translation cache not shared (fUserOnly may differ)
+    ZeroMemory(&pObProcessClone->ReadAhead, sizeof(VMM_READAHEAD_STREAMS));
     InitializeCriticalSection(&pObProcessClone->LockUpdate);
     InitializeCriticalSection(&pObProcessClone->LockPlugin);
     InitializeCriticalSection(&pObProcessClone->Map.LockUpdateThreadMap);
@@ -1192,6 +2374,7 @@ PVMM_PROCESS VmmProcessCreateEntry(_In_ BOOL fTotalRefresh, _In_ DWORD dwPID, _I
         pProcess->paDTB_UserOpt = paDTB_UserOpt;
         pProcess->fUserOnly = fUserOnly;
         pProcess->fTlbSpiderDone = pProcess->fTlbSpiderDone;
+        pProcess->pVTlb = LocalAlloc(LMEM_ZEROINIT, VMM_VTLB_ENTRIES * sizeof(VMM_VTLB_ENTRY));
         pProcess->Plugin.pObCLdrModulesDisplayCache = ObContainer_New(NULL);
         pProcess->Plugin.pObCPeDumpDirCache = ObContainer_New(NULL);
         pProcess->Plugin.pObCPhys2Virt = ObContainer_New(NULL);
@@ -1327,94 +2510,382 @@ BOOL VmmProcessTableCreateInitial()
 
 // ----------------------------------------------------------------------------
 // WORK (THREAD POOL) API:
-// The 'Work' thread pool contain by default 32 threads which is waiting to
-// receive work scheduled by calling the VmmWork function.
+// The 'Work' thread pool is a work-stealing scheduler. Each worker thread owns
+// a deque of work units; work scheduled from a worker thread is pushed to the
+// bottom of its own deque and taken from the bottom (newest first) by the same
+// thread. Idle worker threads steal from the top (oldest first) of the deques
+// of other worker threads. Work scheduled from non-worker threads is put into
+// a shared injection queue. The thread count is sized to the number of CPUs,
+// but never below VMM_WORK_THREADPOOL_NUM_THREADS since some work items block
+// on I/O or run for the lifetime of the VMM. Work units are pooled.
+// Work may optionally be scheduled as part of a work group which allows the
+// caller to wait (join) on all work items in the group.
 // ----------------------------------------------------------------------------
 
 typedef struct tdVMMWORK_UNIT {
+    SLIST_ENTRY SListFree;          // must be first member (pool free list)
+    struct tdVMMWORK_UNIT *FLink;   // towards bottom of deque
+    struct tdVMMWORK_UNIT *BLink;   // towards top of deque
     LPTHREAD_START_ROUTINE pfn;     // function to call
     PVOID ctx;                      // optional function parameter
     HANDLE hEventFinish;            // optional event to set when upon work completion
+    PVMMOB_WORK_GROUP pObGroup;     // optional work group
+    DWORD iIoClass;                 // i/o priority class of the submitting thread
 } VMMWORK_UNIT, *PVMMWORK_UNIT;
 
 typedef struct tdVMMWORK_THREAD_CONTEXT {
-    HANDLE hEventWakeup;
+    DWORD i;
     HANDLE hThread;
+    VMMWORK_DEQUE Deque;
 } VMMWORK_THREAD_CONTEXT, *PVMMWORK_THREAD_CONTEXT;
 
+VOID VmmWorkDeque_PushBottom(_In_ PVMMWORK_DEQUE pd, _In_ PVMMWORK_UNIT pu)
+{
+    AcquireSRWLockExclusive(&pd->LockSRW);
+    pu->FLink = NULL;
+    pu->BLink = pd->pBottom;
+    if(pd->pBottom) {
+        pd->pBottom->FLink = pu;
+    } else {
+        pd->pTop = pu;
+    }
+    pd->pBottom = pu;
+    pd->c++;
+    ReleaseSRWLockExclusive(&pd->LockSRW);
+}
+
+/*
+* Take the newest work unit from the deque.
+* -- pd
+* -- pgFilter = optional: only take the work unit if it belongs to the group.
+* -- return
+*/
+PVMMWORK_UNIT VmmWorkDeque_PopBottom(_In_ PVMMWORK_DEQUE pd, _In_opt_ PVMMOB_WORK_GROUP pgFilter)
+{
+    PVMMWORK_UNIT pu;
+    if(!pd->c) { return NULL; }
+    AcquireSRWLockExclusive(&pd->LockSRW);
+    pu = pd->pBottom;
+    if(pu && (!pgFilter || (pu->pObGroup == pgFilter))) {
+        pd->pBottom = pu->BLink;
+        if(pd->pBottom) {
+            pd->pBottom->FLink = NULL;
+        } else {
+            pd->pTop = NULL;
+        }
+        pd->c--;
+    } else {
+        pu = NULL;
+    }
+    ReleaseSRWLockExclusive(&pd->LockSRW);
+    return pu;
+}
+
+/*
+* Take the oldest work unit from the deque.
+* -- pd
+* -- fTry = do not wait for the deque lock if it's already held (steal).
+* -- return
+*/
+PVMMWORK_UNIT VmmWorkDeque_PopTop(_In_ PVMMWORK_DEQUE pd, _In_ BOOL fTry)
+{
+    PVMMWORK_UNIT pu;
+    if(!pd->c) { return NULL; }
+    if(fTry) {
+        if(!TryAcquireSRWLockExclusive(&pd->LockSRW)) { return NULL; }
+    } else {
+        AcquireSRWLockExclusive(&pd->LockSRW);
+    }
+    if((pu = pd->pTop)) {
+        pd->pTop = pu->FLink;
+        if(pd->pTop) {
+            pd->pTop->BLink = NULL;
+        } else {
+            pd->pBottom = NULL;
+        }
+        pd->c--;
+    }
+    ReleaseSRWLockExclusive(&pd->LockSRW);
+    return pu;
+}
+
+/*
+* Take the oldest work unit belonging to a work group from anywhere in the
+* deque (used by a joining thread to help complete the group).
+* -- pd
+* -- pg
+* -- fTry = do not wait for the deque lock if it's already held.
+* -- return
+*/
+PVMMWORK_UNIT VmmWorkDeque_PopGroup(_In_ PVMMWORK_DEQUE pd, _In_ PVMMOB_WORK_GROUP pg, _In_ BOOL fTry)
+{
+    PVMMWORK_UNIT pu;
+    if(!pd->c) { return NULL; }
+    if(fTry) {
+        if(!TryAcquireSRWLockExclusive(&pd->LockSRW)) { return NULL; }
+    } else {
+        AcquireSRWLockExclusive(&pd->LockSRW);
+    }
+    pu = pd->pTop;
+    while(pu && (pu->pObGroup != pg)) {
+        pu = pu->FLink;
+    }
+    if(pu) {
+        if(pu->BLink) {
+            pu->BLink->FLink = pu->FLink;
+        } else {
+            pd->pTop = pu->FLink;
+        }
+        if(pu->FLink) {
+            pu->FLink->BLink = pu->BLink;
+        } else {
+            pd->pBottom = pu->BLink;
+        }
+        pd->c--;
+    }
+    ReleaseSRWLockExclusive(&pd->LockSRW);
+    return pu;
+}
+
+PVMMWORK_UNIT VmmWork_UnitAlloc()
+{
+    PVMMWORK_UNIT pu;
+    if((pu = (PVMMWORK_UNIT)InterlockedPopEntrySList(&ctxVmm->Work.ListHeadFreeUnit))) {
+        return pu;
+    }
+    return (PVMMWORK_UNIT)LocalAlloc(0, sizeof(VMMWORK_UNIT));
+}
+
+VOID VmmWork_UnitFree(_In_ PVMMWORK_UNIT pu)
+{
+    if(QueryDepthSList(&ctxVmm->Work.ListHeadFreeUnit) < VMM_WORK_UNIT_POOL_MAX) {
+        InterlockedPushEntrySList(&ctxVmm->Work.ListHeadFreeUnit, &pu->SListFree);
+    } else {
+        LocalFree(pu);
+    }
+}
+
+/*
+* Complete a work unit (executed or cancelled) - signal any waiters and return
+* the work unit to the pool.
+*/
+VOID VmmWork_UnitComplete(_In_ PVMMWORK_UNIT pu)
+{
+    PVMMOB_WORK_GROUP pObGroup = pu->pObGroup;
+    if(pu->hEventFinish) {
+        SetEvent(pu->hEventFinish);
+    }
+    VmmWork_UnitFree(pu);
+    if(pObGroup) {
+        if(0 == InterlockedDecrement(&pObGroup->cPending)) {
+            SetEvent(pObGroup->hEventFinish);
+        }
+        Ob_DECREF(pObGroup);
+    }
+}
+
+VOID VmmWork_UnitExecute(_In_ PVMMWORK_UNIT pu)
+{
+    DWORD iIoClassPrevious = VmmIoSchedClassSet(pu->iIoClass);
+    pu->pfn(pu->ctx);
+    VmmIoSchedClassSet(iIoClassPrevious);
+    VmmWork_UnitComplete(pu);
+}
+
+/*
+* Retrieve work for a worker thread: (1) own deque, (2) injection queue and
+* (3) steal from other worker threads.
+*/
+PVMMWORK_UNIT VmmWork_UnitFind(_In_ PVMMWORK_THREAD_CONTEXT ctx)
+{
+    DWORD i, cThread = ctxVmm->Work.cThread;
+    PVMMWORK_UNIT pu;
+    if((pu = VmmWorkDeque_PopBottom(&ctx->Deque, NULL))) { return pu; }
+    if((pu = VmmWorkDeque_PopTop(&ctxVmm->Work.Inject, FALSE))) { return pu; }
+    for(i = 1; i < cThread; i++) {
+        if((pu = VmmWorkDeque_PopTop(&ctxVmm->Work.pThreads[(ctx->i + i) % cThread].Deque, TRUE))) { return pu; }
+    }
+    return NULL;
+}
+
+VOID VmmWork_UnitSchedule(_In_ PVMMWORK_UNIT pu)
+{
+    PVMMWORK_THREAD_CONTEXT ctx = (PVMMWORK_THREAD_CONTEXT)TlsGetValue(ctxVmm->Work.dwTlsIndex);
+    VmmWorkDeque_PushBottom(ctx ? &ctx->Deque : &ctxVmm->Work.Inject, pu);
+    if(InterlockedCompareExchange(&ctxVmm->Work.cThreadIdle, 0, 0)) {
+        ReleaseSemaphore(ctxVmm->Work.hSemaphoreWakeup, 1, NULL);
+    }
+}
+
 DWORD VmmWork_MainWorkerLoop_ThreadProc(PVMMWORK_THREAD_CONTEXT ctx)
 {
-    PVMMWORK_UNIT pu;
-    while(ctxVmm->Work.fEnabled) {
-        if((pu = (PVMMWORK_UNIT)ObSet_Pop(ctxVmm->Work.psUnit))) {
-            pu->pfn(pu->ctx);
-            if(pu->hEventFinish) {
-                SetEvent(pu->hEventFinish);
-            }
-            LocalFree(pu);
-        } else {
-            ResetEvent(ctx->hEventWakeup);
-            ObSet_Push(ctxVmm->Work.psThreadAvail, (QWORD)ctx);
-            WaitForSingleObject(ctx->hEventWakeup, INFINITE);
-        }
+    PVMMWORK_UNIT pu;
+    TlsSetValue(ctxVmm->Work.dwTlsIndex, ctx);
+    while(ctxVmm->Work.fEnabled) {
+        if((pu = VmmWork_UnitFind(ctx))) {
+            VmmWork_UnitExecute(pu);
+            continue;
+        }
+        // register as idle before the final check for work to avoid a
+        // lost wakeup from a concurrent VmmWork_UnitSchedule.
+        InterlockedIncrement(&ctxVmm->Work.cThreadIdle);
+        if((pu = VmmWork_UnitFind(ctx))) {
+            InterlockedDecrement(&ctxVmm->Work.cThreadIdle);
+            VmmWork_UnitExecute(pu);
+            continue;
+        }
+        if(ctxVmm->Work.fEnabled) {
+            WaitForSingleObject(ctxVmm->Work.hSemaphoreWakeup, INFINITE);
+        }
+        InterlockedDecrement(&ctxVmm->Work.cThreadIdle);
+    }
+    InterlockedDecrement(&ctxVmm->Work.cThreadActive);
+    return 1;
+}
+
+VOID VmmWork_Initialize()
+{
+    DWORD i;
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+    ctxVmm->Work.cThread = min(VMM_WORK_THREADPOOL_NUM_THREADS_MAX, max(VMM_WORK_THREADPOOL_NUM_THREADS, VMM_WORK_THREADPOOL_THREADS_PER_CPU * SystemInfo.dwNumberOfProcessors));
+    if(!(ctxVmm->Work.hSemaphoreWakeup = CreateSemaphore(NULL, 0, 0x7fffffff, NULL))) { return; }
+    if((ctxVmm->Work.dwTlsIndex = TlsAlloc()) == TLS_OUT_OF_INDEXES) { return; }
+    if(!(ctxVmm->Work.pThreads = LocalAlloc(LMEM_ZEROINIT, ctxVmm->Work.cThread * sizeof(VMMWORK_THREAD_CONTEXT)))) { return; }
+    InitializeSRWLock(&ctxVmm->Work.Inject.LockSRW);
+    InitializeSListHead(&ctxVmm->Work.ListHeadFreeUnit);
+    for(i = 0; i < ctxVmm->Work.cThread; i++) {
+        ctxVmm->Work.pThreads[i].i = i;
+        InitializeSRWLock(&ctxVmm->Work.pThreads[i].Deque.LockSRW);
+    }
+    ctxVmm->Work.fEnabled = TRUE;
+    for(i = 0; i < ctxVmm->Work.cThread; i++) {
+        InterlockedIncrement(&ctxVmm->Work.cThreadActive);
+        ctxVmm->Work.pThreads[i].hThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)VmmWork_MainWorkerLoop_ThreadProc, ctxVmm->Work.pThreads + i, 0, NULL);
+        if(!ctxVmm->Work.pThreads[i].hThread) {
+            InterlockedDecrement(&ctxVmm->Work.cThreadActive);
+        }
+    }
+}
+
+VOID VmmWork_Close()
+{
+    DWORD i;
+    PVMMWORK_UNIT pu;
+    ctxVmm->Work.fEnabled = FALSE;
+    // 1: wake up and wait for all worker threads to exit
+    while(ctxVmm->Work.cThreadActive) {
+        if(ctxVmm->Work.cThreadIdle) {
+            ReleaseSemaphore(ctxVmm->Work.hSemaphoreWakeup, ctxVmm->Work.cThreadIdle, NULL);
+        }
+        SwitchToThread();
+    }
+    // 2: cancel not yet started work (signal waiters) and free resources
+    while((pu = VmmWorkDeque_PopTop(&ctxVmm->Work.Inject, FALSE))) {
+        VmmWork_UnitComplete(pu);
+    }
+    if(ctxVmm->Work.pThreads) {
+        for(i = 0; i < ctxVmm->Work.cThread; i++) {
+            while((pu = VmmWorkDeque_PopTop(&ctxVmm->Work.pThreads[i].Deque, FALSE))) {
+                VmmWork_UnitComplete(pu);
+            }
+            if(ctxVmm->Work.pThreads[i].hThread) {
+                CloseHandle(ctxVmm->Work.pThreads[i].hThread);
+            }
+        }
+        LocalFree(ctxVmm->Work.pThreads);
+        ctxVmm->Work.pThreads = NULL;
+        while((pu = (PVMMWORK_UNIT)InterlockedPopEntrySList(&ctxVmm->Work.ListHeadFreeUnit))) {
+            LocalFree(pu);
+        }
+    }
+    if(ctxVmm->Work.hSemaphoreWakeup) {
+        if(ctxVmm->Work.dwTlsIndex != TLS_OUT_OF_INDEXES) {
+            TlsFree(ctxVmm->Work.dwTlsIndex);
+        }
+        CloseHandle(ctxVmm->Work.hSemaphoreWakeup);
+        ctxVmm->Work.hSemaphoreWakeup = NULL;
+    }
+}
+
+VOID VmmWork(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDLE hEventFinish)
+{
+    PVMMWORK_UNIT pu;
+    if(!ctxVmm->Work.fEnabled || !(pu = VmmWork_UnitAlloc())) { return; }
+    pu->pfn = pfn;
+    pu->ctx = ctx;
+    pu->hEventFinish = hEventFinish;
+    pu->pObGroup = NULL;
+    pu->iIoClass = VmmIoSchedClassGet();
+    VmmWork_UnitSchedule(pu);
+}
+
+VOID VmmWorkGroup_CloseObCallback(_In_ PVOID pVmmOb)
+{
+    PVMMOB_WORK_GROUP pg = (PVMMOB_WORK_GROUP)pVmmOb;
+    if(pg->hEventFinish) {
+        CloseHandle(pg->hEventFinish);
     }
-    ObSet_Remove(ctxVmm->Work.psThreadAll, (QWORD)ctx);
-    CloseHandle(ctx->hEventWakeup);
-    CloseHandle(ctx->hThread);
-    LocalFree(ctx);
-    return 1;
 }
 
-VOID VmmWork_Initialize()
+PVMMOB_WORK_GROUP VmmWorkGroup_New()
 {
-    PVMMWORK_THREAD_CONTEXT p;
-    ctxVmm->Work.fEnabled = TRUE;
-    ctxVmm->Work.psUnit = ObSet_New();
-    ctxVmm->Work.psThreadAll = ObSet_New();
-    ctxVmm->Work.psThreadAvail = ObSet_New();
-    while(ObSet_Size(ctxVmm->Work.psThreadAll) < VMM_WORK_THREADPOOL_NUM_THREADS) {
-        if((p = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMWORK_THREAD_CONTEXT)))) {
-            p->hEventWakeup = CreateEvent(NULL, TRUE, FALSE, NULL);
-            p->hThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)VmmWork_MainWorkerLoop_ThreadProc, p, 0, NULL);
-            ObSet_Push(ctxVmm->Work.psThreadAll, (QWORD)p);
-        }
+    PVMMOB_WORK_GROUP pObGroup;
+    if(!(pObGroup = Ob_Alloc(OB_TAG_VMM_WORK_GROUP, LMEM_ZEROINIT, sizeof(VMMOB_WORK_GROUP), VmmWorkGroup_CloseObCallback, NULL))) { return NULL; }
+    if(!(pObGroup->hEventFinish = CreateEvent(NULL, TRUE, TRUE, NULL))) {
+        Ob_DECREF(pObGroup);
+        return NULL;
     }
+    return pObGroup;
 }
 
-VOID VmmWork_Close()
+VOID VmmWorkGroup_Add(_In_ PVMMOB_WORK_GROUP pg, _In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx)
 {
     PVMMWORK_UNIT pu;
-    PVMMWORK_THREAD_CONTEXT pt = NULL;
-    ctxVmm->Work.fEnabled = FALSE;
-    while(ObSet_Size(ctxVmm->Work.psThreadAll)) {
-        while((pt = (PVMMWORK_THREAD_CONTEXT)ObSet_GetNext(ctxVmm->Work.psThreadAll, (QWORD)pt))) {
-            SetEvent(pt->hEventWakeup);
-        }
-        SwitchToThread();
-    }
-    while((pu = (PVMMWORK_UNIT)ObSet_Pop(ctxVmm->Work.psUnit))) {
-        if(pu->hEventFinish) {
-            SetEvent(pu->hEventFinish);
-        }
-        LocalFree(pu);
+    if(!ctxVmm->Work.fEnabled || !(pu = VmmWork_UnitAlloc())) { return; }
+    pu->pfn = pfn;
+    pu->ctx = ctx;
+    pu->hEventFinish = NULL;
+    pu->pObGroup = Ob_INCREF(pg);
+    pu->iIoClass = VmmIoSchedClassGet();
+    InterlockedIncrement(&pg->cPending);
+    VmmWork_UnitSchedule(pu);
+}
+
+/*
+* Find a not yet started work unit of a work group for a joining thread: (1)
+* own deque (newest first), (2) injection queue and (3) steal from the deques
+* of the other worker threads. Work units of other groups are never taken.
+*/
+PVMMWORK_UNIT VmmWorkGroup_UnitFind(_In_opt_ PVMMWORK_THREAD_CONTEXT ctx, _In_ PVMMOB_WORK_GROUP pg)
+{
+    DWORD i, cThread = ctxVmm->Work.cThread;
+    PVMMWORK_UNIT pu;
+    if(ctx && (pu = VmmWorkDeque_PopBottom(&ctx->Deque, pg))) { return pu; }
+    if((pu = VmmWorkDeque_PopGroup(&ctxVmm->Work.Inject, pg, FALSE))) { return pu; }
+    if(!ctxVmm->Work.pThreads) { return NULL; }
+    for(i = 0; i < cThread; i++) {
+        if(ctx && (i == ctx->i)) { continue; }
+        if((pu = VmmWorkDeque_PopGroup(&ctxVmm->Work.pThreads[i].Deque, pg, TRUE))) { return pu; }
     }
-    Ob_DECREF_NULL(&ctxVmm->Work.psUnit);
-    Ob_DECREF_NULL(&ctxVmm->Work.psThreadAll);
-    Ob_DECREF_NULL(&ctxVmm->Work.psThreadAvail);
+    return NULL;
 }
 
-VOID VmmWork(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDLE hEventFinish)
+VOID VmmWorkGroup_Join(_In_ PVMMOB_WORK_GROUP pg)
 {
     PVMMWORK_UNIT pu;
-    PVMMWORK_THREAD_CONTEXT pt;
-    if((pu = LocalAlloc(0, sizeof(VMMWORK_UNIT)))) {
-        pu->pfn = pfn;
-        pu->ctx = ctx;
-        pu->hEventFinish = hEventFinish;
-        ObSet_Push(ctxVmm->Work.psUnit, (QWORD)pu);
-        if((pt = (PVMMWORK_THREAD_CONTEXT)ObSet_Pop(ctxVmm->Work.psThreadAvail))) {
-            SetEvent(pt->hEventWakeup);
+    PVMMWORK_THREAD_CONTEXT ctx = (PVMMWORK_THREAD_CONTEXT)TlsGetValue(ctxVmm->Work.dwTlsIndex);
+    while(pg->cPending) {
+        // help: execute not yet started work units of the group - own and
+        // stolen from the injection queue and the other worker threads.
+        if((pu = VmmWorkGroup_UnitFind(ctx, pg))) {
+            VmmWork_UnitExecute(pu);
+            continue;
         }
+        // reset before re-check - a completion after the reset sets the event
+        ResetEvent(pg->hEventFinish);
+        if(!pg->cPending) { break; }
+        WaitForSingleObject(pg->hEventFinish, INFINITE);
     }
 }
 
@@ -1423,10 +2894,8 @@ VOID VmmWork(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDL
 // ----------------------------------------------------------------------------
 
 typedef struct tdVMM_PROCESS_ACTION_FOREACH {
-    HANDLE hEventFinish;
     VOID(*pfnAction)(_In_ PVMM_PROCESS pProcess, _In_ PVOID ctx);
     PVOID ctxAction;
-    DWORD cRemainingWork;       // set to dwPIDs count on entry and decremented as-goes - when zero FinishEvent is set.
     DWORD iPID;                 // set to dwPIDs count on entry and decremented as-goes
     DWORD dwPIDs[];
 } VMM_PROCESS_ACTION_FOREACH, *PVMM_PROCESS_ACTION_FOREACH;
@@ -1438,9 +2907,6 @@ DWORD VmmProcessActionForeachParallel_ThreadProc(PVMM_PROCESS_ACTION_FOREACH ctx
         ctx->pfnAction(pObProcess, ctx->ctxAction);
         Ob_DECREF(pObProcess);
     }
-    if(0 == InterlockedDecrement(&ctx->cRemainingWork)) {
-        SetEvent(ctx->hEventFinish);
-    }
     return 1;
 }
 
@@ -1455,6 +2921,7 @@ VOID VmmProcessActionForeachParallel(_In_opt_ PVOID ctxAction, _In_opt_ BOOL(*pf
     PVMM_PROCESS pObProcess = NULL;
     POB_SET pObProcessSelectedSet = NULL;
     PVMM_PROCESS_ACTION_FOREACH ctx = NULL;
+    PVMMOB_WORK_GROUP pObGroup = NULL;
     // 1: select processes to queue using criteria function
     if(!(pObProcessSelectedSet = ObSet_New())) { goto fail; }
     while(pObProcess = VmmProcessGetNext(pObProcess, VMM_FLAG_PROCESS_SHOW_TERMINATED)) {
@@ -1465,28 +2932,207 @@ VOID VmmProcessActionForeachParallel(_In_opt_ PVOID ctxAction, _In_opt_ BOOL(*pf
     if(!(cProcess = ObSet_Size(pObProcessSelectedSet))) { goto fail; }
     // 2: set up context for worker function
     if(!(ctx = LocalAlloc(LMEM_ZEROINIT, sizeof(VMM_PROCESS_ACTION_FOREACH) + cProcess * sizeof(DWORD)))) { goto fail; }
-    if(!(ctx->hEventFinish = CreateEvent(NULL, TRUE, FALSE, NULL))) { goto fail; }
+    if(!(pObGroup = VmmWorkGroup_New())) { goto fail; }
     ctx->pfnAction = pfnAction;
     ctx->ctxAction = ctxAction;
-    ctx->cRemainingWork = cProcess;
     ctx->iPID = cProcess;
     for(i = 0; i < cProcess; i++) {
         ctx->dwPIDs[i] = (DWORD)ObSet_Pop(pObProcessSelectedSet);
     }
     // 3: parallelize onto worker threads and wait for completion
     for(i = 0; i < cProcess; i++) {
-        VmmWork(VmmProcessActionForeachParallel_ThreadProc, ctx, NULL);
+        VmmWorkGroup_Add(pObGroup, VmmProcessActionForeachParallel_ThreadProc, ctx);
     }
-    WaitForSingleObject(ctx->hEventFinish, INFINITE);
-    BOOL DEBUG = ctxVmm->f32;
+    VmmWorkGroup_Join(pObGroup);
 fail:
     Ob_DECREF(pObProcessSelectedSet);
-    if(ctx) {
-        if(ctx->hEventFinish) {
-            CloseHandle(ctx->hEventFinish);
+    Ob_DECREF(pObGroup);
+    LocalFree(ctx);
+}
+
+// ----------------------------------------------------------------------------
+// READ-AHEAD FUNCTIONALITY BELOW:
+// Cache misses are tracked in stream tables - one for the physical address
+// space and one per process for the virtual address space. An access which
+// continues a sequential or strided stream doubles the read-ahead window of
+// the stream; the next window is read ahead once less than half of the window
+// remains ahead of the reader. Reads not part of a stream are padded with a
+// few contiguous physical pages (if small enough). Read-ahead pages are tagged
+// in the cache; the max stream window and the non-stream window adapt to the
+// ratio of read-ahead pages that are later hit.
+// ----------------------------------------------------------------------------
+
+#define VMM_READAHEAD_ADAPT_INTERVAL        0x200   // # of read-ahead pages between window adaptions
+
+/*
+* Adapt the read-ahead windows to the accuracy (ratio of read-ahead pages hit)
+* observed since the last adaption.
+*/
+VOID VmmReadAhead_Adapt()
+{
+    DWORD tp, dwAccuracy, cWindow;
+    QWORD cIssued, cHit;
+    if(!TryAcquireSRWLockExclusive(&ctxVmm->ReadAhead.LockAdapt)) { return; }
+    for(tp = VMM_READAHEAD_TP_RANDOM; tp <= VMM_READAHEAD_TP_STREAM; tp++) {
+        cIssued = ctxVmm->stat.readahead.cIssued[tp] - ctxVmm->ReadAhead.cIssuedLast[tp];
+        if(cIssued < VMM_READAHEAD_ADAPT_INTERVAL) { continue; }
+        cHit = ctxVmm->stat.readahead.cHit[tp] - ctxVmm->ReadAhead.cHitLast[tp];
+        ctxVmm->ReadAhead.cIssuedLast[tp] += cIssued;
+        ctxVmm->ReadAhead.cHitLast[tp] += cHit;
+        dwAccuracy = (DWORD)(min(cHit, cIssued) * 100 / cIssued);
+        if(tp == VMM_READAHEAD_TP_RANDOM) {
+            cWindow = ctxVmm->ReadAhead.cWindowRandom;
+            if(dwAccuracy < 25) { cWindow = max(1, cWindow / 2); }
+            if(dwAccuracy > 50) { cWindow = min(VMM_READAHEAD_RANDOM_MAX, cWindow * 2 + 1); }
+            ctxVmm->ReadAhead.cWindowRandom = cWindow;
+        } else {
+            cWindow = ctxVmm->ReadAhead.cWindowMax;
+            if(dwAccuracy < 25) { cWindow = max(VMM_READAHEAD_WINDOW_MIN, cWindow / 2); }
+            if(dwAccuracy > 50) { cWindow = min(VMM_READAHEAD_WINDOW_MAX, cWindow * 2); }
+            ctxVmm->ReadAhead.cWindowMax = cWindow;
+        }
+    }
+    ReleaseSRWLockExclusive(&ctxVmm->ReadAhead.LockAdapt);
+}
+
+/*
+* Register an access of the pages [qwFirst, qwLast] in a stream table and
+* retrieve the pages to read ahead (if any).
+* -- pRA
+* -- qwFirst = first page of access.
+* -- qwLast = last page of access.
+* -- pqwAhead = buffer of VMM_READAHEAD_WINDOW_MAX entries to receive pages to read ahead.
+* -- return = # of pages to read ahead, or (DWORD)-1 if access is not part of a stream.
+*/
+DWORD VmmReadAhead_Access(_In_ PVMM_READAHEAD_STREAMS pRA, _In_ QWORD qwFirst, _In_ QWORD qwLast, _Out_writes_(VMM_READAHEAD_WINDOW_MAX) PQWORD pqwAhead)
+{
+    DWORD i, iLRU = 0, cAhead = 0, dwTick, dwAge, dwAgeMax = 0;
+    LONG64 iDiff, iAheadRemain;
+    QWORD qwAnchor, qwStart;
+    PVMM_READAHEAD_STREAM pe, s = NULL;
+    VmmReadAhead_Adapt();
+    dwTick = (DWORD)GetTickCount64();
+    AcquireSRWLockExclusive(&pRA->LockSRW);
+    // 1: continuation of a known stream?
+    for(i = 0; i < VMM_READAHEAD_STREAMS; i++) {
+        pe = pRA->S + i;
+        if(!pe->fValid || !pe->iStride) { continue; }
+        if(pe->iStride == 0x1000) {
+            if((qwFirst > pe->qwLast) && (qwFirst <= max(pe->qwLast, pe->qwAheadEnd) + 0x1000)) { s = pe; break; }
+        } else {
+            if((qwFirst == pe->qwFirst + pe->iStride) || (qwFirst == pe->qwAheadEnd + pe->iStride)) { s = pe; break; }
+        }
+    }
+    if(s) {
+        s->cWindow = min(ctxVmm->ReadAhead.cWindowMax, max(2, s->cWindow * 2));
+        InterlockedIncrement64((s->iStride == 0x1000) ? &ctxVmm->stat.readahead.cAccessSequential : &ctxVmm->stat.readahead.cAccessStrided);
+    }
+    // 2: new sequential / strided stream from a recent access?
+    if(!s) {
+        for(i = 0; i < VMM_READAHEAD_STREAMS; i++) {
+            pe = pRA->S + i;
+            if(!pe->fValid) { continue; }
+            iDiff = (qwFirst == pe->qwLast + 0x1000) ? 0x1000 : (LONG64)(qwFirst - pe->qwFirst);
+            if(iDiff && (iDiff >= -VMM_READAHEAD_STRIDE_MAX * 0x1000) && (iDiff <= VMM_READAHEAD_STRIDE_MAX * 0x1000)) {
+                s = pe;
+                s->iStride = iDiff;
+                s->cWindow = 0;
+                s->qwAheadEnd = (iDiff == 0x1000) ? qwLast : qwFirst;
+                break;
+            }
+        }
+    }
+    // 3: random access -> replace least recently used stream
+    if(!s) {
+        for(i = 0; i < VMM_READAHEAD_STREAMS; i++) {
+            pe = pRA->S + i;
+            dwAge = pe->fValid ? (dwTick - pe->dwTick) : (DWORD)-1;
+            if(dwAge >= dwAgeMax) {
+                dwAgeMax = dwAge;
+                iLRU = i;
+            }
+        }
+        s = pRA->S + iLRU;
+        ZeroMemory(s, sizeof(VMM_READAHEAD_STREAM));
+        s->fValid = TRUE;
+        s->qwFirst = qwFirst;
+        s->qwLast = qwLast;
+        s->qwAheadEnd = qwLast;
+        s->dwTick = dwTick;
+        ReleaseSRWLockExclusive(&pRA->LockSRW);
+        InterlockedIncrement64(&ctxVmm->stat.readahead.cAccessRandom);
+        return (DWORD)-1;
+    }
+    // 4: stream access -> read ahead once less than half the window remains.
+    s->qwFirst = qwFirst;
+    s->qwLast = qwLast;
+    s->dwTick = dwTick;
+    if(s->cWindow) {
+        qwAnchor = (s->iStride == 0x1000) ? qwLast : qwFirst;
+        iAheadRemain = (LONG64)(s->qwAheadEnd - qwAnchor) / s->iStride;
+        iAheadRemain = max(0, iAheadRemain);
+        if(iAheadRemain * 2 <= s->cWindow) {
+            qwStart = iAheadRemain ? s->qwAheadEnd : qwAnchor;
+            for(i = 1; i <= s->cWindow - iAheadRemain; i++) {
+                pqwAhead[cAhead++] = qwStart + i * s->iStride;
+            }
+            s->qwAheadEnd = qwStart + cAhead * s->iStride;
+        }
+    }
+    ReleaseSRWLockExclusive(&pRA->LockSRW);
+    return cAhead;
+}
+
+/*
+* Retrieve the physical pages to read ahead of a physical read.
+* -- paFirst = first missed page.
+* -- paLast = last missed page.
+* -- cMiss = # of missed pages.
+* -- pqwAhead = buffer of VMM_READAHEAD_WINDOW_MAX entries.
+* -- ptpReadAhead = VMM_READAHEAD_TP_*
+* -- return = # of pages to read ahead.
+*/
+DWORD VmmReadAhead_Phys(_In_ QWORD paFirst, _In_ QWORD paLast, _In_ DWORD cMiss, _Out_writes_(VMM_READAHEAD_WINDOW_MAX) PQWORD pqwAhead, _Out_ PDWORD ptpReadAhead)
+{
+    DWORD i, cAhead, cWindow;
+    cAhead = VmmReadAhead_Access(&ctxVmm->ReadAhead.Phys, paFirst, paLast, pqwAhead);
+    if(cAhead != (DWORD)-1) {
+        *ptpReadAhead = VMM_READAHEAD_TP_STREAM;
+        return cAhead;
+    }
+    // not part of a stream -> pad small reads with contiguous pages.
+    *ptpReadAhead = VMM_READAHEAD_TP_RANDOM;
+    cWindow = ctxVmm->ReadAhead.cWindowRandom;
+    if(cMiss > cWindow) { return 0; }
+    cAhead = cWindow + 1 - cMiss;
+    for(i = 0; i < cAhead; i++) {
+        pqwAhead[i] = paLast + ((QWORD)(i + 1) << 12);
+    }
+    return cAhead;
+}
+
+/*
+* Retrieve the physical pages to read ahead of a virtual read. The read-ahead
+* pages are translated ahead in the virtual address space of the process.
+* -- pProcess
+* -- vaFirst = first page of read.
+* -- vaLast = last page of read.
+* -- pqwAhead = buffer of VMM_READAHEAD_WINDOW_MAX entries to receive physical pages.
+* -- return = # of physical pages to read ahead, or (DWORD)-1 if the read is not part of a stream.
+*/
+DWORD VmmReadAhead_Virt(_In_ PVMM_PROCESS pProcess, _In_ QWORD vaFirst, _In_ QWORD vaLast, _Out_writes_(VMM_READAHEAD_WINDOW_MAX) PQWORD pqwAhead)
+{
+    DWORD i, cAhead, cPA = 0;
+    BOOL pfPA[VMM_READAHEAD_WINDOW_MAX];
+    cAhead = VmmReadAhead_Access(&pProcess->ReadAhead, vaFirst, vaLast, pqwAhead);
+    if(!cAhead || (cAhead == (DWORD)-1)) { return cAhead; }
+    VmmVirt2PhysBatch(pProcess, cAhead, pqwAhead, pqwAhead, pfPA);
+    for(i = 0; i < cAhead; i++) {
+        if(pfPA[i]) {
+            pqwAhead[cPA++] = pqwAhead[i] & ~0xfff;
         }
-        LocalFree(ctx);
     }
+    return cPA;
 }
 
 // ----------------------------------------------------------------------------
@@ -1534,19 +3180,35 @@ VOID VmmWriteScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_ PPMEM_SCATTER pp
     }
 }
 
-VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsPhys, _In_ QWORD flags)
+/*
+* Read physical memory scatter style. Cache misses are read from the device
+* together with read-ahead pages. The read-ahead pages are decided by the
+* virtual read-ahead engine of the process (virtual address space streams) if
+* supplied - otherwise by the physical read-ahead engine. Read-ahead is only
+* evaluated on cache misses or on hits of earlier read-ahead pages.
+* -- ppMEMsPhys
+* -- cpMEMsPhys
+* -- flags
+* -- pProcessAheadOpt = process of virtual read (virtual read-ahead), NULL = physical read-ahead.
+* -- vaAheadFirst = first virtual page of read (if pProcessAheadOpt).
+* -- vaAheadLast = last virtual page of read (if pProcessAheadOpt).
+*/
+VOID VmmReadScatterPhysicalEx(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsPhys, _In_ QWORD flags, _In_opt_ PVMM_PROCESS pProcessAheadOpt, _In_ QWORD vaAheadFirst, _In_ QWORD vaAheadLast)
 {
-    QWORD tp;   // 0 = normal, 1 = already read, 2 = cache hit, 3 = speculative read
-    BOOL fCache;
-    PMEM_SCATTER pMEM;
-    DWORD i, c, cSpeculative;
+    QWORD tp;   // 1 = normal read, 2 = cache hit, 3 = already finished, 4 = read-ahead, 5 = negative cache hit
+    BOOL fCache, fAllHit, fReadAheadHit = FALSE;
+    PMEM_SCATTER pMEM, pMEMMissFirst = NULL, pMEMMissLast = NULL;
+    DWORD i, c = 0, cAhead = 0, cSpeculative, tpReadAhead = VMM_READAHEAD_TP_STREAM;
+    LONG tpHit;
+    QWORD pqwAhead[VMM_READAHEAD_WINDOW_MAX];
     PVMMOB_MEM pObCacheEntry, pObReservedMEM;
-    PMEM_SCATTER ppMEMsSpeculative[0x18];
-    PVMMOB_MEM ppObCacheSpeculative[0x18];
-    fCache = !(VMM_FLAG_NOCACHE & (flags | ctxVmm->flags));
+    PMEM_SCATTER ppMEMsSpeculativeSmall[0x40 + VMM_READAHEAD_WINDOW_MAX], *ppMEMsSpeculative = ppMEMsSpeculativeSmall;
+    PVMMOB_MEM ppObCacheSpeculativeSmall[0x40 + VMM_READAHEAD_WINDOW_MAX], *ppObCacheSpeculative = ppObCacheSpeculativeSmall;
+    PBYTE pbSpeculativeLarge = NULL;
+    // memory mapped raw dump file is as fast as the cache -> bypass cache.
+    fCache = !(VMM_FLAG_NOCACHE & (flags | ctxVmm->flags)) && !ctxVmm->PhysFile.fActive;
     // 1: cache read
     if(fCache) {
-        c = 0, cSpeculative = 0;
         for(i = 0; i < cpMEMsPhys; i++) {
             pMEM = ppMEMsPhys[i];
             if(pMEM->f) {
@@ -1561,56 +3223,109 @@ VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsP
                 MEM_SCATTER_STACK_PUSH(pMEM, 2);    // 2: cache read
                 pMEM->f = TRUE;
                 memcpy(pMEM->pb, pObCacheEntry->pb, 0x1000);
+                if(pObCacheEntry->tpReadAhead && (tpHit = InterlockedExchange(&pObCacheEntry->tpReadAhead, 0))) {
+                    InterlockedIncrement64(&ctxVmm->stat.readahead.cHit[tpHit]);
+                    fReadAheadHit = TRUE;
+                }
                 Ob_DECREF(pObCacheEntry);
                 InterlockedIncrement64(&ctxVmm->stat.cPhysCacheHit);
                 c++;
                 continue;
             }
+            // known failed read (negative cache) -> hide address from device read
+            if(((pMEM->qwA & 0xfff) + pMEM->cb <= 0x1000) && VmmNegCacheExists(VMM_CACHE_TAG_PHYS, pMEM->qwA)) {
+                InterlockedIncrement64(&ctxVmm->stat.cPhysFailCacheHit);
+                if((flags & VMM_FLAG_ZEROPAD_ON_FAIL) && (pMEM->qwA < ctxMain->dev.paMax)) {
+                    ZeroMemory(pMEM->pb, pMEM->cb);
+                    pMEM->f = TRUE;
+                    MEM_SCATTER_STACK_PUSH(pMEM, 3);    // 3: already finished
+                } else {
+                    MEM_SCATTER_STACK_PUSH(pMEM, pMEM->qwA);
+                    MEM_SCATTER_STACK_PUSH(pMEM, 5);    // 5: negative cache hit
+                    pMEM->qwA = MEM_SCATTER_ADDR_INVALID;
+                }
+                c++;
+                continue;
+            }
             MEM_SCATTER_STACK_PUSH(pMEM, 1);        // 1: normal read
-            // add to potential speculative read map if read is small enough...
-            if(cSpeculative < 0x18) {
-                ppMEMsSpeculative[cSpeculative++] = pMEM;
+            if(!pMEMMissFirst) { pMEMMissFirst = pMEM; }
+            pMEMMissLast = pMEM;
+        }
+        // retrieve pages to read ahead - virtual read-ahead engine (if process
+        // is supplied and the read is part of a virtual stream) or physical
+        // read-ahead engine. full cache hits only register with the virtual
+        // read-ahead engine if hitting read-ahead pages (stream continuation)
+        // - plain cache hits never take the read-ahead lock.
+        fAllHit = (c == cpMEMsPhys);
+        if(!((VMM_FLAG_FORCECACHE_READ | VMM_FLAG_NOCACHEPUT) & flags) && (!fAllHit || (pProcessAheadOpt && fReadAheadHit))) {
+            cAhead = pProcessAheadOpt ? VmmReadAhead_Virt(pProcessAheadOpt, vaAheadFirst, vaAheadLast, pqwAhead) : (DWORD)-1;
+            if((cAhead == (DWORD)-1) && !fAllHit) {
+                cAhead = VmmReadAhead_Phys(pMEMMissFirst->qwA & ~0xfff, pMEMMissLast->qwA & ~0xfff, cpMEMsPhys - c, pqwAhead, &tpReadAhead);
             }
+            if(cAhead == (DWORD)-1) { cAhead = 0; }
         }
-        // all found in cache _OR_ only cached reads allowed -> restore mem stack and return!
-        if((c == cpMEMsPhys) || (VMM_FLAG_FORCECACHE_READ & flags)) {
+        // all found in cache (nothing to read ahead) _OR_ only cached reads
+        // allowed -> restore mem stack and return!
+        if((fAllHit && !cAhead) || (VMM_FLAG_FORCECACHE_READ & flags)) {
             for(i = 0; i < cpMEMsPhys; i++) {
-                MEM_SCATTER_STACK_POP(ppMEMsPhys[i]);
+                pMEM = ppMEMsPhys[i];
+                if(5 == MEM_SCATTER_STACK_POP(pMEM)) {
+                    pMEM->qwA = MEM_SCATTER_STACK_POP(pMEM);
+                }
             }
             return;
         }
     }
-    // 2: speculative future read if negligible performance loss
-    if(fCache && cSpeculative && (cSpeculative < 0x18)) {
+    // 2: read-ahead - read cache misses together with read-ahead pages
+    cSpeculative = cpMEMsPhys - c + cAhead;
+    if(cAhead && (cSpeculative > _countof(ppMEMsSpeculativeSmall))) {
+        if((pbSpeculativeLarge = LocalAlloc(0, cSpeculative * (sizeof(PMEM_SCATTER) + sizeof(PVMMOB_MEM))))) {
+            ppMEMsSpeculative = (PPMEM_SCATTER)pbSpeculativeLarge;
+            ppObCacheSpeculative = (PVMMOB_MEM*)(pbSpeculativeLarge + cSpeculative * sizeof(PMEM_SCATTER));
+        } else {
+            cAhead = 0;
+        }
+    }
+    if(cAhead) {
+        cSpeculative = 0;
         for(i = 0; i < cpMEMsPhys; i++) {
             pMEM = ppMEMsPhys[i];
             if(1 != MEM_SCATTER_STACK_PEEK(pMEM, 1)) {
-                MEM_SCATTER_STACK_POP(pMEM);
+                if(5 == MEM_SCATTER_STACK_POP(pMEM)) {
+                    pMEM->qwA = MEM_SCATTER_STACK_POP(pMEM);
+                }
+                continue;
             }
+            ppObCacheSpeculative[cSpeculative] = NULL;
+            ppMEMsSpeculative[cSpeculative++] = pMEM;
         }
-        while(cSpeculative < 0x18) {
-            if((ppObCacheSpeculative[cSpeculative] = VmmCacheReserve(VMM_CACHE_TAG_PHYS))) {
-                pMEM = ppMEMsSpeculative[cSpeculative] = &ppObCacheSpeculative[cSpeculative]->h;
-                MEM_SCATTER_STACK_PUSH(pMEM, 4);
-                pMEM->f = FALSE;
-                pMEM->qwA = ((QWORD)ppMEMsSpeculative[cSpeculative - 1]->qwA & ~0xfff) + 0x1000;
-                cSpeculative++;
-            }
+        for(i = 0; i < cAhead; i++) {
+            if((pqwAhead[i] >= ctxMain->dev.paMax) || VmmCacheExists(VMM_CACHE_TAG_PHYS, pqwAhead[i]) || VmmNegCacheExists(VMM_CACHE_TAG_PHYS, pqwAhead[i])) { continue; }
+            if(!(ppObCacheSpeculative[cSpeculative] = VmmCacheReserve(VMM_CACHE_TAG_PHYS))) { break; }
+            pMEM = ppMEMsSpeculative[cSpeculative] = &ppObCacheSpeculative[cSpeculative]->h;
+            MEM_SCATTER_STACK_PUSH(pMEM, 4);        // 4: read-ahead
+            pMEM->f = FALSE;
+            pMEM->qwA = pqwAhead[i];
+            cSpeculative++;
         }
         ppMEMsPhys = ppMEMsSpeculative;
         cpMEMsPhys = cSpeculative;
     }
     // 3: read!
-    LcReadScatter(ctxMain->hLC, cpMEMsPhys, ppMEMsPhys);
+    VmmReadScatterDevice(cpMEMsPhys, ppMEMsPhys);
     // 4: statistics and read fail zero fixups (if required)
     for(i = 0; i < cpMEMsPhys; i++) {
         pMEM = ppMEMsPhys[i];
         if(pMEM->f) {
             // success
             InterlockedIncrement64(&ctxVmm->stat.cPhysReadSuccess);
-        } else {
-            // fail
+        } else if(MEM_SCATTER_ADDR_ISVALID(pMEM)) {
+            // fail (negative cache hits are hidden from the device by an
+            // invalid address - they're counted as cPhysFailCacheHit only).
             InterlockedIncrement64(&ctxVmm->stat.cPhysReadFail);
+            if(fCache && !(VMM_FLAG_NOCACHEPUT & flags) && ((pMEM->qwA & 0xfff) + pMEM->cb <= 0x1000)) {
+                VmmNegCachePush(VMM_CACHE_TAG_PHYS, pMEM->qwA);
+            }
             if((flags & VMM_FLAG_ZEROPAD_ON_FAIL) && (pMEM->qwA < ctxMain->dev.paMax)) {
                 ZeroMemory(pMEM->pb, pMEM->cb);
                 pMEM->f = TRUE;
@@ -1622,10 +3337,19 @@ VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsP
         for(i = 0; i < cpMEMsPhys; i++) {
             pMEM = ppMEMsPhys[i];
             tp = MEM_SCATTER_STACK_POP(pMEM);
-            if(!(VMM_FLAG_NOCACHEPUT & flags)) {
-                if(tp == 4) {   // 4 == speculative & backed by cache reserved
-                    VmmCacheReserveReturn(ppObCacheSpeculative[i]);
+            if(tp == 5) {   // 5 == negative cache hit -> restore address
+                pMEM->qwA = MEM_SCATTER_STACK_POP(pMEM);
+            }
+            if(tp == 4) {   // 4 == read-ahead & backed by cache reserved
+                if(pMEM->f) {
+                    ppObCacheSpeculative[i]->tpReadAhead = tpReadAhead;
+                    InterlockedIncrement64(&ctxVmm->stat.readahead.cIssued[tpReadAhead]);
+                } else {
+                    InterlockedIncrement64(&ctxVmm->stat.readahead.cWasted);
                 }
+                VmmCacheReserveReturn(ppObCacheSpeculative[i]);
+            }
+            if(!(VMM_FLAG_NOCACHEPUT & flags)) {
                 if((tp == 1) && pMEM->f) { // 1 = normal read
                     if((pObReservedMEM = VmmCacheReserve(VMM_CACHE_TAG_PHYS))) {
                         pObReservedMEM->h.f = TRUE;
@@ -1637,34 +3361,62 @@ VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsP
             }
         }
     }
+    LocalFree(pbSpeculativeLarge);
+}
+
+VOID VmmReadScatterPhysical(_Inout_ PPMEM_SCATTER ppMEMsPhys, _In_ DWORD cpMEMsPhys, _In_ QWORD flags)
+{
+    VmmReadScatterPhysicalEx(ppMEMsPhys, cpMEMsPhys, flags, NULL, 0, 0);
 }
 
 VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVirt) PPMEM_SCATTER ppMEMsVirt, _In_ DWORD cpMEMsVirt, _In_ QWORD flags)
 {
-    // NB! the buffers pIoPA / ppMEMsPhys are used for both:
-    //     - physical memory (grows from 0 upwards)
-    //     - paged memory (grows from top downwards).
+    // NB! the buffers pIoPA / ppMEMsPhys are used for physical memory and are
+    //     followed by the batch paged read array pPagedReads and the batch
+    //     virt2phys arrays pqwV2P / pfV2P.
     BOOL fVirt2Phys;
-    DWORD i = 0, iVA, iPA;
-    QWORD qwPA, qwPagedPA = 0;
-    BYTE pbBufferSmall[0x20 * (sizeof(MEM_SCATTER) + sizeof(PMEM_SCATTER))];
+    DWORD i, iVA, iPA, iV2P = 0, cV2P = 0, cPaged = 0;
+    QWORD qwPA, vaFirst = 0, vaLast = 0;
+    BYTE pbBufferSmall[0x20 * (sizeof(MEM_SCATTER) + sizeof(PMEM_SCATTER) + sizeof(VMM_PAGED_READ) + sizeof(QWORD) + sizeof(BOOL))];
     PBYTE pbBufferMEMs, pbBufferLarge = NULL;
+    PQWORD pqwV2P;
+    PBOOL pfV2P;
+    PVMM_PAGED_READ pPaged, pPagedReads;
     PMEM_SCATTER pIoPA, pIoVA;
     PPMEM_SCATTER ppMEMsPhys = NULL;
     BOOL fPaging = !(VMM_FLAG_NOPAGING & (flags | ctxVmm->flags));
     BOOL fAltAddrPte = VMM_FLAG_ALTADDR_VA_PTE & flags;
     BOOL fZeropadOnFail = VMM_FLAG_ZEROPAD_ON_FAIL & (flags | ctxVmm->flags);
+    BOOL fReadAhead = !fAltAddrPte && !((VMM_FLAG_NOCACHE | VMM_FLAG_NOCACHEPUT | VMM_FLAG_FORCECACHE_READ) & (flags | ctxVmm->flags)) && !ctxVmm->PhysFile.fActive;
     // 1: allocate / set up buffers (if needed)
     if(cpMEMsVirt < 0x20) {
         ZeroMemory(pbBufferSmall, sizeof(pbBufferSmall));
         ppMEMsPhys = (PPMEM_SCATTER)pbBufferSmall;
         pbBufferMEMs = pbBufferSmall + cpMEMsVirt * sizeof(PMEM_SCATTER);
     } else {
-        if(!(pbBufferLarge = LocalAlloc(LMEM_ZEROINIT, cpMEMsVirt * (sizeof(MEM_SCATTER) + sizeof(PMEM_SCATTER))))) { return; }
+        if(!(pbBufferLarge = LocalAlloc(LMEM_ZEROINIT, cpMEMsVirt * (sizeof(MEM_SCATTER) + sizeof(PMEM_SCATTER) + sizeof(VMM_PAGED_READ) + sizeof(QWORD) + sizeof(BOOL))))) { return; }
         ppMEMsPhys = (PPMEM_SCATTER)pbBufferLarge;
         pbBufferMEMs = pbBufferLarge + cpMEMsVirt * sizeof(PMEM_SCATTER);
     }
-    // 2: translate virt2phys
+    pPagedReads = (PVMM_PAGED_READ)(pbBufferMEMs + cpMEMsVirt * sizeof(MEM_SCATTER));
+    pqwV2P = (PQWORD)(pPagedReads + cpMEMsVirt);
+    pfV2P = (PBOOL)(pqwV2P + cpMEMsVirt);
+    // 2: translate virt2phys - all pending addresses in one batch
+    if(!fAltAddrPte) {
+        for(iVA = 0; iVA < cpMEMsVirt; iVA++) {
+            pIoVA = ppMEMsVirt[iVA];
+            if(pIoVA->f || (pIoVA->qwA == 0) || (pIoVA->qwA == -1)) { continue; }
+            pqwV2P[cV2P++] = pIoVA->qwA;
+        }
+        if(cV2P) {
+            vaFirst = (QWORD)-1;
+            for(i = 0; i < cV2P; i++) {
+                vaFirst = min(vaFirst, pqwV2P[i] & ~0xfff);
+                vaLast = max(vaLast, pqwV2P[i] & ~0xfff);
+            }
+        }
+        VmmVirt2PhysBatch(pProcess, cV2P, pqwV2P, pqwV2P, pfV2P);
+    }
     for(iVA = 0, iPA = 0; iVA < cpMEMsVirt; iVA++) {
         pIoVA = ppMEMsVirt[iVA];
         // MEMORY READ ALREADY COMPLETED
@@ -1676,18 +3428,22 @@ VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVir
         }
         // PHYSICAL MEMORY
         qwPA = 0;
-        fVirt2Phys = !fAltAddrPte && VmmVirt2Phys(pProcess, pIoVA->qwA, &qwPA);
-        // PAGED MEMORY
+        fVirt2Phys = FALSE;
+        if(!fAltAddrPte) {
+            fVirt2Phys = pfV2P[iV2P];
+            qwPA = pqwV2P[iV2P];
+            iV2P++;
+        }
+        // PAGED MEMORY - resolved in one batch below
         if(!fVirt2Phys && fPaging && (pIoVA->cb == 0x1000) && ctxVmm->fnMemoryModel.pfnPagedRead) {
-            if(ctxVmm->fnMemoryModel.pfnPagedRead(pProcess, (fAltAddrPte ? 0 : pIoVA->qwA), (fAltAddrPte ? pIoVA->qwA : qwPA), pIoVA->pb, &qwPagedPA, flags)) {
-                continue;
-            }
-            if(qwPagedPA) {
-                qwPA = qwPagedPA;
-                fVirt2Phys = TRUE;
-            }
+            pPaged = pPagedReads + cPaged++;
+            pPaged->va = fAltAddrPte ? 0 : pIoVA->qwA;
+            pPaged->pte = fAltAddrPte ? pIoVA->qwA : qwPA;
+            pPaged->pb = pIoVA->pb;
+            pPaged->pMEM = pIoVA;
+            continue;
         }
-        if(!fVirt2Phys) {   // NO TRANSLATION MEMORY / FAILED PAGED MEMORY
+        if(!fVirt2Phys) {   // NO TRANSLATION MEMORY
             if(fZeropadOnFail) {
                 ZeroMemory(pIoVA->pb, pIoVA->cb);
             }
@@ -1703,9 +3459,49 @@ VOID VmmReadScatterVirtual(_In_ PVMM_PROCESS pProcess, _Inout_updates_(cpMEMsVir
         pIoPA->f = FALSE;
         MEM_SCATTER_STACK_PUSH(pIoPA, (QWORD)pIoVA);
     }
-    // 3: read and check result
+    // 3: resolve paged memory - pages resolving to physical memory (transition
+    //    and prototype pages) are read together with the physical memory below.
+    if(cPaged) {
+#ifdef VMM_TEST_SELFTEST
+        if(ctxVmm->fnMemoryModel.pfnPagedReadBatch && !ctxVmm->Test.fPagedBatchDisable) {
+#else
+        if(ctxVmm->fnMemoryModel.pfnPagedReadBatch) {
+#endif /* VMM_TEST_SELFTEST */
+            ctxVmm->fnMemoryModel.pfnPagedReadBatch(pProcess, cPaged, pPagedReads, flags);
+        } else {
+            for(i = 0; i < cPaged; i++) {
+                pPaged = pPagedReads + i;
+                pPaged->f = ctxVmm->fnMemoryModel.pfnPagedRead(pProcess, pPaged->va, pPaged->pte, pPaged->pb, &pPaged->pa, flags);
+            }
+        }
+        for(i = 0; i < cPaged; i++) {
+            pPaged = pPagedReads + i;
+            pIoVA = pPaged->pMEM;
+            if(pPaged->f) {
+                pIoVA->f = TRUE;
+                continue;
+            }
+            if(!pPaged->pa) {   // FAILED PAGED MEMORY
+                if(fZeropadOnFail) {
+                    ZeroMemory(pIoVA->pb, pIoVA->cb);
+                }
+                continue;
+            }
+            pIoPA = ppMEMsPhys[iPA] = (PMEM_SCATTER)pbBufferMEMs + iPA;
+            iPA++;
+            pIoPA->version = MEM_SCATTER_VERSION;
+            pIoPA->qwA = pPaged->pa;
+            pIoPA->cb = 0x1000;
+            pIoPA->pb = pIoVA->pb;
+            pIoPA->f = FALSE;
+            MEM_SCATTER_STACK_PUSH(pIoPA, (QWORD)pIoVA);
+        }
+    }
+    // 4: read and check result - read-ahead in the virtual address space
+    //    (sequential / strided streams) is evaluated on cache misses and on
+    //    hits of read-ahead pages only.
     if(iPA) {
-        VmmReadScatterPhysical(ppMEMsPhys, iPA, flags);
+        VmmReadScatterPhysicalEx(ppMEMsPhys, iPA, flags, (fReadAhead ? pProcess : NULL), vaFirst, vaLast);
         while(iPA > 0) {
             iPA--;
             ((PMEM_SCATTER)MEM_SCATTER_STACK_POP(ppMEMsPhys[iPA]))->f = ppMEMsPhys[iPA]->f;
@@ -1765,6 +3561,391 @@ PVMMOB_PHYS2VIRT_INFORMATION VmmPhys2VirtGetInformation(_In_ PVMM_PROCESS pProce
     return pObP2V;
 }
 
+// ----------------------------------------------------------------------------
+// ASYNCHRONOUS READ FUNCTIONALITY BELOW:
+// Scatter reads (and prefetches) may be submitted asynchronously. A submitted
+// batch is executed by one of the VMM i/o threads and the caller receives a
+// completion handle which may be polled or waited upon - allowing CPU-side
+// parsing to overlap device latency. The max number of concurrently executing
+// batches is given by the configurable queue depth. Read pipes built on top
+// of this keep several rounds of multi-round walkers (lists, trees, tables)
+// in flight at the same time.
+// ----------------------------------------------------------------------------
+
+// marks the async i/o threads. A read executing on an i/o thread may nest a
+// walker which submits reads of its own (e.g. a paged prototype pte resolved
+// by the vad spider under the process LockUpdate) - such reads are executed
+// synchronously since waiting on the queue from an i/o thread may deadlock.
+// The tls index is allocated once per process and is never freed.
+static DWORD g_dwVmmReadAsyncTlsIndex = TLS_OUT_OF_INDEXES;
+
+/*
+* Check whether the current thread is a VMM async i/o thread.
+* -- return
+*/
+BOOL VmmReadAsync_IsIoThread()
+{
+    return (g_dwVmmReadAsyncTlsIndex != TLS_OUT_OF_INDEXES) && TlsGetValue(g_dwVmmReadAsyncTlsIndex);
+}
+
+/*
+* Object manager callback function for object cleanup tasks.
+* -- pVmmOb
+*/
+VOID VmmReadAsync_CloseObCallback(_In_ PVOID pVmmOb)
+{
+    PVMMOB_READASYNC pObAsync = (PVMMOB_READASYNC)pVmmOb;
+    Ob_DECREF(pObAsync->pProcess);
+    LcMemFree(pObAsync->ppMEMsAlloc);
+    if(pObAsync->hEventCompleted) {
+        CloseHandle(pObAsync->hEventCompleted);
+    }
+}
+
+/*
+* Execute an async read (in the current thread) and signal its completion.
+* -- pObAsync
+*/
+VOID VmmReadAsync_Execute(_In_ PVMMOB_READASYNC pObAsync)
+{
+    DWORD iIoClassPrevious = VmmIoSchedClassSet(pObAsync->iIoClass);
+    if(pObAsync->pProcess) {
+        VmmReadScatterVirtual(pObAsync->pProcess, pObAsync->ppMEMs, pObAsync->cMEMs, pObAsync->flags);
+    } else {
+        VmmReadScatterPhysical(pObAsync->ppMEMs, pObAsync->cMEMs, pObAsync->flags);
+    }
+    VmmIoSchedClassSet(iIoClassPrevious);
+    InterlockedDecrement(&ctxVmm->ReadAsync.cInFlight);
+    InterlockedExchange(&pObAsync->fCompleted, TRUE);
+    SetEvent(pObAsync->hEventCompleted);
+}
+
+DWORD VmmReadAsync_ThreadProc(_In_ LPVOID lpThreadParameter)
+{
+    DWORD iThread = (DWORD)(SIZE_T)lpThreadParameter;
+    PVMMOB_READASYNC pObAsync;
+    TlsSetValue(g_dwVmmReadAsyncTlsIndex, (LPVOID)1);
+    while(TRUE) {
+        AcquireSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+        // thread #0 always serves the queue to drain it on a lowered depth.
+        while(!ctxVmm->ReadAsync.fShutdown && (!ctxVmm->ReadAsync.pQueueHead || (iThread >= max(1, ctxVmm->ReadAsync.cDepth)))) {
+            SleepConditionVariableSRW(&ctxVmm->ReadAsync.CondQueue, &ctxVmm->ReadAsync.LockSRW, INFINITE, 0);
+        }
+        if(ctxVmm->ReadAsync.fShutdown) {
+            ReleaseSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+            break;
+        }
+        pObAsync = ctxVmm->ReadAsync.pQueueHead;
+        ctxVmm->ReadAsync.pQueueHead = pObAsync->FLink;
+        if(!ctxVmm->ReadAsync.pQueueHead) {
+            ctxVmm->ReadAsync.pQueueTail = NULL;
+        }
+        ReleaseSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+        VmmReadAsync_Execute(pObAsync);
+        Ob_DECREF(pObAsync);
+    }
+    InterlockedDecrement(&ctxVmm->ReadAsync.cThreadActive);
+    return 1;
+}
+
+/*
+* Submit an async read batch. If the batch cannot be submitted, or if it's
+* submitted from an async i/o thread, it's executed synchronously. Ownership of ppMEMsAllocOpt is transferred to the function.
+* CALLER_DECREF: return
+* -- pProcess
+* -- ppMEMs
+* -- cMEMs
+* -- flags
+* -- ppMEMsAllocOpt = LcAllocScatter1 allocated MEMs to free on completion.
+* -- return = completion handle, NULL if executed synchronously.
+*/
+PVMMOB_READASYNC VmmReadAsync_Submit(_In_opt_ PVMM_PROCESS pProcess, _Inout_ PPMEM_SCATTER ppMEMs, _In_ DWORD cMEMs, _In_ QWORD flags, _In_opt_ PPMEM_SCATTER ppMEMsAllocOpt)
+{
+    LONG cInFlight;
+    QWORD cInFlightMax;
+    PVMMOB_READASYNC pObAsync = NULL;
+    InterlockedIncrement64(&ctxVmm->stat.readasync.cSubmit);
+    if(!ctxVmm->ReadAsync.cDepth || !ctxVmm->ReadAsync.cThread || VmmReadAsync_IsIoThread()) { goto fail; }
+    if(!(pObAsync = Ob_Alloc(OB_TAG_VMM_READASYNC, LMEM_ZEROINIT, sizeof(VMMOB_READASYNC), VmmReadAsync_CloseObCallback, NULL))) { goto fail; }
+    if(!(pObAsync->hEventCompleted = CreateEvent(NULL, TRUE, FALSE, NULL))) { goto fail; }
+    pObAsync->pProcess = Ob_INCREF(pProcess);
+    pObAsync->ppMEMs = ppMEMs;
+    pObAsync->cMEMs = cMEMs;
+    pObAsync->flags = flags;
+    pObAsync->ppMEMsAlloc = ppMEMsAllocOpt;
+    pObAsync->iIoClass = VmmIoSchedClassGet();
+    ppMEMsAllocOpt = NULL;
+    cInFlight = InterlockedIncrement(&ctxVmm->ReadAsync.cInFlight);
+    while((cInFlightMax = ctxVmm->stat.readasync.cInFlightMax) < (QWORD)cInFlight) {
+        if((QWORD)InterlockedCompareExchange64((volatile LONG64*)&ctxVmm->stat.readasync.cInFlightMax, cInFlight, cInFlightMax) == cInFlightMax) { break; }
+    }
+    Ob_INCREF(pObAsync);    // reference held by the queue
+    AcquireSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+    if(ctxVmm->ReadAsync.fShutdown) {
+        ReleaseSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+        VmmReadAsync_Execute(pObAsync);
+        Ob_DECREF(pObAsync);
+        return pObAsync;
+    }
+    if(ctxVmm->ReadAsync.pQueueTail) {
+        ctxVmm->ReadAsync.pQueueTail->FLink = pObAsync;
+    } else {
+        ctxVmm->ReadAsync.pQueueHead = pObAsync;
+    }
+    ctxVmm->ReadAsync.pQueueTail = pObAsync;
+    ReleaseSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+    WakeAllConditionVariable(&ctxVmm->ReadAsync.CondQueue);
+    return pObAsync;
+fail:
+    Ob_DECREF(pObAsync);
+    InterlockedIncrement64(&ctxVmm->stat.readasync.cSync);
+    if(pProcess) {
+        VmmReadScatterVirtual(pProcess, ppMEMs, cMEMs, flags);
+    } else {
+        VmmReadScatterPhysical(ppMEMs, cMEMs, flags);
+    }
+    LcMemFree(ppMEMsAllocOpt);
+    return NULL;
+}
+
+PVMMOB_READASYNC VmmReadScatterAsync(_In_opt_ PVMM_PROCESS pProcess, _Inout_ PPMEM_SCATTER ppMEMs, _In_ DWORD cMEMs, _In_ QWORD flags)
+{
+    return VmmReadAsync_Submit(pProcess, ppMEMs, cMEMs, flags, NULL);
+}
+
+PVMMOB_READASYNC VmmCachePrefetchPagesAsync(_In_opt_ PVMM_PROCESS pProcess, _In_opt_ POB_SET psPrefetchNonPageAligned, _In_ DWORD cb, _In_ QWORD flags)
+{
+    QWORD qwA = 0;
+    DWORD cPages, iMEM = 0;
+    POB_SET psObAlign;
+    PPMEM_SCATTER ppMEMs = NULL;
+    PVMMOB_READASYNC pObAsync = NULL;
+    if(!cb || !ObSet_Size(psPrefetchNonPageAligned) || (ctxVmm->flags & VMM_FLAG_NOCACHE)) { return NULL; }
+    if(!pProcess && ctxVmm->PhysFile.fActive) { return NULL; }
+    if(!(psObAlign = ObSet_New())) { return NULL; }
+    while((qwA = ObSet_GetNext(psPrefetchNonPageAligned, qwA))) {
+        ObSet_Push_PageAlign(psObAlign, qwA, cb);
+    }
+    if((cPages = ObSet_Size(psObAlign)) && LcAllocScatter1(cPages, &ppMEMs)) {
+        while((qwA = ObSet_GetNext(psObAlign, qwA))) {
+            ppMEMs[iMEM++]->qwA = qwA & ~0xfff;
+        }
+        pObAsync = VmmReadAsync_Submit(pProcess, ppMEMs, iMEM, flags, ppMEMs);
+    }
+    Ob_DECREF(psObAlign);
+    return pObAsync;
+}
+
+BOOL VmmReadAsyncPoll(_In_opt_ PVMMOB_READASYNC pObAsync)
+{
+    return !pObAsync || pObAsync->fCompleted;
+}
+
+/*
+* Execute a submitted but not yet started batch in the current thread instead
+* of waiting for an i/o thread. A waiter may hold a lock (e.g. the process
+* LockUpdate while spidering vads) which the busy i/o threads are blocked on;
+* the batch would otherwise never be started.
+* -- pObAsync
+* -- return = TRUE if the batch was removed from the queue and executed.
+*/
+BOOL VmmReadAsync_ExecuteQueued(_In_ PVMMOB_READASYNC pObAsync)
+{
+    PVMMOB_READASYNC pPrev = NULL, pCur;
+    AcquireSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+    for(pCur = ctxVmm->ReadAsync.pQueueHead; pCur && (pCur != pObAsync); pCur = pCur->FLink) {
+        pPrev = pCur;
+    }
+    if(pCur) {
+        if(pPrev) {
+            pPrev->FLink = pCur->FLink;
+        } else {
+            ctxVmm->ReadAsync.pQueueHead = pCur->FLink;
+        }
+        if(ctxVmm->ReadAsync.pQueueTail == pCur) {
+            ctxVmm->ReadAsync.pQueueTail = pPrev;
+        }
+    }
+    ReleaseSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+    if(!pCur) { return FALSE; }
+    InterlockedIncrement64(&ctxVmm->stat.readasync.cSync);
+    VmmReadAsync_Execute(pObAsync);
+    Ob_DECREF(pObAsync);    // reference held by the queue
+    return TRUE;
+}
+
+_Success_(return)
+BOOL VmmReadAsyncWait(_In_opt_ PVMMOB_READASYNC pObAsync, _In_ DWORD dwMilliseconds)
+{
+    if(VmmReadAsyncPoll(pObAsync)) { return TRUE; }
+    if(VmmReadAsync_ExecuteQueued(pObAsync)) { return TRUE; }
+    InterlockedIncrement64(&ctxVmm->stat.readasync.cWaitBlock);
+    return WAIT_OBJECT_0 == WaitForSingleObject(pObAsync->hEventCompleted, dwMilliseconds);
+}
+
+DWORD VmmReadAsyncWaitAny(_In_ DWORD cAsync, _In_reads_(cAsync) PVMMOB_READASYNC *ppObAsync, _In_ DWORD dwMilliseconds)
+{
+    DWORD i, dwResult;
+    HANDLE phEvent[MAXIMUM_WAIT_OBJECTS];
+    if(!cAsync || (cAsync > MAXIMUM_WAIT_OBJECTS)) { return (DWORD)-1; }
+    for(i = 0; i < cAsync; i++) {
+        if(VmmReadAsyncPoll(ppObAsync[i])) { return i; }
+        phEvent[i] = ppObAsync[i]->hEventCompleted;
+    }
+    for(i = 0; i < cAsync; i++) {
+        if(VmmReadAsync_ExecuteQueued(ppObAsync[i])) { return i; }
+    }
+    InterlockedIncrement64(&ctxVmm->stat.readasync.cWaitBlock);
+    dwResult = WaitForMultipleObjects(cAsync, phEvent, FALSE, dwMilliseconds);
+    return (dwResult < WAIT_OBJECT_0 + cAsync) ? (dwResult - WAIT_OBJECT_0) : (DWORD)-1;
+}
+
+_Success_(return)
+BOOL VmmReadAsyncDepthSet(_In_ DWORD cDepth)
+{
+    if(cDepth > VMM_READASYNC_DEPTH_MAX) { return FALSE; }
+    AcquireSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+    while(!ctxVmm->ReadAsync.fShutdown && (ctxVmm->ReadAsync.cThread < cDepth)) {
+        InterlockedIncrement(&ctxVmm->ReadAsync.cThreadActive);
+        ctxVmm->ReadAsync.hThread[ctxVmm->ReadAsync.cThread] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)VmmReadAsync_ThreadProc, (LPVOID)(SIZE_T)ctxVmm->ReadAsync.cThread, 0, NULL);
+        if(!ctxVmm->ReadAsync.hThread[ctxVmm->ReadAsync.cThread]) {
+            InterlockedDecrement(&ctxVmm->ReadAsync.cThreadActive);
+            break;
+        }
+        ctxVmm->ReadAsync.cThread++;
+    }
+    ctxVmm->ReadAsync.cDepth = min(cDepth, ctxVmm->ReadAsync.cThread);
+    ReleaseSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+    WakeAllConditionVariable(&ctxVmm->ReadAsync.CondQueue);
+    return TRUE;
+}
+
+DWORD VmmReadAsyncRoundsMax()
+{
+    DWORD cDepth = ctxVmm->ReadAsync.cDepth;
+    if(VmmReadAsync_IsIoThread()) { return 1; }
+    return cDepth ? max(2, min(cDepth, VMM_READASYNC_PIPE_MAX)) : 1;
+}
+
+VOID VmmReadAsync_Initialize()
+{
+    if(g_dwVmmReadAsyncTlsIndex == TLS_OUT_OF_INDEXES) {
+        if((g_dwVmmReadAsyncTlsIndex = TlsAlloc()) == TLS_OUT_OF_INDEXES) { return; }
+    }
+    InitializeSRWLock(&ctxVmm->ReadAsync.LockSRW);
+    InitializeConditionVariable(&ctxVmm->ReadAsync.CondQueue);
+    VmmReadAsyncDepthSet(VMM_READASYNC_DEPTH_DEFAULT);
+}
+
+VOID VmmReadAsync_Close()
+{
+    DWORD i;
+    PVMMOB_READASYNC pObAsync;
+    // 1: wake up and wait for all i/o threads to exit
+    AcquireSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+    ctxVmm->ReadAsync.fShutdown = TRUE;
+    ReleaseSRWLockExclusive(&ctxVmm->ReadAsync.LockSRW);
+    while(ctxVmm->ReadAsync.cThreadActive) {
+        WakeAllConditionVariable(&ctxVmm->ReadAsync.CondQueue);
+        SwitchToThread();
+    }
+    for(i = 0; i < ctxVmm->ReadAsync.cThread; i++) {
+        CloseHandle(ctxVmm->ReadAsync.hThread[i]);
+        ctxVmm->ReadAsync.hThread[i] = NULL;
+    }
+    ctxVmm->ReadAsync.cThread = 0;
+    ctxVmm->ReadAsync.cDepth = 0;
+    // 2: complete not yet started batches (signal waiters) - without reading.
+    while((pObAsync = ctxVmm->ReadAsync.pQueueHead)) {
+        ctxVmm->ReadAsync.pQueueHead = pObAsync->FLink;
+        InterlockedDecrement(&ctxVmm->ReadAsync.cInFlight);
+        InterlockedExchange(&pObAsync->fCompleted, TRUE);
+        SetEvent(pObAsync->hEventCompleted);
+        Ob_DECREF(pObAsync);
+    }
+    ctxVmm->ReadAsync.pQueueTail = NULL;
+}
+
+VOID VmmReadAsyncPipe_Initialize(_Out_ PVMM_READASYNC_PIPE pPipe, _In_opt_ PVMM_PROCESS pProcess, _In_ DWORD cb, _In_ QWORD flags)
+{
+    ZeroMemory(pPipe, sizeof(VMM_READASYNC_PIPE));
+    pPipe->pProcess = pProcess;
+    pPipe->cb = cb;
+    pPipe->flags = flags;
+    pPipe->cMax = VmmReadAsyncRoundsMax();
+}
+
+DWORD VmmReadAsyncPipe_Free(_In_ PVMM_READASYNC_PIPE pPipe)
+{
+    return pPipe->cMax - pPipe->c;
+}
+
+DWORD VmmReadAsyncPipe_Submit(_Inout_ PVMM_READASYNC_PIPE pPipe, _Inout_ POB_SET psRound, _In_opt_ POB_SET psExtraOpt)
+{
+    QWORD va;
+    DWORD i, cPerRound, cSubmit = 0;
+    POB_SET psObRound, psObPrefetch;
+    cPerRound = min(VmmReadAsyncPipe_Free(pPipe), ObSet_Size(psRound));
+    if(!cPerRound) { return 0; }
+    cPerRound = (ObSet_Size(psRound) + cPerRound - 1) / cPerRound;
+    while(ObSet_Size(psRound) && (pPipe->c < pPipe->cMax)) {
+        if(!(psObRound = ObSet_New())) {
+            // out of memory -> prefetch remaining addresses synchronously. The
+            // addresses are left in psRound for the caller to read directly.
+            VmmCachePrefetchPages3(pPipe->pProcess, psRound, pPipe->cb, pPipe->flags);
+            if(!cSubmit) {
+                VmmCachePrefetchPages3(pPipe->pProcess, psExtraOpt, pPipe->cb, pPipe->flags);
+            }
+            break;
+        }
+        for(i = 0; (i < cPerRound) && (va = ObSet_Pop(psRound)); i++) {
+            ObSet_Push(psObRound, va);
+        }
+        // extra addresses are prefetched together with the first round.
+        psObPrefetch = NULL;
+        if(psExtraOpt && !cSubmit && ObSet_Size(psExtraOpt)) {
+            if((psObPrefetch = ObSet_New())) {
+                ObSet_PushSet(psObPrefetch, psObRound);
+                ObSet_PushSet(psObPrefetch, psExtraOpt);
+            } else {
+                VmmCachePrefetchPages3(pPipe->pProcess, psExtraOpt, pPipe->cb, pPipe->flags);
+            }
+        }
+        pPipe->ppObAsync[pPipe->c] = VmmCachePrefetchPagesAsync(pPipe->pProcess, (psObPrefetch ? psObPrefetch : psObRound), pPipe->cb, pPipe->flags);
+        pPipe->ppsObRound[pPipe->c] = psObRound;
+        pPipe->c++;
+        cSubmit++;
+        Ob_DECREF(psObPrefetch);
+    }
+    return cSubmit;
+}
+
+POB_SET VmmReadAsyncPipe_WaitNext(_Inout_ PVMM_READASYNC_PIPE pPipe)
+{
+    DWORD i;
+    POB_SET psOb;
+    if(!pPipe->c) { return NULL; }
+    i = VmmReadAsyncWaitAny(pPipe->c, pPipe->ppObAsync, INFINITE);
+    if(i >= pPipe->c) {
+        i = 0;
+        VmmReadAsyncWait(pPipe->ppObAsync[0], INFINITE);
+    }
+    psOb = pPipe->ppsObRound[i];
+    Ob_DECREF(pPipe->ppObAsync[i]);
+    pPipe->c--;
+    pPipe->ppObAsync[i] = pPipe->ppObAsync[pPipe->c];
+    pPipe->ppsObRound[i] = pPipe->ppsObRound[pPipe->c];
+    return psOb;
+}
+
+VOID VmmReadAsyncPipe_Close(_Inout_ PVMM_READASYNC_PIPE pPipe)
+{
+    POB_SET psOb;
+    while((psOb = VmmReadAsyncPipe_WaitNext(pPipe))) {
+        Ob_DECREF(psOb);
+    }
+}
+
 // ----------------------------------------------------------------------------
 // PUBLICALLY VISIBLE FUNCTIONALITY RELATED TO VMMU.
 // ----------------------------------------------------------------------------
@@ -1773,10 +3954,13 @@ VOID VmmClose()
 {
     if(!ctxVmm) { return; }
     if(ctxVmm->PluginManager.FLink) { PluginManager_Close(); }
+    VmmReadAsync_Close();
     VmmWork_Close();
+    VmmIoSched_Close();
     VmmWinObj_Close();
     VmmWinReg_Close();
     PDB_Close();
+    PDB_Profile_Close();
     Ob_DECREF_NULL(&ctxVmm->pObVfsDumpContext);
     Ob_DECREF_NULL(&ctxVmm->pObPfnContext);
     Ob_DECREF_NULL(&ctxVmm->pObCPROC);
@@ -1784,10 +3968,12 @@ VOID VmmClose()
         ctxVmm->fnMemoryModel.pfnClose();
     }
     MmWin_PagingClose();
+    VmmPhysFile_Close();
     VmmCache2Close(VMM_CACHE_TAG_PHYS);
     VmmCache2Close(VMM_CACHE_TAG_TLB);
     VmmCache2Close(VMM_CACHE_TAG_PAGING);
-    Ob_DECREF_NULL(&ctxVmm->Cache.PAGING_FAILED);
+    VmmNegCacheClose(VMM_CACHE_TAG_PHYS);
+    VmmNegCacheClose(VMM_CACHE_TAG_PAGING);
     Ob_DECREF_NULL(&ctxVmm->Cache.pmPrototypePte);
     Ob_DECREF_NULL(&ctxVmm->pObCMapPhysMem);
     Ob_DECREF_NULL(&ctxVmm->pObCMapUser);
@@ -2071,12 +4257,17 @@ BOOL VmmInitialize()
     // 5: CACHE INIT: Paged Memory Cache Table
     VmmCache2Initialize(VMM_CACHE_TAG_PAGING);
     if(!ctxVmm->Cache.PAGING.fActive) { goto fail; }
-    if(!(ctxVmm->Cache.PAGING_FAILED = ObSet_New())) { goto fail; }
-    // 6: CACHE INIT: Prototype PTE Cache Map
+    // 6: CACHE INIT: Negative (Failed Read) Cache Tables
+    VmmNegCacheInitialize(VMM_CACHE_TAG_PHYS);
+    VmmNegCacheInitialize(VMM_CACHE_TAG_PAGING);
+    if(!ctxVmm->Cache.PHYS_FAILED.fActive || !ctxVmm->Cache.PAGING_FAILED.fActive) { goto fail; }
+    // 7: CACHE INIT: Prototype PTE Cache Map
     if(!(ctxVmm->Cache.pmPrototypePte = ObMap_New(OB_MAP_FLAGS_OBJECT_OB))) { goto fail; }
-    // 7: WORKER THREADS INIT:
+    // 8: I/O SCHEDULER & WORKER THREADS INIT:
+    VmmIoSched_Initialize();
     VmmWork_Initialize();
-    // 8: OTHER INIT:
+    VmmReadAsync_Initialize();
+    // 9: OTHER INIT:
     ctxVmm->pObCMapPhysMem = ObContainer_New(NULL);
     ctxVmm->pObCMapUser = ObContainer_New(NULL);
     ctxVmm->pObCMapNet = ObContainer_New(NULL);
@@ -2088,6 +4279,19 @@ BOOL VmmInitialize()
     InitializeCriticalSection(&ctxVmm->LockUpdateModule);
     InitializeCriticalSection(&ctxVmm->TcpIp.LockUpdate);
     VmmInitializeFunctions();
+    // 10: MEMORY MAPPED RAW DUMP FILE (if possible):
+    VmmPhysFile_Initialize();
+    // 11: READ-AHEAD:
+    ctxVmm->ReadAhead.cWindowMax = VMM_READAHEAD_WINDOW_MAX / 2;
+    ctxVmm->ReadAhead.cWindowRandom = VMM_READAHEAD_RANDOM_DEFAULT;
+    // 12: COALESCED DEVICE READS:
+    ctxVmm->Coalesce.fContiguous = !ctxMain->dev.fVolatile;
+    VmmReadCoalesceSet(VMM_COALESCE_CB_DEFAULT);
+    // 13: CACHE BUDGET (if set on command line):
+    ctxVmm->Cache.Budget.fAdaptive = TRUE;
+    if(ctxMain->cfg.cCacheBudgetMB) {
+        VmmCacheBudgetSet(ctxMain->cfg.cCacheBudgetMB);
+    }
     return TRUE;
 fail:
     VmmClose();
@@ -42,11 +42,15 @@ typedef unsigned __int64                QWORD, *PQWORD;
 #define VMM_MEMMAP_FLAG_SCAN_PE                 0x0002
 #define VMM_MEMMAP_FLAG_ALL                     (VMM_MEMMAP_FLAG_MODULES | VMM_MEMMAP_FLAG_SCAN_PE)
 
-#define VMM_CACHE_TABLESIZE                     0x4011  // (not even # to prevent clogging at specific table 'hash' buckets)
-#define VMM_CACHE_TLB_ENTRIES                   0x4000  // -> 64MB of cached data
-#define VMM_CACHE_PHYS_ENTRIES                  0x4000  // -> 64MB of cached data
+#define VMM_CACHE_BUDGET_MIN_MB                 16      // min total cache budget (if budget is set)
+#define VMM_CACHE_BUDGET_MIN_PROMILLE           100     // min share of budget per cache table
+#define VMM_CACHE_BUDGET_REBALANCE_MS           1000    // min time between adaptive rebalances
+#define VMM_CACHE_BUDGET_REBALANCE_MIN_MISS     0x100   // min # of cache misses for an adaptive rebalance
 
-#define VMM_WORK_THREADPOOL_NUM_THREADS         0x20
+#define VMM_WORK_THREADPOOL_NUM_THREADS         0x20    // min # of worker threads (blocking work items exist)
+#define VMM_WORK_THREADPOOL_NUM_THREADS_MAX     0x80    // max # of worker threads
+#define VMM_WORK_THREADPOOL_THREADS_PER_CPU     4
+#define VMM_WORK_UNIT_POOL_MAX                  0x1000  // max # of pooled (free) work units
 
 #define VMM_FLAG_NOCACHE                        0x00000001  // do not use the data cache (force reading from memory acquisition device).
 #define VMM_FLAG_ZEROPAD_ON_FAIL                0x00000002  // zero pad failed physical memory reads and report success if read within range of physical memory.
@@ -470,6 +474,51 @@ typedef struct tdVMMOB_PROCESS_PERSISTENT {
     } Plugin;
 } VMMOB_PROCESS_PERSISTENT, *PVMMOB_PROCESS_PERSISTENT;
 
+#define VMM_VTLB_ENTRIES                0x200   // translation cache entries per process (power of two)
+#define VMM_VTLB_PROBE                  4       // max probe length (open addressing)
+
+typedef struct tdVMM_VTLB_ENTRY {
+    volatile QWORD qwTag;           // va page | 1 if valid, 2 if locked (being written), 0 if empty
+    volatile QWORD qwA;             // pa on successful translation, pte on failed translation
+    volatile DWORD dwGeneration;    // ctxVmm->Cache.dwVTlbGeneration at time of translation
+    volatile BOOL f;                // translation success
+} VMM_VTLB_ENTRY, *PVMM_VTLB_ENTRY;
+
+#define VMM_READAHEAD_STREAMS           8       // tracked access streams per stream table
+#define VMM_READAHEAD_STRIDE_MAX        0x10    // max stride (in pages) of a strided stream
+#define VMM_READAHEAD_WINDOW_MAX        0x80    // max # of pages read ahead of a stream
+#define VMM_READAHEAD_WINDOW_MIN        0x04    // min value of adaptive max stream window
+#define VMM_READAHEAD_RANDOM_MAX        0x3f    // max # of pages read ahead of a non-stream read
+#define VMM_READAHEAD_RANDOM_DEFAULT    0x17    // initial # of pages read ahead of a non-stream read
+#define VMM_READAHEAD_TP_RANDOM         1
+#define VMM_READAHEAD_TP_STREAM         2
+
+typedef struct tdVMM_READAHEAD_STREAM {
+    BOOL fValid;
+    DWORD cWindow;                  // current read-ahead window (pages)
+    DWORD dwTick;                   // last access (lru replacement)
+    LONG64 iStride;                 // stride in bytes (0 = unknown)
+    QWORD qwFirst;                  // first page of last access
+    QWORD qwLast;                   // last page of last access
+    QWORD qwAheadEnd;               // last page read ahead
+} VMM_READAHEAD_STREAM, *PVMM_READAHEAD_STREAM;
+
+typedef struct tdVMM_READAHEAD_STREAMS {
+    SRWLOCK LockSRW;
+    VMM_READAHEAD_STREAM S[VMM_READAHEAD_STREAMS];
+} VMM_READAHEAD_STREAMS, *PVMM_READAHEAD_STREAMS;
+
+#define VMM_COALESCE_CB_DEFAULT         0x00100000  // default max size of a coalesced contiguous device read
+#define VMM_COALESCE_CB_MAX             0x01000000  // max allowed value of the max size of a coalesced read
+#define VMM_COALESCE_SMALL              0x40        // # of scatter entries handled without heap allocation
+
+#define VMM_IOSCHED_CLASS_INTERACTIVE   0           // i/o priority class: api/vfs calls (default)
+#define VMM_IOSCHED_CLASS_REFRESH       1           // i/o priority class: background refresh and plugin notify
+#define VMM_IOSCHED_CLASS_BULK          2           // i/o priority class: bulk forensic scans
+#define VMM_IOSCHED_CLASS_MAX           3
+#define VMM_IOSCHED_SLICE_DEFAULT       0x100       // default max # of pages per device read for background classes
+#define VMM_IOSCHED_SLICE_MAX           0x1000      // max allowed value of the slice size
+
 typedef struct tdVMM_PROCESS {
     OB ObHdr;
     CRITICAL_SECTION LockUpdate;
@@ -482,6 +531,8 @@ typedef struct tdVMM_PROCESS {
     CHAR szName[16];
     BOOL fUserOnly;
     BOOL fTlbSpiderDone;
+    PVMM_VTLB_ENTRY pVTlb;          // translation cache [VMM_VTLB_ENTRIES] (may be NULL)
+    VMM_READAHEAD_STREAMS ReadAhead;    // virtual address space read-ahead streams
     struct {
         PVMMOB_MAP_PTE pObPte;
         PVMMOB_MAP_VAD pObVad;
@@ -536,9 +587,10 @@ typedef struct tdVMMOB_PROCESS_TABLE {
     POB_CONTAINER pObCNewPROC;      // contains VMM_PROCESS_TABLE
 } VMMOB_PROCESS_TABLE, *PVMMOB_PROCESS_TABLE;
 
-#define VMM_CACHE2_REGIONS      17
-#define VMM_CACHE2_BUCKETS      2039
-#define VMM_CACHE2_MAX_ENTRIES  0x8000
+#define VMM_CACHE2_SHARDS_MAX   64
+#define VMM_CACHE2_BUCKETS      509     // min # of buckets per shard
+#define VMM_CACHE2_MAX_ENTRIES  0x8000  // default max # of entries per cache table
+#define VMM_CACHE2_MIN_ENTRIES  0x400
 
 #define VMM_CACHE_TAG_PHYS      'CaPh'
 #define VMM_CACHE_TAG_PAGING    'CaPg'
@@ -548,10 +600,13 @@ typedef struct tdVMMOB_MEM {
     OB Ob;
     SLIST_ENTRY SListTotal;
     SLIST_ENTRY SListEmpty;
-    struct tdVMMOB_MEM *FLink;
-    struct tdVMMOB_MEM *BLink;
-    struct tdVMMOB_MEM *AgeFLink;
-    struct tdVMMOB_MEM *AgeBLink;
+    struct tdVMMOB_MEM *volatile FLink;     // bucket chain (walked without lock)
+    struct tdVMMOB_MEM *ClockFLink;         // clock ring (shard lock)
+    struct tdVMMOB_MEM *ClockBLink;         // clock ring (shard lock)
+    struct tdVMMOB_MEM *RetireFLink;        // epoch retire list (shard lock)
+    volatile BOOL fClockRef;
+    BOOL fDiscard;                          // entry is being released due to cache shrink
+    volatile LONG tpReadAhead;              // VMM_READAHEAD_TP_* if read ahead and not yet hit
     MEM_SCATTER h;
     union {
         BYTE pb[0x1000];
@@ -560,6 +615,31 @@ typedef struct tdVMMOB_MEM {
     };
 } VMMOB_MEM, *PVMMOB_MEM, **PPVMMOB_MEM;
 
+typedef struct tdVMM_CACHE_BUCKETS {
+    DWORD cB;
+    PVMMOB_MEM volatile B[];
+} VMM_CACHE_BUCKETS, *PVMM_CACHE_BUCKETS;
+
+/*
+* Cache shard. Lookups walk the bucket chains without taking the lock and
+* only announce themselves in cReaders[iEpoch & 1]. Writers (insert/evict)
+* serialize on Lock. Entries removed from a shard are put on the retire list
+* of the current epoch and are only released to the empty list once all
+* readers that may still hold a pointer to them have left (epoch advance).
+* Replaced bucket arrays (on cache resize) are retired in the same way.
+*/
+typedef struct tdVMM_CACHE_SHARD {
+    volatile LONG cReaders[2];
+    volatile DWORD iEpoch;
+    DWORD c;
+    DWORD cRetired;
+    CRITICAL_SECTION Lock;
+    PVMMOB_MEM ClockHand;
+    PVMMOB_MEM Retire[2];
+    PVMM_CACHE_BUCKETS RetireBuckets[2];
+    PVMM_CACHE_BUCKETS volatile pB;
+} VMM_CACHE_SHARD, *PVMM_CACHE_SHARD;
+
 typedef struct tdVMM_CACHE_TABLE {
     BOOL fActive;
     DWORD tag;
@@ -567,17 +647,28 @@ typedef struct tdVMM_CACHE_TABLE {
     SLIST_HEADER ListHeadTotal;
     DWORD cEmpty;
     DWORD cTotal;
-    WORD iReclaimLast;
-    struct {
-        DWORD c;
-        DWORD dwFuture;
-        CRITICAL_SECTION Lock;
-        PVMMOB_MEM AgeFLink;
-        PVMMOB_MEM AgeBLink;
-        PVMMOB_MEM B[VMM_CACHE2_BUCKETS];
-    } R[VMM_CACHE2_REGIONS];
+    DWORD cMaxEntries;
+    DWORD cShard;
+    DWORD iReclaimLast;
+    CRITICAL_SECTION LockResize;
+    VMM_CACHE_SHARD S[VMM_CACHE2_SHARDS_MAX];
 } VMM_CACHE_TABLE, *PVMM_CACHE_TABLE;
 
+#define VMM_NEGCACHE_BUCKET_ENTRIES     8       // 8 * 8 bytes = one 64-byte cache line per bucket
+#define VMM_NEGCACHE_BUCKETS            0x4000  // buckets per table (power of 2) -> fixed 1MB per table
+
+/*
+* Negative (failed read) cache table. A set associative table of 32-bit key
+* fingerprints - membership is probabilistic and false positives are possible
+* (but rare) while false negatives only occur on eviction or expiry. Each entry
+* is a single QWORD [fingerprint:32 | tick:32] read and written lock-free.
+*/
+typedef struct tdVMM_NEGCACHE_TABLE {
+    BOOL fActive;
+    DWORD cBucketMask;
+    volatile QWORD *pqwE;
+} VMM_NEGCACHE_TABLE, *PVMM_NEGCACHE_TABLE;
+
 typedef struct tdVMM_VIRT2PHYS_INFORMATION {
     VMM_MEMORYMODEL_TP tpMemoryModel;
     QWORD va;
@@ -586,15 +677,34 @@ typedef struct tdVMM_VIRT2PHYS_INFORMATION {
     WORD  iPTEs[5]; // Index of PTE in page table
 } VMM_VIRT2PHYS_INFORMATION, *PVMM_VIRT2PHYS_INFORMATION;
 
+#define VMM_VIRT2PHYS_STEP_NEXT         0   // pqw = next level page table (pte)
+#define VMM_VIRT2PHYS_STEP_SUCCESS      1   // pqw = physical address
+#define VMM_VIRT2PHYS_STEP_FAIL         2   // pqw = pte (if invalid pte in lowest level) or 0
+
+// resolve one level of a virtual to physical translation given the page table
+typedef DWORD(*PVMM_VIRT2PHYS_STEP_PFN)(_In_ PVMMOB_MEM pObPT, _In_ QWORD paPT, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD pqw);
+
+// paged memory read request - used by the batched paged read.
+typedef struct tdVMM_PAGED_READ {
+    QWORD va;           // virtual address (0 if unknown).
+    QWORD pte;          // invalid pte of the page.
+    PBYTE pb;           // 4kB page buffer.
+    QWORD pa;           // out: physical address if resolved to physical memory (transition/prototype).
+    BOOL f;             // out: TRUE if the page was read into pb.
+    PMEM_SCATTER pMEM;  // caller context.
+} VMM_PAGED_READ, *PVMM_PAGED_READ;
+
 typedef struct tdVMM_MEMORYMODEL_FUNCTIONS {
     VOID(*pfnClose)();
     BOOL(*pfnVirt2Phys)(_In_ QWORD paDTB, _In_ BOOL fUserOnly, _In_ BYTE iPML, _In_ QWORD va, _Out_ PQWORD ppa);
+    VOID(*pfnVirt2PhysBatch)(_In_ PVMM_PROCESS pProcess, _In_ DWORD cVA, _In_reads_(cVA) PQWORD pqwVA, _Out_writes_(cVA) PQWORD pqwPA, _Out_writes_(cVA) PBOOL pfPA);
     VOID(*pfnVirt2PhysGetInformation)(_Inout_ PVMM_PROCESS pProcess, _Inout_ PVMM_VIRT2PHYS_INFORMATION pVirt2PhysInfo);
     VOID(*pfnPhys2VirtGetInformation)(_In_ PVMM_PROCESS pProcess, _Inout_ PVMMOB_PHYS2VIRT_INFORMATION pP2V);
     BOOL(*pfnPteMapInitialize)(_In_ PVMM_PROCESS pProcess);
     VOID(*pfnTlbSpider)(_In_ PVMM_PROCESS pProcess);
     BOOL(*pfnTlbPageTableVerify)(_Inout_ PBYTE pb, _In_ QWORD pa, _In_ BOOL fSelfRefReq);
     BOOL(*pfnPagedRead)(_In_ PVMM_PROCESS pProcess, _In_opt_ QWORD va, _In_ QWORD pte, _Out_writes_opt_(4096) PBYTE pbPage, _Out_ PQWORD ppa, _In_ QWORD flags);
+    VOID(*pfnPagedReadBatch)(_In_ PVMM_PROCESS pProcess, _In_ DWORD cPages, _Inout_updates_(cPages) PVMM_PAGED_READ pPages, _In_ QWORD flags);
 } VMM_MEMORYMODEL_FUNCTIONS;
 
 // ----------------------------------------------------------------------------
@@ -605,15 +715,19 @@ typedef struct tdVmmConfig {
     CHAR szMountPoint[1];
     QWORD paCR3;
     DWORD tpForensicMode;                 // command line forensic mode
+    DWORD cCacheBudgetMB;                 // command line cache budget (0 = default)
+    DWORD cForensicScanRing;              // # of 16MB chunks in the forensic physical memory scan ring (0 = default)
     // flags below
     BOOL fVerboseDll;
     BOOL fVerbose;
     BOOL fVerboseExtra;
     BOOL fVerboseExtraTlp;
     BOOL fDisableBackgroundRefresh;
+    BOOL fForensicDisableRenderFile;      // disable pre-rendered forensic timeline/ntfs files
     BOOL fDisableLeechCoreClose;    // when device 'existing'
     BOOL fDisableSymbolServerOnStartup;
     BOOL fWaitInitialize;
+    BOOL fWarmMaps;                 // eager initialization of process maps at startup
     // strings below
     CHAR szMemMap[MAX_PATH];
     CHAR szPythonPath[MAX_PATH];
@@ -622,6 +736,7 @@ typedef struct tdVmmConfig {
 
 typedef struct tdVMM_STATISTICS {
     QWORD cPhysCacheHit;
+    QWORD cPhysFailCacheHit;
     QWORD cPhysReadSuccess;
     QWORD cPhysReadFail;
     QWORD cPhysWrite;
@@ -645,10 +760,88 @@ typedef struct tdVMM_STATISTICS {
     QWORD cTlbReadSuccess;
     QWORD cTlbReadFail;
     QWORD cTlbRefreshCache;
+    QWORD cVTlbHit;
+    QWORD cVTlbMiss;
     QWORD cProcessRefreshPartial;
     QWORD cProcessRefreshFull;
+    struct {
+        QWORD cInsert;
+        QWORD cEvict;
+        QWORD cExpire;
+    } negcache;
+    struct {
+        QWORD cAccessSequential;
+        QWORD cAccessStrided;
+        QWORD cAccessRandom;
+        QWORD cIssued[3];       // pages read ahead [VMM_READAHEAD_TP_*]
+        QWORD cHit[3];          // pages read ahead and later hit [VMM_READAHEAD_TP_*]
+        QWORD cWasted;          // pages read ahead and failed or evicted without hit
+    } readahead;
+    struct {
+        QWORD cDeviceCall;      // # of LeechCore read calls (scatter + contiguous)
+        QWORD cPage;            // # of pages requested from the device layer
+        QWORD cDuplicate;       // # of duplicate page requests merged
+        QWORD cRun;             // # of contiguous runs read in one contiguous call
+        QWORD cRunPage;         // # of pages read as part of a contiguous run
+        QWORD cRunFail;         // # of contiguous runs that failed and were re-read scatter style
+    } coalesce;
+    struct {
+        QWORD cSubmit;          // # of submitted async read batches
+        QWORD cSync;            // # of async read batches executed synchronously
+        QWORD cWaitBlock;       // # of waits that blocked on a not yet completed batch
+        QWORD cInFlightMax;     // max # of batches in flight at the same time
+    } readasync;
+    struct {
+        QWORD cRequest;         // # of device read requests
+        QWORD cSlice;           // # of device reads dispatched (requests after slicing)
+        QWORD cWait;            // # of device reads that had to wait in queue
+        QWORD usWaitTotal;      // total time (us) spent waiting in queue
+        QWORD usWaitMax;        // max time (us) spent waiting in queue
+    } iosched[VMM_IOSCHED_CLASS_MAX];
 } VMM_STATISTICS, *PVMM_STATISTICS;
 
+typedef struct tdVMMWORK_DEQUE {
+    SRWLOCK LockSRW;
+    struct tdVMMWORK_UNIT *pTop;        // oldest work unit - stolen by other threads
+    struct tdVMMWORK_UNIT *pBottom;     // newest work unit - taken by owning thread
+    volatile DWORD c;
+} VMMWORK_DEQUE, *PVMMWORK_DEQUE;
+
+typedef struct tdVMMOB_WORK_GROUP {
+    OB ObHdr;
+    volatile LONG cPending;
+    HANDLE hEventFinish;
+} VMMOB_WORK_GROUP, *PVMMOB_WORK_GROUP;
+
+#define VMM_READASYNC_DEPTH_DEFAULT     4       // default # of concurrently executing async read batches
+#define VMM_READASYNC_DEPTH_MAX         16      // max # of concurrently executing async read batches (i/o threads)
+#define VMM_READASYNC_PIPE_MAX          4       // max # of rounds in flight in a pipelined walk
+// #define VMM_TEST_LATENCY_INJECT              // test/benchmark builds only (Test configuration): injected device read latency
+// #define VMM_TEST_SELFTEST                    // test/benchmark builds only (Test configuration): .test module with internal self-tests
+
+typedef struct tdVMMOB_READASYNC {
+    OB ObHdr;
+    struct tdVMMOB_READASYNC *FLink;        // submit queue link (internal)
+    PVMM_PROCESS pProcess;                  // NULL = physical read
+    QWORD flags;
+    DWORD cMEMs;
+    PPMEM_SCATTER ppMEMs;
+    PPMEM_SCATTER ppMEMsAlloc;              // MEMs owned by the async read - LcMemFree on close (internal)
+    DWORD iIoClass;                         // i/o priority class of the submitter (internal)
+    HANDLE hEventCompleted;
+    volatile LONG fCompleted;
+} VMMOB_READASYNC, *PVMMOB_READASYNC;
+
+typedef struct tdVMM_READASYNC_PIPE {
+    PVMM_PROCESS pProcess;
+    DWORD cb;
+    QWORD flags;
+    DWORD cMax;                             // max # of rounds in flight
+    DWORD c;                                // # of rounds in flight
+    PVMMOB_READASYNC ppObAsync[VMM_READASYNC_PIPE_MAX];
+    POB_SET ppsObRound[VMM_READASYNC_PIPE_MAX];
+} VMM_READASYNC_PIPE, *PVMM_READASYNC_PIPE;
+
 typedef struct tdVMM_OFFSET_EPROCESS {
     BOOL fValid;
     BOOL f64VistaOr7;
@@ -875,12 +1068,20 @@ typedef struct tdVMM_CONTEXT {
         DWORD cTick_ProcTotal;
         DWORD cTick_Registry;
     } ThreadProcCache;
+    // eager process map initialization (-warmmaps) progress
+    struct {
+        BOOL fActive;
+        BOOL fCompleted;
+        volatile LONG cProcessTotal;
+        volatile LONG cProcessDone;
+    } WarmMaps;
     VMM_STATISTICS stat;
     VMM_KERNELINFO kernel;
     VMM_OFFSET offset;
     POB pObVfsDumpContext;
     POB pObPfnContext;
     PVOID pPdbContext;
+    PVOID pPdbProfile;
     PVOID pMmContext;
     PVMMWINOBJ_CONTEXT pObjects;
     PVMMWIN_REGISTRY_CONTEXT pRegistry;
@@ -905,16 +1106,89 @@ typedef struct tdVMM_CONTEXT {
         VMM_CACHE_TABLE PHYS;
         VMM_CACHE_TABLE TLB;
         VMM_CACHE_TABLE PAGING;
-        POB_SET PAGING_FAILED;
+        VMM_NEGCACHE_TABLE PHYS_FAILED;     // negative cache: failed physical reads (key: pa)
+        VMM_NEGCACHE_TABLE PAGING_FAILED;   // negative cache: failed paged reads (key: pte)
         POB_MAP pmPrototypePte;     // map with mm_vad.c managed data
+        volatile DWORD dwVTlbGeneration;    // bumped on TLB clear/invalidate - invalidates process translation caches
+        volatile DWORD dwPagingGeneration;  // bumped on PAGING cache clear - invalidates compressed store metadata cache
+        struct {
+            DWORD cMB;              // total budget in MB (0 = default fixed size)
+            BOOL fAdaptive;         // adaptive split of budget between caches
+            DWORD dwPromille[3];    // budget share: PHYS, TLB, PAGING
+            QWORD cMissLast[3];     // miss count at last rebalance: PHYS, TLB, PAGING
+            QWORD cHitLast[3];      // hit count at last rebalance: PHYS, TLB, PAGING
+            QWORD tcRebalanceLast;
+            volatile LONG fRebalanceActive;
+            volatile LONG fRebalanceQueued;
+        } Budget;
     } Cache;
+    // read-ahead (speculative reads)
+    struct {
+        VMM_READAHEAD_STREAMS Phys;         // physical address space read-ahead streams
+        volatile DWORD cWindowMax;          // adaptive max stream window (pages)
+        volatile DWORD cWindowRandom;       // adaptive non-stream read window (pages)
+        QWORD cIssuedLast[3];               // stat.readahead.cIssued at last adaption
+        QWORD cHitLast[3];                  // stat.readahead.cHit at last adaption
+        SRWLOCK LockAdapt;
+    } ReadAhead;
+    // coalescing of adjacent device reads into contiguous reads
+    struct {
+        volatile DWORD cbMax;               // max contiguous read size (0 = disabled)
+        BOOL fContiguous;                   // backend benefits from contiguous reads (non-volatile)
+    } Coalesce;
+    // asynchronous reads
+    struct {
+        SRWLOCK LockSRW;
+        CONDITION_VARIABLE CondQueue;
+        PVMMOB_READASYNC pQueueHead;        // submitted not yet started batches (reference held)
+        PVMMOB_READASYNC pQueueTail;
+        volatile DWORD cDepth;              // max # of concurrently executing batches (0 = synchronous)
+        DWORD cThread;                      // # of started i/o threads
+        volatile LONG cThreadActive;
+        volatile LONG cInFlight;
+        BOOL fShutdown;
+        HANDLE hThread[VMM_READASYNC_DEPTH_MAX];
+#ifdef VMM_TEST_LATENCY_INJECT
+        volatile DWORD cMsLatencyInject;    // injected latency (ms) per device read call - for benchmarks
+#endif /* VMM_TEST_LATENCY_INJECT */
+    } ReadAsync;
+    // priority aware device i/o scheduler
+    struct {
+        BOOL fActive;
+        QWORD qwFreq;                       // performance counter frequency
+        volatile DWORD cSlice;              // max # of pages per device read for background classes (0 = disabled)
+        SRWLOCK LockSRW;
+        CONDITION_VARIABLE CondGrant;
+        DWORD cActive;                      // # of background device reads currently dispatched
+        struct tdVMM_IOSCHED_REQUEST *pQueueHead[VMM_IOSCHED_CLASS_MAX];
+        struct tdVMM_IOSCHED_REQUEST *pQueueTail[VMM_IOSCHED_CLASS_MAX];
+    } IoSched;
+    // memory mapped raw dump file
+    struct {
+        BOOL fActive;
+        HANDLE hFile;
+        HANDLE hMap;
+        PBYTE pb;
+        QWORD cb;
+    } PhysFile;
     // worker threads
     struct {
         BOOL fEnabled;
-        POB_SET psThreadAll;
-        POB_SET psThreadAvail;
-        POB_SET psUnit;
+        DWORD cThread;
+        volatile LONG cThreadActive;
+        volatile LONG cThreadIdle;
+        DWORD dwTlsIndex;                   // tls: current thread PVMMWORK_THREAD_CONTEXT
+        HANDLE hSemaphoreWakeup;
+        struct tdVMMWORK_THREAD_CONTEXT *pThreads;
+        VMMWORK_DEQUE Inject;               // work scheduled from non-worker threads
+        SLIST_HEADER ListHeadFreeUnit;      // pooled work units
     } Work;
+#ifdef VMM_TEST_SELFTEST
+    // test/benchmark knobs - set through the .test module (DWORD members only)
+    struct {
+        DWORD fPagedBatchDisable;           // resolve paged memory page-by-page (no pfnPagedReadBatch)
+    } Test;
+#endif /* VMM_TEST_SELFTEST */
     WCHAR _EmptyWCHAR;
     VMMWIN_OBJECT_TYPE_TABLE ObjectTypeTable;
 } VMM_CONTEXT, *PVMM_CONTEXT;
@@ -1180,18 +1454,50 @@ inline BOOL VmmVirt2PhysEx(_In_ QWORD paDTB, _In_ BOOL fUserOnly, _In_ QWORD va,
 * The successfully translated Physical Address (PA) is returned in ppa.
 * Upon fail the PTE will be returned in ppa (if possible) - which may be used
 * to further lookup virtual memory in case of PageFile or Win10 MemCompression.
+* Results are cached in the per-process translation cache until the next TLB
+* cache clear or invalidation.
 * -- pProcess
 * -- va
 * -- ppa
 * -- return
 */
 _Success_(return)
-inline BOOL VmmVirt2Phys(_In_ PVMM_PROCESS pProcess, _In_ QWORD va, _Out_ PQWORD ppa)
-{
-    *ppa = 0;
-    if(ctxVmm->tpMemoryModel == VMM_MEMORYMODEL_NA) { return FALSE; }
-    return ctxVmm->fnMemoryModel.pfnVirt2Phys(pProcess->paDTB, pProcess->fUserOnly, -1, va, ppa);
-}
+BOOL VmmVirt2Phys(_In_ PVMM_PROCESS pProcess, _In_ QWORD va, _Out_ PQWORD ppa);
+
+/*
+* Invalidate all per-process translation caches by bumping the global VTLB
+* generation. Called when the TLB cache is cleared or when a cached page table
+* is invalidated - not when a page table is evicted by the cache reclaim.
+*/
+VOID VmmVTlbInvalidateAll();
+
+/*
+* Translate multiple virtual addresses to physical addresses in one pass. The
+* addresses are walked sorted, page tables shared between neighboring addresses
+* are only looked up once and missing page tables are prefetched into the TLB
+* cache once per page table level. Results are the same as for VmmVirt2Phys.
+* pqwPA may be the same buffer as pqwVA (in-place translation).
+* -- pProcess
+* -- cVA
+* -- pqwVA = virtual addresses to translate.
+* -- pqwPA = physical addresses on success, pte (if possible) on fail.
+* -- pfPA = success status of each individual translation.
+*/
+VOID VmmVirt2PhysBatch(_In_ PVMM_PROCESS pProcess, _In_ DWORD cVA, _In_reads_(cVA) PQWORD pqwVA, _Out_writes_(cVA) PQWORD pqwPA, _Out_writes_(cVA) PBOOL pfPA);
+
+/*
+* Memory model independent implementation of pfnVirt2PhysBatch. Should only be
+* called by the memory models which supply their per-level resolve function.
+* Translations are looked up in, and added to, the process translation cache.
+* -- pProcess
+* -- iPML = top level of page table hierarchy.
+* -- pfnStep = memory model specific function to resolve one level.
+* -- cVA
+* -- pqwVA
+* -- pqwPA
+* -- pfPA
+*/
+VOID VmmVirt2PhysBatch_DoWork(_In_ PVMM_PROCESS pProcess, _In_ BYTE iPML, _In_ PVMM_VIRT2PHYS_STEP_PFN pfnStep, _In_ DWORD cVA, _In_reads_(cVA) PQWORD pqwVA, _Out_writes_(cVA) PQWORD pqwPA, _Out_writes_(cVA) PBOOL pfPA);
 
 /*
 * Spider the TLB (page table cache) to load all page table pages into the cache.
@@ -1512,6 +1818,31 @@ VOID VmmProcessListPIDs(_Out_writes_opt_(*pcPIDs) PDWORD pPIDs, _Inout_ PSIZE_T
 */
 VOID VmmWork(_In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx, _In_opt_ HANDLE hEventFinish);
 
+/*
+* Create a new work group. Work items added to the group may be waited upon
+* (joined) as a whole. The group may be re-used after it's been joined.
+* CALLER DECREF: return
+* -- return
+*/
+PVMMOB_WORK_GROUP VmmWorkGroup_New();
+
+/*
+* Schedule an asynchronous work item belonging to the work group.
+* -- pg
+* -- pfn
+* -- ctx = optional context to provide to the pfn function.
+*/
+VOID VmmWorkGroup_Add(_In_ PVMMOB_WORK_GROUP pg, _In_ LPTHREAD_START_ROUTINE pfn, _In_opt_ PVOID ctx);
+
+/*
+* Wait for all work items in the work group to finish. Not yet started work
+* items of the group are executed by the calling thread rather than waited upon
+* - regardless of which deque (own, injection queue or other worker threads)
+* they're queued on. Work items of other groups are never executed.
+* -- pg
+*/
+VOID VmmWorkGroup_Join(_In_ PVMMOB_WORK_GROUP pg);
+
 /*
 * Perform multi-threaded parallel processing of processes in the process table.
 * This is useful when slow I/O should take place on multiple or all processes
@@ -1555,6 +1886,115 @@ VOID VmmCacheClear(_In_ DWORD dwTblTag);
 */
 VOID VmmCacheInvalidate(_In_ QWORD pa);
 
+/*
+* Set the max number of 4kB entries of a cache table. If the table shrinks the
+* surplus entries are evicted and their memory is released.
+* -- dwTblTag
+* -- cMaxEntries
+*/
+VOID VmmCacheResize(_In_ DWORD dwTblTag, _In_ DWORD cMaxEntries);
+
+/*
+* Set the total memory budget of the PHYS, TLB and PAGING caches. The budget
+* is split between the caches - adaptively if Cache.Budget.fAdaptive is set.
+* -- cMB = budget in MB, 0 = revert to default fixed size caches.
+*/
+VOID VmmCacheBudgetSet(_In_ DWORD cMB);
+
+/*
+* Re-split the cache budget between the PHYS, TLB and PAGING caches according
+* to the cache misses (weighted by hit ratio) observed since the last rebalance.
+* Rate limited unless fForce is set. No action is taken if no budget is set or
+* if not adaptive. Called by the cache refresh thread.
+* -- fForce
+*/
+VOID VmmCacheBudgetRebalance(_In_ BOOL fForce);
+
+/*
+* Request an adaptive rebalance of the cache budget without performing it on
+* the calling thread. Only has effect if the cache refresh thread isn't running.
+*/
+VOID VmmCacheBudgetRebalanceRequest();
+
+/*
+* Check whether a key exists in the negative (failed read) cache. Entries older
+* than the physical memory cache refresh period expire on volatile targets.
+* -- dwTblTag = VMM_CACHE_TAG_PHYS (key: pa) or VMM_CACHE_TAG_PAGING (key: pte).
+* -- qwKey
+* -- return
+*/
+BOOL VmmNegCacheExists(_In_ DWORD dwTblTag, _In_ QWORD qwKey);
+
+/*
+* Add a key to the negative (failed read) cache.
+* -- dwTblTag = VMM_CACHE_TAG_PHYS (key: pa) or VMM_CACHE_TAG_PAGING (key: pte).
+* -- qwKey
+*/
+VOID VmmNegCachePush(_In_ DWORD dwTblTag, _In_ QWORD qwKey);
+
+/*
+* Clear the specified negative (failed read) cache from all entries.
+* -- dwTblTag
+*/
+VOID VmmNegCacheClear(_In_ DWORD dwTblTag);
+
+/*
+* Try to memory map the backing raw memory dump file (if any). If successful
+* physical reads are serviced directly from the mapping and the PHYS cache is
+* bypassed. Only possible for non-volatile local raw dump files w/o memmap.
+* -- return
+*/
+_Success_(return)
+BOOL VmmPhysFile_Initialize();
+
+/*
+* Unmap the memory mapped raw dump file (if any).
+*/
+VOID VmmPhysFile_Close();
+
+/*
+* Read scatter physical memory from the underlying device - either directly
+* from a memory mapped raw dump file or from LeechCore. LeechCore reads are
+* sorted, de-duplicated and adjacent pages are coalesced into contiguous reads
+* (if supported by the backend). No caching is done.
+* -- cMEMs
+* -- ppMEMs
+*/
+VOID VmmReadScatterDevice(_In_ DWORD cMEMs, _Inout_ PPMEM_SCATTER ppMEMs);
+
+/*
+* Set the max size of a coalesced contiguous device read.
+* -- cbMax = max size in bytes (rounded down to page size), 0 = disable.
+* -- return
+*/
+_Success_(return)
+BOOL VmmReadCoalesceSet(_In_ DWORD cbMax);
+
+/*
+* Retrieve the i/o priority class of the current thread.
+* -- return = VMM_IOSCHED_CLASS_*
+*/
+DWORD VmmIoSchedClassGet();
+
+/*
+* Set the i/o priority class of the current thread. Device reads issued by the
+* thread, and by work and async reads submitted by the thread, are scheduled
+* according to the class.
+* -- iClass = VMM_IOSCHED_CLASS_*
+* -- return = the previous class - to be restored by the caller if required.
+*/
+DWORD VmmIoSchedClassSet(_In_ DWORD iClass);
+
+/*
+* Set the max number of pages per device read for the background (refresh and
+* bulk) i/o priority classes. Larger reads are sliced and re-queued between the
+* slices to allow interactive reads to pass.
+* -- cSlice = max # of pages, 0 = disable the i/o scheduler.
+* -- return
+*/
+_Success_(return)
+BOOL VmmIoSchedSliceSet(_In_ DWORD cSlice);
+
 /*
 * Prefetch a set of addresses contained in pPrefetchPages into the cache. This
 * is useful when reading data from somewhat known addresses over higher latency
@@ -1610,6 +2050,117 @@ VOID VmmCachePrefetchPages4(_In_opt_ PVMM_PROCESS pProcess, _In_ DWORD cAddresse
 */
 BOOL VmmCachePrefetchPages5(_In_opt_ PVMM_PROCESS pProcess, _In_opt_ POB_MAP pmPrefetchObjects, _In_ DWORD cb, _In_ QWORD flags, _In_ VOID(*pfnFilter)(_In_ QWORD k, _In_ PVOID v, _Inout_ POB_SET ps));
 
+/*
+* Submit an asynchronous scatter read. The read is executed by a VMM i/o thread
+* and the caller continues immediately. The MEMs must stay valid and must not
+* be accessed until the read is completed (VmmReadAsyncWait/Poll).
+* A NULL return means the read was executed synchronously and is completed.
+* CALLER_DECREF: return
+* -- pProcess = process to read virtual memory from, NULL = physical memory.
+* -- ppMEMs
+* -- cMEMs
+* -- flags = flags as in VMM_FLAG_*
+* -- return = completion handle.
+*/
+PVMMOB_READASYNC VmmReadScatterAsync(_In_opt_ PVMM_PROCESS pProcess, _Inout_ PPMEM_SCATTER ppMEMs, _In_ DWORD cMEMs, _In_ QWORD flags);
+
+/*
+* Prefetch a set of optionally non-page aligned addresses into the cache in an
+* asynchronous way. The address set may be altered by the caller after return.
+* A NULL return means nothing was submitted or the prefetch was completed.
+* CALLER_DECREF: return
+* -- pProcess
+* -- psPrefetchNonPageAligned
+* -- cb
+* -- flags
+* -- return = completion handle.
+*/
+PVMMOB_READASYNC VmmCachePrefetchPagesAsync(_In_opt_ PVMM_PROCESS pProcess, _In_opt_ POB_SET psPrefetchNonPageAligned, _In_ DWORD cb, _In_ QWORD flags);
+
+/*
+* Check whether an asynchronous read is completed without blocking.
+* -- pObAsync
+* -- return
+*/
+BOOL VmmReadAsyncPoll(_In_opt_ PVMMOB_READASYNC pObAsync);
+
+/*
+* Wait for an asynchronous read to complete.
+* -- pObAsync
+* -- dwMilliseconds = timeout as in WaitForSingleObject.
+* -- return = TRUE if completed.
+*/
+_Success_(return)
+BOOL VmmReadAsyncWait(_In_opt_ PVMMOB_READASYNC pObAsync, _In_ DWORD dwMilliseconds);
+
+/*
+* Wait for any of several asynchronous reads to complete.
+* -- cAsync = max MAXIMUM_WAIT_OBJECTS.
+* -- ppObAsync
+* -- dwMilliseconds = timeout as in WaitForMultipleObjects.
+* -- return = index of a completed read, (DWORD)-1 on timeout/error.
+*/
+DWORD VmmReadAsyncWaitAny(_In_ DWORD cAsync, _In_reads_(cAsync) PVMMOB_READASYNC *ppObAsync, _In_ DWORD dwMilliseconds);
+
+/*
+* Set the async read queue depth, i.e. the max number of concurrently executing
+* asynchronous read batches. 0 = execute asynchronous reads synchronously.
+* -- cDepth
+* -- return
+*/
+_Success_(return)
+BOOL VmmReadAsyncDepthSet(_In_ DWORD cDepth);
+
+/*
+* Retrieve the max number of rounds a pipelined walk should keep in flight.
+* This is at least two if asynchronous reads are enabled, otherwise one.
+* -- return
+*/
+DWORD VmmReadAsyncRoundsMax();
+
+/*
+* Initialize a read pipe. A read pipe keeps several rounds of prefetches of
+* address sets in flight for multi-round walkers (lists, trees, tables).
+* -- pPipe
+* -- pProcess
+* -- cb = number of bytes to prefetch at each address.
+* -- flags
+*/
+VOID VmmReadAsyncPipe_Initialize(_Out_ PVMM_READASYNC_PIPE pPipe, _In_opt_ PVMM_PROCESS pProcess, _In_ DWORD cb, _In_ QWORD flags);
+
+/*
+* Retrieve the number of free round slots in the read pipe.
+* -- pPipe
+* -- return
+*/
+DWORD VmmReadAsyncPipe_Free(_In_ PVMM_READASYNC_PIPE pPipe);
+
+/*
+* Submit the addresses in psRound as new rounds split over the free round slots
+* of the pipe. The addresses are popped from psRound. If a round cannot be
+* allocated the remaining addresses are prefetched synchronously and are left
+* in psRound for the caller to read directly.
+* -- pPipe
+* -- psRound = addresses to prefetch and to be returned by VmmReadAsyncPipe_WaitNext.
+* -- psExtraOpt = additional addresses to prefetch (not returned).
+* -- return = number of rounds submitted.
+*/
+DWORD VmmReadAsyncPipe_Submit(_Inout_ PVMM_READASYNC_PIPE pPipe, _Inout_ POB_SET psRound, _In_opt_ POB_SET psExtraOpt);
+
+/*
+* Wait for any round in flight to complete and return its addresses.
+* CALLER_DECREF: return
+* -- pPipe
+* -- return = address set of the completed round, NULL if no rounds in flight.
+*/
+POB_SET VmmReadAsyncPipe_WaitNext(_Inout_ PVMM_READASYNC_PIPE pPipe);
+
+/*
+* Wait for all rounds in flight and clean up the read pipe.
+* -- pPipe
+*/
+VOID VmmReadAsyncPipe_Close(_Inout_ PVMM_READASYNC_PIPE pPipe);
+
 /*
 * Initialize the memory model specified and discard any previous memory models
 * that may be in action.
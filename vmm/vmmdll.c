@@ -96,12 +96,20 @@ BOOL VmmDll_ConfigIntialize(_In_ DWORD argc, _In_ char* argv[])
             ctxMain->cfg.fWaitInitialize = TRUE;
             i++;
             continue;
+        } else if(0 == _stricmp(argv[i], "-warmmaps")) {
+            ctxMain->cfg.fWarmMaps = TRUE;
+            i++;
+            continue;
         } else if(i + 1 >= argc) {
             return FALSE;
         } else if(0 == _stricmp(argv[i], "-cr3")) {
             ctxMain->cfg.paCR3 = Util_GetNumericA(argv[i + 1]);
             i += 2;
             continue;
+        } else if(0 == _stricmp(argv[i], "-cache-budget")) {
+            ctxMain->cfg.cCacheBudgetMB = (DWORD)Util_GetNumericA(argv[i + 1]);
+            i += 2;
+            continue;
         } else if(0 == _stricmp(argv[i], "-forensic")) {
             ctxMain->cfg.tpForensicMode = (DWORD)Util_GetNumericA(argv[i + 1]);
             if(ctxMain->cfg.tpForensicMode > FC_DATABASE_TYPE_MAX) { return FALSE; }
@@ -208,6 +216,9 @@ VOID VmmDll_PrintHelp()
         "   -cr3 : base address of kernel/process page table (PML4) / CR3 CPU register. \n" \
         "   -max : memory max address, valid range: 0x0 .. 0xffffffffffffffff           \n" \
         "          default: auto-detect (max supported by device / target system).      \n" \
+        "   -cache-budget : total memory budget in MB of the physical memory, page      \n" \
+        "          table (tlb) and paging caches. The budget is split adaptively between\n" \
+        "          the caches. default: fixed size caches.  Example: -cache-budget 32768\n" \
         "   -memmap : specify a physical memory map given in a file or specify 'auto'.  \n" \
         "          example: -memmap c:\\temp\\my_custom_memory_map.txt                  \n" \
         "          example: -memmap auto                                                \n" \
@@ -227,6 +238,9 @@ VOID VmmDll_PrintHelp()
         "          will be limited if this is activated. Example: -symbolserverdisable  \n" \
         "   -waitinitialize : wait debugging .pdb symbol subsystem to fully start before\n" \
         "          mounting file system and fully starting MemProcFS.                   \n" \
+        "   -warmmaps : initialize module, vad, thread and handle maps of all processes \n" \
+        "          in parallel at startup. Progress is shown in .status/warmmaps.       \n" \
+        "          Combine with -waitinitialize to wait for completion before mount.    \n" \
         "   -forensic : start a forensic scan of the physical memory immediately after  \n" \
         "          startup if possible. Allowed parameter values range from 0-4.        \n" \
         "          Note! forensic mode is not available for live memory.                \n" \
@@ -431,6 +445,35 @@ BOOL VMMDLL_ConfigGet(_In_ ULONG64 fOption, _Out_ PULONG64 pqwValue)
         case VMMDLL_OPT_CONFIG_STATISTICS_FUNCTIONCALL:
             *pqwValue = Statistics_CallGetEnabled() ? 1 : 0;
             return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_BUDGET_MB:
+            *pqwValue = ctxVmm->Cache.Budget.cMB;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_ADAPTIVE:
+            *pqwValue = ctxVmm->Cache.Budget.fAdaptive ? 1 : 0;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_ENTRIES_PHYS:
+            *pqwValue = ctxVmm->Cache.PHYS.cMaxEntries;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_ENTRIES_TLB:
+            *pqwValue = ctxVmm->Cache.TLB.cMaxEntries;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_ENTRIES_PAGING:
+            *pqwValue = ctxVmm->Cache.PAGING.cMaxEntries;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_READ_COALESCE_MAX:
+            *pqwValue = ctxVmm->Coalesce.cbMax;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_READ_ASYNC_DEPTH:
+            *pqwValue = ctxVmm->ReadAsync.cDepth;
+            return TRUE;
+#ifdef VMM_TEST_LATENCY_INJECT
+        case VMMDLL_OPT_CONFIG_READ_LATENCY_INJECT_MS:
+            *pqwValue = ctxVmm->ReadAsync.cMsLatencyInject;
+            return TRUE;
+#endif /* VMM_TEST_LATENCY_INJECT */
+        case VMMDLL_OPT_CONFIG_READ_SCHED_SLICE:
+            *pqwValue = ctxVmm->IoSched.cSlice;
+            return TRUE;
         case VMMDLL_OPT_WIN_VERSION_MAJOR:
             *pqwValue = ctxVmm->kernel.dwVersionMajor;
             return TRUE;
@@ -443,6 +486,12 @@ BOOL VMMDLL_ConfigGet(_In_ ULONG64 fOption, _Out_ PULONG64 pqwValue)
         case VMMDLL_OPT_FORENSIC_MODE:
             *pqwValue = ctxFc ? (BYTE)ctxFc->db.tp : 0;
             return TRUE;
+        case VMMDLL_OPT_FORENSIC_SCAN_RING:
+            *pqwValue = ctxMain->cfg.cForensicScanRing;
+            return TRUE;
+        case VMMDLL_OPT_FORENSIC_RENDER_FILE:
+            *pqwValue = ctxMain->cfg.fForensicDisableRenderFile ? 0 : 1;
+            return TRUE;
         // core options affecting both vmm.dll and pcileech.dll
         case VMMDLL_OPT_CORE_PRINTF_ENABLE:
             *pqwValue = ctxMain->cfg.fVerboseDll ? 1 : 0;
@@ -472,12 +521,14 @@ BOOL VMMDLL_ConfigSet(_In_ ULONG64 fOption, _In_ ULONG64 qwValue)
     if((fOption & 0xffff0000'00000000) == 0x20010000'00000000) {
         if(VMMDLL_REFRESH_CHECK(fOption, VMMDLL_OPT_REFRESH_READ)) {
             VmmCacheClear(VMM_CACHE_TAG_PHYS);
+            VmmNegCacheClear(VMM_CACHE_TAG_PHYS);
         }
         if(VMMDLL_REFRESH_CHECK(fOption, VMMDLL_OPT_REFRESH_TLB)) {
             VmmCacheClear(VMM_CACHE_TAG_TLB);
         }
         if(VMMDLL_REFRESH_CHECK(fOption, VMMDLL_OPT_REFRESH_PAGING)) {
             VmmCacheClear(VMM_CACHE_TAG_PAGING);
+            VmmNegCacheClear(VMM_CACHE_TAG_PAGING);
         }
         if(VMMDLL_REFRESH_CHECK(fOption, VMMDLL_OPT_REFRESH_PROCESS)) {
             VmmProc_RefreshProcesses(TRUE);
@@ -546,8 +597,37 @@ BOOL VMMDLL_ConfigSet(_In_ ULONG64 fOption, _In_ ULONG64 qwValue)
         case VMMDLL_OPT_CONFIG_STATISTICS_FUNCTIONCALL:
             Statistics_CallSetEnabled(qwValue ? TRUE : FALSE);
             return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_BUDGET_MB:
+            if(qwValue > 0xffffffff) { return FALSE; }
+            VmmCacheBudgetSet((DWORD)qwValue);
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_CACHE_ADAPTIVE:
+            ctxVmm->Cache.Budget.fAdaptive = qwValue ? TRUE : FALSE;
+            return TRUE;
+        case VMMDLL_OPT_CONFIG_READ_COALESCE_MAX:
+            if(qwValue > VMM_COALESCE_CB_MAX) { return FALSE; }
+            return VmmReadCoalesceSet((DWORD)qwValue);
+        case VMMDLL_OPT_CONFIG_READ_ASYNC_DEPTH:
+            if(qwValue > VMM_READASYNC_DEPTH_MAX) { return FALSE; }
+            return VmmReadAsyncDepthSet((DWORD)qwValue);
+#ifdef VMM_TEST_LATENCY_INJECT
+        case VMMDLL_OPT_CONFIG_READ_LATENCY_INJECT_MS:
+            if(qwValue > 10000) { return FALSE; }
+            ctxVmm->ReadAsync.cMsLatencyInject = (DWORD)qwValue;
+            return TRUE;
+#endif /* VMM_TEST_LATENCY_INJECT */
+        case VMMDLL_OPT_CONFIG_READ_SCHED_SLICE:
+            if(qwValue > VMM_IOSCHED_SLICE_MAX) { return FALSE; }
+            return VmmIoSchedSliceSet((DWORD)qwValue);
         case VMMDLL_OPT_FORENSIC_MODE:
             return FcInitialize((DWORD)qwValue, FALSE);
+        case VMMDLL_OPT_FORENSIC_SCAN_RING:
+            if(qwValue > FC_PHYSMEM_RING_MAX) { return FALSE; }
+            ctxMain->cfg.cForensicScanRing = (DWORD)qwValue;
+            return TRUE;
+        case VMMDLL_OPT_FORENSIC_RENDER_FILE:
+            ctxMain->cfg.fForensicDisableRenderFile = qwValue ? FALSE : TRUE;
+            return TRUE;
         default:
             // non-recognized option - possibly a device option to pass along to leechcore.dll
             return LcSetOption(ctxMain->hLC, fOption, qwValue);
@@ -57,6 +57,8 @@ extern "C" {
 *              2 = forensic mode with temp sqlite database deleted upon exit.
 *              3 = forensic mode with temp sqlite database remaining upon exit.
 *              4 = forensic mode with static named sqlite database (vmm.sqlite3).
+*                  the database is resumable - re-opening the same memory dump
+*                  skips completed stages and continues an interrupted scan.
 *              Example -forensic 4
 *
 * -- argc
@@ -113,12 +115,23 @@ VOID VMMDLL_MemFree(_Frees_ptr_opt_ PVOID pvMem);
 #define VMMDLL_OPT_CONFIG_VMM_VERSION_REVISION          0x2000000B'00000000  // R
 #define VMMDLL_OPT_CONFIG_STATISTICS_FUNCTIONCALL       0x2000000C'00000000  // RW - enable function call statistics (.status/statistics_fncall file)
 #define VMMDLL_OPT_CONFIG_IS_PAGING_ENABLED             0x2000000D'00000000  // RW - 1/0
+#define VMMDLL_OPT_CONFIG_CACHE_BUDGET_MB               0x2000000E'00000000  // RW - total cache memory budget in MB (0 = default)
+#define VMMDLL_OPT_CONFIG_CACHE_ADAPTIVE                0x2000000F'00000000  // RW - 1/0 - adaptive split of cache budget
+#define VMMDLL_OPT_CONFIG_CACHE_ENTRIES_PHYS            0x20000010'00000000  // R - max # of 4kB entries in physical read cache
+#define VMMDLL_OPT_CONFIG_CACHE_ENTRIES_TLB             0x20000011'00000000  // R - max # of 4kB entries in page table (tlb) cache
+#define VMMDLL_OPT_CONFIG_CACHE_ENTRIES_PAGING          0x20000012'00000000  // R - max # of 4kB entries in paging cache
+#define VMMDLL_OPT_CONFIG_READ_COALESCE_MAX             0x20000013'00000000  // RW - max size in bytes of coalesced contiguous device reads (0 = disable)
+#define VMMDLL_OPT_CONFIG_READ_ASYNC_DEPTH              0x20000014'00000000  // RW - max # of concurrent asynchronous read batches (0 = synchronous)
+#define VMMDLL_OPT_CONFIG_READ_LATENCY_INJECT_MS        0x20000015'00000000  // RW - injected latency in ms per device read (VMM_TEST_LATENCY_INJECT builds only)
+#define VMMDLL_OPT_CONFIG_READ_SCHED_SLICE              0x20000016'00000000  // RW - max # of pages per background device read (0 = disable i/o scheduler)
 
 #define VMMDLL_OPT_WIN_VERSION_MAJOR                    0x20000101'00000000  // R
 #define VMMDLL_OPT_WIN_VERSION_MINOR                    0x20000102'00000000  // R
 #define VMMDLL_OPT_WIN_VERSION_BUILD                    0x20000103'00000000  // R
 
 #define VMMDLL_OPT_FORENSIC_MODE                        0x20000201'00000000  // RW - enable/retrieve forensic mode type [0-4].
+#define VMMDLL_OPT_FORENSIC_SCAN_RING                   0x20000202'00000000  // RW - # of 16MB chunks in the physical memory scan ring [2-16] (0 = default).
+#define VMMDLL_OPT_FORENSIC_RENDER_FILE                 0x20000203'00000000  // RW - pre-render timeline/ntfs text files at forensic init [0-1] (default = 1).
 
 #define VMMDLL_OPT_REFRESH_ALL                          0x2001ffff'00000000  // W - refresh all caches
 #define VMMDLL_OPT_REFRESH_PROCESS                      0x20010001'00000000  // W - refresh process listings
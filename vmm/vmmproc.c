@@ -92,6 +92,7 @@ DWORD VmmProcCacheUpdaterThread()
     QWORD i = 0;
     BOOL fPHYS, fTLB, fProcPartial, fProcTotal, fRegistry;
     vmmprintfv("VmmProc: Start periodic cache flushing.\n");
+    VmmIoSchedClassSet(VMM_IOSCHED_CLASS_REFRESH);
     if(ctxMain->dev.fRemote) {
         ctxVmm->ThreadProcCache.cMs_TickPeriod = VMMPROC_UPDATERTHREAD_REMOTE_PERIOD;
         ctxVmm->ThreadProcCache.cTick_Phys = VMMPROC_UPDATERTHREAD_REMOTE_PHYSCACHE;
@@ -115,6 +116,8 @@ DWORD VmmProcCacheUpdaterThread()
         fProcTotal = !(i % ctxVmm->ThreadProcCache.cTick_ProcTotal);
         fProcPartial = !(i % ctxVmm->ThreadProcCache.cTick_ProcPartial) && !fProcTotal;
         fRegistry = !(i % ctxVmm->ThreadProcCache.cTick_Registry);
+        // adaptive cache budget split (rate limited)
+        VmmCacheBudgetRebalance(FALSE);
         EnterCriticalSection(&ctxVmm->LockMaster);
         // PHYS / TLB cache clear
         if(fPHYS) {
@@ -122,7 +125,6 @@ DWORD VmmProcCacheUpdaterThread()
             InterlockedIncrement64(&ctxVmm->stat.cPhysRefreshCache);
             VmmCacheClear(VMM_CACHE_TAG_PAGING);
             InterlockedIncrement64(&ctxVmm->stat.cPageRefreshCache);
-            ObSet_Clear(ctxVmm->Cache.PAGING_FAILED);
         }
         if(fTLB) {
             VmmCacheClear(VMM_CACHE_TAG_TLB);
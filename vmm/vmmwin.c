@@ -1475,6 +1475,24 @@ VOID VmmWinHandle_CloseObCallback(_In_ PVOID pVmmHandle)
     LocalFree(pOb->wszMultiText);
 }
 
+/*
+* Prefetch the sub-tables pointed to by a handle table directory page.
+* -- ctx
+* -- pbTable = 0x1000 byte handle table directory page.
+*/
+VOID VmmWinHandle_InitializeCore_SpiderTablesPrefetch(_In_ PVMMWIN_INITIALIZE_HANDLE_CONTEXT ctx, _In_reads_(0x1000) PBYTE pbTable)
+{
+    QWORD va;
+    DWORD i, c = 0;
+    QWORD pva[0x400];
+    for(i = 0; i < (ctxVmm->f32 ? 0x400UL : 0x200UL); i++) {
+        va = ctxVmm->f32 ? ((PDWORD)pbTable)[i] : ((PQWORD)pbTable)[i];
+        if(!VMM_KADDR_PAGE(va)) { break; }
+        pva[c++] = va;
+    }
+    VmmCachePrefetchPages4(ctx->pSystemProcess, c, pva, 0x1000, 0);
+}
+
 /*
 * Spider the handle table hierarchy if there is one.
 * -- ctx
@@ -1490,6 +1508,10 @@ VOID VmmWinHandle_InitializeCore_SpiderTables(_In_ PVMMWIN_INITIALIZE_HANDLE_CON
         QWORD pqw[0x200];
     } u;
     if(!VmmRead(ctx->pSystemProcess, vaTable, u.pb, 0x1000)) { return; }
+    if(fLevel2) {
+        // fetch all sub-tables in one round rather than one round per table.
+        VmmWinHandle_InitializeCore_SpiderTablesPrefetch(ctx, u.pb);
+    }
     if(ctxVmm->f32) {
         for(i = 0; i < 0x400; i++) {
             va = u.pdw[i];
@@ -1519,39 +1541,58 @@ VOID VmmWinHandle_InitializeCore_SpiderTables(_In_ PVMMWIN_INITIALIZE_HANDLE_CON
     }
 }
 
+#define VMMWIN_HANDLE_TABLES_PER_ROUND      0x40
+
 /*
-* Count the number of valid handles.
+* Count the number of valid handles. The handle tables are fetched in rounds
+* with several rounds in flight asynchronously while counting is ongoing.
 * -- ctx
 * -- return = the number of valid handles.
 */
 DWORD VmmWinHandle_InitializeCore_CountHandles(_In_ PVMMWIN_INITIALIZE_HANDLE_CONTEXT ctx)
 {
-    QWORD va;
-    DWORD iTable, i, cHandles = 0;
+    QWORD va, vaTable;
+    DWORD iTable = 0, i, cHandles = 0;
+    POB_SET psObSubmit, psObRound;
+    VMM_READASYNC_PIPE Pipe;
     union {
         BYTE pb[0x1000];
         DWORD pdw[0x400];
         QWORD pqw[0x200];
     } u;
-    VmmCachePrefetchPages4(ctx->pSystemProcess, ctx->cTables, ctx->pvaTables, 0x1000, 0);
-    for(iTable = 0; iTable < ctx->cTables; iTable++) {
-        if(!VmmRead(ctx->pSystemProcess, ctx->pvaTables[iTable], u.pb, 0x1000)) { continue; }
-        if(ctxVmm->f32) {
-            for(i = 1; i < 512; i++) {
-                if(!VMM_KADDR32(u.pdw[i << 1])) { continue; }
-                cHandles++;
+    VmmReadAsyncPipe_Initialize(&Pipe, ctx->pSystemProcess, 0x1000, 0);
+    while(TRUE) {
+        // keep the pipe filled with rounds of not yet fetched tables
+        if((iTable < ctx->cTables) && VmmReadAsyncPipe_Free(&Pipe) && (psObSubmit = ObSet_New())) {
+            for(i = 0; (i < VMMWIN_HANDLE_TABLES_PER_ROUND) && (iTable < ctx->cTables); i++, iTable++) {
+                ObSet_Push(psObSubmit, ctx->pvaTables[iTable]);
             }
-        } else {
-            for(i = 1; i < 256; i++) {
-                va = u.pqw[i << 1];
-                if(ctxVmm->kernel.dwVersionBuild >= 9200) {     // Win8 or later
-                    va = 0xffff0000'00000000 | (va >> 16);
+            VmmReadAsyncPipe_Submit(&Pipe, psObSubmit, NULL);
+            Ob_DECREF(psObSubmit);
+            continue;
+        }
+        if(!(psObRound = VmmReadAsyncPipe_WaitNext(&Pipe))) { break; }
+        while((vaTable = ObSet_Pop(psObRound))) {
+            if(!VmmRead(ctx->pSystemProcess, vaTable, u.pb, 0x1000)) { continue; }
+            if(ctxVmm->f32) {
+                for(i = 1; i < 512; i++) {
+                    if(!VMM_KADDR32(u.pdw[i << 1])) { continue; }
+                    cHandles++;
+                }
+            } else {
+                for(i = 1; i < 256; i++) {
+                    va = u.pqw[i << 1];
+                    if(ctxVmm->kernel.dwVersionBuild >= 9200) {     // Win8 or later
+                        va = 0xffff0000'00000000 | (va >> 16);
+                    }
+                    if(!VMM_KADDR64(va)) { continue; }
+                    cHandles++;
                 }
-                if(!VMM_KADDR64(va)) { continue; }
-                cHandles++;
             }
         }
+        Ob_DECREF(psObRound);
     }
+    VmmReadAsyncPipe_Close(&Pipe);
     return cHandles;
 }
 
@@ -2467,6 +2508,31 @@ VOID VmmWinProcess_OffsetLocator_SetMaxOffset()
     po->cbMaxOffset = o + 0x80;
 }
 
+/*
+* Try to retrieve the EPROCESS offsets from the kernel offset profile cache.
+* The cached offsets are verified against the SYSTEM process before use.
+* -- pSystemProcess
+* -- return
+*/
+_Success_(return)
+BOOL VmmWinProcess_OffsetLocator_Profile(_In_ PVMM_PROCESS pSystemProcess)
+{
+    VMM_OFFSET_EPROCESS o;
+    BYTE pb[VMMPROC_EPROCESS64_MAX_SIZE];
+    QWORD paDTB;
+    if(!PDB_Profile_Get(PDB_PROFILE_KEY_EPROCESS, (PBYTE)&o, sizeof(VMM_OFFSET_EPROCESS))) { return FALSE; }
+    if(!o.fValid || (o.cbMaxOffset > sizeof(pb)) || (o.Name + 8 > o.cbMaxOffset) || (o.PID + 4 > o.cbMaxOffset) || (o.DTB + 8 > o.cbMaxOffset)) { return FALSE; }
+    if(!VmmRead(pSystemProcess, pSystemProcess->win.EPROCESS.va, pb, o.cbMaxOffset)) { return FALSE; }
+    paDTB = ctxVmm->f32 ? *(PDWORD)(pb + o.DTB) : *(PQWORD)(pb + o.DTB);
+    if((*(PDWORD)(pb + o.PID) != 4) || (*(PQWORD)(pb + o.Name) != 0x00006D6574737953) || (pSystemProcess->paDTB != (0xfffffffffffff000 & paDTB))) {
+        vmmprintfv_fn("Cached EPROCESS offsets do not match SYSTEM process - ignoring.\n");
+        return FALSE;
+    }
+    memcpy(&ctxVmm->offset.EPROCESS, &o, sizeof(VMM_OFFSET_EPROCESS));
+    vmmprintfvv_fn("EPROCESS offsets loaded from offset profile.\n");
+    return TRUE;
+}
+
 /*
 * Very ugly hack that tries to locate some offsets required withn the EPROCESS struct.
 */
@@ -2834,7 +2900,7 @@ BOOL VmmWinProcess_Enum64(_In_ PVMM_PROCESS pSystemProcess, _In_ BOOL fTotalRefr
     PVMM_OFFSET_EPROCESS po = &ctxVmm->offset.EPROCESS;
     VMMWIN_ENUMERATE_EPROCESS_CONTEXT ctx = { 0 };
     // retrieve offsets
-    if(!po->fValid) {
+    if(!po->fValid && !VmmWinProcess_OffsetLocator_Profile(pSystemProcess)) {
         VmmWinProcess_OffsetLocator64(pSystemProcess);
         if(!po->fValid || ctxMain->cfg.fVerboseExtra) {
             VmmWinProcess_OffsetLocator_Print();
@@ -2843,6 +2909,7 @@ BOOL VmmWinProcess_Enum64(_In_ PVMM_PROCESS pSystemProcess, _In_ BOOL fTotalRefr
             vmmprintf("VmmWin: Unable to locate EPROCESS offsets.\n");
             return FALSE;
         }
+        PDB_Profile_Put(PDB_PROFILE_KEY_EPROCESS, (PBYTE)po, sizeof(VMM_OFFSET_EPROCESS));
     }
     vmmprintfvv_fn("SYSTEM DTB: %016llx EPROCESS: %016llx\n", pSystemProcess->paDTB, pSystemProcess->win.EPROCESS.va);
     // set up context
@@ -3124,7 +3191,7 @@ BOOL VmmWinProcess_Enum32(_In_ PVMM_PROCESS pSystemProcess, _In_ BOOL fTotalRefr
     PVMM_OFFSET_EPROCESS po = &ctxVmm->offset.EPROCESS;
     VMMWIN_ENUMERATE_EPROCESS_CONTEXT ctx = { 0 };
     // retrieve offsets
-    if(!po->fValid) {
+    if(!po->fValid && !VmmWinProcess_OffsetLocator_Profile(pSystemProcess)) {
         VmmWinProcess_OffsetLocator32(pSystemProcess);
         if(!po->fValid || ctxMain->cfg.fVerboseExtra) {
             VmmWinProcess_OffsetLocator_Print();
@@ -3133,6 +3200,7 @@ BOOL VmmWinProcess_Enum32(_In_ PVMM_PROCESS pSystemProcess, _In_ BOOL fTotalRefr
             vmmprintf("VmmWin: Unable to locate EPROCESS offsets.\n");
             return FALSE;
         }
+        PDB_Profile_Put(PDB_PROFILE_KEY_EPROCESS, (PBYTE)po, sizeof(VMM_OFFSET_EPROCESS));
     }
     vmmprintfvv_fn("SYSTEM DTB: %016llx EPROCESS: %08x\n", pSystemProcess->paDTB, (DWORD)pSystemProcess->win.EPROCESS.va);
     // set up context
@@ -3216,11 +3284,13 @@ VOID VmmWin_ListTraversePrefetch(
     _In_opt_ POB_CONTAINER pPrefetchAddressContainer)
 {
     QWORD vaData;
-    DWORD cbReadData;
+    DWORD cbReadData, iAllSubmitted;
     PBYTE pbData = NULL;
     QWORD vaFLink, vaBLink;
-    POB_SET pObSet_vaAll = NULL, pObSet_vaTry1 = NULL, pObSet_vaTry2 = NULL, pObSet_vaValid = NULL;
-    BOOL fValidEntry, fValidFLink, fValidBLink, fTry1;
+    POB_SET pObSet_vaAll = NULL, pObSet_vaTry1 = NULL, pObSet_vaTry2 = NULL, pObSet_vaTry3 = NULL, pObSet_vaValid = NULL, pObSet_vaExtra = NULL, pObSet_vaRound;
+    BOOL fValidEntry, fValidFLink, fValidBLink;
+    VMM_READASYNC_PIPE Pipe;
+    VmmReadAsyncPipe_Initialize(&Pipe, pProcess, cbData, 0);
     // 1: Prefetch any addresses stored in optional address container
     pObSet_vaAll = ObContainer_GetOb(pPrefetchAddressContainer);
     VmmCachePrefetchPages3(pProcess, pObSet_vaAll, cbData, 0);
@@ -3229,34 +3299,52 @@ VOID VmmWin_ListTraversePrefetch(
     if(!(pObSet_vaAll = ObSet_New())) { goto fail; }
     if(!(pObSet_vaTry1 = ObSet_New())) { goto fail; }
     if(!(pObSet_vaTry2 = ObSet_New())) { goto fail; }
+    if(!(pObSet_vaTry3 = ObSet_New())) { goto fail; }
     if(!(pObSet_vaValid = ObSet_New())) { goto fail; }
+    if(!(pObSet_vaExtra = ObSet_New())) { goto fail; }
     if(!(pbData = LocalAlloc(0, cbData))) { goto fail; }
     while(cvaDataStart) {
         cvaDataStart--;
         ObSet_Push(pObSet_vaAll, pvaDataStart[cvaDataStart]);
         ObSet_Push(pObSet_vaTry1, pvaDataStart[cvaDataStart]);
     }
-    // 3: Initial list walk
-    fTry1 = TRUE;
+    iAllSubmitted = ObSet_Size(pObSet_vaAll);
+    // 3: Initial list walk. Entries not yet in cache are fetched in rounds and
+    //    up to several rounds are kept in flight asynchronously (typically the
+    //    forward and backward directions of the list) while the walk continues
+    //    on entries already fetched.
     while(TRUE) {
-        if(fTry1) {
-            vaData = ObSet_Pop(pObSet_vaTry1);
-            if(!vaData && (0 == ObSet_Size(pObSet_vaTry2))) { break; }
-            if(!vaData) {
-                VmmCachePrefetchPages3(pProcess, pObSet_vaAll, cbData, 0);
-                fTry1 = FALSE;
-                continue;
-            }
+        if((vaData = ObSet_Pop(pObSet_vaTry3))) {
+            // entry fetched by a completed round
+            if(!VmmRead(pProcess, vaData, pbData, cbData)) { continue; }
+        } else if((vaData = ObSet_Pop(pObSet_vaTry1))) {
+            // newly found entry - try cache only
             VmmReadEx(pProcess, vaData, pbData, cbData, &cbReadData, VMM_FLAG_FORCECACHE_READ);
             if(cbReadData != cbData) {
                 ObSet_Push(pObSet_vaTry2, vaData);
                 continue;
             }
         } else {
-            vaData = ObSet_Pop(pObSet_vaTry2);
-            if(!vaData && (0 == ObSet_Size(pObSet_vaTry1))) { break; }
-            if(!vaData) { fTry1 = TRUE; continue; }
-            if(!VmmRead(pProcess, vaData, pbData, cbData)) { continue; }
+            if(ObSet_Size(pObSet_vaTry2) && VmmReadAsyncPipe_Free(&Pipe)) {
+                // submit new round(s) - also prefetch additional addresses
+                // added by the callback since the previous round.
+                ObSet_Clear(pObSet_vaExtra);
+                while(iAllSubmitted < ObSet_Size(pObSet_vaAll)) {
+                    ObSet_Push(pObSet_vaExtra, ObSet_Get(pObSet_vaAll, iAllSubmitted++));
+                }
+                if(VmmReadAsyncPipe_Submit(&Pipe, pObSet_vaTry2, pObSet_vaExtra)) { continue; }
+            }
+            if(!(pObSet_vaRound = VmmReadAsyncPipe_WaitNext(&Pipe))) {
+                // no rounds in flight - remaining entries (if any) were
+                // prefetched synchronously by the pipe -> read them directly.
+                if(!ObSet_Size(pObSet_vaTry2)) { break; }
+                ObSet_PushSet(pObSet_vaTry3, pObSet_vaTry2);
+                ObSet_Clear(pObSet_vaTry2);
+                continue;
+            }
+            ObSet_PushSet(pObSet_vaTry3, pObSet_vaRound);
+            Ob_DECREF(pObSet_vaRound);
+            continue;
         }
         vaFLink = f32 ? *(PDWORD)(pbData + oListStart + 0) : *(PQWORD)(pbData + oListStart + 0);
         vaBLink = f32 ? *(PDWORD)(pbData + oListStart + 4) : *(PQWORD)(pbData + oListStart + 8);
@@ -3304,9 +3392,12 @@ VOID VmmWin_ListTraversePrefetch(
     }
 fail:
     // 7: Cleanup
+    VmmReadAsyncPipe_Close(&Pipe);
     Ob_DECREF_NULL(&pObSet_vaAll);
     Ob_DECREF_NULL(&pObSet_vaTry1);
     Ob_DECREF_NULL(&pObSet_vaTry2);
+    Ob_DECREF_NULL(&pObSet_vaTry3);
     Ob_DECREF_NULL(&pObSet_vaValid);
+    Ob_DECREF_NULL(&pObSet_vaExtra);
     LocalFree(pbData);
 }
@@ -825,6 +825,54 @@ success:
     return vaSystemEPROCESS;
 }
 
+BOOL VmmWinInit_WarmMaps_CallbackCriteria(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx)
+{
+    if(pProcess->dwState) { return FALSE; }
+    InterlockedIncrement(&ctxVmm->WarmMaps.cProcessTotal);
+    return TRUE;
+}
+
+VOID VmmWinInit_WarmMaps_CallbackAction(_In_ PVMM_PROCESS pProcess, _In_opt_ PVOID ctx)
+{
+    PVMMOB_MAP_MODULE pObModuleMap = NULL;
+    PVMMOB_MAP_VAD pObVadMap = NULL;
+    PVMMOB_MAP_THREAD pObThreadMap = NULL;
+    PVMMOB_MAP_HANDLE pObHandleMap = NULL;
+    // per-process order: module map (PEB) before vad map (vad text uses
+    // module names), thread and handle maps are independent of the others.
+    if(ctxVmm->Work.fEnabled) {
+        VmmMap_GetModule(pProcess, &pObModuleMap);
+        VmmMap_GetVad(pProcess, &pObVadMap, TRUE);
+        if(ctxVmm->fThreadMapEnabled) {
+            VmmMap_GetThread(pProcess, &pObThreadMap);
+        }
+        VmmMap_GetHandle(pProcess, &pObHandleMap, TRUE);
+    }
+    Ob_DECREF(pObModuleMap);
+    Ob_DECREF(pObVadMap);
+    Ob_DECREF(pObThreadMap);
+    Ob_DECREF(pObHandleMap);
+    InterlockedIncrement(&ctxVmm->WarmMaps.cProcessDone);
+}
+
+/*
+* Eagerly initialize the module, vad, thread and handle maps of all active
+* processes in parallel. Must be called after the PDB subsystem and thread
+* support is initialized. Global dependencies (object type table used by the
+* handle map text) are initialized single-threaded before processes are
+* processed in parallel.
+*/
+VOID VmmWinInit_WarmMaps()
+{
+    QWORD tcStart = GetTickCount64();
+    ctxVmm->WarmMaps.fActive = TRUE;
+    VmmWin_ObjectTypeGet(0);    // DUMMY call to initialize ctxVmm->ObjectTypeTable
+    VmmProcessActionForeachParallel(NULL, VmmWinInit_WarmMaps_CallbackCriteria, VmmWinInit_WarmMaps_CallbackAction);
+    ctxVmm->WarmMaps.fActive = FALSE;
+    ctxVmm->WarmMaps.fCompleted = TRUE;
+    vmmprintfv("VmmWinInit: Process maps initialized for %i processes in %llims.\n", ctxVmm->WarmMaps.cProcessDone, GetTickCount64() - tcStart);
+}
+
 /*
 * Async initialization of remaining actions in VmmWinInit_TryInitialize.
 * -- lpParameter
@@ -836,6 +884,10 @@ DWORD VmmWinInit_TryInitialize_Async(LPVOID lpParameter)
     MmWin_PagingInitialize(TRUE);   // initialize full paging (memcompression)
     VmmWinInit_TryInitializeThreading();
     VmmWinInit_TryInitializeKernelOptionalValues();
+    if(ctxMain->cfg.fWarmMaps) {
+        VmmWinInit_WarmMaps();
+    }
+    PDB_Profile_Flush();
     return 1;
 }
 
@@ -872,6 +924,8 @@ BOOL VmmWinInit_TryInitialize(_In_opt_ QWORD paDTBOpt)
         goto fail;
     }
     vmmprintfvv_fn("INFO: NTOS located at: %016llx.\n", ctxVmm->kernel.vaBase);
+    // Load cached kernel offsets (if any) before offsets are fuzzed below
+    PDB_Profile_Initialize(pObSystemProcess);
     // Initialize Paging (Limited Mode)
     MmWin_PagingInitialize(FALSE);
     // Locate System EPROCESS
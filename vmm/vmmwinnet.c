@@ -6,6 +6,7 @@
 
 #include <ws2tcpip.h>
 #include "vmmwinnet.h"
+#include "pdb.h"
 #include "pe.h"
 #include "util.h"
 
@@ -173,6 +174,22 @@ int VmmWinTcpIp_TcpE_CmpSort(PVMMWIN_TCPIP_ENTRY a, PVMMWIN_TCPIP_ENTRY b)
     return a->Src.wPort - b->Src.wPort;
 }
 
+/*
+* Verify that TcpE offsets (from the offset profile) are within the fuzzed TcpE
+* buffer and the TcpE struct size before they're used.
+* -- po
+* -- return
+*/
+BOOL VmmWinTcpIp_TcpE_OffsetVerify(_In_ PVMMWIN_TCPIP_OFFSET_TcpE po)
+{
+    if(!po->_fValid || (po->_Size < 8) || (po->_Size > 0x300)) { return FALSE; }
+    if((po->EProcess > 0x300 - 8) || (po->EProcess + 8 > po->_Size)) { return FALSE; }
+    if((po->Time + 8 > po->_Size) || (po->INET_AF + 8 > po->_Size) || (po->INET_Addr + 8 > po->_Size) || (po->FLink + 8 > po->_Size)) { return FALSE; }
+    if((po->State + 4 > po->_Size) || (po->PortSrc + 2 > po->_Size) || (po->PortDst + 2 > po->_Size)) { return FALSE; }
+    if(po->INET_AF_AF + 0x10 + 2 > 0x30) { return FALSE; }     // INET_AF is read as 0x30 bytes (incl. 0x10 pool header)
+    return TRUE;
+}
+
 /*
 * Fuzz offsets in TcpE if required. Upon a successful fuzz values will be stored
 * in the ctxVmm global context.
@@ -187,9 +204,26 @@ VOID VmmWinTcpIp_TcpE_Fuzz(_In_ PVMM_PROCESS pSystemProcess, _In_ QWORD vaTcpE)
     BYTE pb[0x300];
     PVMM_PROCESS pObProcess = NULL;
     PVMMWIN_TCPIP_OFFSET_TcpE po = &ctxVmm->TcpIp.OTcpE;
+    VMMWIN_TCPIP_OFFSET_TcpE oProfile = { 0 };
     if(po->_fValid || po->_fProcessedTry) { goto fail; }
     po->_fProcessedTry = TRUE;
     if(!VmmRead(pSystemProcess, vaTcpE, pb, 0x300)) { goto fail; }
+    // Try cached offsets from the kernel offset profile - verified by offset
+    // ranges and EPROCESS value before being published in the global context.
+    if(PDB_Profile_Get(PDB_PROFILE_KEY_TCPE, (PBYTE)&oProfile, sizeof(VMMWIN_TCPIP_OFFSET_TcpE)) && VmmWinTcpIp_TcpE_OffsetVerify(&oProfile)) {
+        va = *(PQWORD)(pb + oProfile.EProcess);
+        while((pObProcess = VmmProcessGetNext(pObProcess, VMM_FLAG_PROCESS_SHOW_TERMINATED))) {
+            if(va == pObProcess->win.EPROCESS.va) {
+                oProfile._fValid = FALSE;
+                oProfile._fProcessedTry = TRUE;
+                memcpy(po, &oProfile, sizeof(VMMWIN_TCPIP_OFFSET_TcpE));
+                po->_fValid = TRUE;
+                vmmprintfvv_fn("TcpE offsets loaded from offset profile.\n");
+                Ob_DECREF(pObProcess);
+                return;
+            }
+        }
+    }
     // Search for EPROCESS value in TcpE struct
     while((pObProcess = VmmProcessGetNext(pObProcess, VMM_FLAG_PROCESS_SHOW_TERMINATED))) {
         for(o = 0x80; o < 0x300; o += 8) {
@@ -227,6 +261,7 @@ VOID VmmWinTcpIp_TcpE_Fuzz(_In_ PVMM_PROCESS pSystemProcess, _In_ QWORD vaTcpE)
                         po->State, po->PortSrc, po->PortDst, po->EProcess, po->Time);
                     Util_PrintHexAscii(pb, 0x300, 0);
                 }
+                PDB_Profile_Put(PDB_PROFILE_KEY_TCPE, (PBYTE)po, sizeof(VMMWIN_TCPIP_OFFSET_TcpE));
                 Ob_DECREF(pObProcess);
                 return;
             }
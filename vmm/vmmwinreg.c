@@ -188,11 +188,15 @@ BOOL VmmWinReg_Reg2Virt(_In_ PVMM_PROCESS pProcessRegistry, _In_ POB_REGISTRY_HI
         VmmWinReg_Reg2Virt64(pProcessRegistry, pRegistryHive, ra, pva);
 }
 
+#define VMMWINREG_READSCATTER_CHUNK     0x100
+
 /*
 * Read scatter registry address. This translates each registry memory scatter
 * request item into a virtual memory scatter request item and submits it to
 * the underlying vmm sub-system. See VmmReadScatterVirtual for additional
-* information.
+* information. Large reads (such as hive snapshots) are split into chunks that
+* are read asynchronously - translation of the next chunk and the device reads
+* of up to several previous chunks are then overlapping.
 * -- pProcessRegistry
 * -- pRegistryHive
 * -- ppMEMsReg
@@ -201,16 +205,38 @@ BOOL VmmWinReg_Reg2Virt(_In_ PVMM_PROCESS pProcessRegistry, _In_ POB_REGISTRY_HI
 */
 VOID VmmWinReg_ReadScatter(_In_ PVMM_PROCESS pProcessRegistry, _In_ POB_REGISTRY_HIVE pRegistryHive, _Inout_ PPMEM_SCATTER ppMEMsReg, _In_ DWORD cpMEMsReg, _In_ QWORD flags)
 {
-    DWORD i;
     PMEM_SCATTER pMEM;
-    for(i = 0; i < cpMEMsReg; i++) {
-        pMEM = ppMEMsReg[i];
-        MEM_SCATTER_STACK_PUSH(pMEM, pMEM->qwA);
-        if(pMEM->f || !VmmWinReg_Reg2Virt(pProcessRegistry, pRegistryHive, (DWORD)pMEM->qwA, &pMEM->qwA)) {
-            pMEM->qwA = -1;
+    DWORD i, iChunk, cChunk, iRound = 0, cRound = 0, cRoundMax;
+    PVMMOB_READASYNC ppObAsync[VMM_READASYNC_PIPE_MAX] = { 0 };
+    cRoundMax = VmmReadAsyncRoundsMax();
+    for(iChunk = 0; iChunk < cpMEMsReg; iChunk += cChunk) {
+        cChunk = min(VMMWINREG_READSCATTER_CHUNK, cpMEMsReg - iChunk);
+        for(i = iChunk; i < iChunk + cChunk; i++) {
+            pMEM = ppMEMsReg[i];
+            MEM_SCATTER_STACK_PUSH(pMEM, pMEM->qwA);
+            if(pMEM->f || !VmmWinReg_Reg2Virt(pProcessRegistry, pRegistryHive, (DWORD)pMEM->qwA, &pMEM->qwA)) {
+                pMEM->qwA = -1;
+            }
         }
+        if(cChunk == cpMEMsReg) {
+            VmmReadScatterVirtual(pProcessRegistry, ppMEMsReg, cpMEMsReg, flags);
+            break;
+        }
+        if(cRound == cRoundMax) {
+            VmmReadAsyncWait(ppObAsync[iRound], INFINITE);
+            Ob_DECREF_NULL(&ppObAsync[iRound]);
+            iRound = (iRound + 1) % cRoundMax;
+            cRound--;
+        }
+        ppObAsync[(iRound + cRound) % cRoundMax] = VmmReadScatterAsync(pProcessRegistry, ppMEMsReg + iChunk, cChunk, flags);
+        cRound++;
+    }
+    while(cRound) {
+        VmmReadAsyncWait(ppObAsync[iRound], INFINITE);
+        Ob_DECREF_NULL(&ppObAsync[iRound]);
+        iRound = (iRound + 1) % cRoundMax;
+        cRound--;
     }
-    VmmReadScatterVirtual(pProcessRegistry, ppMEMsReg, cpMEMsReg, flags);
     for(i = 0; i < cpMEMsReg; i++) {
         pMEM = ppMEMsReg[i];
         pMEM->qwA = MEM_SCATTER_STACK_POP(pMEM);
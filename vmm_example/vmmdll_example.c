@@ -24,6 +24,17 @@
 //#define _INITIALIZE_FROM_FPGA
 //#define _INITIALIZE_FROM_TOTALMELTDOWN
 
+// ----------------------------------------------------------------------------
+// Run the test and benchmark drivers in vmmdll_test.c instead of the examples.
+// Syntax is shown when started without arguments. Defined by the Test build
+// configuration.
+// ----------------------------------------------------------------------------
+//#define _TEST_AND_BENCHMARK
+
+#ifdef _TEST_AND_BENCHMARK
+int VmmTest_Main(_In_ int argc, _In_ char* argv[]);
+#endif /* _TEST_AND_BENCHMARK */
+
 // ----------------------------------------------------------------------------
 // Utility functions below:
 // ----------------------------------------------------------------------------
@@ -106,6 +117,10 @@ int main(_In_ int argc, _In_ char* argv[])
     QWORD va;
     BYTE pbPage1[0x1000], pbPage2[0x1000];
 
+#ifdef _TEST_AND_BENCHMARK
+    return VmmTest_Main(argc, argv);
+#endif /* _TEST_AND_BENCHMARK */
+
 #ifdef _INITIALIZE_FROM_FILE
     // Initialize PCILeech DLL with a memory dump file.
     printf("------------------------------------------------------------\n");
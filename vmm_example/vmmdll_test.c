@@ -0,0 +1,1564 @@
+// vmmdll_test.c - MemProcFS C/C++ VMM API test and benchmark drivers
+//
+// The drivers run against a memory dump file and use the public VMM API only.
+// This allows a benchmark to be run unmodified against the vmm.dll of an older
+// build for comparison. The drivers are built by the Test solution configuration
+// (which defines _TEST_AND_BENCHMARK, and VMM_TEST_SELFTEST together with
+// VMM_TEST_LATENCY_INJECT for vmm.dll) and are started by running:
+//   vmm_example.exe <driver> <memory dump file> [driver arguments]
+// Tests print PASS/FAIL and return non-zero on failure. Benchmarks print their
+// measurements.
+//
+// (c) Ulf Frisk, 2018-2020
+// Author: Ulf Frisk, pcileech@frizk.net
+//
+
+#include <Windows.h>
+#include <psapi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <leechcore.h>
+#include <vmmdll.h>
+
+#define VMMTEST_ARGS_MAX            16
+#define VMMTEST_THREADS_MAX         64
+
+// ----------------------------------------------------------------------------
+// Utility functions below:
+// ----------------------------------------------------------------------------
+
+/*
+* Initialize MemProcFS from a memory dump file with optional additional command
+* line arguments. Plugins are initialized as well since some drivers use the
+* virtual file system.
+* -- szDump
+* -- cArgs
+* -- pszArgs
+* -- return
+*/
+_Success_(return)
+BOOL VmmTest_Initialize(_In_ LPSTR szDump, _In_ DWORD cArgs, _In_reads_opt_(cArgs) LPSTR *pszArgs)
+{
+    DWORD i, c = 0;
+    LPSTR szArgv[VMMTEST_ARGS_MAX + 3];
+    if(cArgs > VMMTEST_ARGS_MAX) { return FALSE; }
+    szArgv[c++] = "";
+    szArgv[c++] = "-device";
+    szArgv[c++] = szDump;
+    for(i = 0; i < cArgs; i++) {
+        szArgv[c++] = pszArgs[i];
+    }
+    if(!VMMDLL_Initialize(c, szArgv)) {
+        printf("FAIL:    VMMDLL_Initialize: '%s'\n", szDump);
+        return FALSE;
+    }
+    if(!VMMDLL_InitializePlugins()) {
+        printf("FAIL:    VMMDLL_InitializePlugins\n");
+        VMMDLL_Close();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+* Retrieve a monotonic timestamp in microseconds.
+*/
+QWORD VmmTest_TimeUs()
+{
+    static LARGE_INTEGER qwFreq = { 0 };
+    LARGE_INTEGER qwNow;
+    if(!qwFreq.QuadPart) { QueryPerformanceFrequency(&qwFreq); }
+    QueryPerformanceCounter(&qwNow);
+    return (qwNow.QuadPart / qwFreq.QuadPart) * 1000000 + (qwNow.QuadPart % qwFreq.QuadPart) * 1000000 / qwFreq.QuadPart;
+}
+
+/*
+* Pseudo random number generator (xorshift64) - fast and thread-local state.
+*/
+QWORD VmmTest_Rand(_Inout_ PQWORD pqwSeed)
+{
+    QWORD x = *pqwSeed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return (*pqwSeed = x);
+}
+
+/*
+* Read a whole file from the virtual file system into a null-terminated buffer.
+* CALLER LocalFree: return
+* -- wszPath
+* -- pcb = optional # of bytes read (excluding the null terminator).
+* -- return
+*/
+PBYTE VmmTest_VfsReadAlloc(_In_ LPWSTR wszPath, _Out_opt_ PDWORD pcb)
+{
+    NTSTATUS nt;
+    PBYTE pb, pbNew;
+    DWORD cb = 0, cbMax = 0x00100000, cbRead;
+    if(!(pb = LocalAlloc(0, cbMax))) { return NULL; }
+    while(TRUE) {
+        if(cb + 1 == cbMax) {
+            if(!(pbNew = LocalAlloc(0, 2ULL * cbMax))) { goto fail; }
+            memcpy(pbNew, pb, cb);
+            LocalFree(pb);
+            pb = pbNew;
+            cbMax *= 2;
+        }
+        nt = VMMDLL_VfsRead(wszPath, pb + cb, cbMax - cb - 1, &cbRead, cb);
+        if((nt != VMMDLL_STATUS_SUCCESS) && (nt != VMMDLL_STATUS_END_OF_FILE)) { goto fail; }
+        if((nt == VMMDLL_STATUS_END_OF_FILE) || !cbRead) { break; }
+        cb += cbRead;
+    }
+    pb[cb] = 0;
+    if(pcb) { *pcb = cb; }
+    return pb;
+fail:
+    LocalFree(pb);
+    return NULL;
+}
+
+/*
+* Write a string to a file in the virtual file system (i.e. a config file).
+* -- wszPath
+* -- sz
+* -- return
+*/
+_Success_(return)
+BOOL VmmTest_VfsWriteStr(_In_ LPWSTR wszPath, _In_ LPSTR sz)
+{
+    DWORD cbWrite;
+    return VMMDLL_STATUS_SUCCESS == VMMDLL_VfsWrite(wszPath, sz, (DWORD)strlen(sz), &cbWrite, 0);
+}
+
+/*
+* Retrieve a counter from the text of the .status/statistics file. Counters are
+* hexadecimal unless the label says DECIMAL. Labels occurring multiple times
+* (such as per i/o class) are selected by their occurrence index.
+* -- szStatistics
+* -- szLabel = label without the trailing colon, i.e. "DEVICE CALLS".
+* -- iOccurrence
+* -- return = the counter value, or 0 if not found.
+*/
+QWORD VmmTest_StatisticsValue(_In_ LPSTR szStatistics, _In_ LPSTR szLabel, _In_ DWORD iOccurrence)
+{
+    LPSTR sz = szStatistics;
+    SIZE_T cchLabel = strlen(szLabel);
+    while(sz && *sz) {
+        while(*sz == ' ') { sz++; }
+        if(!strncmp(sz, szLabel, cchLabel) && (sz[cchLabel] == ':')) {
+            if(!iOccurrence--) {
+                return _strtoui64(sz + cchLabel + 1, NULL, strstr(szLabel, "DECIMAL") ? 10 : 16);
+            }
+        }
+        if((sz = strchr(sz, '\n'))) { sz++; }
+    }
+    return 0;
+}
+
+/*
+* Run an internal self-test or benchmark of the .test module by writing its
+* parameter to \.test\<name> and print its result. The .test module exists in
+* VMM_TEST_SELFTEST builds of vmm.dll only.
+* -- wszName
+* -- szParam = decimal parameter, "0" = test default.
+* -- return = 0 on success, 1 if the test is missing or reported FAIL.
+*/
+int VmmTest_SelfTest(_In_ LPWSTR wszName, _In_ LPSTR szParam)
+{
+    int iResult = 1;
+    PBYTE pbResult = NULL;
+    WCHAR wszPath[MAX_PATH];
+    _snwprintf_s(wszPath, _countof(wszPath), _TRUNCATE, L"\\.test\\%s", wszName);
+    if(!VmmTest_VfsWriteStr(wszPath, szParam)) {
+        printf("FAIL:    %S not found - vmm.dll must be built with VMM_TEST_SELFTEST\n", wszPath);
+        return 1;
+    }
+    if(!(pbResult = VmmTest_VfsReadAlloc(wszPath, NULL))) {
+        printf("FAIL:    %S read result\n", wszPath);
+        return 1;
+    }
+    printf("%s", (LPSTR)pbResult);
+    iResult = strstr((LPSTR)pbResult, "FAIL") ? 1 : 0;
+    LocalFree(pbResult);
+    return iResult;
+}
+
+/*
+* Retrieve the progress of the physical memory scan of the forensic sub-system
+* from \forensic\scan_statistics.txt (decimal counters).
+* -- pcChunk = optional # of 16MB chunks read so far.
+* -- return = TRUE if the scan is finished.
+*/
+BOOL VmmTest_FcScanProgress(_Out_opt_ PQWORD pcChunk)
+{
+    BOOL fFinish;
+    LPSTR sz;
+    PBYTE pbStatistics;
+    if(pcChunk) { *pcChunk = 0; }
+    if(!(pbStatistics = VmmTest_VfsReadAlloc(L"\\forensic\\scan_statistics.txt", NULL))) { return FALSE; }
+    fFinish = strstr((LPSTR)pbStatistics, "FINISHED") ? TRUE : FALSE;
+    if(pcChunk && (sz = strstr((LPSTR)pbStatistics, "CHUNKS READ:"))) {
+        *pcChunk = _strtoui64(sz + 12, NULL, 10);
+    }
+    LocalFree(pbStatistics);
+    return fFinish;
+}
+
+/*
+* Wait for the forensic sub-system initialization to complete. The hidden
+* \forensic\ntfs module becomes visible (readable) once it is completed.
+* -- dwTimeoutSeconds
+* -- return = elapsed time in microseconds, or 0 on timeout.
+*/
+QWORD VmmTest_FcWait(_In_ DWORD dwTimeoutSeconds)
+{
+    BYTE b;
+    DWORD cbRead;
+    NTSTATUS nt;
+    QWORD tmStart = VmmTest_TimeUs();
+    while(VmmTest_TimeUs() - tmStart < dwTimeoutSeconds * 1000000ULL) {
+        nt = VMMDLL_VfsRead(L"\\forensic\\ntfs\\ntfs_files.txt", &b, 1, &cbRead, 0);
+        if((nt == VMMDLL_STATUS_SUCCESS) || (nt == VMMDLL_STATUS_END_OF_FILE)) {
+            return max(1, VmmTest_TimeUs() - tmStart);
+        }
+        Sleep(50);
+    }
+    printf("FAIL:    forensic initialization did not complete within %i seconds\n", dwTimeoutSeconds);
+    return 0;
+}
+
+typedef struct tdVMMTEST_THREAD {
+    struct tdVMMTEST_THREADS *pts;
+    DWORD i;
+    QWORD cOp;
+    QWORD cFail;
+    QWORD qwSeed;
+    BYTE _Pad[24];                      // one cache line per thread
+} VMMTEST_THREAD, *PVMMTEST_THREAD;
+
+typedef struct tdVMMTEST_THREADS {
+    volatile BOOL fStop;
+    PVOID ctx;
+    VOID(*pfn)(_In_ struct tdVMMTEST_THREADS *pts, _Inout_ PVMMTEST_THREAD pt);
+    VMMTEST_THREAD Thread[VMMTEST_THREADS_MAX];
+} VMMTEST_THREADS, *PVMMTEST_THREADS;
+
+DWORD VmmTest_Threads_ThreadProc(_In_ PVMMTEST_THREAD pt)
+{
+    pt->pts->pfn(pt->pts, pt);
+    return 0;
+}
+
+/*
+* Run the benchmark loop pts->pfn on cThread threads until dwMilliseconds has
+* passed. The loop counts its operations and exits when pts->fStop is set.
+* -- pts
+* -- cThread
+* -- dwMilliseconds
+* -- pcOp = total # of operations.
+* -- pcFail = total # of failed operations.
+* -- return = elapsed time in microseconds.
+*/
+QWORD VmmTest_ThreadsRun(_Inout_ PVMMTEST_THREADS pts, _In_ DWORD cThread, _In_ DWORD dwMilliseconds, _Out_ PQWORD pcOp, _Out_ PQWORD pcFail)
+{
+    DWORD i, cHandle = 0;
+    QWORD tmStart, tmElapsed;
+    HANDLE hThreads[VMMTEST_THREADS_MAX];
+    cThread = min(cThread, VMMTEST_THREADS_MAX);
+    pts->fStop = FALSE;
+    for(i = 0; i < cThread; i++) {
+        pts->Thread[i].pts = pts;
+        pts->Thread[i].i = i;
+        pts->Thread[i].cOp = 0;
+        pts->Thread[i].cFail = 0;
+        pts->Thread[i].qwSeed = 0x9e3779b97f4a7c15 * (i + 1);
+    }
+    tmStart = VmmTest_TimeUs();
+    for(i = 0; i < cThread; i++) {
+        if((hThreads[cHandle] = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)VmmTest_Threads_ThreadProc, pts->Thread + i, 0, NULL))) {
+            cHandle++;
+        }
+    }
+    Sleep(dwMilliseconds);
+    pts->fStop = TRUE;
+    if(cHandle) { WaitForMultipleObjects(cHandle, hThreads, TRUE, INFINITE); }
+    tmElapsed = VmmTest_TimeUs() - tmStart;
+    *pcOp = 0;
+    *pcFail = 0;
+    for(i = 0; i < cHandle; i++) {
+        CloseHandle(hThreads[i]);
+    }
+    for(i = 0; i < cThread; i++) {
+        *pcOp += pts->Thread[i].cOp;
+        *pcFail += pts->Thread[i].cFail;
+    }
+    return tmElapsed;
+}
+
+/*
+* Retrieve up to cPage readable physical page addresses spread evenly over the
+* physical memory map of the system.
+* CALLER LocalFree: return
+* -- cPage
+* -- pcPage = # of page addresses returned.
+* -- return
+*/
+PQWORD VmmTest_PhysPages(_In_ DWORD cPage, _Out_ PDWORD pcPage)
+{
+    DWORD i, cbPhysMemMap = 0;
+    QWORD pa, cbTotal = 0, cbStride;
+    PQWORD ppa = NULL;
+    PVMMDLL_MAP_PHYSMEM pPhysMemMap = NULL;
+    *pcPage = 0;
+    if(!VMMDLL_Map_GetPhysMem(NULL, &cbPhysMemMap) || !cbPhysMemMap) { goto fail; }
+    if(!(pPhysMemMap = LocalAlloc(0, cbPhysMemMap))) { goto fail; }
+    if(!VMMDLL_Map_GetPhysMem(pPhysMemMap, &cbPhysMemMap)) { goto fail; }
+    if(!(ppa = LocalAlloc(0, cPage * sizeof(QWORD)))) { goto fail; }
+    for(i = 0; i < pPhysMemMap->cMap; i++) {
+        cbTotal += pPhysMemMap->pMap[i].cb;
+    }
+    cbStride = max(0x1000, (cbTotal / cPage) & ~0xfff);
+    for(i = 0; (i < pPhysMemMap->cMap) && (*pcPage < cPage); i++) {
+        for(pa = pPhysMemMap->pMap[i].pa; (pa + 0x1000 <= pPhysMemMap->pMap[i].pa + pPhysMemMap->pMap[i].cb) && (*pcPage < cPage); pa += cbStride) {
+            ppa[(*pcPage)++] = pa & ~0xfff;
+        }
+    }
+fail:
+    LocalFree(pPhysMemMap);
+    if(!*pcPage) {
+        LocalFree(ppa);
+        return NULL;
+    }
+    return ppa;
+}
+
+/*
+* Read the pages with scatter reads (in batches of 0x1000 pages). Pages that
+* failed to read are removed from the array.
+* -- dwPID
+* -- pqwA
+* -- pcA
+* -- flags = VMMDLL_FLAG_*
+* -- return = # of bytes read.
+*/
+QWORD VmmTest_ReadScatterPages(_In_ DWORD dwPID, _Inout_ PQWORD pqwA, _Inout_ PDWORD pcA, _In_ DWORD flags)
+{
+    DWORD i, o, c, cKeep = 0;
+    QWORD cbRead = 0;
+    PPMEM_SCATTER ppMEMs = NULL;
+    if(!LcAllocScatter1(0x1000, &ppMEMs)) { return 0; }
+    for(o = 0; o < *pcA; o += c) {
+        c = min(0x1000, *pcA - o);
+        for(i = 0; i < c; i++) {
+            ppMEMs[i]->qwA = pqwA[o + i];
+            ppMEMs[i]->f = FALSE;
+        }
+        VMMDLL_MemReadScatter(dwPID, ppMEMs, c, flags);
+        for(i = 0; i < c; i++) {
+            if(ppMEMs[i]->f) {
+                pqwA[cKeep++] = ppMEMs[i]->qwA;
+                cbRead += 0x1000;
+            }
+        }
+    }
+    *pcA = cKeep;
+    LcMemFree(ppMEMs);
+    return cbRead;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// cache: read cache hit throughput from N threads. Every read is a forced cache
+// read (VMMDLL_FLAG_FORCECACHE_READ) of a small part of a page in a working set
+// which fits in the cache - measuring the cache lookup (VmmCacheGet) rather than
+// the device or the copy. Physical reads hit the physical memory cache, virtual
+// kernel reads of the System process additionally hit the page table cache.
+// ----------------------------------------------------------------------------
+
+#define VMMTEST_CACHE_PAGES         0x4000
+
+typedef struct tdVMMTEST_CACHE_CONTEXT {
+    DWORD dwPID;
+    DWORD cA;
+    PQWORD pqwA;
+} VMMTEST_CACHE_CONTEXT, *PVMMTEST_CACHE_CONTEXT;
+
+VOID VmmTest_Cache_ThreadLoop(_In_ PVMMTEST_THREADS pts, _Inout_ PVMMTEST_THREAD pt)
+{
+    BYTE pb[0x100];
+    DWORD cbRead;
+    QWORD qwA;
+    PVMMTEST_CACHE_CONTEXT ctx = (PVMMTEST_CACHE_CONTEXT)pts->ctx;
+    while(!pts->fStop) {
+        qwA = ctx->pqwA[VmmTest_Rand(&pt->qwSeed) % ctx->cA] + ((pt->cOp & 0xf) << 8);
+        if(!VMMDLL_MemReadEx(ctx->dwPID, qwA, pb, sizeof(pb), &cbRead, VMMDLL_FLAG_FORCECACHE_READ) || (cbRead != sizeof(pb))) {
+            pt->cFail++;
+        }
+        pt->cOp++;
+    }
+}
+
+/*
+* Retrieve up to cPage valid kernel virtual page addresses of the System process.
+* CALLER LocalFree: return
+*/
+PQWORD VmmTest_Cache_KernelPages(_In_ DWORD cPage, _Out_ PDWORD pcPage)
+{
+    DWORD i, cbPteMap = 0;
+    QWORD j;
+    PQWORD pva = NULL;
+    PVMMDLL_MAP_PTE pPteMap = NULL;
+    *pcPage = 0;
+    if(!VMMDLL_ProcessMap_GetPte(4, NULL, &cbPteMap, FALSE) || !cbPteMap) { goto fail; }
+    if(!(pPteMap = LocalAlloc(0, cbPteMap))) { goto fail; }
+    if(!VMMDLL_ProcessMap_GetPte(4, pPteMap, &cbPteMap, FALSE)) { goto fail; }
+    if(!(pva = LocalAlloc(0, cPage * sizeof(QWORD)))) { goto fail; }
+    for(i = 0; (i < pPteMap->cMap) && (*pcPage < cPage); i++) {
+        for(j = 0; (j < pPteMap->pMap[i].cPages) && (*pcPage < cPage); j++) {
+            pva[(*pcPage)++] = pPteMap->pMap[i].vaBase + (j << 12);
+        }
+    }
+fail:
+    LocalFree(pPteMap);
+    if(!*pcPage) {
+        LocalFree(pva);
+        return NULL;
+    }
+    return pva;
+}
+
+int VmmTest_Cache(_In_ int argc, _In_ char* argv[])
+{
+    int iResult = 1;
+    DWORD i, cThread, cThreadMax, dwMilliseconds;
+    QWORD qwCacheEntries = 0, tmElapsed, cOp, cFail;
+    SYSTEM_INFO SystemInfo;
+    VMMTEST_CACHE_CONTEXT ctx[2] = { 0 };
+    PVMMTEST_THREADS pts = NULL;
+    GetSystemInfo(&SystemInfo);
+    cThreadMax = min(VMMTEST_THREADS_MAX, (argc > 3) ? atoi(argv[3]) : SystemInfo.dwNumberOfProcessors);
+    dwMilliseconds = 1000 * ((argc > 4) ? atoi(argv[4]) : 5);
+    if(!cThreadMax || !dwMilliseconds) { return 1; }
+    if(!VmmTest_Initialize(argv[2], 0, NULL)) { return 1; }
+    if(!(pts = LocalAlloc(LMEM_ZEROINIT, sizeof(VMMTEST_THREADS)))) { goto fail; }
+    // working set: half the physical memory cache (if reported by this build).
+    VMMDLL_ConfigGet(VMMDLL_OPT_CONFIG_CACHE_ENTRIES_PHYS, &qwCacheEntries);
+    ctx[0].cA = (DWORD)(qwCacheEntries ? min(VMMTEST_CACHE_PAGES, qwCacheEntries / 2) : VMMTEST_CACHE_PAGES / 4);
+    ctx[1].cA = ctx[0].cA / 2;
+    ctx[0].dwPID = (DWORD)-1;
+    ctx[1].dwPID = 4;
+    if(!(ctx[0].pqwA = VmmTest_PhysPages(ctx[0].cA, &ctx[0].cA))) { goto fail; }
+    if(!(ctx[1].pqwA = VmmTest_Cache_KernelPages(ctx[1].cA, &ctx[1].cA))) { goto fail; }
+    for(i = 0; i < 2; i++) {
+        VmmTest_ReadScatterPages(ctx[i].dwPID, ctx[i].pqwA, &ctx[i].cA, 0);
+        if(!ctx[i].cA) { goto fail; }
+    }
+    printf("CACHE HIT THROUGHPUT: %i phys pages, %i virt pages, %i s per run\n", ctx[0].cA, ctx[1].cA, dwMilliseconds / 1000);
+    printf("MODE  THREADS        READS/S  READS/S/THREAD  MISS\n");
+    for(i = 0; i < 2; i++) {
+        pts->ctx = ctx + i;
+        pts->pfn = VmmTest_Cache_ThreadLoop;
+        for(cThread = 1; cThread; cThread = (cThread == cThreadMax) ? 0 : min(cThreadMax, cThread * 2)) {
+            tmElapsed = VmmTest_ThreadsRun(pts, cThread, dwMilliseconds, &cOp, &cFail);
+            printf(
+                "%s  %7i %14lli %15lli %5lli\n",
+                i ? "VIRT" : "PHYS",
+                cThread,
+                cOp * 1000000 / max(1, tmElapsed),
+                cOp * 1000000 / max(1, tmElapsed) / cThread,
+                cFail
+            );
+        }
+    }
+    iResult = 0;
+fail:
+    if(iResult) { printf("FAIL:    cache benchmark\n"); }
+    LocalFree(ctx[0].pqwA);
+    LocalFree(ctx[1].pqwA);
+    LocalFree(pts);
+    VMMDLL_Close();
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// scatter: read every page of the physical memory map of a (multi-GB) dump with
+// VMMDLL_MemReadScatter. Raw dump files are read from the memory mapped dump by
+// default, and through LeechCore if a memory map is given (-memmap auto), which
+// allows both paths to be compared in the same build. Uncached reads measure
+// the read path, cached reads additionally the copy into the read cache.
+// ----------------------------------------------------------------------------
+
+/*
+* Read all pages of the physical memory map once with scatter reads.
+* -- cPagePerCall = # of pages per VMMDLL_MemReadScatter call.
+* -- flags = VMMDLL_FLAG_*
+* -- pcbRead
+* -- pcPageFail
+* -- return = elapsed time in microseconds, or 0 on failure.
+*/
+QWORD VmmTest_ScatterPass(_In_ DWORD cPagePerCall, _In_ DWORD flags, _Out_ PQWORD pcbRead, _Out_ PQWORD pcPageFail)
+{
+    DWORD i, j, c = 0, cbPhysMemMap = 0;
+    QWORD pa, tmStart, tmElapsed = 0;
+    PPMEM_SCATTER ppMEMs = NULL;
+    PVMMDLL_MAP_PHYSMEM pPhysMemMap = NULL;
+    *pcbRead = 0;
+    *pcPageFail = 0;
+    if(!VMMDLL_Map_GetPhysMem(NULL, &cbPhysMemMap) || !cbPhysMemMap) { goto fail; }
+    if(!(pPhysMemMap = LocalAlloc(0, cbPhysMemMap))) { goto fail; }
+    if(!VMMDLL_Map_GetPhysMem(pPhysMemMap, &cbPhysMemMap)) { goto fail; }
+    if(!LcAllocScatter1(cPagePerCall, &ppMEMs)) { goto fail; }
+    tmStart = VmmTest_TimeUs();
+    for(i = 0; i < pPhysMemMap->cMap; i++) {
+        pa = pPhysMemMap->pMap[i].pa & ~0xfff;
+        while(TRUE) {
+            if(pa < pPhysMemMap->pMap[i].pa + pPhysMemMap->pMap[i].cb) {
+                ppMEMs[c]->qwA = pa;
+                ppMEMs[c]->f = FALSE;
+                pa += 0x1000;
+                c++;
+            }
+            if((c == cPagePerCall) || (c && (pa >= pPhysMemMap->pMap[i].pa + pPhysMemMap->pMap[i].cb) && (i + 1 == pPhysMemMap->cMap))) {
+                VMMDLL_MemReadScatter((DWORD)-1, ppMEMs, c, flags);
+                for(j = 0; j < c; j++) {
+                    if(ppMEMs[j]->f) {
+                        *pcbRead += 0x1000;
+                    } else {
+                        (*pcPageFail)++;
+                    }
+                }
+                c = 0;
+            }
+            if(pa >= pPhysMemMap->pMap[i].pa + pPhysMemMap->pMap[i].cb) { break; }
+        }
+    }
+    tmElapsed = max(1, VmmTest_TimeUs() - tmStart);
+fail:
+    LcMemFree(ppMEMs);
+    LocalFree(pPhysMemMap);
+    return tmElapsed;
+}
+
+/*
+* Retrieve the private (committed) memory usage of this process in MB - the
+* read cache is private memory, the memory mapped dump file is not.
+*/
+QWORD VmmTest_PrivateMB()
+{
+    PROCESS_MEMORY_COUNTERS_EX pmc = { 0 };
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), (PPROCESS_MEMORY_COUNTERS)&pmc, sizeof(pmc))) { return 0; }
+    return pmc.PrivateUsage / (1024 * 1024);
+}
+
+int VmmTest_Scatter(_In_ int argc, _In_ char* argv[])
+{
+    DWORD iMode, iPass, cPagePerCall;
+    QWORD tmElapsed, cbRead, cPageFail;
+    LPSTR szMode[] = { "default", "-memmap auto" };
+    LPSTR szArgsMemMap[] = { "-memmap", "auto" };
+    struct { LPSTR sz; DWORD flags; } Pass[] = {
+        { "uncached (cold)", VMMDLL_FLAG_NOCACHE },
+        { "uncached (warm)", VMMDLL_FLAG_NOCACHE },
+        { "cached         ", 0 },
+    };
+    cPagePerCall = (argc > 3) ? atoi(argv[3]) : 0x400;
+    if(!cPagePerCall) { return 1; }
+    printf("SCATTER READ OF ALL PHYSICAL PAGES: %i pages per call\n", cPagePerCall);
+    printf("MODE          PASS                   MB/S    MB READ  PAGES FAIL  PRIVATE MB\n");
+    for(iMode = 0; iMode < 2; iMode++) {
+        if(!VmmTest_Initialize(argv[2], iMode ? 2 : 0, iMode ? szArgsMemMap : NULL)) { return 1; }
+        for(iPass = 0; iPass < _countof(Pass); iPass++) {
+            if(!(tmElapsed = VmmTest_ScatterPass(cPagePerCall, Pass[iPass].flags, &cbRead, &cPageFail))) {
+                printf("FAIL:    scatter read pass\n");
+                VMMDLL_Close();
+                return 1;
+            }
+            printf(
+                "%-12s  %s  %10lli %10lli %11lli %11lli\n",
+                szMode[iMode],
+                Pass[iPass].sz,
+                cbRead / tmElapsed,
+                cbRead / (1024 * 1024),
+                cPageFail,
+                VmmTest_PrivateMB()
+            );
+        }
+        VMMDLL_Close();
+    }
+    return 0;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// workgroup: work scheduler overhead and scaling with a fan-out of (by default)
+// 10k tiny tasks submitted from 1-8 threads. The work-stealing scheduler with
+// VmmWorkGroup is compared against the previous ObSet-backed thread pool which
+// the .test module keeps as the reference (VMM_TEST_SELFTEST builds only).
+// ----------------------------------------------------------------------------
+
+int VmmTest_WorkGroup(_In_ int argc, _In_ char* argv[])
+{
+    int iResult;
+    if(!VmmTest_Initialize(argv[2], 0, NULL)) { return 1; }
+    iResult = VmmTest_SelfTest(L"workgroup", (argc > 3) ? argv[3] : "0");
+    VMMDLL_Close();
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// pdb: compare the native .pdb parser against dbghelp.dll for the kernel .pdb
+// of each memory dump given - a corpus of dumps of different Windows builds is
+// a corpus of ntoskrnl .pdbs. Every public symbol and every struct/class/union
+// type (size and member offsets) is compared (VMM_TEST_SELFTEST builds only).
+// ----------------------------------------------------------------------------
+
+int VmmTest_Pdb(_In_ int argc, _In_ char* argv[])
+{
+    int i, cFail = 0;
+    for(i = 2; i < argc; i++) {
+        printf("DUMP: %s\n", argv[i]);
+        if(!VmmTest_Initialize(argv[i], 0, NULL)) {
+            cFail++;
+            continue;
+        }
+        cFail += VmmTest_SelfTest(L"pdb", "0");
+        VMMDLL_Close();
+    }
+    printf("%s: %i of %i dumps failed\n", cFail ? "FAIL" : "PASS", cFail, argc - 2);
+    return cFail ? 1 : 0;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// xpress: validate the in-tree XPRESS decoder of compressed memory against the
+// ntdll decoder on a corpus of (by default) 4096 memory pages of the dump and
+// synthetic pages compressed by ntdll, and benchmark both decoders in pages/s
+// (VMM_TEST_SELFTEST builds only).
+// ----------------------------------------------------------------------------
+
+int VmmTest_Xpress(_In_ int argc, _In_ char* argv[])
+{
+    int iResult;
+    if(!VmmTest_Initialize(argv[2], 0, NULL)) { return 1; }
+    iResult = VmmTest_SelfTest(L"xpress", (argc > 3) ? argv[3] : "0");
+    VMMDLL_Close();
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// pagefile: concurrent page file read throughput from 1-16 threads with the
+// positional page file reader (single page and batched reads) compared to the
+// previous single-lock fseek/fread reader (VMM_TEST_SELFTEST builds only).
+// The page file is given as for normal analysis: -pagefile0 pagefile.sys.
+// ----------------------------------------------------------------------------
+
+int VmmTest_PageFile(_In_ int argc, _In_ char* argv[])
+{
+    int iResult;
+    LPSTR szArgs[] = { "-pagefile0", NULL };
+    if(argc < 4) {
+        printf("FAIL:    page file argument missing\n");
+        return 1;
+    }
+    szArgs[1] = argv[3];
+    if(!VmmTest_Initialize(argv[2], 2, szArgs)) { return 1; }
+    iResult = VmmTest_SelfTest(L"pagefile", (argc > 4) ? argv[4] : "0");
+    VMMDLL_Close();
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// paged: batched resolution of paged virtual memory. The committed private
+// memory (heaps, stacks and other private allocations) of all processes - the
+// memory most likely to be partly paged out - is read in 2MB virtual reads.
+// Each read is resolved page-by-page (config_paged_batch_disable = 1) and
+// batched; the page contents must be equal and the throughput is compared.
+// A dump with substantial paged memory should be used, preferably together
+// with its page file (VMM_TEST_SELFTEST builds only).
+// ----------------------------------------------------------------------------
+
+#define VMMTEST_PAGED_CHUNK             0x00200000
+#define VMMTEST_PAGED_MB_DEFAULT        512
+
+typedef struct tdVMMTEST_PAGED_CHUNK {
+    DWORD dwPID;
+    DWORD cb;
+    QWORD va;
+} VMMTEST_PAGED_CHUNK, *PVMMTEST_PAGED_CHUNK;
+
+/*
+* Collect up to cChunkMax 2MB chunks of private memory of all processes.
+* CALLER LocalFree: return
+* -- cChunkMax
+* -- pcChunk
+* -- return
+*/
+PVMMTEST_PAGED_CHUNK VmmTest_Paged_Chunks(_In_ DWORD cChunkMax, _Out_ PDWORD pcChunk)
+{
+    DWORD iPID, iVad, cbVadMap;
+    QWORD va, cPIDs = 0;
+    PDWORD pPIDs = NULL;
+    PVMMDLL_MAP_VAD pVadMap = NULL;
+    PVMMDLL_MAP_VADENTRY pe;
+    PVMMTEST_PAGED_CHUNK pChunks = NULL;
+    *pcChunk = 0;
+    if(!VMMDLL_PidList(NULL, &cPIDs) || !cPIDs) { goto fail; }
+    if(!(pPIDs = LocalAlloc(0, cPIDs * sizeof(DWORD)))) { goto fail; }
+    if(!VMMDLL_PidList(pPIDs, &cPIDs)) { goto fail; }
+    if(!(pChunks = LocalAlloc(0, cChunkMax * sizeof(VMMTEST_PAGED_CHUNK)))) { goto fail; }
+    for(iPID = 0; (iPID < cPIDs) && (*pcChunk < cChunkMax); iPID++) {
+        cbVadMap = 0;
+        if(!VMMDLL_ProcessMap_GetVad(pPIDs[iPID], NULL, &cbVadMap, FALSE) || !cbVadMap) { continue; }
+        if(!(pVadMap = LocalAlloc(0, cbVadMap))) { continue; }
+        if(VMMDLL_ProcessMap_GetVad(pPIDs[iPID], pVadMap, &cbVadMap, FALSE)) {
+            for(iVad = 0; (iVad < pVadMap->cMap) && (*pcChunk < cChunkMax); iVad++) {
+                pe = pVadMap->pMap + iVad;
+                if(!pe->fPrivateMemory || (pe->vaEnd <= pe->vaStart)) { continue; }
+                for(va = pe->vaStart & ~0xfff; (va < pe->vaEnd) && (*pcChunk < cChunkMax); va += VMMTEST_PAGED_CHUNK) {
+                    pChunks[*pcChunk].dwPID = pPIDs[iPID];
+                    pChunks[*pcChunk].va = va;
+                    pChunks[*pcChunk].cb = (DWORD)min(VMMTEST_PAGED_CHUNK, ((pe->vaEnd + 1) & ~0xfff) - va);
+                    (*pcChunk)++;
+                }
+            }
+        }
+        LocalFree(pVadMap);
+        pVadMap = NULL;
+    }
+fail:
+    LocalFree(pPIDs);
+    if(!*pcChunk) {
+        LocalFree(pChunks);
+        return NULL;
+    }
+    return pChunks;
+}
+
+/*
+* FNV-1a hash of a 4kB page.
+*/
+QWORD VmmTest_HashPage(_In_reads_(0x1000) PBYTE pb)
+{
+    DWORD i;
+    QWORD qwHash = 0xcbf29ce484222325;
+    for(i = 0; i < 0x1000; i += 8) {
+        qwHash = (qwHash ^ *(PQWORD)(pb + i)) * 0x100000001b3;
+    }
+    return qwHash;
+}
+
+int VmmTest_Paged(_In_ int argc, _In_ char* argv[])
+{
+    int iResult = 1;
+    BOOL fBatch;
+    PBYTE pb = NULL, pbStatistics;
+    DWORD iPass, iChunk, iPage, o, cChunk = 0, cbRead, cArgs = 0, cMismatch = 0;
+    QWORD tmStart, tmElapsed, cbTotal = 0, cPageFile, cCompressed, cTransition, cPrototype, cFail;
+    PQWORD pqwHash[2] = { 0 };
+    LPSTR szArgs[2] = { "-pagefile0", NULL };
+    PVMMTEST_PAGED_CHUNK pChunks = NULL;
+    LPSTR szPass[] = { "warm-up", "page-by-page", "batched" };
+    if(argc > 3) {
+        szArgs[1] = argv[3];
+        cArgs = 2;
+    }
+    if(!(pb = LocalAlloc(0, VMMTEST_PAGED_CHUNK))) { return 1; }
+    printf("PAGED VIRTUAL MEMORY READ: 2MB reads of private memory of all processes\n");
+    printf("PASS             MB/S   MB READ  PAGEFILE COMPRESSED TRANSITION PROTOTYPE   FAIL\n");
+    for(iPass = 0; iPass < 3; iPass++) {
+        fBatch = (iPass != 1);
+        if(!VmmTest_Initialize(argv[2], cArgs, szArgs)) { goto fail; }
+        if(!pChunks) {
+            if(!(pChunks = VmmTest_Paged_Chunks((DWORD)((QWORD)((argc > 4) ? atoi(argv[4]) : VMMTEST_PAGED_MB_DEFAULT) * 1024 * 1024 / VMMTEST_PAGED_CHUNK), &cChunk))) { goto fail_close; }
+            for(iChunk = 0; iChunk < cChunk; iChunk++) {
+                cbTotal += pChunks[iChunk].cb;
+            }
+            if(!(pqwHash[0] = LocalAlloc(0, (cbTotal >> 12) * sizeof(QWORD)))) { goto fail_close; }
+            if(!(pqwHash[1] = LocalAlloc(0, (cbTotal >> 12) * sizeof(QWORD)))) { goto fail_close; }
+        }
+        if(!VmmTest_VfsWriteStr(L"\\.test\\config_paged_batch_disable", fBatch ? "0" : "1")) {
+            printf("FAIL:    \\.test not found - vmm.dll must be built with VMM_TEST_SELFTEST\n");
+            goto fail_close;
+        }
+        iPage = 0;
+        tmStart = VmmTest_TimeUs();
+        for(iChunk = 0; iChunk < cChunk; iChunk++) {
+            VMMDLL_MemReadEx(pChunks[iChunk].dwPID, pChunks[iChunk].va, pb, pChunks[iChunk].cb, &cbRead, VMMDLL_FLAG_NOCACHE | VMMDLL_FLAG_ZEROPAD_ON_FAIL);
+            for(o = 0; o < pChunks[iChunk].cb; o += 0x1000) {
+                pqwHash[fBatch ? 1 : 0][iPage++] = VmmTest_HashPage(pb + o);
+            }
+        }
+        tmElapsed = max(1, VmmTest_TimeUs() - tmStart);
+        cPageFile = cCompressed = cTransition = cPrototype = cFail = 0;
+        if((pbStatistics = VmmTest_VfsReadAlloc(L"\\.status\\statistics", NULL))) {
+            cPageFile = VmmTest_StatisticsValue((LPSTR)pbStatistics, "PageFile", 0);
+            cCompressed = VmmTest_StatisticsValue((LPSTR)pbStatistics, "Compressed", 0);
+            cTransition = VmmTest_StatisticsValue((LPSTR)pbStatistics, "Transition", 0);
+            cPrototype = VmmTest_StatisticsValue((LPSTR)pbStatistics, "Prototype", 0);
+            cFail = VmmTest_StatisticsValue((LPSTR)pbStatistics, "READ FAIL", 1);
+            LocalFree(pbStatistics);
+        }
+        printf(
+            "%-12s %8lli %9lli %9lli %10lli %10lli %9lli %6lli\n",
+            szPass[iPass],
+            cbTotal / tmElapsed,
+            cbTotal / (1024 * 1024),
+            cPageFile, cCompressed, cTransition, cPrototype, cFail
+        );
+        VMMDLL_Close();
+    }
+    for(iPage = 0; iPage < (cbTotal >> 12); iPage++) {
+        if(pqwHash[0][iPage] != pqwHash[1][iPage]) { cMismatch++; }
+    }
+    printf("%s: %i of %lli pages differ between page-by-page and batched resolution\n", cMismatch ? "FAIL" : "PASS", cMismatch, cbTotal >> 12);
+    iResult = cMismatch ? 1 : 0;
+    goto fail;
+fail_close:
+    VMMDLL_Close();
+fail:
+    LocalFree(pb);
+    LocalFree(pChunks);
+    LocalFree(pqwHash[0]);
+    LocalFree(pqwHash[1]);
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// coalesce: coalescing of adjacent physical scatter reads into contiguous
+// device reads. The dump is read through the LeechCore file device (-memmap
+// auto disables the memory mapped dump) with coalescing disabled and with the
+// default and maximum coalesced read sizes. Workloads: all physical pages
+// (fully adjacent) and every other physical page (nothing to coalesce). The
+// device calls (VMM -> LeechCore) and the read i/o operations (syscalls) of
+// this process are counted, together with the throughput.
+// ----------------------------------------------------------------------------
+
+/*
+* Retrieve the # of read i/o operations issued by this process.
+*/
+QWORD VmmTest_IoReadOperations()
+{
+    IO_COUNTERS IoCounters = { 0 };
+    GetProcessIoCounters(GetCurrentProcess(), &IoCounters);
+    return IoCounters.ReadOperationCount;
+}
+
+/*
+* Retrieve the DEVICE CALLS counter of the .status/statistics file.
+*/
+QWORD VmmTest_DeviceCalls()
+{
+    QWORD c;
+    PBYTE pbStatistics;
+    if(!(pbStatistics = VmmTest_VfsReadAlloc(L"\\.status\\statistics", NULL))) { return 0; }
+    c = VmmTest_StatisticsValue((LPSTR)pbStatistics, "DEVICE CALLS", 0);
+    LocalFree(pbStatistics);
+    return c;
+}
+
+int VmmTest_Coalesce(_In_ int argc, _In_ char* argv[])
+{
+    DWORD i, iMode, iLoad, cPagePerCall, cPageCall, cPage, cbMax[3] = { 0 };
+    QWORD qwDefault = 0, tmStart, tmElapsed, cbRead, cPageFail, cDevice, cIo;
+    PQWORD ppa = NULL;
+    LPSTR szArgsMemMap[] = { "-memmap", "auto" };
+    LPSTR szLoad[] = { "all pages", "every 2nd page" };
+    cPagePerCall = (argc > 3) ? atoi(argv[3]) : 0x400;
+    if(!cPagePerCall) { return 1; }
+    printf("COALESCED DEVICE READS: LeechCore file device, %i pages per scatter call\n", cPagePerCall);
+    printf("COALESCE MAX  WORKLOAD            MB/S    MB READ  DEVICE CALLS  READ SYSCALLS\n");
+    for(iMode = 0; iMode < 3; iMode++) {
+        if(!VmmTest_Initialize(argv[2], 2, szArgsMemMap)) { return 1; }
+        if(!iMode) {
+            if(!VMMDLL_ConfigGet(VMMDLL_OPT_CONFIG_READ_COALESCE_MAX, &qwDefault)) {
+                printf("FAIL:    read coalescing not supported by this vmm.dll\n");
+                VMMDLL_Close();
+                return 1;
+            }
+            cbMax[1] = (DWORD)qwDefault;
+            cbMax[2] = 0x01000000;
+        }
+        if(!VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_READ_COALESCE_MAX, cbMax[iMode])) {
+            VMMDLL_ConfigGet(VMMDLL_OPT_CONFIG_READ_COALESCE_MAX, &qwDefault);
+            cbMax[iMode] = (DWORD)qwDefault;
+        }
+        VmmTest_ScatterPass(cPagePerCall, VMMDLL_FLAG_NOCACHE, &cbRead, &cPageFail);     // warm-up (os file cache)
+        for(iLoad = 0; iLoad < 2; iLoad++) {
+            cDevice = VmmTest_DeviceCalls();
+            cIo = VmmTest_IoReadOperations();
+            if(iLoad == 0) {
+                if(!(tmElapsed = VmmTest_ScatterPass(cPagePerCall, VMMDLL_FLAG_NOCACHE, &cbRead, &cPageFail))) {
+                    VMMDLL_Close();
+                    return 1;
+                }
+            } else {
+                if(!(ppa = VmmTest_PhysPages((DWORD)min(0x01000000, cbRead >> 13), &cPage))) {
+                    VMMDLL_Close();
+                    return 1;
+                }
+                cbRead = 0;
+                tmStart = VmmTest_TimeUs();
+                for(i = 0; i < cPage; i += cPageCall) {
+                    cPageCall = min(cPagePerCall, cPage - i);
+                    cbRead += VmmTest_ReadScatterPages((DWORD)-1, ppa + i, &cPageCall, VMMDLL_FLAG_NOCACHE);
+                    cPageCall = min(cPagePerCall, cPage - i);
+                }
+                tmElapsed = max(1, VmmTest_TimeUs() - tmStart);
+                LocalFree(ppa);
+                ppa = NULL;
+            }
+            printf(
+                "%10x    %-14s %9lli %10lli %13lli %14lli\n",
+                cbMax[iMode],
+                szLoad[iLoad],
+                cbRead / tmElapsed,
+                cbRead / (1024 * 1024),
+                VmmTest_DeviceCalls() - cDevice,
+                VmmTest_IoReadOperations() - cIo
+            );
+        }
+        VMMDLL_Close();
+    }
+    return 0;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// async: pipelined asynchronous reads of the multi-round walkers against a slow
+// device. The stand-in slow device is the dump with an injected latency per
+// device read (VMMDLL_OPT_CONFIG_READ_LATENCY_INJECT_MS - only present in
+// builds with VMM_TEST_LATENCY_INJECT). Process enumeration, VAD spider,
+// handle tables and registry hive reads are timed with async reads disabled
+// and with increasing queue depths. The results of each walk must be equal to
+// the synchronous results.
+// ----------------------------------------------------------------------------
+
+typedef struct tdVMMTEST_ASYNC_RESULT {
+    QWORD tm[4];
+    QWORD cProcess;
+    QWORD cVad;
+    QWORD cHandle;
+    QWORD qwHashRegistry;
+} VMMTEST_ASYNC_RESULT, *PVMMTEST_ASYNC_RESULT;
+
+/*
+* Run the walkers once with cold caches and time them.
+* -- pr
+*/
+VOID VmmTest_Async_Walk(_Out_ PVMMTEST_ASYNC_RESULT pr)
+{
+    DWORD i, o, oPage, cb, cbRead, cHives = 0;
+    QWORD tmStart, cPIDs = 0;
+    PDWORD pPIDs = NULL;
+    PBYTE pb = NULL;
+    PVMMDLL_REGISTRY_HIVE_INFORMATION pHives = NULL;
+    ZeroMemory(pr, sizeof(VMMTEST_ASYNC_RESULT));
+    pr->qwHashRegistry = 0xcbf29ce484222325;
+    // process enumeration (full refresh of all caches):
+    tmStart = VmmTest_TimeUs();
+    VMMDLL_ConfigSet(VMMDLL_OPT_REFRESH_ALL, 1);
+    VMMDLL_PidList(NULL, &cPIDs);
+    if(!cPIDs || !(pPIDs = LocalAlloc(0, cPIDs * sizeof(DWORD)))) { goto fail; }
+    if(!VMMDLL_PidList(pPIDs, &cPIDs)) { goto fail; }
+    pr->cProcess = cPIDs;
+    pr->tm[0] = VmmTest_TimeUs() - tmStart;
+    // vad spider:
+    tmStart = VmmTest_TimeUs();
+    for(i = 0; i < cPIDs; i++) {
+        cb = 0;
+        if(!VMMDLL_ProcessMap_GetVad(pPIDs[i], NULL, &cb, FALSE) || !cb) { continue; }
+        if(!(pb = LocalAlloc(0, cb))) { continue; }
+        if(VMMDLL_ProcessMap_GetVad(pPIDs[i], (PVMMDLL_MAP_VAD)pb, &cb, FALSE)) {
+            pr->cVad += ((PVMMDLL_MAP_VAD)pb)->cMap;
+        }
+        LocalFree(pb);
+        pb = NULL;
+    }
+    pr->tm[1] = VmmTest_TimeUs() - tmStart;
+    // handle tables:
+    tmStart = VmmTest_TimeUs();
+    for(i = 0; i < cPIDs; i++) {
+        cb = 0;
+        if(!VMMDLL_ProcessMap_GetHandle(pPIDs[i], NULL, &cb) || !cb) { continue; }
+        if(!(pb = LocalAlloc(0, cb))) { continue; }
+        if(VMMDLL_ProcessMap_GetHandle(pPIDs[i], (PVMMDLL_MAP_HANDLE)pb, &cb)) {
+            pr->cHandle += ((PVMMDLL_MAP_HANDLE)pb)->cMap;
+        }
+        LocalFree(pb);
+        pb = NULL;
+    }
+    pr->tm[2] = VmmTest_TimeUs() - tmStart;
+    // registry hive reads (1MB chunks):
+    tmStart = VmmTest_TimeUs();
+    if(!VMMDLL_WinReg_HiveList(NULL, 0, &cHives) || !cHives) { goto fail; }
+    if(!(pHives = LocalAlloc(0, cHives * sizeof(VMMDLL_REGISTRY_HIVE_INFORMATION)))) { goto fail; }
+    if(!VMMDLL_WinReg_HiveList(pHives, cHives, &cHives)) { goto fail; }
+    if(!(pb = LocalAlloc(0, 0x00100000))) { goto fail; }
+    for(i = 0; i < cHives; i++) {
+        for(o = 0; o < pHives[i].cbLength; o += 0x00100000) {
+            cb = min(0x00100000, pHives[i].cbLength - o);
+            cbRead = 0;
+            ZeroMemory(pb, 0x00100000);
+            VMMDLL_WinReg_HiveReadEx(pHives[i].vaCMHIVE, o, pb, cb, &cbRead, VMMDLL_FLAG_NOCACHE | VMMDLL_FLAG_ZEROPAD_ON_FAIL);
+            for(oPage = 0; oPage < cb; oPage += 0x1000) {
+                pr->qwHashRegistry = (pr->qwHashRegistry ^ VmmTest_HashPage(pb + oPage)) * 0x100000001b3;
+            }
+        }
+    }
+    pr->tm[3] = VmmTest_TimeUs() - tmStart;
+fail:
+    LocalFree(pHives);
+    LocalFree(pPIDs);
+    LocalFree(pb);
+}
+
+int VmmTest_Async(_In_ int argc, _In_ char* argv[])
+{
+    int iResult = 1;
+    DWORD iDepth, dwLatency, cDepth[] = { 0, 1, 2, 4, 8, 16 };
+    VMMTEST_ASYNC_RESULT rSync = { 0 }, r;
+    dwLatency = (argc > 3) ? atoi(argv[3]) : 2;
+    if(!VmmTest_Initialize(argv[2], 0, NULL)) { return 1; }
+    if(!VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_READ_LATENCY_INJECT_MS, dwLatency)) {
+        printf("FAIL:    latency injection requires a vmm.dll built with VMM_TEST_LATENCY_INJECT\n");
+        goto fail;
+    }
+    printf("ASYNC PIPELINED READS: %i ms injected latency per device read\n", dwLatency);
+    printf("DEPTH  PROCESS(MS)  VAD(MS)  HANDLE(MS)  REGISTRY(MS)  PROCESSES    VADS  HANDLES\n");
+    for(iDepth = 0; iDepth < _countof(cDepth); iDepth++) {
+        if(!VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_READ_ASYNC_DEPTH, cDepth[iDepth])) {
+            printf("FAIL:    VMMDLL_OPT_CONFIG_READ_ASYNC_DEPTH = %i\n", cDepth[iDepth]);
+            goto fail;
+        }
+        VmmTest_Async_Walk(iDepth ? &r : &rSync);
+        if(!iDepth) { r = rSync; }
+        printf(
+            "%5i %12lli %8lli %11lli %13lli %10lli %7lli %8lli\n",
+            cDepth[iDepth], r.tm[0] / 1000, r.tm[1] / 1000, r.tm[2] / 1000, r.tm[3] / 1000, r.cProcess, r.cVad, r.cHandle
+        );
+        if(!r.cProcess || (r.cProcess != rSync.cProcess) || (r.cVad != rSync.cVad) || (r.cHandle != rSync.cHandle) || (r.qwHashRegistry != rSync.qwHashRegistry)) {
+            printf("FAIL:    depth %i walk results differ from the synchronous walk\n", cDepth[iDepth]);
+            goto fail;
+        }
+    }
+    printf("PASS:    async walk results equal to synchronous walk results\n");
+    iResult = 0;
+fail:
+    VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_READ_LATENCY_INJECT_MS, 0);
+    VMMDLL_Close();
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// iosched: latency of interactive reads while a forensic scan runs. The device
+// is the dump with an injected latency per device read (a vmm.dll built with
+// VMM_TEST_LATENCY_INJECT) so that the bulk forensic reads saturate it. Single
+// page uncached reads (an api/vfs caller) are timed during the first seconds
+// of the forensic initialization with the i/o scheduler disabled (slice = 0)
+// and enabled (default slice). The per-class statistics of .status/statistics
+// and the scan progress made during the measurement are shown as well.
+// ----------------------------------------------------------------------------
+
+int VmmTest_IoSched_CompareQWORD(_In_ const void *p1, _In_ const void *p2)
+{
+    QWORD q1 = *(PQWORD)p1, q2 = *(PQWORD)p2;
+    return (q1 < q2) ? -1 : ((q1 > q2) ? 1 : 0);
+}
+
+int VmmTest_IoSched(_In_ int argc, _In_ char* argv[])
+{
+    int iResult = 1;
+    BYTE pb[0x1000];
+    DWORD iMode, cPage = 0, cOp, cOpMax = 0x00100000, dwLatency, dwSeconds, cbRead;
+    QWORD qwSeed = 0x5eed, qwDefault = 0, cSlice[2] = { 0 }, tmStart, tmOp, tmTotal, cChunk;
+    PQWORD ppa = NULL, ptmOp = NULL;
+    PBYTE pbStatistics = NULL;
+    dwLatency = (argc > 3) ? atoi(argv[3]) : 1;
+    dwSeconds = (argc > 4) ? atoi(argv[4]) : 10;
+    if(!(ptmOp = LocalAlloc(0, cOpMax * sizeof(QWORD)))) { return 1; }
+    printf("I/O SCHEDULER: interactive reads during forensic scan, %i ms injected latency, %i seconds\n", dwLatency, dwSeconds);
+    printf("SLICE   READS  AVG(US)  P50(US)  P99(US)  MAX(US)  SCAN CHUNKS | INTERACTIVE: REQ  WAIT AVG | BULK: REQ  WAIT AVG\n");
+    for(iMode = 0; iMode < 2; iMode++) {
+        if(!VmmTest_Initialize(argv[2], 0, NULL)) { goto fail_nohandle; }
+        if(!iMode) {
+            VMMDLL_ConfigGet(VMMDLL_OPT_CONFIG_READ_SCHED_SLICE, &qwDefault);
+            cSlice[1] = qwDefault ? qwDefault : 0x100;
+        }
+        if(!(ppa = VmmTest_PhysPages(0x4000, &cPage))) { goto fail; }
+        if(!VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_READ_SCHED_SLICE, cSlice[iMode])) {
+            printf("FAIL:    VMMDLL_OPT_CONFIG_READ_SCHED_SLICE = %lli\n", cSlice[iMode]);
+            goto fail;
+        }
+        if(!VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_READ_LATENCY_INJECT_MS, dwLatency)) {
+            printf("FAIL:    latency injection requires a vmm.dll built with VMM_TEST_LATENCY_INJECT\n");
+            goto fail;
+        }
+        if(!VMMDLL_ConfigSet(VMMDLL_OPT_FORENSIC_MODE, 1)) {
+            printf("FAIL:    forensic mode could not be started\n");
+            goto fail;
+        }
+        Sleep(250);
+        cOp = 0;
+        tmTotal = 0;
+        tmStart = VmmTest_TimeUs();
+        while((VmmTest_TimeUs() - tmStart < dwSeconds * 1000000ULL) && (cOp < cOpMax) && !VmmTest_FcScanProgress(NULL)) {
+            tmOp = VmmTest_TimeUs();
+            VMMDLL_MemReadEx((DWORD)-1, ppa[VmmTest_Rand(&qwSeed) % cPage], pb, 0x1000, &cbRead, VMMDLL_FLAG_NOCACHE);
+            ptmOp[cOp] = VmmTest_TimeUs() - tmOp;
+            tmTotal += ptmOp[cOp++];
+        }
+        VmmTest_FcScanProgress(&cChunk);
+        if(!cOp || !(pbStatistics = VmmTest_VfsReadAlloc(L"\\.status\\statistics", NULL))) { goto fail; }
+        qsort(ptmOp, cOp, sizeof(QWORD), VmmTest_IoSched_CompareQWORD);
+        printf(
+            "%5llx %7i %8lli %8lli %8lli %8lli %12lli | %16llx %9lli | %9llx %9lli\n",
+            cSlice[iMode], cOp, tmTotal / cOp, ptmOp[cOp / 2], ptmOp[cOp * 99 / 100], ptmOp[cOp - 1], cChunk,
+            VmmTest_StatisticsValue((LPSTR)pbStatistics, "REQUESTS", 0),
+            VmmTest_StatisticsValue((LPSTR)pbStatistics, "WAIT AVG (US, DECIMAL)", 0),
+            VmmTest_StatisticsValue((LPSTR)pbStatistics, "REQUESTS", 2),
+            VmmTest_StatisticsValue((LPSTR)pbStatistics, "WAIT AVG (US, DECIMAL)", 2)
+        );
+        LocalFree(pbStatistics);
+        pbStatistics = NULL;
+        LocalFree(ppa);
+        ppa = NULL;
+        VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_READ_LATENCY_INJECT_MS, 0);
+        VMMDLL_Close();
+    }
+    iResult = 0;
+    goto fail_nohandle;
+fail:
+    VMMDLL_ConfigSet(VMMDLL_OPT_CONFIG_READ_LATENCY_INJECT_MS, 0);
+    VMMDLL_Close();
+fail_nohandle:
+    LocalFree(pbStatistics);
+    LocalFree(ppa);
+    LocalFree(ptmOp);
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// ntfscarve: carving accuracy regression test of the NTFS MFT record carver.
+// The synthetic image with known valid and invalid MFT records is created by
+// the .test module of vmm.dll (VMM_TEST_SELFTEST build) - the dump is only
+// required to initialize vmm.dll.
+// ----------------------------------------------------------------------------
+
+int VmmTest_NtfsCarve(_In_ int argc, _In_ char* argv[])
+{
+    int iResult;
+    if(!VmmTest_Initialize(argv[2], 0, NULL)) { return 1; }
+    iResult = VmmTest_SelfTest(L"ntfscarve", (argc > 3) ? argv[3] : "0");
+    VMMDLL_Close();
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// ntfsfinal: NTFS MFT tree reconstruction test+benchmark. Synthetic MFT record
+// sets of multiple volumes are finalized by the .test module of vmm.dll
+// (VMM_TEST_SELFTEST build) with the previous sequential algorithm and the
+// parallel algorithm - the output must be identical. The dump is only required
+// to initialize vmm.dll.
+// ----------------------------------------------------------------------------
+
+int VmmTest_NtfsFinal(_In_ int argc, _In_ char* argv[])
+{
+    int iResult;
+    if(!VmmTest_Initialize(argv[2], 0, NULL)) { return 1; }
+    iResult = VmmTest_SelfTest(L"ntfsfinal", (argc > 3) ? argv[3] : "0");
+    VMMDLL_Close();
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// sqlbulk: forensic database ingest benchmark. The 'str' and 'ntfs' row stream
+// of a completed forensic scan of the dump is recorded and replayed into empty
+// databases row-by-row (previous ingest path) and with the bulk ingest path by
+// the .test module of vmm.dll (VMM_TEST_SELFTEST build).
+// ----------------------------------------------------------------------------
+
+int VmmTest_SqlBulk(_In_ int argc, _In_ char* argv[])
+{
+    int iResult = 1;
+    QWORD tmScan;
+    if(!VmmTest_Initialize(argv[2], 0, NULL)) { return 1; }
+    if(!VMMDLL_ConfigSet(VMMDLL_OPT_FORENSIC_MODE, 1)) {
+        printf("FAIL:    forensic mode could not be started\n");
+        goto fail;
+    }
+    if(!(tmScan = VmmTest_FcWait(3600))) { goto fail; }
+    printf("FORENSIC: initialization completed in %lli ms\n", tmScan / 1000);
+    iResult = VmmTest_SelfTest(L"sqlbulk", (argc > 3) ? argv[3] : "0");
+fail:
+    VMMDLL_Close();
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// timeline: timeline build benchmark and identical-output test. A synthetic
+// timeline (default 50M events) is built both with the external merge sort and
+// with the window-function SQL by the .test module of vmm.dll (VMM_TEST_SELFTEST
+// build) once the forensic scan of the dump is completed.
+// ----------------------------------------------------------------------------
+
+int VmmTest_Timeline(_In_ int argc, _In_ char* argv[])
+{
+    int iResult = 1;
+    if(!VmmTest_Initialize(argv[2], 0, NULL)) { return 1; }
+    if(!VMMDLL_ConfigSet(VMMDLL_OPT_FORENSIC_MODE, 1)) {
+        printf("FAIL:    forensic mode could not be started\n");
+        goto fail;
+    }
+    if(!VmmTest_FcWait(3600)) { goto fail; }
+    iResult = VmmTest_SelfTest(L"timeline", (argc > 3) ? argv[3] : "0");
+fail:
+    VMMDLL_Close();
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// resume: kill-mid-scan and resume test of the resumable forensic database
+// (forensic mode 4, static vmm.sqlite3). A reference forensic initialization
+// of the dump is run on a new database. The database is then deleted and the
+// forensic initialization is started in child processes which are killed hard
+// (TerminateProcess, no VMMDLL_Close) once they have read a number of scan
+// chunks, or once the scan is finished/skipped. A final run resumes from the
+// store to completion - the ntfs and timeline files must be identical to the
+// reference and the final run must have reused the store (skipped stages or a
+// resumed scan). The static database in the temp directory is deleted.
+// ----------------------------------------------------------------------------
+
+#define VMMTEST_RESUME_FILE_MAX             32
+#define VMMTEST_RESUME_CHUNK_MIN            32      // > FC_RESUME_CHECKPOINT_CHUNKS
+#define VMMTEST_RESUME_EXIT_KILL_SCAN       0x10    // child killed during the scan
+#define VMMTEST_RESUME_EXIT_KILL_DONE       0x11    // child killed after the scan
+
+typedef struct tdVMMTEST_RESUME_RUN {
+    QWORD tmUs;
+    QWORD cChunk;
+    BOOL fResumed;
+    QWORD cStageSkip;
+    QWORD cbScanStart;
+    QWORD cCheckpoint;
+    DWORD cFile;
+    struct {
+        WCHAR wszName[MAX_PATH];
+        QWORD cb;
+        QWORD qwHash;
+    } File[VMMTEST_RESUME_FILE_MAX];
+} VMMTEST_RESUME_RUN, *PVMMTEST_RESUME_RUN;
+
+/*
+* Retrieve a decimal value from \forensic\scan_statistics.txt.
+*/
+QWORD VmmTest_Resume_StatisticsValue(_In_ LPSTR szStatistics, _In_ LPSTR szLabel)
+{
+    LPSTR sz = strstr(szStatistics, szLabel);
+    return sz ? _strtoui64(sz + strlen(szLabel), NULL, 10) : 0;
+}
+
+/*
+* Size and FNV-1a hash of a (large) file in the virtual file system - the file
+* is read in 16MB parts.
+* -- wszPath
+* -- pcb
+* -- return = the hash, or 0 on failure.
+*/
+QWORD VmmTest_Resume_HashFile(_In_ LPWSTR wszPath, _Out_ PQWORD pcb)
+{
+    NTSTATUS nt;
+    PBYTE pb;
+    DWORD i, cbRead;
+    QWORD qwHash = 0xcbf29ce484222325;
+    *pcb = 0;
+    if(!(pb = LocalAlloc(0, 0x01000000))) { return 0; }
+    while(TRUE) {
+        nt = VMMDLL_VfsRead(wszPath, pb, 0x01000000, &cbRead, *pcb);
+        if((nt != VMMDLL_STATUS_SUCCESS) && (nt != VMMDLL_STATUS_END_OF_FILE)) {
+            qwHash = 0;
+            break;
+        }
+        for(i = 0; i < cbRead; i++) {
+            qwHash = (qwHash ^ pb[i]) * 0x100000001b3;
+        }
+        *pcb += cbRead;
+        if((nt == VMMDLL_STATUS_END_OF_FILE) || !cbRead) { break; }
+    }
+    LocalFree(pb);
+    return qwHash;
+}
+
+VOID VmmTest_Resume_ListAddFile(_Inout_ HANDLE h, _In_ LPWSTR wszName, _In_ ULONG64 cb, _In_opt_ PVMMDLL_VFS_FILELIST_EXINFO pExInfo)
+{
+    PVMMTEST_RESUME_RUN pRun = (PVMMTEST_RESUME_RUN)h;
+    if(pRun->cFile < VMMTEST_RESUME_FILE_MAX) {
+        _snwprintf_s(pRun->File[pRun->cFile++].wszName, MAX_PATH, _TRUNCATE, L"\\forensic\\timeline\\%s", wszName);
+    }
+}
+
+VOID VmmTest_Resume_ListAddDirectory(_Inout_ HANDLE h, _In_ LPWSTR wszName, _In_opt_ PVMMDLL_VFS_FILELIST_EXINFO pExInfo)
+{
+    return;
+}
+
+/*
+* Retrieve the path of the static forensic database (mode 4) - the same path
+* as is used by vmm.dll: <long temp path>\vmm.sqlite3.
+* -- wszDatabase
+* -- return
+*/
+_Success_(return)
+BOOL VmmTest_Resume_DatabasePath(_Out_writes_(MAX_PATH) LPWSTR wszDatabase)
+{
+    WCHAR wszTempShort[MAX_PATH];
+    if(!GetTempPathW(MAX_PATH, wszTempShort)) { return FALSE; }
+    if(!GetLongPathNameW(wszTempShort, wszDatabase, MAX_PATH)) { return FALSE; }
+    return !wcscat_s(wszDatabase, MAX_PATH, L"vmm.sqlite3");
+}
+
+/*
+* Delete the static forensic database together with its wal/shm/journal files.
+* -- wszDatabase
+*/
+VOID VmmTest_Resume_DatabaseDelete(_In_ LPWSTR wszDatabase)
+{
+    DWORD i;
+    WCHAR wsz[MAX_PATH + 16];
+    LPWSTR wszSuffix[] = { L"", L"-wal", L"-shm", L"-journal" };
+    for(i = 0; i < _countof(wszSuffix); i++) {
+        _snwprintf_s(wsz, _countof(wsz), _TRUNCATE, L"%s%s", wszDatabase, wszSuffix[i]);
+        DeleteFileW(wsz);
+    }
+}
+
+/*
+* Run the forensic initialization (mode 4) of the dump to completion in this
+* process and record the resume statistics and the output files.
+* -- szDump
+* -- pRun
+* -- return
+*/
+_Success_(return)
+BOOL VmmTest_Resume_Run(_In_ LPSTR szDump, _Out_ PVMMTEST_RESUME_RUN pRun)
+{
+    BOOL fResult = FALSE;
+    DWORD i;
+    PBYTE pbStatistics = NULL;
+    VMMDLL_VFS_FILELIST FileList;
+    ZeroMemory(pRun, sizeof(VMMTEST_RESUME_RUN));
+    if(!VmmTest_Initialize(szDump, 0, NULL)) { return FALSE; }
+    if(!VMMDLL_ConfigSet(VMMDLL_OPT_FORENSIC_MODE, 4)) {
+        printf("FAIL:    forensic mode 4 could not be started\n");
+        goto fail;
+    }
+    if(!(pRun->tmUs = VmmTest_FcWait(3600))) { goto fail; }
+    if(!(pbStatistics = VmmTest_VfsReadAlloc(L"\\forensic\\scan_statistics.txt", NULL))) { goto fail; }
+    pRun->cChunk = VmmTest_Resume_StatisticsValue((LPSTR)pbStatistics, "CHUNKS READ:");
+    pRun->fResumed = strstr((LPSTR)pbStatistics, "RESUMED") ? TRUE : FALSE;
+    pRun->cStageSkip = VmmTest_Resume_StatisticsValue((LPSTR)pbStatistics, "RESUME STAGES SKIPPED:");
+    pRun->cbScanStart = VmmTest_Resume_StatisticsValue((LPSTR)pbStatistics, "RESUME SCAN START (MB):") << 20;
+    pRun->cCheckpoint = VmmTest_Resume_StatisticsValue((LPSTR)pbStatistics, "RESUME CHECKPOINTS:");
+    if(!strstr((LPSTR)pbStatistics, "RESUME STORE:")) {
+        printf("FAIL:    resumable store not active - vmm.sqlite3 could not be opened\n");
+        goto fail;
+    }
+    // output files: ntfs_files.txt and all timeline files
+    wcscpy_s(pRun->File[pRun->cFile++].wszName, MAX_PATH, L"\\forensic\\ntfs\\ntfs_files.txt");
+    FileList.dwVersion = VMMDLL_VFS_FILELIST_VERSION;
+    FileList.h = (HANDLE)pRun;
+    FileList.pfnAddFile = VmmTest_Resume_ListAddFile;
+    FileList.pfnAddDirectory = VmmTest_Resume_ListAddDirectory;
+    VMMDLL_VfsList(L"\\forensic\\timeline", &FileList);
+    for(i = 0; i < pRun->cFile; i++) {
+        pRun->File[i].qwHash = VmmTest_Resume_HashFile(pRun->File[i].wszName, &pRun->File[i].cb);
+    }
+    fResult = TRUE;
+fail:
+    LocalFree(pbStatistics);
+    VMMDLL_Close();
+    return fResult;
+}
+
+/*
+* Child process: start the forensic initialization (mode 4) and kill this
+* process hard once cChunkKill chunks have been read or the scan is finished
+* or skipped. Never returns on a kill.
+* -- szDump
+* -- cChunkKill
+* -- return = 1 on failure.
+*/
+int VmmTest_Resume_Child(_In_ LPSTR szDump, _In_ QWORD cChunkKill)
+{
+    BOOL fFinish = FALSE;
+    QWORD cChunk = 0, tmStart;
+    if(!VmmTest_Initialize(szDump, 0, NULL)) { return 1; }
+    if(!VMMDLL_ConfigSet(VMMDLL_OPT_FORENSIC_MODE, 4)) {
+        printf("FAIL:    forensic mode 4 could not be started\n");
+        VMMDLL_Close();
+        return 1;
+    }
+    tmStart = VmmTest_TimeUs();
+    while(!fFinish && (cChunk < cChunkKill) && (VmmTest_TimeUs() - tmStart < 3600 * 1000000ULL)) {
+        Sleep(10);
+        fFinish = VmmTest_FcScanProgress(&cChunk);
+    }
+    printf("KILL:    child killed after %lli chunks (%s)\n", cChunk, fFinish ? "scan finished or skipped" : "mid-scan");
+    fflush(stdout);
+    TerminateProcess(GetCurrentProcess(), fFinish ? VMMTEST_RESUME_EXIT_KILL_DONE : VMMTEST_RESUME_EXIT_KILL_SCAN);
+    return 1;
+}
+
+int VmmTest_Resume(_In_ int argc, _In_ char* argv[])
+{
+    int iResult = 1;
+    DWORD i, iKill, cKill, cKillScan = 0, dwExitCode, cMismatch = 0;
+    QWORD cChunkKill;
+    CHAR szExe[MAX_PATH], szCmd[3 * MAX_PATH];
+    WCHAR wszDatabase[MAX_PATH];
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    PVMMTEST_RESUME_RUN pRef = NULL, pRun = NULL;
+    // child process (spawned below): <dump> <kills> -kill <chunks>
+    if((argc > 5) && !strcmp(argv[4], "-kill")) {
+        return VmmTest_Resume_Child(argv[2], _strtoui64(argv[5], NULL, 10));
+    }
+    cKill = (argc > 3) ? max(1, atoi(argv[3])) : 3;
+    if(!VmmTest_Resume_DatabasePath(wszDatabase)) { return 1; }
+    if(!GetModuleFileNameA(NULL, szExe, MAX_PATH)) { return 1; }
+    if(!(pRef = LocalAlloc(0, sizeof(VMMTEST_RESUME_RUN)))) { goto fail; }
+    if(!(pRun = LocalAlloc(0, sizeof(VMMTEST_RESUME_RUN)))) { goto fail; }
+    printf("RESUME:  kill-mid-scan and resume test, %i kills, database: %S\n", cKill, wszDatabase);
+    // 1: reference run on a new database
+    VmmTest_Resume_DatabaseDelete(wszDatabase);
+    if(!VmmTest_Resume_Run(argv[2], pRef)) { goto fail; }
+    if(pRef->fResumed || pRef->cStageSkip) {
+        printf("FAIL:    reference run resumed from a database which should have been deleted\n");
+        goto fail;
+    }
+    // 2: start over and kill child processes at increasing scan progress
+    VmmTest_Resume_DatabaseDelete(wszDatabase);
+    cChunkKill = max(VMMTEST_RESUME_CHUNK_MIN, pRef->cChunk / (cKill + 1));
+    for(iKill = 0; iKill < cKill; iKill++) {
+        _snprintf_s(szCmd, _countof(szCmd), _TRUNCATE, "\"%s\" resume \"%s\" %i -kill %lli", szExe, argv[2], cKill, cChunkKill);
+        ZeroMemory(&si, sizeof(si));
+        si.cb = sizeof(si);
+        if(!CreateProcessA(NULL, szCmd, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) {
+            printf("FAIL:    CreateProcess: %s\n", szCmd);
+            goto fail;
+        }
+        WaitForSingleObject(pi.hProcess, INFINITE);
+        GetExitCodeProcess(pi.hProcess, &dwExitCode);
+        CloseHandle(pi.hThread);
+        CloseHandle(pi.hProcess);
+        if((dwExitCode != VMMTEST_RESUME_EXIT_KILL_SCAN) && (dwExitCode != VMMTEST_RESUME_EXIT_KILL_DONE)) {
+            printf("FAIL:    child process %i exit code %i - not killed\n", iKill, dwExitCode);
+            goto fail;
+        }
+        if(dwExitCode == VMMTEST_RESUME_EXIT_KILL_SCAN) { cKillScan++; }
+    }
+    // 3: resume to completion and compare with the reference
+    if(!VmmTest_Resume_Run(argv[2], pRun)) { goto fail; }
+    printf("RUN          TIME(MS)   CHUNKS  STAGES SKIPPED  SCAN START(MB)  CHECKPOINTS\n");
+    printf("reference  %10lli %8lli %15lli %15lli %12lli\n", pRef->tmUs / 1000, pRef->cChunk, pRef->cStageSkip, pRef->cbScanStart >> 20, pRef->cCheckpoint);
+    printf("resumed    %10lli %8lli %15lli %15lli %12lli\n", pRun->tmUs / 1000, pRun->cChunk, pRun->cStageSkip, pRun->cbScanStart >> 20, pRun->cCheckpoint);
+    printf("FILE                                                   SIZE    REF HASH           RESUMED HASH\n");
+    for(i = 0; i < max(pRef->cFile, pRun->cFile); i++) {
+        if((i >= pRef->cFile) || (i >= pRun->cFile) || wcscmp(pRef->File[i].wszName, pRun->File[i].wszName) || (pRef->File[i].cb != pRun->File[i].cb) || (pRef->File[i].qwHash != pRun->File[i].qwHash)) {
+            cMismatch++;
+        }
+        printf("%-48S %12lli    %016llx   %016llx\n",
+            (i < pRef->cFile) ? pRef->File[i].wszName : pRun->File[i].wszName,
+            (i < pRef->cFile) ? pRef->File[i].cb : pRun->File[i].cb,
+            (i < pRef->cFile) ? pRef->File[i].qwHash : 0,
+            (i < pRun->cFile) ? pRun->File[i].qwHash : 0);
+    }
+    if(!pRun->fResumed || (!pRun->cStageSkip && !pRun->cbScanStart)) {
+        printf("FAIL:    final run did not resume from the store (%i of %i kills mid-scan)\n", cKillScan, cKill);
+        goto fail;
+    }
+    if(cMismatch || !pRef->File[0].qwHash) {
+        printf("FAIL:    %i output files differ from the reference\n", cMismatch);
+        goto fail;
+    }
+    printf("PASS:    resumed output identical to the reference (%i of %i kills mid-scan)\n", cKillScan, cKill);
+    iResult = 0;
+fail:
+    VmmTest_Resume_DatabaseDelete(wszDatabase);
+    LocalFree(pRef);
+    LocalFree(pRun);
+    return iResult;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Main entry point of the test and benchmark drivers.
+// ----------------------------------------------------------------------------
+
+typedef struct tdVMMTEST_DRIVER {
+    LPSTR szName;
+    LPSTR szUsage;
+    int(*pfn)(_In_ int argc, _In_ char* argv[]);
+} VMMTEST_DRIVER, *PVMMTEST_DRIVER;
+
+VMMTEST_DRIVER g_VmmTestDrivers[] = {
+    { "cache",      "<dump> [max threads] [seconds]         - benchmark: read cache hit throughput", VmmTest_Cache },
+    { "scatter",    "<dump> [pages per call]                - benchmark: scatter read of all physical pages", VmmTest_Scatter },
+    { "workgroup",  "<dump> [tasks]                         - benchmark: work scheduler fan-out vs previous pool (selftest build)", VmmTest_WorkGroup },
+    { "pdb",        "<dump> [dump ...]                      - test: native .pdb parser equals dbghelp for each kernel (selftest build)", VmmTest_Pdb },
+    { "xpress",     "<dump> [pages]                         - test+benchmark: in-tree xpress decoder vs ntdll (selftest build)", VmmTest_Xpress },
+    { "pagefile",   "<dump> <pagefile.sys> [seconds]        - benchmark: concurrent page file reads vs previous reader (selftest build)", VmmTest_PageFile },
+    { "paged",      "<dump> [pagefile.sys] [MB]             - test+benchmark: batched vs page-by-page paged memory reads (selftest build)", VmmTest_Paged },
+    { "coalesce",   "<dump> [pages per call]                - benchmark: device calls/syscalls/throughput with and without read coalescing", VmmTest_Coalesce },
+    { "async",      "<dump> [latency ms]                    - test+benchmark: pipelined walkers vs synchronous on a slow device (latency inject build)", VmmTest_Async },
+    { "iosched",    "<dump> [latency ms] [seconds]          - benchmark: interactive read latency during a forensic scan (latency inject build)", VmmTest_IoSched },
+    { "ntfscarve",  "<dump> [scan iterations]               - test+benchmark: mft record carving on a synthetic image (selftest build)", VmmTest_NtfsCarve },
+    { "ntfsfinal",  "<dump> [volumes]                       - test+benchmark: parallel vs sequential mft tree reconstruction on synthetic mft sets (selftest build)", VmmTest_NtfsFinal },
+    { "sqlbulk",    "<dump> [rows]                          - benchmark: recorded forensic row stream replay, row-by-row vs bulk ingest (selftest build)", VmmTest_SqlBulk },
+    { "timeline",   "<dump> [events]                        - test+benchmark: merge-sort vs sql timeline build on synthetic events (selftest build)", VmmTest_Timeline },
+    { "resume",     "<dump> [kills]                         - test: kill forensic mode 4 mid-scan, resume and compare with a fresh run", VmmTest_Resume },
+};
+
+int VmmTest_Main(_In_ int argc, _In_ char* argv[])
+{
+    DWORD i;
+    if(argc > 2) {
+        for(i = 0; i < _countof(g_VmmTestDrivers); i++) {
+            if(!_stricmp(argv[1], g_VmmTestDrivers[i].szName)) {
+                return g_VmmTestDrivers[i].pfn(argc, argv);
+            }
+        }
+    }
+    printf("MemProcFS test and benchmark drivers. Syntax:\n");
+    for(i = 0; i < _countof(g_VmmTestDrivers); i++) {
+        printf("  vmm_example.exe %-10s %s\n", g_VmmTestDrivers[i].szName, g_VmmTestDrivers[i].szUsage);
+    }
+    return 1;
+}